@@ -109,6 +109,10 @@ Boolean
 	Clipboard_CreateCFStringArrayFromPasteboard		(CFArrayRef&		outCFStringCFArray,
 											 NSPasteboard*				inPasteboardOrNull = nullptr);
 
+Boolean
+	Clipboard_CreateCFStringFromPasteboard	(CFStringRef&				outCFString,
+											 NSPasteboard*				inPasteboardOrNull = nullptr);
+
 Boolean
 	Clipboard_CreateCGImageFromPasteboard	(CGImageRef&				outImage,
 											 CFStringRef&				outUTI,
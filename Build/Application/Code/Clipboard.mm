@@ -75,6 +75,7 @@ namespace {
 CFStringRef		copyTypeDescription			(CFStringRef);
 Boolean			isImageType					(CFStringRef);
 Boolean			isTextType					(CFStringRef);
+NSArray*		readPasteboardStrings		(NSPasteboard*);
 void			updateClipboard				();
 
 } // anonymous namespace
@@ -287,131 +288,114 @@ When successful (returning true), the "outCFStringCFArray"
 will be defined and you must call CFRelease() on it when
 finished. Otherwise, it will be set to nullptr.
 
+See also Clipboard_CreateCFStringFromPasteboard(), which
+is better for large amounts of text.
+
 (2018.08)
 */
 Boolean
 Clipboard_CreateCFStringArrayFromPasteboard		(CFArrayRef&		outCFStringCFArray,
 												 NSPasteboard*		inPasteboardOrNull)
 {
-	NSPasteboard*		kPasteboard = (nullptr == inPasteboardOrNull)
-										? [NSPasteboard generalPasteboard]
-										: inPasteboardOrNull;
-	NSArray*			objectArray = nil;
+	NSArray*			itemStrings = readPasteboardStrings(inPasteboardOrNull);
 	NSMutableArray*		newStringArray = [[NSMutableArray alloc] init];
-	NSDictionary*		fileReadingOptions = @{ NSPasteboardURLReadingFileURLsOnlyKey: @(YES) };
 	Boolean				result = false;
 	
 	
 	outCFStringCFArray = nullptr; // initially...
 	
-	// first look for file objects
-	objectArray = [kPasteboard readObjectsForClasses:@[NSURL.class] options:fileReadingOptions];
-	if ((nil != objectArray) && (objectArray.count > 0))
+	for (NSString* stringValue in itemStrings)
 	{
-		// read URLs; in this case, copy all of them in a row
-		// (separated by new lines)
-		for (id anObject in objectArray)
+		CFRetainRelease		lineArray(StringUtilities_CFNewStringsWithLines(BRIDGE_CAST(stringValue, CFStringRef)),
+										CFRetainRelease::kAlreadyRetained);
+		
+		
+		for (id stringObject in BRIDGE_CAST(lineArray.returnCFArrayRef(), NSArray*))
 		{
-			if ([anObject isKindOfClass:NSURL.class])
+			if (NO == [stringObject isKindOfClass:NSString.class])
 			{
-				NSURL*		asURL = STATIC_CAST(anObject, NSURL*);
-				NSString*	stringValue = [asURL absoluteURL].path;
-				
-				
-				if (nil != stringValue)
-				{
-					[newStringArray addObject:stringValue];
-				}
-				else
-				{
-					Console_Warning(Console_WriteLine, "unable to resolve NSURL object on pasteboard");
-				}
+				Console_Warning(Console_WriteLine, "assertion failure; received non-string object in array that expected strings");
 			}
 			else
 			{
-				// ???
-				Console_Warning(Console_WriteLine, "non-NSURL object in pasteboard");
+				NSString*	asString = STATIC_CAST(stringObject, NSString*);
+				
+				
+				[newStringArray addObject:asString];
 			}
 		}
 	}
-	else
+	
+	if (newStringArray.count > 0)
 	{
-		// read other types of items
-		NSDictionary*	readingOptions = @{};
+		outCFStringCFArray = BRIDGE_CAST(newStringArray, CFArrayRef);
+		CFRetain(outCFStringCFArray);
+		result = true;
+	}
+	
+	return result;
+}// CreateCFStringArrayFromPasteboard
+
+
+/*!
+Returns true only if the specified pasteboard contains text
+that was successfully converted.  This reads the same data
+as Clipboard_CreateCFStringArrayFromPasteboard() but the
+result is one string: the text of each item (including any
+new-line sequences) is kept as-is, and separate items are
+joined by new-lines.
+
+Unlike an array of lines, this costs nothing extra for text
+with a very large number of lines (such as a Paste that
+should be streamed to a session).
+
+When successful (returning true), the "outCFString" will
+be defined and you must call CFRelease() on it when
+finished. Otherwise, it will be set to nullptr.
+
+(2023.10)
+*/
+Boolean
+Clipboard_CreateCFStringFromPasteboard		(CFStringRef&		outCFString,
+											 NSPasteboard*		inPasteboardOrNull)
+{
+	NSArray*	itemStrings = readPasteboardStrings(inPasteboardOrNull);
+	Boolean		result = false;
+	
+	
+	outCFString = nullptr; // initially...
+	
+	if (1 == itemStrings.count)
+	{
+		// common case; no copy is necessary
+		outCFString = BRIDGE_CAST(itemStrings.firstObject, CFStringRef);
+		CFRetain(outCFString);
+		result = true;
+	}
+	else if (itemStrings.count > 1)
+	{
+		NSMutableString*	joinedString = [[NSMutableString alloc] init];
+		NSCharacterSet*		newlineSet = [NSCharacterSet newlineCharacterSet];
 		
 		
-		objectArray = [kPasteboard readObjectsForClasses:@[NSPasteboardItem.class] options:readingOptions];
-		if ((nil == objectArray) || (0 == objectArray.count))
+		for (NSString* stringValue in itemStrings)
 		{
-			// not text content
-			//Console_Warning(Console_WriteLine, "failed to read any text from pasteboard");
-		}
-		else
-		{
-			for (id anObject in objectArray)
+			// separate items with a new-line (unless the previous
+			// item already ended with one)
+			if ((joinedString.length > 0) &&
+				(NO == [newlineSet characterIsMember:[joinedString characterAtIndex:(joinedString.length - 1)]]))
 			{
-				if ([anObject isKindOfClass:NSPasteboardItem.class])
-				{
-					// read text
-					NSPasteboardItem*	asPasteboardItem = STATIC_CAST(anObject, NSPasteboardItem*);
-					NSArray*			textUTIs = @[
-														// in order of preference, and most specific first (otherwise the
-														// more generic types will match)
-														BRIDGE_CAST(kUTTypeUTF16ExternalPlainText, NSString*),
-														BRIDGE_CAST(kUTTypeUTF16PlainText, NSString*),
-														BRIDGE_CAST(kUTTypeUTF8PlainText, NSString*),
-														BRIDGE_CAST(kUTTypePlainText, NSString*),
-														@"com.apple.traditional-mac-plain-text",
-													];
-					
-					
-					for (NSString* aUTI in textUTIs)
-					{
-						NSString*	stringValue = [asPasteboardItem stringForType:aUTI];
-						
-						
-						if (nil != stringValue)
-						{
-							CFRetainRelease		lineArray(StringUtilities_CFNewStringsWithLines(BRIDGE_CAST(stringValue, CFStringRef)),
-															CFRetainRelease::kAlreadyRetained);
-							
-							
-							for (id stringObject in BRIDGE_CAST(lineArray.returnCFArrayRef(), NSArray*))
-							{
-								if (NO == [stringObject isKindOfClass:NSString.class])
-								{
-									Console_Warning(Console_WriteLine, "assertion failure; received non-string object in array that expected strings");
-								}
-								else
-								{
-									NSString*	asString = STATIC_CAST(stringObject, NSString*);
-									
-									
-									[newStringArray addObject:asString];
-								}
-							}
-							break;
-						}
-					}
-				}
-				else
-				{
-					// ???
-					Console_Warning(Console_WriteLine, "non-NSPasteboardItem object in pasteboard");
-				}
+				[joinedString appendString:@"\n"];
 			}
+			[joinedString appendString:stringValue];
 		}
-	}
-	
-	if (newStringArray.count > 0)
-	{
-		outCFStringCFArray = BRIDGE_CAST(newStringArray, CFArrayRef);
-		CFRetain(outCFStringCFArray);
+		outCFString = BRIDGE_CAST(joinedString, CFStringRef);
+		CFRetain(outCFString);
 		result = true;
 	}
 	
 	return result;
-}// CreateCFStringArrayFromPasteboard
+}// CreateCFStringFromPasteboard
 
 
 /*!
@@ -652,6 +636,114 @@ isTextType	(CFStringRef	inUTI)
 }// isTextType
 
 
+/*!
+Reads every text item from the given pasteboard (or the
+general pasteboard, if nullptr), converting data that is
+not text (such as file URLs) into text.  Each string in
+the returned array corresponds to one item and is not
+split into lines.
+
+The array is empty if there is no usable text.
+
+(2023.10)
+*/
+NSArray*
+readPasteboardStrings	(NSPasteboard*		inPasteboardOrNull)
+{
+	NSPasteboard*		kPasteboard = (nullptr == inPasteboardOrNull)
+										? [NSPasteboard generalPasteboard]
+										: inPasteboardOrNull;
+	NSArray*			objectArray = nil;
+	NSDictionary*		fileReadingOptions = @{ NSPasteboardURLReadingFileURLsOnlyKey: @(YES) };
+	NSMutableArray*		result = [[NSMutableArray alloc] init];
+	
+	
+	// first look for file objects
+	objectArray = [kPasteboard readObjectsForClasses:@[NSURL.class] options:fileReadingOptions];
+	if ((nil != objectArray) && (objectArray.count > 0))
+	{
+		// read URLs; in this case, copy all of them in a row
+		// (separated by new lines)
+		for (id anObject in objectArray)
+		{
+			if ([anObject isKindOfClass:NSURL.class])
+			{
+				NSURL*		asURL = STATIC_CAST(anObject, NSURL*);
+				NSString*	stringValue = [asURL absoluteURL].path;
+				
+				
+				if (nil != stringValue)
+				{
+					[result addObject:stringValue];
+				}
+				else
+				{
+					Console_Warning(Console_WriteLine, "unable to resolve NSURL object on pasteboard");
+				}
+			}
+			else
+			{
+				// ???
+				Console_Warning(Console_WriteLine, "non-NSURL object in pasteboard");
+			}
+		}
+	}
+	else
+	{
+		// read other types of items
+		NSDictionary*	readingOptions = @{};
+		
+		
+		objectArray = [kPasteboard readObjectsForClasses:@[NSPasteboardItem.class] options:readingOptions];
+		if ((nil == objectArray) || (0 == objectArray.count))
+		{
+			// not text content
+			//Console_Warning(Console_WriteLine, "failed to read any text from pasteboard");
+		}
+		else
+		{
+			for (id anObject in objectArray)
+			{
+				if ([anObject isKindOfClass:NSPasteboardItem.class])
+				{
+					// read text
+					NSPasteboardItem*	asPasteboardItem = STATIC_CAST(anObject, NSPasteboardItem*);
+					NSArray*			textUTIs = @[
+														// in order of preference, and most specific first (otherwise the
+														// more generic types will match)
+														BRIDGE_CAST(kUTTypeUTF16ExternalPlainText, NSString*),
+														BRIDGE_CAST(kUTTypeUTF16PlainText, NSString*),
+														BRIDGE_CAST(kUTTypeUTF8PlainText, NSString*),
+														BRIDGE_CAST(kUTTypePlainText, NSString*),
+														@"com.apple.traditional-mac-plain-text",
+													];
+					
+					
+					for (NSString* aUTI in textUTIs)
+					{
+						NSString*	stringValue = [asPasteboardItem stringForType:aUTI];
+						
+						
+						if (nil != stringValue)
+						{
+							[result addObject:stringValue];
+							break;
+						}
+					}
+				}
+				else
+				{
+					// ???
+					Console_Warning(Console_WriteLine, "non-NSPasteboardItem object in pasteboard");
+				}
+			}
+		}
+	}
+	
+	return result;
+}// readPasteboardStrings
+
+
 /*!
 Updates internal state so that other API calls from this
 module actually work with the given pasteboard!
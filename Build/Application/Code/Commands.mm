@@ -2403,7 +2403,14 @@ performActionForMacro:(id)		sender
 	}
 	else
 	{
-		MacroManager_UserInputMacro(oneBasedMacroNumber - 1/* zero-based macro number */);
+		MacroManager_Result		macroResult = MacroManager_UserInputMacro(oneBasedMacroNumber - 1/* zero-based macro number */);
+		
+		
+		if (kMacroManager_ResultBusy == macroResult)
+		{
+			// the session is still sending earlier input (such as a large Paste)
+			Sound_StandardAlert();
+		}
 	}
 }
 - (id)
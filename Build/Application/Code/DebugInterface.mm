@@ -36,13 +36,18 @@
 @import Cocoa;
 
 // library includes
+#import <CocoaBasic.h>
 #import <Console.h>
+#import <MemoryBlockSlotLocker.template.h>
 #import <SoundSystem.h>
+#import <UTF8Decoder.h>
+#import <UTF8Encoder.h>
 #import <XPCCallPythonClient.objc++.h>
 
 // application includes
 #import "Session.h"
 #import "SessionFactory.h"
+#import "SixelDecoder.h"
 #import "Terminal.h"
 
 // Swift imports
@@ -183,7 +188,7 @@ dumpStateOfActiveTerminal
 			}
 			else
 			{
-				Console_WriteLine("No debugging information has been defined.");
+				Session_DebugDumpDetailedSnapshot(activeSession);
 			}
 		}
 		Console_WriteLine("Terminal Window");
@@ -271,6 +276,103 @@ launchNewCallPythonClient
 }// launchNewCallPythonClient
 
 
+/*!
+Asks the user for one or more files of captured terminal
+output and replays each one through a scratch terminal
+screen, logging throughput figures to the console.  See
+Terminal_DebugRunThroughputBenchmark().
+
+(2023.10)
+*/
+- (void)
+runTerminalThroughputBenchmark
+{
+	UNUSED_RETURN(Boolean)CocoaBasic_FileOpenPanelDisplay
+							(CFSTR("Choose files of captured terminal output to replay."),
+								nullptr/* allowed file types */,
+								^(CFURLRef aURL)
+								{
+									NSData*		fileData = [NSData dataWithContentsOfURL:BRIDGE_CAST(aURL, NSURL*)];
+									
+									
+									if (nil == fileData)
+									{
+										Console_Warning(Console_WriteValueCFString, "unable to read benchmark file",
+														CFURLGetString(aURL));
+									}
+									else
+									{
+										Terminal_Result		benchmarkResult = Terminal_DebugRunThroughputBenchmark
+																				(BRIDGE_CAST([BRIDGE_CAST(aURL, NSURL*) lastPathComponent], CFStringRef),
+																					REINTERPRET_CAST(fileData.bytes, UInt8 const*),
+																					fileData.length, 10/* iterations; arbitrary */);
+										
+										
+										if (kTerminal_ResultOK != benchmarkResult)
+										{
+											Console_Warning(Console_WriteValue, "terminal benchmark failed, error", benchmarkResult);
+										}
+									}
+								});
+}// runTerminalThroughputBenchmark
+
+
+/*!
+Compares the per-call cost of validating and locking opaque
+references with hashed lock counts and with slots, logging
+results to the console.  See MemoryBlockSlotLocker_RunBenchmarks().
+
+(2023.10)
+*/
+- (void)
+runMemoryBlockLockerBenchmark
+{
+	MemoryBlockSlotLocker_RunBenchmarks();
+}// runMemoryBlockLockerBenchmark
+
+
+/*!
+Compares the speed of the per-byte and block-based UTF-8
+decoders on generated text, logging results to the console.
+See UTF8Decoder_RunBenchmarks().
+
+(2023.10)
+*/
+- (void)
+runUTF8DecoderBenchmark
+{
+	UTF8Decoder_RunBenchmarks();
+}// runUTF8DecoderBenchmark
+
+
+/*!
+Compares the speed of per-character and bulk UTF-8 encoding
+of generated text (as used when sending text to sessions),
+logging results to the console.  See UTF8Encoder_RunBenchmarks().
+
+(2023.10)
+*/
+- (void)
+runUTF8EncoderBenchmark
+{
+	UTF8Encoder_RunBenchmarks();
+}// runUTF8EncoderBenchmark
+
+
+/*!
+Measures how quickly generated Sixel images are sized and
+decoded, logging results to the console.  See
+SixelDecoder_RunBenchmarks().
+
+(2023.10)
+*/
+- (void)
+runSixelDecoderBenchmark
+{
+	SixelDecoder_RunBenchmarks();
+}// runSixelDecoderBenchmark
+
+
 /*!
 Displays a Cocoa-based terminal toolbar window.
 
@@ -220,6 +220,15 @@ any way required, e.g. saving state.
 */
 typedef void (^FindDialog_OnCloseBlock)	(FindDialog_Ref _Nonnull, FindDialog_Options);
 
+/*!
+Find Dialog Search Completion Method
+
+This is called on the main thread when every terminal that
+FindDialog_SearchWithoutDialog() started to search has been
+searched, with the total number of matches.
+*/
+typedef void (^FindDialog_SearchCompletionBlock)	(UInt32);
+
 
 
 #pragma mark Public Methods
@@ -233,10 +242,11 @@ FindDialog_Ref _Nullable
 void
 	FindDialog_Display				(FindDialog_Ref _Nonnull			inDialog);
 
-UInt32
+void
 	FindDialog_SearchWithoutDialog	(CFStringRef _Nullable				inQueryBaseOrNullToClear,
 									 TerminalWindowRef _Nonnull			inStartTerminalWindow,
 									 FindDialog_Options					inFlags,
-									 Boolean* _Nullable					outDidSearchOrNull = nullptr);
+									 Boolean* _Nullable					outDidSearchOrNull = nullptr,
+									 FindDialog_SearchCompletionBlock _Nullable		inCompletionBlockOrNull = nullptr);
 
 // BELOW IS REQUIRED NEWLINE TO END FILE
@@ -38,6 +38,7 @@
 #import <climits>
 
 // standard-C++ includes
+#import <atomic>
 #import <vector>
 
 // Mac includes
@@ -124,13 +125,14 @@ The private class interface.
 	clearSearchHighlightingInContext:(FindDialog_SearchContext)_;
 	- (void)
 	display;
-	- (UInt32)
+	- (void)
 	initiateSearchFor:(NSString*)_
 	regularExpression:(BOOL)_
 	ignoringCase:(BOOL)_
 	allTerminals:(BOOL)_
 	notFinal:(BOOL)_
-	didSearch:(BOOL*)_;
+	didSearch:(BOOL*)_
+	completion:(FindDialog_SearchCompletionBlock)_;
 	- (void)
 	removeWithAcceptance:(BOOL)_;
 	- (void)
@@ -164,6 +166,13 @@ typedef std::vector< Terminal_RangeDescription >	My_TerminalRangeList;
 
 } // anonymous namespace
 
+#pragma mark Variables
+namespace {
+
+std::atomic< UInt32 >	gSearchGeneration(0);	//!< incremented by every call to FindDialog_SearchWithoutDialog(),
+												//!  which stops any search from an earlier call
+} // anonymous namespace
+
 
 
 #pragma mark Public Methods
@@ -230,17 +239,25 @@ If the query string is nullptr, no search is performed and
 highlighting is cleared in the given context (one window or
 all windows).
 
-Returns the number of matches.
+Terminals are searched in the background (see the function
+Terminal_SearchInBackground()), so this returns before any
+matches are found; they are highlighted as they arrive.  A
+search that is still running from an earlier call stops,
+and none of its later matches are used.  When every terminal
+has been searched, the completion block (if any) is given
+the number of matches; it is not invoked if no search was
+done or if a later call replaced this one.
 
 (4.1)
 */
-UInt32
-FindDialog_SearchWithoutDialog		(CFStringRef			inQueryBaseOrNullToClear,
-									 TerminalWindowRef		inStartTerminalWindow,
-									 FindDialog_Options		inFlags,
-									 Boolean*				outDidSearchOrNull)
+void
+FindDialog_SearchWithoutDialog		(CFStringRef						inQueryBaseOrNullToClear,
+									 TerminalWindowRef					inStartTerminalWindow,
+									 FindDialog_Options					inFlags,
+									 Boolean*							outDidSearchOrNull,
+									 FindDialog_SearchCompletionBlock	inCompletionBlockOrNull)
 {
-	UInt32										result = 0;
+	UInt32 const								kGeneration = ++gSearchGeneration; // stops any earlier search
 	__block std::vector< TerminalWindowRef >	allWindowsList;
 	
 	
@@ -290,6 +307,8 @@ FindDialog_SearchWithoutDialog		(CFStringRef			inQueryBaseOrNullToClear,
 		NSString*									trimmedString = [asNSString stringByTrimmingCharactersInSet:whitespaceSet];
 		std::vector< TerminalWindowRef >			singleWindowList;
 		std::vector< TerminalWindowRef > const*		searchedWindows = &singleWindowList;
+		__block UInt32								matchCount = 0; // the count is global (if multi-terminal, reflects results from all terminals)
+		__block UInt32								pendingSearchCount = 0;
 		
 		
 		if (nullptr != outDidSearchOrNull)
@@ -343,14 +362,13 @@ FindDialog_SearchWithoutDialog		(CFStringRef			inQueryBaseOrNullToClear,
 		
 		for (auto terminalWindowRef : *searchedWindows)
 		{
-			TerminalViewRef			view = TerminalWindow_ReturnViewWithFocus(terminalWindowRef);
-			TerminalScreenRef		screen = TerminalWindow_ReturnScreenWithFocus(terminalWindowRef);
-			My_TerminalRangeList	searchResults;
-			Terminal_SearchFlags	flags = 0;
-			Terminal_Result			searchStatus = kTerminal_ResultOK;
+			TerminalScreenRef				screen = TerminalWindow_ReturnScreenWithFocus(terminalWindowRef);
+			__block UInt32					terminalMatchCount = 0;
+			Terminal_SearchFlags			flags = 0;
+			Terminal_Result					searchStatus = kTerminal_ResultOK;
 			
 			
-			// initiate synchronous (should be asynchronous!) search
+			// initiate asynchronous search
 			if ((nullptr != inQueryBaseOrNullToClear) && (searchQueryLength > 0))
 			{
 				// configure search
@@ -381,47 +399,87 @@ FindDialog_SearchWithoutDialog		(CFStringRef			inQueryBaseOrNullToClear,
 					}
 				}
 				
-				// initiate synchronous (should it be asynchronous?) search
-				searchStatus = Terminal_Search(screen, inQueryBaseOrNullToClear, flags, searchResults);
+				// initiate search; matches are highlighted batch by batch on the
+				// main queue while other threads search the rest of the buffer;
+				// if the user types again (or anything else starts a search),
+				// the generation changes and this search stops without
+				// checking for events
+				searchStatus = Terminal_SearchInBackground(screen, inQueryBaseOrNullToClear, flags,
+															^(My_TerminalRangeList const& inMatchBatch, Boolean& outStopSearch)
+															{
+																// batches arrive on the main queue as the search continues;
+																// a batch from a search that has been replaced (or from a
+																// window that has closed) is discarded
+																if ((kGeneration != gSearchGeneration) || (false == TerminalWindow_IsValid(terminalWindowRef)))
+																{
+																	outStopSearch = true;
+																}
+																else
+																{
+																	TerminalViewRef		view = TerminalWindow_ReturnViewWithFocus(terminalWindowRef);
+																	
+																	
+																	// highlight search results
+																	for (auto rangeDesc : inMatchBatch)
+																	{
+																		TerminalView_CellRange		highlightRange;
+																		TerminalView_Result			viewResult = kTerminalView_ResultOK;
+																		
+																		
+																		// translate this result range into cell anchors for highlighting
+																		viewResult = TerminalView_TranslateTerminalScreenRange(view, rangeDesc, highlightRange);
+																		if (kTerminalView_ResultOK == viewResult)
+																		{
+																			TerminalView_FindVirtualRange(view, highlightRange);
+																		}
+																	}
+																	
+																	// scroll to the first result
+																	if ((0 == terminalMatchCount) && (0 == (inFlags & kFindDialog_OptionDoNotScrollToMatch)))
+																	{
+																		// show the user where the text is; delay this slightly to avoid
+																		// animation interference caused by the closing of the popover
+																		CocoaExtensions_RunLater(0.1/* seconds */,
+																		^{
+																			if ((kGeneration == gSearchGeneration) && TerminalWindow_IsValid(terminalWindowRef))
+																			{
+																				TerminalView_ZoomToSearchResults(TerminalWindow_ReturnViewWithFocus(terminalWindowRef));
+																			}
+																		});
+																	}
+																	
+																	terminalMatchCount += STATIC_CAST(inMatchBatch.size(), UInt32);
+																}
+															},
+															^Boolean ()
+															{
+																return (kGeneration != gSearchGeneration);
+															},
+															^{
+																if (kGeneration == gSearchGeneration)
+																{
+																	matchCount += terminalMatchCount;
+																	--pendingSearchCount;
+																	if ((0 == pendingSearchCount) && (nullptr != inCompletionBlockOrNull))
+																	{
+																		inCompletionBlockOrNull(matchCount);
+																	}
+																}
+															});
 				if (kTerminal_ResultOK == searchStatus)
 				{
-					if (false == searchResults.empty())
-					{
-						// the count is global (if multi-terminal, reflects results from all terminals)
-						result += STATIC_CAST(searchResults.size(), UInt32);
-						
-						// highlight search results
-						for (auto rangeDesc : searchResults)
-						{
-							TerminalView_CellRange		highlightRange;
-							TerminalView_Result			viewResult = kTerminalView_ResultOK;
-							
-							
-							// translate this result range into cell anchors for highlighting
-							viewResult = TerminalView_TranslateTerminalScreenRange(view, rangeDesc, highlightRange);
-							if (kTerminalView_ResultOK == viewResult)
-							{
-								TerminalView_FindVirtualRange(view, highlightRange);
-							}
-						}
-						
-						// scroll to the first result
-						if (0 == (inFlags & kFindDialog_OptionDoNotScrollToMatch))
-						{
-							// show the user where the text is; delay this slightly to avoid
-							// animation interference caused by the closing of the popover
-							CocoaExtensions_RunLater(0.1/* seconds */,
-							^{
-								TerminalView_ZoomToSearchResults(TerminalWindow_ReturnViewWithFocus(terminalWindowRef));
-							});
-						}
-					}
+					++pendingSearchCount;
 				}
 			}
 		}
+		
+		// if no search could start (e.g. due to an invalid regular
+		// expression) then the number of matches is already known
+		if ((0 == pendingSearchCount) && (false == searchedWindows->empty()) && (nullptr != inCompletionBlockOrNull))
+		{
+			inCompletionBlockOrNull(0);
+		}
 	}
-	
-	return result;
 }// SearchWithoutDialog
 
 
@@ -508,15 +566,25 @@ didSearchInManagedView:(NSView*)	aManagedView
 withQuery:(NSString*)				searchText
 {
 #pragma unused(aManagedView)
-	BOOL		didSearch = NO;
-	UInt32		matchCount = [self initiateSearchFor:searchText
-														regularExpression:aViewMgr.regularExpressionSearch
-														ignoringCase:aViewMgr.caseInsensitiveSearch
-														allTerminals:aViewMgr.multiTerminalSearch
-														notFinal:YES didSearch:&didSearch];
+	BOOL	didSearch = NO;
 	
 	
-	[aViewMgr updateUserInterfaceWithMatches:matchCount didSearch:didSearch];
+	// the match count is only known once the search completes
+	// (and the completion is skipped if another search replaces it)
+	[self initiateSearchFor:searchText
+							regularExpression:aViewMgr.regularExpressionSearch
+							ignoringCase:aViewMgr.caseInsensitiveSearch
+							allTerminals:aViewMgr.multiTerminalSearch
+							notFinal:YES didSearch:&didSearch
+							completion:^(UInt32 inMatchCount)
+							{
+								[aViewMgr updateUserInterfaceWithMatches:inMatchCount didSearch:YES];
+							}];
+	
+	unless (didSearch)
+	{
+		[aViewMgr updateUserInterfaceWithMatches:0 didSearch:NO];
+	}
 }// findDialog:didSearchInManagedView:withQuery:
 
 
@@ -564,12 +632,13 @@ finalOptions:(FindDialog_Options)		options
 		BOOL	didSearch = NO;
 		
 		
-		UNUSED_RETURN(UInt32)[self initiateSearchFor:searchText
-														regularExpression:isRegEx
-														ignoringCase:caseInsensitive
-														allTerminals:multiTerminal
-														notFinal:NO
-														didSearch:&didSearch];
+		[self initiateSearchFor:searchText
+								regularExpression:isRegEx
+								ignoringCase:caseInsensitive
+								allTerminals:multiTerminal
+								notFinal:NO
+								didSearch:&didSearch
+								completion:nil];
 	}
 	else
 	{
@@ -580,12 +649,13 @@ finalOptions:(FindDialog_Options)		options
 			
 			
 			searchText = STATIC_CAST([recentSearchesArray objectAtIndex:0], NSString*);
-			UNUSED_RETURN(UInt32)[self initiateSearchFor:searchText
-															regularExpression:isRegEx
-															ignoringCase:caseInsensitive
-															allTerminals:NO
-															notFinal:NO
-															didSearch:&didSearch];
+			[self initiateSearchFor:searchText
+									regularExpression:isRegEx
+									ignoringCase:caseInsensitive
+									allTerminals:NO
+									notFinal:NO
+									didSearch:&didSearch
+									completion:nil];
 		}
 		else
 		{
@@ -757,7 +827,7 @@ clearSearchHighlightingInContext:(FindDialog_SearchContext)		aContext
 		flags |= kFindDialog_OptionAllOpenTerminals;
 	}
 	
-	UNUSED_RETURN(UInt32)FindDialog_SearchWithoutDialog(nullptr/* query */, self.terminalWindow, flags);
+	FindDialog_SearchWithoutDialog(nullptr/* query */, self.terminalWindow, flags);
 }// clearSearchHighlightingInContext:
 
 
@@ -788,8 +858,11 @@ display
 
 
 /*!
-Starts a (synchronous) search of the focused terminal screen.
-Returns the number of matches.
+Starts a background search of the focused terminal screen
+(or all terminals).  When the search is done, the completion
+block (if any) is given the number of matches; it is not
+invoked if no search was done or if another search replaced
+this one before it finished.
 
 If "regularExpression" is YES, the string is considered to be
 a regular expression instead of a literal string.  And if
@@ -813,20 +886,20 @@ occurred.
 
 (4.0)
 */
-- (UInt32)
-initiateSearchFor:(NSString*)	queryString
-regularExpression:(BOOL)		regularExpression
-ignoringCase:(BOOL)				ignoreCase
-allTerminals:(BOOL)				allTerminals
-notFinal:(BOOL)					isNotFinal
-didSearch:(BOOL*)				outDidSearch
+- (void)
+initiateSearchFor:(NSString*)						queryString
+regularExpression:(BOOL)							regularExpression
+ignoringCase:(BOOL)									ignoreCase
+allTerminals:(BOOL)									allTerminals
+notFinal:(BOOL)										isNotFinal
+didSearch:(BOOL*)									outDidSearch
+completion:(FindDialog_SearchCompletionBlock)		aBlock
 {
 	CFStringRef					searchQueryCFString = BRIDGE_CAST(queryString, CFStringRef);
 	CFIndex						searchQueryLength = 0;
 	FindDialog_SearchContext	searchContext = (YES == allTerminals)
 												? kFindDialog_SearchContextGlobal
 												: kFindDialog_SearchContextLocal;
-	UInt32						result = 0;
 	
 	
 	*outDidSearch = YES; // initially...
@@ -865,13 +938,11 @@ didSearch:(BOOL*)				outDidSearch
 			searchFlags |= kFindDialog_OptionAllOpenTerminals;
 		}
 		
-		result = FindDialog_SearchWithoutDialog(BRIDGE_CAST(queryString, CFStringRef),
-												self.terminalWindow, searchFlags, &didSearch);
+		FindDialog_SearchWithoutDialog(BRIDGE_CAST(queryString, CFStringRef),
+										self.terminalWindow, searchFlags, &didSearch, aBlock);
 		*outDidSearch = (true == didSearch);
 	}
-	
-	return result;
-}// initiateSearchFor:regularExpression:ignoringCase:allTerminals:notFinal:didSearch:
+}// initiateSearchFor:regularExpression:ignoringCase:allTerminals:notFinal:didSearch:completion:
 
 
 /*!
@@ -0,0 +1,223 @@
+/*!	\file ImageStore.h
+	\brief Process-wide storage for the images that terminal
+	cells display.
+	
+	Each distinct image (as identified by a SHA-256 digest of
+	the data it was created from) is stored once, no matter how many times
+	or in how many terminals it appears, and it is referred to
+	by a stable ImageStore_ImageID.  Terminal cells refer to
+	“segments” (cell-sized parts of an image) whose IDs fit in
+	the bitmap field of text attributes; a segment ID is never
+	reused while its image is still retained.
+	
+	The decoded pixels of images are kept in memory only up to
+	a limit; beyond that, the least recently used images are
+	released (if nothing retains them) or written to a cache
+	file, which is memory-mapped to draw them again later.
+	
+	All functions must be called from the main thread.
+*/
+/*###############################################################
+
+	MacTerm
+		© 1998-2023 by Kevin Grant.
+		© 2001-2003 by Ian Anderson.
+		© 1986-1994 University of Illinois Board of Trustees
+		(see About box for full list of U of I contributors).
+	
+	This program is free software; you can redistribute it or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version
+	2 of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be
+	useful, but WITHOUT ANY WARRANTY; without even the implied
+	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+	PURPOSE.  See the GNU General Public License for more
+	details.
+	
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to:
+	
+		Free Software Foundation, Inc.
+		59 Temple Place, Suite 330
+		Boston, MA  02111-1307
+		USA
+
+###############################################################*/
+
+#include <UniversalDefines.h>
+
+#pragma once
+
+// standard-C++ includes
+#include <algorithm>
+#include <array>
+
+// Mac includes
+#include <CommonCrypto/CommonDigest.h>
+#include <CoreGraphics/CoreGraphics.h>
+#ifdef __OBJC__
+@class NSImage;
+#else
+class NSImage;
+#endif
+
+// application includes
+#include "TextAttributes.h"
+
+
+
+#pragma mark Constants
+
+typedef UInt32 ImageStore_ImageID; //!< identifies an image; IDs are never reused
+
+enum
+{
+	kImageStore_InvalidImageID		= 0		//!< never refers to an image
+};
+
+#pragma mark Types
+
+/*!
+Identifies the content of an image, so that an image that
+is sent again (such as a frame of a progress animation) can
+be found instead of being stored again.  Typically, the
+bytes that an image is decoded from are given to
+appendBytes() as they arrive.
+
+A cryptographic digest is used because the data comes from
+programs running in the terminal, which could otherwise
+craft different images with the same key to replace what
+another image displays.
+*/
+struct ImageStore_ContentKey
+{
+	typedef std::array< UInt8, CC_SHA256_DIGEST_LENGTH >	Digest;
+	
+	ImageStore_ContentKey ()
+	{
+		UNUSED_RETURN(int)CC_SHA256_Init(&hashState);
+	}
+	
+	CC_SHA256_CTX	hashState;		//!< SHA-256 of all bytes so far, before finalization (see returnDigest())
+	UInt64			byteCount = 0;	//!< number of bytes that have been hashed
+	
+	//! Updates the key with the given bytes.
+	inline void
+	appendBytes		(void const*, size_t);
+	
+	//! Returns the SHA-256 digest of all bytes so far; more
+	//! bytes may still be appended afterwards.
+	inline Digest
+	returnDigest () const;
+};
+
+
+
+#pragma mark Public Methods
+
+//!\name Module Tests
+//@{
+
+void
+	ImageStore_RunTests					();
+
+//@}
+
+//!\name Storing Images
+//@{
+
+ImageStore_ImageID
+	ImageStore_AddImage					(NSImage*						inImage,
+										 ImageStore_ContentKey const&	inContentKey);
+
+ImageStore_ImageID
+	ImageStore_FindImage				(ImageStore_ContentKey const&	inContentKey);
+
+void
+	ImageStore_ImageChanged				(ImageStore_ImageID				inID);
+
+void
+	ImageStore_ReleaseImage				(ImageStore_ImageID				inID);
+
+void
+	ImageStore_RetainImage				(ImageStore_ImageID				inID);
+
+void
+	ImageStore_SetMemoryLimit			(size_t							inByteCount);
+
+//@}
+
+//!\name Accessing Images
+//@{
+
+NSImage*
+	ImageStore_ReturnImage				(ImageStore_ImageID				inID);
+
+//@}
+
+//!\name Terminal Cell Segments
+//@{
+
+Boolean
+	ImageStore_DefineSegment			(ImageStore_ImageID				inID,
+										 CGRect							inSubRect,
+										 TextAttributes_BitmapID&		outSegmentID);
+
+Boolean
+	ImageStore_GetSegment				(TextAttributes_BitmapID		inSegmentID,
+										 ImageStore_ImageID&			outImageID,
+										 CGRect&						outSubRect);
+
+//@}
+
+
+
+#pragma mark Inline Methods
+
+/*!
+Updates the hash with the given bytes.
+
+(2023.10)
+*/
+inline void
+ImageStore_ContentKey::appendBytes	(void const*	inBytes,
+									 size_t			inByteCount)
+{
+	UInt8 const*	bytePtr = REINTERPRET_CAST(inBytes, UInt8 const*);
+	size_t			bytesLeft = inByteCount;
+	
+	
+	// the length given to CommonCrypto is only 32 bits wide
+	while (bytesLeft > 0)
+	{
+		CC_LONG const	kPieceSize = STATIC_CAST(std::min< size_t >(bytesLeft, 0x40000000), CC_LONG);
+		
+		
+		UNUSED_RETURN(int)CC_SHA256_Update(&hashState, bytePtr, kPieceSize);
+		bytePtr += kPieceSize;
+		bytesLeft -= kPieceSize;
+	}
+	byteCount += inByteCount;
+}// ImageStore_ContentKey::appendBytes
+
+
+/*!
+Finalizes a copy of the hash state, so that the key itself
+can still be updated.
+
+(2023.10)
+*/
+inline ImageStore_ContentKey::Digest
+ImageStore_ContentKey::returnDigest () const
+{
+	CC_SHA256_CTX	finalState = hashState;
+	Digest			result;
+	
+	
+	UNUSED_RETURN(int)CC_SHA256_Final(result.data(), &finalState);
+	return result;
+}// ImageStore_ContentKey::returnDigest
+
+// BELOW IS REQUIRED NEWLINE TO END FILE
@@ -0,0 +1,1018 @@
+/*!	\file ImageStore.mm
+	\brief Process-wide storage for the images that terminal
+	cells display.
+*/
+/*###############################################################
+
+	MacTerm
+		© 1998-2023 by Kevin Grant.
+		© 2001-2003 by Ian Anderson.
+		© 1986-1994 University of Illinois Board of Trustees
+		(see About box for full list of U of I contributors).
+	
+	This program is free software; you can redistribute it or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version
+	2 of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be
+	useful, but WITHOUT ANY WARRANTY; without even the implied
+	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+	PURPOSE.  See the GNU General Public License for more
+	details.
+	
+	You should have received a copy of the GNU General Public
+	License along with this program; if not, write to:
+	
+		Free Software Foundation, Inc.
+		59 Temple Place, Suite 330
+		Boston, MA  02111-1307
+		USA
+
+###############################################################*/
+
+#import "ImageStore.h"
+#import <UniversalDefines.h>
+
+// standard-C includes
+#import <cstring>
+
+// standard-C++ includes
+#import <atomic>
+#import <iterator>
+#import <list>
+#import <map>
+#import <tuple>
+#import <unordered_map>
+#import <vector>
+
+// UNIX includes
+extern "C"
+{
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <unistd.h>
+}
+
+// Mac includes
+@import Cocoa;
+
+// library includes
+#import <Console.h>
+
+
+
+#pragma mark Constants
+namespace {
+
+size_t const	kMy_DefaultMemoryLimit = 256 * 1024 * 1024;	//!< bytes of decoded pixels to keep in memory
+
+} // anonymous namespace
+
+#pragma mark Types
+namespace {
+
+typedef std::list< ImageStore_ImageID >		My_ImageIDList;
+
+/*!
+Where the pixels of an image are in the cache file, once
+they have been written there.  The byte count is zero for
+images that have never been written.
+*/
+struct My_CachedPixels
+{
+	off_t		fileOffset = 0;		//!< start of the pixels in the cache file (a multiple of the page size)
+	size_t		byteCount = 0;		//!< size of the pixels in the cache file
+	size_t		bytesPerRow = 0;	//!< size of each row of pixels (4 bytes per pixel)
+	size_t		pixelsWide = 0;		//!< width of the image in pixels
+	size_t		pixelsHigh = 0;		//!< height of the image in pixels
+};
+
+typedef std::tuple< CGFloat, CGFloat, CGFloat, CGFloat >			My_RectKey;		//!< origin and size of a segment
+typedef std::map< My_RectKey, TextAttributes_BitmapID >			My_SegmentIDByRect;
+
+/*!
+An image and everything that refers to it.
+*/
+struct My_ImageEntry
+{
+	ImageStore_ContentKey::Digest	contentDigest;	//!< identifies the data that the image came from
+	NSImage* __strong			image = nil;		//!< the image, if its pixels are in memory
+	NSSize						imageSize = NSZeroSize;	//!< size of "image" (kept when the image is only in the cache file)
+	size_t						residentByteCount = 0;	//!< estimated size of the decoded pixels of "image", if any
+	UInt32						retainCount = 0;	//!< number of references to this image (it is discarded at zero)
+	My_ImageIDList::iterator	recentUse;			//!< position in the list that orders images by use
+	My_SegmentIDByRect			segmentIDs;			//!< every segment defined for this image
+	My_CachedPixels				cachedPixels;		//!< location of the pixels in the cache file, if any
+};
+
+/*!
+One cell-sized part of an image, indexed by segment ID;
+the image ID is kImageStore_InvalidImageID for unused IDs.
+*/
+struct My_Segment
+{
+	ImageStore_ImageID		imageID = kImageStore_InvalidImageID;	//!< the image that this is part of
+	CGRect					subRect = CGRectZero;					//!< the part of the image to draw
+};
+
+typedef std::unordered_map< ImageStore_ImageID, My_ImageEntry >		My_ImageEntryByID;
+typedef std::map< ImageStore_ContentKey::Digest, ImageStore_ImageID >	My_ImageIDByContent;
+typedef std::vector< My_Segment >									My_SegmentList;
+typedef std::vector< TextAttributes_BitmapID >						My_SegmentIDList;
+
+} // anonymous namespace
+
+#pragma mark Internal Method Prototypes
+namespace {
+
+Boolean			cacheImagePixels				(My_ImageEntry&);
+size_t			calculateResidentByteCount		(NSImage*);
+void			enforceMemoryLimit				();
+My_ImageEntry*	findImageEntry					(ImageStore_ImageID);
+Boolean			openCacheFile					();
+void			releaseMappedPixels				(void*, void const*, size_t);
+void			removeImageEntry				(ImageStore_ImageID);
+NSImage*		returnNewImageFromCache			(My_ImageEntry const&);
+NSImage*		returnNewTestImage				(UInt8);
+void			truncateCacheFileIfUnused		();
+Boolean			unitTest_Cache_000				();
+Boolean			unitTest_Content_000			();
+
+} // anonymous namespace
+
+#pragma mark Variables
+namespace {
+
+int							gCacheFileDescriptor = -1;						//!< file for pixels that are not in memory; see openCacheFile()
+off_t						gCacheFileEnd = 0;								//!< where the next pixels are written to the cache file
+size_t						gCachedImageCount = 0;							//!< number of images with pixels in the cache file
+std::atomic< size_t >		gMappedPixelsCount(0);							//!< number of mappings of the cache file that are still in use by
+																			//!  images (which may outlive their entries); see releaseMappedPixels()
+ImageStore_ImageID			gNextImageID = 1;								//!< IDs are never reused
+TextAttributes_BitmapID		gNextSegmentID = 1;								//!< the first segment ID that has never been used
+size_t						gMemoryLimit = kMy_DefaultMemoryLimit;			//!< see ImageStore_SetMemoryLimit()
+size_t						gResidentByteCount = 0;							//!< sum of the sizes of all images in memory
+My_ImageEntryByID&			gImageEntries ()		{ static My_ImageEntryByID x; return x; }
+My_ImageIDByContent&		gImageIDsByContent ()	{ static My_ImageIDByContent x; return x; }
+My_ImageIDList&				gImagesByRecentUse ()	{ static My_ImageIDList x; return x; } // most recent first
+My_SegmentList&				gSegments ()			{ static My_SegmentList x; return x; }
+My_SegmentIDList&			gFreeSegmentIDs ()		{ static My_SegmentIDList x; return x; }
+
+} // anonymous namespace
+
+
+
+#pragma mark Public Methods
+
+/*!
+A unit test for this module.  This should always be run
+before a release, after any substantial changes are made,
+or if you suspect bugs!  It should also be EXPANDED as
+new functionality is proposed (ideally, a test is written
+before the functionality is added).
+
+(2023.10)
+*/
+void
+ImageStore_RunTests ()
+{
+	UInt16		totalTests = 0;
+	UInt16		failedTests = 0;
+	
+	
+	++totalTests; if (false == unitTest_Content_000()) ++failedTests;
+	++totalTests; if (false == unitTest_Cache_000()) ++failedTests;
+	
+	Console_WriteUnitTestReport("Image Store", failedTests, totalTests);
+}// RunTests
+
+
+/*!
+Stores the given image, which was created from data that
+is described by the given key, and returns its ID.  If an
+image with the same content is already stored, the given
+image is ignored and the ID of the existing image is
+returned instead (so it is not necessary to create an
+image first; see ImageStore_FindImage()).
+
+The image is retained on behalf of the caller, who must
+eventually call ImageStore_ReleaseImage().
+
+The image may be empty and have representations added later
+(for instance, by a decoder that is still running) as long
+as ImageStore_ImageChanged() is called afterwards.
+
+(2023.10)
+*/
+ImageStore_ImageID
+ImageStore_AddImage		(NSImage*						inImage,
+						 ImageStore_ContentKey const&	inContentKey)
+{
+	ImageStore_ImageID	result = ImageStore_FindImage(inContentKey);
+	
+	
+	if ((kImageStore_InvalidImageID == result) && (nil != inImage))
+	{
+		result = gNextImageID++;
+		
+		My_ImageEntry&		newEntry = gImageEntries()[result];
+		
+		
+		newEntry.contentDigest = inContentKey.returnDigest();
+		newEntry.image = inImage;
+		newEntry.imageSize = inImage.size;
+		newEntry.residentByteCount = calculateResidentByteCount(inImage);
+		newEntry.retainCount = 1;
+		gImagesByRecentUse().push_front(result);
+		newEntry.recentUse = gImagesByRecentUse().begin();
+		gImageIDsByContent()[newEntry.contentDigest] = result;
+		gResidentByteCount += newEntry.residentByteCount;
+		
+		enforceMemoryLimit();
+	}
+	
+	return result;
+}// AddImage
+
+
+/*!
+Returns the ID of the stored image that was created from
+data described by the given key, or kImageStore_InvalidImageID
+if there is no such image.  A valid image is retained on
+behalf of the caller, who must eventually call
+ImageStore_ReleaseImage().
+
+Since an image is not discarded as soon as it is released
+(as long as there is room in memory) a repeated image is
+often found even if nothing is displaying it anymore.
+
+(2023.10)
+*/
+ImageStore_ImageID
+ImageStore_FindImage	(ImageStore_ContentKey const&	inContentKey)
+{
+	ImageStore_ImageID	result = kImageStore_InvalidImageID;
+	auto				toPair = gImageIDsByContent().find(inContentKey.returnDigest());
+	
+	
+	if (gImageIDsByContent().end() != toPair)
+	{
+		result = toPair->second;
+		ImageStore_RetainImage(result);
+	}
+	
+	return result;
+}// FindImage
+
+
+/*!
+Updates the memory used by the given image, after changes
+such as adding a representation to it.  If the store is
+now over its memory limit, other images may be written to
+the cache file or discarded.
+
+(2023.10)
+*/
+void
+ImageStore_ImageChanged		(ImageStore_ImageID		inID)
+{
+	My_ImageEntry*		entryPtr = findImageEntry(inID);
+	
+	
+	if ((nullptr != entryPtr) && (nil != entryPtr->image))
+	{
+		gResidentByteCount -= entryPtr->residentByteCount;
+		entryPtr->residentByteCount = calculateResidentByteCount(entryPtr->image);
+		gResidentByteCount += entryPtr->residentByteCount;
+		
+		enforceMemoryLimit();
+	}
+}// ImageChanged
+
+
+/*!
+Releases one reference to the given image.  An image that
+is no longer retained stays in memory (so that it can still
+be found by ImageStore_FindImage()) until memory is needed,
+unless its pixels are not in memory; then it is discarded
+at once, along with all of its segments.
+
+(2023.10)
+*/
+void
+ImageStore_ReleaseImage		(ImageStore_ImageID		inID)
+{
+	My_ImageEntry*		entryPtr = findImageEntry(inID);
+	
+	
+	if (nullptr == entryPtr)
+	{
+		Console_Warning(Console_WriteValue, "attempt to release unknown image ID", inID);
+	}
+	else if (0 == entryPtr->retainCount)
+	{
+		Console_Warning(Console_WriteValue, "attempt to over-release image ID", inID);
+	}
+	else
+	{
+		--(entryPtr->retainCount);
+		if ((0 == entryPtr->retainCount) && (0 == entryPtr->residentByteCount))
+		{
+			removeImageEntry(inID);
+		}
+	}
+}// ReleaseImage
+
+
+/*!
+Adds one reference to the given image, which must be
+balanced by a call to ImageStore_ReleaseImage().
+
+(2023.10)
+*/
+void
+ImageStore_RetainImage		(ImageStore_ImageID		inID)
+{
+	My_ImageEntry*		entryPtr = findImageEntry(inID);
+	
+	
+	if (nullptr == entryPtr)
+	{
+		Console_Warning(Console_WriteValue, "attempt to retain unknown image ID", inID);
+	}
+	else
+	{
+		++(entryPtr->retainCount);
+	}
+}// RetainImage
+
+
+/*!
+Returns the image with the given ID, or nil if the ID is
+not valid.  If the pixels of the image are only in the
+cache file, a new image is created from the mapped file
+(which may cause other images to leave memory).
+
+The image is marked as the most recently used one, since
+this is normally called to draw it.
+
+(2023.10)
+*/
+NSImage*
+ImageStore_ReturnImage	(ImageStore_ImageID		inID)
+{
+	NSImage*			result = nil;
+	My_ImageEntry*		entryPtr = findImageEntry(inID);
+	
+	
+	if (nullptr != entryPtr)
+	{
+		gImagesByRecentUse().splice(gImagesByRecentUse().begin(), gImagesByRecentUse(), entryPtr->recentUse);
+		
+		if ((nil == entryPtr->image) && (0 != entryPtr->cachedPixels.byteCount))
+		{
+			entryPtr->image = returnNewImageFromCache(*entryPtr);
+			if (nil != entryPtr->image)
+			{
+				entryPtr->residentByteCount = calculateResidentByteCount(entryPtr->image);
+				gResidentByteCount += entryPtr->residentByteCount;
+				enforceMemoryLimit();
+			}
+		}
+		result = entryPtr->image;
+	}
+	
+	return result;
+}// ReturnImage
+
+
+/*!
+Finds or creates a segment for the given part of an image
+(a rectangle in image coordinates) and returns its ID in
+"outSegmentID".  Segments are shared, so an image that is
+displayed many times at the same cell size uses the same
+segment IDs every time.
+
+Returns false if the image is not valid or if every
+possible segment ID is in use by a retained image.
+
+(2023.10)
+*/
+Boolean
+ImageStore_DefineSegment	(ImageStore_ImageID			inID,
+							 CGRect						inSubRect,
+							 TextAttributes_BitmapID&	outSegmentID)
+{
+	Boolean				result = false;
+	My_ImageEntry*		entryPtr = findImageEntry(inID);
+	
+	
+	if (nullptr != entryPtr)
+	{
+		My_RectKey const	kRectKey = std::make_tuple(inSubRect.origin.x, inSubRect.origin.y,
+														inSubRect.size.width, inSubRect.size.height);
+		auto				toPair = entryPtr->segmentIDs.find(kRectKey);
+		
+		
+		if (entryPtr->segmentIDs.end() != toPair)
+		{
+			outSegmentID = toPair->second;
+			result = true;
+		}
+		else
+		{
+			// define new ID within range of allowed IDs; IDs are only
+			// reused after the images that had them are discarded
+			if (false == gFreeSegmentIDs().empty())
+			{
+				outSegmentID = gFreeSegmentIDs().back();
+				gFreeSegmentIDs().pop_back();
+				result = true;
+			}
+			else if (gNextSegmentID <= kTextAttributes_BitmapIDMaximum)
+			{
+				outSegmentID = gNextSegmentID++;
+				result = true;
+			}
+			
+			if (result)
+			{
+				if (outSegmentID >= gSegments().size())
+				{
+					gSegments().resize(outSegmentID + 1);
+				}
+				gSegments()[outSegmentID].imageID = inID;
+				gSegments()[outSegmentID].subRect = inSubRect;
+				entryPtr->segmentIDs[kRectKey] = outSegmentID;
+			}
+		}
+	}
+	
+	return result;
+}// DefineSegment
+
+
+/*!
+Returns the image and the part of it (in image coordinates)
+that the given segment refers to.  Returns false if the ID
+is not in use.
+
+(2023.10)
+*/
+Boolean
+ImageStore_GetSegment	(TextAttributes_BitmapID	inSegmentID,
+						 ImageStore_ImageID&		outImageID,
+						 CGRect&					outSubRect)
+{
+	Boolean		result = false;
+	
+	
+	outImageID = kImageStore_InvalidImageID; // initially...
+	outSubRect = CGRectZero; // initially...
+	if (inSegmentID < gSegments().size())
+	{
+		My_Segment const&	segment = gSegments()[inSegmentID];
+		
+		
+		if (kImageStore_InvalidImageID != segment.imageID)
+		{
+			outImageID = segment.imageID;
+			outSubRect = segment.subRect;
+			result = true;
+		}
+	}
+	
+	return result;
+}// GetSegment
+
+
+/*!
+Changes the number of bytes of decoded pixels that may be
+kept in memory before the least recently used images are
+discarded or written to the cache file.  The most recently
+used image always stays in memory, even if it is larger
+than the limit.
+
+(2023.10)
+*/
+void
+ImageStore_SetMemoryLimit	(size_t		inByteCount)
+{
+	gMemoryLimit = inByteCount;
+	enforceMemoryLimit();
+}// SetMemoryLimit
+
+
+#pragma mark Internal Methods
+namespace {
+
+/*!
+Writes the pixels of the given image to the end of the
+cache file and discards the image from memory.  Pixels that
+were written before are not written again.  Returns false
+(and changes nothing) if the image has no pixels yet or if
+the file cannot be written.
+
+(2023.10)
+*/
+Boolean
+cacheImagePixels	(My_ImageEntry&		inoutEntry)
+{
+	Boolean		result = false;
+	
+	
+	if (0 != inoutEntry.cachedPixels.byteCount)
+	{
+		// pixels are already in the file
+		result = true;
+	}
+	else if ((0 != inoutEntry.residentByteCount) && openCacheFile())
+	{
+		CGImageRef		image = [inoutEntry.image CGImageForProposedRect:nullptr context:nil hints:nil];
+		
+		
+		if (nullptr != image)
+		{
+			size_t const			kPixelsWide = CGImageGetWidth(image);
+			size_t const			kPixelsHigh = CGImageGetHeight(image);
+			size_t const			kBytesPerRow = (kPixelsWide * 4);
+			size_t const			kPageSize = STATIC_CAST(getpagesize(), size_t);
+			off_t const				kFileOffset = STATIC_CAST((gCacheFileEnd + kPageSize - 1) / kPageSize * kPageSize, off_t);
+			std::vector< UInt8 >	pixels(kBytesPerRow * kPixelsHigh);
+			CGColorSpaceRef			colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+			CGContextRef			drawingContext = CGBitmapContextCreate(pixels.data(), kPixelsWide, kPixelsHigh, 8/* bits per component */,
+																			kBytesPerRow, colorSpace, STATIC_CAST(kCGImageAlphaPremultipliedLast, uint32_t));
+			
+			
+			CGColorSpaceRelease(colorSpace), colorSpace = nullptr;
+			if ((nullptr != drawingContext) && (false == pixels.empty()))
+			{
+				CGContextDrawImage(drawingContext, CGRectMake(0, 0, kPixelsWide, kPixelsHigh), image);
+				if (STATIC_CAST(pixels.size(), ssize_t) != pwrite(gCacheFileDescriptor, pixels.data(), pixels.size(), kFileOffset))
+				{
+					Console_Warning(Console_WriteValue, "failed to write image to cache file; errno", errno);
+				}
+				else
+				{
+					inoutEntry.cachedPixels.fileOffset = kFileOffset;
+					inoutEntry.cachedPixels.byteCount = pixels.size();
+					inoutEntry.cachedPixels.bytesPerRow = kBytesPerRow;
+					inoutEntry.cachedPixels.pixelsWide = kPixelsWide;
+					inoutEntry.cachedPixels.pixelsHigh = kPixelsHigh;
+					gCacheFileEnd = STATIC_CAST(kFileOffset + pixels.size(), off_t);
+					++gCachedImageCount;
+					result = true;
+				}
+			}
+			if (nullptr != drawingContext)
+			{
+				CGContextRelease(drawingContext), drawingContext = nullptr;
+			}
+		}
+	}
+	
+	if (result)
+	{
+		gResidentByteCount -= inoutEntry.residentByteCount;
+		inoutEntry.residentByteCount = 0;
+		inoutEntry.image = nil;
+	}
+	
+	return result;
+}// cacheImagePixels
+
+
+/*!
+Returns an estimate of the number of bytes used by the
+decoded pixels of the given image (4 bytes per pixel of
+each representation).  Returns 0 for an image that has no
+representations, such as one that is still being decoded.
+
+(2023.10)
+*/
+size_t
+calculateResidentByteCount	(NSImage*	inImage)
+{
+	size_t		result = 0;
+	
+	
+	for (NSImageRep* rep in inImage.representations)
+	{
+		result += (STATIC_CAST(rep.pixelsWide, size_t) * STATIC_CAST(rep.pixelsHigh, size_t) * 4);
+	}
+	
+	return result;
+}// calculateResidentByteCount
+
+
+/*!
+Removes images from memory, least recently used first,
+until the total size is within the limit.  Images that are
+not retained are discarded; others have their pixels
+written to the cache file.
+
+(2023.10)
+*/
+void
+enforceMemoryLimit ()
+{
+	if ((gResidentByteCount > gMemoryLimit) && (gImagesByRecentUse().size() > 1))
+	{
+		// copy the IDs, since the list changes as images are removed;
+		// the most recently used image is never removed
+		std::vector< ImageStore_ImageID >	oldestFirst(gImagesByRecentUse().rbegin(), std::prev(gImagesByRecentUse().rend()));
+		
+		
+		for (ImageStore_ImageID imageID : oldestFirst)
+		{
+			My_ImageEntry*		entryPtr = findImageEntry(imageID);
+			
+			
+			if (gResidentByteCount <= gMemoryLimit)
+			{
+				break;
+			}
+			else if (0 == entryPtr->retainCount)
+			{
+				removeImageEntry(imageID);
+			}
+			else if (0 != entryPtr->residentByteCount)
+			{
+				UNUSED_RETURN(Boolean)cacheImagePixels(*entryPtr);
+			}
+		}
+	}
+}// enforceMemoryLimit
+
+
+/*!
+Returns the entry for the given image ID, or nullptr if the
+ID is not valid.
+
+(2023.10)
+*/
+My_ImageEntry*
+findImageEntry		(ImageStore_ImageID		inID)
+{
+	My_ImageEntry*		result = nullptr;
+	auto				toPair = gImageEntries().find(inID);
+	
+	
+	if (gImageEntries().end() != toPair)
+	{
+		result = &(toPair->second);
+	}
+	
+	return result;
+}// findImageEntry
+
+
+/*!
+Creates the cache file if it is not open yet, and returns
+true only if it is open.  The file is removed from the file
+system right away so that it is never left behind; it is
+only accessible through the open file descriptor.
+
+(2023.10)
+*/
+Boolean
+openCacheFile ()
+{
+	if (gCacheFileDescriptor < 0)
+	{
+		NSString*	templatePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"MacTermImageCache.XXXXXX"];
+		char*		pathBuffer = strdup(templatePath.fileSystemRepresentation);
+		
+		
+		if (nullptr != pathBuffer)
+		{
+			gCacheFileDescriptor = mkstemp(pathBuffer);
+			if (gCacheFileDescriptor < 0)
+			{
+				Console_Warning(Console_WriteValue, "failed to create image cache file; errno", errno);
+			}
+			else
+			{
+				UNUSED_RETURN(int)unlink(pathBuffer);
+				gCacheFileEnd = 0;
+			}
+			free(pathBuffer), pathBuffer = nullptr;
+		}
+	}
+	
+	return (gCacheFileDescriptor >= 0);
+}// openCacheFile
+
+
+/*!
+A standard "CGDataProviderReleaseDataCallback" that unmaps
+the pixels given to an image by returnNewImageFromCache().
+
+This may be called on any thread (for instance, by drawing
+that finishes in the background) so if this was the last
+mapping, the cache file is emptied later, on the main queue.
+
+(2023.10)
+*/
+void
+releaseMappedPixels		(void*			UNUSED_ARGUMENT(inInfo),
+						 void const*	inData,
+						 size_t			inSize)
+{
+	UNUSED_RETURN(int)munmap(CONST_CAST(inData, void*), inSize);
+	if (1 == gMappedPixelsCount--)
+	{
+		dispatch_async(dispatch_get_main_queue(),
+		^{
+			truncateCacheFileIfUnused();
+		});
+	}
+}// releaseMappedPixels
+
+
+/*!
+Discards the given image and all of its segments, freeing
+the segment IDs for reuse.  If no other image still has
+pixels in the cache file, the file is emptied (once no
+mapping of it is in use; see truncateCacheFileIfUnused()).
+
+(2023.10)
+*/
+void
+removeImageEntry	(ImageStore_ImageID		inID)
+{
+	auto	toPair = gImageEntries().find(inID);
+	
+	
+	if (gImageEntries().end() != toPair)
+	{
+		My_ImageEntry&		entry = toPair->second;
+		
+		
+		for (auto const& rectAndSegmentID : entry.segmentIDs)
+		{
+			gSegments()[rectAndSegmentID.second] = My_Segment();
+			gFreeSegmentIDs().push_back(rectAndSegmentID.second);
+		}
+		
+		if (0 != entry.cachedPixels.byteCount)
+		{
+			--gCachedImageCount;
+			truncateCacheFileIfUnused();
+		}
+		
+		gResidentByteCount -= entry.residentByteCount;
+		gImagesByRecentUse().erase(entry.recentUse);
+		gImageIDsByContent().erase(entry.contentDigest);
+		gImageEntries().erase(toPair);
+	}
+}// removeImageEntry
+
+
+/*!
+Creates an image from pixels that are in the cache file,
+by mapping the file into memory; or, returns nil if the
+pixels cannot be mapped.
+
+(2023.10)
+*/
+NSImage*
+returnNewImageFromCache		(My_ImageEntry const&	inEntry)
+{
+	NSImage*			result = nil;
+	My_CachedPixels const&	kPixels = inEntry.cachedPixels;
+	void*				mappedPixels = mmap(nullptr, kPixels.byteCount, PROT_READ, MAP_PRIVATE,
+											gCacheFileDescriptor, kPixels.fileOffset);
+	
+	
+	if (MAP_FAILED == mappedPixels)
+	{
+		Console_Warning(Console_WriteValue, "failed to map image from cache file; errno", errno);
+	}
+	else
+	{
+		// the mapping is counted until the image no longer needs it
+		// (see releaseMappedPixels()), since the file must not be
+		// truncated while pages of it may still be read
+		++gMappedPixelsCount;
+		
+		CGDataProviderRef	dataProvider = CGDataProviderCreateWithData(nullptr/* info */, mappedPixels, kPixels.byteCount,
+																		releaseMappedPixels);
+		CGColorSpaceRef		colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+		CGImageRef			image = CGImageCreate(kPixels.pixelsWide, kPixels.pixelsHigh, 8/* bits per component */, 32/* bits per pixel */,
+													kPixels.bytesPerRow, colorSpace, STATIC_CAST(kCGImageAlphaPremultipliedLast, uint32_t), dataProvider,
+													nullptr/* decode array */, false/* interpolate */, kCGRenderingIntentDefault);
+		
+		
+		CGDataProviderRelease(dataProvider), dataProvider = nullptr;
+		CGColorSpaceRelease(colorSpace), colorSpace = nullptr;
+		if (nullptr != image)
+		{
+			result = [[NSImage alloc] initWithSize:inEntry.imageSize];
+			[result addRepresentation:[[NSBitmapImageRep alloc] initWithCGImage:image]];
+			CGImageRelease(image), image = nullptr;
+		}
+	}
+	
+	return result;
+}// returnNewImageFromCache
+
+
+/*!
+For tests; returns a new 4×4 image whose pixels all have
+the given value in every color component.
+
+(2023.10)
+*/
+NSImage*
+returnNewTestImage		(UInt8		inComponentValue)
+{
+	NSImage*			result = [[NSImage alloc] initWithSize:NSMakeSize(4, 4)];
+	NSBitmapImageRep*	bitmap = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nullptr pixelsWide:4 pixelsHigh:4
+																		bitsPerSample:8 samplesPerPixel:4 hasAlpha:YES isPlanar:NO
+																		colorSpaceName:NSDeviceRGBColorSpace bytesPerRow:16 bitsPerPixel:32];
+	
+	
+	std::memset(bitmap.bitmapData, inComponentValue, 16 * 4);
+	[result addRepresentation:bitmap];
+	
+	return result;
+}// returnNewTestImage
+
+
+/*!
+Empties the cache file if no image has pixels in it and no
+mapping of it is in use.  An image that was created from the
+file (see returnNewImageFromCache()) can outlive its entry,
+since anything drawing it may still hold it; truncating the
+file under its mapping would crash that image’s next read.
+
+(2023.10)
+*/
+void
+truncateCacheFileIfUnused ()
+{
+	if ((0 == gCachedImageCount) && (0 == gMappedPixelsCount) && (gCacheFileDescriptor >= 0))
+	{
+		UNUSED_RETURN(int)ftruncate(gCacheFileDescriptor, 0);
+		gCacheFileEnd = 0;
+	}
+}// truncateCacheFileIfUnused
+
+
+/*!
+Tests writing images to the cache file and reading them
+back.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_Cache_000 ()
+{
+	Boolean					result = true;
+	ImageStore_ContentKey	keyA;
+	ImageStore_ContentKey	keyB;
+	ImageStore_ImageID		firstID = kImageStore_InvalidImageID;
+	ImageStore_ImageID		secondID = kImageStore_InvalidImageID;
+	NSImage*				reloadedImage = nil;
+	
+	
+	keyA.appendBytes("cached image A", 14);
+	keyB.appendBytes("cached image B", 14);
+	
+	// with no room in memory, the older retained image goes to the file
+	ImageStore_SetMemoryLimit(0);
+	firstID = ImageStore_AddImage(returnNewTestImage(0xFF), keyA);
+	secondID = ImageStore_AddImage(returnNewTestImage(0x80), keyB);
+	Console_TestAssertUpdate(result, nil == findImageEntry(firstID)->image, Console_WriteLine, "older image leaves memory");
+	Console_TestAssertUpdate(result, 0 != findImageEntry(firstID)->cachedPixels.byteCount, Console_WriteLine, "older image is in cache file");
+	Console_TestAssertUpdate(result, nil != findImageEntry(secondID)->image, Console_WriteLine, "newer image stays in memory");
+	
+	// using the older image brings it back (and sends the other one out)
+	reloadedImage = ImageStore_ReturnImage(firstID);
+	Console_TestAssertUpdate(result, nil != reloadedImage, Console_WriteLine, "cached image is reloaded");
+	Console_TestAssertUpdate(result, NSEqualSizes(reloadedImage.size, NSMakeSize(4, 4)), Console_WriteLine, "reloaded image has same size");
+	Console_TestAssertUpdate(result, nil == findImageEntry(secondID)->image, Console_WriteLine, "other image leaves memory");
+	if (nil != reloadedImage)
+	{
+		NSBitmapImageRep*	bitmap = [NSBitmapImageRep imageRepWithData:reloadedImage.TIFFRepresentation];
+		NSUInteger			pixel[4] = { 0, 0, 0, 0 };
+		
+		
+		[bitmap getPixel:pixel atX:1 y:1];
+		Console_TestAssertUpdate(result, (0xFF == pixel[0]) && (0xFF == pixel[3]), Console_WriteValue, "reloaded pixel", pixel[0]);
+	}
+	
+	// clean up
+	ImageStore_SetMemoryLimit(kMy_DefaultMemoryLimit);
+	ImageStore_ReleaseImage(firstID);
+	ImageStore_ReleaseImage(secondID);
+	removeImageEntry(firstID);
+	removeImageEntry(secondID);
+	Console_TestAssertUpdate(result, 0 == gCachedImageCount, Console_WriteValue, "cached images after cleanup", gCachedImageCount);
+	
+	// the reloaded image still uses its mapping, so the file must
+	// not be truncated yet (reading the pixels would crash)
+	Console_TestAssertUpdate(result, gMappedPixelsCount > 0, Console_WriteValue, "mappings in use", gMappedPixelsCount.load());
+	Console_TestAssertUpdate(result, 0 != gCacheFileEnd, Console_WriteLine, "cache file is kept while a mapping is in use");
+	if (nil != reloadedImage)
+	{
+		NSBitmapImageRep*	bitmap = [NSBitmapImageRep imageRepWithData:reloadedImage.TIFFRepresentation];
+		NSUInteger			pixel[4] = { 0, 0, 0, 0 };
+		
+		
+		[bitmap getPixel:pixel atX:2 y:2];
+		Console_TestAssertUpdate(result, 0xFF == pixel[0], Console_WriteValue, "pixel of image whose entry was removed", pixel[0]);
+	}
+	
+	return result;
+}// unitTest_Cache_000
+
+
+/*!
+Tests finding images by content and sharing segments.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_Content_000 ()
+{
+	Boolean					result = true;
+	ImageStore_ContentKey	keyA;
+	ImageStore_ContentKey	keyB;
+	ImageStore_ImageID		firstID = kImageStore_InvalidImageID;
+	ImageStore_ImageID		secondID = kImageStore_InvalidImageID;
+	ImageStore_ImageID		otherID = kImageStore_InvalidImageID;
+	ImageStore_ImageID		segmentImageID = kImageStore_InvalidImageID;
+	TextAttributes_BitmapID	firstSegmentID = 0;
+	TextAttributes_BitmapID	secondSegmentID = 0;
+	TextAttributes_BitmapID	otherSegmentID = 0;
+	CGRect					segmentRect = CGRectZero;
+	
+	
+	// a key does not depend on how the bytes are split into pieces
+	keyA.appendBytes("image ", 6);
+	keyA.appendBytes("data", 4);
+	keyB.appendBytes("image data", 10);
+	Console_TestAssertUpdate(result, (keyA.returnDigest() == keyB.returnDigest()) && (keyA.byteCount == keyB.byteCount),
+								Console_WriteLine, "same bytes give same key");
+	Console_TestAssertUpdate(result, keyA.returnDigest() == keyA.returnDigest(),
+								Console_WriteLine, "returning the digest does not change the key");
+	keyB.appendBytes("!", 1);
+	Console_TestAssertUpdate(result, keyA.returnDigest() != keyB.returnDigest(), Console_WriteLine, "different bytes give different key");
+	
+	// an image with the same content is found instead of being stored again
+	firstID = ImageStore_AddImage(returnNewTestImage(0x40), keyA);
+	secondID = ImageStore_AddImage(returnNewTestImage(0x40), keyA);
+	otherID = ImageStore_AddImage(returnNewTestImage(0x80), keyB);
+	Console_TestAssertUpdate(result, kImageStore_InvalidImageID != firstID, Console_WriteLine, "image is stored");
+	Console_TestAssertUpdate(result, firstID == secondID, Console_WriteValue, "same content gives same ID", secondID);
+	Console_TestAssertUpdate(result, firstID != otherID, Console_WriteValue, "different content gives different ID", otherID);
+	Console_TestAssertUpdate(result, firstID == ImageStore_FindImage(keyA), Console_WriteLine, "image is found by content");
+	
+	// segments are shared for the same part of the same image
+	Console_TestAssertUpdate(result, ImageStore_DefineSegment(firstID, CGRectMake(0, 2, 2, 2), firstSegmentID),
+								Console_WriteLine, "first segment");
+	Console_TestAssertUpdate(result, ImageStore_DefineSegment(firstID, CGRectMake(0, 2, 2, 2), secondSegmentID),
+								Console_WriteLine, "second segment");
+	Console_TestAssertUpdate(result, ImageStore_DefineSegment(otherID, CGRectMake(0, 2, 2, 2), otherSegmentID),
+								Console_WriteLine, "segment of other image");
+	Console_TestAssertUpdate(result, firstSegmentID == secondSegmentID, Console_WriteValue, "same part gives same segment", secondSegmentID);
+	Console_TestAssertUpdate(result, firstSegmentID != otherSegmentID, Console_WriteValue, "other image gives other segment", otherSegmentID);
+	Console_TestAssertUpdate(result, ImageStore_GetSegment(firstSegmentID, segmentImageID, segmentRect) &&
+										(firstID == segmentImageID) && CGRectEqualToRect(segmentRect, CGRectMake(0, 2, 2, 2)),
+								Console_WriteLine, "segment refers to image");
+	
+	// released images stay until memory is needed, then their segments are freed
+	ImageStore_ReleaseImage(firstID);
+	ImageStore_ReleaseImage(firstID);
+	ImageStore_ReleaseImage(firstID);
+	ImageStore_ReleaseImage(otherID);
+	Console_TestAssertUpdate(result, ImageStore_GetSegment(firstSegmentID, segmentImageID, segmentRect),
+								Console_WriteLine, "released image is kept while there is room");
+	ImageStore_SetMemoryLimit(0);
+	ImageStore_SetMemoryLimit(kMy_DefaultMemoryLimit);
+	Console_TestAssertUpdate(result, false == ImageStore_GetSegment(firstSegmentID, segmentImageID, segmentRect),
+								Console_WriteLine, "segment is freed when image is discarded");
+	Console_TestAssertUpdate(result, kImageStore_InvalidImageID == ImageStore_FindImage(keyA),
+								Console_WriteLine, "discarded image is not found");
+	
+	// clean up (the most recently used image is always kept)
+	removeImageEntry(otherID);
+	
+	return result;
+}// unitTest_Content_000
+
+} // anonymous namespace
+
+// BELOW IS REQUIRED NEWLINE TO END FILE
@@ -51,12 +51,18 @@
 
 // library includes
 #import <AlertMessages.h>
+#import <ByteRing.h>
 #import <CocoaBasic.h>
 #import <Console.h>
 #import <Localization.h>
 #import <MemoryBlockPtrLocker.template.h>
+#import <MemoryBlockSlotLocker.template.h>
 #import <MemoryBlocks.h>
 #import <ParameterDecoder.h>
+#import <UnicodeWidth.h>
+#import <UTF8Decoder.h>
+#import <UTF8Encoder.h>
+#import <WorkPool.h>
 
 // application includes
 #import "AppResources.h"
@@ -65,10 +71,13 @@
 #import "Commands.h"
 #import "DebugInterface.h"
 #import "EventLoop.h"
+#import "ImageStore.h"
 #import "InfoWindow.h"
 #import "Preferences.h"
 #import "PrefsWindow.h"
 #import "SessionFactory.h"
+#import "SixelDecoder.h"
+#import "Terminal.h"
 #import "TerminalView.h"
 #import "UIStrings.h"
 
@@ -111,6 +120,30 @@ Initialize_ApplicationStartup	(CFBundleRef	inApplicationBundle)
 	MemoryBlockPtrLocker_RunTests();
 #endif
 	
+#if RUN_MODULE_TESTS
+	MemoryBlockSlotLocker_RunTests();
+#endif
+	
+#if RUN_MODULE_TESTS
+	WorkPool_RunTests();
+#endif
+	
+#if RUN_MODULE_TESTS
+	ByteRing_RunTests();
+#endif
+	
+#if RUN_MODULE_TESTS
+	UnicodeWidth_RunTests();
+#endif
+	
+#if RUN_MODULE_TESTS
+	UTF8Decoder_RunTests();
+#endif
+	
+#if RUN_MODULE_TESTS
+	UTF8Encoder_RunTests();
+#endif
+	
 	// set the application bundle so everything searches in the right place for resources
 	AppResources_Init(inApplicationBundle);
 	
@@ -172,6 +205,18 @@ Initialize_ApplicationStartup	(CFBundleRef	inApplicationBundle)
 		ParameterDecoder_RunTests();
 	#endif
 		
+	#if RUN_MODULE_TESTS
+		SixelDecoder_RunTests();
+	#endif
+		
+	#if RUN_MODULE_TESTS
+		ImageStore_RunTests();
+	#endif
+		
+	#if RUN_MODULE_TESTS
+		Terminal_RunTests();
+	#endif
+		
 		TerminalView_Init();
 	#if RUN_MODULE_TESTS
 		//TerminalView_RunTests();
@@ -192,6 +237,67 @@ Initialize_ApplicationStartup	(CFBundleRef	inApplicationBundle)
 		//InfooWindow_RunTests();
 	#endif
 		
+		// if the environment asks for it, replay captured terminal output
+		// through the throughput benchmark and quit without creating any
+		// windows; each file yields one line of JSON on standard output
+		// (see Terminal_DebugRunThroughputBenchmark()), for example:
+		//   MACTERM_BENCHMARK_FILES=/tmp/ls.txt:/tmp/htop.txt \
+		//   MACTERM_BENCHMARK_ITERATIONS=10 \
+		//   MacTerm.app/Contents/MacOS/MacTerm > results.jsonl
+		{
+			char const*		benchmarkFileList = std::getenv("MACTERM_BENCHMARK_FILES");
+			
+			
+			if (nullptr != benchmarkFileList)
+			{
+				char const*			iterationString = std::getenv("MACTERM_BENCHMARK_ITERATIONS");
+				long				iterationCount = ((nullptr != iterationString)
+														? std::strtol(iterationString, nullptr, 10)
+														: 10/* arbitrary */);
+				std::istringstream	fileListStream(benchmarkFileList);
+				std::string			filePath;
+				int					exitStatus = EXIT_SUCCESS;
+				
+				
+				if ((iterationCount < 1) || (iterationCount > UINT16_MAX))
+				{
+					Console_Warning(Console_WriteValue, "ignoring invalid benchmark iteration count", iterationCount);
+					iterationCount = 10; // arbitrary
+				}
+				
+				while (std::getline(fileListStream, filePath, ':'))
+				{
+				@autoreleasepool {
+					NSString*	filePathObject = [NSString stringWithUTF8String:filePath.c_str()];
+					NSData*		fileData = [NSData dataWithContentsOfFile:filePathObject];
+					
+					
+					if (nil == fileData)
+					{
+						Console_Warning(Console_WriteValueCString, "unable to read benchmark file", filePath.c_str());
+						exitStatus = EXIT_FAILURE;
+					}
+					else
+					{
+						Terminal_Result		benchmarkResult = Terminal_DebugRunThroughputBenchmark
+																(BRIDGE_CAST([filePathObject lastPathComponent], CFStringRef),
+																	REINTERPRET_CAST(fileData.bytes, UInt8 const*),
+																	fileData.length, STATIC_CAST(iterationCount, UInt16),
+																	true/* machine-readable */);
+						
+						
+						if (kTerminal_ResultOK != benchmarkResult)
+						{
+							Console_Warning(Console_WriteValue, "terminal benchmark failed, error", benchmarkResult);
+							exitStatus = EXIT_FAILURE;
+						}
+					}
+				}// @autoreleasepool
+				}
+				std::exit(exitStatus);
+			}
+		}
+	
 	#ifndef NDEBUG
 		// write an initial header to the console that describes the user’s runtime environment
 		{
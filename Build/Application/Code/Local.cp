@@ -40,9 +40,14 @@
 #include <cstdlib>
 
 // standard-C++ includes
+#include <algorithm>
+#include <atomic>
+#include <deque>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 // UNIX includes
 //struct pthread_rwlock_t;
@@ -54,6 +59,7 @@ extern "C"
 #include <fcntl.h>
 #include <grp.h>
 #include <netdb.h>
+#include <poll.h>
 #include <pthread.h>
 #include <pwd.h>
 #include <signal.h>
@@ -75,6 +81,7 @@ extern "C"
 
 // library includes
 #include <AlertMessages.h>
+#include <ByteRing.h>
 #include <CFRetainRelease.h>
 #include <CFUtilities.h>
 #include <CocoaBasic.h>
@@ -86,6 +93,7 @@ extern "C"
 #include "AppResources.h"
 #include "ConstantsRegistry.h"
 #include "DebugInterface.h"
+#include "Preferences.h"
 #include "QuillsSession.h"
 #include "Session.h"
 #include "Terminal.h"
@@ -102,6 +110,13 @@ enum MyTTYState
 	kMyTTYStateRaw
 };
 
+CFAbsoluteTime const	kMy_DataLoopDrainTimeBudget = 0.010;	//!< seconds that the main queue may spend on one batch of data
+UInt32 const			kMy_DataLoopQueueSizeMinimum = 64;		//!< kilobytes; smallest allowed value of the queue size preference
+UInt32 const			kMy_DataLoopQueueSizeMaximum = 65536;	//!< kilobytes; largest allowed value of the queue size preference
+size_t const			kMy_WriteQueueChunkSize = 65536;		//!< bytes; small writes are combined into chunks up to this size
+size_t const			kMy_WriteQueueHighWaterMark = 1048576;	//!< bytes; above this, the write queue is full (senders should wait)
+size_t const			kMy_WriteQueueLowWaterMark = 262144;	//!< bytes; below this, a full write queue is ready again
+
 } // anonymous namespace
 
 #pragma mark Types
@@ -113,17 +128,130 @@ typedef Local_TerminalID		My_TTYSlaveID;
 typedef std::set< pid_t >		My_UnixProcessIDSet;
 
 /*!
-Thread context passed to threadForLocalProcessDataLoop().
+Connects a pseudo-terminal to a session.  A thread (see
+threadForLocalProcessDataLoop()) reads from the device
+directly into a lock-free ring, and the main queue is
+asked to process the data in batches (see drain()).
+
+The reader never waits for the main queue unless the
+ring is full; and, no matter how many reads occur while
+the main queue is busy, at most one batch is scheduled
+at a time.  This is shared (by the reading thread, any
+scheduled batch and the process that owns the device)
+so that it is destroyed only when none of them need it.
 */
-struct My_DataLoopThreadContext
+struct My_DataLoop:
+public std::enable_shared_from_this< My_DataLoop >
 {
-	dispatch_queue_t	dispatchQueue;
-	SessionRef			session;
-	My_TTYMasterID		masterTTY;
-	size_t				blockSize;
+	My_DataLoop		(SessionRef, My_TTYMasterID, size_t);
+	~My_DataLoop	();
+	
+	void
+	debugDumpDetailedSnapshot () const;
+	
+	void
+	drain	(Boolean);
+	
+	void
+	scheduleDrain ();
+	
+	dispatch_queue_t				dispatchQueue;			//!< runs the loop that reads from the device
+	dispatch_semaphore_t			spaceAvailable;			//!< signaled by the main queue when it frees space for a waiting reader
+	SessionRef						session;				//!< where data is processed
+	My_TTYMasterID					masterTTY;				//!< where data is read
+	ByteRing_Buffer					ring;					//!< data that has been read but not processed
+	std::atomic< bool >				drainScheduled;			//!< true if a call to drain() is pending on the main queue
+	std::atomic< bool >				readerWaiting;			//!< true if the reader is waiting on "spaceAvailable"
+	std::atomic< bool >				abandoned;				//!< true if the session stopped accepting data
+	std::atomic< CFAbsoluteTime >	drainRequestTime;		//!< when the pending call to drain() was scheduled
+	std::atomic< UInt64 >			totalBytesRead;			//!< statistic; bytes ever read from the device
+	std::atomic< UInt64 >			backpressureCount;		//!< statistic; number of times that the reader found the ring full
+	// IMPORTANT: the remaining statistics are only accessed on the main queue
+	UInt64							totalBytesProcessed;	//!< bytes ever given to the session
+	UInt64							drainCount;				//!< number of batches processed
+	CFAbsoluteTime					totalDrainLatency;		//!< sum of delays between scheduling and processing each batch
+	CFAbsoluteTime					maximumDrainLatency;	//!< largest delay between scheduling and processing a batch
+	CFAbsoluteTime					rateIntervalStartTime;	//!< start of the interval used to find "recentBytesPerSecond"
+	UInt64							rateIntervalBytes;		//!< bytes processed since "rateIntervalStartTime"
+	Float64							recentBytesPerSecond;	//!< processing rate over the last complete interval
+};
+
+/*!
+Data that has been written by a session but not yet
+accepted by its pseudo-terminal device.
+*/
+struct My_WriteChunk
+{
+	std::vector< UInt8 >	bytes;			//!< data to write
+	size_t					offset;			//!< number of bytes (from the start) that have been written
+	CFAbsoluteTime			enqueueTime;	//!< when the first byte was added
+};
+
+/*!
+Sends data to a pseudo-terminal device without waiting for
+it.  Data is written immediately if the device has room;
+otherwise it is queued, and a dispatch source (which uses
+kqueue to watch the device) writes more of the queue each
+time the device can accept it.
+
+The queue is “full” (see isFull()) once it holds more than
+a high-water mark, and work on "readyQueue" is suspended
+until it has drained below a low-water mark; this gives
+senders of large amounts of data (such as a Paste) a way
+to wait without blocking the main queue.  Data is still
+accepted while the queue is full.  Similarly, work on
+"drainedQueue" is suspended whenever anything is queued,
+so that a sender can measure how quickly the process is
+actually reading its input.
+
+IMPORTANT:	Call all methods only from the main queue.
+*/
+struct My_WriteQueue
+{
+	My_WriteQueue	(int);
+	~My_WriteQueue	();
+	
+	void
+	debugDumpDetailedSnapshot () const;
+	
+	void
+	enqueue		(UInt8 const*, size_t);
+	
+	void
+	fail	(int);
+	
+	//! Returns true if senders should wait for "readyQueue".
+	Boolean
+	isFull () const
+	{
+		return (queuedByteCount > kMy_WriteQueueHighWaterMark);
+	}
+	
+	void
+	updateDispatchState ();
+	
+	void
+	writeQueuedData ();
+	
+	int							fileDescriptor;			//!< nonblocking duplicate of the master TTY; closed when "writeSource" is canceled
+	dispatch_source_t			writeSource;			//!< calls writeQueuedData() when the device can accept data
+	dispatch_queue_t			readyQueue;				//!< runs blocks on the main queue whenever the queue is not full
+	dispatch_queue_t			drainedQueue;			//!< runs blocks on the main queue whenever the queue is empty
+	Boolean						writeSourceSuspended;	//!< true if "writeSource" is suspended (the queue is empty)
+	Boolean						readyQueueSuspended;	//!< true if "readyQueue" is suspended (the queue was full)
+	Boolean						drainedQueueSuspended;	//!< true if "drainedQueue" is suspended (the queue is not empty)
+	Boolean						failed;					//!< true if the device stopped accepting data
+	std::deque< My_WriteChunk >	chunks;					//!< data waiting to be written, in order
+	size_t						queuedByteCount;		//!< total unwritten bytes in "chunks"
+	size_t						maximumQueuedByteCount;	//!< statistic; largest value of "queuedByteCount"
+	UInt64						totalBytesWritten;		//!< statistic; bytes ever accepted by the device
+	UInt64						immediateWriteCount;	//!< statistic; number of writes that needed no queue
+	UInt64						chunksWritten;			//!< statistic; number of queued chunks that were completely written
+	CFAbsoluteTime				totalWriteLatency;		//!< statistic; sum of delays between queueing and writing each chunk
+	CFAbsoluteTime				maximumWriteLatency;	//!< statistic; largest delay between queueing and writing a chunk
+	UInt64						backpressureCount;		//!< statistic; number of times that the queue became full
+	UInt64						droppedByteCount;		//!< statistic; bytes discarded because the device failed
 };
-typedef My_DataLoopThreadContext*			My_DataLoopThreadContextPtr;
-typedef My_DataLoopThreadContext const*		My_DataLoopThreadContextConstPtr;
 
 /*!
 Information retained about a new process.  Known externally
@@ -141,6 +269,8 @@ struct My_Process
 	CFRetainRelease		_commandLine;		// array of strings for parent process’ command line arguments (first is program name)
 	CFRetainRelease		_recentDirectory;	// empty until a query is done to determine the value
 	CFRetainRelease		_originalDirectory;	// empty if no chdir() was used, otherwise the chdir() value at spawn time
+	std::shared_ptr< My_DataLoop >	_dataLoop;	// transfers data from "_pseudoTerminal" to the session
+	std::unique_ptr< My_WriteQueue >	_writeQueue;	// transfers data from the session to "_pseudoTerminal"
 };
 typedef My_Process*			My_ProcessPtr;
 typedef My_Process const*	My_ProcessConstPtr;
@@ -162,7 +292,7 @@ void			putTTYInOriginalModeAtExit			();
 Local_Result	putTTYInRawMode						(Local_TerminalID);
 void			receiveSignal						(int);
 Local_Result	sendTerminalResizeMessage			(Local_TerminalID, struct winsize const*);
-void			threadForLocalProcessDataLoop		(void*);
+void			threadForLocalProcessDataLoop		(std::shared_ptr< My_DataLoop > const&);
 
 } // anonymous namespace
 
@@ -563,6 +693,39 @@ Local_KillProcess	(Local_ProcessRef*	inoutRefPtr)
 }// KillProcess
 
 
+/*!
+Writes arbitrary debugging information to the console for the
+specified process, such as statistics on the transfer of data
+from the process to its terminal.
+
+(2023.10)
+*/
+void
+Local_ProcessDebugDumpDetailedSnapshot	(Local_ProcessRef	inProcess)
+{
+	My_ProcessAutoLocker	ptr(gProcessPtrLocks(), inProcess);
+	
+	
+	Console_WriteValue("Process ID", ptr->_processID);
+	if (nullptr == ptr->_dataLoop)
+	{
+		Console_WriteLine("No data queue is defined.");
+	}
+	else
+	{
+		ptr->_dataLoop->debugDumpDetailedSnapshot();
+	}
+	if (nullptr == ptr->_writeQueue)
+	{
+		Console_WriteLine("No write queue is defined.");
+	}
+	else
+	{
+		ptr->_writeQueue->debugDumpDetailedSnapshot();
+	}
+}// ProcessDebugDumpDetailedSnapshot
+
+
 /*!
 Returns true only if the terminal associated with the specified
 process is apparently waiting for password input.  This can be
@@ -608,6 +771,73 @@ Local_ProcessIsStopped	(Local_ProcessRef	inProcess)
 }// ProcessIsStopped
 
 
+/*!
+Arranges for the given block to run on the main queue as soon
+as the process has accepted everything in its write queue
+(which may be right away).  Blocks run in the order they are
+given to this routine.
+
+Unlike Local_ProcessNotifyWhenWriteQueueReady(), this waits
+for all data, so the delay is a measure of how quickly the
+process is actually reading (useful for pacing a sender).
+If the process stops accepting data, waiting blocks still
+run (but anything that they send is discarded).
+
+IMPORTANT:	Call this only from the main queue.
+
+(2023.10)
+*/
+void
+Local_ProcessNotifyWhenWriteQueueEmpty	(Local_ProcessRef	inProcess,
+										 void				(^inBlock)())
+{
+	My_ProcessAutoLocker	ptr(gProcessPtrLocks(), inProcess);
+	
+	
+	if (nullptr == ptr->_writeQueue)
+	{
+		dispatch_async(dispatch_get_main_queue(), inBlock);
+	}
+	else
+	{
+		dispatch_async(ptr->_writeQueue->drainedQueue, inBlock);
+	}
+}// ProcessNotifyWhenWriteQueueEmpty
+
+
+/*!
+Arranges for the given block to run on the main queue as soon
+as the process’ write queue is not full (which may be right
+away).  Blocks run in the order they are given to this routine.
+
+This is the way for a sender of a lot of data to respond to
+backpressure: if Local_ProcessWriteQueueIsFull() returns true,
+send the rest of the data from a block given to this routine.
+If the process stops accepting data, waiting blocks still run
+(but anything that they send is discarded).
+
+IMPORTANT:	Call this only from the main queue.
+
+(2023.10)
+*/
+void
+Local_ProcessNotifyWhenWriteQueueReady	(Local_ProcessRef	inProcess,
+										 void				(^inBlock)())
+{
+	My_ProcessAutoLocker	ptr(gProcessPtrLocks(), inProcess);
+	
+	
+	if (nullptr == ptr->_writeQueue)
+	{
+		dispatch_async(dispatch_get_main_queue(), inBlock);
+	}
+	else
+	{
+		dispatch_async(ptr->_writeQueue->readyQueue, inBlock);
+	}
+}// ProcessNotifyWhenWriteQueueReady
+
+
 /*!
 Returns the program and its given arguments as an array of
 CFStringRefs, suitable for display.  The strings can be decoded
@@ -704,6 +934,30 @@ Local_ProcessReturnOriginalDirectory	(Local_ProcessRef	inProcess)
 }// ProcessReturnOriginalDirectory
 
 
+/*!
+Returns the number of bytes that have been given to
+Local_ProcessWriteBytes() but not yet accepted by the
+pseudo-terminal device.
+
+IMPORTANT:	Call this only from the main queue.
+
+(2023.10)
+*/
+size_t
+Local_ProcessReturnQueuedWriteByteCount		(Local_ProcessRef	inProcess)
+{
+	My_ProcessAutoLocker	ptr(gProcessPtrLocks(), inProcess);
+	size_t					result = 0;
+	
+	
+	if (nullptr != ptr->_writeQueue)
+	{
+		result = ptr->_writeQueue->queuedByteCount;
+	}
+	return result;
+}// ProcessReturnQueuedWriteByteCount
+
+
 /*!
 Returns the name of the pseudo-terminal device ("/dev/ttyp0",
 for example) that is connected as a slave.  Data sent to this
@@ -742,6 +996,77 @@ Local_ProcessReturnUnixID	(Local_ProcessRef	inProcess)
 }// ProcessReturnUnixID
 
 
+/*!
+Sends the specified data to the process’ pseudo-terminal
+device without waiting.  Whatever the device cannot accept
+right away is queued, and written as soon as the process
+reads more of its input.  Returns the number of bytes that
+were written or queued, which is normally "inByteCount".
+
+Data is accepted even if the queue is full, so that small
+responses (such as key presses or terminal reports) are
+never lost; but a sender of a lot of data should check
+Local_ProcessWriteQueueIsFull() and, if necessary, wait
+with Local_ProcessNotifyWhenWriteQueueReady().
+
+IMPORTANT:	Writing bytes to a process is a very low-level
+			operation, and you should usually be calling a
+			higher-level API (see the Session module).  For
+			example, the Session knows what text encoding is
+			supposed to be used.
+
+IMPORTANT:	Call this only from the main queue.
+
+(2023.10)
+*/
+ssize_t
+Local_ProcessWriteBytes		(Local_ProcessRef	inProcess,
+							 void const*		inBufferPtr,
+							 size_t				inByteCount)
+{
+	My_ProcessAutoLocker	ptr(gProcessPtrLocks(), inProcess);
+	ssize_t					result = 0;
+	
+	
+	if (nullptr == ptr->_writeQueue)
+	{
+		result = Local_TerminalWriteBytes(ptr->_pseudoTerminal, inBufferPtr, inByteCount);
+	}
+	else
+	{
+		ptr->_writeQueue->enqueue(REINTERPRET_CAST(inBufferPtr, UInt8 const*), inByteCount);
+		result = inByteCount;
+	}
+	return result;
+}// ProcessWriteBytes
+
+
+/*!
+Returns true only if so much data is waiting to be written
+to the process that a sender of a lot of data should wait
+(see Local_ProcessNotifyWhenWriteQueueReady()) before it
+sends more.  This happens when the process is not reading
+its input as quickly as it arrives.
+
+IMPORTANT:	Call this only from the main queue.
+
+(2023.10)
+*/
+Boolean
+Local_ProcessWriteQueueIsFull	(Local_ProcessRef	inProcess)
+{
+	My_ProcessAutoLocker	ptr(gProcessPtrLocks(), inProcess);
+	Boolean					result = false;
+	
+	
+	if (nullptr != ptr->_writeQueue)
+	{
+		result = ptr->_writeQueue->isFull();
+	}
+	return result;
+}// ProcessWriteQueueIsFull
+
+
 /*!
 Forks a new process and arranges for its output and input to be
 channeled through the specified screen.  The Unix command line is
@@ -1069,8 +1394,28 @@ Local_SpawnProcess	(SessionRef			inUninitializedSession,
 			}
 			
 			// start a thread for data processing so that MacTerm’s main event loop can still run
-			auto	threadContextPtr = new My_DataLoopThreadContext();
-			if (nullptr == threadContextPtr) result = kLocal_ResultInsufficientBufferSpace;
+			std::shared_ptr< My_DataLoop >	dataLoop;
+			UInt32							queueSizeInKilobytes = 0;
+			
+			
+			unless (kPreferences_ResultOK ==
+					Preferences_GetData(kPreferences_TagDataReceiveQueueSize,
+										sizeof(queueSizeInKilobytes), &queueSizeInKilobytes))
+			{
+				queueSizeInKilobytes = 1024; // arbitrary
+			}
+			queueSizeInKilobytes = std::max< UInt32 >(queueSizeInKilobytes, kMy_DataLoopQueueSizeMinimum);
+			queueSizeInKilobytes = std::min< UInt32 >(queueSizeInKilobytes, kMy_DataLoopQueueSizeMaximum);
+			try
+			{
+				dataLoop = std::make_shared< My_DataLoop >(inUninitializedSession, masterTTY,
+															STATIC_CAST(queueSizeInKilobytes, size_t) * 1024);
+			}
+			catch (std::bad_alloc)
+			{
+				dataLoop.reset();
+			}
+			if (nullptr == dataLoop) result = kLocal_ResultInsufficientBufferSpace;
 			else
 			{
 				// store process information for session
@@ -1079,33 +1424,35 @@ Local_SpawnProcess	(SessionRef			inUninitializedSession,
 																		targetDirCFString.returnCFStringRef(),
 																		masterTTY, slaveDeviceName, processID);
 					Local_ProcessRef	newProcess = REINTERPRET_CAST(newProcessPtr, Local_ProcessRef);
+					int const			kWriteDescriptor = dup(masterTTY);
+					
 					
+					newProcessPtr->_dataLoop = dataLoop;
 					
+					// writes to the device are queued so that the main queue never
+					// waits for the process; if this fails, writes will block
+					if (-1 == kWriteDescriptor)
+					{
+						int const	kActualError = errno;
+						
+						
+						Console_Warning(Console_WriteValue, "unable to duplicate master TTY for writing, errno", kActualError);
+					}
+					else
+					{
+						newProcessPtr->_writeQueue.reset(new My_WriteQueue(kWriteDescriptor));
+					}
 					Session_SetProcess(inUninitializedSession, newProcess);
 				}
 				
-				// set up context
-				static int		gQueueCounter = 0;
-				char			nameBuffer[256];
-				char const*		queueName = nameBuffer;
-				auto			formatStatus = snprintf(nameBuffer, sizeof(nameBuffer), "net.macterm.queues.sessions.%d", (int)++gQueueCounter);
-				
-				
-				if (formatStatus < 0)
-				{
-					Console_Warning(Console_WriteValue, "unable to create formatted string for terminal queue name, error", formatStatus);
-					queueName = nullptr;
-				}
-				threadContextPtr->dispatchQueue = dispatch_queue_create(queueName, DISPATCH_QUEUE_CONCURRENT);
-				threadContextPtr->session = inUninitializedSession;
-				threadContextPtr->masterTTY = masterTTY;
-				threadContextPtr->blockSize = 4096; // TEMPORARY; could make this a user preference
-				
 				// put the session in the initialized state, to indicate it is complete
-				Session_SetState(threadContextPtr->session, kSession_StateInitialized);
+				Session_SetState(inUninitializedSession, kSession_StateInitialized);
 				
 				// create and run thread with data-processing loop
-				dispatch_async_f(threadContextPtr->dispatchQueue, STATIC_CAST(threadContextPtr, void*), threadForLocalProcessDataLoop);
+				dispatch_async(dataLoop->dispatchQueue,
+								^{
+									threadForLocalProcessDataLoop(dataLoop);
+								});
 			}
 		}
 	}
@@ -1503,6 +1850,540 @@ Local_UpdateCurrentDirectoryCache ()
 #pragma mark Internal Methods
 namespace {
 
+/*!
+Creates a connection between the given pseudo-terminal and
+session that can hold the given number of bytes (at least)
+while the session is busy.  No thread is started; see
+threadForLocalProcessDataLoop().
+
+(2023.10)
+*/
+My_DataLoop::
+My_DataLoop		(SessionRef			inSession,
+				 My_TTYMasterID		inMasterTTY,
+				 size_t				inQueueSize)
+:
+// IMPORTANT: THESE ARE EXECUTED IN THE ORDER MEMBERS APPEAR IN THE CLASS.
+dispatchQueue(nullptr),
+spaceAvailable(dispatch_semaphore_create(0)),
+session(inSession),
+masterTTY(inMasterTTY),
+ring(inQueueSize),
+drainScheduled(false),
+readerWaiting(false),
+abandoned(false),
+drainRequestTime(0),
+totalBytesRead(0),
+backpressureCount(0),
+totalBytesProcessed(0),
+drainCount(0),
+totalDrainLatency(0),
+maximumDrainLatency(0),
+rateIntervalStartTime(CFAbsoluteTimeGetCurrent()),
+rateIntervalBytes(0),
+recentBytesPerSecond(0)
+{
+	static int		gQueueCounter = 0;
+	char			nameBuffer[256];
+	char const*		queueName = nameBuffer;
+	auto			formatStatus = snprintf(nameBuffer, sizeof(nameBuffer), "net.macterm.queues.sessions.%d", (int)++gQueueCounter);
+	
+	
+	if (formatStatus < 0)
+	{
+		Console_Warning(Console_WriteValue, "unable to create formatted string for terminal queue name, error", formatStatus);
+		queueName = nullptr;
+	}
+	dispatchQueue = dispatch_queue_create(queueName, DISPATCH_QUEUE_CONCURRENT);
+}// My_DataLoop 3-argument constructor
+
+
+/*!
+Destructor.
+
+(2023.10)
+*/
+My_DataLoop::
+~My_DataLoop ()
+{
+	dispatch_release(spaceAvailable);
+	dispatch_release(dispatchQueue);
+}// My_DataLoop destructor
+
+
+/*!
+Writes the data-transfer statistics to the console.
+
+IMPORTANT:	Call this only from the main queue.
+
+(2023.10)
+*/
+void
+My_DataLoop::
+debugDumpDetailedSnapshot () const
+{
+	Console_WriteValue("Data queue: capacity in bytes", ring.returnCapacity());
+	Console_WriteValue("Data queue: bytes waiting to be processed", ring.returnSizeInUse());
+	Console_WriteValue("Data queue: total bytes read", totalBytesRead.load());
+	Console_WriteValue("Data queue: total bytes processed", totalBytesProcessed);
+	Console_WriteValue("Data queue: recent bytes processed per second", STATIC_CAST(recentBytesPerSecond, SInt64));
+	Console_WriteValue("Data queue: batches processed", drainCount);
+	Console_WriteValue("Data queue: average batch latency (microseconds)",
+						(0 == drainCount) ? 0 : STATIC_CAST(totalDrainLatency * 1000000 / drainCount, SInt64));
+	Console_WriteValue("Data queue: maximum batch latency (microseconds)", STATIC_CAST(maximumDrainLatency * 1000000, SInt64));
+	Console_WriteValue("Data queue: times that reads waited for space", backpressureCount.load());
+	Console_WriteValue("Data queue: abandoned because session stopped accepting data", abandoned.load());
+}// My_DataLoop::debugDumpDetailedSnapshot
+
+
+/*!
+Gives data from the ring to the session until the ring
+is empty or (if "inUntilEmpty" is false) the time budget
+of one batch expires.  In the latter case, another batch
+is scheduled so that other main-queue events (such as
+drawing and user input) can be handled in between.
+
+If the session stops accepting data, the loop is marked
+as abandoned and any remaining data is discarded.
+
+IMPORTANT:	Call this only from the main queue.
+
+(2023.10)
+*/
+void
+My_DataLoop::
+drain	(Boolean	inUntilEmpty)
+{
+	CFAbsoluteTime const	kStartTime = CFAbsoluteTimeGetCurrent();
+	size_t					bytesProcessed = 0;
+	Boolean					stalled = false;
+	
+	
+	unless (inUntilEmpty)
+	{
+		CFAbsoluteTime const	kLatency = (kStartTime - drainRequestTime.load());
+		
+		
+		++drainCount;
+		totalDrainLatency += kLatency;
+		maximumDrainLatency = std::max(maximumDrainLatency, kLatency);
+	}
+	
+	// any data committed after this point will schedule a new batch
+	drainScheduled = false;
+	
+	for (;;)
+	{
+		UInt8 const*	spanPtr = nullptr;
+		size_t const	kSpanSize = ring.returnReadableSpan(spanPtr);
+		
+		
+		if (0 == kSpanSize)
+		{
+			break;
+		}
+		
+		if (abandoned || (false == Session_IsValid(session)))
+		{
+			// discard the data so that the reader is not blocked
+			abandoned = true;
+			ring.commitRead(kSpanSize);
+		}
+		else
+		{
+			size_t				unprocessedSize = 0;
+			Session_Result		sessionResult = Session_AppendDataForProcessing(session, spanPtr, kSpanSize, &unprocessedSize);
+			
+			
+			if (sessionResult.ok())
+			{
+				size_t const	kAcceptedSize = (kSpanSize - unprocessedSize);
+				
+				
+				ring.commitRead(kAcceptedSize);
+				bytesProcessed += kAcceptedSize;
+				stalled = (0 == kAcceptedSize);
+			}
+			else
+			{
+				Console_Warning(Console_WriteValue, "data-processing loop terminated, append operation error", sessionResult.code());
+				abandoned = true;
+			}
+		}
+		
+		// wake up the reader if it was waiting for space
+		if (readerWaiting.exchange(false))
+		{
+			dispatch_semaphore_signal(spaceAvailable);
+		}
+		
+		if (stalled || ((false == inUntilEmpty) && ((CFAbsoluteTimeGetCurrent() - kStartTime) > kMy_DataLoopDrainTimeBudget)))
+		{
+			break;
+		}
+	}
+	
+	// update statistics
+	{
+		CFAbsoluteTime const	kEndTime = CFAbsoluteTimeGetCurrent();
+		CFAbsoluteTime const	kInterval = (kEndTime - rateIntervalStartTime);
+		
+		
+		totalBytesProcessed += bytesProcessed;
+		rateIntervalBytes += bytesProcessed;
+		if (kInterval >= 1.0)
+		{
+			recentBytesPerSecond = (rateIntervalBytes / kInterval);
+			rateIntervalBytes = 0;
+			rateIntervalStartTime = kEndTime;
+		}
+	}
+	
+	// if time ran out, continue in a separate batch
+	if ((false == inUntilEmpty) && (ring.returnSizeInUse() > 0))
+	{
+		scheduleDrain();
+	}
+}// My_DataLoop::drain
+
+
+/*!
+Arranges for drain() to be called on the main queue, unless
+a call is already pending (in which case, that call will
+process any new data).
+
+(2023.10)
+*/
+void
+My_DataLoop::
+scheduleDrain ()
+{
+	unless (drainScheduled.exchange(true))
+	{
+		std::shared_ptr< My_DataLoop > const	kSelf = shared_from_this(); // keep alive until the block runs
+		
+		
+		drainRequestTime = CFAbsoluteTimeGetCurrent();
+		dispatch_async(dispatch_get_main_queue(),
+						^{
+							kSelf->drain(false/* until empty */);
+						});
+	}
+}// My_DataLoop::scheduleDrain
+
+
+/*!
+Takes ownership of the given file descriptor (a duplicate
+of a pseudo-terminal master) and makes it nonblocking.
+
+Since the duplicate shares its flags with the original
+descriptor, reads from the device do not block either;
+see threadForLocalProcessDataLoop().
+
+(2023.10)
+*/
+My_WriteQueue::
+My_WriteQueue	(int	inFileDescriptor)
+:
+// IMPORTANT: THESE ARE EXECUTED IN THE ORDER MEMBERS APPEAR IN THE CLASS.
+fileDescriptor(inFileDescriptor),
+writeSource(dispatch_source_create(DISPATCH_SOURCE_TYPE_WRITE, inFileDescriptor, 0/* mask */, dispatch_get_main_queue())),
+readyQueue(dispatch_queue_create("net.macterm.queues.writeready", DISPATCH_QUEUE_SERIAL)),
+drainedQueue(dispatch_queue_create("net.macterm.queues.writedrained", DISPATCH_QUEUE_SERIAL)),
+writeSourceSuspended(true), // sources are created in the suspended state
+readyQueueSuspended(false),
+drainedQueueSuspended(false),
+failed(false),
+chunks(),
+queuedByteCount(0),
+maximumQueuedByteCount(0),
+totalBytesWritten(0),
+immediateWriteCount(0),
+chunksWritten(0),
+totalWriteLatency(0),
+maximumWriteLatency(0),
+backpressureCount(0),
+droppedByteCount(0)
+{
+	int const	kFlags = fcntl(fileDescriptor, F_GETFL);
+	int const	kDescriptor = fileDescriptor; // make block capture a copy
+	
+	
+	if ((-1 == kFlags) || (-1 == fcntl(fileDescriptor, F_SETFL, kFlags | O_NONBLOCK)))
+	{
+		int const	kActualError = errno;
+		
+		
+		Console_Warning(Console_WriteValue, "unable to make master TTY nonblocking, errno", kActualError);
+	}
+	
+	dispatch_set_target_queue(readyQueue, dispatch_get_main_queue());
+	dispatch_set_target_queue(drainedQueue, dispatch_get_main_queue());
+	dispatch_source_set_event_handler(writeSource,
+										^{
+											this->writeQueuedData();
+										});
+	dispatch_source_set_cancel_handler(writeSource,
+										^{
+											close(kDescriptor);
+										});
+}// My_WriteQueue 1-argument constructor
+
+
+/*!
+Destructor.  Any unwritten data is discarded, and any
+blocks that are waiting for the queue will run.
+
+(2023.10)
+*/
+My_WriteQueue::
+~My_WriteQueue ()
+{
+	// a suspended object must be resumed before it is released;
+	// the cancel handler (which closes the descriptor) only runs
+	// after the source is resumed
+	dispatch_source_cancel(writeSource);
+	if (writeSourceSuspended)
+	{
+		dispatch_resume(writeSource);
+	}
+	dispatch_release(writeSource);
+	if (readyQueueSuspended)
+	{
+		dispatch_resume(readyQueue);
+	}
+	dispatch_release(readyQueue);
+	if (drainedQueueSuspended)
+	{
+		dispatch_resume(drainedQueue);
+	}
+	dispatch_release(drainedQueue);
+}// My_WriteQueue destructor
+
+
+/*!
+Writes the write-queue statistics to the console.
+
+IMPORTANT:	Call this only from the main queue.
+
+(2023.10)
+*/
+void
+My_WriteQueue::
+debugDumpDetailedSnapshot () const
+{
+	Console_WriteValue("Write queue: bytes waiting to be written", queuedByteCount);
+	Console_WriteValue("Write queue: maximum bytes waiting to be written", maximumQueuedByteCount);
+	Console_WriteValue("Write queue: total bytes written", totalBytesWritten);
+	Console_WriteValue("Write queue: writes completed immediately", immediateWriteCount);
+	Console_WriteValue("Write queue: chunks written later", chunksWritten);
+	Console_WriteValue("Write queue: average chunk latency (microseconds)",
+						(0 == chunksWritten) ? 0 : STATIC_CAST(totalWriteLatency * 1000000 / chunksWritten, SInt64));
+	Console_WriteValue("Write queue: maximum chunk latency (microseconds)", STATIC_CAST(maximumWriteLatency * 1000000, SInt64));
+	Console_WriteValue("Write queue: times that the queue became full", backpressureCount);
+	Console_WriteValue("Write queue: total bytes discarded", droppedByteCount);
+	Console_WriteValue("Write queue: device stopped accepting data", failed);
+}// My_WriteQueue::debugDumpDetailedSnapshot
+
+
+/*!
+Writes as much of the given data as the device will accept
+right now (unless older data is still queued) and queues
+the rest.
+
+IMPORTANT:	Call this only from the main queue.
+
+(2023.10)
+*/
+void
+My_WriteQueue::
+enqueue		(UInt8 const*	inBytes,
+			 size_t			inByteCount)
+{
+	UInt8 const*	bytePtr = inBytes;
+	size_t			bytesLeft = inByteCount;
+	
+	
+	// data cannot be written directly if older data is waiting
+	if ((false == failed) && chunks.empty() && (bytesLeft > 0))
+	{
+		ssize_t const	kBytesWritten = write(fileDescriptor, bytePtr, bytesLeft);
+		
+		
+		if (kBytesWritten >= 0)
+		{
+			bytePtr += kBytesWritten;
+			bytesLeft -= kBytesWritten;
+			totalBytesWritten += kBytesWritten;
+			if (0 == bytesLeft)
+			{
+				++immediateWriteCount;
+			}
+		}
+		else
+		{
+			int const	kActualError = errno;
+			
+			
+			unless ((EAGAIN == kActualError) || (EINTR == kActualError))
+			{
+				fail(kActualError);
+			}
+		}
+	}
+	
+	if (failed)
+	{
+		droppedByteCount += bytesLeft;
+	}
+	else if (bytesLeft > 0)
+	{
+		// combine small writes (such as key presses) into one chunk
+		if (chunks.empty() || (chunks.back().bytes.size() >= kMy_WriteQueueChunkSize))
+		{
+			chunks.emplace_back();
+			chunks.back().offset = 0;
+			chunks.back().enqueueTime = CFAbsoluteTimeGetCurrent();
+		}
+		chunks.back().bytes.insert(chunks.back().bytes.end(), bytePtr, bytePtr + bytesLeft);
+		queuedByteCount += bytesLeft;
+		maximumQueuedByteCount = std::max(maximumQueuedByteCount, queuedByteCount);
+		updateDispatchState();
+	}
+}// My_WriteQueue::enqueue
+
+
+/*!
+Discards all queued data after an error that means the
+device will never accept it (such as EIO, after the process
+has exited).  Any data given to enqueue() later is also
+discarded, and waiting blocks are allowed to run.
+
+(2023.10)
+*/
+void
+My_WriteQueue::
+fail	(int	inError)
+{
+	unless (failed)
+	{
+		Console_Warning(Console_WriteValue, "discarding data for process, write error", inError);
+		failed = true;
+		dispatch_source_cancel(writeSource);
+	}
+	droppedByteCount += queuedByteCount;
+	queuedByteCount = 0;
+	chunks.clear();
+	updateDispatchState();
+}// My_WriteQueue::fail
+
+
+/*!
+Resumes or suspends the write source and ready queue to
+match the amount of queued data: the write source runs
+only while there is data, and the ready queue runs only
+while the queue is not full (with some hysteresis, so
+that senders are not woken for every write).
+
+(2023.10)
+*/
+void
+My_WriteQueue::
+updateDispatchState ()
+{
+	if (chunks.empty())
+	{
+		unless (writeSourceSuspended || failed)
+		{
+			dispatch_suspend(writeSource);
+			writeSourceSuspended = true;
+		}
+		if (drainedQueueSuspended)
+		{
+			dispatch_resume(drainedQueue);
+			drainedQueueSuspended = false;
+		}
+	}
+	else
+	{
+		if (writeSourceSuspended)
+		{
+			dispatch_resume(writeSource);
+			writeSourceSuspended = false;
+		}
+		unless (drainedQueueSuspended)
+		{
+			dispatch_suspend(drainedQueue);
+			drainedQueueSuspended = true;
+		}
+	}
+	
+	if (readyQueueSuspended)
+	{
+		if (queuedByteCount < kMy_WriteQueueLowWaterMark)
+		{
+			dispatch_resume(readyQueue);
+			readyQueueSuspended = false;
+		}
+	}
+	else if (isFull())
+	{
+		dispatch_suspend(readyQueue);
+		readyQueueSuspended = true;
+		++backpressureCount;
+	}
+}// My_WriteQueue::updateDispatchState
+
+
+/*!
+Writes queued data until the device stops accepting it or
+the queue is empty.  Called by the write source whenever
+the device has room.
+
+(2023.10)
+*/
+void
+My_WriteQueue::
+writeQueuedData ()
+{
+	while (false == chunks.empty())
+	{
+		My_WriteChunk&	chunk = chunks.front();
+		ssize_t const	kBytesWritten = write(fileDescriptor, chunk.bytes.data() + chunk.offset,
+												chunk.bytes.size() - chunk.offset);
+		
+		
+		if (kBytesWritten <= 0)
+		{
+			int const	kActualError = errno;
+			
+			
+			if ((kBytesWritten < 0) && (EAGAIN != kActualError) && (EINTR != kActualError))
+			{
+				fail(kActualError);
+			}
+			break;
+		}
+		
+		chunk.offset += kBytesWritten;
+		queuedByteCount -= kBytesWritten;
+		totalBytesWritten += kBytesWritten;
+		if (chunk.bytes.size() == chunk.offset)
+		{
+			CFAbsoluteTime const	kLatency = (CFAbsoluteTimeGetCurrent() - chunk.enqueueTime);
+			
+			
+			++chunksWritten;
+			totalWriteLatency += kLatency;
+			maximumWriteLatency = std::max(maximumWriteLatency, kLatency);
+			chunks.pop_front();
+		}
+	}
+	
+	updateDispatchState();
+}// My_WriteQueue::writeQueuedData
+
+
 My_Process::
 My_Process	(CFArrayRef			inArgumentArray,
 			 CFStringRef		inWorkingDirectory,
@@ -1964,86 +2845,95 @@ This is the data processing loop for a particular
 pseudo-terminal device, and it runs on a dedicated
 concurrent queue.  See Local_SpawnProcess().
 
-(2019.12)
+Data is read directly into the ring of the given loop
+and processed on the main queue in batches, so reads
+continue while the terminal is busy; this thread only
+waits for the main queue when the ring is full.
+
+(2023.10)
 */
 void
-threadForLocalProcessDataLoop	(void*		inDataLoopThreadContextPtr)
+threadForLocalProcessDataLoop	(std::shared_ptr< My_DataLoop > const&	inDataLoop)
 {
-	My_DataLoopThreadContextPtr		contextPtr = REINTERPRET_CAST(inDataLoopThreadContextPtr, My_DataLoopThreadContextPtr);
-	size_t const					kBufferSize = contextPtr->blockSize;
-	size_t							numberOfBytesRead = 0;
-	std::unique_ptr< UInt8[] >		dataBuffer(new UInt8[kBufferSize]);
-	UInt8*							bufferBegin = dataBuffer.get();
-	__block bool					endLoop = false;
-	__block UInt8*					processingBegin = bufferBegin;
-	UInt8*							processingPastEnd = processingBegin;
-	
-	
 	for (;;)
 	{
-		assert(processingBegin >= bufferBegin);
-		assert(processingBegin <= (bufferBegin + kBufferSize));
+		UInt8*		spanPtr = nullptr;
+		size_t		spanSize = inDataLoop->ring.returnWritableSpan(spanPtr);
+		
 		
-		if (endLoop)
+		if (inDataLoop->abandoned)
 		{
 			break;
 		}
 		
-		// There are two possible actions...read more data, or process
-		// the data that is in the buffer already.  If the processing
-		// buffer is smaller than the data buffer, then this loop will
-		// effectively stall reads until the processor catchs up.
-		if (processingPastEnd == processingBegin)
+		if (0 == spanSize)
 		{
-			// each time through the loop, read a bit more data from the
-			// pseudo-terminal device, up to the maximum limit of the buffer
-			numberOfBytesRead = read(contextPtr->masterTTY, bufferBegin, kBufferSize);
-			
-			// TEMPORARY HACK - REMOVE HIGH ASCII
-			//for (unsigned char* foo = (unsigned char*)bufferBegin; (char*)foo != (bufferBegin + kBufferSize); ++foo) { if (*foo > 127) *foo = '?'; }
-			
-			if (numberOfBytesRead <= 0)
+			// the terminal is not keeping up; wait for space, but
+			// check again after setting the flag in case the main
+			// queue freed space before it could see the flag
+			++(inDataLoop->backpressureCount);
+			inDataLoop->readerWaiting = true;
+			spanSize = inDataLoop->ring.returnWritableSpan(spanPtr);
+			if ((0 == spanSize) && (false == inDataLoop->abandoned))
 			{
-				// error or EOF (process quit)
-				endLoop = true;
+				inDataLoop->scheduleDrain();
+				dispatch_semaphore_wait(inDataLoop->spaceAvailable, DISPATCH_TIME_FOREVER);
 			}
-			else
+			else if (false == inDataLoop->readerWaiting.exchange(false))
 			{
-				// adjust the total number of bytes remaining to be processed
-				processingBegin = bufferBegin;
-				processingPastEnd = processingBegin + numberOfBytesRead;
+				// the main queue has cleared the flag so it will
+				// signal; consume that signal so the next wait works
+				dispatch_semaphore_wait(inDataLoop->spaceAvailable, DISPATCH_TIME_FOREVER);
 			}
+			continue;
 		}
-		else
+		
+		// each time through the loop, read a bit more data from the
+		// pseudo-terminal device, up to the contiguous free space;
+		// since the device is nonblocking (see My_WriteQueue), first
+		// wait until there is something to read
 		{
-			// process data via main queue (since terminal UI has to
-			// update there) and wait until the session responds
-			// before resuming the loop to process more data
-			dispatch_sync(dispatch_get_main_queue(),
-							^{
-								size_t				unprocessedSize = 0;
-								Session_Result		sessionResult = Session_AppendDataForProcessing(contextPtr->session,
-																									processingBegin,
-																									STATIC_CAST(processingPastEnd - processingBegin, size_t),
-																									&unprocessedSize);
-								
-								
-								if (sessionResult.ok())
-								{
-									processingBegin = (processingPastEnd - unprocessedSize);
-								}
-								else
-								{
-									Console_Warning(Console_WriteValue, "data-processing loop terminated, append operation error", sessionResult.code());
-									endLoop = true;
-								}
-							});
+			struct pollfd	pollInfo;
+			ssize_t			numberOfBytesRead = 0;
+			
+			
+			bzero(&pollInfo, sizeof(pollInfo));
+			pollInfo.fd = inDataLoop->masterTTY;
+			pollInfo.events = POLLIN;
+			if (-1 == poll(&pollInfo, 1/* number of descriptors */, -1/* timeout; -1 = forever */))
+			{
+				if (EINTR == errno)
+				{
+					continue;
+				}
+				// error
+				break;
+			}
+			
+			numberOfBytesRead = read(inDataLoop->masterTTY, spanPtr, spanSize);
+			if ((-1 == numberOfBytesRead) && ((EAGAIN == errno) || (EINTR == errno)))
+			{
+				// nothing to read after all; wait again
+				continue;
+			}
+			if (numberOfBytesRead <= 0)
+			{
+				// error or EOF (process quit)
+				break;
+			}
+			inDataLoop->totalBytesRead += numberOfBytesRead;
+			inDataLoop->ring.commitWrite(STATIC_CAST(numberOfBytesRead, size_t));
 		}
+		
+		// process data via main queue (since terminal UI has to update
+		// there); this does not wait, and if a batch is already pending
+		// then it will also process this data
+		inDataLoop->scheduleDrain();
 	}
 	
 	// loop terminated, ensure TTY is closed
 	{
-		int		sysResult = close(contextPtr->masterTTY);
+		int		sysResult = close(inDataLoop->masterTTY);
 		
 		
 		if (-1 == sysResult)
@@ -2055,20 +2945,22 @@ threadForLocalProcessDataLoop	(void*		inDataLoopThreadContextPtr)
 		}
 	}
 	
-	// update the state; for thread safety, this is done indirectly
-	// by posting a session-state-update event to the main queue
-	SessionRef const	kSession = contextPtr->session; // make block capture only a SessionRef and not "contextPtr"
-	dispatch_async(dispatch_get_main_queue(),
-					^{
-						if (Session_IsValid(kSession))
-						{
-							Session_SetState(kSession, kSession_StateDead);
-						}
-					});
-	
-	// since the thread is finished, dispose of dynamically-allocated memory
-	dispatch_release(contextPtr->dispatchQueue);
-	delete contextPtr;
+	// process any remaining data and then update the state; for
+	// thread safety, this is done indirectly by posting a
+	// session-state-update event to the main queue
+	{
+		std::shared_ptr< My_DataLoop > const	kDataLoop = inDataLoop; // make block capture a copy and not a reference
+		
+		
+		dispatch_async(dispatch_get_main_queue(),
+						^{
+							kDataLoop->drain(true/* until empty */);
+							if (Session_IsValid(kDataLoop->session))
+							{
+								Session_SetState(kDataLoop->session, kSession_StateDead);
+							}
+						});
+	}
 }// threadForLocalProcessDataLoop
 
 } // anonymous namespace
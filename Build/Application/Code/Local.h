@@ -118,12 +118,23 @@ void
 void
 	Local_KillProcess						(Local_ProcessRef*			inoutRefPtr);
 
+void
+	Local_ProcessDebugDumpDetailedSnapshot	(Local_ProcessRef			inProcess);
+
 Boolean
 	Local_ProcessIsInPasswordMode			(Local_ProcessRef			inProcess);
 
 Boolean
 	Local_ProcessIsStopped					(Local_ProcessRef			inProcess);
 
+void
+	Local_ProcessNotifyWhenWriteQueueEmpty	(Local_ProcessRef			inProcess,
+											 void						(^inBlock)());
+
+void
+	Local_ProcessNotifyWhenWriteQueueReady	(Local_ProcessRef			inProcess,
+											 void						(^inBlock)());
+
 CFArrayRef
 	Local_ProcessReturnCommandLine			(Local_ProcessRef			inProcess);
 
@@ -137,12 +148,23 @@ Local_TerminalID
 CFStringRef
 	Local_ProcessReturnOriginalDirectory	(Local_ProcessRef			inProcess);
 
+size_t
+	Local_ProcessReturnQueuedWriteByteCount	(Local_ProcessRef			inProcess);
+
 char const*
 	Local_ProcessReturnSlaveDeviceName		(Local_ProcessRef			inProcess);
 
 pid_t
 	Local_ProcessReturnUnixID				(Local_ProcessRef			inProcess);
 
+ssize_t
+	Local_ProcessWriteBytes					(Local_ProcessRef			inProcess,
+											 void const*				inBufferPtr,
+											 size_t						inByteCount);
+
+Boolean
+	Local_ProcessWriteQueueIsFull			(Local_ProcessRef			inProcess);
+
 //@}
 
 //!\name Manipulating Pseudo-Terminals
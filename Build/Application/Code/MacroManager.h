@@ -83,6 +83,7 @@ Possible return values from MacroManager module routines.
 typedef ResultCode< UInt16 >	MacroManager_Result;
 MacroManager_Result const	kMacroManager_ResultOK(0);					//!< no error
 MacroManager_Result const	kMacroManager_ResultGenericFailure(1);		//!< unspecified error occurred
+MacroManager_Result const	kMacroManager_ResultBusy(2);				//!< target session is still sending earlier input; try again later
 
 /*!
 Used with MacroManager_StartMonitoring() and MacroManager_StopMonitoring()
@@ -702,6 +702,10 @@ session, if none is provided).
 \retval kMacroManager_ResultOK
 if no error occurred
 
+\retval kMacroManager_ResultBusy
+if the macro sends text but the session has too much input
+waiting to be sent already (see Session_SendQueueIsFull())
+
 \retval kMacroManager_ResultGenericFailure
 if any error occurred
 
@@ -751,8 +755,17 @@ MacroManager_UserInputMacro		(UInt16						inZeroBasedMacroIndex,
 					// send string to the session as-is
 					if (nullptr != session)
 					{
-						Session_UserInputCFString(session, actionCFString);
-						result = kMacroManager_ResultOK;
+						if (Session_SendQueueIsFull(session))
+						{
+							// the process is not reading its input quickly enough;
+							// refuse the macro instead of queueing even more data
+							result = kMacroManager_ResultBusy;
+						}
+						else
+						{
+							Session_UserInputCFString(session, actionCFString);
+							result = kMacroManager_ResultOK;
+						}
 					}
 					break;
 				
@@ -760,14 +773,20 @@ MacroManager_UserInputMacro		(UInt16						inZeroBasedMacroIndex,
 					// find string as-is without performing substitutions
 					if (nullptr != session)
 					{
-						UNUSED_RETURN(NSUInteger)FindDialog_SearchWithoutDialog(actionCFString, Session_ReturnActiveTerminalWindow(session),
-																				kFindDialog_OptionsAllOff);
+						FindDialog_SearchWithoutDialog(actionCFString, Session_ReturnActiveTerminalWindow(session),
+														kFindDialog_OptionsAllOff);
 						result = kMacroManager_ResultOK;
 					}
 					break;
 				
 				case kMacroManager_ActionSendTextProcessingEscapes:
-					if (nullptr != session)
+					if ((nullptr != session) && Session_SendQueueIsFull(session))
+					{
+						// the process is not reading its input quickly enough;
+						// refuse the macro instead of queueing even more data
+						result = kMacroManager_ResultBusy;
+					}
+					else if (nullptr != session)
 					{
 						CFRetainRelease		finalCFString(returnStringCopyWithSubstitutions(actionCFString, session), CFRetainRelease::kAlreadyRetained);
 						
@@ -800,8 +819,8 @@ MacroManager_UserInputMacro		(UInt16						inZeroBasedMacroIndex,
 						else
 						{
 							// perform a search with the edited string
-							UNUSED_RETURN(NSUInteger)FindDialog_SearchWithoutDialog(finalCFString.returnCFStringRef(), Session_ReturnActiveTerminalWindow(session),
-																					kFindDialog_OptionsAllOff);
+							FindDialog_SearchWithoutDialog(finalCFString.returnCFStringRef(), Session_ReturnActiveTerminalWindow(session),
+															kFindDialog_OptionsAllOff);
 							result = kMacroManager_ResultOK;
 						}
 					}
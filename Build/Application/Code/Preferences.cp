@@ -933,6 +933,9 @@ Preferences_Init ()
 										CFSTR("terminal-cursor-auto-move-on-drop"), Quills::Prefs::GENERAL);
 	My_PreferenceDefinition::createFlag(kPreferences_TagDataReceiveDoNotStripHighBit,
 										CFSTR("data-receive-do-not-strip-high-bit"), Quills::Prefs::TERMINAL);
+	My_PreferenceDefinition::create(kPreferences_TagDataReceiveQueueSize,
+									CFSTR("data-receive-queue-size-kilobytes"), kPreferences_DataTypeCFNumberRef,
+									sizeof(UInt32), Quills::Prefs::GENERAL);
 	My_PreferenceDefinition::create(kPreferences_TagDataReadBufferSize,
 									CFSTR("data-receive-buffer-size-bytes"), kPreferences_DataTypeCFNumberRef,
 									sizeof(SInt16), Quills::Prefs::SESSION);
@@ -1206,6 +1209,8 @@ Preferences_Init ()
 	My_PreferenceDefinition::create(kPreferences_TagTerminalScreenScrollbackRows,
 									CFSTR("terminal-scrollback-size-lines"), kPreferences_DataTypeCFNumberRef,
 									sizeof(UInt32), Quills::Prefs::TERMINAL);
+	My_PreferenceDefinition::createFlag(kPreferences_TagTerminalScreenScrollbackSearchIndex,
+										CFSTR("terminal-scrollback-enable-search-index"), Quills::Prefs::TERMINAL);
 	My_PreferenceDefinition::create(kPreferences_TagTerminalScreenScrollbackType,
 									CFSTR("terminal-scrollback-type"), kPreferences_DataTypeCFStringRef,
 									sizeof(UInt16), Quills::Prefs::TERMINAL);
@@ -6654,6 +6659,31 @@ getGeneralPreference	(My_ContextInterfaceConstPtr	inContextPtr,
 					}
 					break;
 				
+				case kPreferences_TagDataReceiveQueueSize:
+					assert(kPreferences_DataTypeCFNumberRef == keyValueType);
+					if (false == inContextPtr->exists(keyName))
+					{
+						result = kPreferences_ResultBadVersionDataNotAvailable;
+					}
+					else
+					{
+						SInt32 const	kValueInteger = inContextPtr->returnLong(keyName);
+						UInt32* const	data = REINTERPRET_CAST(outDataPtr, UInt32*);
+						
+						
+						if (kValueInteger <= 0)
+						{
+							// failed; make default
+							*data = 1024; // arbitrary
+							result = kPreferences_ResultBadVersionDataNotAvailable;
+						}
+						else
+						{
+							*data = STATIC_CAST(kValueInteger, UInt32);
+						}
+					}
+					break;
+				
 				case kPreferences_TagKioskAllowsForceQuit:
 				case kPreferences_TagKioskShowsMenuBar:
 				case kPreferences_TagKioskShowsScrollBar:
@@ -8061,6 +8091,7 @@ getTerminalPreference	(My_ContextInterfaceConstPtr	inContextPtr,
 				case kPreferences_TagTerminal24BitColorEnabled:
 				case kPreferences_TagTerminalClearSavesLines:
 				case kPreferences_TagTerminalLineWrap:
+				case kPreferences_TagTerminalScreenScrollbackSearchIndex:
 				case kPreferences_TagVT100FixLineWrappingBug:
 				case kPreferences_TagXTerm256ColorsEnabled:
 				case kPreferences_TagXTermBackgroundColorEraseEnabled:
@@ -9263,6 +9294,21 @@ setGeneralPreference	(My_ContextInterfacePtr		inContextPtr,
 				}
 				break;
 			
+			case kPreferences_TagDataReceiveQueueSize:
+				{
+					SInt32 const	data = STATIC_CAST(*(REINTERPRET_CAST(inDataPtr, UInt32 const*)), SInt32);
+					CFNumberRef		numberRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &data);
+					
+					
+					if (nullptr != numberRef)
+					{
+						assert(kPreferences_DataTypeCFNumberRef == keyValueType);
+						setApplicationPreference(keyName, numberRef);
+						CFRelease(numberRef), numberRef = nullptr;
+					}
+				}
+				break;
+			
 			case kPreferences_TagDontAutoClose:
 				{
 					Boolean const	data = *(REINTERPRET_CAST(inDataPtr, Boolean const*));
@@ -10488,6 +10534,7 @@ setTerminalPreference	(My_ContextInterfacePtr		inContextPtr,
 			case kPreferences_TagTerminal24BitColorEnabled:
 			case kPreferences_TagTerminalClearSavesLines:
 			case kPreferences_TagTerminalLineWrap:
+			case kPreferences_TagTerminalScreenScrollbackSearchIndex:
 			case kPreferences_TagVT100FixLineWrappingBug:
 			case kPreferences_TagXTerm256ColorsEnabled:
 			case kPreferences_TagXTermBackgroundColorEraseEnabled:
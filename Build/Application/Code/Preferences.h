@@ -215,6 +215,7 @@ enum
 	kPreferences_TagCopyTableThreshold					= 'ctth',	//!< data: "UInt16", the number of spaces per tab
 	kPreferences_TagCursorBlinks						= 'curf',	//!< data: "Boolean"
 	kPreferences_TagCursorMovesPriorToDrops				= 'curm',	//!< data: "Boolean"
+	kPreferences_TagDataReceiveQueueSize				= 'rdqs',	//!< data: "UInt32", size in kilobytes of the queue between a process and its terminal
 	kPreferences_TagDontAutoClose						= 'wdga',	//!< data: "Boolean"
 	kPreferences_TagDontAutoNewOnApplicationReopen		= 'nonu',	//!< data: "Boolean"
 	kPreferences_TagDontDimBackgroundScreens			= 'wddb',	//!< data: "Boolean"
@@ -328,6 +329,7 @@ enum
 	kPreferences_TagTerminalScreenColumns				= 'scol',	//!< data: "UInt16"
 	kPreferences_TagTerminalScreenRows					= 'srow',	//!< data: "UInt16"
 	kPreferences_TagTerminalScreenScrollbackRows		= 'scrb',	//!< data: "UInt32"
+	kPreferences_TagTerminalScreenScrollbackSearchIndex	= 'scsi',	//!< data: "Boolean"
 	kPreferences_TagTerminalScreenScrollbackType		= 'scrt',	//!< data: "UInt16" (Terminal_ScrollbackType)
 	kPreferences_TagVT100FixLineWrappingBug				= 'vlwr',	//!< data: "Boolean"
 	kPreferences_TagXTermBackgroundColorEraseEnabled	= 'xbce',	//!< data: "Boolean"
@@ -356,6 +356,9 @@ Boolean
 Session_Result
 	Session_Select							(SessionRef							inRef);
 
+void
+	Session_UserInputCancelPaste			(SessionRef							inRef);
+
 void
 	Session_UserInputCFString				(SessionRef							inRef,
 											 CFStringRef						inStringBuffer);
@@ -439,7 +442,7 @@ Session_Result
 void
 	Session_FlushNetwork					(SessionRef							inRef);
 
-SInt16
+ssize_t
 	Session_SendData						(SessionRef							inRef,
 											 void const*						inBufferPtr,
 											 size_t								inByteCount);
@@ -456,6 +459,17 @@ void
 SInt16
 	Session_SendFlush						(SessionRef							inRef);
 
+Boolean
+	Session_SendQueueIsFull					(SessionRef							inRef);
+
+void
+	Session_SendQueueNotifyWhenEmpty		(SessionRef							inRef,
+											 void								(^inBlock)());
+
+void
+	Session_SendQueueNotifyWhenReady		(SessionRef							inRef,
+											 void								(^inBlock)());
+
 void
 	Session_SendNewline						(SessionRef							inRef,
 											 Session_Echo						inEcho);
@@ -643,4 +657,12 @@ void
 
 //@}
 
+//!\name Debugging
+//@{
+
+void
+	Session_DebugDumpDetailedSnapshot		(SessionRef							inRef);
+
+//@}
+
 // BELOW IS REQUIRED NEWLINE TO END FILE
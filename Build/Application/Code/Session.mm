@@ -45,6 +45,7 @@
 // standard-C++ includes
 #import <algorithm>
 #import <map>
+#import <memory>
 #import <set>
 #import <vector>
 
@@ -71,6 +72,7 @@
 #import <RegionUtilities.h>
 #import <SoundSystem.h>
 #import <StringUtilities.h>
+#import <UTF8Encoder.h>
 #import <WindowTitleDialog.h>
 
 // application includes
@@ -116,6 +118,11 @@ enum My_SessionSheetType
 	kMy_SessionSheetTypeSpecialKeySequences		= 1
 };
 
+CFIndex const			kMy_PasteChunkLengthMinimum = 256;		//!< UTF-16 values sent in the first chunk of a Paste, and for slow readers
+CFIndex const			kMy_PasteChunkLengthMaximum = 65536;	//!< largest number of UTF-16 values sent in one chunk of a Paste
+CFAbsoluteTime const	kMy_PasteFastDrainTime = 0.02;			//!< seconds; if a chunk is read this quickly, the next chunk is larger
+CFAbsoluteTime const	kMy_PasteSlowDrainTime = 0.1;			//!< seconds; if a chunk takes this long to read, the next chunk is smaller
+
 } // anonymous namespace
 
 
@@ -166,6 +173,27 @@ typedef std::vector< TerminalScreenRef >		My_TerminalScreenList;
 
 typedef std::set< VectorWindow_Ref >			My_VectorWindowSet;
 
+/*!
+A Paste that is still being sent to a session.  The text is
+not split into lines in advance; instead, the job remembers
+how much has been sent, and continuePaste() sends the next
+chunk only once the process has read all of the previous
+one.  This keeps memory use constant for any size of Paste
+and lets the rate follow how quickly the process reads.
+*/
+struct My_PasteJob
+{
+	NSString* __strong						text;				//!< everything that is being pasted
+	CFIndex									position;			//!< index into "text" of the first UTF-16 value not yet sent
+	CFIndex									chunkLength;		//!< number of UTF-16 values to send next; adapts to the process
+	CFAbsoluteTime							chunkSendTime;		//!< when the most recent chunk was sent
+	Preferences_TimeInterval				chunkDelay;			//!< additional pause between chunks (from user preferences)
+	Boolean									joinLines;			//!< if true, lines are separated by spaces instead of new-lines
+	Boolean									bracketed;			//!< if true, the text is surrounded by bracketed-paste sequences
+	Boolean									canceled;			//!< if true, the rest of the text is discarded
+	TerminalWindow_InfoBubble* __strong		progressBubble;		//!< displays the progress of a long Paste
+};
+
 /*!
 The data structure that is known as a "SessionRef" to
 any code outside this module.  See Session_New().
@@ -222,6 +250,7 @@ struct My_Session
 	size_t						readBufferSizeInUse;		// number of bytes of data currently in the read buffer
 	std::unique_ptr< UInt8[] >	readBufferPtr;				// buffer space for processing data
 	CFStringEncoding			writeEncoding;				// the character set that text (data) sent to a session should be using
+	std::unique_ptr< My_PasteJob >	pasteJob;				// if defined, a Paste that has not been completely sent yet
 	Session_Watch				activeWatch;				// if any, what notification is currently set up for internal data events
 	NSTimer* __strong			inactivityWatchTimer;		// called if data has not arrived after awhile; retain in order to invalidate at destruction time
 	Preferences_ContextWrap		recentSheetContext;			// defined temporarily while a Preferences-dependent sheet (such as key sequences) is up
@@ -261,6 +290,7 @@ void						changeNotifyForSession				(My_SessionPtr, Session_Change, void*);
 void						changeStateAttributes				(My_SessionPtr, Session_StateAttributes,
 																 Session_StateAttributes);
 void						closeTerminalWindow					(My_SessionPtr);
+void						continuePaste						(SessionRef);
 UInt16						copyAutoCapturePreferences			(My_SessionPtr, Preferences_ContextRef, Boolean);
 UInt16						copyEventKeyPreferences				(My_SessionPtr, Preferences_ContextRef, Boolean);
 UInt16						copyVectorGraphicsPreferences		(My_SessionPtr, Preferences_ContextRef, Boolean);
@@ -277,6 +307,7 @@ void						sheetClosed							(GenericDialog_Ref, Boolean);
 Preferences_ContextRef		sheetContextBegin					(My_SessionPtr, Quills::Prefs::Class,
 																 My_SessionSheetType);
 void						sheetContextEnd						(My_SessionPtr);
+void						startPaste							(My_SessionPtr, NSString*, Boolean, Boolean);
 void						terminalHoverLocalEchoString		(My_SessionPtr, UInt8 const*, size_t);
 void						terminalInsertLocalEchoString		(My_SessionPtr, UInt8 const*, size_t);
 void						terminalViewChanged					(ListenerModel_Ref, ListenerModel_Event,
@@ -665,6 +696,31 @@ Session_AppendDataForProcessing		(SessionRef		inRef,
 }// AppendDataForProcessing
 
 
+/*!
+Writes arbitrary debugging information to the console for the
+specified session, including the state of any local process.
+
+(2023.10)
+*/
+void
+Session_DebugDumpDetailedSnapshot	(SessionRef		inRef)
+{
+	My_SessionAutoLocker	ptr(gSessionPtrLocks(), inRef);
+	
+	
+	Console_WriteValue("Read buffer: bytes in use", ptr->readBufferSizeInUse);
+	Console_WriteValue("Read buffer: maximum bytes", ptr->readBufferSizeMaximum);
+	if (nullptr == ptr->mainProcess)
+	{
+		Console_WriteLine("No local process is defined.");
+	}
+	else
+	{
+		Local_ProcessDebugDumpDetailedSnapshot(ptr->mainProcess);
+	}
+}// DebugDumpDetailedSnapshot
+
+
 /*!
 Displays a Save dialog for a capture file based on the
 contents of the given terminal window, handling the user’s
@@ -1909,11 +1965,16 @@ Session_Select	(SessionRef		inRef)
 /*!
 Adds the specified data to a buffer, which will be sent to the
 local or remote process for the given session when the receiver
-is ready.
+is ready.  This never waits for the receiver.
 
-Returns the number of bytes actually written; if this number is
-less than "inByteCount", offset the buffer by the difference
-and try again to send the rest.
+Returns the number of bytes actually written or queued; if this
+number is less than "inByteCount", offset the buffer by the
+difference and try again to send the rest.
+
+Data is accepted even when the receiver is slow; so, if you are
+sending a lot of data, check Session_SendQueueIsFull() and (if
+necessary) use Session_SendQueueNotifyWhenReady() to send the
+rest at a better time.
 
 See also Session_SendDataCFString().
 
@@ -1927,20 +1988,18 @@ WARNING:	This is a “raw” write function that does not give
 
 (3.0)
 */
-SInt16
+ssize_t
 Session_SendData	(SessionRef		inRef,
 					 void const*	inBufferPtr,
 					 size_t			inByteCount)
 {
 	My_SessionAutoLocker	ptr(gSessionPtrLocks(), inRef);
-	SInt16					result = 0;
+	ssize_t					result = 0;
 	
 	
 	if (nullptr != ptr->mainProcess)
 	{
-		result = STATIC_CAST(Local_TerminalWriteBytes(Local_ProcessReturnMasterTerminal(ptr->mainProcess),
-														inBufferPtr, inByteCount),
-								SInt16);
+		result = Local_ProcessWriteBytes(ptr->mainProcess, inBufferPtr, inByteCount);
 	}
 	return result;
 }// SendData
@@ -1957,10 +2016,11 @@ available (in the CFString), it converts the data into the
 target encoding and sends the new format as a raw stream of
 bytes.  The assumption is that the application running in
 the terminal will know how to decode the data in the format
-that the user has selected for the session.  If the string
-appears to be in the target encoding already, this might be
-done efficiently; note however that radically different text
-encodings will incur significant translation costs.
+that the user has selected for the session.  Text is converted
+in large runs: directly by UTF8Encoder_EncodeRun() if the target
+is UTF-8 (the usual case), and otherwise by the system; note
+however that radically different text encodings will incur
+significant translation costs.
 
 This function now guarantees that the transmitted bytes fall
 on character boundaries; so, although it may return before
@@ -1982,89 +2042,72 @@ Session_SendDataCFString	(SessionRef		inRef,
 							 CFIndex		inFirstCharacter)
 {
 	CFIndex const			kLength = CFStringGetLength(inString);
+	CFIndex const			kChunkLength = 4096; // arbitrary; number of UTF-16 values converted at once
 	My_SessionAutoLocker	ptr(gSessionPtrLocks(), inRef);
-	CFRange					targetRange = CFRangeMake(0, 1/* count */);
-	UInt8					byteArray[1024]; // arbitrary size
-	UInt8*					currentPtr = byteArray;
-	size_t					sizeRemaining = sizeof(byteArray);
+	UniChar const*			directCharacters = CFStringGetCharactersPtr(inString);
+	Boolean					stopped = false;
 	CFIndex					result = 0;
 	
 	
-	// convert characters one at a time, so that it is possible to ensure
-	// that all the bytes for a character have been sent (even if the
-	// whole string cannot be sent successfully)
-	for (targetRange.location = inFirstCharacter; targetRange.location < kLength; )
+	// convert large ranges at once (but only whole characters, so that
+	// all the bytes for a character are sent even if the whole string
+	// cannot be sent successfully)
+	for (CFIndex location = inFirstCharacter; ((false == stopped) && (location < kLength)); )
 	{
-		CFIndex		bytesForChar = 0;
+		UInt8		byteArray[kChunkLength * kUTF8Encoder_MaximumBytesPerUniChar];
+		CFIndex		chunkLength = std::min(kLength - location, kChunkLength);
 		CFIndex		numberOfCharactersConverted = 0;
+		CFIndex		byteCount = 0;
 		
 		
-		// initially look for a single character
-		targetRange.length = 1;
-		
-		// IMPORTANT: Although CFStringGetBytes() ought to accept a zero-length buffer,
-		// it appears that actually giving that function a length of zero makes it
-		// return a nonzero number of “bytes used”.  Not only would that violate the
-		// assertion that follows, but it calls into question just what the heck might
-		// have happened to the buffer and its surrounding memory!  A preemptive check
-		// is done to avoid this problem.
-		if (sizeRemaining > 0)
+		if (kCFStringEncodingUTF8 == ptr->writeEncoding)
 		{
-			numberOfCharactersConverted = CFStringGetBytes(inString, targetRange, ptr->writeEncoding,
-															0/* loss byte, or 0 for no lossy conversion */,
-															false/* is external representation */,
-															currentPtr, sizeRemaining, &bytesForChar);
-			if (0 == numberOfCharactersConverted)
-			{
-				// not all values can be represented as a single character;
-				// if a single-character conversion is not possible, try to
-				// request more than one character at a time
-				targetRange.length = 2;
-				numberOfCharactersConverted = CFStringGetBytes(inString, targetRange, ptr->writeEncoding,
-																0/* loss byte, or 0 for no lossy conversion */,
-																false/* is external representation */,
-																currentPtr, sizeRemaining, &bytesForChar);
+			// the most common case is encoded directly (and, if possible,
+			// without copying the string); note that the encoder never
+			// ends a run between the two halves of a surrogate pair
+			UniChar			characterArray[kChunkLength];
+			UniChar const*	chunkCharacters = characterArray;
+			size_t			textLengthUsed = 0;
+			
+			
+			if (nullptr == directCharacters)
+			{
+				CFStringGetCharacters(inString, CFRangeMake(location, chunkLength), characterArray);
+			}
+			else
+			{
+				chunkCharacters = (directCharacters + location);
 			}
+			byteCount = STATIC_CAST(UTF8Encoder_EncodeRun(chunkCharacters, chunkLength, byteArray, sizeof(byteArray), textLengthUsed),
+									CFIndex);
+			numberOfCharactersConverted = STATIC_CAST(textLengthUsed, CFIndex);
 		}
-		
-		if (numberOfCharactersConverted > 0)
+		else
 		{
-			assert(sizeRemaining >= STATIC_CAST(bytesForChar, size_t));
-			sizeRemaining -= bytesForChar;
-			currentPtr += bytesForChar;
-			result += targetRange.length;
-			targetRange.location += targetRange.length;
+			// never end a range between the two halves of a surrogate pair
+			if (((location + chunkLength) < kLength) && (chunkLength > 1) &&
+				CFStringIsSurrogateHighCharacter(CFStringGetCharacterAtIndex(inString, location + chunkLength - 1)))
+			{
+				--chunkLength;
+			}
+			numberOfCharactersConverted = CFStringGetBytes(inString, CFRangeMake(location, chunkLength), ptr->writeEncoding,
+															0/* loss byte, or 0 for no lossy conversion */,
+															false/* is external representation */,
+															byteArray, sizeof(byteArray), &byteCount);
 		}
 		
+		// if nothing could be converted, the next character cannot be
+		// represented in the target encoding; and if the data is not
+		// accepted, the session has no process to send it to
 		if ((0 == numberOfCharactersConverted) ||
-			(sizeRemaining < 4/* arbitrary */) ||
-			(targetRange.location >= kLength))
+			(Session_SendData(inRef, byteArray, byteCount) != byteCount))
 		{
-			// send what has been accumulated, and then reset the pointer
-			size_t		bytesLeft = sizeof(byteArray) - sizeRemaining;
-			size_t		bytesWritten = 0;
-			
-			
-			currentPtr = byteArray;
-			while (bytesLeft > 0)
-			{
-				bytesWritten = Session_SendData(inRef, currentPtr, bytesLeft);
-				if (bytesWritten > 0)
-				{
-					assert(bytesLeft >= bytesWritten);
-					bytesLeft -= bytesWritten;
-					currentPtr += bytesWritten;
-				}
-			}
-			currentPtr = byteArray;
-			sizeRemaining = sizeof(byteArray);
+			stopped = true;
 		}
-		
-		// if the most recent conversion attempt failed, it will
-		// only fail again if the loop is allowed to continue
-		if (0 == numberOfCharactersConverted)
+		else
 		{
-			break;
+			location += numberOfCharactersConverted;
+			result += numberOfCharactersConverted;
 		}
 	}
 	return result;
@@ -2215,6 +2258,87 @@ Session_SendNewline		(SessionRef		inRef,
 }// SendNewline
 
 
+/*!
+Returns true only if so much data is waiting to be sent to
+the session’s process that senders of a lot of data (such as
+a Paste or a macro) should wait before they send more; see
+Session_SendQueueNotifyWhenReady().  Data is still accepted
+by Session_SendData() in the meantime.
+
+(2023.10)
+*/
+Boolean
+Session_SendQueueIsFull		(SessionRef		inRef)
+{
+	My_SessionAutoLocker	ptr(gSessionPtrLocks(), inRef);
+	Boolean					result = false;
+	
+	
+	if (nullptr != ptr->mainProcess)
+	{
+		result = Local_ProcessWriteQueueIsFull(ptr->mainProcess);
+	}
+	return result;
+}// SendQueueIsFull
+
+
+/*!
+Arranges for the given block to run on the main queue as soon
+as the session’s process has accepted all data that has been
+sent to it (which may be right away).  Blocks run in the order
+they are given.
+
+The time that this takes is a measure of how quickly the
+process is reading, so a sender can use it to decide how much
+to send next (as a Paste does).
+
+(2023.10)
+*/
+void
+Session_SendQueueNotifyWhenEmpty	(SessionRef		inRef,
+									 void			(^inBlock)())
+{
+	My_SessionAutoLocker	ptr(gSessionPtrLocks(), inRef);
+	
+	
+	if (nullptr == ptr->mainProcess)
+	{
+		dispatch_async(dispatch_get_main_queue(), inBlock);
+	}
+	else
+	{
+		Local_ProcessNotifyWhenWriteQueueEmpty(ptr->mainProcess, inBlock);
+	}
+}// SendQueueNotifyWhenEmpty
+
+
+/*!
+Arranges for the given block to run on the main queue as soon
+as Session_SendQueueIsFull() is false (which may be right
+away).  Blocks run in the order they are given, so a sender
+can split a lot of data into pieces and give each piece to a
+separate block without changing the order of the data.
+
+(2023.10)
+*/
+void
+Session_SendQueueNotifyWhenReady	(SessionRef		inRef,
+									 void			(^inBlock)())
+{
+	My_SessionAutoLocker	ptr(gSessionPtrLocks(), inRef);
+	
+	
+	if (nullptr == ptr->mainProcess)
+	{
+		dispatch_async(dispatch_get_main_queue(), inBlock);
+	}
+	else
+	{
+		Local_ProcessNotifyWhenWriteQueueReady(ptr->mainProcess, inBlock);
+	}
+}// SendQueueNotifyWhenReady
+
+
 /*!
 Changes the keys used as short-cuts for various events.
 See the documentation on Session_EventKeys for more
@@ -2324,7 +2448,7 @@ Session_SetNetworkSuspended		(SessionRef		inRef,
 			UInt8		charToSend = STATIC_CAST
 										(Local_TerminalReturnFlowStopCharacter
 											(Local_ProcessReturnMasterTerminal(ptr->mainProcess)), UInt8);
-			SInt16		bytesSent = Session_SendData(inRef, &charToSend, 1/* number of bytes */);
+			ssize_t		bytesSent = Session_SendData(inRef, &charToSend, 1/* number of bytes */);
 			
 			
 			if (bytesSent < 1)
@@ -2344,7 +2468,7 @@ Session_SetNetworkSuspended		(SessionRef		inRef,
 			UInt8		charToSend = STATIC_CAST
 										(Local_TerminalReturnFlowStartCharacter
 											(Local_ProcessReturnMasterTerminal(ptr->mainProcess)), UInt8);
-			SInt16		bytesSent = Session_SendData(inRef, &charToSend, 1/* number of bytes */);
+			ssize_t		bytesSent = Session_SendData(inRef, &charToSend, 1/* number of bytes */);
 			
 			
 			if (bytesSent < 1)
@@ -3257,6 +3381,29 @@ Session_TypeIsLocalNonLoginShell	(SessionRef		inRef)
 }// TypeIsLocalNonLoginShell
 
 
+/*!
+Stops a Paste that is still being sent to the session (see
+Session_UserInputPaste()); the rest of the text is discarded.
+If the terminal uses bracketed-paste mode, the sequence that
+ends the Paste is still sent.  Has no effect if there is no
+Paste in progress.
+
+(2023.10)
+*/
+void
+Session_UserInputCancelPaste	(SessionRef		inRef)
+{
+	My_SessionAutoLocker	ptr(gSessionPtrLocks(), inRef);
+	
+	
+	if (nullptr != ptr->pasteJob)
+	{
+		// the job notices this the next time that it runs
+		ptr->pasteJob->canceled = true;
+	}
+}// UserInputCancelPaste
+
+
 /*!
 Send a string to a session as if it were typed into the given
 session’s window.  Any previous pending output is first flushed
@@ -3264,9 +3411,11 @@ to the session.  If local echoing is enabled for the session,
 the string will be written to the local data target (usually a
 terminal) before it is sent to the underlying process.
 
-This function will block until every character in the string
-has been sent to the session.  To have more direct control over
-the data transmission rate, see Session_SendData().
+This function returns once every character in the string has
+been given to the session, but it does not wait for the process
+to read them (see Session_SendQueueIsFull()).  To have more
+direct control over the data transmission rate, see
+Session_SendData().
 
 (3.0)
 */
@@ -3311,7 +3460,7 @@ Session_UserInputCFString	(SessionRef		inRef,
 Send input to the session to interrupt whatever
 process is running.  For local sessions, this means
 to send control-C (or whatever the interrupt control
-key is).
+key is).  Any Paste in progress is also canceled.
 
 (3.1)
 */
@@ -3322,6 +3471,9 @@ Session_UserInputInterruptProcess	(SessionRef		inRef)
 	// since the process already considers the pipe reopened
 	Session_SetNetworkSuspended(inRef, false);
 	
+	// do not send anything more from a Paste
+	Session_UserInputCancelPaste(inRef);
+	
 	// send character to Unix process
 	{
 		My_SessionAutoLocker	ptr(gSessionPtrLocks(), inRef);
@@ -3345,7 +3497,7 @@ Session_UserInputInterruptProcess	(SessionRef		inRef)
 			UInt8		charToSend = STATIC_CAST
 										(Local_TerminalReturnInterruptCharacter
 											(Local_ProcessReturnMasterTerminal(ptr->mainProcess)), UInt8);
-			SInt16		bytesSent = Session_SendData(inRef, &charToSend, 1/* number of bytes */);
+			ssize_t		bytesSent = Session_SendData(inRef, &charToSend, 1/* number of bytes */);
 			
 			
 			if (bytesSent < 1)
@@ -4618,6 +4770,11 @@ text is multi-line, the user is warned and given options on how
 to perform the Paste.  This also means that this function could
 return before the Paste actually occurs.
 
+Text is sent gradually, at the rate that the process reads it
+(see continuePaste()), so a large Paste may take some time; it
+displays its progress, and Session_UserInputCancelPaste() will
+stop it.  Only one Paste at a time is allowed for a session.
+
 IMPORTANT:	This returns a result immediately based on the
 			viability of the pasteboard data but the actual
 			Paste could happen at any time (for example, it
@@ -4629,6 +4786,9 @@ pasteboard contained data that was possible to paste
 \retval kSession_ResultParameterError
 pasteboard did not contain usable data
 
+\retval kSession_ResultNotReady
+a previous Paste is still being sent to the session
+
 (2018.08)
 */
 Session_Result
@@ -4639,17 +4799,25 @@ Session_UserInputPaste	(SessionRef		inRef,
 											? [NSPasteboard generalPasteboard]
 											: inSourceOrNull;
 	My_SessionAutoLocker	ptr(gSessionPtrLocks(), inRef);
-	CFArrayRef				pendingLines = nullptr;
+	CFStringRef				pendingText = nullptr;
 	TerminalWindowRef		terminalWindow = Session_ReturnActiveTerminalWindow(inRef);
 	TerminalScreenRef		screenBuffer = TerminalWindow_ReturnScreenWithFocus(terminalWindow);
 	Boolean					isBracketedPaste = Terminal_PasteIsBracketed(screenBuffer);
 	Session_Result			result = kSession_ResultParameterError;
 	
 	
-	if (Clipboard_CreateCFStringArrayFromPasteboard(pendingLines, kPasteboard))
+	if (nullptr != ptr->pasteJob)
+	{
+		// the order of pasted text must be preserved, and a new
+		// Paste cannot be inserted into the middle of another
+		Sound_StandardAlert();
+		result = kSession_ResultNotReady;
+	}
+	else if (Clipboard_CreateCFStringFromPasteboard(pendingText, kPasteboard))
 	{
 		// convert to Objective-C object reference for better implicit behavior in blocks
-		NSArray*	blockPendingLines = BRIDGE_CAST(pendingLines, NSArray*);
+		NSString*	blockPendingText = BRIDGE_CAST(pendingText, NSString*);
+		CFIndex		firstLineEnd = 0;
 		Boolean		isOneLine = false;
 		Boolean		noWarning = false;
 		
@@ -4658,7 +4826,9 @@ Session_UserInputPaste	(SessionRef		inRef,
 		result = kSession_ResultOK;
 		
 		// examine the Clipboard; if the data contains new-lines, warn the user
-		isOneLine = (blockPendingLines.count < 2);
+		// (a new-line that only ends the text does not count)
+		CFStringGetLineBounds(pendingText, CFRangeMake(0, 0), nullptr/* line start */, &firstLineEnd, nullptr/* contents end */);
+		isOneLine = (firstLineEnd >= CFStringGetLength(pendingText));
 		
 		// determine if the user should be warned
 		if (isBracketedPaste)
@@ -4678,106 +4848,20 @@ Session_UserInputPaste	(SessionRef		inRef,
 		// now, paste (perhaps displaying a warning first)
 		{
 			AlertMessages_BoxWrap	box;
-			auto					sendPasteBracket =
-									^(BOOL	inIsOpenBracket)
-									{
-										if (inIsOpenBracket)
-										{
-											char const*		bracket = "\033[200~";
-											size_t const	length = CPP_STD::strlen(bracket);
-											
-											
-											UNUSED_RETURN(SInt16)Session_SendData(inRef, bracket, length);
-										}
-										else
-										{
-											char const*		bracket = "\033[201~";
-											size_t const	length = CPP_STD::strlen(bracket);
-											
-											
-											UNUSED_RETURN(SInt16)Session_SendData(inRef, bracket, length);
-										}
-									};
 			auto					joinResponder =
 									^{
-										// first join the text into one line (replace new-line sequences
-										// with single spaces), then Paste
-										NSString*	joinedString = [blockPendingLines componentsJoinedByString:@" "];
+										// replace new-line sequences with single spaces
+										My_SessionAutoLocker	blockPtr(gSessionPtrLocks(), inRef);
 										
 										
-										if (isBracketedPaste)
-										{
-											sendPasteBracket(true/* open */);
-										}
-										Session_UserInputCFString(inRef, BRIDGE_CAST(joinedString, CFStringRef));
-										if (isBracketedPaste)
-										{
-											sendPasteBracket(false/* open */);
-										}
+										startPaste(blockPtr, blockPendingText, true/* join lines */, isBracketedPaste);
 									};
 			auto					normalPasteResponder =
 									^{
-										CFIndex								lineCount = blockPendingLines.count;
-										CFIndex								dispatchIndex = 0;
-										__block CFIndex						lineIndex = 0;
-										__block Preferences_TimeInterval	pasteDelaySoFar = 0;
-										Preferences_Result					prefsResult = kPreferences_ResultOK;
-										Preferences_TimeInterval			delayValue = 0;
-										dispatch_queue_t					targetQueue = dispatch_get_main_queue();
+										My_SessionAutoLocker	blockPtr(gSessionPtrLocks(), inRef);
 										
 										
-										// determine how long the delay between lines should be
-										prefsResult = Preferences_GetData(kPreferences_TagPasteNewLineDelay, sizeof(delayValue),
-																			&delayValue);
-										if (kPreferences_ResultOK != prefsResult)
-										{
-											// set an arbitrary default value
-											delayValue = 50 * kPreferences_TimeIntervalMillisecond;
-										}
-										
-										// regular Paste; periodically insert each line into the session,
-										// dispatching each line-send at a multiple of the user-preferred
-										// delay time in the same queue; also, in the event of very large
-										// pastes, force an even greater delay at a longer period
-										if (isBracketedPaste)
-										{
-											dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 0),
-															targetQueue,
-															^{
-																sendPasteBracket(true/* open */);
-															});
-										}
-										for (NSString* aString in blockPendingLines)
-										{
-											++dispatchIndex;
-											pasteDelaySoFar = (dispatchIndex * STATIC_CAST(delayValue / kPreferences_TimeIntervalNanosecond, int64_t));
-											// TEMPORARY; create low-level preferences for these additional delay intervals
-											if (0 == (dispatchIndex % 40/* arbitrary */))
-											{
-												// for very large pastes, insert an additional delay after every
-												// so many lines (based on if-statement above), in addition to
-												// any user-prescribed per-line delay
-												pasteDelaySoFar += (10 * kPreferences_TimeIntervalMillisecond); // arbitrary
-											}
-											dispatch_after(dispatch_time(DISPATCH_TIME_NOW, pasteDelaySoFar),
-															targetQueue,
-															^{
-																Session_UserInputCFString(inRef, BRIDGE_CAST(aString, CFStringRef));
-																++lineIndex;
-																if (lineCount != lineIndex)
-																{
-																	Session_SendNewline(inRef, kSession_EchoCurrentSessionValue);
-																}
-															});
-										}
-										if (isBracketedPaste)
-										{
-											dispatch_after(dispatch_time(DISPATCH_TIME_NOW, pasteDelaySoFar),
-															targetQueue,
-															^{
-																sendPasteBracket(false/* open */);
-															});
-										}
+										startPaste(blockPtr, blockPendingText, false/* join lines */, isBracketedPaste);
 									};
 			
 			
@@ -4853,7 +4937,7 @@ Session_UserInputPaste	(SessionRef		inRef,
 				Alert_Display(box.returnRef()); // retains alert until it is dismissed
 			}
 		}
-		CFRelease(pendingLines), pendingLines = nullptr;
+		CFRelease(pendingText), pendingText = nullptr;
 	}
 	
 	return result;
@@ -5004,6 +5088,7 @@ readBufferSizeMaximum(4096), // arbitrary, for initialization
 readBufferSizeInUse(0),
 readBufferPtr(std::make_unique<UInt8[]>(this->readBufferSizeMaximum)),
 writeEncoding(kCFStringEncodingUTF8), // initially...
+pasteJob(),
 activeWatch(kSession_WatchNothing),
 inactivityWatchTimer(nil), // set later
 recentSheetContext(),
@@ -5152,6 +5237,12 @@ My_Session::
 		this->inactivityWatchTimer = nil;
 	}
 	
+	if (nullptr != this->pasteJob)
+	{
+		[this->pasteJob->progressBubble removeWithAnimation];
+		this->pasteJob.reset();
+	}
+	
 	if (nullptr != this->mainProcess)
 	{
 		Local_KillProcess(&this->mainProcess);
@@ -5410,6 +5501,214 @@ closeTerminalWindow		(My_SessionPtr	inPtr)
 }// closeTerminalWindow
 
 
+/*!
+Sends the next chunk of the Paste that is in progress for the
+given session (see startPaste()), or ends the Paste if all of
+the text has been sent or the Paste has been canceled.
+
+A chunk is a series of whole lines (unless one line is longer
+than a chunk), separated by new-lines or (if lines are being
+joined) spaces.  Nothing else is sent until the process has
+read the entire chunk; if that happens quickly, the next chunk
+is larger, and if it takes a long time, the next chunk is
+smaller.  So a process that reads quickly receives a Paste
+quickly, and a process that reads slowly is never flooded.
+
+The user’s preferred new-line delay is applied between chunks.
+
+(2023.10)
+*/
+void
+continuePaste	(SessionRef		inRef)
+{
+	if (Session_IsValid(inRef))
+	{
+		My_SessionAutoLocker	ptr(gSessionPtrLocks(), inRef);
+		My_PasteJob*			jobPtr = ptr->pasteJob.get();
+		
+		
+		if (nullptr != jobPtr)
+		{
+			CFStringRef const	kText = BRIDGE_CAST(jobPtr->text, CFStringRef);
+			CFIndex const		kTextLength = CFStringGetLength(kText);
+			
+			
+			if ((jobPtr->canceled) || (jobPtr->position >= kTextLength))
+			{
+				// the closing bracket is sent even if the Paste is canceled,
+				// so that the application does not treat subsequent typing
+				// as part of the Paste
+				if (jobPtr->bracketed)
+				{
+					char const*		bracket = "\033[201~";
+					size_t const	length = CPP_STD::strlen(bracket);
+					
+					
+					UNUSED_RETURN(ssize_t)Session_SendData(inRef, bracket, length);
+				}
+				[jobPtr->progressBubble removeWithAnimation];
+				ptr->pasteJob.reset();
+			}
+			else
+			{
+				CFIndex const	kChunkEnd = std::min(jobPtr->position + jobPtr->chunkLength, kTextLength);
+				Boolean			lineSplit = false;
+				
+				
+				while ((jobPtr->position < kChunkEnd) && (false == lineSplit))
+				{
+					CFIndex		lineEnd = 0;
+					CFIndex		contentsEnd = 0;
+					CFIndex		segmentEnd = 0;
+					
+					
+					CFStringGetLineBounds(kText, CFRangeMake(jobPtr->position, 0), nullptr/* line start */, &lineEnd, &contentsEnd);
+					segmentEnd = std::min(contentsEnd, kChunkEnd);
+					if (segmentEnd < contentsEnd)
+					{
+						// the line does not fit in the rest of the chunk; split it,
+						// but not between the values of a surrogate pair or near an
+						// escape character (so that the filter below cannot miss a
+						// sequence that is divided between chunks)
+						CFIndex const	kSearchStart = std::max(jobPtr->position + 1, segmentEnd - 5/* length of sequence, minus 1 */);
+						
+						
+						for (CFIndex i = segmentEnd - 1; i >= kSearchStart; --i)
+						{
+							if (0x1B == CFStringGetCharacterAtIndex(kText, i))
+							{
+								segmentEnd = i;
+							}
+						}
+						if ((segmentEnd - 1 > jobPtr->position) &&
+							CFStringIsSurrogateHighCharacter(CFStringGetCharacterAtIndex(kText, segmentEnd - 1)))
+						{
+							--segmentEnd;
+						}
+						lineSplit = true;
+					}
+					
+					if (segmentEnd > jobPtr->position)
+					{
+						CFRetainRelease		segmentCFString(CFStringCreateWithSubstring(kCFAllocatorDefault, kText,
+																						CFRangeMake(jobPtr->position,
+																									segmentEnd - jobPtr->position)),
+															CFRetainRelease::kAlreadyRetained);
+						
+						
+						if (jobPtr->bracketed)
+						{
+							// pasted text must not be able to end the Paste early
+							CFRetainRelease		filteredCFString(CFStringCreateMutableCopy(kCFAllocatorDefault, 0/* length limit */,
+																							segmentCFString.returnCFStringRef()),
+																	CFRetainRelease::kAlreadyRetained);
+							
+							
+							while (0 != CFStringFindAndReplace(filteredCFString.returnCFMutableStringRef(), CFSTR("\033[201~"), CFSTR(""),
+																CFRangeMake(0, CFStringGetLength(filteredCFString.returnCFStringRef())),
+																0/* options */))
+							{
+								// repeat, since removing a sequence can join the
+								// pieces of another one (e.g. "\033[20\033[201~1~")
+							}
+							segmentCFString = filteredCFString;
+						}
+						Session_UserInputCFString(inRef, segmentCFString.returnCFStringRef());
+					}
+					
+					if (lineSplit)
+					{
+						jobPtr->position = segmentEnd;
+					}
+					else
+					{
+						// skip the new-line sequence of the text; lines are
+						// separated in the same way as typed lines (a new-line
+						// that only ends the text is not sent)
+						jobPtr->position = lineEnd;
+						if (jobPtr->position < kTextLength)
+						{
+							if (jobPtr->joinLines)
+							{
+								Session_UserInputCFString(inRef, CFSTR(" "));
+							}
+							else
+							{
+								Session_SendNewline(inRef, kSession_EchoCurrentSessionValue);
+							}
+						}
+					}
+				}
+				jobPtr->chunkSendTime = CFAbsoluteTimeGetCurrent();
+				
+				// if the Paste will take more than one chunk, display its progress
+				if (jobPtr->position < kTextLength)
+				{
+					CFRetainRelease		templateCFString(UIStrings_ReturnCopy(kUIStrings_TerminalPasteProgress),
+															CFRetainRelease::kAlreadyRetained);
+					
+					
+					if (templateCFString.exists())
+					{
+						CFRetainRelease		progressCFString(CFStringCreateWithFormat(kCFAllocatorDefault, nullptr/* options */,
+																						templateCFString.returnCFStringRef(),
+																						STATIC_CAST((100 * jobPtr->position) / kTextLength, unsigned int)),
+																CFRetainRelease::kAlreadyRetained);
+						
+						
+						if (nil == jobPtr->progressBubble)
+						{
+							jobPtr->progressBubble = [[TerminalWindow_InfoBubble alloc]
+														initWithStringValue:BRIDGE_CAST(progressCFString.returnCFStringRef(), NSString*)];
+							jobPtr->progressBubble.delayBeforeRemoval = 0; // removed when the Paste ends
+							[jobPtr->progressBubble moveBelowCursorInTerminalWindow:ptr->terminalWindow];
+							[jobPtr->progressBubble display];
+						}
+						else
+						{
+							jobPtr->progressBubble.stringValue = BRIDGE_CAST(progressCFString.returnCFStringRef(), NSString*);
+						}
+					}
+				}
+				
+				// wait for the process to read everything, then adjust the
+				// size of the next chunk based on how long that took
+				Session_SendQueueNotifyWhenEmpty(inRef,
+				^{
+					if (Session_IsValid(inRef))
+					{
+						My_SessionAutoLocker	blockPtr(gSessionPtrLocks(), inRef);
+						
+						
+						if (nullptr != blockPtr->pasteJob)
+						{
+							My_PasteJob*			blockJobPtr = blockPtr->pasteJob.get();
+							CFAbsoluteTime const	kDrainTime = (CFAbsoluteTimeGetCurrent() - blockJobPtr->chunkSendTime);
+							
+							
+							if (kDrainTime < kMy_PasteFastDrainTime)
+							{
+								blockJobPtr->chunkLength = std::min(2 * blockJobPtr->chunkLength, kMy_PasteChunkLengthMaximum);
+							}
+							else if (kDrainTime > kMy_PasteSlowDrainTime)
+							{
+								blockJobPtr->chunkLength = std::max(blockJobPtr->chunkLength / 2, kMy_PasteChunkLengthMinimum);
+							}
+							
+							dispatch_after(dispatch_time(DISPATCH_TIME_NOW, STATIC_CAST(blockJobPtr->chunkDelay / kPreferences_TimeIntervalNanosecond, int64_t)),
+											dispatch_get_main_queue(),
+											^{
+												continuePaste(inRef);
+											});
+						}
+					}
+				});
+			}
+		}
+	}
+}// continuePaste
+
+
 /*!
 Attempts to read all supported auto-capture-to-file tags from the
 given preference context, and any settings that exist will be
@@ -6536,6 +6835,69 @@ sheetContextEnd		(My_SessionPtr		inPtr)
 }// sheetContextEnd
 
 
+/*!
+Starts to send the given text to the session as a Paste; see
+Session_UserInputPaste() and continuePaste().  If lines should
+be joined, new-line sequences are replaced by single spaces.
+The text is surrounded by bracketed-paste sequences if the
+terminal requested them.
+
+If a Paste is already in progress, this has no effect (other
+than a beep).
+
+(2023.10)
+*/
+void
+startPaste	(My_SessionPtr		inPtr,
+			 NSString*			inText,
+			 Boolean			inJoinLines,
+			 Boolean			inIsBracketedPaste)
+{
+	if (nullptr != inPtr->pasteJob)
+	{
+		Sound_StandardAlert();
+	}
+	else
+	{
+		Preferences_TimeInterval	delayValue = 0;
+		
+		
+		// joined lines are not delayed (the user-preferred delay is
+		// meant to give applications time to respond to new-lines)
+		unless (inJoinLines)
+		{
+			unless (kPreferences_ResultOK ==
+					Preferences_GetData(kPreferences_TagPasteNewLineDelay, sizeof(delayValue), &delayValue))
+			{
+				// set an arbitrary default value
+				delayValue = 50 * kPreferences_TimeIntervalMillisecond;
+			}
+		}
+		
+		inPtr->pasteJob = std::make_unique< My_PasteJob >();
+		inPtr->pasteJob->text = inText;
+		inPtr->pasteJob->position = 0;
+		inPtr->pasteJob->chunkLength = kMy_PasteChunkLengthMinimum;
+		inPtr->pasteJob->chunkSendTime = 0;
+		inPtr->pasteJob->chunkDelay = delayValue;
+		inPtr->pasteJob->joinLines = inJoinLines;
+		inPtr->pasteJob->bracketed = inIsBracketedPaste;
+		inPtr->pasteJob->canceled = false;
+		inPtr->pasteJob->progressBubble = nil;
+		
+		if (inIsBracketedPaste)
+		{
+			char const*		bracket = "\033[200~";
+			size_t const	length = CPP_STD::strlen(bracket);
+			
+			
+			UNUSED_RETURN(ssize_t)Session_SendData(inPtr->selfRef, bracket, length);
+		}
+		continuePaste(inPtr->selfRef);
+	}
+}// startPaste
+
+
 /*!
 Displays the specified text temporarily in a floating window.
 The given byte sequence MUST use UTF-8 encoding.
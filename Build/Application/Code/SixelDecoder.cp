@@ -35,6 +35,14 @@
 
 // standard-C includes
 #include <climits>
+#include <cmath>
+#include <cstring>
+
+// standard-C++ includes
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <string>
 
 // Mac includes
 #include <ApplicationServices/ApplicationServices.h>
@@ -53,6 +61,43 @@
 namespace {
 
 SInt16 const	kMy_IntegerAccumulatorOverflowValue = SHRT_MIN;
+long const		kMy_MaximumPiecesInFlight = 16;		// number of appended pieces that can wait to be decoded
+
+} // anonymous namespace
+
+#pragma mark Types
+
+/*!
+A decoder that draws into a canvas, for one image.  This is
+used directly by SixelDecoder_NewImage() and it is shared
+between a SixelDecoder_Stream and the blocks on its queue.
+*/
+struct SixelDecoder_Stream::Drawing
+{
+	Drawing		(UInt16, UInt16, UInt16 = 0, UInt16 = 0);
+	
+	void
+	logSummary () const;
+	
+	SixelDecoder_StateMachine	decoder;		//!< draws into "canvas" (through blocks) as data is decoded
+	SixelDecoder_Canvas			canvas;			//!< the pixels of the image
+	Boolean						isFirstColor;	//!< true until a color is defined (the first one may fill the background)
+	Boolean						haveSixelSize;	//!< true once the canvas has the final size of a sixel (when the first one is drawn)
+	Boolean						allocationFailed;	//!< true if the canvas could not grow; remaining data is ignored and there is no image
+};
+
+#pragma mark Internal Method Prototypes
+namespace {
+
+void		appendBenchmarkImage		(std::string&, UInt16, UInt16, UInt16, UInt16, std::minstd_rand&);
+void		getImageSizeFromDecoder		(SixelDecoder_StateMachine const&, UInt16&, UInt16&);
+UInt32		makePixel					(UInt8, UInt8, UInt8);
+void		releaseCanvasPixels			(void*, void const*, size_t);
+UInt32		returnImagePixel			(CGImageRef, UInt16, UInt16);
+Boolean		returnStateExpectsCommand	(SixelDecoder_StateMachine::State);
+Boolean		unitTest_Canvas_000			();
+Boolean		unitTest_Decode_000			();
+Boolean		unitTest_Stream_000			();
 
 } // anonymous namespace
 
@@ -60,6 +105,248 @@ SInt16 const	kMy_IntegerAccumulatorOverflowValue = SHRT_MIN;
 
 #pragma mark Public Methods
 
+/*!
+A unit test for this module.  This should always
+be run before a release, after any substantial
+changes are made, or if you suspect bugs!  It
+should also be EXPANDED as new functionality is
+proposed (ideally, a test is written before the
+functionality is added).
+
+(2023.10)
+*/
+void
+SixelDecoder_RunTests ()
+{
+	UInt16		totalTests = 0;
+	UInt16		failedTests = 0;
+	
+	
+	++totalTests; if (false == unitTest_Canvas_000()) ++failedTests;
+	++totalTests; if (false == unitTest_Decode_000()) ++failedTests;
+	++totalTests; if (false == unitTest_Stream_000()) ++failedTests;
+	
+	Console_WriteUnitTestReport("Sixel Decoder", failedTests, totalTests);
+}// RunTests
+
+
+/*!
+Decodes generated 2000 x 2000 pixel Sixel images several
+times and reports the speed of each step to the console:
+finding the image size (with and without raster attributes)
+and decoding all of the pixels.
+
+One image has many colors in short runs, like the output
+of an image converter for a photograph; the other has a
+few colors in long runs, like a chart or screen capture.
+
+(2023.10)
+*/
+void
+SixelDecoder_RunBenchmarks ()
+{
+	UInt16 const		kImageSize = 2000;
+	UInt16 const		kIterationCount = 5;
+	std::minstd_rand	generator(2023/* arbitrary, but fixed */);
+	
+	
+	for (UInt16 imageIndex = 0; imageIndex < 2; ++imageIndex)
+	{
+		char const*			imageName = ((0 == imageIndex) ? "photo" : "chart");
+		std::string			imageData;
+		size_t				rasterAttributesLength = 0;
+		CFAbsoluteTime		hintedSizeTime = 0;
+		CFAbsoluteTime		scannedSizeTime = 0;
+		CFAbsoluteTime		decodeTime = 0;
+		UInt16				pixelsH = 0;
+		UInt16				pixelsV = 0;
+		Boolean				sizesMatch = true;
+		
+		
+		imageData = "\"1;1;" + std::to_string(kImageSize) + ";" + std::to_string(kImageSize);
+		rasterAttributesLength = imageData.size();
+		if (0 == imageIndex)
+		{
+			appendBenchmarkImage(imageData, kImageSize, kImageSize, 256/* palette size */, 24/* maximum run */, generator);
+		}
+		else
+		{
+			appendBenchmarkImage(imageData, kImageSize, kImageSize, 4/* palette size */, 600/* maximum run */, generator);
+		}
+		
+		UInt8 const* const	kDataPtr = REINTERPRET_CAST(imageData.data(), UInt8 const*);
+		
+		
+		// find the size from raster attributes (the usual case)
+		{
+			CFAbsoluteTime const	kStartTime = CFAbsoluteTimeGetCurrent();
+			
+			
+			for (UInt16 i = 0; i < kIterationCount; ++i)
+			{
+				SixelDecoder_GetImageSize(kDataPtr, imageData.size(), 2, 1, pixelsH, pixelsV);
+			}
+			hintedSizeTime = (CFAbsoluteTimeGetCurrent() - kStartTime);
+			sizesMatch = ((kImageSize == pixelsH) && (kImageSize == pixelsV));
+		}
+		
+		// find the size without raster attributes (the entire image is scanned)
+		{
+			CFAbsoluteTime const	kStartTime = CFAbsoluteTimeGetCurrent();
+			
+			
+			for (UInt16 i = 0; i < kIterationCount; ++i)
+			{
+				SixelDecoder_GetImageSize(kDataPtr + rasterAttributesLength, imageData.size() - rasterAttributesLength,
+											1, 1, pixelsH, pixelsV);
+			}
+			scannedSizeTime = (CFAbsoluteTimeGetCurrent() - kStartTime);
+		}
+		
+		// decode all pixels
+		{
+			CFAbsoluteTime const	kStartTime = CFAbsoluteTimeGetCurrent();
+			
+			
+			for (UInt16 i = 0; i < kIterationCount; ++i)
+			{
+				CGImageRef	image = SixelDecoder_NewImage(kDataPtr, imageData.size(), 2, 1, kImageSize, kImageSize);
+				
+				
+				if (nullptr == image)
+				{
+					sizesMatch = false;
+				}
+				else
+				{
+					CGImageRelease(image);
+				}
+			}
+			decodeTime = (CFAbsoluteTimeGetCurrent() - kStartTime);
+		}
+		
+		// report results
+		{
+			double const		kMegabytes = ((STATIC_CAST(imageData.size(), double) * kIterationCount) / (1024.0 * 1024.0));
+			double const		kMegapixels = ((STATIC_CAST(kImageSize, double) * kImageSize * kIterationCount) / 1000000.0);
+			std::ostringstream	reportSS;
+			std::string			reportStr;
+			
+			
+			reportSS << "Sixel decoder benchmark, " << imageName << " (" << imageData.size() << " bytes):"
+						<< " size from attributes " << ((hintedSizeTime > 0) ? (1000.0 * hintedSizeTime / kIterationCount) : 0) << " ms,"
+						<< " size from scan " << ((scannedSizeTime > 0) ? (kMegabytes / scannedSizeTime) : 0) << " MB/s,"
+						<< " decode " << ((decodeTime > 0) ? (kMegabytes / decodeTime) : 0) << " MB/s"
+						<< " (" << ((decodeTime > 0) ? (kMegapixels / decodeTime) : 0) << " megapixels/s)"
+						<< (sizesMatch ? "" : " (UNEXPECTED IMAGE SIZE)");
+			reportStr = reportSS.str();
+			Console_WriteLine(reportStr.c_str());
+		}
+	}
+}// RunBenchmarks
+
+
+/*!
+Returns the size, in pixels, of the image that the given
+Sixel data (without any introducing parameters) describes,
+for placing the image before it is decoded.
+
+If the data begins with raster attributes that give a width
+and height, they determine the size and nothing else is
+parsed.  Otherwise, the data is scanned (without drawing
+anything) to find the greatest extent of the graphics
+cursor.  Either way, the result is limited to the value of
+"kSixelDecoder_ImageSizeMaximum".
+
+The default aspect ratio comes from the parameters that
+introduce the Sixel data; raster attributes can change it.
+
+(2023.10)
+*/
+void
+SixelDecoder_GetImageSize	(UInt8 const*	inData,
+							 size_t			inByteCount,
+							 UInt16			inDefaultAspectRatioV,
+							 UInt16			inDefaultAspectRatioH,
+							 UInt16&		outPixelsH,
+							 UInt16&		outPixelsV)
+{
+	SixelDecoder_StateMachine	decoder;
+	size_t						headerByteCount = 0;
+	
+	
+	decoder.aspectRatioV = inDefaultAspectRatioV;
+	decoder.aspectRatioH = inDefaultAspectRatioH;
+	
+	// raster attributes can only appear first; their parameters end
+	// at the first byte that is not a digit or separator, and that
+	// byte must also be decoded before the parameters are applied
+	while ((headerByteCount < inByteCount) && std::isspace(inData[headerByteCount]))
+	{
+		++headerByteCount;
+	}
+	if ((headerByteCount < inByteCount) && ('"' == inData[headerByteCount]))
+	{
+		++headerByteCount;
+		while ((headerByteCount < inByteCount) &&
+				(std::isdigit(inData[headerByteCount]) || (';' == inData[headerByteCount])))
+		{
+			++headerByteCount;
+		}
+		headerByteCount = std::min(headerByteCount + 1, inByteCount);
+	}
+	decoder.decodeRun(inData, headerByteCount);
+	
+	unless ((decoder.suggestedImageWidth > 0) && (decoder.suggestedImageHeight > 0))
+	{
+		// without blocks, the decoder only tracks the graphics cursor
+		decoder.decodeRun(inData + headerByteCount, inByteCount - headerByteCount);
+	}
+	
+	getImageSizeFromDecoder(decoder, outPixelsH, outPixelsV);
+}// GetImageSize
+
+
+/*!
+Decodes the given Sixel data (without any introducing
+parameters) in a single pass, and returns a new image of
+the given size (see SixelDecoder_GetImageSize()); sixels
+outside that area are ignored.  Release the image with
+CGImageRelease().  Returns nullptr if either dimension is
+zero.
+
+Pixels that are not set by the data are black, unless the
+data begins with raster attributes that give a size; in
+that case, the first color defined fills the background.
+
+This does not depend on any terminal state, so it is safe
+to call from any thread (data can be decoded on a queue
+while the terminal continues processing other text).
+
+(2023.10)
+*/
+CGImageRef
+SixelDecoder_NewImage	(UInt8 const*	inData,
+						 size_t			inByteCount,
+						 UInt16			inDefaultAspectRatioV,
+						 UInt16			inDefaultAspectRatioH,
+						 UInt16			inPixelsH,
+						 UInt16			inPixelsV)
+{
+	CGImageRef						result = nullptr;
+	SixelDecoder_Stream::Drawing	drawing(inDefaultAspectRatioV, inDefaultAspectRatioH, inPixelsH, inPixelsV);
+	
+	
+	drawing.decoder.decodeRun(inData, inByteCount);
+	drawing.logSummary();
+	result = drawing.canvas.createImage(inPixelsH, inPixelsV);
+	
+	return result;
+}// NewImage
+
+
+#pragma mark Public Methods: SixelDecoder_StateMachine
+
 /*!
 Constructor.
 
@@ -114,6 +401,124 @@ SixelDecoder_StateMachine::
 }// SixelDecoder_StateMachine destructor
 
 
+/*!
+Decodes the given bytes, which may be any part of a stream
+of Sixel data (the state is kept between calls).  Blocks
+that were installed by setColorChooser(), etc. are invoked
+as the data is decoded.
+
+Ordinary sixels, repetitions and color selections are by far
+the most common data, so they are handled without visiting
+the state machine (unless a command is split between
+buffers).  Consecutive copies of the same sixel are also
+combined, so the sixel handler sees one repetition instead
+of many single sixels.
+
+(2023.10)
+*/
+void
+SixelDecoder_StateMachine::
+decodeRun	(UInt8 const*	inBytes,
+			 size_t			inByteCount)
+{
+	size_t		i = 0;
+	
+	
+	while (i < inByteCount)
+	{
+		UInt8 const		kByte = inBytes[i];
+		Boolean const	kExpectCommand = returnStateExpectsCommand(this->currentState);
+		size_t			digitsEnd = (i + 1);
+		UInt32			numberValue = 0;
+		
+		
+		if ((kExpectCommand) && (('!' == kByte) || ('#' == kByte)))
+		{
+			// read the number that follows (up to 4 digits, which cannot overflow)
+			while ((digitsEnd < inByteCount) && (digitsEnd < (i + 5)) && std::isdigit(inBytes[digitsEnd]))
+			{
+				numberValue = ((10 * numberValue) + (inBytes[digitsEnd] - '0'));
+				++digitsEnd;
+			}
+		}
+		
+		// repetitions (“!”, a count and a sixel) and color selections
+		// (“#” and a number that is not followed by more parameters)
+		// are handled directly when they are complete in this buffer;
+		// anything else (such as a color definition or an overflow)
+		// is left to the state machine
+		if ((kExpectCommand) && ('!' == kByte) && (digitsEnd > (i + 1)) && (digitsEnd < inByteCount) &&
+			(numberValue <= kSixelDecoder_RepeatCountMaximum) && (inBytes[digitsEnd] >= 0x3F) && (inBytes[digitsEnd] <= 0x7E))
+		{
+			// equivalent to the states from "kStateRepeatBegin" to "kStateRepeatApply"
+			this->currentState = kStateExpectCommand;
+			handleCommandCharacter(inBytes[digitsEnd], STATIC_CAST(numberValue, UInt16));
+			i = (digitsEnd + 1);
+		}
+		else if ((kExpectCommand) && ('#' == kByte) && (digitsEnd > (i + 1)) && (digitsEnd < inByteCount) &&
+					(false == std::isdigit(inBytes[digitsEnd])) && (';' != inBytes[digitsEnd]))
+		{
+			// equivalent to the states from "kStateSetColorInitParams" to "kStateSetColorApplyParams"
+			// (the byte after the number is not used by those states)
+			this->currentState = kStateSetColorApplyParams;
+			if (nullptr != this->colorChooser)
+			{
+				this->colorChooser(STATIC_CAST(numberValue, UInt16));
+			}
+			i = digitsEnd;
+		}
+		else if ((kExpectCommand) && (kByte >= 0x3F) && (kByte <= 0x7E))
+		{
+			// equivalent to a transition to "kStateSetPixels" for each byte
+			size_t		runLength = 1;
+			
+			
+			while (((i + runLength) < inByteCount) && (kByte == inBytes[i + runLength]) &&
+					(runLength < kSixelDecoder_RepeatCountMaximum))
+			{
+				++runLength;
+			}
+			this->byteRegister = kByte;
+			this->currentState = kStateSetPixels;
+			handleCommandCharacter(kByte, STATIC_CAST(runLength, UInt16));
+			i += runLength;
+		}
+		else
+		{
+			State const		kOriginalState = this->currentState;
+			SInt16			loopGuard = 0;
+			Boolean			byteNotUsed = true;
+			
+			
+			while (byteNotUsed)
+			{
+				goNextState(kByte, byteNotUsed);
+				if ((byteNotUsed) && (kOriginalState == this->currentState))
+				{
+					// no way to proceed
+					break;
+				}
+				
+				++loopGuard;
+				if (loopGuard > 100/* arbitrary */)
+				{
+					Console_Warning(Console_WriteLine, "Sixel decoder forced to break after unexpected tight loop");
+					break;
+				}
+			}
+			if (kStateRepeatExpectCharacter == this->currentState)
+			{
+				// the repetition does not depend on the next byte, so apply
+				// it now (otherwise, the last repetition of a stream would
+				// wait for data that might never arrive)
+				stateTransition(kStateRepeatApply);
+			}
+			++i;
+		}
+	}
+}// SixelDecoder_StateMachine::decodeRun
+
+
 /*!
 Returns the values of the (up to 6) pixels indicated by the given
 raw Sixel data.  The exact meaning of the pixels, such as shape,
@@ -1103,4 +1508,1033 @@ stateTransition		(State		inNextState)
 }// SixelDecoder_StateMachine::stateTransition
 
 
+#pragma mark Public Methods: SixelDecoder_Canvas
+
+/*!
+Constructs an empty canvas.  If a size is given, pixels are
+allocated for an image of that size right away (this avoids
+reallocation when the final size is already known).
+
+(2023.10)
+*/
+SixelDecoder_Canvas::
+SixelDecoder_Canvas		(UInt16		inInitialPixelsH,
+						 UInt16		inInitialPixelsV)
+:
+sixelWidth(1),
+sixelHeight(1),
+pixels(),
+columnCapacity(0),
+rowCapacity(0),
+palette(),
+backgroundPixel(0),
+currentPixel(0),
+haveColor(false)
+{
+	growToInclude(std::min(inInitialPixelsH, kSixelDecoder_ImageSizeMaximum),
+					std::min(inInitialPixelsV, kSixelDecoder_ImageSizeMaximum));
+}// SixelDecoder_Canvas 2-argument constructor
+
+
+/*!
+Returns a new image of the given size from the pixels that
+have been drawn, or nullptr if either dimension is zero.
+Any area that was never drawn has the background color.
+Release the image with CGImageRelease().
+
+The pixels are given to the image without being copied, so
+the canvas is empty afterwards.
+
+(2023.10)
+*/
+CGImageRef
+SixelDecoder_Canvas::
+createImage		(UInt16		inPixelsH,
+				 UInt16		inPixelsV)
+{
+	CGImageRef		result = nullptr;
+	UInt16 const	kPixelsH = std::min(inPixelsH, kSixelDecoder_ImageSizeMaximum);
+	UInt16 const	kPixelsV = std::min(inPixelsV, kSixelDecoder_ImageSizeMaximum);
+	
+	
+	if ((kPixelsH > 0) && (kPixelsV > 0))
+	{
+		std::vector< UInt32 >*		imagePixels = new std::vector< UInt32 >();
+		size_t						bytesPerRow = 0;
+		CGDataProviderRef			dataProvider = nullptr;
+		CGColorSpaceRef				colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+		
+		
+		growToInclude(kPixelsH, kPixelsV);
+		bytesPerRow = (this->columnCapacity * sizeof(UInt32));
+		imagePixels->swap(this->pixels);
+		dataProvider = CGDataProviderCreateWithData(imagePixels, imagePixels->data(), bytesPerRow * kPixelsV,
+													releaseCanvasPixels);
+		this->columnCapacity = 0;
+		this->rowCapacity = 0;
+		
+		// note: casting kCGBitmapByteOrderDefault and kCGImageAlphaNoneSkipLast to
+		// the same base integer type to suppress compiler warning about combining
+		// different enum types with "|" (the API requires it so this has to be
+		// suppressed)
+		result = CGImageCreate(kPixelsH, kPixelsV, 8/* bits per component */, 32/* bits per pixel */, bytesPerRow, colorSpace,
+								(STATIC_CAST(kCGBitmapByteOrderDefault, uint32_t) | STATIC_CAST(kCGImageAlphaNoneSkipLast, uint32_t)),
+								dataProvider, nullptr/* decode array */, false/* interpolate */, kCGRenderingIntentDefault);
+		CGDataProviderRelease(dataProvider); dataProvider = nullptr;
+		CGColorSpaceRelease(colorSpace); colorSpace = nullptr;
+	}
+	
+	return result;
+}// SixelDecoder_Canvas::createImage
+
+
+/*!
+Adds the given color to the palette, or replaces the color
+that has the same index.  (Pixels that were drawn already
+are not affected, and neither is the current color.)
+
+Components have the ranges of SixelDecoder_ColorCreator:
+degrees for a hue and percentages for everything else.
+
+(2023.10)
+*/
+void
+SixelDecoder_Canvas::
+defineColor		(UInt16						inColorIndex,
+				 SixelDecoder_ColorType		inColorType,
+				 UInt16						inComponent1,
+				 UInt16						inComponent2,
+				 UInt16						inComponent3)
+{
+	Float32		red = 0;
+	Float32		green = 0;
+	Float32		blue = 0;
+	
+	
+	switch (inColorType)
+	{
+	case kSixelDecoder_ColorTypeHLS:
+		// note: given in HLS order but interpreted as hue, saturation and
+		// brightness (the last two values are flipped), which is what
+		// earlier versions did with NSColor
+		{
+			Float32 const	kHue = std::fmod(STATIC_CAST(inComponent1, Float32) / 60.0f, 6.0f);
+			Float32 const	kBrightness = (std::min< UInt16 >(inComponent2, 100) / 100.0f);
+			Float32 const	kSaturation = (std::min< UInt16 >(inComponent3, 100) / 100.0f);
+			Float32 const	kChroma = (kBrightness * kSaturation);
+			Float32 const	kSecond = (kChroma * (1.0f - std::fabs(std::fmod(kHue, 2.0f) - 1.0f)));
+			Float32 const	kMinimum = (kBrightness - kChroma);
+			
+			
+			switch (STATIC_CAST(kHue, UInt16))
+			{
+			case 0: red = kChroma; green = kSecond; break;
+			case 1: red = kSecond; green = kChroma; break;
+			case 2: green = kChroma; blue = kSecond; break;
+			case 3: green = kSecond; blue = kChroma; break;
+			case 4: red = kSecond; blue = kChroma; break;
+			default: red = kChroma; blue = kSecond; break;
+			}
+			red += kMinimum;
+			green += kMinimum;
+			blue += kMinimum;
+		}
+		break;
+	
+	case kSixelDecoder_ColorTypeRGB:
+		red = (std::min< UInt16 >(inComponent1, 100) / 100.0f);
+		green = (std::min< UInt16 >(inComponent2, 100) / 100.0f);
+		blue = (std::min< UInt16 >(inComponent3, 100) / 100.0f);
+		break;
+	
+	default:
+		// ???
+		break;
+	}
+	
+	if (inColorIndex >= this->palette.size())
+	{
+		this->palette.resize(inColorIndex + 1, 0/* undefined */);
+	}
+	this->palette[inColorIndex] = makePixel(STATIC_CAST(std::lround(red * 255.0f), UInt8),
+											STATIC_CAST(std::lround(green * 255.0f), UInt8),
+											STATIC_CAST(std::lround(blue * 255.0f), UInt8));
+}// SixelDecoder_Canvas::defineColor
+
+
+/*!
+Draws a sixel (a column of 6 bits, the raw value of a sixel
+character from 0x3F to 0x7E) with the current color, the
+given number of times across, starting at the given graphics
+cursor position.  The cursor is in sixels, not pixels; see
+"sixelWidth" and "sixelHeight".  Bits that are “off” do not
+change any pixels.
+
+Only the bits that are set are visited, and each one fills
+the same span of every row it covers, so the repetition
+costs one memset_pattern4() per row instead of one store
+per pixel.  The canvas grows as needed, up to the limit of
+"kSixelDecoder_ImageSizeMaximum" (sixels beyond that are
+ignored).
+
+(2023.10)
+*/
+void
+SixelDecoder_Canvas::
+drawSixels	(UInt16		inGraphicsCursorX,
+			 UInt16		inGraphicsCursorY,
+			 UInt8		inRawCharacter,
+			 UInt16		inRepeatCount)
+{
+	UInt32		bits = (STATIC_CAST(inRawCharacter - 0x3F, UInt32) & 0x3F);
+	
+	
+	if ((this->haveColor) && (0 != bits) && (inRepeatCount > 0))
+	{
+		UInt32 const	kBitHeight = this->sixelHeight;
+		UInt32 const	kLeft = (STATIC_CAST(inGraphicsCursorX, UInt32) * this->sixelWidth);
+		UInt32 const	kPastRight = std::min< UInt32 >((STATIC_CAST(inGraphicsCursorX, UInt32) + inRepeatCount) * this->sixelWidth,
+														kSixelDecoder_ImageSizeMaximum);
+		UInt32 const	kTop = (STATIC_CAST(inGraphicsCursorY, UInt32) * 6/* bits per sixel */ * kBitHeight);
+		UInt32 const	kPastBottom = std::min< UInt32 >(kTop + (6 * kBitHeight), kSixelDecoder_ImageSizeMaximum);
+		
+		
+		if ((kLeft < kPastRight) && (kTop < kPastBottom))
+		{
+			size_t const	kSpanBytes = ((kPastRight - kLeft) * sizeof(UInt32));
+			
+			
+			growToInclude(kPastRight, kPastBottom);
+			while (0 != bits)
+			{
+				UInt32 const	kFirstRow = (kTop + (__builtin_ctz(bits) * kBitHeight));
+				UInt32 const	kPastLastRow = std::min(kFirstRow + kBitHeight, kPastBottom);
+				
+				
+				bits &= (bits - 1); // clear lowest bit
+				for (UInt32 row = kFirstRow; row < kPastLastRow; ++row)
+				{
+					UInt32*		spanPtr = &this->pixels[(STATIC_CAST(row, size_t) * this->columnCapacity) + kLeft];
+					
+					
+					if (sizeof(UInt32) == kSpanBytes)
+					{
+						*spanPtr = this->currentPixel;
+					}
+					else
+					{
+						memset_pattern4(spanPtr, &this->currentPixel, kSpanBytes);
+					}
+				}
+			}
+		}
+	}
+}// SixelDecoder_Canvas::drawSixels
+
+
+/*!
+Sets every pixel to the given palette color, including any
+that are added later as the canvas grows.  Has no effect if
+the color is not defined.
+
+(2023.10)
+*/
+void
+SixelDecoder_Canvas::
+fillBackground	(UInt16		inColorIndex)
+{
+	if ((inColorIndex < this->palette.size()) && (0 != this->palette[inColorIndex]))
+	{
+		this->backgroundPixel = this->palette[inColorIndex];
+		std::fill(this->pixels.begin(), this->pixels.end(), this->backgroundPixel);
+	}
+}// SixelDecoder_Canvas::fillBackground
+
+
+/*!
+Makes the given palette color the one that is used by
+drawSixels().  If the color is not defined (yet), sixels
+are not drawn at all until another color is selected.
+
+(2023.10)
+*/
+void
+SixelDecoder_Canvas::
+selectColor		(UInt16		inColorIndex)
+{
+	this->haveColor = ((inColorIndex < this->palette.size()) && (0 != this->palette[inColorIndex]));
+	this->currentPixel = (this->haveColor ? this->palette[inColorIndex] : 0);
+}// SixelDecoder_Canvas::selectColor
+
+
+/*!
+Ensures that pixels exist for at least the given number of
+columns and rows.  Each dimension that is too small at least
+doubles, so that an image that grows a little at a time is
+only copied a few times.  New pixels have the background
+color.
+
+(2023.10)
+*/
+void
+SixelDecoder_Canvas::
+growToInclude	(UInt32		inColumnCount,
+				 UInt32		inRowCount)
+{
+	if ((inColumnCount > this->columnCapacity) || (inRowCount > this->rowCapacity))
+	{
+		UInt32 const			kNewColumnCapacity = ((inColumnCount > this->columnCapacity)
+														? std::min< UInt32 >(std::max(inColumnCount, 2 * this->columnCapacity),
+																				kSixelDecoder_ImageSizeMaximum)
+														: this->columnCapacity);
+		UInt32 const			kNewRowCapacity = ((inRowCount > this->rowCapacity)
+													? std::min< UInt32 >(std::max(inRowCount, 2 * this->rowCapacity),
+																			kSixelDecoder_ImageSizeMaximum)
+													: this->rowCapacity);
+		std::vector< UInt32 >	newPixels(STATIC_CAST(kNewColumnCapacity, size_t) * kNewRowCapacity, this->backgroundPixel);
+		
+		
+		for (UInt32 row = 0; row < this->rowCapacity; ++row)
+		{
+			std::copy_n(this->pixels.begin() + (STATIC_CAST(row, size_t) * this->columnCapacity), this->columnCapacity,
+						newPixels.begin() + (STATIC_CAST(row, size_t) * kNewColumnCapacity));
+		}
+		this->pixels.swap(newPixels);
+		this->columnCapacity = kNewColumnCapacity;
+		this->rowCapacity = kNewRowCapacity;
+	}
+}// SixelDecoder_Canvas::growToInclude
+
+
+#pragma mark Public Methods: SixelDecoder_Stream
+
+/*!
+Constructs a stream for Sixel data with the given default
+aspect ratio (from the parameters that introduce the data;
+raster attributes can change it).
+
+(2023.10)
+*/
+SixelDecoder_Stream::
+SixelDecoder_Stream		(UInt16		inDefaultAspectRatioV,
+						 UInt16		inDefaultAspectRatioH)
+:
+// IMPORTANT: THESE ARE EXECUTED IN THE ORDER MEMBERS APPEAR IN THE CLASS.
+decodingQueue(dispatch_queue_create("net.macterm.queues.sixel", DISPATCH_QUEUE_SERIAL)),
+pieceLimit(dispatch_semaphore_create(kMy_MaximumPiecesInFlight)),
+drawing(std::make_shared< Drawing >(inDefaultAspectRatioV, inDefaultAspectRatioH)),
+sizeScanner(),
+haveRasterSize(false)
+{
+	sizeScanner.aspectRatioV = inDefaultAspectRatioV;
+	sizeScanner.aspectRatioH = inDefaultAspectRatioH;
+}// SixelDecoder_Stream 2-argument constructor
+
+
+/*!
+Destructor.  Blocks that are still scheduled keep the queue
+and the drawing alive until they finish.
+
+(2023.10)
+*/
+SixelDecoder_Stream::
+~SixelDecoder_Stream ()
+{
+	dispatch_release(decodingQueue);
+	dispatch_release(pieceLimit);
+}// SixelDecoder_Stream destructor
+
+
+/*!
+Schedules the given piece of Sixel data (which may end in
+the middle of a command) to be decoded after all previous
+pieces.  The data is copied, so the buffer can be reused as
+soon as this returns.
+
+At most a few pieces can wait to be decoded at any time; if
+data arrives faster than it can be decoded, this waits for
+the oldest piece to finish before copying another one, so
+that memory use stays bounded.
+
+Unless the data began with raster attributes that give the
+size, it is also scanned right away to update the size
+that getImageSize() returns.
+
+(2023.10)
+*/
+void
+SixelDecoder_Stream::
+appendData	(UInt8 const*	inBytes,
+			 size_t			inByteCount)
+{
+	dispatch_semaphore_t	pieceLimitSemaphore = this->pieceLimit; // copied into block (the stream may be destroyed first)
+	auto					drawingPtr = this->drawing; // copied into block
+	
+	
+	unless (this->haveRasterSize)
+	{
+		// without blocks, the decoder only tracks the graphics cursor
+		this->sizeScanner.decodeRun(inBytes, inByteCount);
+		this->haveRasterSize = ((this->sizeScanner.suggestedImageWidth > 0) && (this->sizeScanner.suggestedImageHeight > 0));
+	}
+	
+	// the block signals the semaphore when its piece is decoded
+	UNUSED_RETURN(long)dispatch_semaphore_wait(pieceLimitSemaphore, DISPATCH_TIME_FOREVER);
+	dispatch_retain(pieceLimitSemaphore);
+	{
+		auto	dataCopy = std::make_shared< std::vector< UInt8 > >(inBytes, inBytes + inByteCount);
+		
+		
+		dispatch_async(this->decodingQueue,
+		^{
+			unless (drawingPtr->allocationFailed)
+			{
+				try
+				{
+					drawingPtr->decoder.decodeRun(dataCopy->data(), dataCopy->size());
+				}
+				catch (std::bad_alloc const&)
+				{
+					// a canvas can require hundreds of megabytes, so this
+					// must not terminate the application; the image fails
+					Console_Warning(Console_WriteLine, "not enough memory to decode Sixel image");
+					drawingPtr->allocationFailed = true;
+				}
+			}
+			UNUSED_RETURN(long)dispatch_semaphore_signal(pieceLimitSemaphore);
+			dispatch_release(pieceLimitSemaphore);
+		});
+	}
+}// SixelDecoder_Stream::appendData
+
+
+/*!
+Schedules the image to be created, at the size returned by
+getImageSize() now, once all data that has been appended is
+decoded.  The given block is then invoked ON THE DECODING
+QUEUE with the new image (or nullptr, if either dimension is
+zero or if there was not enough memory to decode the image);
+it must release the image with CGImageRelease().
+
+Call this only once, after the last piece of data.
+
+(2023.10)
+*/
+void
+SixelDecoder_Stream::
+finishImage		(SixelDecoder_ImageHandler		inHandler)
+{
+	auto	drawingPtr = this->drawing; // copied into block
+	UInt16	pixelsH = 0;
+	UInt16	pixelsV = 0;
+	
+	
+	getImageSize(pixelsH, pixelsV);
+	
+	dispatch_async(this->decodingQueue,
+	^{
+		CGImageRef		image = nullptr;
+		
+		
+		drawingPtr->logSummary();
+		unless (drawingPtr->allocationFailed)
+		{
+			try
+			{
+				image = drawingPtr->canvas.createImage(pixelsH, pixelsV);
+			}
+			catch (std::bad_alloc const&)
+			{
+				Console_Warning(Console_WriteLine, "not enough memory to create Sixel image");
+				drawingPtr->allocationFailed = true;
+			}
+		}
+		inHandler(image);
+	});
+}// SixelDecoder_Stream::finishImage
+
+
+/*!
+Returns the size, in pixels, of the image that the data
+appended so far describes; see SixelDecoder_GetImageSize(),
+which gives the same result for the same data.
+
+(2023.10)
+*/
+void
+SixelDecoder_Stream::
+getImageSize	(UInt16&	outPixelsH,
+				 UInt16&	outPixelsV)
+const
+{
+	getImageSizeFromDecoder(this->sizeScanner, outPixelsH, outPixelsV);
+}// SixelDecoder_Stream::getImageSize
+
+
+#pragma mark Public Methods: SixelDecoder_Stream::Drawing
+
+/*!
+Constructs a decoder with the given default aspect ratio
+that draws into a new canvas (which has room for an image
+of the given size right away, if one is given).
+
+(2023.10)
+*/
+SixelDecoder_Stream::Drawing::
+Drawing		(UInt16		inDefaultAspectRatioV,
+			 UInt16		inDefaultAspectRatioH,
+			 UInt16		inInitialPixelsH,
+			 UInt16		inInitialPixelsV)
+:
+// IMPORTANT: THESE ARE EXECUTED IN THE ORDER MEMBERS APPEAR IN THE CLASS.
+decoder(),
+canvas(inInitialPixelsH, inInitialPixelsV),
+isFirstColor(true),
+haveSixelSize(false),
+allocationFailed(false)
+{
+	Drawing*	drawingPtr = this; // so copied blocks can refer to object without copying object
+	
+	
+	decoder.aspectRatioV = inDefaultAspectRatioV; // default only; can change if raster attributes are parsed
+	decoder.aspectRatioH = inDefaultAspectRatioH;
+	decoder.setColorCreator(^(UInt16 colorIndex, SixelDecoder_ColorType colorType,
+								UInt16 component1, UInt16 component2, UInt16 component3)
+	{
+		if (DebugInterface_LogsSixelDecoderSummary())
+		{
+			Console_WriteValue("Sixel color defined with index", colorIndex);
+		}
+		drawingPtr->canvas.defineColor(colorIndex, colorType, component1, component2, component3);
+		
+		// the VT330/340 manual says that a VT300 would only fill the width/height
+		// when zero-pixels are set to use the current background (as opposed to
+		// keeping their previous color); this isn’t practical though because image
+		// conversion utilities typically provide only the sixel data string and
+		// not the introductory terminal sequence that would specify a color mode,
+		// causing images to have large gaps if no background fill is performed
+		if ((drawingPtr->isFirstColor) && (drawingPtr->decoder.suggestedImageWidth > 0) && (drawingPtr->decoder.suggestedImageHeight > 0))
+		{
+			// the first time a color is defined, fill the image background
+			// (the VT300 manual specifies only the region that is filled, as
+			// the width/height from raster attributes; it isn’t clear what
+			// “background color” should be; this interpretation is somewhat
+			// arbitrary but it seems compatible with known image utilities)
+			if (DebugInterface_LogsSixelDecoderSummary())
+			{
+				Console_WriteLine("Sixel color definition will be used for background");
+			}
+			drawingPtr->canvas.fillBackground(colorIndex);
+		}
+		drawingPtr->isFirstColor = false;
+	});
+	decoder.setColorChooser(^(UInt16 colorIndex)
+	{
+		drawingPtr->canvas.selectColor(colorIndex);
+	});
+	decoder.setSixelHandler(^(UInt8 rawChar, UInt16 repeatCount)
+	{
+		if (false == drawingPtr->haveSixelSize)
+		{
+			// raster attributes (which can change the aspect ratio) must
+			// come before any sixels, so the size is now final
+			drawingPtr->decoder.getSixelSize(drawingPtr->canvas.sixelHeight, drawingPtr->canvas.sixelWidth);
+			drawingPtr->haveSixelSize = true;
+		}
+		drawingPtr->canvas.drawSixels(drawingPtr->decoder.graphicsCursorX, drawingPtr->decoder.graphicsCursorY, rawChar, repeatCount);
+	});
+}// SixelDecoder_Stream::Drawing 4-argument constructor
+
+
+/*!
+Writes the final state of decoding to the console, if the
+debugging summary is enabled.
+
+(2023.10)
+*/
+void
+SixelDecoder_Stream::Drawing::
+logSummary ()
+const
+{
+	if (DebugInterface_LogsSixelDecoderSummary())
+	{
+		Console_WriteValue("final cursor position relative to Sixel image: x", this->decoder.graphicsCursorX);
+		Console_WriteValue("final cursor position relative to Sixel image: y", this->decoder.graphicsCursorY);
+		Console_WriteValue("apparent width in “sixels”", 1 + this->decoder.graphicsCursorMaxX);
+		Console_WriteValue("apparent height in “sixels”", 1 + this->decoder.graphicsCursorMaxY);
+		Console_WriteValue("final pan (aspect ratio, vertical)", this->decoder.aspectRatioV);
+		Console_WriteValue("final pad (aspect ratio, horizontal)", this->decoder.aspectRatioH);
+		Console_WriteValue("calculated “sixel” width (in screen pixels)", this->canvas.sixelWidth);
+		Console_WriteValue("calculated “sixel” height (in screen pixels)", this->canvas.sixelHeight);
+	}
+}// SixelDecoder_Stream::Drawing::logSummary
+
+
+#pragma mark Internal Methods
+namespace {
+
+/*!
+Appends generated sixels (and the color definitions that
+they need) for an image of the given size to the given
+string, in the style of an image converter: each band of
+6 rows is written once for each color that it uses, with
+runs of sixels written as repetitions.
+
+Each band is divided into horizontal runs of random length
+(up to the given maximum) and each run uses a random color
+from a palette of the given size.
+
+(2023.10)
+*/
+void
+appendBenchmarkImage	(std::string&			inoutData,
+						 UInt16					inPixelsH,
+						 UInt16					inPixelsV,
+						 UInt16					inColorCount,
+						 UInt16					inMaximumRunLength,
+						 std::minstd_rand&		inoutGenerator)
+{
+	std::vector< UInt16 >	pixelColors(inPixelsH * 6/* bits per sixel */);
+	std::vector< UInt8 >	sixelBits(inPixelsH);
+	
+	
+	for (UInt16 i = 0; i < inColorCount; ++i)
+	{
+		inoutData += "#" + std::to_string(i) + ";2;" + std::to_string(inoutGenerator() % 101) + ";" +
+						std::to_string(inoutGenerator() % 101) + ";" + std::to_string(inoutGenerator() % 101);
+	}
+	
+	for (UInt16 bandTop = 0; bandTop < inPixelsV; bandTop += 6/* bits per sixel */)
+	{
+		// assign colors to every pixel of the band, in horizontal runs
+		for (UInt16 bit = 0; bit < 6; ++bit)
+		{
+			UInt16		x = 0;
+			
+			
+			while (x < inPixelsH)
+			{
+				UInt16 const	kRunColor = STATIC_CAST(inoutGenerator() % inColorCount, UInt16);
+				UInt16 const	kRunEnd = std::min< UInt16 >(inPixelsH, x + 1 + (inoutGenerator() % inMaximumRunLength));
+				
+				
+				for (; x < kRunEnd; ++x)
+				{
+					pixelColors[bit * inPixelsH + x] = kRunColor;
+				}
+			}
+		}
+		
+		// write one line of sixels for each color that the band uses
+		for (UInt16 color = 0; color < inColorCount; ++color)
+		{
+			Boolean		colorUsed = false;
+			UInt16		x = 0;
+			
+			
+			for (x = 0; x < inPixelsH; ++x)
+			{
+				sixelBits[x] = 0;
+				for (UInt16 bit = 0; bit < 6; ++bit)
+				{
+					if (color == pixelColors[bit * inPixelsH + x])
+					{
+						sixelBits[x] |= (1 << bit);
+					}
+				}
+				colorUsed = (colorUsed || (0 != sixelBits[x]));
+			}
+			
+			if (colorUsed)
+			{
+				inoutData += "#" + std::to_string(color);
+				x = 0;
+				while (x < inPixelsH)
+				{
+					UInt16		runLength = 1;
+					
+					
+					while (((x + runLength) < inPixelsH) && (sixelBits[x + runLength] == sixelBits[x]))
+					{
+						++runLength;
+					}
+					if (runLength > 3)
+					{
+						inoutData += "!" + std::to_string(runLength);
+						inoutData += STATIC_CAST(0x3F + sixelBits[x], char);
+					}
+					else
+					{
+						inoutData.append(runLength, STATIC_CAST(0x3F + sixelBits[x], char));
+					}
+					x += runLength;
+				}
+				inoutData += "$";
+			}
+		}
+		inoutData += "-";
+	}
+}// appendBenchmarkImage
+
+
+/*!
+Returns the size, in pixels, of the image that a decoder
+(with or without blocks) has seen so far: the size from
+raster attributes, if any, or else the greatest extent of
+the graphics cursor.  Either way, the result is limited to
+the value of "kSixelDecoder_ImageSizeMaximum".
+
+(2023.10)
+*/
+void
+getImageSizeFromDecoder		(SixelDecoder_StateMachine const&	inDecoder,
+							 UInt16&							outPixelsH,
+							 UInt16&							outPixelsV)
+{
+	UInt16		sixelSizeH = 1;
+	UInt16		sixelSizeV = 1;
+	UInt32		pixelsH = 0;
+	UInt32		pixelsV = 0;
+	
+	
+	inDecoder.getSixelSize(sixelSizeV, sixelSizeH);
+	if ((inDecoder.suggestedImageWidth > 0) && (inDecoder.suggestedImageHeight > 0))
+	{
+		pixelsH = (STATIC_CAST(inDecoder.suggestedImageWidth, UInt32) * sixelSizeH);
+		pixelsV = (STATIC_CAST(inDecoder.suggestedImageHeight, UInt32) * sixelSizeV);
+	}
+	else
+	{
+		pixelsH = ((1 + STATIC_CAST(inDecoder.graphicsCursorMaxX, UInt32)) * sixelSizeH);
+		pixelsV = ((1 + STATIC_CAST(inDecoder.graphicsCursorMaxY, UInt32)) * sixelSizeV * 6/* sixel has 6 bits, one per vertical plot */);
+	}
+	
+	outPixelsH = STATIC_CAST(std::min< UInt32 >(pixelsH, kSixelDecoder_ImageSizeMaximum), UInt16);
+	outPixelsV = STATIC_CAST(std::min< UInt32 >(pixelsV, kSixelDecoder_ImageSizeMaximum), UInt16);
+}// getImageSizeFromDecoder
+
+
+/*!
+Returns the value that SixelDecoder_Canvas stores for a pixel
+of the given color.  Palette entries that are defined always
+have a nonzero value because the (unused) alpha byte is set.
+
+(2023.10)
+*/
+UInt32
+makePixel	(UInt8		inRed,
+			 UInt8		inGreen,
+			 UInt8		inBlue)
+{
+	UInt8 const		kBytes[] = { inRed, inGreen, inBlue, 0xFF };
+	UInt32			result = 0;
+	
+	
+	std::memcpy(&result, kBytes, sizeof(result));
+	
+	return result;
+}// makePixel
+
+
+/*!
+A standard "CGDataProviderReleaseDataCallback" that frees the
+pixels given to an image by SixelDecoder_Canvas::createImage().
+
+(2023.10)
+*/
+void
+releaseCanvasPixels		(void*			inInfo,
+						 void const*	UNUSED_ARGUMENT(inData),
+						 size_t			UNUSED_ARGUMENT(inSize))
+{
+	std::vector< UInt32 >*	imagePixels = REINTERPRET_CAST(inInfo, std::vector< UInt32 >*);
+	
+	
+	delete imagePixels;
+}// releaseCanvasPixels
+
+
+/*!
+For tests; returns the red, green and blue bytes of the given
+pixel of an image from SixelDecoder_Canvas (in the form that
+makePixel() returns), or 0 if the pixel is black.
+
+(2023.10)
+*/
+UInt32
+returnImagePixel	(CGImageRef		inImage,
+					 UInt16			inX,
+					 UInt16			inY)
+{
+	CFDataRef	imageData = CGDataProviderCopyData(CGImageGetDataProvider(inImage));
+	UInt8 const*	pixelBytes = (CFDataGetBytePtr(imageData) + (inY * CGImageGetBytesPerRow(inImage)) + (inX * sizeof(UInt32)));
+	UInt32		result = 0;
+	
+	
+	if ((0 != pixelBytes[0]) || (0 != pixelBytes[1]) || (0 != pixelBytes[2]))
+	{
+		result = makePixel(pixelBytes[0], pixelBytes[1], pixelBytes[2]);
+	}
+	CFRelease(imageData); imageData = nullptr;
+	
+	return result;
+}// returnImagePixel
+
+
+/*!
+Returns true only if the given decoder state treats the
+next byte as the start of a new command, exactly as the
+state "kStateExpectCommand" does.  This is true of states
+that have completed a command, since their only possible
+transition is to "kStateExpectCommand" without using a
+byte.
+
+(2023.10)
+*/
+Boolean
+returnStateExpectsCommand	(SixelDecoder_StateMachine::State	inState)
+{
+	Boolean		result = false;
+	
+	
+	switch (inState)
+	{
+	case SixelDecoder_StateMachine::kStateInitial:
+	case SixelDecoder_StateMachine::kStateExpectCommand:
+	case SixelDecoder_StateMachine::kStateSetPixels:
+	case SixelDecoder_StateMachine::kStateRasterAttrsApplyParams:
+	case SixelDecoder_StateMachine::kStateCarriageReturn:
+	case SixelDecoder_StateMachine::kStateCarriageReturnLineFeed:
+	case SixelDecoder_StateMachine::kStateLineFeed:
+	case SixelDecoder_StateMachine::kStateRepeatApply:
+	case SixelDecoder_StateMachine::kStateSetColorApplyParams:
+		result = true;
+		break;
+	
+	default:
+		break;
+	}
+	
+	return result;
+}// returnStateExpectsCommand
+
+
+/*!
+Tests drawing into a canvas directly, including growth and
+clipping.
+
+Returns "true" if ALL assertions pass; "false" is returned
+if any fail, however messages should be printed for ALL
+assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_Canvas_000 ()
+{
+	Boolean					result = true;
+	SixelDecoder_Canvas		canvas;
+	UInt32 const			kRed = makePixel(0xFF, 0, 0);
+	UInt32 const			kBlue = makePixel(0, 0, 0xFF);
+	CGImageRef				image = nullptr;
+	
+	
+	canvas.defineColor(1, kSixelDecoder_ColorTypeRGB, 100, 0, 0);
+	canvas.defineColor(2, kSixelDecoder_ColorTypeHLS, 240, 100, 100); // hue/saturation/brightness: blue
+	
+	// undefined colors draw nothing
+	canvas.selectColor(7);
+	canvas.drawSixels(0, 0, '~', 1);
+	
+	// bits 0 and 2 (rows 6 and 8 of the second band), 3 times across
+	canvas.selectColor(1);
+	canvas.drawSixels(2, 1, 0x3F + 0x05, 3);
+	
+	// all bits, far enough away that the canvas must grow in both directions
+	canvas.selectColor(2);
+	canvas.drawSixels(30, 3, '~', 1);
+	
+	image = canvas.createImage(40, 24);
+	Console_TestAssertUpdate(result, nullptr != image, Console_WriteLine, "image was created");
+	if (nullptr != image)
+	{
+		Console_TestAssertUpdate(result, 40 == CGImageGetWidth(image), Console_WriteValue, "image width", CGImageGetWidth(image));
+		Console_TestAssertUpdate(result, 24 == CGImageGetHeight(image), Console_WriteValue, "image height", CGImageGetHeight(image));
+		Console_TestAssertUpdate(result, 0 == returnImagePixel(image, 0, 0), Console_WriteLine, "undefined color did not draw");
+		Console_TestAssertUpdate(result, kRed == returnImagePixel(image, 2, 6), Console_WriteLine, "first bit, first column");
+		Console_TestAssertUpdate(result, kRed == returnImagePixel(image, 4, 8), Console_WriteLine, "third bit, last column");
+		Console_TestAssertUpdate(result, 0 == returnImagePixel(image, 3, 7), Console_WriteLine, "bit that is off");
+		Console_TestAssertUpdate(result, 0 == returnImagePixel(image, 5, 6), Console_WriteLine, "column past repetition");
+		Console_TestAssertUpdate(result, kBlue == returnImagePixel(image, 30, 23), Console_WriteLine, "pixel after growth");
+		Console_TestAssertUpdate(result, 0 == returnImagePixel(image, 31, 23), Console_WriteLine, "pixel after growth, not drawn");
+		CGImageRelease(image); image = nullptr;
+	}
+	
+	return result;
+}// unitTest_Canvas_000
+
+
+/*!
+Tests finding the size of Sixel data and decoding it, with
+and without raster attributes.
+
+Returns "true" if ALL assertions pass; "false" is returned
+if any fail, however messages should be printed for ALL
+assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_Decode_000 ()
+{
+	Boolean			result = true;
+	UInt32 const	kGreen = makePixel(0, 0xFF, 0);
+	UInt16			pixelsH = 0;
+	UInt16			pixelsV = 0;
+	
+	
+	// without raster attributes, the image covers every position of the
+	// graphics cursor (which ends one sixel past the widest line); note
+	// that ordinary sixels and a repetition are used
+	{
+		char const*		kData = "#1;2;0;100;0#1~~~-!4N";
+		size_t const	kDataSize = std::strlen(kData);
+		CGImageRef		image = nullptr;
+		
+		
+		SixelDecoder_GetImageSize(REINTERPRET_CAST(kData, UInt8 const*), kDataSize, 1, 1, pixelsH, pixelsV);
+		Console_TestAssertUpdate(result, 5 == pixelsH, Console_WriteValue, "scanned width", pixelsH);
+		Console_TestAssertUpdate(result, 12 == pixelsV, Console_WriteValue, "scanned height", pixelsV);
+		
+		image = SixelDecoder_NewImage(REINTERPRET_CAST(kData, UInt8 const*), kDataSize, 1, 1, pixelsH, pixelsV);
+		Console_TestAssertUpdate(result, nullptr != image, Console_WriteLine, "scanned image was created");
+		if (nullptr != image)
+		{
+			Console_TestAssertUpdate(result, kGreen == returnImagePixel(image, 2, 5), Console_WriteLine, "first band");
+			Console_TestAssertUpdate(result, 0 == returnImagePixel(image, 3, 0), Console_WriteLine, "past first band");
+			Console_TestAssertUpdate(result, kGreen == returnImagePixel(image, 3, 9), Console_WriteLine, "repetition, last bit");
+			Console_TestAssertUpdate(result, 0 == returnImagePixel(image, 3, 10), Console_WriteLine, "repetition, bit that is off");
+			CGImageRelease(image); image = nullptr;
+		}
+	}
+	
+	// raster attributes (with a 2:1 aspect ratio) determine the size and
+	// cause the first color to fill the background
+	{
+		char const*		kData = "\"2;1;3;2#1;2;0;100;0#2;2;100;0;0#2AA";
+		size_t const	kDataSize = std::strlen(kData);
+		CGImageRef		image = nullptr;
+		
+		
+		SixelDecoder_GetImageSize(REINTERPRET_CAST(kData, UInt8 const*), kDataSize, 1, 1, pixelsH, pixelsV);
+		Console_TestAssertUpdate(result, 3 == pixelsH, Console_WriteValue, "given width", pixelsH);
+		Console_TestAssertUpdate(result, 4 == pixelsV, Console_WriteValue, "given height", pixelsV);
+		
+		image = SixelDecoder_NewImage(REINTERPRET_CAST(kData, UInt8 const*), kDataSize, 1, 1, pixelsH, pixelsV);
+		Console_TestAssertUpdate(result, nullptr != image, Console_WriteLine, "given image was created");
+		if (nullptr != image)
+		{
+			Console_TestAssertUpdate(result, makePixel(0xFF, 0, 0) == returnImagePixel(image, 1, 2), Console_WriteLine, "second bit, double height");
+			Console_TestAssertUpdate(result, makePixel(0xFF, 0, 0) == returnImagePixel(image, 1, 3), Console_WriteLine, "second bit, double height (2)");
+			Console_TestAssertUpdate(result, kGreen == returnImagePixel(image, 1, 1), Console_WriteLine, "background");
+			Console_TestAssertUpdate(result, kGreen == returnImagePixel(image, 2, 3), Console_WriteLine, "background past sixels");
+			CGImageRelease(image); image = nullptr;
+		}
+	}
+	
+	return result;
+}// unitTest_Decode_000
+
+
+/*!
+Tests decoding Sixel data that arrives in small pieces
+(as it can from a terminal), which must give the same
+size and pixels as decoding the data all at once.  There
+are more pieces than are allowed to wait for decoding, so
+this also requires appending to wait correctly.
+
+Returns "true" if ALL assertions pass; "false" is returned
+if any fail, however messages should be printed for ALL
+assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_Stream_000 ()
+{
+	Boolean			result = true;
+	char const*		kDataList[] =
+					{
+						"#1;2;0;100;0#1~~~-!4N",
+						"\"2;1;3;2#1;2;0;100;0#2;2;100;0;0#2AA",
+					};
+	
+	
+	for (char const* dataString : kDataList)
+	{
+		UInt8 const*			kData = REINTERPRET_CAST(dataString, UInt8 const*);
+		size_t const			kDataSize = std::strlen(dataString);
+		SixelDecoder_Stream		stream(1, 1);
+		dispatch_semaphore_t	doneSignal = dispatch_semaphore_create(0);
+		__block CGImageRef		streamImage = nullptr;
+		CGImageRef				wholeImage = nullptr;
+		UInt16					pixelsH = 0;
+		UInt16					pixelsV = 0;
+		UInt16					streamPixelsH = 0;
+		UInt16					streamPixelsV = 0;
+		
+		
+		// split every command, including the parameters of colors,
+		// raster attributes and repetitions
+		for (size_t i = 0; i < kDataSize; ++i)
+		{
+			stream.appendData(kData + i, 1);
+		}
+		stream.getImageSize(streamPixelsH, streamPixelsV);
+		stream.finishImage(^(CGImageRef inImage)
+		{
+			streamImage = inImage;
+			dispatch_semaphore_signal(doneSignal);
+		});
+		dispatch_semaphore_wait(doneSignal, DISPATCH_TIME_FOREVER);
+		dispatch_release(doneSignal);
+		
+		SixelDecoder_GetImageSize(kData, kDataSize, 1, 1, pixelsH, pixelsV);
+		Console_TestAssertUpdate(result, pixelsH == streamPixelsH, Console_WriteValue, "streamed width", streamPixelsH);
+		Console_TestAssertUpdate(result, pixelsV == streamPixelsV, Console_WriteValue, "streamed height", streamPixelsV);
+		
+		wholeImage = SixelDecoder_NewImage(kData, kDataSize, 1, 1, pixelsH, pixelsV);
+		Console_TestAssertUpdate(result, nullptr != streamImage, Console_WriteLine, "streamed image was created");
+		if ((nullptr != streamImage) && (nullptr != wholeImage))
+		{
+			Boolean		pixelsMatch = true;
+			
+			
+			for (UInt16 y = 0; y < pixelsV; ++y)
+			{
+				for (UInt16 x = 0; x < pixelsH; ++x)
+				{
+					pixelsMatch = (pixelsMatch && (returnImagePixel(wholeImage, x, y) == returnImagePixel(streamImage, x, y)));
+				}
+			}
+			Console_TestAssertUpdate(result, pixelsMatch, Console_WriteValueCString, "streamed pixels match, data", dataString);
+		}
+		
+		if (nullptr != streamImage)
+		{
+			CGImageRelease(streamImage); streamImage = nullptr;
+		}
+		if (nullptr != wholeImage)
+		{
+			CGImageRelease(wholeImage); wholeImage = nullptr;
+		}
+	}
+	
+	return result;
+}// unitTest_Stream_000
+
+} // anonymous namespace
+
+
 // BELOW IS REQUIRED NEWLINE TO END FILE
@@ -36,6 +36,7 @@
 
 // standard-C++ includes
 #include <bitset>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -43,7 +44,9 @@
 #include <ParameterDecoder.h>
 
 // Mac includes
+#include <CoreGraphics/CoreGraphics.h>
 #include <CoreServices/CoreServices.h>
+#include <dispatch/dispatch.h>
 
 
 #pragma mark Constants
@@ -65,6 +68,13 @@ too large.
 */
 UInt16 const kSixelDecoder_RepeatCountMaximum = 2048;
 
+/*!
+The largest width or height, in pixels, of an image that is
+decoded by SixelDecoder_NewImage().  Any sixels beyond this
+are ignored (the image is clipped).
+*/
+UInt16 const kSixelDecoder_ImageSizeMaximum = 8192;
+
 #pragma mark Types
 
 /*!
@@ -112,6 +122,14 @@ IMPORTANT:	The graphics cursor
 */
 typedef void (^SixelDecoder_SixelHandler)(UInt8 inRawCharacter, UInt16 inRepeatCount);
 
+/*!
+An “image handler block” receives the result of decoding a
+stream of Sixel data (see SixelDecoder_Stream::finishImage()),
+or nullptr if there is no image.  The block is responsible for
+calling CGImageRelease() on the image.
+*/
+typedef void (^SixelDecoder_ImageHandler)(CGImageRef);
+
 /*!
 Manages the state of decoding a stream of Sixel data.
 */
@@ -159,6 +177,10 @@ struct SixelDecoder_StateMachine
 	//! Frees blocks stored in the state machine.
 	~SixelDecoder_StateMachine ();
 	
+	//! Decodes a buffer of Sixel data (which may be any part of a stream), invoking blocks as needed.
+	void
+	decodeRun	(UInt8 const*, size_t);
+	
 	//! Returns values of the (up to 6) pixels indicated by a raw Sixel data value.
 	static void
 	getSixelBits	(UInt8, std::bitset<6>&);
@@ -230,4 +252,150 @@ private:
 	State						currentState;	//!< determines which additional bytes are valid
 };
 
+/*!
+A growable buffer of 32-bit RGBA pixels, for drawing sixels
+as they are decoded (see SixelDecoder_NewImage()).
+
+The final size of a Sixel image is not known until all of
+its data has been decoded, so the buffer grows (doubling its
+width or height) as sixels are drawn beyond its edges, and
+new areas are filled with the background color.  Each row
+of a sixel becomes a horizontal span of identical pixels
+that is filled with one call to memset_pattern4(), so a long
+repetition costs little more than a single sixel.
+*/
+struct SixelDecoder_Canvas
+{
+	//! Constructs an empty canvas, with room for an image of the given size.
+	SixelDecoder_Canvas		(UInt16 = 0, UInt16 = 0);
+	
+	//! Returns an image with the given size (padded or clipped), and empties the canvas.
+	CGImageRef
+	createImage	(UInt16, UInt16);
+	
+	//! Adds or replaces a palette entry; the components have the ranges of SixelDecoder_ColorCreator.
+	void
+	defineColor		(UInt16, SixelDecoder_ColorType, UInt16, UInt16, UInt16);
+	
+	//! Draws the “on” bits of a raw sixel value the given number of times, at a graphics cursor position.
+	void
+	drawSixels	(UInt16, UInt16, UInt8, UInt16);
+	
+	//! Sets every pixel (including those added by growth later) to a palette entry.
+	void
+	fillBackground	(UInt16);
+	
+	//! Chooses the palette entry for future calls to drawSixels(); undefined entries draw nothing.
+	void
+	selectColor		(UInt16);
+	
+	UInt16		sixelWidth;		//!< number of pixels across for one sixel
+	UInt16		sixelHeight;	//!< number of pixels down for EACH of the 6 bits of a sixel
+
+protected:
+	//! Reallocates the pixels, if necessary, so that the given number of columns and rows exist.
+	void
+	growToInclude	(UInt32, UInt32);
+
+private:
+	std::vector< UInt32 >	pixels;				//!< RGBA bytes (red first) of each pixel, row by row
+	UInt32					columnCapacity;		//!< number of pixels in each row of "pixels"
+	UInt32					rowCapacity;		//!< number of rows in "pixels"
+	std::vector< UInt32 >	palette;			//!< pixel value for each color index; zero alpha if undefined
+	UInt32					backgroundPixel;	//!< value of new pixels
+	UInt32					currentPixel;		//!< value of pixels drawn by drawSixels()
+	Boolean					haveColor;			//!< if false, drawSixels() has no effect
+};
+
+
+/*!
+Decodes Sixel data that arrives in pieces (for instance, as
+a terminal reads it), so that the data never has to be kept
+in full no matter how large the image is.
+
+Each piece given to appendData() is copied and then decoded
+on a serial queue, in order, into a growing pixel buffer (see
+SixelDecoder_Canvas).  Meanwhile, the size of the image is
+tracked on the calling thread: it comes from raster attributes
+when the data begins with them, or else from a scan that does
+not draw anything.  Therefore, getImageSize() is accurate as
+soon as the last piece has been appended, even though pixels
+may still be decoding.
+
+The methods of this object must be called from one thread
+at a time (normally, the main thread).
+*/
+struct SixelDecoder_Stream
+{
+	struct Drawing;		//!< the state that is used by the decoding queue (defined by the implementation)
+	
+	//! Prepares to decode data with the given default aspect ratio (pan, pad).
+	SixelDecoder_Stream		(UInt16, UInt16);
+	
+	//! Releases the queue; any decoding that is still scheduled continues until it finishes.
+	~SixelDecoder_Stream ();
+	
+	//! Schedules the next piece of data to be decoded (and updates the size); waits if too many pieces are pending.
+	void
+	appendData	(UInt8 const*, size_t);
+	
+	//! Schedules the image to be created after all appended data is decoded; the block runs on the queue.
+	void
+	finishImage		(SixelDecoder_ImageHandler);
+	
+	//! Returns the size, in pixels, of the image that the data appended so far describes.
+	void
+	getImageSize	(UInt16&, UInt16&) const;
+
+private:
+	//! Copy is not allowed (the queue and drawing are shared with scheduled blocks).
+	SixelDecoder_Stream (SixelDecoder_Stream const&) = delete;
+	
+	//! Copy is not allowed (the queue and drawing are shared with scheduled blocks).
+	SixelDecoder_Stream&
+	operator =(SixelDecoder_Stream const&) = delete;
+	
+	dispatch_queue_t				decodingQueue;	//!< serial queue that decodes each piece of data in order
+	dispatch_semaphore_t			pieceLimit;		//!< limits the number of appended pieces that are waiting to be decoded
+	std::shared_ptr< Drawing >		drawing;		//!< decoder and canvas that are used only on "decodingQueue"
+	SixelDecoder_StateMachine		sizeScanner;	//!< decoder without blocks, used on the calling thread to track the size
+	Boolean							haveRasterSize;	//!< if true, raster attributes gave the size so "sizeScanner" is no longer used
+};
+
+
+
+#pragma mark Public Methods
+
+//!\name Module Tests
+//@{
+
+void
+	SixelDecoder_RunTests			();
+
+void
+	SixelDecoder_RunBenchmarks		();
+
+//@}
+
+//!\name Decoding Images
+//@{
+
+void
+	SixelDecoder_GetImageSize		(UInt8 const*		inData,
+									 size_t				inByteCount,
+									 UInt16				inDefaultAspectRatioV,
+									 UInt16				inDefaultAspectRatioH,
+									 UInt16&			outPixelsH,
+									 UInt16&			outPixelsV);
+
+CGImageRef
+	SixelDecoder_NewImage			(UInt8 const*		inData,
+									 size_t				inByteCount,
+									 UInt16				inDefaultAspectRatioV,
+									 UInt16				inDefaultAspectRatioH,
+									 UInt16				inPixelsH,
+									 UInt16				inPixelsV);
+
+//@}
+
 // BELOW IS REQUIRED NEWLINE TO END FILE
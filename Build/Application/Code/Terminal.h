@@ -48,6 +48,7 @@
 #pragma once
 
 // standard-C++ includes
+#include <memory>
 #include <vector>
 
 // Mac includes
@@ -205,12 +206,46 @@ enum
 	kTerminal_TextFilterFlagsNoEndWhitespace			= (1 << 0)		//!< skip all whitespace characters at the end of lines
 };
 
+/*!
+Since every cell holds exactly one UTF-16 unit, a double-width
+character from the Basic Multilingual Plane (such as a CJK
+ideograph) is followed by this value in its second cell.  It is
+a zero-width space so that lines still draw correctly, but it
+should be removed from any text that is copied (see
+Terminal_RemoveWideCharacterContinuations()).  (Double-width
+characters outside this plane use the 2 cells for a surrogate
+pair instead.)
+*/
+enum : UniChar
+{
+	kTerminal_WideCharacterContinuation		= 0x200B	//!< placeholder in the second cell of a double-width character
+};
+
 #pragma mark Types
 
 #include "TerminalScreenRef.typedef.h"
 
 typedef struct Terminal_OpaqueLineIterator*		Terminal_LineRef;	//!< efficient access to an arbitrary screen line
 
+/*!
+An immutable copy of the rows of a main screen, as of one
+call to Terminal_PublishSnapshot().  A snapshot never
+changes once it is published, so it can be kept (and read
+on any thread) while the terminal continues to change.
+Each row is a shared copy that is only made again when the
+row changes, so consecutive snapshots share most rows.
+
+IMPORTANT:	Snapshots are built on the main thread, from the
+			live buffer, and data is still parsed on the
+			main thread too; so a snapshot only gives one
+			drawing pass a consistent copy at a cost that
+			is proportional to the rows that changed.  It
+			does not keep a busy terminal from delaying
+			other terminals.
+*/
+struct Terminal_Snapshot;
+typedef std::shared_ptr< Terminal_Snapshot const >	Terminal_SnapshotPtr;
+
 /*!
 An iterator may be allocated on the stack (instead of
 incurring an automatic heap allocation) by declaring
@@ -236,6 +271,12 @@ struct Terminal_ScrollDescription
 											//!  greater than zero if content scrolled downward and clipped
 											//!  the bottom of the main screen; equal to zero if the scrollback
 											//!  was modified in some unspecified way (e.g. being cleared)
+	SInt16				screenRowDelta;		//!< if nonzero, every main screen row moved by this number of rows
+											//!  (upward if negative) BEFORE any "kTerminal_ChangeTextEdited"
+											//!  that follows, and only the rows that were exposed are reported
+											//!  as edited; a consumer can simply move its existing copy of the
+											//!  other rows (snapshots do, though views currently redraw them);
+											//!  if zero, edits report every row that changed
 };
 typedef Terminal_ScrollDescription const*	Terminal_ScrollDescriptionConstPtr;
 
@@ -275,10 +316,68 @@ typedef void (^Terminal_ScreenRunBlock)	(UInt16						inLineTextBufferOrWhitespac
 										 UInt16						inZeroBasedStartColumnNumber,
 										 TextAttributes_Object		inAttributes);
 
+/*!
+Search Results Block
+
+Used by Terminal_SearchIncrementally() to deliver matches
+in batches, as soon as they are found.  Matches arrive in
+the same order as they would from Terminal_Search(), even
+though several parts of the buffer are searched at once.
+
+IMPORTANT:	Other parts of the buffer are still being read
+			by other threads while the block runs, so the
+			block must not change the terminal in any way
+			(this includes highlighting text, which changes
+			attributes).  Keep the ranges, and use them after
+			Terminal_SearchIncrementally() returns.  (This
+			does not apply to Terminal_SearchInBackground(),
+			which invokes the block on the main queue at a
+			time when the terminal may be changed.)
+
+Set the stop flag to true to end the search early; no more
+batches will be delivered.
+*/
+typedef void (^Terminal_SearchResultsBlock)	(std::vector< Terminal_RangeDescription > const&	inMatchBatch,
+											 Boolean&										outStopSearch);
+
+/*!
+Search Cancel Block
+
+Used by Terminal_SearchIncrementally() to find out whether
+the search should end early.  It is invoked on the calling
+thread several times per second until the search ends,
+whether or not any matches are found, so that a long search
+can always be abandoned (e.g. because the user has typed
+something new).  Return true to stop the search.
+
+Like the results block, this must not change the terminal.
+For Terminal_SearchInBackground(), the block runs on another
+thread, so it should only read a value that is safe to use
+from any thread (such as a "std::atomic").
+*/
+typedef Boolean (^Terminal_SearchCancelBlock)	();
+
+/*!
+Search Completion Block
+
+Used by Terminal_SearchInBackground() to announce that a
+search has ended (whether or not it was stopped early).  It
+is invoked on the main queue, after every batch of matches.
+*/
+typedef void (^Terminal_SearchCompletionBlock)	();
+
 
 
 #pragma mark Public Methods
 
+//!\name Module Tests
+//@{
+
+void
+	Terminal_RunTests						();
+
+//@}
+
 //!\name Creating and Destroying Terminal Screen Buffers
 //@{
 
@@ -362,6 +461,22 @@ Terminal_Result
 
 //@}
 
+//!\name Screen Snapshots
+//@{
+
+Terminal_SnapshotPtr
+	Terminal_PublishSnapshot				(TerminalScreenRef			inScreen);
+
+Terminal_Result
+	Terminal_SnapshotForEachLikeAttributeRun	(Terminal_SnapshotPtr const&	inSnapshot,
+											 UInt16						inZeroBasedRow,
+											 Terminal_ScreenRunBlock	inDoWhat);
+
+UInt16
+	Terminal_SnapshotReturnRowCount			(Terminal_SnapshotPtr const&	inSnapshot);
+
+//@}
+
 //!\name Buffer Search
 //@{
 
@@ -371,6 +486,21 @@ Terminal_Result
 											 Terminal_SearchFlags		inFlags,
 											 std::vector< Terminal_RangeDescription >&	outMatches);
 
+Terminal_Result
+	Terminal_SearchInBackground				(TerminalScreenRef			inScreen,
+											 CFStringRef				inQuery,
+											 Terminal_SearchFlags		inFlags,
+											 Terminal_SearchResultsBlock	inResultsHandler,
+											 Terminal_SearchCancelBlock	inCancelBlockOrNull = nullptr,
+											 Terminal_SearchCompletionBlock	inCompletionBlockOrNull = nullptr);
+
+Terminal_Result
+	Terminal_SearchIncrementally			(TerminalScreenRef			inScreen,
+											 CFStringRef				inQuery,
+											 Terminal_SearchFlags		inFlags,
+											 Terminal_SearchResultsBlock	inResultsHandler,
+											 Terminal_SearchCancelBlock	inCancelBlockOrNull = nullptr);
+
 //@}
 
 //!\name Accessing Screen Data
@@ -429,6 +559,10 @@ Terminal_Result
 											 CFRange&					outReferenceRange,
 											 Terminal_TextFilterFlags	inFlags = 0);
 
+CFIndex
+	Terminal_RemoveWideCharacterContinuations	(CFMutableStringRef		inoutText,
+											 CFRange					inRange);
+
 //@}
 
 //!\name Terminal State
@@ -640,6 +774,13 @@ void
 void
 	Terminal_DebugDumpDetailedSnapshot		(TerminalScreenRef			inScreen);
 
+Terminal_Result
+	Terminal_DebugRunThroughputBenchmark	(CFStringRef				inDescription,
+											 UInt8 const*				inBuffer,
+											 size_t						inLength,
+											 UInt16						inIterationCount,
+											 Boolean					inMachineReadable = false);
+
 //@}
 
 // BELOW IS REQUIRED NEWLINE TO END FILE
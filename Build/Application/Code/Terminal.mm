@@ -41,9 +41,14 @@
 
 // standard-C++ includes
 #import <algorithm>
+#import <atomic>
+#import <bitset>
+#import <deque>
 #import <iterator>
 #import <list>
 #import <map>
+#import <memory>
+#import <numeric>
 #import <set>
 #import <sstream>
 #import <stdexcept>
@@ -55,9 +60,18 @@
 extern "C"
 {
 #	include <errno.h>
+#	include <mach/mach.h>
+#	include <malloc/malloc.h>
 }
 #include <pthread.h>
 
+// compiler includes
+#if defined(__SSE2__)
+#	include <immintrin.h>
+#elif defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
 // Mac includes
 @import ApplicationServices;
 @import CoreServices;
@@ -74,11 +88,14 @@ extern "C"
 #import <Registrar.template.h>
 #import <SoundSystem.h>
 #import <StringUtilities.h>
+#import <UnicodeWidth.h>
+#import <WorkPool.h>
 
 // application includes
 #import "Commands.h"
 #import "DebugInterface.h"
 #import "Emulation.h"
+#import "ImageStore.h"
 #import "Preferences.h"
 #import "PrintTerminal.h"
 #import "QuillsTerminal.h"
@@ -462,6 +479,13 @@ enum
 										// this will be the maximum <param>s allowed
 };
 
+size_t const	kMy_PayloadPieceSize			= (64 * 1024);		//!< number of bytes of a long string (such as image data) that are accumulated
+																	//!  before they are passed to the "payloadHandler" of the emulator
+size_t const	kMy_StringAccumulatorMaximum	= (1024 * 1024);	//!< a string that has no "payloadHandler" (so it is accumulated in full) is
+																	//!  abandoned if it grows beyond this many bytes without terminating
+size_t const	kMy_ITermFileMaximum			= (20 * 1024 * 1024);	//!< an iTerm2 file whose decoded data grows beyond this many bytes is
+																		//!  abandoned (arbitrary; TEMPORARY; make user-configurable?)
+
 } // anonymous namespace
 
 #pragma mark Callbacks
@@ -502,6 +526,25 @@ invokeEmulatorEchoDataProc	(My_EmulatorEchoDataProcPtr		inProc,
 	return (*inProc)(inDataPtr, inBuffer, inLength);
 }
 
+/*!
+Emulator Payload Block
+
+Receives the next piece of a long string sequence (such as
+the data of an image) as soon as it arrives, so that the
+string never has to be accumulated in full.  The final flag
+is set for the last piece, when the string terminates;
+otherwise, more pieces are expected.
+
+A state transition installs this block in the emulator once
+it has seen enough of the string to recognize its purpose
+(for instance, the parameters that introduce Sixel data).
+See streamStringAccumulator().
+*/
+typedef void (^My_EmulatorPayloadBlock)		(My_ScreenBuffer*	inDataPtr,
+											 UInt8 const*		inBuffer,
+											 size_t				inLength,
+											 Boolean			inIsFinal);
+
 /*!
 Emulator Reset Routine
 
@@ -630,7 +673,6 @@ typedef TerminalLine_Object		My_ScreenBufferLine;
 typedef TerminalLine_Handle		My_ScreenBufferLinePtr; // see createLinePtr(), deleteLinePtr()
 
 typedef std::list< My_ScreenBufferLinePtr >		My_ScreenBufferLineList;
-typedef std::list< My_ScreenBufferLinePtr >		My_ScrollbackBufferLineList;
 typedef My_ScreenBufferLineList::size_type		My_ScreenRowIndex;
 
 typedef std::basic_string< UInt8 >				My_ByteString;
@@ -645,6 +687,8 @@ typedef std::vector< char >						My_TabStopList;
 
 typedef std::map< UInt32, TextAttributes_TrueColorID >		My_TrueColorIDByComponentKey;
 
+typedef std::vector< UniChar >					My_UniCharList;
+
 typedef std::list< void const* >				My_VoidPtrList;
 
 /*!
@@ -736,2163 +780,4181 @@ public:
 };
 
 /*!
-Represents a line of the terminal buffer, either in the
-scrollback or one of the main screen (“visible”) lines.
+An optional index of the trigrams (sequences of 3 characters)
+in scrollback lines, so that searches can skip lines that
+cannot contain a literal query (see My_ScrollbackBuffer).
 
-A line iterator can traverse from the oldest scrollback
-line (the beginning) all the way to the bottommost main
-screen line (the end), as if all terminal lines were
-stored sequentially in memory.
+Lines are grouped into blocks of consecutive sequence numbers
+and each block has a fixed-size set of bits, one per trigram
+hash (effectively a Bloom filter with a single hash), so the
+memory used depends only on the number of lines and never on
+the variety of their text.  Several trigrams can share a bit
+so a block may be searched unnecessarily, but a block never
+appears to lack a trigram that it has.  ASCII letters are
+folded to lowercase, so the same bits serve searches that do
+or do not ignore case.
 
-IMPORTANT:	Since the scrollback size is cached, it is
-			important that the scrollback buffer NOT be
-			changed without updating the cache.  The
-			iterator holds a non-constant reference to
-			the buffer, but should have no legitimate
-			reason to resize the buffer.
+Lines outside the indexed blocks (such as blank lines that
+were inserted before the oldest line, or lines in the oldest
+blocks that were dropped to respect "kByteLimit") and any
+blocks that may be out of date (see invalidateLine()) are
+always searched.
 */
-struct My_LineIterator
+class My_ScrollbackSearchIndex
 {
 public:
-	enum BufferTarget
-	{
-		kBufferTargetScreen = 0,
-		kBufferTargetScrollback = 1
-	};
+	typedef SInt64		SequenceNumber;
+	typedef UInt16		TrigramHash;
 	
-	enum ScreenBufferDesignator
+	enum
 	{
-		kScreenBufferDesignator = 0
+		kLinesPerBlock = 16,				//!< number of consecutive lines that share bits
+		kBitsPerBlock = 4096,				//!< number of distinct trigram hashes
+		kByteLimit = 32 * 1024 * 1024		//!< the oldest blocks are dropped to stay within this many bytes
 	};
 	
-	// the "inDesignateScreen" is used only to provide a unique
-	// constructor signature in the event that the two buffers
-	// are set to exactly the same underlying container type
-	My_LineIterator		(Boolean							isHeapStorage,
-						 My_ScreenBufferLineList&			inScreenBuffer,
-						 My_ScrollbackBufferLineList&		inScrollbackBuffer,
-						 My_ScreenBufferLineList::iterator	inRowIterator,
-						 ScreenBufferDesignator				UNUSED_ARGUMENT(inDesignateScreen))
+	My_ScrollbackSearchIndex ()
 	:
-	screenBuffer(inScreenBuffer),
-	scrollbackBuffer(inScrollbackBuffer),
-	screenRowIterator(inRowIterator),
-	scrollbackRowIterator(),
-	currentBufferType(kBufferTargetScreen),
-	heapAllocated(isHeapStorage)
+	blocks(),
+	firstBlockNumber(0),
+	invalidBlockNumbers()
 	{
 	}
 	
-	// this version constructs iterators starting in the scrollback
-	My_LineIterator		(Boolean								isHeapStorage,
-						 My_ScreenBufferLineList&				inScreenBuffer,
-						 My_ScrollbackBufferLineList&			inScrollbackBuffer,
-						 My_ScrollbackBufferLineList::iterator	inRowIterator)
-	:
-	screenBuffer(inScreenBuffer),
-	scrollbackBuffer(inScrollbackBuffer),
-	screenRowIterator(),
-	scrollbackRowIterator(inRowIterator),
-	currentBufferType(kBufferTargetScrollback),
-	heapAllocated(isHeapStorage)
+	//! Records every trigram in the given characters as part of
+	//! the line with the given sequence number.  Blank lines should
+	//! also be added (with no characters), except that they do not
+	//! start an empty index.
+	void
+	addTrigrams		(SequenceNumber		inSequenceNumber,
+					 UniChar const*		inCharacters,
+					 size_t				inLength)
 	{
+		Block*		blockPtr = ((0 == inLength) && blocks.empty())
+								? nullptr
+								: returnBlockForLine(inSequenceNumber);
+		
+		
+		if (nullptr != blockPtr)
+		{
+			for (size_t i = 2; i < inLength; ++i)
+			{
+				blockPtr->bits.set(returnTrigramHash(inCharacters[i - 2], inCharacters[i - 1], inCharacters[i]));
+			}
+		}
 	}
 	
-	My_ScreenBufferLine&
-	currentLine ()
+	//! Discards all blocks.
+	void
+	clear ()
 	{
-		// these dereferences will crash if past the end, which is expected (STL-like) behavior
-		return (currentBufferType == kBufferTargetScreen)
-				? **screenRowIterator
-				: **scrollbackRowIterator;
+		blocks.clear();
+		invalidBlockNumbers.clear();
 	}
 	
-	//! Returns either the oldest scrollback line, or the topmost
-	//! main screen line when the scrollback is empty.
-	My_ScreenBufferLine&
-	firstLine ()
+	//! Discards blocks that only contain lines older than the
+	//! given sequence number.
+	void
+	discardBefore	(SequenceNumber		inOldestSequenceNumber)
 	{
-		// the back of the scrollback is used because its first line is the one
-		// that is closest to the main screen, and the front (from the caller’s
-		// perspective) must be the oldest scrollback line
-		return (scrollbackBuffer.empty() || (currentBufferType == kBufferTargetScreen))
-				? *(screenBuffer.front())
-				: *(scrollbackBuffer.back());
+		while ((false == blocks.empty()) && (returnBlockNumber(inOldestSequenceNumber) > firstBlockNumber))
+		{
+			blocks.pop_front();
+			++firstBlockNumber;
+		}
 	}
 	
-	//! Increments the internal line pointer so that currentLine() now
-	//! refers to the next line in the scrollback or screen buffer, as
-	//! appropriate.  Returns a reference to the new currentLine().
-	//! If the returned line is the last valid line, "isEnd" is set to
-	//! true; otherwise, it is set to false.  The initial value of
-	//! "isEnd" is ignored.
-	My_ScreenBufferLine&
-	goToNextLine	(Boolean&	isEnd)
+	//! Marks the blocks that depend on the given line (including
+	//! text that may continue onto the following rows) as unknown,
+	//! so that they are always searched until they are rebuilt
+	//! (see takeInvalidBlocks()); used when a line may change.
+	void
+	invalidateLine	(SequenceNumber		inSequenceNumber)
 	{
-		// IMPORTANT:	The scrollback buffer is stored in the opposite
-		//			sense that it is returned by this iterator: the
-		//			beginning of the scrollback is the line nearest
-		//			the main screen.  So, the scrollback buffer is
-		//			traversed backward to reach “next lines”.
-		isEnd = false;
-		if ((currentBufferType == kBufferTargetScrollback) &&
-			(scrollbackBuffer.empty() || (scrollbackBuffer.front() == &currentLine())))
-		{
-			// change the iterator to look at the screen buffer instead
-			currentBufferType = kBufferTargetScreen;
-			screenRowIterator = screenBuffer.begin();
-		}
-		else
+		SequenceNumber const	kFirstBlockNumber = returnBlockNumber(inSequenceNumber);
+		SequenceNumber const	kLastBlockNumber = returnBlockNumber(inSequenceNumber + 2);
+		
+		
+		for (SequenceNumber blockNumber = kFirstBlockNumber; blockNumber <= kLastBlockNumber; ++blockNumber)
 		{
-			if ((currentBufferType == kBufferTargetScrollback) &&
-				(scrollbackBuffer.begin() != scrollbackRowIterator))
+			if ((blockNumber >= firstBlockNumber) && (blockNumber < returnPastEndBlockNumber()))
 			{
-				--scrollbackRowIterator; // scrollback is inverted
+				Block&	blockRef = blocks[STATIC_CAST(blockNumber - firstBlockNumber, size_t)];
+				
+				
+				if (blockRef.isValid)
+				{
+					blockRef.isValid = false;
+					invalidBlockNumbers.push_back(blockNumber);
+				}
 			}
-			else if ((currentBufferType == kBufferTargetScreen) &&
-						(*screenRowIterator != &lastLine()))
+		}
+	}
+	
+	//! Returns false only if the index proves that the text formed
+	//! by the given range of lines (joined, as for soft-wrapped lines)
+	//! cannot contain every one of the given trigram hashes.
+	bool
+	isCandidate		(SequenceNumber						inFirstSequenceNumber,
+					 SequenceNumber						inLastSequenceNumber,
+					 std::vector< TrigramHash > const&	inTrigramHashes)
+	const
+	{
+		SequenceNumber const	kFirstBlockNumber = returnBlockNumber(inFirstSequenceNumber);
+		SequenceNumber const	kLastBlockNumber = returnBlockNumber(inLastSequenceNumber);
+		bool					result = true;
+		
+		
+		if ((kFirstBlockNumber >= firstBlockNumber) && (kLastBlockNumber < returnPastEndBlockNumber()))
+		{
+			auto const		kFirstBlockIterator = blocks.begin() + STATIC_CAST(kFirstBlockNumber - firstBlockNumber, size_t);
+			auto const		kPastEndBlockIterator = blocks.begin() + STATIC_CAST(kLastBlockNumber + 1 - firstBlockNumber, size_t);
+			
+			
+			if (std::all_of(kFirstBlockIterator, kPastEndBlockIterator, [](Block const& inBlock) { return inBlock.isValid; }))
 			{
-				++screenRowIterator;
+				for (TrigramHash const kHash : inTrigramHashes)
+				{
+					if (std::none_of(kFirstBlockIterator, kPastEndBlockIterator,
+										[kHash](Block const& inBlock) { return inBlock.bits.test(kHash); }))
+					{
+						result = false;
+						break;
+					}
+				}
 			}
-			else
+		}
+		return result;
+	}
+	
+	//! Returns the number of bytes used by all blocks.
+	size_t
+	returnByteCount ()
+	const
+	{
+		return (blocks.size() * sizeof(Block));
+	}
+	
+	//! Returns the number of line sequence numbers that the
+	//! index covers (this may include a few that do not exist).
+	size_t
+	returnLineCount ()
+	const
+	{
+		return (blocks.size() * kLinesPerBlock);
+	}
+	
+	//! Returns the hash of the given trigram (which may equal the
+	//! hash of other trigrams).
+	static TrigramHash
+	returnTrigramHash	(UniChar	inFirst,
+						 UniChar	inSecond,
+						 UniChar	inThird)
+	{
+		auto const		kFold = [](UniChar inCharacter) -> UInt64
+								{
+									return (((inCharacter >= 'A') && (inCharacter <= 'Z'))
+											? (inCharacter + ('a' - 'A'))
+											: inCharacter);
+								};
+		UInt64 const	kKey = ((kFold(inFirst) << 32) | (kFold(inSecond) << 16) | kFold(inThird));
+		
+		
+		// multiplicative hash; the high bits are the best mixed
+		return STATIC_CAST((kKey * 0x9E3779B97F4A7C15ULL) >> (64 - 12/* log2(kBitsPerBlock) */), TrigramHash);
+	}
+	
+	//! Clears every block that was marked by invalidateLine() and
+	//! considers it valid again, returning the sequence number of
+	//! the first line of each one; the caller must then add the
+	//! trigrams of every line in those blocks.
+	void
+	takeInvalidBlocks	(std::vector< SequenceNumber >&		outFirstSequenceNumbers)
+	{
+		outFirstSequenceNumbers.clear();
+		for (SequenceNumber const kBlockNumber : invalidBlockNumbers)
+		{
+			if ((kBlockNumber >= firstBlockNumber) && (kBlockNumber < returnPastEndBlockNumber()))
 			{
-				isEnd = true;
+				Block&	blockRef = blocks[STATIC_CAST(kBlockNumber - firstBlockNumber, size_t)];
+				
+				
+				blockRef.bits.reset();
+				blockRef.isValid = true;
+				outFirstSequenceNumbers.push_back(kBlockNumber * kLinesPerBlock);
 			}
 		}
-		return currentLine();
+		invalidBlockNumbers.clear();
+	}
+
+private:
+	struct Block
+	{
+		std::bitset< kBitsPerBlock >	bits;		//!< set for the hash of every trigram in the block’s lines
+		bool							isValid;	//!< if false, the bits may be incomplete
+	};
+	
+	//! Returns the number of the block that contains the given line.
+	static SequenceNumber
+	returnBlockNumber	(SequenceNumber		inSequenceNumber)
+	{
+		// round toward negative infinity (sequence numbers can be negative)
+		return ((inSequenceNumber >= 0)
+				? (inSequenceNumber / kLinesPerBlock)
+				: (-((-inSequenceNumber + kLinesPerBlock - 1) / kLinesPerBlock)));
 	}
 	
-	//! Decrements the internal line pointer so that currentLine() now
-	//! refers to the previous line in the scrollback or screen buffer,
-	//! as appropriate.  Returns a reference to the new currentLine().
-	//! If the returned line is the first valid line, "isEnd" is set to
-	//! true; otherwise, it is set to false.  The initial value of
-	//! "isEnd" is ignored.
-	My_ScreenBufferLine&
-	goToPreviousLine	(Boolean&	isEnd)
+	//! Returns the block for the given line, adding blocks as needed
+	//! (and dropping the oldest ones if the memory limit is reached);
+	//! or, returns nullptr if the line is older than every block.
+	Block*
+	returnBlockForLine	(SequenceNumber		inSequenceNumber)
 	{
-		// IMPORTANT:	The scrollback buffer is stored in the opposite
-		//			sense that it is returned by this iterator: the
-		//			beginning of the scrollback is the line nearest
-		//			the main screen.  So, the scrollback buffer is
-		//			traversed forward to reach “previous lines”.
-		isEnd = false;
-		if ((currentBufferType == kBufferTargetScreen) &&
-			(screenBuffer.front() == &currentLine()))
+		SequenceNumber const	kBlockNumber = returnBlockNumber(inSequenceNumber);
+		Block*					result = nullptr;
+		
+		
+		if (blocks.empty())
 		{
-			// change the iterator to look at the scrollback buffer instead
-			currentBufferType = kBufferTargetScrollback;
-			scrollbackRowIterator = scrollbackBuffer.begin();
+			// blank lines before this one may share the first block
+			// but were not added; since they might have changed, the
+			// block is rebuilt before it is used
+			firstBlockNumber = kBlockNumber;
+			blocks.emplace_back();
+			blocks.back().isValid = false;
+			invalidBlockNumbers.push_back(kBlockNumber);
 		}
-		else
+		if (kBlockNumber >= firstBlockNumber)
 		{
-			if ((currentBufferType == kBufferTargetScreen) &&
-				(screenBuffer.begin() != screenRowIterator))
+			while (kBlockNumber >= returnPastEndBlockNumber())
 			{
-				--screenRowIterator;
+				blocks.emplace_back();
+				blocks.back().isValid = true;
 			}
-			else if ((currentBufferType == kBufferTargetScrollback) &&
-						(*scrollbackRowIterator != &firstLine()))
+			while ((blocks.size() > 1) && (returnByteCount() > STATIC_CAST(kByteLimit, size_t)))
 			{
-				++scrollbackRowIterator; // scrollback is inverted
+				blocks.pop_front();
+				++firstBlockNumber;
 			}
-			else
+			if (kBlockNumber >= firstBlockNumber)
 			{
-				isEnd = true;
+				result = &blocks[STATIC_CAST(kBlockNumber - firstBlockNumber, size_t)];
 			}
 		}
-		return currentLine();
+		return result;
 	}
 	
-	//! Returns false if the constructor claims to have initialized this
-	//! data in a block of memory that is on the stack.
-	Boolean
-	isHeapAllocated ()
+	//! Returns the number of the block after the newest block.
+	SequenceNumber
+	returnPastEndBlockNumber ()
+	const
 	{
-		return heapAllocated;
+		return (firstBlockNumber + STATIC_CAST(blocks.size(), SequenceNumber));
 	}
 	
-	//! Returns the bottommost main screen line.
-	My_ScreenBufferLine&
-	lastLine ()
-	{
-		return *(screenBuffer.back());
-	}
-
-private:
-	My_ScreenBufferLineList&				screenBuffer;			//!< the other possible source for the current line
-	My_ScrollbackBufferLineList&			scrollbackBuffer;		//!< one possible source for the current line
-	My_ScreenBufferLineList::iterator		screenRowIterator;		//!< the current line when "kBufferTargetScreen"
-	My_ScrollbackBufferLineList::iterator	scrollbackRowIterator;	//!< the current line when "kBufferTargetScrollback"
-	BufferTarget							currentBufferType : 2;	//!< whether or not the screen is being targeted
-	Boolean									heapAllocated : 1;		//!< an annoying extra use of memory for this flag...
+	std::deque< Block >				blocks;					//!< trigram bits for consecutive groups of lines, oldest at the FRONT
+	SequenceNumber					firstBlockNumber;		//!< block number of the front block
+	std::vector< SequenceNumber >	invalidBlockNumbers;	//!< blocks marked by invalidateLine() since the last rebuild
 };
-STATIC_ASSERT(sizeof(Terminal_LineStackStorage) == sizeof(My_LineIterator),
-				assert_My_LineIterator_size_equals_Terminal_LineRefStackStorage);
-
-typedef My_LineIterator*	My_LineIteratorPtr;
 
 /*!
-Represents the state of a terminal emulator, such as any
-parameters collected and any pending operations.
-*/
-struct My_Emulator
+Stores all scrollback lines in a double-ended sequence of
+fixed-size blocks (a std::deque), oldest line first.  Any
+row can be found in constant time, and lines can be added
+or removed at either end in constant time without moving
+the others; in particular, the oldest line can be handed
+back to the main screen for reuse without allocating.
+
+Rows are addressed relative to the NEWEST line (zero is the
+scrollback line nearest the top of the main screen), which
+is the order used by the rest of the terminal API.  Each
+line also has a "sequence number" that does not change as
+newer lines are added; this allows line iterators to keep
+their positions while the terminal scrolls.
+
+Lines that are more than "kExpandedLineLimit" rows old are
+converted into a TerminalLine_CompactLine and their full
+storage is released.  Any non-constant access to a line
+restores it transparently; since restored lines are usually
+only being drawn or copied, they are compacted again once
+enough of them accumulate (this only happens when a line is
+added, so references obtained while reading are not
+disturbed).  Constant access never restores lines, so code
+that may run on other threads (such as searches) should use
+returnCompactLine() to read compacted text.
+
+If enabled, a My_ScrollbackSearchIndex is kept up to date as
+lines are added and removed.  Since non-constant access may
+change a line, it marks the line’s part of the index as out
+of date; updateSearchIndex() rebuilds those parts.
+
+When the terminal width changes, startReflow() prepares to
+rewrap every line to the new width: the rows of each logical
+line (every row of which, except the last, is soft-wrapped)
+are joined and split again.  Since this can take a while for
+a large buffer, continueReflow() does a limited number of
+rows each time it is called, from the newest to the oldest,
+so that the rows nearest the screen are done first.  Lines
+that are added in the meantime already have the new width.
+
+The buffer also counts the lines that show any part of each
+inline image (see returnImageLineCount()) as lines are added,
+rewrapped and discarded, so that the terminal can release the
+images that nothing displays anymore.
+
+IMPORTANT:	Line handles do not copy their contents (see
+			TerminalLine_Handle), so lines are always moved
+			in and out of this buffer, never copied.
+*/
+class My_ScrollbackBuffer
 {
 public:
-	//! Variants allow emulators to be tweaked so that the
-	//! behavior is non-standard in some way.  They can also
-	//! allow memory or runtime optimizations when disabled.
-	typedef UInt8		VariantFlags;
-	enum
-	{
-		kVariantFlagsNone				= 0,
-		kVariantFlag24BitColor			= (1 << 0),		//!< corresponds to kPreferences_TagTerminal24BitColorEnabled
-		kVariantFlagXTerm256Color		= (1 << 1),		//!< corresponds to kPreferences_TagXTerm256ColorsEnabled
-		kVariantFlagXTermAlterWindow	= (1 << 2),		//!< corresponds to kPreferences_TagXTermWindowAlterationEnabled
-		kVariantFlagXTermBCE			= (1 << 3),		//!< corresponds to kPreferences_TagXTermBackgroundColorEraseEnabled
-		kVariantFlagSixelGraphics		= (1 << 4),		//!< corresponds to kPreferences_TagSixelGraphicsEnabled
-		kVariantFlagITermGraphics		= (1 << 5),		//!< corresponds to kPreferences_TagITermGraphicsEnabled
-	};
-	
-	struct Callbacks
+	struct Line
 	{
-	public:
-		Callbacks	();
-		Callbacks	(My_EmulatorEchoDataProcPtr,
-					 My_EmulatorStateDeterminantProcPtr,
-					 My_EmulatorStateTransitionProcPtr,
-					 My_EmulatorResetProcPtr);
-		
-		Boolean
-		exist () const;
+		explicit Line	(TerminalLine_Allocator&	inAllocator)
+		:
+		handle(inAllocator),
+		compactForm()
+		{
+		}
 		
-		My_EmulatorEchoDataProcPtr			dataWriter;				//!< translates data and dumps it to the screen
-		My_EmulatorResetProcPtr				resetHandler;			//!< handles a soft or hard reset; varies based on the emulator
-		My_EmulatorStateDeterminantProcPtr	stateDeterminant;		//!< figures out what the next state should be
-		My_EmulatorStateTransitionProcPtr	transitionHandler;		//!< handles new parser states, driving the terminal; varies based on the emulator
+		My_ScreenBufferLinePtr							handle;			//!< full line; the shared empty line if "compactForm" is defined
+		std::unique_ptr< TerminalLine_CompactLine >		compactForm;	//!< if defined, the line is compacted
 	};
 	
-	typedef std::vector< Callbacks >	VariantChain;
-	typedef std::vector< SInt16 >		ParameterList;
-	
-	My_Emulator		(Emulation_FullType, CFStringRef, CFStringEncoding);
-	
-	~My_Emulator ();
-	
-	void
-	clearEscapeSequenceParameters ();
-	
-	void
-	initializeParserStateStack ();
-	
-	Boolean
-	is8BitReceiver ();
+	typedef std::deque< Line >		LineDeque;
+	typedef LineDeque::iterator		iterator;
+	typedef LineDeque::size_type	size_type;
+	typedef SInt64					SequenceNumber;
+	typedef std::list< SequenceNumber >		SequenceNumberList;
 	
-	Boolean
-	is8BitTransmitter ();
-	
-	UInt32
-	recentCodePoint ();
+	enum
+	{
+		kExpandedLineLimit = 1000,	//!< lines nearer than this to the newest line are never compacted
+		kRestoredLineLimit = 200,	//!< at most this many restored lines stay expanded (least recently used are compacted again)
+		kReflowSliceLineLimit = 1000,	//!< approximate number of rows rewrapped by each call to continueReflow()
+		kSpareLineLimit = 8			//!< maximum number of released line allocations kept for reuse
+	};
 	
-	void
-	reset	(Boolean);
+	explicit My_ScrollbackBuffer	(TerminalLine_Allocator&	inLineAllocator)
+	:
+	lineAllocator(inLineAllocator),
+	lines(),
+	oldestSequenceNumber(0),
+	restoredLineOrder(),
+	restoredLinePositions(),
+	spareLines(),
+	compactLineCount(0),
+	compactByteCount(0),
+	compactionCount(0),
+	restorationCount(0),
+	imageLineCounts(),
+	searchIndex(),
+	indexCharacters(),
+	indexText(),
+	reflowColumnCount(0),
+	reflowPendingLineCount(0),
+	isSearchIndexDeferred(false),
+	reflowCellCounts(),
+	reflowSourceRows(),
+	reflowScratchLines(),
+	reflowNewRows(),
+	reflowNewLines()
+	{
+	}
+	
+	//! Returns the line that is the given number of rows away from
+	//! the newest line (zero is the newest line), restoring it from
+	//! its compact form if necessary.
+	My_ScreenBufferLinePtr&
+	operator [] (size_type	inLineNumberZeroForNewest)
+	{
+		return expandedLine(lines.size() - 1 - inLineNumberZeroForNewest);
+	}
+	
+	//! Returns the line that is the given number of rows away from
+	//! the newest line (zero is the newest line); a compacted line
+	//! appears empty (see returnCompactLine()).
+	My_ScreenBufferLinePtr const&
+	operator [] (size_type	inLineNumberZeroForNewest)
+	const
+	{
+		return lines[lines.size() - 1 - inLineNumberZeroForNewest].handle;
+	}
 	
-	My_BufferChanges
-	returnEraseEffectsForNormalUse ();
+	//! Appends to the given list each image (that is not already
+	//! in the list) with a segment shown by any of the given
+	//! attribute runs; see ImageStore_GetSegment().
+	static void
+	appendLineImages	(TerminalLine_AttributeRunList::const_iterator	inBegin,
+						 TerminalLine_AttributeRunList::const_iterator	inEnd,
+						 std::vector< ImageStore_ImageID >&				inoutImageIDs)
+	{
+		for (auto toRun = inBegin; toRun != inEnd; ++toRun)
+		{
+			if (toRun->attributes.hasBitmap())
+			{
+				ImageStore_ImageID	imageID = kImageStore_InvalidImageID;
+				CGRect				subRect = CGRectZero;
+				
+				
+				if (ImageStore_GetSegment(toRun->attributes.bitmapID(), imageID, subRect) &&
+					(inoutImageIDs.end() == std::find(inoutImageIDs.begin(), inoutImageIDs.end(), imageID)))
+				{
+					inoutImageIDs.push_back(imageID);
+				}
+			}
+		}
+	}
 	
-	My_BufferChanges
-	returnEraseEffectsForSelectiveUse ();
+	//! For iteration over all lines, from oldest to newest.
+	iterator
+	begin ()
+	{
+		return lines.begin();
+	}
 	
+	//! Discards all lines.
 	void
-	sendEscape	(SessionRef, void const*, size_t);
+	clear ()
+	{
+		oldestSequenceNumber += lines.size();
+		lines.clear();
+		restoredLineOrder.clear();
+		restoredLinePositions.clear();
+		compactLineCount = 0;
+		compactByteCount = 0;
+		reflowPendingLineCount = 0;
+		imageLineCounts.clear();
+		if (nullptr != searchIndex)
+		{
+			searchIndex->clear();
+		}
+	}
 	
-	void
-	set8BitReceive		(Boolean);
-	
-	void
-	set8BitTransmit		(Boolean);
+	//! Rewraps the newest logical lines that have not been rewrapped
+	//! since startReflow() was called, up to about kReflowSliceLineLimit
+	//! rows, and returns true only if any rows changed.  The reflow
+	//! ends once every line is done (see isReflowPending()).  Since
+	//! the number of rows may change, the sequence numbers of older
+	//! lines change too; only newer lines keep their numbers.
+	bool
+	continueReflow ()
+	{
+		bool	result = false;
+		
+		
+		if ((0 != reflowColumnCount) && (0 == reflowPendingLineCount))
+		{
+			finishReflow();
+		}
+		else if (0 != reflowColumnCount)
+		{
+			size_type const		kPastEndIndex = reflowPendingLineCount;
+			size_type			firstIndex = kPastEndIndex;
+			std::vector< std::pair< size_type, size_type > >	changedGroups; // newest first
+			
+			
+			// find whole logical lines, newest first; if the newest
+			// was wrapped then it continues onto the main screen
+			while ((firstIndex > 0) && ((kPastEndIndex - firstIndex) < kReflowSliceLineLimit))
+			{
+				size_type const		kGroupPastEndIndex = firstIndex;
+				bool				isChanged = false;
+				
+				
+				--firstIndex;
+				while ((firstIndex > 0) && (0 != returnSoftWrapColumnCount(lines[firstIndex - 1])))
+				{
+					--firstIndex;
+				}
+				
+				// a logical line that already fits is left alone (without
+				// even restoring compacted rows), so that repeated resizes
+				// and unwrapped lines cost very little
+				for (size_type i = firstIndex; ((false == isChanged) && (i < kGroupPastEndIndex)); ++i)
+				{
+					UInt16 const	kCellCount = returnReflowCellCount(lines[i]);
+					
+					
+					isChanged = ((i + 1) < kGroupPastEndIndex)
+								? (kCellCount != reflowColumnCount)
+								: (kCellCount > reflowColumnCount);
+				}
+				if (isChanged)
+				{
+					changedGroups.emplace_back(firstIndex, kGroupPastEndIndex);
+				}
+			}
+			
+			if (false == changedGroups.empty())
+			{
+				size_type	nextIndex = firstIndex;
+				
+				
+				// lines are moved, so compact forms are counted again below
+				for (size_type i = firstIndex; i < kPastEndIndex; ++i)
+				{
+					if (nullptr != lines[i].compactForm)
+					{
+						compactByteCount -= lines[i].compactForm->returnByteCount();
+						--compactLineCount;
+					}
+				}
+				
+				reflowNewLines.clear();
+				for (auto toGroup = changedGroups.rbegin(); toGroup != changedGroups.rend(); ++toGroup)
+				{
+					for (; nextIndex < toGroup->first; ++nextIndex)
+					{
+						reflowNewLines.emplace_back(std::move(lines[nextIndex]));
+					}
+					reflowGroup(toGroup->first, toGroup->second);
+					nextIndex = toGroup->second;
+				}
+				for (; nextIndex < kPastEndIndex; ++nextIndex)
+				{
+					reflowNewLines.emplace_back(std::move(lines[nextIndex]));
+				}
+				
+				// replace the original rows; newer lines keep their sequence numbers
+				lines.erase(lines.begin() + firstIndex, lines.begin() + kPastEndIndex);
+				lines.insert(lines.begin() + firstIndex,
+								std::make_move_iterator(reflowNewLines.begin()), std::make_move_iterator(reflowNewLines.end()));
+				{
+					SequenceNumber const	kFirstNumber = oldestSequenceNumber + STATIC_CAST(firstIndex, SequenceNumber);
+					SequenceNumber const	kPastEndNumber = oldestSequenceNumber + STATIC_CAST(kPastEndIndex, SequenceNumber);
+					SequenceNumber const	kRowDelta = (STATIC_CAST(reflowNewLines.size(), SequenceNumber) -
+															STATIC_CAST(kPastEndIndex - firstIndex, SequenceNumber));
+					
+					
+					// restored lines in the range are gone (any that only moved
+					// are compacted again below, if old enough); older restored
+					// lines keep their places (and their order of use), so they
+					// are renumbered along with every other older line
+					restoredLinePositions.clear();
+					for (auto toNumber = restoredLineOrder.begin(); toNumber != restoredLineOrder.end(); )
+					{
+						if ((*toNumber >= kFirstNumber) && (*toNumber < kPastEndNumber))
+						{
+							toNumber = restoredLineOrder.erase(toNumber);
+						}
+						else
+						{
+							if (*toNumber < kFirstNumber)
+							{
+								*toNumber -= kRowDelta;
+							}
+							restoredLinePositions[*toNumber] = toNumber;
+							++toNumber;
+						}
+					}
+					oldestSequenceNumber -= kRowDelta;
+				}
+				for (size_type i = firstIndex; i < (firstIndex + reflowNewLines.size()); ++i)
+				{
+					if (nullptr != lines[i].compactForm)
+					{
+						compactByteCount += lines[i].compactForm->returnByteCount();
+						++compactLineCount;
+					}
+					else if ((lines.size() - 1 - i) >= kExpandedLineLimit)
+					{
+						compactLine(i);
+					}
+				}
+				reflowNewLines.clear();
+				result = true;
+			}
+			reflowPendingLineCount = firstIndex;
+		}
+		return result;
+	}
 	
-	void
-	set8BitTransmitNever	();
+	//! Returns true only if there are no lines.
+	bool
+	empty ()
+	const
+	{
+		return lines.empty();
+	}
 	
-	Boolean
-	supportsVariant		(VariantFlags);
+	//! For iteration over all lines, from oldest to newest.
+	iterator
+	end ()
+	{
+		return lines.end();
+	}
 	
-	Emulation_FullType					primaryType;			//!< VT100, VT220, etc.
-	Boolean								isUTF8Encoding;			//!< the emulator is using the UTF-8 encoding, and should ignore any specific sequences
-																//!  that would change character sets in other ways (such as those defined for a VT220); in
-																//!  addition, the data stream is decoded as UTF-8 BEFORE it is searched for any control
-																//!  sequences, instead of being decoded in the echo-data phase; WARNING: do not assign this
-																//!  flag casually, it is usually only correct to use Session APIs to change the text encoding
-	Boolean								lockUTF8;				//!< set if UTF-8 should be set permanently, ignoring any sequences to switch it back until
-																//!  a full reset occurs
-	Boolean								disableShifts;			//!< prevents shift-in, shift-out, and any related old-style character set mechanism from working;
-																//!  usually this should be set only when a Unicode encoding is present (which is large enough to
-																//!  support all characters, making alternate sets unnecessary), but it is a separate state anyway
-	CFStringEncoding					inputTextEncoding;		//!< specifies the encoding used by the input data stream
-	CFRetainRelease						answerBackCFString;		//!< similar to "primaryType", but can be an arbitrary string
-	UInt64								stateRepetitions;		//!< to guard against looping; counts repetitions of same state
-	My_ParserState						currentState;			//!< state the terminal input parser is in now
-	My_ParserState						stringAccumulatorState;	//!< state that was in effect when the "stringAccumulator" was recently cleared
-	std::basic_string< UInt8 >			stringAccumulator;		//!< used to gather characters for such things as XTerm window changes
-	UTF8Decoder_StateMachine			multiByteDecoder;		//!< as individual bytes are processed, this tracks complete or invalid sequences
-	UInt8								recentCodePointByte;	//!< for 8-bit encodings, the most recent byte read; see also "multiByteDecoder"
-	Boolean								addedITerm;				//!< keep track of previous requests to install the same variant
-	Boolean								addedSixel;				//!< keep track of previous requests to install the same variant
-	Boolean								addedXTerm;				//!< since multiple variants reuse these callbacks, only insert them once
-	Boolean								allowSixelScrolling;	//!< whether or not the screen scrolls when a Sixel cursor goes past the bottom
-	SInt16								argLastIndex;			//!< zero-based last parameter position in the "values" array
-	ParameterList						argList;				//!< all values provided for the current escape sequence
-	ParameterList						parameterMarkList;		//!< this list has the same size as "argList"; in parallel with "argList", it sets only two values:
-																//!  -1 to indicate that a parameter is finished (the typical case) or 0 to indicate that it is just
-																//!  a colon-separated sub-parameter; in cases like SGR, this is used to track related values
-	VariantChain						preCallbackSet;			//!< state determinant/transition callbacks invoked ahead of normal callbacks, to allow tweaks;
-																//!  a pre-callback set’s echo and reset callbacks are never used and should be nullptr; in
-																//!  addition, “normal” emulator callbacks CANNOT be used as pre-callbacks because they will
-																//!  absorb too many actions, so every pre-callback must be ITS OWN CLASS and be lightweight
-	Callbacks							currentCallbacks;		//!< emulator-type-specific handlers to drive the state machine
-	Callbacks							pushedCallbacks;		//!< for emulators that can switch modes, the previous set of callbacks
-	VariantFlags						supportedVariants;		//!< tags identifying minor features, e.g. 256-color support
-	My_TrueColorIDByComponentKey		trueColorIDsByRGB;		//!< maps RGB elements to their table index value (ID), if any
-	My_RGBComponentList*				trueColorTableReds;		//!< red components for all 24-bit colors; allocated only for supporting terminals
-	My_RGBComponentList*				trueColorTableGreens;	//!< green components for all 24-bit colors; allocated only for supporting terminals
-	My_RGBComponentList*				trueColorTableBlues;	//!< blue components for all 24-bit colors; allocated only for supporting terminals
-	TextAttributes_TrueColorID			trueColorTableNextID;	//!< basis for new IDs; current entry for storing new colors in true-color table
-	TextAttributes_BitmapID				bitmapTableNextID;		//!< basis for new IDs; current entry for storing new bitmaps in bitmap table
-	NSMutableArray* __strong			bitmapImageTable;		//!< NSArray of NSImage*; shared (“whole image”) bitmap representations by index (ID)
-	NSMutableArray* __strong			bitmapSegmentTable;		//!< NSArray of NSValue* (holding NSRect); single-cell bitmap sub-rectangles by index (ID)
-
-protected:
-	My_EmulatorEchoDataProcPtr
-	returnDataWriter	(Emulation_FullType);
+	//! Returns true only if startReflow() has been called and
+	//! continueReflow() has not yet finished.
+	bool
+	isReflowPending ()
+	const
+	{
+		return (0 != reflowColumnCount);
+	}
 	
-	My_EmulatorResetProcPtr
-	returnResetHandler		(Emulation_FullType);
+	//! Returns true only if the line with the given sequence number
+	//! is counted as restored from its compact form (so that it is
+	//! compacted again once it is among the least recently used;
+	//! see kRestoredLineLimit).
+	bool
+	isRestoredLine	(SequenceNumber		inSequenceNumber)
+	const
+	{
+		return (restoredLinePositions.end() != restoredLinePositions.find(inSequenceNumber));
+	}
 	
-	My_EmulatorStateDeterminantProcPtr
-	returnStateDeterminant		(Emulation_FullType);
+	//! Returns true only if the given sequence number still
+	//! refers to a line in the buffer.
+	bool
+	isValidSequenceNumber	(SequenceNumber		inSequenceNumber)
+	const
+	{
+		return ((inSequenceNumber >= oldestSequenceNumber) &&
+				(inSequenceNumber < (oldestSequenceNumber + STATIC_CAST(lines.size(), SequenceNumber))));
+	}
 	
-	My_EmulatorStateTransitionProcPtr
-	returnStateTransitionHandler	(Emulation_FullType);
-
-private:
-	Boolean								eightBitReceiver;		//!< if true, equivalent 8-bit codes should be recognized by the emulator’s state determinant
-																//!  (for example, in a VT100, the 7-bit ESC-[ sequence is equivalent to the 8-bit code 155)
-	Boolean								eightBitTransmitter;	//!< if true, any sequences returned to the listening session should use 8-bit codes only
-	Boolean								lockSevenBitTransmit;	//!< if true, the emulator can never be set to 8-bit; useful in weird emulation corner cases
-};
-typedef My_Emulator*	My_EmulatorPtr;
-
-typedef MemoryBlockReferenceTracker< TerminalScreenRef >	My_RefTracker;
-typedef Registrar< TerminalScreenRef, My_RefTracker >		My_RefRegistrar;
-
-struct My_ScreenBuffer
-{
-public:
-	My_ScreenBuffer	(Preferences_ContextRef, Preferences_ContextRef);
-	~My_ScreenBuffer ();
+	//! Returns the line with the given sequence number, which must
+	//! be valid (see isValidSequenceNumber()), restoring it from its
+	//! compact form if necessary.
+	My_ScreenBufferLinePtr&
+	lineWithSequenceNumber	(SequenceNumber		inSequenceNumber)
+	{
+		return expandedLine(STATIC_CAST(inSequenceNumber - oldestSequenceNumber, size_type));
+	}
 	
-	static void
-	preferenceChanged	(ListenerModel_Ref, ListenerModel_Event, void*, void*);
+	//! Returns the oldest line; the buffer must not be empty.
+	My_ScreenBufferLinePtr&
+	oldest ()
+	{
+		return expandedLine(0);
+	}
 	
+	//! Removes the oldest line, transferring it to the given handle
+	//! (whose previous line is destroyed); the buffer must not be empty.
+	//! If the line was compacted, its contents are NOT restored, since
+	//! the line is being discarded; a released allocation is reused
+	//! instead when possible.
 	void
-	printingEnd		(Boolean = true);
+	popOldest	(My_ScreenBufferLinePtr&	outLine)
+	{
+		countLineImages(lines.front(), false/* is added */);
+		if ((nullptr != lines.front().compactForm) && (false == spareLines.empty()))
+		{
+			lines.front().handle.swap(spareLines.back());
+			spareLines.pop_back();
+		}
+		outLine.swap(lines.front().handle);
+		discardOldest();
+	}
 	
+	//! Adds the given line as the newest line; the given handle
+	//! is left referring to the shared empty line.  This may cause
+	//! older lines to be compacted.
 	void
-	printingReset ();
+	pushNewest	(My_ScreenBufferLinePtr&	inoutLine)
+	{
+		lines.emplace_back(lineAllocator);
+		lines.back().handle.swap(inoutLine);
+		countLineImages(lines.back(), true/* is added */);
+		if (nullptr != searchIndex)
+		{
+			indexLine(lines.size() - 1);
+		}
+		if (lines.size() > kExpandedLineLimit)
+		{
+			// the line that has just become old enough is compacted
+			compactLine(lines.size() - 1 - kExpandedLineLimit);
+		}
+	}
 	
-	Boolean
-	return24BitColor	(Preferences_ContextRef);
+	//! Rewraps one logical line to the given number of columns,
+	//! appending the new rows to the given list.  The logical line
+	//! is given as its rows and the number of cells of each row
+	//! that belong to it (normally the soft-wrap column, except on
+	//! the last row).  Every new row except the last is soft-wrapped
+	//! at the new width (or one column earlier if a double-width
+	//! character had to move to the next row, see
+	//! returnReflowTargetCell()); the last one is also marked if the
+	//! text continues past the given rows.  If the line has fewer
+	//! than the given minimum number of cells, blank cells are added
+	//! (so that a cursor position is not lost, for instance).  The
+	//! new rows are created by the given allocator.
+	static void
+	reflowRows	(std::vector< TerminalLine_Object const* > const&	inRows,
+				 std::vector< UInt16 > const&						inCellCounts,
+				 UInt16												inColumnCount,
+				 bool												inContinuesPastEnd,
+				 UInt32												inMinimumCellCount,
+				 TerminalLine_Allocator&							inAllocator,
+				 std::vector< My_ScreenBufferLinePtr >&				outRows)
+	{
+		TextAttributes_Object const		kGlobalAttributes = inRows.front()->returnGlobalAttributes();
+		size_t const					kFirstRowIndex = outRows.size();
+		UInt32							sourceCellCount = 0;
+		UInt32							totalCellCount = 0;
+		UInt32							targetCell = 0;
+		size_t							newRowCount = 0;
+		
+		
+		for (UInt16 const kCellCount : inCellCounts)
+		{
+			sourceCellCount += kCellCount;
+		}
+		totalCellCount = returnReflowTargetCell(inRows, inCellCounts, inColumnCount, std::max(sourceCellCount, inMinimumCellCount));
+		newRowCount = std::max< size_t >(1, (totalCellCount + inColumnCount - 1) / inColumnCount);
+		outRows.resize(kFirstRowIndex + newRowCount, My_ScreenBufferLinePtr(inAllocator));
+		for (size_t i = 0; i < newRowCount; ++i)
+		{
+			TerminalLine_Object&	targetLine = *(outRows[kFirstRowIndex + i]); // allocates a blank line
+			
+			
+			if (TextAttributes_Object() != kGlobalAttributes)
+			{
+				targetLine.returnMutableGlobalAttributes() = kGlobalAttributes;
+			}
+			if ((i + 1) < newRowCount)
+			{
+				targetLine.softWrapColumnCount = inColumnCount;
+			}
+			else if (inContinuesPastEnd)
+			{
+				targetLine.softWrapColumnCount = STATIC_CAST(totalCellCount - (i * inColumnCount), UInt16);
+			}
+		}
+		
+		// copy cells in pieces that do not cross the end of any row
+		for (size_t rowIndex = 0; rowIndex < inRows.size(); ++rowIndex)
+		{
+			TerminalLine_Object const&				kSourceLine = *(inRows[rowIndex]);
+			TerminalLine_AttributeRunList const&	kSourceRuns = kSourceLine.returnAttributeRuns();
+			UInt16 const							kSourceCellCount = inCellCounts[rowIndex];
+			UInt16									sourceCell = 0;
+			
+			
+			while (sourceCell < kSourceCellCount)
+			{
+				// a double-width character cannot start in the last column,
+				// so that column is left blank and the row wraps before it
+				if ((inColumnCount > 1) && ((inColumnCount - 1) == (targetCell % inColumnCount)) &&
+					isReflowWideCharacterStart(inRows, inCellCounts, rowIndex, sourceCell))
+				{
+					outRows[kFirstRowIndex + (targetCell / inColumnCount)]->softWrapColumnCount = (inColumnCount - 1);
+					++targetCell;
+				}
+				
+				TerminalLine_Object&	targetLine = *(outRows[kFirstRowIndex + (targetCell / inColumnCount)]);
+				UInt16 const			kTargetCell = STATIC_CAST(targetCell % inColumnCount, UInt16);
+				UInt16					copiedCount = std::min(STATIC_CAST(kSourceCellCount - sourceCell, UInt16),
+																STATIC_CAST(inColumnCount - kTargetCell, UInt16));
+				
+				
+				// a piece that reaches the last column stops before any
+				// double-width character that would start there
+				if ((copiedCount > 1) && ((kTargetCell + copiedCount) == inColumnCount) &&
+					isReflowWideCharacterStart(inRows, inCellCounts, rowIndex, sourceCell + copiedCount - 1))
+				{
+					--copiedCount;
+				}
+				
+				UInt16 const	kPastEndSourceCell = STATIC_CAST(sourceCell + copiedCount, UInt16);
+				
+				
+				std::copy(kSourceLine.textVectorBegin + sourceCell, kSourceLine.textVectorBegin + kPastEndSourceCell,
+							targetLine.textVectorBegin + kTargetCell);
+				for (auto toRun = kSourceRuns.begin(); toRun != kSourceRuns.end(); ++toRun)
+				{
+					UInt16 const	kFirstRunCell = std::max(toRun->firstCell, sourceCell);
+					UInt16 const	kPastEndRunCell = std::min(kSourceRuns.returnPastEndCell(toRun), kPastEndSourceCell);
+					
+					
+					if ((kFirstRunCell < kPastEndRunCell) && (false == targetLine.sharesUniformAttributes(toRun->attributes)))
+					{
+						targetLine.returnMutableAttributeRuns().assign(kTargetCell + (kFirstRunCell - sourceCell),
+																		kTargetCell + (kPastEndRunCell - sourceCell),
+																		toRun->attributes);
+					}
+				}
+				sourceCell = kPastEndSourceCell;
+				targetCell += copiedCount;
+			}
+		}
+	}
 	
-	CFStringRef
-	returnAnswerBackMessage		(Preferences_ContextRef);
+	//! Discards the oldest lines until no more than the given
+	//! number of lines remain, or adds blank lines before the
+	//! oldest line until there are exactly that many.
+	void
+	resize	(size_type	inLineCount)
+	{
+		while (lines.size() > inLineCount)
+		{
+			countLineImages(lines.front(), false/* is added */);
+			discardOldest();
+		}
+		while (lines.size() < inLineCount)
+		{
+			lines.emplace_front(lineAllocator);
+			--oldestSequenceNumber;
+			if (0 != reflowColumnCount)
+			{
+				// blank lines need no reflow but they are older
+				++reflowPendingLineCount;
+			}
+		}
+	}
 	
-	Emulation_FullType
-	returnEmulator		(Preferences_ContextRef);
+	//! Returns the approximate number of bytes used by compacted lines.
+	size_t
+	returnCompactByteCount ()
+	const
+	{
+		return compactByteCount;
+	}
 	
-	Boolean
-	returnForceSave		(Preferences_ContextRef);
+	//! Returns the compact form of the line that is the given number
+	//! of rows away from the newest line, or nullptr if the line is
+	//! not compacted.  This never changes the buffer.
+	TerminalLine_CompactLine const*
+	returnCompactLine	(size_type	inLineNumberZeroForNewest)
+	const
+	{
+		return lines[lines.size() - 1 - inLineNumberZeroForNewest].compactForm.get();
+	}
 	
-	Boolean
-	returnITermGraphics		(Preferences_ContextRef);
+	//! Returns the number of lines that are currently compacted.
+	size_type
+	returnCompactLineCount ()
+	const
+	{
+		return compactLineCount;
+	}
 	
-	Session_LineEnding
-	returnLineEndings ();
+	//! Returns the number of times that any line has been compacted.
+	UInt64
+	returnCompactionCount ()
+	const
+	{
+		return compactionCount;
+	}
 	
-	UInt16
-	returnScreenColumns		(Preferences_ContextRef, Boolean = true);
-	
-	UInt16
-	returnScreenRows		(Preferences_ContextRef, Boolean = true);
+	//! Returns the approximate number of bytes used by lines that are
+	//! not compacted (blank lines use no storage); this is not cached,
+	//! so it takes time proportional to the number of lines.
+	size_t
+	returnExpandedByteCount ()
+	const
+	{
+		size_t		result = 0;
+		
+		
+		for (Line const& kLine : lines)
+		{
+			if (false == kLine.handle.isDefault())
+			{
+				result += (*kLine.handle).returnByteCount();
+			}
+		}
+		return result;
+	}
 	
+	//! Returns the number of lines that show any part of the given
+	//! image (see appendLineImages()).  This assumes that lines do
+	//! not gain or lose images while they are in the buffer, except
+	//! by being rewrapped.
 	UInt32
-	returnScrollbackRows	(Preferences_ContextRef, Boolean = true);
-	
-	Boolean
-	returnSixelGraphics		(Preferences_ContextRef);
-	
-	CFStringEncoding
-	returnTextEncoding		(Preferences_ContextRef);
-	
-	Boolean
-	returnXTerm256	(Preferences_ContextRef);
-	
-	Boolean
-	returnXTermBackgroundColorErase		(Preferences_ContextRef);
-	
-	UInt16
-	returnXTermPatchLevel	(Preferences_ContextRef, Boolean = true);
-	
-	Boolean
-	returnXTermWindowAlteration		(Preferences_ContextRef);
-	
-	My_RefRegistrar						refValidator;				//!< ensures this reference is recognized as a valid one
-	Preferences_ContextWrap				configuration;
-	My_Emulator							emulator;					//!< handles all parsing of the data stream
-	SessionRef							listeningSession;			//!< may be nullptr; the currently attached session, where certain terminal reports are sent
-	
-	TerminalSpeaker_Ref					speaker;					//!< object that emits sound based on this terminal data;
-																	//!  TEMPORARY: the speaker REALLY shouldn’t be part of the terminal data model!
-	CFRetainRelease						windowTitleCFString;		//!< stores the string that the terminal considers its window title
-	CFRetainRelease						iconTitleCFString;			//!< stores the string that the terminal considers its icon title
-	
-	ListenerModel_Ref					changeListenerModel;		//!< registry of listeners for various terminal events
-	ListenerModel_ListenerWrap			preferenceMonitor;			//!< listener for changes to preferences that affect a particular screen
-	
-	My_ScrollbackBufferLineList::size_type	scrollbackBufferCachedSize;	//!< linked list size is sometimes needed, but is VERY expensive to calculate;
-																	//!  therefore, it is cached, and ALL code that changes "scrollbackBuffer" must
-																	//!  be aware of this cached size and update it accordingly!
-	My_ScrollbackBufferLineList			scrollbackBuffer;			//!< all of the scrollback text for the terminal; "scrollbackBufferCachedSize"
-																	//!  is a redundant copy of the (expensively-computed) full size of the buffer;
-																	//!  IMPORTANT: the FRONT is the scrollback line CLOSEST to the top (FRONT) of
-																	//!  the screen buffer; imagine both buffers starting at the home line and
-																	//!  growing away from one another
-	My_ScreenBufferLineList				screenBuffer;				//!< all of the visible text for the terminal;
-																	//!  IMPORTANT: ONLY modify the screen buffer using screen...() routines!
-	My_ByteString						bytesToEcho;				//!< captures contiguous blocks of text to be translated and echoed
-	My_VoidPtrList						debugStateHandlerSequence;	//!< used only when logging is enabled; cleared at each state transition, tracks
-																	//!  handlers that are invoked during the processing of the transition
+	returnImageLineCount	(ImageStore_ImageID		inImageID)
+	const
+	{
+		auto const	kToPair = imageLineCounts.find(inImageID);
+		
+		
+		return ((imageLineCounts.end() != kToPair) ? kToPair->second : 0);
+	}
 	
-	// Error Counts
-	//
-	// Certain classes of error are exceptional, but when they occur
-	// they may occur very often (e.g. extremely bad input data that
-	// continues to cause errors until it is cleared out).
-	//
-	// To avoid the spam and resulting slowdown of logging these
-	// cases, error counts are used: incremented as errors occur,
-	// and decremented when a periodic handler discovers new errors
-	// (except for the total, which is never reset).
-	UInt32								echoErrorCount;				//!< echo errors occur when a stream of exceptionally bad data arrives (e.g.
-																	//!  someone dumps binary data)
-	UInt32								translationErrorCount;		//!< translation errors typically occur when the text encoding assumed either
-																	//!  by the user or the running process is not actually used by some data; if
-																	//!  enough of these are accumulated, the user could actually be prompted to
-																	//!  reconsider the chosen translation table for the session
-	UInt32								errorCountTotal;			//!< used to eventually fire "kTerminal_ChangeExcessiveErrors", if things have
-																	//!  become just ridiculous
+	//! Finds the characters of the given line (either the full line
+	//! or, if it is not nullptr, the compact form) and returns their
+	//! count; the text pointer is set to either the line storage or
+	//! the given buffer (if the characters had to be copied or
+	//! decoded).  Blank lines have no characters at all.  This never
+	//! changes the line, so it is safe for any thread that is allowed
+	//! to read it.
+	static CFIndex
+	returnLineText	(My_ScreenBufferLinePtr const&		inLine,
+					 TerminalLine_CompactLine const*	inCompactLineOrNull,
+					 std::vector< UniChar >&			inoutBuffer,
+					 UniChar const*&					outText)
+	{
+		CFIndex		result = 0;
+		
+		
+		outText = nullptr;
+		if (nullptr != inCompactLineOrNull)
+		{
+			inoutBuffer.resize(kTerminalLine_MaximumCharacterCount);
+			result = inCompactLineOrNull->copyCharacters(inoutBuffer.data());
+			outText = inoutBuffer.data();
+		}
+		else if (false == inLine.isDefault())
+		{
+			CFStringRef const	kLineCFString = inLine->returnCFStringRef();
+			
+			
+			// the string is normally just a wrapper for the line storage
+			result = CFStringGetLength(kLineCFString);
+			outText = CFStringGetCharactersPtr(kLineCFString);
+			if (nullptr == outText)
+			{
+				inoutBuffer.resize(STATIC_CAST(result, size_t));
+				CFStringGetCharacters(kLineCFString, CFRangeMake(0, result), inoutBuffer.data());
+				outText = inoutBuffer.data();
+			}
+		}
+		return result;
+	}
 	
-	My_TabStopList						tabSettings;				//!< array of characters representing tab stops; values are either kMy_TabClear
-																	//!  (for most columns), or kMy_TabSet at tab columns
+	//! Returns the cell of the rows created by reflowRows() (counted
+	//! from the start of the first new row) that the given cell of
+	//! the logical line (counted from the start of its first row)
+	//! moves to.  This is the same cell unless double-width characters
+	//! before it (or the cell itself) had to move to the next row,
+	//! leaving the last column blank.  Cells past the end of the text
+	//! are blank, so they simply follow the last cell of the text.
+	static UInt32
+	returnReflowTargetCell	(std::vector< TerminalLine_Object const* > const&	inRows,
+							 std::vector< UInt16 > const&						inCellCounts,
+							 UInt16												inColumnCount,
+							 UInt32												inSourceCell)
+	{
+		UInt32		result = 0;
+		UInt32		sourceCell = 0;
+		bool		isFound = false;
+		
+		
+		for (size_t rowIndex = 0; ((false == isFound) && (rowIndex < inRows.size())); ++rowIndex)
+		{
+			for (UInt16 i = 0; ((false == isFound) && (i < inCellCounts[rowIndex])); ++i)
+			{
+				if ((inColumnCount > 1) && ((inColumnCount - 1) == (result % inColumnCount)) &&
+					isReflowWideCharacterStart(inRows, inCellCounts, rowIndex, i))
+				{
+					++result;
+				}
+				isFound = (sourceCell == inSourceCell);
+				unless (isFound)
+				{
+					++result;
+					++sourceCell;
+				}
+			}
+		}
+		unless (isFound)
+		{
+			result += (inSourceCell - sourceCell);
+		}
+		return result;
+	}
 	
-	StreamCapture_Ref					captureStream;				//!< used to stream data to a file chosen by the user
-	StreamCapture_Ref					printingStream;				//!< used to stream data to a temporary file for later printing
-	CFRetainRelease						printingFileURL;			//!< URL of the temporary printing file
-	UInt8								printingModes;				//!< MC private (VT102): true only if terminal-rendered lines are also sent to the printer
-	Boolean								bellDisabled;				//!< if true, all bell signals are completely ignored (no audio or visual)
-	Terminal_CursorType					cursorType;					//!< cursor shape (from viewpoint of program running in terminal)
-	Boolean								cursorBlinking;				//!< if true, cursor is set to blink (from viewpoint of program running in terminal)
-	Boolean								cursorVisible;				//!< if true, cursor state is visible (as opposed to invisible); see also DECTCEM
-	Boolean								reverseVideo;				//!< if true, foreground and background colors are swapped when rendering
-	Boolean								windowMinimized;			//!< if true, the window has been *flagged* as being iconified; since this is only
-																	//!  a data model, this only means that a terminal sequence has told the window to
-																	//!  become iconified; synchronizing this flag with the actual window state is the
-																	//!  responsibility of the Terminal Window module
+	//! Returns the number of times that any line has been restored
+	//! from its compact form.
+	UInt64
+	returnRestorationCount ()
+	const
+	{
+		return restorationCount;
+	}
 	
-	My_CharacterSetInfo					vtG0;						//!< the G0 character set
-	My_CharacterSetInfo					vtG1;						//!< the G1 character set
-	My_CharacterSetInfo					vtG2;						//!< the G2 character set
-	My_CharacterSetInfo					vtG3;						//!< the G3 character set
+	//! Returns the search index, or nullptr if it is not enabled
+	//! (see setSearchIndexEnabled()).  The index may have parts that
+	//! are out of date; see updateSearchIndex().
+	My_ScrollbackSearchIndex const*
+	returnSearchIndex ()
+	const
+	{
+		return searchIndex.get();
+	}
 	
-	My_RowColumnBoundary				visibleBoundary;			//!< rows and columns forming the perimeter of the buffer’s “visible” region
-	My_RowBoundary						customScrollingRegion;		//!< region that is in effect when margin set sequence is received; updated only
-																	//!  when a terminal sequence to change margins is received
+	//! Returns the sequence number of the line that is the given
+	//! number of rows away from the newest line.
+	SequenceNumber
+	returnSequenceNumber	(size_type	inLineNumberZeroForNewest)
+	const
+	{
+		return (oldestSequenceNumber + STATIC_CAST(lines.size(), SequenceNumber) - 1 -
+				STATIC_CAST(inLineNumberZeroForNewest, SequenceNumber));
+	}
 	
-	struct
+	//! Creates a search index for all lines (taking time in proportion
+	//! to the number of lines), or destroys the index.
+	void
+	setSearchIndexEnabled	(bool	inIsEnabled)
 	{
-		struct
+		if (false == inIsEnabled)
 		{
-			My_ScreenRowIndex	numberOfRowsPermitted;  //!< maximum lines of scrollback specified by the user
-														//!  (NOTE: this is inflexible; cooler scrollback handling schemes are limited by it...)
-			Boolean				enabled;				//!< true if scrolled lines should be appended to the buffer automatically
-		} scrollback;
-		
-		struct
+			searchIndex.reset();
+			isSearchIndexDeferred = false;
+		}
+		else if (0 != reflowColumnCount)
 		{
-			UInt16				numberOfColumnsAllocated;	//!< how many characters per line are currently taking up memory; it follows
-															//!  that this is the maximum possible value for "numberOfColumnsPermitted"
-			UInt16				numberOfColumnsPermitted;	//!< maximum columns per line specified by the user; but see current.returnNumberOfColumnsPermitted()
-		} visibleScreen;
-	} text;
-	
-	My_LEDBits							litLEDs;					//!< highlighted states of terminal LEDs (lights)
-	
-	Boolean								passwordMode;				//!< when last checked, terminal device of process was not echoing (password prompt)
-	Boolean								mayNeedToSaveToScrollback;	//!< if true, the cursor has moved to the home position, and therefore
-																	//!  a subsequent attempt to erase to the end of the line or screen
-																	//!  should cause the data to be copied to the scrollback first (that is,
-																	//!  of course, if the force-save flag is also set)
-	Boolean								saveToScrollbackOnClear;	//!< if true, the entire screen contents are saved to the scrollback
-																	//!  buffer just before being explicitly erased with a clear command
-	
-	Boolean								reportOnlyOnRequest;		//!< DECREQTPARM mode: determines response format and timing
-	Boolean								wrapPending;				//!< set only when a character is echoed in final column
+			// rows are renumbered until the reflow ends (see finishReflow())
+			isSearchIndexDeferred = true;
+		}
+		else if (nullptr == searchIndex)
+		{
+			try
+			{
+				searchIndex.reset(new My_ScrollbackSearchIndex);
+			}
+			catch (std::bad_alloc const&)
+			{
+				// search without an index
+				return;
+			}
+			for (size_type i = 0; i < lines.size(); ++i)
+			{
+				indexLine(i);
+			}
+		}
+	}
 	
-	Boolean								modeANSIEnabled;			//!< DECANM mode: true only if in ANSI mode (as opposed to VT52 compatibility
-																	//!  mode); if the former, parameters are only recognized following the CSI
-																	//!  sequence, but if the latter, ESC-character sequences are allowed instead
-	Boolean								modeApplicationKeys;		//!< DECKPAM mode: true only if the keypad is in application mode
-	Boolean								modeAutoWrap;				//!< DECAWM mode: true only if line wrapping is automatic
-	Boolean								modeBracketedPaste;			//!< true only if “bracketed Paste” was enabled (DEC private code 2004)
-	Boolean								modeCursorKeysForApp;		//!< DECCKM mode: true only if the keypad should not act as cursor movement arrows
-																	//!  (note also that the VT100 manual states this setting has no effect unless
-																	//!  the terminal is also in ANSI mode and the keypad is in application mode
-	Boolean								modeInsertNotReplace;		//!< IRM mode: if true, new characters overwrite the cursor position, otherwise
-																	//!  they first shift existing text over by one before appearing
-	Boolean								modeNewLineOption;			//!< LNM mode: if true, a line feed causes the cursor to move to the start of
-																	//!  the next line, and a Return generates a CR LF sequence; if false, the
-																	//!  line feed is just vertical movement of the cursor, and Return is just CR
-	Boolean								modeOriginRedefined;		//!< DECOM mode: true only if the origin has been moved from its default place
-																	//!  (in which case, various subsequent terminal operations must be relative to
-																	//!  the origin instead of the home position)
-	UInt16								reportedPatchLevel;			//!< for XTerm; how to respond to Secondary Device Attributes
-	My_RowBoundary*						originRegionPtr;			//!< automatically set to the boundaries appropriate for the current origin mode;
-																	//!  this should always be preferred when restricting the cursor, and as an offset
-																	//!  when returning column or row numbers
+	//! Returns the number of lines, in constant time.
+	size_type
+	size ()
+	const
+	{
+		return lines.size();
+	}
 	
-    struct
+	//! Prepares to rewrap every current line to the given number
+	//! of columns; see continueReflow().  Any reflow in progress
+	//! starts over (lines that already fit are skipped quickly).
+	//! The search index is removed until the reflow ends, because
+	//! rows are renumbered; searches still work without it.
+	void
+	startReflow		(UInt16		inColumnCount)
 	{
-		Terminal_SpeechMode		mode;	//!< restrictions on when the computer may speak
-	} speech;
+		reflowColumnCount = inColumnCount;
+		reflowPendingLineCount = lines.size();
+		if (nullptr != searchIndex)
+		{
+			searchIndex.reset();
+			isSearchIndexDeferred = true;
+		}
+	}
 	
-	struct CurrentLineCache
+	//! Rebuilds any parts of the search index that may be out of
+	//! date because lines were accessed in a non-constant way; this
+	//! should be called before the index is used.
+	void
+	updateSearchIndex ()
 	{
-		CurrentLineCache	(struct My_ScreenBuffer const&		inParent)
-		:
-		parent(inParent),
-		cursorAttributes(),
-		drawingAttributes(),
-		cursorX(0),
-		cursorY(0),
-		characterSetInfoPtr(nullptr)
+		if (nullptr != searchIndex)
 		{
+			std::vector< SequenceNumber >	firstSequenceNumbers;
+			
+			
+			searchIndex->takeInvalidBlocks(firstSequenceNumbers);
+			for (SequenceNumber const kFirstSequenceNumber : firstSequenceNumbers)
+			{
+				for (SequenceNumber sequenceNumber = kFirstSequenceNumber;
+						sequenceNumber < (kFirstSequenceNumber + My_ScrollbackSearchIndex::kLinesPerBlock); ++sequenceNumber)
+				{
+					if (isValidSequenceNumber(sequenceNumber))
+					{
+						indexLine(STATIC_CAST(sequenceNumber - oldestSequenceNumber, size_type));
+					}
+				}
+			}
 		}
+	}
+
+private:
+	//! Replaces the full storage of the line at the given index
+	//! (from the oldest line) with a compact copy; blank lines
+	//! and lines that are already compact are not changed.
+	void
+	compactLine		(size_type	inIndexZeroForOldest)
+	{
+		Line&	targetLine = lines[inIndexZeroForOldest];
 		
-		UInt16
-		returnNumberOfColumnsPermitted ()
-		const
+		
+		if ((nullptr == targetLine.compactForm) && (false == targetLine.handle.isDefault()))
 		{
-			UInt16		result = parent.text.visibleScreen.numberOfColumnsPermitted;
+			My_ScreenBufferLinePtr		releasedLine(lineAllocator);
 			
 			
-			if (this->cursorAttributes.hasDoubleAny())
+			try
 			{
-				result = STATIC_CAST(INTEGER_DIV_2(result), UInt16);
+				targetLine.compactForm.reset(new TerminalLine_CompactLine(*targetLine.handle));
+			}
+			catch (std::bad_alloc const&)
+			{
+				// keep the full line
+				return;
+			}
+			compactByteCount += targetLine.compactForm->returnByteCount();
+			++compactLineCount;
+			++compactionCount;
+			
+			// release the full storage, keeping a few for reuse
+			releasedLine.swap(targetLine.handle);
+			if (spareLines.size() < kSpareLineLimit)
+			{
+				spareLines.emplace_back(lineAllocator);
+				spareLines.back().swap(releasedLine);
 			}
-			return result;
 		}
-		
-		struct My_ScreenBuffer const&	parent;
-		TextAttributes_Object			cursorAttributes;		//!< text attributes for the position under the cursor; useful for rendering the cursor
-																//!  in a way that does not clash with these attributes (e.g. by choosing opposite colors)
-		TextAttributes_Object			drawingAttributes;		//!< text attributes for the line the cursor is on; these should be updated as the cursor
-																//!  moves, or as terminal sequences are processed by the emulator
-		TextAttributes_Object			latentAttributes;		//!< used to implement Background Color Erase; records the most recent attribute settings
-																//!  (currently for background color bits ONLY, this is NOT properly updated for other
-																//!  attribute changes)
-		SInt16							cursorX;				//!< column number of current cursor position;
-																//!  WARNING: do not change this value except with a moveCursor...() routine
-		My_ScreenRowIndex				cursorY;				//!< row number of current cursor position;
-																//!  WARNING: do not change this value except with a moveCursor...() routine
-		My_CharacterSetInfoPtr			characterSetInfoPtr;	//!< pointer to either G0 or G1 character rules, whichever is active
-	} current;
+	}
 	
-	struct
+	//! Adds one to (or, if the flag is false, subtracts one from)
+	//! the line count of every image that the given attribute
+	//! runs show; see returnImageLineCount().
+	void
+	countImages		(TerminalLine_AttributeRunList::const_iterator	inBegin,
+					 TerminalLine_AttributeRunList::const_iterator	inEnd,
+					 bool											inIsAdded)
 	{
-		TextAttributes_Object		drawingAttributes;	//!< previous bits of corresponding bits in "current" structure
-		SInt16						cursorX;			//!< previous value of corresponding value in "current" structure
-		My_ScreenRowIndex			cursorY;			//!< previous value of corresponding value in "current" structure
-	} previous;
-	
-	TerminalScreenRef		selfRef;					//!< opaque reference that would resolve to a pointer to this structure
-};
-typedef My_ScreenBuffer*			My_ScreenBufferPtr;
-typedef My_ScreenBuffer const*		My_ScreenBufferConstPtr;
-
-typedef MemoryBlockReferenceLocker< TerminalScreenRef, My_ScreenBuffer >	My_ScreenReferenceLocker;
-
-/*!
-Manages state determination and transition for conditions
-that no emulator knows how to deal with.  Also used to
-handle extremely common things like echoing printable
-characters.
-*/
-class My_DefaultEmulator
-{
-public:
-	static UInt32	echoData			(My_ScreenBufferPtr, UInt8 const*, UInt32);
-	static void		hardSoftReset		(My_EmulatorPtr, Boolean);
-	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
-	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
-};
-
-/*!
-Manages state determination and transition for a terminal
-that does nothing but echo human-readable versions of every
-character it receives.
-*/
-class My_DumbTerminal
-{
-public:
-	static UInt32	echoData			(My_ScreenBufferPtr, UInt8 const*, UInt32);
-	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
-	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
-};
-
-/*!
-A lightweight terminal implementation, suitable ONLY as a
-pre-callback.  Implements custom iTerm2 sequences.
-*/
-class My_ITermCore
-{
-public:
-	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
-	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
+		std::vector< ImageStore_ImageID >	imageIDs;
+		
+		
+		appendLineImages(inBegin, inEnd, imageIDs);
+		for (ImageStore_ImageID const kImageID : imageIDs)
+		{
+			if (inIsAdded)
+			{
+				++(imageLineCounts[kImageID]);
+			}
+			else
+			{
+				auto	toPair = imageLineCounts.find(kImageID);
+				
+				
+				if (imageLineCounts.end() != toPair)
+				{
+					--(toPair->second);
+					if (0 == toPair->second)
+					{
+						imageLineCounts.erase(toPair);
+					}
+				}
+			}
+		}
+	}
 	
-	enum State
-	{
-		// Ideally these are "protected", but loop evasion code requires them.
-		kStateITermCustomBegin		= kMy_ParserStateSeenESCRightSqBracket1337Semi,	//!< saw custom iTerm2 ESC]1337; sequence
-		kStateITermAcquireStr		= 'iAcS',							//!< continuously copy iTerm2 data string
-		kStateITermStringTerminator	= kMy_ParserStateSeenControlG		//!< end of custom data stream
-	};
-};
-
-/*!
-A lightweight terminal implementation, suitable ONLY as a
-pre-callback.  Implements the Sixel graphics sequences.
-*/
-class My_SixelCore
-{
-public:
-	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
-	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
-};
-
-/*!
-A lightweight terminal implementation, suitable ONLY as a
-pre-callback.  Implements sequences that are unique to the
-UTF-8 encoding (Unicode).
-*/
-class My_UTF8Core
-{
-public:
-	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
-	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
-
-protected:
-	enum State
+	//! Calls countImages() for the attributes of the given line,
+	//! using its compact form if it has one.
+	void
+	countLineImages		(Line const&	inLine,
+						 bool			inIsAdded)
 	{
-		// Ideally these are "protected", but loop evasion code requires them.
-		kStateUTF8OnUnspecifiedImpl		= kMy_ParserStateSeenESCPercentG,		//!< switch to UTF-8, allow return to normal mode; unspecified behavior
-		kStateUTF8Off					= kMy_ParserStateSeenESCPercentAt,		//!< disable UTF-8, return to ordinary emulator character set behavior
-		kStateToUTF8Level1				= kMy_ParserStateSeenESCPercentSlashG,	//!< switch to UTF-8 level 1; cannot switch back
-		kStateToUTF8Level2				= kMy_ParserStateSeenESCPercentSlashH,	//!< switch to UTF-8 level 2; cannot switch back
-		kStateToUTF8Level3				= kMy_ParserStateSeenESCPercentSlashI,	//!< switch to UTF-8 level 3; cannot switch back
-	};
-};
-
-/*!
-Manages state determination and transition for the VT100
-terminal emulator while in ANSI mode.  The VT52 subclass
-handles sequences specific to VT52 mode.
-*/
-class My_VT100
-{
-public:
-	static void				hardSoftReset		(My_EmulatorPtr, Boolean);
-	static My_ParserState	returnCSINextState	(My_ParserState, UnicodeScalarValue, Boolean&);
-	static UInt32			stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
-	static UInt32			stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
+		if (nullptr != inLine.compactForm)
+		{
+			TerminalLine_AttributeRunList::RunList const&	kRuns = inLine.compactForm->returnAttributeRuns();
+			
+			
+			countImages(kRuns.begin(), kRuns.end(), inIsAdded);
+		}
+		else
+		{
+			TerminalLine_AttributeRunList const&	kRuns = inLine.handle->returnAttributeRuns();
+			
+			
+			countImages(kRuns.begin(), kRuns.end(), inIsAdded);
+		}
+	}
 	
-	static void		alignmentDisplay			(My_ScreenBufferPtr);
-	static void		ansiMode					(My_ScreenBufferPtr);
-	static void		cursorBackward				(My_ScreenBufferPtr);
-	static void		cursorDown					(My_ScreenBufferPtr);
-	static void		cursorForward				(My_ScreenBufferPtr);
-	static void		cursorUp					(My_ScreenBufferPtr);
-	static void		deviceAttributes			(My_ScreenBufferPtr);
-	static void		deviceStatusReport			(My_ScreenBufferPtr);
-	static void		eraseInDisplay				(My_ScreenBufferPtr);
-	static void		eraseInLine					(My_ScreenBufferPtr);
-	static void		loadLEDs					(My_ScreenBufferPtr);
-	static void		modeSetReset				(My_ScreenBufferPtr, Boolean);
-	static void		reportTerminalParameters	(My_ScreenBufferPtr);
-	static void		setTopAndBottomMargins		(My_ScreenBufferPtr);
-	static void		vt52Mode					(My_ScreenBufferPtr);
+	//! Removes the oldest line, destroying any compact form.  The
+	//! caller must first remove the line from the image counts
+	//! (see countLineImages()).
+	void
+	discardOldest ()
+	{
+		if (nullptr != lines.front().compactForm)
+		{
+			compactByteCount -= lines.front().compactForm->returnByteCount();
+			--compactLineCount;
+		}
+		if (false == restoredLinePositions.empty())
+		{
+			auto	toPosition = restoredLinePositions.find(oldestSequenceNumber);
+			
+			
+			if (restoredLinePositions.end() != toPosition)
+			{
+				restoredLineOrder.erase(toPosition->second);
+				restoredLinePositions.erase(toPosition);
+			}
+		}
+		lines.pop_front();
+		++oldestSequenceNumber;
+		if (reflowPendingLineCount > 0)
+		{
+			--reflowPendingLineCount;
+		}
+		if (nullptr != searchIndex)
+		{
+			searchIndex->discardBefore(oldestSequenceNumber);
+		}
+	}
 	
-	class VT52
+	//! Returns the line at the given index (from the oldest line),
+	//! restoring it from its compact form first if necessary.  At
+	//! most kRestoredLineLimit restored lines are kept expanded:
+	//! restoring one more compacts the least recently used one
+	//! again (so, a caller must not hold references to more than
+	//! that many old lines at once).
+	My_ScreenBufferLinePtr&
+	expandedLine	(size_type	inIndexZeroForOldest)
 	{
-		friend class My_VT100;
+		Line&					targetLine = lines[inIndexZeroForOldest];
+		SequenceNumber const	kSequenceNumber = oldestSequenceNumber + STATIC_CAST(inIndexZeroForOldest, SequenceNumber);
 		
-	public:
-		static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
-		static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
 		
-		static void		cursorBackward		(My_ScreenBufferPtr);
-		static void		cursorDown			(My_ScreenBufferPtr);
-		static void		cursorForward		(My_ScreenBufferPtr);
-		static void		cursorUp			(My_ScreenBufferPtr);
-		static void		identify			(My_ScreenBufferPtr);
+		if (nullptr != searchIndex)
+		{
+			// the caller may change the line
+			searchIndex->invalidateLine(kSequenceNumber);
+		}
+		if (nullptr != targetLine.compactForm)
+		{
+			if (false == spareLines.empty())
+			{
+				targetLine.handle.swap(spareLines.back());
+				spareLines.pop_back();
+			}
+			targetLine.compactForm->restore(*targetLine.handle);
+			compactByteCount -= targetLine.compactForm->returnByteCount();
+			--compactLineCount;
+			++restorationCount;
+			targetLine.compactForm.reset();
+			restoredLinePositions[kSequenceNumber] = restoredLineOrder.insert(restoredLineOrder.end(), kSequenceNumber);
+			while (restoredLineOrder.size() > kRestoredLineLimit)
+			{
+				SequenceNumber const	kEvictedNumber = restoredLineOrder.front();
+				
+				
+				restoredLinePositions.erase(kEvictedNumber);
+				restoredLineOrder.pop_front();
+				if (isValidSequenceNumber(kEvictedNumber))
+				{
+					size_type const		kEvictedIndex = STATIC_CAST(kEvictedNumber - oldestSequenceNumber, size_type);
+					
+					
+					if ((lines.size() - 1 - kEvictedIndex) >= kExpandedLineLimit)
+					{
+						compactLine(kEvictedIndex);
+					}
+				}
+			}
+		}
+		else if ((false == restoredLinePositions.empty()) &&
+					((lines.size() - 1 - inIndexZeroForOldest) >= kExpandedLineLimit))
+		{
+			// a restored line that is used again becomes the most recently used
+			auto	toPosition = restoredLinePositions.find(kSequenceNumber);
+			
+			
+			if (restoredLinePositions.end() != toPosition)
+			{
+				restoredLineOrder.splice(restoredLineOrder.end(), restoredLineOrder, toPosition->second);
+			}
+		}
+		return targetLine.handle;
+	}
 	
-	protected:
-		// The names of these constants use the same mnemonics from
-		// the programming manual of the original terminal.
-		enum State
+	//! Ends a reflow, restoring the search index if it was enabled.
+	void
+	finishReflow ()
+	{
+		reflowColumnCount = 0;
+		reflowPendingLineCount = 0;
+		reflowScratchLines.clear();
+		if (isSearchIndexDeferred)
 		{
-			// VT100 sequences in VT52 compatibility mode (in the order they appear in the manual) - see VT100 manual for full details
-			kStateCU		= kMy_ParserStateSeenESCA,				//!< cursor up
-			kStateCD		= kMy_ParserStateSeenESCB,				//!< cursor down
-			kStateCR 		= kMy_ParserStateSeenESCC,				//!< cursor right
-			kStateCL 		= kMy_ParserStateSeenESCD,				//!< cursor left
-			kStateNGM		= kMy_ParserStateSeenESCF,				//!< enter graphics mode
-			kStateXGM		= kMy_ParserStateSeenESCG,				//!< exit graphics mode
-			kStateCH		= kMy_ParserStateSeenESCH,				//!< cursor home
-			kStateRLF		= kMy_ParserStateSeenESCI,				//!< reverse line feed
-			kStateEES		= kMy_ParserStateSeenESCJ,				//!< erase to end of screen
-			kStateEEL		= kMy_ParserStateSeenESCK,				//!< erase to end of line
-			kStateDCA		= kMy_ParserStateSeenESCY,				//!< direct cursor address
-			kStateDCAY		= 'DCAY',								//!< direct cursor address, seen first follow-up character (Y)
-			kStateDCAX		= 'DCAX',								//!< direct cursor address, seen second follow-up character (X)
-			kStateID		= kMy_ParserStateSeenESCZ,				//!< identify terminal
-			kStateNAKM		= kMy_ParserStateSeenESCEquals,			//!< enter alternate keypad mode
-			kStateXAKM		= kMy_ParserStateSeenESCGreaterThan,	//!< exit alternate keypad mode
-			kStateANSI		= kMy_ParserStateSeenESCLessThan,		//!< enter ANSI mode
-		};
-	};
+			isSearchIndexDeferred = false;
+			setSearchIndexEnabled(true);
+		}
+	}
 	
-	// The names of these constants use the same mnemonics from
-	// the programming manual of the original terminal.
-	enum State
+	//! Adds the trigrams of the line at the given index (from the
+	//! oldest line) to the search index, including any trigrams that
+	//! begin on previous rows whose text wraps onto this one.  The
+	//! text is what a search would see (see searchChunk()): for
+	//! instance, a soft-wrapped row contributes all columns up to
+	//! its wrap column, padded with spaces, and the placeholders
+	//! of double-width characters are left out.
+	void
+	indexLine	(size_type	inIndexZeroForOldest)
 	{
-		// VT100 immediates (in order of the corresponding control character’s ASCII code)
-		kStateControlENQ		= 'VAns',				//!< transmit answerback message
-		kStateControlBEL		= 'VBel',				//!< audio event
-		kStateControlBS			= 'VBks',				//!< move cursor left if possible
-		kStateControlHT			= 'VTab',				//!< move cursor right to tab stop, or margin
-		kStateControlLFVTFF		= 'VLnF',				//!< newline or line feed, depending on LNM
-		kStateControlCR			= 'VCRt',				//!< move cursor down and to left margin
-		kStateControlSO			= 'VShO',				//!< shift out to G1 character set
-		kStateControlSI			= 'VShI',				//!< shift in to G0 character set
-		kStateControlXON		= 'VXON',				//!< resume transmission
-		kStateControlXOFF		= 'VXOF',				//!< suspend transmission
-		kStateControlCANSUB		= 'VCAN',				//!< terminate control seq. with error char.
+		Line const&			kLine = lines[inIndexZeroForOldest];
+		UInt16 const		kWrapColumnCount = returnSoftWrapColumnCount(kLine);
+		UniChar				wrappedCharacters[2]; // last characters of previous rows, newest first
+		size_t				wrappedCharacterCount = 0;
+		UniChar const*		textPtr = nullptr;
+		CFIndex				textLength = 0;
 		
-		// VT100 sequences (in the order they appear in the manual) - see VT100 manual for full details
-		kStateCSI				= kMy_ParserStateSeenESCLeftSqBracket,	//!< control sequence inducer
-		kStateCSIParamDigit0	= 'PNm0',				//!< digit has been encountered; define or extend current numerical parameter value;
-		kStateCSIParamDigit1	= 'PNm1',				//!  IMPORTANT: the 10 digit state values must be defined consecutively, as the code uses a
-		kStateCSIParamDigit2	= 'PNm2',				//!  short-cut that relies on arithmetic...
-		kStateCSIParamDigit3	= 'PNm3',
-		kStateCSIParamDigit4	= 'PNm4',
-		kStateCSIParamDigit5	= 'PNm5',
-		kStateCSIParamDigit6	= 'PNm6',
-		kStateCSIParamDigit7	= 'PNm7',
-		kStateCSIParamDigit8	= 'PNm8',
-		kStateCSIParamDigit9	= 'PNm9',
-		kStateCSIParamDigitSub	= 'PNm:',				//!< end of sub-parameter (colons can appear more than once)
-		kStateCSIParameterEnd	= kMy_ParserStateSeenESCLeftSqBracketSemicolon,		//!< end of parameter (semicolons can appear more than once)
-		kStateCSIPrivate		= kMy_ParserStateSeenESCLeftSqBracketQuestionMark,	//!< parameter list prefixed by '?' to indicate a private sequence
-		kStateCUB				= kMy_ParserStateSeenESCLeftSqBracketParamsD,	//!< cursor backward
-		kStateCUD				= kMy_ParserStateSeenESCLeftSqBracketParamsB,	//!< cursor down
-		kStateCUF				= kMy_ParserStateSeenESCLeftSqBracketParamsC,	//!< cursor forward
-		kStateCUP				= kMy_ParserStateSeenESCLeftSqBracketParamsH,	//!< cursor position
-		kStateCUU				= kMy_ParserStateSeenESCLeftSqBracketParamsA,	//!< cursor up
-		kStateDA				= kMy_ParserStateSeenESCLeftSqBracketParamsc,	//!< device attributes
-		kStateDECALN			= kMy_ParserStateSeenESCPound8,			//!< screen alignment display
-		kStateDECANM			= 'VANM',				//!< ANSI/VT52 mode
-		kStateDECARM			= 'VARM',				//!< auto repeat mode
-		kStateDECAWM			= 'VAWM',				//!< auto wrap mode
-		kStateDECCKM			= 'VCKM',				//!< cursor keys mode
-		kStateDECCOLM			= 'VCLM',				//!< column mode
-		kStateDECDHLT			= kMy_ParserStateSeenESCPound3,			//!< double height line, top half
-		kStateDECDHLB			= kMy_ParserStateSeenESCPound4,			//!< double height line, bottom half
-		kStateDECDWL			= kMy_ParserStateSeenESCPound6,			//!< double width line
-		kStateDECID				= kMy_ParserStateSeenESCZ,				//!< identify terminal
-		kStateDECKPAM			= kMy_ParserStateSeenESCEquals,			//!< keypad application mode
-		kStateDECKPNM			= kMy_ParserStateSeenESCGreaterThan,	//!< keypad numeric mode
-		kStateDECLL				= kMy_ParserStateSeenESCLeftSqBracketParamsq,	//!< load LEDs (keyboard lights)
-		kStateDECOM				= 'VOM ',				//!< origin mode
-		kStateDECRC				= kMy_ParserStateSeenESC8,				//!< restore cursor
-		kStateDECREPTPARM		= 'VRPM',				//!< report terminal parameters
-		kStateDECREQTPARM		= kMy_ParserStateSeenESCLeftSqBracketParamsx,	//!< request terminal parameters
-		kStateDECSC				= kMy_ParserStateSeenESC7,				//!< save cursor
-		kStateDECSTBM			= kMy_ParserStateSeenESCLeftSqBracketParamsr,	//!< set top and bottom margins
-		kStateDECSWL			= kMy_ParserStateSeenESCPound5,			//!< single width line
-		kStateDECTST			= 'VTST',				//!< invoke confidence test
-		kStateDSR				= kMy_ParserStateSeenESCLeftSqBracketParamsn,	//!< device status report
-		kStateED 				= kMy_ParserStateSeenESCLeftSqBracketParamsJ,	//!< erase in display
-		kStateEL 				= kMy_ParserStateSeenESCLeftSqBracketParamsK,	//!< erase in line
-		kStateHTS				= kMy_ParserStateSeenESCH,				//!< horizontal tabulation set
-		kStateHVP				= kMy_ParserStateSeenESCLeftSqBracketParamsf,	//!< horizontal and vertical position
-		kStateIND				= kMy_ParserStateSeenESCD,				//!< index
-		kStateNEL				= kMy_ParserStateSeenESCE,				//!< next line
-		kStateRI				= kMy_ParserStateSeenESCM,				//!< reverse index
-		kStateRIS				= kMy_ParserStateSeenESCc,				//!< reset to initial state
-		kStateRM				= kMy_ParserStateSeenESCLeftSqBracketParamsl,	//!< reset mode
-		kStateSCSG0UK			= kMy_ParserStateSeenESCLeftParenA,		//!< select character set for G0, U.K.
-		kStateSCSG0ASCII		= kMy_ParserStateSeenESCLeftParenB,		//!< select character set for G0, ASCII
-		kStateSCSG0SG			= kMy_ParserStateSeenESCLeftParen0,		//!< select character set for G0, special graphics
-		kStateSCSG0ACRStd		= kMy_ParserStateSeenESCLeftParen1,		//!< select character set for G0, alternate character ROM standard set
-		kStateSCSG0ACRSG		= kMy_ParserStateSeenESCLeftParen2,		//!< select character set for G0, alternate character ROM special graphics
-		kStateSCSG1UK			= kMy_ParserStateSeenESCRightParenA,	//!< select character set for G0, U.K.
-		kStateSCSG1ASCII		= kMy_ParserStateSeenESCRightParenB,	//!< select character set for G0, ASCII
-		kStateSCSG1SG			= kMy_ParserStateSeenESCRightParen0,	//!< select character set for G0, special graphics
-		kStateSCSG1ACRStd		= kMy_ParserStateSeenESCRightParen1,	//!< select character set for G0, alternate character ROM standard set
-		kStateSCSG1ACRSG		= kMy_ParserStateSeenESCRightParen2,	//!< select character set for G0, alternate character ROM special graphics
-		kStateSGR				= kMy_ParserStateSeenESCLeftSqBracketParamsm,	//!< select graphic rendition
-		kStateSM				= kMy_ParserStateSeenESCLeftSqBracketParamsh,	//!< set mode
-		kStateTBC				= kMy_ParserStateSeenESCLeftSqBracketParamsg,	//!< tabulation clear
 		
-		// ANSI hacks that should be in their own emulator, but for now are not
-		kStateANSISC			= kMy_ParserStateSeenESCLeftSqBracketParamss,	//!< save cursor
-		kStateANSIRC			= kMy_ParserStateSeenESCLeftSqBracketParamsu,	//!< restore cursor
-	};
+		// find the end of any text that continues onto this row (usually
+		// from one row, but from two if the previous row has one column)
+		for (size_type previousIndex = inIndexZeroForOldest; ((wrappedCharacterCount < 2) && (previousIndex > 0)); --previousIndex)
+		{
+			Line const&		kPreviousLine = lines[previousIndex - 1];
+			UInt16 const	kPreviousWrapColumnCount = returnSoftWrapColumnCount(kPreviousLine);
+			
+			
+			if (0 == kPreviousWrapColumnCount)
+			{
+				break;
+			}
+			textLength = returnLineText(kPreviousLine.handle, kPreviousLine.compactForm.get(), indexCharacters, textPtr);
+			for (CFIndex offset = (kPreviousWrapColumnCount - 1); ((wrappedCharacterCount < 2) && (offset >= 0)); --offset)
+			{
+				UniChar const	kCharacter = (offset < textLength) ? textPtr[offset] : ' ';
+				
+				
+				if (kTerminal_WideCharacterContinuation != kCharacter)
+				{
+					wrappedCharacters[wrappedCharacterCount++] = kCharacter;
+				}
+			}
+		}
+		
+		textLength = returnLineText(kLine.handle, kLine.compactForm.get(), indexCharacters, textPtr);
+		{
+			CFIndex const	kSearchedLength = (kWrapColumnCount > 0) ? STATIC_CAST(kWrapColumnCount, CFIndex) : textLength;
+			CFIndex			trimmedLength = std::min(textLength, kSearchedLength);
+			
+			
+			// trailing spaces only contribute a few distinct trigrams
+			while ((trimmedLength > 0) && (' ' == textPtr[trimmedLength - 1]))
+			{
+				--trimmedLength;
+			}
+			indexText.clear();
+			while (wrappedCharacterCount > 0)
+			{
+				indexText.push_back(wrappedCharacters[--wrappedCharacterCount]);
+			}
+			for (CFIndex i = 0; i < std::min(kSearchedLength, trimmedLength + 3); ++i)
+			{
+				UniChar const	kCharacter = (i < textLength) ? textPtr[i] : ' ';
+				
+				
+				if (kTerminal_WideCharacterContinuation != kCharacter)
+				{
+					indexText.push_back(kCharacter);
+				}
+			}
+		}
+		
+		// even a blank line is added, so that its block exists in case
+		// the line changes later (see My_ScrollbackSearchIndex::addTrigrams())
+		searchIndex->addTrigrams(oldestSequenceNumber + STATIC_CAST(inIndexZeroForOldest, SequenceNumber),
+									indexText.data(), indexText.size());
+	}
+	
+	//! Returns true only if the given cell of the given row of a
+	//! logical line (see reflowRows()) is the first half of a
+	//! double-width character: the next cell of the logical line
+	//! (possibly on the next row) is either a placeholder or the
+	//! second half of a surrogate pair.
+	static bool
+	isReflowWideCharacterStart	(std::vector< TerminalLine_Object const* > const&	inRows,
+								 std::vector< UInt16 > const&						inCellCounts,
+								 size_t												inRowIndex,
+								 UInt16												inCell)
+	{
+		bool	result = false;
+		
+		
+		if ((inCell + 1) < inCellCounts[inRowIndex])
+		{
+			UniChar const	kNextCharacter = inRows[inRowIndex]->textVectorBegin[inCell + 1];
+			
+			
+			result = ((kTerminal_WideCharacterContinuation == kNextCharacter) || CFStringIsSurrogateLowCharacter(kNextCharacter));
+		}
+		else if (((inRowIndex + 1) < inRows.size()) && (inCellCounts[inRowIndex + 1] > 0))
+		{
+			UniChar const	kNextCharacter = inRows[inRowIndex + 1]->textVectorBegin[0];
+			
+			
+			result = ((kTerminal_WideCharacterContinuation == kNextCharacter) || CFStringIsSurrogateLowCharacter(kNextCharacter));
+		}
+		return result;
+	}
+	
+	//! Appends to "reflowNewLines" the rows of the logical line
+	//! from the first index up to (but not including) the past-
+	//! the-end index (from the oldest line), rewrapped to the
+	//! current reflow width; the caller removes the original rows.
+	void
+	reflowGroup		(size_type	inFirstIndex,
+					 size_type	inPastEndIndex)
+	{
+		bool	isDoubleSize = false;
+		
+		
+		reflowSourceRows.clear();
+		reflowCellCounts.clear();
+		for (size_type i = inFirstIndex; i < inPastEndIndex; ++i)
+		{
+			Line const&		kLine = lines[i];
+			
+			
+			if (nullptr != kLine.compactForm)
+			{
+				size_t const	kScratchIndex = (i - inFirstIndex);
+				
+				
+				// compacted rows are decoded into reusable lines
+				if (reflowScratchLines.size() <= kScratchIndex)
+				{
+					reflowScratchLines.resize(kScratchIndex + 1, My_ScreenBufferLinePtr(lineAllocator));
+				}
+				kLine.compactForm->restore(*(reflowScratchLines[kScratchIndex]));
+				reflowSourceRows.push_back(&*(reflowScratchLines[kScratchIndex]));
+			}
+			else
+			{
+				reflowSourceRows.push_back(&*(kLine.handle));
+			}
+			reflowCellCounts.push_back(returnReflowCellCount(kLine));
+			if (reflowSourceRows.back()->returnGlobalAttributes().hasDoubleAny())
+			{
+				isDoubleSize = true;
+			}
+		}
+		
+		if (isDoubleSize)
+		{
+			// lines with double-sized text are never wrapped, so
+			// they are kept exactly as they are
+			for (size_type i = inFirstIndex; i < inPastEndIndex; ++i)
+			{
+				reflowNewLines.emplace_back(std::move(lines[i]));
+			}
+		}
+		else
+		{
+			// images are counted by row, so the rows are counted again
+			for (TerminalLine_Object const* rowPtr : reflowSourceRows)
+			{
+				countImages(rowPtr->returnAttributeRuns().begin(), rowPtr->returnAttributeRuns().end(), false/* is added */);
+			}
+			reflowRows(reflowSourceRows, reflowCellCounts, reflowColumnCount,
+						(0 != returnSoftWrapColumnCount(lines[inPastEndIndex - 1])), 0/* minimum cell count */,
+						lineAllocator, reflowNewRows);
+			for (My_ScreenBufferLinePtr& newRowPtr : reflowNewRows)
+			{
+				reflowNewLines.emplace_back(lineAllocator);
+				reflowNewLines.back().handle.swap(newRowPtr);
+				countLineImages(reflowNewLines.back(), true/* is added */);
+			}
+			reflowNewRows.clear();
+			
+			// keep a few of the released allocations for reuse
+			for (size_type i = inFirstIndex; ((i < inPastEndIndex) && (spareLines.size() < kSpareLineLimit)); ++i)
+			{
+				if ((nullptr == lines[i].compactForm) && (false == lines[i].handle.isDefault()))
+				{
+					spareLines.emplace_back(lineAllocator);
+					spareLines.back().swap(lines[i].handle);
+				}
+			}
+		}
+	}
+	
+	//! Returns the number of cells of the given line that belong to
+	//! its logical line: all columns up to the soft wrap if the line
+	//! wrapped, otherwise every cell up to the last non-blank one.
+	static UInt16
+	returnReflowCellCount	(Line const&	inLine)
+	{
+		UInt16		result = returnSoftWrapColumnCount(inLine);
+		
+		
+		if (0 == result)
+		{
+			result = ((nullptr != inLine.compactForm)
+						? inLine.compactForm->returnCellCount()
+						: inLine.handle->returnTrimmedCellCount());
+		}
+		return result;
+	}
+	
+	//! Returns the column after which the given line wrapped
+	//! automatically, or zero.
+	static UInt16
+	returnSoftWrapColumnCount	(Line const&	inLine)
+	{
+		return ((nullptr != inLine.compactForm)
+				? inLine.compactForm->returnSoftWrapColumnCount()
+				: inLine.handle->softWrapColumnCount);
+	}
+
+private:
+	TerminalLine_Allocator&					lineAllocator;				//!< source of every line (see My_ScreenBuffer)
+	LineDeque								lines;						//!< all lines, oldest at the FRONT
+	SequenceNumber							oldestSequenceNumber;		//!< sequence number of the front line
+	SequenceNumberList						restoredLineOrder;			//!< lines restored and still expanded, least recently used at the FRONT
+	std::map< SequenceNumber, SequenceNumberList::iterator >	restoredLinePositions;	//!< where each restored line is in "restoredLineOrder"
+	std::vector< My_ScreenBufferLinePtr >	spareLines;					//!< allocations released by compaction, for reuse
+	size_type								compactLineCount;			//!< number of lines with "compactForm" defined
+	size_t									compactByteCount;			//!< sum of the byte counts of all compact forms
+	UInt64									compactionCount;			//!< total number of lines ever compacted
+	UInt64									restorationCount;			//!< total number of lines ever restored
+	std::map< ImageStore_ImageID, UInt32 >	imageLineCounts;			//!< for each image shown by any line, the number of such lines
+	std::unique_ptr< My_ScrollbackSearchIndex >	searchIndex;			//!< if defined, trigrams of lines for faster searches
+	std::vector< UniChar >					indexCharacters;			//!< reused by indexLine() for lines that cannot be read in place
+	std::vector< UniChar >					indexText;					//!< reused by indexLine() for the text to be indexed
+	UInt16									reflowColumnCount;			//!< if nonzero, the width that lines are being rewrapped to
+	size_type								reflowPendingLineCount;		//!< number of OLDEST lines that are not yet rewrapped
+	bool									isSearchIndexDeferred;		//!< if true, the search index is rebuilt when the reflow ends
+	std::vector< UInt16 >					reflowCellCounts;			//!< reused by reflowGroup() for the cells of each row
+	std::vector< TerminalLine_Object const* >	reflowSourceRows;		//!< reused by reflowGroup() for the rows being joined
+	std::vector< My_ScreenBufferLinePtr >	reflowScratchLines;			//!< reused by reflowGroup() for rows decoded from compact forms
+	std::vector< My_ScreenBufferLinePtr >	reflowNewRows;				//!< reused by reflowGroup() for rewrapped rows
+	std::vector< Line >						reflowNewLines;				//!< reused by continueReflow() for all rows that replace a range
 };
 
 /*!
-Manages state determination and transition for the VT102
-terminal emulator.
+Represents a line of the terminal buffer, either in the
+scrollback or one of the main screen (“visible”) lines.
+
+A line iterator can traverse from the oldest scrollback
+line (the beginning) all the way to the bottommost main
+screen line (the end), as if all terminal lines were
+stored sequentially in memory.
+
+Scrollback positions are kept as sequence numbers (see
+My_ScrollbackBuffer) so that an iterator continues to
+refer to the same line as newer lines are added.  The
+iterator holds a non-constant reference to the buffer,
+but should have no legitimate reason to resize it.
 */
-class My_VT102:
-public My_VT100
+struct My_LineIterator
 {
 public:
-	static void		deleteCharacters	(My_ScreenBufferPtr);
-	static void		deleteLines			(My_ScreenBufferPtr);
-	static void		deviceAttributes	(My_ScreenBufferPtr);
-	static void		insertLines			(My_ScreenBufferPtr);
-	static void		loadLEDs			(My_ScreenBufferPtr);
+	enum BufferTarget
+	{
+		kBufferTargetScreen = 0,
+		kBufferTargetScrollback = 1
+	};
 	
-	static My_ParserState	returnCSINextState	(My_ParserState, UnicodeScalarValue, Boolean&);
-	static UInt32			stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
-	static UInt32			stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
-
-protected:
-	// The names of these constants use the same mnemonics from
-	// the programming manual of the original terminal.
-	enum State
+	enum ScreenBufferDesignator
 	{
-		kStateDCH		= kMy_ParserStateSeenESCLeftSqBracketParamsP,	//!< delete characters on the cursor line
-		kStateDL		= kMy_ParserStateSeenESCLeftSqBracketParamsM,	//!< delete lines, including cursor line
-		kStateIL		= kMy_ParserStateSeenESCLeftSqBracketParamsL,	//!< insert lines below cursor line
-		kStateMC		= kMy_ParserStateSeenESCLeftSqBracketParamsi,	//!< media copy (printer access)
+		kScreenBufferDesignator = 0
 	};
-};
-
-/*!
-Manages state determination and transition for the VT220
-terminal emulator.
-*/
-class My_VT220
-{
-public:
-	static void				hardSoftReset		(My_EmulatorPtr, Boolean);
-	static My_ParserState	returnCSINextState	(My_ParserState, UnicodeScalarValue, Boolean&);
-	static UInt32			stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
-	static UInt32			stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
 	
-	static void		compatibilityLevel					(My_ScreenBufferPtr);
-	static void		deviceStatusReportKeyboardLanguage	(My_ScreenBufferPtr);
-	static void		deviceStatusReportPrinterPort		(My_ScreenBufferPtr);
-	static void		deviceStatusReportUserDefinedKeys	(My_ScreenBufferPtr);
-	static void		eraseCharacters						(My_ScreenBufferPtr);
-	static void		insertBlankCharacters				(My_ScreenBufferPtr);
-	static void		primaryDeviceAttributes				(My_ScreenBufferPtr);
-	static void		requestDECPrivateMode				(My_ScreenBufferPtr);
-	static void		secondaryDeviceAttributes			(My_ScreenBufferPtr);
-	static void		selectCharacterAttributes			(My_ScreenBufferPtr);
-	static void		selectCursorStyle					(My_ScreenBufferPtr);
-	static void		selectiveEraseInDisplay				(My_ScreenBufferPtr);
-	static void		selectiveEraseInLine				(My_ScreenBufferPtr);
-
-	// The names of these constants use the same mnemonics from
-	// the programming manual of the original terminal.
-	enum State
+	// the "inDesignateScreen" is used only to provide a unique
+	// constructor signature for iterators that start on the screen
+	My_LineIterator		(Boolean							isHeapStorage,
+						 My_ScreenBufferLineList&			inScreenBuffer,
+						 My_ScrollbackBuffer&				inScrollbackBuffer,
+						 My_ScreenBufferLineList::iterator	inRowIterator,
+						 ScreenBufferDesignator				UNUSED_ARGUMENT(inDesignateScreen))
+	:
+	screenBuffer(inScreenBuffer),
+	scrollbackBuffer(inScrollbackBuffer),
+	screenRowIterator(inRowIterator),
+	scrollbackRowNumber(0),
+	currentBufferType(kBufferTargetScreen),
+	heapAllocated(isHeapStorage)
 	{
-		// Ideally these are "protected", but XTerm may require them.
-		kStateCSISecondaryDA	= kMy_ParserStateSeenESCLeftSqBracketGreaterThan,	//!< parameter list indicates secondary device attributes
-		kStateDCS				= kMy_ParserStateSeenESCP,				//!< device control string
-		kStateDCSAcquireStr		= 'VACS',								//!< state of reading bytes into string accumulator
-		kStateDECRQM			= 'VRQM',								//!< request DEC private mode
-		kStateDECSCA			= 'VSCA',								//!< select character attributes
-		kStateDECSCL			= 'VSCL',								//!< compatibility level
-		kStateDECSTR			= kMy_ParserStateSeenESCLeftSqBracketExPointp,	//!< soft terminal reset
-		kStateDECSCUSR			= 'VSCU',								//!< select cursor style
-		kStateECH				= kMy_ParserStateSeenESCLeftSqBracketParamsX,	//!< erase characters without insertion
-		kStateICH				= kMy_ParserStateSeenESCLeftSqBracketParamsAt,	//!< insert blank characters
-		kStateLS1R				= kMy_ParserStateSeenESCTilde,			//!< lock shift G1, right side
-		kStateLS2				= kMy_ParserStateSeenESCn,				//!< lock shift G2, left side
-		kStateLS2R				= kMy_ParserStateSeenESCRightBrace,		//!< lock shift G2, right side
-		kStateLS3				= kMy_ParserStateSeenESCo,				//!< lock shift G3, left side
-		kStateLS3R				= kMy_ParserStateSeenESCVerticalBar,	//!< lock shift G3, right side
-		kStateS7C1T				= kMy_ParserStateSeenESCSpaceF,			//!< direct terminal to emit 7-bit sequences only (CSI = "ESC[")
-		kStateS8C1T				= kMy_ParserStateSeenESCSpaceG,			//!< direct terminal to emit 8-bit sequences only (CSI = the CSI C1 code)
-		kStateSCSG0DECSupplemental	= kMy_ParserStateSeenESCLeftParenLessThan,	//!< select character set for G0, DEC supplemental
-		kStateSCSG0Dutch		= kMy_ParserStateSeenESCLeftParen4,		//!< select character set for G0, Dutch
-		kStateSCSG0Finnish1		= kMy_ParserStateSeenESCLeftParenC,		//!< select character set for G0, Finnish
-		kStateSCSG0Finnish2		= kMy_ParserStateSeenESCLeftParen5,		//!< select character set for G0, Finnish (alternate)
-		kStateSCSG0French		= kMy_ParserStateSeenESCLeftParenR,		//!< select character set for G0, French
-		kStateSCSG0FrenchCdn	= kMy_ParserStateSeenESCLeftParenQ,		//!< select character set for G0, French Canadian
-		kStateSCSG0German		= kMy_ParserStateSeenESCLeftParenK,		//!< select character set for G0, German
-		kStateSCSG0Italian		= kMy_ParserStateSeenESCLeftParenY,		//!< select character set for G0, Italian
-		kStateSCSG0Norwegian1	= kMy_ParserStateSeenESCLeftParenE,		//!< select character set for G0, Norwegian and Danish
-		kStateSCSG0Norwegian2	= kMy_ParserStateSeenESCLeftParen6,		//!< select character set for G0, Norwegian and Danish (alternate)
-		kStateSCSG0Spanish		= kMy_ParserStateSeenESCLeftParenZ,		//!< select character set for G0, Spanish
-		kStateSCSG0Swedish1		= kMy_ParserStateSeenESCLeftParenH,		//!< select character set for G0, Swedish
-		kStateSCSG0Swedish2		= kMy_ParserStateSeenESCLeftParen7,		//!< select character set for G0, Swedish (alternate)
-		kStateSCSG0Swiss		= kMy_ParserStateSeenESCLeftParenEquals,	//!< select character set for G0, Swiss
-		kStateSCSG1DECSupplemental	= kMy_ParserStateSeenESCRightParenLessThan,	//!< select character set for G1, DEC supplemental
-		kStateSCSG1Dutch		= kMy_ParserStateSeenESCRightParen4,	//!< select character set for G1, Dutch
-		kStateSCSG1Finnish1		= kMy_ParserStateSeenESCRightParenC,	//!< select character set for G1, Finnish
-		kStateSCSG1Finnish2		= kMy_ParserStateSeenESCRightParen5,	//!< select character set for G1, Finnish (alternate)
-		kStateSCSG1French		= kMy_ParserStateSeenESCRightParenR,	//!< select character set for G1, French
-		kStateSCSG1FrenchCdn	= kMy_ParserStateSeenESCRightParenQ,	//!< select character set for G1, French Canadian
-		kStateSCSG1German		= kMy_ParserStateSeenESCRightParenK,	//!< select character set for G1, German
-		kStateSCSG1Italian		= kMy_ParserStateSeenESCRightParenY,	//!< select character set for G1, Italian
-		kStateSCSG1Norwegian1	= kMy_ParserStateSeenESCRightParenE,	//!< select character set for G1, Norwegian and Danish
-		kStateSCSG1Norwegian2	= kMy_ParserStateSeenESCRightParen6,	//!< select character set for G1, Norwegian and Danish (alternate)
-		kStateSCSG1Spanish		= kMy_ParserStateSeenESCRightParenZ,	//!< select character set for G1, Spanish
-		kStateSCSG1Swedish1		= kMy_ParserStateSeenESCRightParenH,	//!< select character set for G1, Swedish
-		kStateSCSG1Swedish2		= kMy_ParserStateSeenESCRightParen7,	//!< select character set for G1, Swedish (alternate)
-		kStateSCSG1Swiss		= kMy_ParserStateSeenESCRightParenEquals,	//!< select character set for G1, Swiss
-		kStateSCSG2UK			= kMy_ParserStateSeenESCAsteriskA,		//!< select character set for G2, U.K.
-		kStateSCSG2ASCII		= kMy_ParserStateSeenESCAsteriskB,		//!< select character set for G2, ASCII
-		kStateSCSG2SG			= kMy_ParserStateSeenESCAsterisk0,		//!< select character set for G2, special graphics
-		kStateSCSG2DECSupplemental	= kMy_ParserStateSeenESCAsteriskLessThan,	//!< select character set for G2, DEC supplemental
-		kStateSCSG2Dutch		= kMy_ParserStateSeenESCAsterisk4,		//!< select character set for G2, Dutch
-		kStateSCSG2Finnish1		= kMy_ParserStateSeenESCAsteriskC,		//!< select character set for G2, Finnish
-		kStateSCSG2Finnish2		= kMy_ParserStateSeenESCAsterisk5,		//!< select character set for G2, Finnish (alternate)
-		kStateSCSG2French		= kMy_ParserStateSeenESCAsteriskR,		//!< select character set for G2, French
-		kStateSCSG2FrenchCdn	= kMy_ParserStateSeenESCAsteriskQ,		//!< select character set for G2, French Canadian
-		kStateSCSG2German		= kMy_ParserStateSeenESCAsteriskK,		//!< select character set for G2, German
-		kStateSCSG2Italian		= kMy_ParserStateSeenESCAsteriskY,		//!< select character set for G2, Italian
-		kStateSCSG2Norwegian1	= kMy_ParserStateSeenESCAsteriskE,		//!< select character set for G2, Norwegian and Danish
-		kStateSCSG2Norwegian2	= kMy_ParserStateSeenESCAsterisk6,		//!< select character set for G2, Norwegian and Danish (alternate)
-		kStateSCSG2Spanish		= kMy_ParserStateSeenESCAsteriskZ,		//!< select character set for G2, Spanish
-		kStateSCSG2Swedish1		= kMy_ParserStateSeenESCAsteriskH,		//!< select character set for G2, Swedish
-		kStateSCSG2Swedish2		= kMy_ParserStateSeenESCAsterisk7,		//!< select character set for G2, Swedish (alternate)
-		kStateSCSG2Swiss		= kMy_ParserStateSeenESCAsteriskEquals,	//!< select character set for G2, Swiss
-		kStateSCSG3UK			= kMy_ParserStateSeenESCPlusA,			//!< select character set for G3, U.K.
-		kStateSCSG3ASCII		= kMy_ParserStateSeenESCPlusB,			//!< select character set for G3, ASCII
-		kStateSCSG3SG			= kMy_ParserStateSeenESCPlus0,			//!< select character set for G3, special graphics
-		kStateSCSG3DECSupplemental	= kMy_ParserStateSeenESCPlusLessThan,	//!< select character set for G3, DEC supplemental
-		kStateSCSG3Dutch		= kMy_ParserStateSeenESCPlus4,			//!< select character set for G3, Dutch
-		kStateSCSG3Finnish1		= kMy_ParserStateSeenESCPlusC,			//!< select character set for G3, Finnish
-		kStateSCSG3Finnish2		= kMy_ParserStateSeenESCPlus5,			//!< select character set for G3, Finnish (alternate)
-		kStateSCSG3French		= kMy_ParserStateSeenESCPlusR,			//!< select character set for G3, French
-		kStateSCSG3FrenchCdn	= kMy_ParserStateSeenESCPlusQ,			//!< select character set for G3, French Canadian
-		kStateSCSG3German		= kMy_ParserStateSeenESCPlusK,			//!< select character set for G3, German
-		kStateSCSG3Italian		= kMy_ParserStateSeenESCPlusY,			//!< select character set for G3, Italian
-		kStateSCSG3Norwegian1	= kMy_ParserStateSeenESCPlusE,			//!< select character set for G3, Norwegian and Danish
-		kStateSCSG3Norwegian2	= kMy_ParserStateSeenESCPlus6,			//!< select character set for G3, Norwegian and Danish (alternate)
-		kStateSCSG3Spanish		= kMy_ParserStateSeenESCPlusZ,			//!< select character set for G3, Spanish
-		kStateSCSG3Swedish1		= kMy_ParserStateSeenESCPlusH,			//!< select character set for G3, Swedish
-		kStateSCSG3Swedish2		= kMy_ParserStateSeenESCPlus7,			//!< select character set for G3, Swedish (alternate)
-		kStateSCSG3Swiss		= kMy_ParserStateSeenESCPlusEquals,		//!< select character set for G3, Swiss
-		kStateST				= kMy_ParserStateSeenESCBackslash,		//!< string terminator
-	};
-};
-
-/*!
-Manages state determination and transition for the XTerm
-terminal emulator.  Automatically uses My_XTermCore for
-various basic features, but also implements the rest of
-the XTerm terminal type.
-*/
-class My_XTerm
-{
-public:
-	static My_ParserState	returnCSINextState	(My_ParserState, UnicodeScalarValue, Boolean&);
-	static UInt32			stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
-	static UInt32			stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
+	}
 	
-	static void		cursorBackwardTabulation		(My_ScreenBufferPtr);
-	static void		cursorCharacterAbsolute			(My_ScreenBufferPtr);
-	static void		cursorForwardTabulation			(My_ScreenBufferPtr);
-	static void		cursorNextLine					(My_ScreenBufferPtr);
-	static void		cursorPreviousLine				(My_ScreenBufferPtr);
-	static void		horizontalPositionAbsolute		(My_ScreenBufferPtr);
-	static void		reportCursorStyle				(My_ScreenBufferPtr);
-	static void		reportSelectionSettingNotUsed	(My_ScreenBufferPtr);
-	static void		reportTopBottomMargins			(My_ScreenBufferPtr);
-	static void		scrollDown						(My_ScreenBufferPtr);
-	static void		scrollUp						(My_ScreenBufferPtr);
-	static void		secondaryDeviceAttributes		(My_ScreenBufferPtr);
-	static void		verticalPositionAbsolute		(My_ScreenBufferPtr);
+	// this version constructs iterators starting in the scrollback
+	My_LineIterator		(Boolean								isHeapStorage,
+						 My_ScreenBufferLineList&				inScreenBuffer,
+						 My_ScrollbackBuffer&					inScrollbackBuffer,
+						 My_ScrollbackBuffer::SequenceNumber	inRowSequenceNumber)
+	:
+	screenBuffer(inScreenBuffer),
+	scrollbackBuffer(inScrollbackBuffer),
+	screenRowIterator(),
+	scrollbackRowNumber(inRowSequenceNumber),
+	currentBufferType(kBufferTargetScrollback),
+	heapAllocated(isHeapStorage)
+	{
+	}
 	
-	enum State
+	My_ScreenBufferLine&
+	currentLine ()
 	{
-		// Ideally these are "protected", but loop evasion code requires them.
-		kStateCSITertiaryDA		= kMy_ParserStateSeenESCLeftSqBracketEquals,			//!< parameter list indicates tertiary device attributes (VT420)
-		kStateCBT				= kMy_ParserStateSeenESCLeftSqBracketParamsZ,			//!< cursor backward tabulation
-		kStateCHA				= kMy_ParserStateSeenESCLeftSqBracketParamsG,			//!< cursor character absolute
-		kStateCHT				= kMy_ParserStateSeenESCLeftSqBracketParamsI,			//!< cursor forward tabulation
-		kStateCNL				= kMy_ParserStateSeenESCLeftSqBracketParamsE,			//!< cursor next line
-		kStateCPL				= kMy_ParserStateSeenESCLeftSqBracketParamsF,			//!< cursor previous line
-		kStateHPA				= kMy_ParserStateSeenESCLeftSqBracketParamsBackquote,	//!< horizontal (character) position absolute
-		kStateSD				= kMy_ParserStateSeenESCLeftSqBracketParamsT,			//!< scroll down
-		kStateSU				= kMy_ParserStateSeenESCLeftSqBracketParamsS,			//!< scroll up
-		kStateVPA				= kMy_ParserStateSeenESCLeftSqBracketParamsd,			//!< vertical position absolute
-	};
+		// these dereferences will crash if past the end, which is expected (STL-like) behavior
+		return (currentBufferType == kBufferTargetScreen)
+				? **screenRowIterator
+				: *(scrollbackBuffer.lineWithSequenceNumber(scrollbackRowNumber));
+	}
+	
+	//! Returns either the oldest scrollback line, or the topmost
+	//! main screen line when the scrollback is empty.
+	My_ScreenBufferLine&
+	firstLine ()
+	{
+		return (scrollbackBuffer.empty() || (currentBufferType == kBufferTargetScreen))
+				? *(screenBuffer.front())
+				: *(scrollbackBuffer.oldest());
+	}
+	
+	//! Increments the internal line pointer so that currentLine() now
+	//! refers to the next line in the scrollback or screen buffer, as
+	//! appropriate.  Returns a reference to the new currentLine().
+	//! If the returned line is the last valid line, "isEnd" is set to
+	//! true; otherwise, it is set to false.  The initial value of
+	//! "isEnd" is ignored.
+	My_ScreenBufferLine&
+	goToNextLine	(Boolean&	isEnd)
+	{
+		isEnd = false;
+		if (currentBufferType == kBufferTargetScrollback)
+		{
+			if (scrollbackBuffer.empty() || (scrollbackRowNumber >= scrollbackBuffer.returnSequenceNumber(0)))
+			{
+				// change the iterator to look at the screen buffer instead
+				currentBufferType = kBufferTargetScreen;
+				screenRowIterator = screenBuffer.begin();
+			}
+			else
+			{
+				// newer scrollback lines have higher sequence numbers
+				++scrollbackRowNumber;
+			}
+		}
+		else if (*screenRowIterator != &lastLine())
+		{
+			++screenRowIterator;
+		}
+		else
+		{
+			isEnd = true;
+		}
+		return currentLine();
+	}
+	
+	//! Decrements the internal line pointer so that currentLine() now
+	//! refers to the previous line in the scrollback or screen buffer,
+	//! as appropriate.  Returns a reference to the new currentLine().
+	//! If the returned line is the first valid line, "isEnd" is set to
+	//! true; otherwise, it is set to false.  The initial value of
+	//! "isEnd" is ignored.
+	My_ScreenBufferLine&
+	goToPreviousLine	(Boolean&	isEnd)
+	{
+		isEnd = false;
+		if (currentBufferType == kBufferTargetScreen)
+		{
+			if (screenBuffer.begin() != screenRowIterator)
+			{
+				--screenRowIterator;
+			}
+			else if (false == scrollbackBuffer.empty())
+			{
+				// change the iterator to look at the scrollback buffer instead
+				currentBufferType = kBufferTargetScrollback;
+				scrollbackRowNumber = scrollbackBuffer.returnSequenceNumber(0);
+			}
+			else
+			{
+				isEnd = true;
+			}
+		}
+		else if (scrollbackBuffer.isValidSequenceNumber(scrollbackRowNumber - 1))
+		{
+			// older scrollback lines have lower sequence numbers
+			--scrollbackRowNumber;
+		}
+		else
+		{
+			isEnd = true;
+		}
+		return currentLine();
+	}
+	
+	//! Returns false if the constructor claims to have initialized this
+	//! data in a block of memory that is on the stack.
+	Boolean
+	isHeapAllocated ()
+	{
+		return heapAllocated;
+	}
+	
+	//! Returns the bottommost main screen line.
+	My_ScreenBufferLine&
+	lastLine ()
+	{
+		return *(screenBuffer.back());
+	}
+
+private:
+	My_ScreenBufferLineList&				screenBuffer;			//!< the other possible source for the current line
+	My_ScrollbackBuffer&					scrollbackBuffer;		//!< one possible source for the current line
+	My_ScreenBufferLineList::iterator		screenRowIterator;		//!< the current line when "kBufferTargetScreen"
+	My_ScrollbackBuffer::SequenceNumber		scrollbackRowNumber;	//!< the current line when "kBufferTargetScrollback"
+	BufferTarget							currentBufferType : 2;	//!< whether or not the screen is being targeted
+	Boolean									heapAllocated : 1;		//!< an annoying extra use of memory for this flag...
 };
+STATIC_ASSERT(sizeof(Terminal_LineStackStorage) == sizeof(My_LineIterator),
+				assert_My_LineIterator_size_equals_Terminal_LineRefStackStorage);
 
-/*!
-A lightweight terminal implementation, suitable ONLY as a
-pre-callback.  Implements certain basic features of XTerm,
-such as colors and window title changes, that can be safely
-superimposed onto other emulators like the VT100.  The state
-determinant and transition routines automatically use the
-My_Emulator class’ supportsVariant() method to determine if
-a particular XTerm sequence should be handled; otherwise,
-the sequences are ignored.  In addition, any more advanced
-sequences from XTerm are always ignored.
+typedef My_LineIterator*	My_LineIteratorPtr;
 
-NOTE:	Almost all of XTerm is ignored by this class.  See
-		the class "My_XTerm" for the full emulator.
+/*!
+Represents the state of a terminal emulator, such as any
+parameters collected and any pending operations.
 */
-class My_XTermCore
+struct My_Emulator
 {
 public:
-	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
-	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
+	//! Variants allow emulators to be tweaked so that the
+	//! behavior is non-standard in some way.  They can also
+	//! allow memory or runtime optimizations when disabled.
+	typedef UInt8		VariantFlags;
+	enum
+	{
+		kVariantFlagsNone				= 0,
+		kVariantFlag24BitColor			= (1 << 0),		//!< corresponds to kPreferences_TagTerminal24BitColorEnabled
+		kVariantFlagXTerm256Color		= (1 << 1),		//!< corresponds to kPreferences_TagXTerm256ColorsEnabled
+		kVariantFlagXTermAlterWindow	= (1 << 2),		//!< corresponds to kPreferences_TagXTermWindowAlterationEnabled
+		kVariantFlagXTermBCE			= (1 << 3),		//!< corresponds to kPreferences_TagXTermBackgroundColorEraseEnabled
+		kVariantFlagSixelGraphics		= (1 << 4),		//!< corresponds to kPreferences_TagSixelGraphicsEnabled
+		kVariantFlagITermGraphics		= (1 << 5),		//!< corresponds to kPreferences_TagITermGraphicsEnabled
+	};
 	
-	enum State
+	struct Callbacks
 	{
-		// Ideally these are "protected", but loop evasion code requires them.
-		kStateSWIT				= kMy_ParserStateSeenESCRightSqBracket0,				//!< subsequent string is for window title and icon title
-		kStateSWITAcquireStr	= kMy_ParserStateSeenESCRightSqBracket0Semi,			//!< seen ESC]0, gathering characters of string
-		kStateSIT				= kMy_ParserStateSeenESCRightSqBracket1,				//!< subsequent string is for icon title only
-		kStateSITAcquireStr		= kMy_ParserStateSeenESCRightSqBracket1Semi,			//!< seen ESC]1, gathering characters of string
-		kStateSWT				= kMy_ParserStateSeenESCRightSqBracket2,				//!< subsequent string is for window title only
-		kStateSWTAcquireStr		= kMy_ParserStateSeenESCRightSqBracket2Semi,			//!< seen ESC]2, gathering characters of string
-		kStateSetColor			= kMy_ParserStateSeenESCRightSqBracket4,				//!< subsequent string is a color specification
-		kStateColorAcquireStr	= kMy_ParserStateSeenESCRightSqBracket4Semi,			//!< seen ESC]4, gathering characters of string
+	public:
+		Callbacks	();
+		Callbacks	(My_EmulatorEchoDataProcPtr,
+					 My_EmulatorStateDeterminantProcPtr,
+					 My_EmulatorStateTransitionProcPtr,
+					 My_EmulatorResetProcPtr);
+		
+		Boolean
+		exist () const;
+		
+		My_EmulatorEchoDataProcPtr			dataWriter;				//!< translates data and dumps it to the screen
+		My_EmulatorResetProcPtr				resetHandler;			//!< handles a soft or hard reset; varies based on the emulator
+		My_EmulatorStateDeterminantProcPtr	stateDeterminant;		//!< figures out what the next state should be
+		My_EmulatorStateTransitionProcPtr	transitionHandler;		//!< handles new parser states, driving the terminal; varies based on the emulator
 	};
-};
-
-/*!
-Thread context passed to threadForTerminalSearch().
-*/
-struct My_SearchThreadContext
-{
-	My_ScreenBufferPtr							screenBufferPtr; // the terminal being searched
-	std::vector< Terminal_RangeDescription >*	matchesVectorPtr;
-	CFStringRef									queryCFString;
-	CFOptionFlags								searchFlags; // for CFStringCreateArrayWithFindResults()
-	NSRegularExpressionOptions					regExOptions; // for NSRegularExpression calls
-	Boolean										isRegularExpression; // perform non-literal pattern match
-	UInt16										threadNumber; // thread 0 searches the screen, thread N searches every Nth scrollback line
-	My_ScreenBufferLineList::const_iterator		rangeStart; // buffer offset (into screen if thread 0, otherwise scrollback)
-	SInt32										startRowIndex; // index of the line pointed to by "rangeStart"
-	UInt32										rowCount; // number of lines from buffer offset to search
-};
-typedef My_SearchThreadContext*			My_SearchThreadContextPtr;
-typedef My_SearchThreadContext const*	My_SearchThreadContextConstPtr;
-
-} // anonymous namespace
-
-#pragma mark Internal Method Prototypes
-namespace {
-
-void						assertScrollingRegion					(My_ScreenBufferPtr);
-void						bufferEraseCursorLine					(My_ScreenBufferPtr, My_BufferChanges);
-void						bufferEraseFromCursorColumn				(My_ScreenBufferPtr, My_BufferChanges, UInt16);
-void						bufferEraseFromCursorColumnToLineEnd	(My_ScreenBufferPtr, My_BufferChanges);
-void						bufferEraseFromCursorToEnd				(My_ScreenBufferPtr, My_BufferChanges);
-void						bufferEraseFromHomeToCursor				(My_ScreenBufferPtr, My_BufferChanges);
-void						bufferEraseFromLineBeginToCursorColumn  (My_ScreenBufferPtr, My_BufferChanges);
-void						bufferEraseLineWithoutUpdate			(My_ScreenBufferPtr, My_BufferChanges, My_ScreenBufferLine&);
-void						bufferEraseRange						(My_ScreenBufferPtr, Boolean, My_ScreenBufferLine&, My_CellBoundary);
-void						bufferEraseVisibleScreen				(My_ScreenBufferPtr, My_BufferChanges);
-void						bufferInsertBlankLines					(My_ScreenBufferPtr, UInt16,
-																	 My_ScreenBufferLineList::iterator&,
-																	 My_AttributeRule);
-void						bufferInsertBlanksAtCursorColumnWithoutUpdate	(My_ScreenBufferPtr, SInt16, My_AttributeRule);
-void						bufferInsertInlineImageWithoutUpdate	(My_ScreenBufferPtr, NSImage*, UInt16, UInt16, UInt16, UInt16, Boolean, Boolean);
-void						bufferLineFill							(My_ScreenBufferPtr, My_ScreenBufferLine&, CFStringRef,
-																	 TextAttributes_Object = TextAttributes_Object(),
-																	 Boolean = true);
-void						bufferRemoveCharactersAtCursorColumn	(My_ScreenBufferPtr, SInt16, My_AttributeRule);
-void						bufferRemoveLines						(My_ScreenBufferPtr, UInt16,
-																	 My_ScreenBufferLineList::iterator&,
-																	 My_AttributeRule);
-void						changeLineAttributes					(My_ScreenBufferPtr, My_ScreenBufferLine&,
-																	 TextAttributes_Object, TextAttributes_Object);
-void						changeLineGlobalAttributes				(My_ScreenBufferPtr, My_ScreenBufferLine&,
-																	 TextAttributes_Object, TextAttributes_Object);
-void						changeLineRangeAttributes				(My_ScreenBufferPtr, My_ScreenBufferLine&, UInt16,
-																	 SInt16, TextAttributes_Object, TextAttributes_Object);
-void						changeNotifyForTerminal					(My_ScreenBufferConstPtr, Terminal_Change, void*);
-My_ScreenBufferLinePtr		createLinePtr							();
-void						cursorRestore							(My_ScreenBufferPtr);
-void						cursorSave								(My_ScreenBufferPtr);
-void						cursorWrapIfNecessaryGetLocation		(My_ScreenBufferPtr, SInt16*, My_ScreenRowIndex*);
-Boolean						defineBitmap							(My_ScreenBufferPtr, NSImage*, NSRect, TextAttributes_BitmapID&);
-Boolean						defineTrueColor							(My_ScreenBufferPtr, UInt8, UInt8, UInt8, TextAttributes_TrueColorID&);
-void						deleteLinePtr							(My_ScreenBufferLinePtr&);
-void						echoCFString							(My_ScreenBufferPtr, CFStringRef);
-void						eraseRightHalfOfLine					(My_ScreenBufferPtr, My_ScreenBufferLine&);
-inline My_LineIteratorPtr	getLineIterator							(Terminal_LineRef);
-void						getParametersFromStringAccumulator		(My_ScreenBufferPtr, ParameterDecoder_StateMachine&,
-																	 std::basic_string< UInt8 >::const_iterator&);
-void						getParametersFromStringRange			(std::basic_string< UInt8 >::const_iterator, std::basic_string< UInt8 >::const_iterator,
-																	 ParameterDecoder_StateMachine&, std::basic_string< UInt8 >::const_iterator&);
-My_ScreenBufferPtr			getVirtualScreenData					(TerminalScreenRef);
-void						highlightLED							(My_ScreenBufferPtr, SInt16);
-My_StringByPointer			initCallbackIDsByFuncPtr				();
-void						locateCursorLine						(My_ScreenBufferPtr, My_ScreenBufferLineList::iterator&);
-void						locateScrollingRegion					(My_ScreenBufferPtr, My_ScreenBufferLineList::iterator&,
-																	 My_ScreenBufferLineList::iterator&);
-void						locateScrollingRegionTop				(My_ScreenBufferPtr, My_ScreenBufferLineList::iterator&);
-void						moveCursor								(My_ScreenBufferPtr, SInt16, My_ScreenRowIndex);
-void						moveCursorDown							(My_ScreenBufferPtr);
-void						moveCursorDownOrScroll					(My_ScreenBufferPtr);
-void						moveCursorDownToEdge					(My_ScreenBufferPtr);
-void						moveCursorLeft							(My_ScreenBufferPtr);
-void						moveCursorLeftToEdge					(My_ScreenBufferPtr);
-void						moveCursorLeftToHalf					(My_ScreenBufferPtr);
-void						moveCursorLeftToNextTabStop				(My_ScreenBufferPtr);
-void						moveCursorRight							(My_ScreenBufferPtr);
-void						moveCursorRightToEdge					(My_ScreenBufferPtr);
-void						moveCursorRightToNextTabStop			(My_ScreenBufferPtr);
-void						moveCursorUpToEdge						(My_ScreenBufferPtr);
-void						moveCursorUp							(My_ScreenBufferPtr);
-void						moveCursorUpOrScroll					(My_ScreenBufferPtr);
-void						moveCursorX								(My_ScreenBufferPtr, SInt16);
-void						moveCursorY								(My_ScreenBufferPtr, My_ScreenRowIndex);
-void						resetTerminal							(My_ScreenBufferPtr, Boolean = false);
-SessionRef					returnListeningSession					(My_ScreenBufferPtr);
-Boolean						screenCopyLinesToScrollback				(My_ScreenBufferPtr);
-Boolean						screenInsertNewLines					(My_ScreenBufferPtr, My_ScreenBufferLineList::size_type);
-Boolean						screenMoveLinesToScrollback				(My_ScreenBufferPtr, My_ScreenBufferLineList::size_type);
-void						screenScroll							(My_ScreenBufferPtr, SInt16 = 1);
-void						setCursorVisible						(My_ScreenBufferPtr, Boolean);
-void						setScrollbackSize						(My_ScreenBufferPtr, UInt32);
-Terminal_Result				setVisibleColumnCount					(My_ScreenBufferPtr, UInt16);
-Terminal_Result				setVisibleRowCount						(My_ScreenBufferPtr, UInt16);
-CFStringRef					stringByStrippingEndWhitespace			(CFStringRef);
-// IMPORTANT: Attribute bit manipulation is fully described in "TextAttributes.h".
-//            Changes must be kept consistent everywhere.  See below, for usage.
-inline TextAttributes_Object	styleOfVTParameter					(UInt16	inPs)
-{
-	return TextAttributes_Object(1 << (inPs - 1));
-}
-void						tabStopClearAll							(My_ScreenBufferPtr);
-UInt16						tabStopGetDistanceFromCursor			(My_ScreenBufferConstPtr, Boolean);
-void						tabStopInitialize						(My_ScreenBufferPtr);
-void*						threadForTerminalSearch					(void*);
-void						translateCell							(My_ScreenBufferPtr, My_ScreenBufferLinePtr&, StringUtilities_Cell, CFStringRef, TextAttributes_Object);
-
-} // anonymous namespace
-
-#pragma mark Variables
-namespace {
-
-My_StringByPointer&				gCallbackIDsByFuncPtr ()	{ static My_StringByPointer x = initCallbackIDsByFuncPtr(); return x; }
-My_PrintableByUniChar&			gDumbTerminalRenderings ()	{ static My_PrintableByUniChar x; return x; }
-My_ScreenReferenceLocker&		gScreenRefLocks ()			{ static My_ScreenReferenceLocker x; return x; }
-My_RefTracker&					gTerminalScreenValidRefs ()	{ static My_RefTracker x; return x; }
-
-} // anonymous namespace
+	
+	typedef std::vector< Callbacks >	VariantChain;
+	typedef std::vector< SInt16 >		ParameterList;
+	
+	My_Emulator		(Emulation_FullType, CFStringRef, CFStringEncoding);
+	
+	~My_Emulator ();
+	
+	void
+	clearEscapeSequenceParameters ();
+	
+	void
+	initializeParserStateStack ();
+	
+	Boolean
+	is8BitReceiver ();
+	
+	Boolean
+	is8BitTransmitter ();
+	
+	UInt32
+	recentCodePoint ();
+	
+	void
+	reset	(Boolean);
+	
+	My_BufferChanges
+	returnEraseEffectsForNormalUse ();
+	
+	My_BufferChanges
+	returnEraseEffectsForSelectiveUse ();
+	
+	void
+	sendEscape	(SessionRef, void const*, size_t);
+	
+	void
+	set8BitReceive		(Boolean);
+	
+	void
+	set8BitTransmit		(Boolean);
+	
+	void
+	set8BitTransmitNever	();
+	
+	Boolean
+	supportsVariant		(VariantFlags);
+	
+	Emulation_FullType					primaryType;			//!< VT100, VT220, etc.
+	Boolean								isUTF8Encoding;			//!< the emulator is using the UTF-8 encoding, and should ignore any specific sequences
+																//!  that would change character sets in other ways (such as those defined for a VT220); in
+																//!  addition, the data stream is decoded as UTF-8 BEFORE it is searched for any control
+																//!  sequences, instead of being decoded in the echo-data phase; WARNING: do not assign this
+																//!  flag casually, it is usually only correct to use Session APIs to change the text encoding
+	Boolean								lockUTF8;				//!< set if UTF-8 should be set permanently, ignoring any sequences to switch it back until
+																//!  a full reset occurs
+	Boolean								disableShifts;			//!< prevents shift-in, shift-out, and any related old-style character set mechanism from working;
+																//!  usually this should be set only when a Unicode encoding is present (which is large enough to
+																//!  support all characters, making alternate sets unnecessary), but it is a separate state anyway
+	CFStringEncoding					inputTextEncoding;		//!< specifies the encoding used by the input data stream
+	CFRetainRelease						answerBackCFString;		//!< similar to "primaryType", but can be an arbitrary string
+	UInt64								stateRepetitions;		//!< to guard against looping; counts repetitions of same state
+	My_ParserState						currentState;			//!< state the terminal input parser is in now
+	My_ParserState						stringAccumulatorState;	//!< state that was in effect when the "stringAccumulator" was recently cleared
+	std::basic_string< UInt8 >			stringAccumulator;		//!< used to gather characters for such things as XTerm window changes
+	My_EmulatorPayloadBlock __strong	payloadHandler;			//!< if not nil, receives the "stringAccumulator" in pieces as the string arrives
+																//!  (instead of waiting for the whole string); see streamStringAccumulator()
+	UTF8Decoder_StateMachine			multiByteDecoder;		//!< as individual bytes are processed, this tracks complete or invalid sequences
+	UInt8								recentCodePointByte;	//!< for 8-bit encodings, the most recent byte read; see also "multiByteDecoder"
+	Boolean								addedITerm;				//!< keep track of previous requests to install the same variant
+	Boolean								addedSixel;				//!< keep track of previous requests to install the same variant
+	Boolean								addedXTerm;				//!< since multiple variants reuse these callbacks, only insert them once
+	Boolean								allowSixelScrolling;	//!< whether or not the screen scrolls when a Sixel cursor goes past the bottom
+	SInt16								argLastIndex;			//!< zero-based last parameter position in the "values" array
+	ParameterList						argList;				//!< all values provided for the current escape sequence
+	ParameterList						parameterMarkList;		//!< this list has the same size as "argList"; in parallel with "argList", it sets only two values:
+																//!  -1 to indicate that a parameter is finished (the typical case) or 0 to indicate that it is just
+																//!  a colon-separated sub-parameter; in cases like SGR, this is used to track related values
+	VariantChain						preCallbackSet;			//!< state determinant/transition callbacks invoked ahead of normal callbacks, to allow tweaks;
+																//!  a pre-callback set’s echo and reset callbacks are never used and should be nullptr; in
+																//!  addition, “normal” emulator callbacks CANNOT be used as pre-callbacks because they will
+																//!  absorb too many actions, so every pre-callback must be ITS OWN CLASS and be lightweight
+	Callbacks							currentCallbacks;		//!< emulator-type-specific handlers to drive the state machine
+	Callbacks							pushedCallbacks;		//!< for emulators that can switch modes, the previous set of callbacks
+	VariantFlags						supportedVariants;		//!< tags identifying minor features, e.g. 256-color support
+	My_TrueColorIDByComponentKey		trueColorIDsByRGB;		//!< maps RGB elements to their table index value (ID), if any
+	My_RGBComponentList*				trueColorTableReds;		//!< red components for all 24-bit colors; allocated only for supporting terminals
+	My_RGBComponentList*				trueColorTableGreens;	//!< green components for all 24-bit colors; allocated only for supporting terminals
+	My_RGBComponentList*				trueColorTableBlues;	//!< blue components for all 24-bit colors; allocated only for supporting terminals
+	TextAttributes_TrueColorID			trueColorTableNextID;	//!< basis for new IDs; current entry for storing new colors in true-color table
+	std::set< ImageStore_ImageID >		retainedImages;			//!< every image that cells of this terminal may display (retained once each;
+																//!  see releaseUnusedImages())
 
+protected:
+	My_EmulatorEchoDataProcPtr
+	returnDataWriter	(Emulation_FullType);
+	
+	My_EmulatorResetProcPtr
+	returnResetHandler		(Emulation_FullType);
+	
+	My_EmulatorStateDeterminantProcPtr
+	returnStateDeterminant		(Emulation_FullType);
+	
+	My_EmulatorStateTransitionProcPtr
+	returnStateTransitionHandler	(Emulation_FullType);
 
+private:
+	Boolean								eightBitReceiver;		//!< if true, equivalent 8-bit codes should be recognized by the emulator’s state determinant
+																//!  (for example, in a VT100, the 7-bit ESC-[ sequence is equivalent to the 8-bit code 155)
+	Boolean								eightBitTransmitter;	//!< if true, any sequences returned to the listening session should use 8-bit codes only
+	Boolean								lockSevenBitTransmit;	//!< if true, the emulator can never be set to 8-bit; useful in weird emulation corner cases
+};
+typedef My_Emulator*	My_EmulatorPtr;
 
-#pragma mark Public Methods
+typedef MemoryBlockReferenceTracker< TerminalScreenRef >	My_RefTracker;
+typedef Registrar< TerminalScreenRef, My_RefTracker >		My_RefRegistrar;
 
 /*!
-Creates a new terminal screen and initial view according
-to the given specifications.
-
-Version 3.0 is designed so that a terminal screen buffer
-can have multiple views, or vice-versa (a view can display
-the contents of multiple buffers).  Therefore, although a
-single buffer and view is created by this routine, more
-could be constructed later.
-
-\retval kTerminal_ResultOK
-if the screen was created successfully
-
-\retval kTerminal_ResultParameterError
-if any of the given storage pointers are nullptr
-
-\retval kTerminal_ResultNotEnoughMemory
-if there is a serious problem creating the screen
+One row of a Terminal_Snapshot: copies of the text and the
+attributes of a main screen line at the time it was last
+changed.  Rows are never modified after construction, so
+any number of snapshots may share them.
+*/
+struct My_SnapshotRow
+{
+	My_SnapshotRow	(My_ScreenBufferLine const&, UInt64);
+	
+	CFRetainRelease					textCFString;		//!< immutable copy of the text of the line
+	TerminalLine_AttributeRunList	attributeRuns;		//!< copy of the style runs of the line
+	TextAttributes_Object			globalAttributes;	//!< copy of the attributes that apply to the whole line
+	UInt64							version;			//!< snapshot version in which this copy was made
+};
+typedef std::shared_ptr< My_SnapshotRow const >		My_SnapshotRowPtr;
+typedef std::vector< My_SnapshotRowPtr >			My_SnapshotRowList;
 
-(3.0)
+/*!
+Keeps the most recently published snapshot of a screen and
+the set of main screen rows that have changed since then,
+so that the next snapshot only copies those rows (see
+Terminal_PublishSnapshot()).  Rows are marked by the same
+change notifications that views use to redraw, and by any
+change to attributes (such as highlighting); when the
+whole screen scrolls, rows that only moved are shared with
+the previous snapshot instead of being copied again.
 */
-Terminal_Result
-Terminal_NewScreen	(Preferences_ContextRef		inTerminalConfig,
-					 Preferences_ContextRef		inTranslationConfig,
-					 TerminalScreenRef*			outScreenPtr)
+struct My_SnapshotPublisher
 {
-	Terminal_Result		result = kTerminal_ResultOK;
+	My_SnapshotPublisher ();
 	
+	void
+	markAllRowsChanged ();
 	
-	if (outScreenPtr == nullptr) result = kTerminal_ResultParameterError;
-	else
+	void
+	markRowsChanged		(SInt64, SInt64);
+	
+	void
+	moveRows	(SInt64);
+	
+	enum : SInt32
 	{
-		*outScreenPtr = nullptr;
-		
-		try
-		{
-			*outScreenPtr = REINTERPRET_CAST(new My_ScreenBuffer(inTerminalConfig, inTranslationConfig), TerminalScreenRef);
-		}
-		catch (std::bad_alloc)
-		{
-			result = kTerminal_ResultNotEnoughMemory;
-			*outScreenPtr = nullptr;
-		}
-		catch (Terminal_Result		inConstructionError)
-		{
-			result = inConstructionError;
-			*outScreenPtr = nullptr;
-		}
-		
-		if (*outScreenPtr != nullptr)
-		{
-			// successfully created; set initial retain-count to 1
-			Terminal_RetainScreen(*outScreenPtr);
-		}
-	}
+		kChangedRow = -1	//!< value in "sourceRows" for a row that must be copied
+	};
 	
-	return result;
-}// NewScreen
-
-
-/*!
-Adds a lock on the specified reference.  This indicates you
-are using the screen, so attempts by anyone else to delete
-the screen with Terminal_ReleaseScreen() will fail until you
-release your lock (and everyone else releases locks they
-may have).
-
-(4.1)
-*/
-void
-Terminal_RetainScreen	(TerminalScreenRef	inRef)
-{
-	gScreenRefLocks().acquireLock(inRef);
-}// RetainScreen
-
-
-/*!
-Releases one lock on the specified screen created with
-Terminal_NewScreen() and deletes the screen *if* no other
-locks remain.  Your copy of the reference is set to
-nullptr.
-
-(4.1)
-*/
-void
-Terminal_ReleaseScreen	(TerminalScreenRef*		inoutRefPtr)
-{
-	gScreenRefLocks().releaseLock(*inoutRefPtr);
-	unless (gScreenRefLocks().isLocked(*inoutRefPtr))
-	{
-		My_ScreenBufferPtr		ptr = getVirtualScreenData(*inoutRefPtr);
-		
-		
-		delete ptr;
-	}
-	*inoutRefPtr = nullptr;
-}// ReleaseScreen
-
-
-/*!
-Creates a special reference to the given line of the given
-terminal screen’s VISIBLE SCREEN buffer, or returns nullptr
-if the line is out of range or the iterator cannot be created
-for some other reason.
-
-Pass 0 to indicate you want the very topmost line (that is,
-the one that would be added to the scrollback buffer first if
-the screen scrolls), or larger values to ask for lines below
-it.  Currently, this routine takes linearly more time to
-figure out where the bottommost lines are.
-
-A main line iterator can be advanced using negative numbers
-to go backwards, and if this is done often enough, it will
-automatically enter the scrollback buffer (as if the iterator
-were constructed with Terminal_NewScrollbackLineIterator()).
-
-IMPORTANT:	An iterator is completely invalid once the
-			screen it was created for has been destroyed.
+	std::vector< SInt32 >	sourceRows;			//!< for each main screen row, the row of "latestSnapshot" that has the
+												//!  same contents (usually the same row), or "kChangedRow"
+	Boolean					allRowsChanged;		//!< if true, "sourceRows" is ignored and every row is copied
+	UInt64					versionCounter;		//!< most recent version number given to a snapshot
+	Terminal_SnapshotPtr	latestSnapshot;		//!< may be empty; the snapshot returned until rows change again
+	UInt64					publishCount;		//!< number of snapshots created (for debugging)
+	UInt64					rowCopyCount;		//!< number of rows copied into all snapshots (for debugging)
+};
 
-(3.0)
-*/
-Terminal_LineRef
-Terminal_NewMainScreenLineIterator	(TerminalScreenRef				inRef,
-									 UInt16							inLineNumberZeroForTop,
-									 Terminal_LineStackStorage*		inStackAllocationOrNull)
+struct My_ScreenBuffer
 {
-	Terminal_LineRef		result = nullptr;
-	My_ScreenBufferPtr		ptr = getVirtualScreenData(inRef);
+public:
+	My_ScreenBuffer	(Preferences_ContextRef, Preferences_ContextRef);
+	~My_ScreenBuffer ();
 	
+	static void
+	preferenceChanged	(ListenerModel_Ref, ListenerModel_Event, void*, void*);
 	
-	if (false == Terminal_IsValid(inRef))
-	{
-		Console_Warning(Console_WriteValueAddress, "attempt to construct iterator from invalid reference", inRef);
-	}
-	else if (nullptr != ptr)
-	{
-		// ensure the specified row is in range
-		if (inLineNumberZeroForTop < ptr->screenBuffer.size())
-		{
-			auto	startIterator = ptr->screenBuffer.begin();
-			
-			
-			std::advance(startIterator, STATIC_CAST(inLineNumberZeroForTop,
-													My_ScreenBufferLineList::difference_type));
-			if (nullptr != inStackAllocationOrNull)
-			{
-				new (inStackAllocationOrNull) My_LineIterator(false/* heap allocated */,
-																ptr->screenBuffer, ptr->scrollbackBuffer,
-																startIterator,
-																My_LineIterator::kScreenBufferDesignator);
-				result = REINTERPRET_CAST(inStackAllocationOrNull, Terminal_LineRef);
-			}
-			else
-			{
-				try
-				{
-					My_LineIteratorPtr		iteratorPtr = new My_LineIterator
-																(true/* heap allocated */,
-																	ptr->screenBuffer, ptr->scrollbackBuffer,
-																	startIterator,
-																	My_LineIterator::kScreenBufferDesignator);
-					
-					
-					if (nullptr != iteratorPtr)
-					{
-						result = REINTERPRET_CAST(iteratorPtr, Terminal_LineRef);
-					}
-				}
-				catch (std::bad_alloc)
-				{
-					result = nullptr;
-				}
-			}
-		}
-	}
-	return result;
-}// NewMainScreenLineIterator
-
-
-/*!
-Creates a special reference to the given line of the given
-terminal screen’s SCROLLBACK buffer, or returns nullptr if
-the line is out of range or the iterator cannot be created
-for some other reason.
-
-Pass 0 to indicate you want the very newest line (that is,
-the one that most recently scrolled off the top of the main
-screen), or larger values to ask for older lines.  Currently,
-this routine takes linearly more time to figure out where
-old scrollback lines are.
-
-A scrollback line iterator can be advanced often enough to
-automatically enter the main screen buffer (as if the iterator
-were constructed with NewMainScreenLineIterator()).
-
-IMPORTANT:	An iterator is completely invalid once the screen
-			it was created for has been destroyed.  It can
-			also be invalidated in other ways, e.g. a call to
-			Terminal_DeleteAllSavedLines().
-
-(3.0)
-*/
-Terminal_LineRef
-Terminal_NewScrollbackLineIterator	(TerminalScreenRef				inRef,
-									 UInt64							inLineNumberZeroForNewest,
-									 Terminal_LineStackStorage*		inStackAllocationOrNull)
-{
-	Terminal_LineRef		result = nullptr;
-	My_ScreenBufferPtr		ptr = getVirtualScreenData(inRef);
+	void
+	printingEnd		(Boolean = true);
 	
+	void
+	printingReset ();
 	
-	if ((nullptr != ptr) && (ptr->scrollbackBuffer.begin() != ptr->scrollbackBuffer.end()))
-	{
-		My_ScrollbackBufferLineList::difference_type const		kLineEnd = inLineNumberZeroForNewest;
-		auto		startIterator = ptr->scrollbackBuffer.begin();
-		Boolean		validIterator = true;
-		
-		
-		// ensure the specified row is in range; since the scrollback buffer is
-		// a linked list, it would be prohibitively expensive to ask for its size,
-		// so instead the iterator is incremented while watching for the end
-		for (My_ScrollbackBufferLineList::difference_type i = 0; i < kLineEnd; ++i)
-		{
-			++startIterator;
-			if (startIterator == ptr->scrollbackBuffer.end())
-			{
-				validIterator = false;
-				break;
-			}
-		}
-		
-		if (validIterator)
-		{
-			if (nullptr != inStackAllocationOrNull)
-			{
-				new (inStackAllocationOrNull) My_LineIterator(false/* heap allocated */,
-																ptr->screenBuffer, ptr->scrollbackBuffer,
-																startIterator);
-				result = REINTERPRET_CAST(inStackAllocationOrNull, Terminal_LineRef);
-			}
-			else
-			{
-				try
-				{
-					My_LineIteratorPtr		iteratorPtr = new My_LineIterator
-																(true/* heap allocated */,
-																	ptr->screenBuffer, ptr->scrollbackBuffer,
-																	startIterator);
-					
-					
-					if (nullptr != iteratorPtr)
-					{
-						result = REINTERPRET_CAST(iteratorPtr, Terminal_LineRef);
-					}
-				}
-				catch (std::bad_alloc)
-				{
-					result = nullptr;
-				}
-			}
-		}
-	}
-	return result;
-}// NewScrollbackLineIterator
-
-
-/*!
-Destroys an iterator created with Terminal_NewLineIterator(),
-and sets your copy of the reference to nullptr.
-
-Note that no actual memory is deallocated by this call if
-stack storage was used to construct the iterator, although
-your copy of the reference is still nullified.
-
-(3.0)
-*/
-void
-Terminal_DisposeLineIterator	(Terminal_LineRef*		inoutRefPtr)
-{
-	if (nullptr != inoutRefPtr)
-	{
-		My_LineIteratorPtr		ptr = getLineIterator(*inoutRefPtr);
-		
-		
-		if (nullptr != ptr)
-		{
-			if (ptr->isHeapAllocated())
-			{
-				delete ptr;
-			}
-			*inoutRefPtr = nullptr;
-		}
-	}
-}// DisposeLineIterator
-
-
-/*!
-Returns "true" only if the given terminal’s bell is
-active.  An inactive bell completely ignores all
-bell signals - without giving any audible or visible
-indication that a bell has occurred.  This can be
-useful if you know you’ve just triggered a long string
-of bells and don’t want to be annoyed by a series of
-beeps or flashes.
-
-(3.0)
-*/
-Boolean
-Terminal_BellIsEnabled		(TerminalScreenRef	inRef)
-{
-	My_ScreenBufferPtr	dataPtr = getVirtualScreenData(inRef);
-	Boolean				result = false;
+	Boolean
+	return24BitColor	(Preferences_ContextRef);
 	
+	CFStringRef
+	returnAnswerBackMessage		(Preferences_ContextRef);
 	
-	if (dataPtr != nullptr)
-	{
-		result = !dataPtr->bellDisabled;
-	}
-	return result;
-}// BellIsEnabled
-
-
-/*!
-Returns the bitmap image representation for the given ID,
-which is defined (usually along with several other bitmaps)
-if bitmap terminal sequences are received.  The ID may be
-used in more than one place.
-
-The bitmap is meant to have a resolution suitable for
-rendering within a single default-sized character cell,
-with no surrounding space except any defined by the pixels
-of the image itself.  It is considered read-only at this
-stage; anything that normally overwrites a terminal cell’s
-attributes may clear the cell’s bitmaps however.
-
-The returned image can be shared by many bitmap IDs but a
-particular sub-rectangle of the image is also given to
-specify the portion of the image that the ID represents.
-
-Note that since the entire image is available from any ID
-associated with any part of that image, user operations
-that depend on a whole image are easier to implement (for
-example, a contextual menu click or drag on a particular
-terminal cell).
-
-The TextAttributes_Object type can be used to extract the
-TextAttributes_BitmapID value for a section of text, and
-to determine what a bitmap is for.
-
-\retval kTerminal_ResultOK
-if no error occurred
-
-\retval kTerminal_ResultInvalidID
-if the specified screen reference is invalid
-
-\retval kTerminal_ResultParameterError
-if the specified ID is not valid
-
-\retval kTerminal_ResultUnsupported
-if the specified terminal was not configured for bitmaps
-
-(2017.11)
-*/
-Terminal_Result
-Terminal_BitmapGetFromID	(TerminalScreenRef			inRef,
-							 TextAttributes_BitmapID	inID,
-							 CGRect&					outImageSubRect,
-							 NSImage*&					outCompleteImage)
-{
-	Terminal_Result		result = kTerminal_ResultOK;
-	My_ScreenBufferPtr	dataPtr = getVirtualScreenData(inRef);
+	Emulation_FullType
+	returnEmulator		(Preferences_ContextRef);
 	
+	Boolean
+	returnForceSave		(Preferences_ContextRef);
 	
-	outImageSubRect = CGRectZero; // initially...
-	outCompleteImage = nil; // initially...
+	Boolean
+	returnITermGraphics		(Preferences_ContextRef);
 	
-	if (nullptr == dataPtr)
-	{
-		result = kTerminal_ResultInvalidID;
-	}
-	else
-	{
-		if ((nil == dataPtr->emulator.bitmapSegmentTable) ||
-			(inID >= dataPtr->emulator.bitmapSegmentTable.count))
-		{
-			result = kTerminal_ResultParameterError;
-		}
-		else
-		{
-			id			anObject = [dataPtr->emulator.bitmapSegmentTable objectAtIndex:inID];
-			assert([anObject isKindOfClass:NSValue.class]); 
-			NSValue*	rectValue = STATIC_CAST(anObject, NSValue*);
-			NSRect		aRect = [rectValue rectValue];
-			
-			
-			outImageSubRect = CGRectMake(aRect.origin.x, aRect.origin.y, NSWidth(aRect), NSHeight(aRect));
-		}
-		
-		if ((nil == dataPtr->emulator.bitmapImageTable) ||
-			(inID >= dataPtr->emulator.bitmapImageTable.count))
-		{
-			result = kTerminal_ResultParameterError;
-		}
-		else
-		{
-			outCompleteImage = [dataPtr->emulator.bitmapImageTable objectAtIndex:inID];
-		}
-	}
+	Session_LineEnding
+	returnLineEndings ();
 	
-	return result;
-}// BitmapGetFromID
-
-
-/*!
-Applies the specified changes to every single attribute
-for a single line of the screen buffer (no effect on
-the display until the next redraw). Also updates the
-“current” attributes, if the cursor happens to be on
-the specified line.
-
-The row value may be negative, signifying a scrollback
-buffer row.
-
-Equivalent to invoking Terminal_ChangeLineRangeAttributes()
-with a range from first column to last column.
-
-You can use this to apply effects intended to be global
-to a line, like double-sized text.
-
-\retval kTerminal_ResultOK
-if the line attributes were changed successfully
-
-\retval kTerminal_ResultInvalidID
-if the specified screen reference is invalid
-
-\retval kTerminal_ResultInvalidIterator
-if the specified row reference is invalid
-
-(3.0)
-*/
-Terminal_Result
-Terminal_ChangeLineAttributes	(TerminalScreenRef			inRef,
-								 Terminal_LineRef			inRow,
-								 TextAttributes_Object		inSetTheseAttributes,
-								 TextAttributes_Object		inClearTheseAttributes)
-{
-	Terminal_Result			result = kTerminal_ResultOK;
-	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
-	My_LineIteratorPtr		iteratorPtr = getLineIterator(inRow);
+	UInt16
+	returnScreenColumns		(Preferences_ContextRef, Boolean = true);
 	
+	UInt16
+	returnScreenRows		(Preferences_ContextRef, Boolean = true);
 	
-	if (dataPtr == nullptr) result = kTerminal_ResultInvalidID;
-	else if (iteratorPtr == nullptr) result = kTerminal_ResultInvalidIterator;
-	else
-	{
-		changeLineAttributes(dataPtr, iteratorPtr->currentLine(), inSetTheseAttributes, inClearTheseAttributes);
-	}
+	UInt32
+	returnScrollbackRows	(Preferences_ContextRef, Boolean = true);
 	
-	return result;
-}// ChangeLineAttributes
-
-
-/*!
-Applies the specified changes to every single attribute
-in the specified column range of the specified line
-screen buffer (no effect on the display until the next
-redraw).  Also updates the “current” attributes, if the
-cursor happens to be in the specified range.
-
-The row value may be negative, signifying a scrollback
-buffer row.
-
-Equivalent to invoking Terminal_ChangeRangeAttributes()
-with the same start and end rows.
-
-You can use this to apply effects intended to be applied
-to a series of characters on a line, like text coloring.
-
-\retval kTerminal_ResultOK
-if the line range attributes were changed successfully
-
-\retval kTerminal_ResultInvalidID
-if the specified screen reference is invalid
-
-\retval kTerminal_ResultInvalidIterator
-if the specified row reference is invalid
-
-(3.0)
-*/
-Terminal_Result
-Terminal_ChangeLineRangeAttributes	(TerminalScreenRef			inRef,
-									 Terminal_LineRef			inRow,
-									 UInt16						inZeroBasedStartColumn,
-									 SInt16						inZeroBasedPastTheEndColumnOrNegativeForLastColumn,
-									 TextAttributes_Object		inSetTheseAttributes,
-									 TextAttributes_Object		inClearTheseAttributes)
-{
-	Terminal_Result			result = kTerminal_ResultOK;
-	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
-	My_LineIteratorPtr		iteratorPtr = getLineIterator(inRow);
+	Boolean
+	returnScrollbackSearchIndex		(Preferences_ContextRef);
 	
+	Boolean
+	returnSixelGraphics		(Preferences_ContextRef);
 	
-	if (dataPtr == nullptr) result = kTerminal_ResultInvalidID;
-	else if (iteratorPtr == nullptr) result = kTerminal_ResultInvalidIterator;
-	else
-	{
-		changeLineRangeAttributes(dataPtr, iteratorPtr->currentLine(), inZeroBasedStartColumn,
-									inZeroBasedPastTheEndColumnOrNegativeForLastColumn,
-									inSetTheseAttributes, inClearTheseAttributes);
-	}
+	CFStringEncoding
+	returnTextEncoding		(Preferences_ContextRef);
 	
-	return result;
-}// ChangeLineRangeAttributes
-
-
-/*!
-Applies the specified changes to every single attribute
-within the specified range of the screen buffer (no
-effect on the display until the next redraw).  Also
-updates the “current” attributes, if the cursor happens
-to be in the specified range.
-
-The anchor points are automatically “sorted”, so despite
-their names it does not matter which point really marks
-the start or end of the range.
-
-If "inConstrainToRectangle" is true, the range is
-considered to be exact so no columns outside the range
-are filled in (normally, all lines in between the start
-and end points are filled completely, from column 0 to
-the last column).
-
-You can use this to apply effects to a large number of
-characters at once (e.g. when highlighting).
-
-\retval kTerminal_ResultOK
-if the range attributes were changed successfully
-
-\retval kTerminal_ResultInvalidID
-if the specified screen reference is invalid
-
-\retval kTerminal_ResultInvalidIterator
-if the specified row reference is invalid
-
-(3.0)
-*/
-Terminal_Result
-Terminal_ChangeRangeAttributes	(TerminalScreenRef			inRef,
-								 Terminal_LineRef			inStartRow,
-								 UInt32						inNumberOfRowsToConsider,
-								 UInt16						inZeroBasedStartColumn,
-								 UInt16						inZeroBasedPastTheEndColumn,
-								 Boolean					inConstrainToRectangle,
-								 TextAttributes_Object		inSetTheseAttributes,
-								 TextAttributes_Object		inClearTheseAttributes)
-{
-	Terminal_Result			result = kTerminal_ResultOK;
-	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
-	My_LineIteratorPtr		iteratorPtr = getLineIterator(inStartRow);
+	Boolean
+	returnXTerm256	(Preferences_ContextRef);
 	
+	Boolean
+	returnXTermBackgroundColorErase		(Preferences_ContextRef);
 	
-	// force anchors to be within valid screen boundaries
-	if (inZeroBasedStartColumn >= dataPtr->text.visibleScreen.numberOfColumnsPermitted)
-	{
-		inZeroBasedStartColumn = dataPtr->text.visibleScreen.numberOfColumnsPermitted - 1;
-	}
-	if (inZeroBasedPastTheEndColumn > dataPtr->text.visibleScreen.numberOfColumnsPermitted)
-	{
-		inZeroBasedPastTheEndColumn = dataPtr->text.visibleScreen.numberOfColumnsPermitted;
-	}
+	UInt16
+	returnXTermPatchLevel	(Preferences_ContextRef, Boolean = true);
 	
-	if (inNumberOfRowsToConsider > 0)
-	{
-		// now apply changes to attributes of all specified cells, and to
-		// the “current” attributes (if the cursor is anywhere in the range)
-		if (nullptr == dataPtr) result = kTerminal_ResultInvalidID;
-		else if (nullptr == iteratorPtr) result = kTerminal_ResultInvalidIterator;
-		else
+	Boolean
+	returnXTermWindowAlteration		(Preferences_ContextRef);
+	
+	My_RefRegistrar						refValidator;				//!< ensures this reference is recognized as a valid one
+	Preferences_ContextWrap				configuration;
+	My_Emulator							emulator;					//!< handles all parsing of the data stream
+	SessionRef							listeningSession;			//!< may be nullptr; the currently attached session, where certain terminal reports are sent
+	
+	TerminalSpeaker_Ref					speaker;					//!< object that emits sound based on this terminal data;
+																	//!  TEMPORARY: the speaker REALLY shouldn’t be part of the terminal data model!
+	CFRetainRelease						windowTitleCFString;		//!< stores the string that the terminal considers its window title
+	CFRetainRelease						iconTitleCFString;			//!< stores the string that the terminal considers its icon title
+	
+	ListenerModel_Ref					changeListenerModel;		//!< registry of listeners for various terminal events
+	ListenerModel_ListenerWrap			preferenceMonitor;			//!< listener for changes to preferences that affect a particular screen
+	
+	TerminalLine_Allocator				lineAllocator;				//!< source of every line of "scrollbackBuffer" and "screenBuffer" (so it is
+																	//!  declared first, as it must outlive them)
+	My_ScrollbackBuffer					scrollbackBuffer;			//!< all of the scrollback text for the terminal; IMPORTANT: row zero is the
+																	//!  scrollback line CLOSEST to the top (FRONT) of the screen buffer; imagine
+																	//!  both buffers starting at the home line and growing away from one another
+	My_ScreenBufferLineList				screenBuffer;				//!< all of the visible text for the terminal;
+																	//!  IMPORTANT: ONLY modify the screen buffer using screen...() routines!
+	My_SnapshotPublisher				snapshotPublisher;			//!< read-only copies of "screenBuffer" for drawing
+	My_ByteString						bytesToEcho;				//!< captures contiguous blocks of text to be translated and echoed
+	My_UniCharList						echoUniChars;				//!< reusable storage for text decoded from "bytesToEcho" by echoBytesDirectly(),
+																	//!  or copied from strings by echoCFString()
+	My_VoidPtrList						debugStateHandlerSequence;	//!< used only when logging is enabled; cleared at each state transition, tracks
+																	//!  handlers that are invoked during the processing of the transition
+	
+	// Error Counts
+	//
+	// Certain classes of error are exceptional, but when they occur
+	// they may occur very often (e.g. extremely bad input data that
+	// continues to cause errors until it is cleared out).
+	//
+	// To avoid the spam and resulting slowdown of logging these
+	// cases, error counts are used: incremented as errors occur,
+	// and decremented when a periodic handler discovers new errors
+	// (except for the total, which is never reset).
+	UInt32								echoErrorCount;				//!< echo errors occur when a stream of exceptionally bad data arrives (e.g.
+																	//!  someone dumps binary data)
+	UInt32								translationErrorCount;		//!< translation errors typically occur when the text encoding assumed either
+																	//!  by the user or the running process is not actually used by some data; if
+																	//!  enough of these are accumulated, the user could actually be prompted to
+																	//!  reconsider the chosen translation table for the session
+	UInt32								errorCountTotal;			//!< used to eventually fire "kTerminal_ChangeExcessiveErrors", if things have
+																	//!  become just ridiculous
+	
+	My_TabStopList						tabSettings;				//!< array of characters representing tab stops; values are either kMy_TabClear
+																	//!  (for most columns), or kMy_TabSet at tab columns
+	
+	StreamCapture_Ref					captureStream;				//!< used to stream data to a file chosen by the user
+	StreamCapture_Ref					printingStream;				//!< used to stream data to a temporary file for later printing
+	CFRetainRelease						printingFileURL;			//!< URL of the temporary printing file
+	UInt8								printingModes;				//!< MC private (VT102): true only if terminal-rendered lines are also sent to the printer
+	Boolean								bellDisabled;				//!< if true, all bell signals are completely ignored (no audio or visual)
+	Terminal_CursorType					cursorType;					//!< cursor shape (from viewpoint of program running in terminal)
+	Boolean								cursorBlinking;				//!< if true, cursor is set to blink (from viewpoint of program running in terminal)
+	Boolean								cursorVisible;				//!< if true, cursor state is visible (as opposed to invisible); see also DECTCEM
+	Boolean								reverseVideo;				//!< if true, foreground and background colors are swapped when rendering
+	Boolean								windowMinimized;			//!< if true, the window has been *flagged* as being iconified; since this is only
+																	//!  a data model, this only means that a terminal sequence has told the window to
+																	//!  become iconified; synchronizing this flag with the actual window state is the
+																	//!  responsibility of the Terminal Window module
+	
+	My_CharacterSetInfo					vtG0;						//!< the G0 character set
+	My_CharacterSetInfo					vtG1;						//!< the G1 character set
+	My_CharacterSetInfo					vtG2;						//!< the G2 character set
+	My_CharacterSetInfo					vtG3;						//!< the G3 character set
+	
+	My_RowColumnBoundary				visibleBoundary;			//!< rows and columns forming the perimeter of the buffer’s “visible” region
+	My_RowBoundary						customScrollingRegion;		//!< region that is in effect when margin set sequence is received; updated only
+																	//!  when a terminal sequence to change margins is received
+	
+	struct
+	{
+		struct
 		{
-			Boolean const		kSingleLineRange = (1 == inNumberOfRowsToConsider);
+			My_ScreenRowIndex	numberOfRowsPermitted;  //!< maximum lines of scrollback specified by the user
+														//!  (NOTE: this is inflexible; cooler scrollback handling schemes are limited by it...)
+			Boolean				enabled;				//!< true if scrolled lines should be appended to the buffer automatically
+			Boolean				reflowScheduled;		//!< true if scrollbackReflowLines() will run again soon
+		} scrollback;
+		
+		struct
+		{
+			UInt16				numberOfColumnsAllocated;	//!< how many characters per line are currently taking up memory (this only
+															//!  grows, and lines being changed are enlarged to match); it follows that
+															//!  this is the maximum possible value for "numberOfColumnsPermitted"
+			UInt16				numberOfColumnsPermitted;	//!< maximum columns per line specified by the user; but see current.returnNumberOfColumnsPermitted()
+		} visibleScreen;
+	} text;
+	
+	struct
+	{
+		pthread_rwlock_t		lock;				//!< held by chunks of background searches while they read the buffer; the main
+													//!  thread holds it for writing except while waiting for events (see
+													//!  backgroundSearchBegin())
+		UInt16					count;				//!< number of searches from Terminal_SearchInBackground() that have not ended
+		std::atomic< UInt32 >	invalidationCount;	//!< incremented whenever rows are rearranged, which stops background searches
+		My_ByteString			deferredInput;		//!< data received while background searches run, processed when they end
+	} backgroundSearch;
+	
+	My_LEDBits							litLEDs;					//!< highlighted states of terminal LEDs (lights)
+	
+	Boolean								passwordMode;				//!< when last checked, terminal device of process was not echoing (password prompt)
+	Boolean								mayNeedToSaveToScrollback;	//!< if true, the cursor has moved to the home position, and therefore
+																	//!  a subsequent attempt to erase to the end of the line or screen
+																	//!  should cause the data to be copied to the scrollback first (that is,
+																	//!  of course, if the force-save flag is also set)
+	Boolean								saveToScrollbackOnClear;	//!< if true, the entire screen contents are saved to the scrollback
+																	//!  buffer just before being explicitly erased with a clear command
+	
+	Boolean								reportOnlyOnRequest;		//!< DECREQTPARM mode: determines response format and timing
+	Boolean								wrapPending;				//!< set only when a character is echoed in final column
+	
+	Boolean								modeANSIEnabled;			//!< DECANM mode: true only if in ANSI mode (as opposed to VT52 compatibility
+																	//!  mode); if the former, parameters are only recognized following the CSI
+																	//!  sequence, but if the latter, ESC-character sequences are allowed instead
+	Boolean								modeApplicationKeys;		//!< DECKPAM mode: true only if the keypad is in application mode
+	Boolean								modeAutoWrap;				//!< DECAWM mode: true only if line wrapping is automatic
+	Boolean								modeBracketedPaste;			//!< true only if “bracketed Paste” was enabled (DEC private code 2004)
+	Boolean								modeCursorKeysForApp;		//!< DECCKM mode: true only if the keypad should not act as cursor movement arrows
+																	//!  (note also that the VT100 manual states this setting has no effect unless
+																	//!  the terminal is also in ANSI mode and the keypad is in application mode
+	Boolean								modeInsertNotReplace;		//!< IRM mode: if true, new characters overwrite the cursor position, otherwise
+																	//!  they first shift existing text over by one before appearing
+	Boolean								modeNewLineOption;			//!< LNM mode: if true, a line feed causes the cursor to move to the start of
+																	//!  the next line, and a Return generates a CR LF sequence; if false, the
+																	//!  line feed is just vertical movement of the cursor, and Return is just CR
+	Boolean								modeOriginRedefined;		//!< DECOM mode: true only if the origin has been moved from its default place
+																	//!  (in which case, various subsequent terminal operations must be relative to
+																	//!  the origin instead of the home position)
+	UInt16								reportedPatchLevel;			//!< for XTerm; how to respond to Secondary Device Attributes
+	My_RowBoundary*						originRegionPtr;			//!< automatically set to the boundaries appropriate for the current origin mode;
+																	//!  this should always be preferred when restricting the cursor, and as an offset
+																	//!  when returning column or row numbers
+	
+    struct
+	{
+		Terminal_SpeechMode		mode;	//!< restrictions on when the computer may speak
+	} speech;
+	
+	struct CurrentLineCache
+	{
+		CurrentLineCache	(struct My_ScreenBuffer const&		inParent)
+		:
+		parent(inParent),
+		cursorAttributes(),
+		drawingAttributes(),
+		cursorX(0),
+		cursorY(0),
+		characterSetInfoPtr(nullptr)
+		{
+		}
+		
+		UInt16
+		returnNumberOfColumnsPermitted ()
+		const
+		{
+			UInt16		result = parent.text.visibleScreen.numberOfColumnsPermitted;
 			
 			
-			// figure out how to treat the first line
-			if (kSingleLineRange)
-			{
-				// same line - iterate only over certain columns
-				changeLineRangeAttributes(dataPtr, iteratorPtr->currentLine(), inZeroBasedStartColumn, inZeroBasedPastTheEndColumn,
-											inSetTheseAttributes, inClearTheseAttributes);
-			}
-			else
+			if (this->cursorAttributes.hasDoubleAny())
 			{
-				// multi-line range; start by creating some convenient anchors that
-				// are set correctly based on the rectangular/non-rectangular mode
-				UInt16		lineStartColumn = (inConstrainToRectangle)
-												? inZeroBasedStartColumn
-												: 0;
-				SInt16		linePastTheEndColumn = (inConstrainToRectangle)
-													? inZeroBasedPastTheEndColumn
-													: dataPtr->text.visibleScreen.numberOfColumnsPermitted;
-				Boolean		isEnd = false;
-				
-				
-				// fill in first line
-				changeLineRangeAttributes(dataPtr, iteratorPtr->currentLine(), inZeroBasedStartColumn, linePastTheEndColumn,
-											inSetTheseAttributes, inClearTheseAttributes);
-				iteratorPtr->goToNextLine(isEnd);
-				
-				if (false == isEnd)
-				{
-					// fill in remaining lines; the last line is special
-					// because it will end “early” at the end anchor
-					{
-						SInt16			i = 0;
-						SInt32 const	kLineEnd = (inNumberOfRowsToConsider - 1);
-						
-						
-						for (i = 0; i < kLineEnd; ++i, iteratorPtr->goToNextLine(isEnd))
-						{
-							if (isEnd)
-							{
-								//Console_Warning(Console_WriteLine, "exceeded row boundaries when changing attributes of a range");
-								break;
-							}
-							
-							// intermediate lines occupy the whole range; the last line
-							// only occupies up to the final anchor point
-							if (i < (kLineEnd - 1))
-							{
-								// fill in intermediate line
-								changeLineRangeAttributes(dataPtr, iteratorPtr->currentLine(), lineStartColumn, linePastTheEndColumn,
-															inSetTheseAttributes, inClearTheseAttributes);
-							}
-							else
-							{
-								// fill in last line
-								changeLineRangeAttributes(dataPtr, iteratorPtr->currentLine(), lineStartColumn, inZeroBasedPastTheEndColumn,
-															inSetTheseAttributes, inClearTheseAttributes);
-							}
-						}
-					}
-				}
+				result = STATIC_CAST(INTEGER_DIV_2(result), UInt16);
 			}
+			return result;
 		}
-	}
+		
+		struct My_ScreenBuffer const&	parent;
+		TextAttributes_Object			cursorAttributes;		//!< text attributes for the position under the cursor; useful for rendering the cursor
+																//!  in a way that does not clash with these attributes (e.g. by choosing opposite colors)
+		TextAttributes_Object			drawingAttributes;		//!< text attributes for the line the cursor is on; these should be updated as the cursor
+																//!  moves, or as terminal sequences are processed by the emulator
+		TextAttributes_Object			latentAttributes;		//!< used to implement Background Color Erase; records the most recent attribute settings
+																//!  (currently for background color bits ONLY, this is NOT properly updated for other
+																//!  attribute changes)
+		SInt16							cursorX;				//!< column number of current cursor position;
+																//!  WARNING: do not change this value except with a moveCursor...() routine
+		My_ScreenRowIndex				cursorY;				//!< row number of current cursor position;
+																//!  WARNING: do not change this value except with a moveCursor...() routine
+		My_CharacterSetInfoPtr			characterSetInfoPtr;	//!< pointer to either G0 or G1 character rules, whichever is active
+	} current;
 	
-	return result;
-}// ChangeRangeAttributes
+	struct
+	{
+		TextAttributes_Object		drawingAttributes;	//!< previous bits of corresponding bits in "current" structure
+		SInt16						cursorX;			//!< previous value of corresponding value in "current" structure
+		My_ScreenRowIndex			cursorY;			//!< previous value of corresponding value in "current" structure
+	} previous;
+	
+	TerminalScreenRef		selfRef;					//!< opaque reference that would resolve to a pointer to this structure
+};
+typedef My_ScreenBuffer*			My_ScreenBufferPtr;
+typedef My_ScreenBuffer const*		My_ScreenBufferConstPtr;
 
+typedef MemoryBlockReferenceLocker< TerminalScreenRef, My_ScreenBuffer >	My_ScreenReferenceLocker;
 
 /*!
-Returns the title assigned to the iconified version of this
-terminal.  In MacTerm this is symbolic, as no assumption is
-made that a terminal corresponds to a single minimized window;
-the exact usage of the “icon title” is not decided by this
-module.
-
-IMPORTANT:	You must eventually use CFRelease() on the returned
-			title string.
-
-(3.0)
+Manages state determination and transition for conditions
+that no emulator knows how to deal with.  Also used to
+handle extremely common things like echoing printable
+characters.
 */
-void
-Terminal_CopyTitleForIcon	(TerminalScreenRef	inRef,
-							 CFStringRef&		outTitle)
+class My_DefaultEmulator
 {
-	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
-	
-	
-	outTitle = dataPtr->iconTitleCFString.returnCFStringRef();
-	if (outTitle != nullptr)
-	{
-		CFRetain(outTitle);
-	}
-}// CopyTitleForIcon
-
-
-/*!
-Returns the title assigned to the window of this terminal.  In
-MacTerm this is symbolic, as no assumption is made that a
-terminal corresponds to a single window; the exact usage of the
-“window title” is not decided by this module.
-
-IMPORTANT:	You must eventually use CFRelease() on the returned
-			title string.
-
-(3.0)
-*/
-void
-Terminal_CopyTitleForWindow		(TerminalScreenRef	inRef,
-								 CFStringRef&		outTitle)
-{
-	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
-	
-	
-	outTitle = dataPtr->windowTitleCFString.returnCFStringRef();
-	if (outTitle != nullptr)
-	{
-		CFRetain(outTitle);
-	}
-}// CopyTitleForWindow
-
+public:
+	static UInt32	echoData			(My_ScreenBufferPtr, UInt8 const*, UInt32);
+	static void		hardSoftReset		(My_EmulatorPtr, Boolean);
+	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
+	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
+};
 
 /*!
-Returns the zero-based column and line numbers of the
-terminal cursor in the given buffer.  Since the cursor
-is not allowed to enter the scrollback buffer, negative
-return values are not possible.
-
-Pass nullptr for one of the values if you do not want it.
-
-\retval kTerminal_ResultOK
-if no error occurred
-
-\retval kTerminal_ResultInvalidID
-if the specified screen reference is invalid
-
-(3.0)
+Manages state determination and transition for a terminal
+that does nothing but echo human-readable versions of every
+character it receives.
 */
-Terminal_Result
-Terminal_CursorGetLocation	(TerminalScreenRef		inRef,
-							 UInt16*				outZeroBasedColumnPtr,
-							 UInt16*				outZeroBasedRowPtr)
+class My_DumbTerminal
 {
-	Terminal_Result				result = kTerminal_ResultOK;
-	My_ScreenBufferConstPtr		dataPtr = getVirtualScreenData(inRef);
-	
-	
-	if (dataPtr == nullptr) result = kTerminal_ResultInvalidID;
-	else
-	{
-		if (outZeroBasedColumnPtr != nullptr) *outZeroBasedColumnPtr = dataPtr->current.cursorX;
-		if (outZeroBasedRowPtr != nullptr) *outZeroBasedRowPtr = STATIC_CAST(dataPtr->current.cursorY, UInt16);
-	}
-	
-	return result;
-}// CursorGetLocation
-
+public:
+	static UInt32	echoData			(My_ScreenBufferPtr, UInt8 const*, UInt32);
+	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
+	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
+};
 
 /*!
-Returns "true" only if the terminal cursor is supposed
-to be visible in the specified screen buffer.  This is
-a logical state ONLY, and is set by interaction with the
-terminal emulator.  It is only guaranteed to correspond
-to a rendered cursor by virtue of the callback framework
-that links Terminal Views to screen buffers.
-
-(3.0)
+A lightweight terminal implementation, suitable ONLY as a
+pre-callback.  Implements custom iTerm2 sequences.
 */
-Boolean
-Terminal_CursorIsVisible	(TerminalScreenRef		inRef)
+class My_ITermCore
 {
-	Boolean						result = false;
-	My_ScreenBufferConstPtr		dataPtr = getVirtualScreenData(inRef);
-	
+public:
+	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
+	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
 	
-	if (nullptr != dataPtr)
+	enum State
 	{
-		result = dataPtr->cursorVisible;
-	}
-	return result;
-}// CursorIsVisible
+		// Ideally these are "protected", but loop evasion code requires them.
+		kStateITermCustomBegin		= kMy_ParserStateSeenESCRightSqBracket1337Semi,	//!< saw custom iTerm2 ESC]1337; sequence
+		kStateITermAcquireStr		= 'iAcS',							//!< continuously copy iTerm2 data string
+		kStateITermStringTerminator	= kMy_ParserStateSeenControlG		//!< end of custom data stream
+	};
 
+protected:
+	static void		beginFileStream		(My_ScreenBufferPtr);
+};
 
 /*!
-Provides all the text attributes of the position currently
-occupied by the cursor.
-
-NOTE:	Admittedly this is a bit of a weird exception (since
-		all other style information is returned as part of a
-		Terminal_ForEachLikeAttributeRun() loop) but the
-		cursor is rendered at unusual times and has a special
-		appearance.
-
-(4.0)
+A lightweight terminal implementation, suitable ONLY as a
+pre-callback.  Implements the Sixel graphics sequences.
 */
-TextAttributes_Object
-Terminal_CursorReturnAttributes		(TerminalScreenRef		inRef)
+class My_SixelCore
 {
-	My_ScreenBufferPtr			dataPtr = getVirtualScreenData(inRef);
-	TextAttributes_Object		result = dataPtr->current.cursorAttributes;
-	
-	
-	return result;
-}// CursorReturnAttributes
+public:
+	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
+	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
 
+protected:
+	static void		beginImageStream	(My_ScreenBufferPtr);
+	static void		finishImageStream	(My_ScreenBufferPtr, SixelDecoder_Stream&, ImageStore_ContentKey const&);
+};
 
 /*!
-Writes arbitrary debugging information to the console for the
-specified terminal screen.
-
-(4.0)
+A lightweight terminal implementation, suitable ONLY as a
+pre-callback.  Implements sequences that are unique to the
+UTF-8 encoding (Unicode).
 */
-void
-Terminal_DebugDumpDetailedSnapshot		(TerminalScreenRef		inRef)
+class My_UTF8Core
 {
-	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
-	
-	
-	Console_WriteValuePair("Visible boundary first and last columns", dataPtr->visibleBoundary.firstColumn,
-																		dataPtr->visibleBoundary.lastColumn);
-	Console_WriteValuePair("Visible boundary first and last rows", dataPtr->visibleBoundary.rows.firstRow,
-																	dataPtr->visibleBoundary.rows.lastRow);
-	Console_WriteValuePair("Defined scrolling region first and last rows", dataPtr->customScrollingRegion.firstRow,
-																			dataPtr->customScrollingRegion.lastRow);
-	Console_WriteValuePair("Current scrolling region first and last rows", dataPtr->originRegionPtr->firstRow,
-																			dataPtr->originRegionPtr->lastRow);
-	Console_WriteValue("Mode: ANSI", dataPtr->modeANSIEnabled);
-	Console_WriteValue("Mode: auto-wrap", dataPtr->modeAutoWrap);
-	Console_WriteValue("Mode: bracketed Paste", dataPtr->modeBracketedPaste);
-	Console_WriteValue("Mode: cursor keys for application", dataPtr->modeCursorKeysForApp);
-	Console_WriteValue("Mode: application keys", dataPtr->modeApplicationKeys);
-	Console_WriteValue("Mode: origin redefined", dataPtr->modeOriginRedefined);
-	Console_WriteValue("Mode: insert, not replace", dataPtr->modeInsertNotReplace);
-	Console_WriteValue("Mode: new-line option", dataPtr->modeNewLineOption);
-	Console_WriteValue("Emulator UTF-8 mode", dataPtr->emulator.isUTF8Encoding);
-	Console_WriteValue("Emulator UTF-8 locked", dataPtr->emulator.lockUTF8);
-	Console_WriteValue("Emulator ignores requests to shift character sets", dataPtr->emulator.disableShifts);
-	Console_WriteValue("Emulator accepts 8-bit and 7-bit codes", dataPtr->emulator.is8BitReceiver());
-	Console_WriteValue("Emulator transmits 8-bit codes", dataPtr->emulator.is8BitTransmitter());
-	Console_WriteValueBitFlags("Drawing attributes: current, upper 32 bits", dataPtr->current.drawingAttributes.returnValueInRange(TextAttributes_Object::BitRange(0xFFFFFFFF, 32)));
-	Console_WriteValueBitFlags("Drawing attributes: current, lower 32 bits", dataPtr->current.drawingAttributes.returnValueInRange(TextAttributes_Object::BitRange(0xFFFFFFFF, 0)));
-	// INCOMPLETE - could put just about anything here, whatever is interesting to know
-}// DebugDumpDetailedSnapshot
+public:
+	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
+	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
 
+protected:
+	enum State
+	{
+		// Ideally these are "protected", but loop evasion code requires them.
+		kStateUTF8OnUnspecifiedImpl		= kMy_ParserStateSeenESCPercentG,		//!< switch to UTF-8, allow return to normal mode; unspecified behavior
+		kStateUTF8Off					= kMy_ParserStateSeenESCPercentAt,		//!< disable UTF-8, return to ordinary emulator character set behavior
+		kStateToUTF8Level1				= kMy_ParserStateSeenESCPercentSlashG,	//!< switch to UTF-8 level 1; cannot switch back
+		kStateToUTF8Level2				= kMy_ParserStateSeenESCPercentSlashH,	//!< switch to UTF-8 level 2; cannot switch back
+		kStateToUTF8Level3				= kMy_ParserStateSeenESCPercentSlashI,	//!< switch to UTF-8 level 3; cannot switch back
+	};
+};
 
 /*!
-Destroys all scrollback buffer lines.  The “visible”
-lines are not affected.  This obviously invalidates any
-iterators pointing to scrollback lines.
-
-It follows that after invoking this routine, the return
-value of Terminal_ReturnInvisibleRowCount() should be zero.
-
-This triggers two events: "kTerminal_ChangeScrollActivity"
-to indicate that data has been removed, and also
-"kkTerminal_ChangeTextRemoved" (given a range consisting of
-all previous scrollback lines).
-
-(3.1)
+Manages state determination and transition for the VT100
+terminal emulator while in ANSI mode.  The VT52 subclass
+handles sequences specific to VT52 mode.
 */
-void
-Terminal_DeleteAllSavedLines	(TerminalScreenRef		inRef)
+class My_VT100
 {
-	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+public:
+	static void				hardSoftReset		(My_EmulatorPtr, Boolean);
+	static My_ParserState	returnCSINextState	(My_ParserState, UnicodeScalarValue, Boolean&);
+	static UInt32			stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
+	static UInt32			stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
 	
+	static void		alignmentDisplay			(My_ScreenBufferPtr);
+	static void		ansiMode					(My_ScreenBufferPtr);
+	static void		cursorBackward				(My_ScreenBufferPtr);
+	static void		cursorDown					(My_ScreenBufferPtr);
+	static void		cursorForward				(My_ScreenBufferPtr);
+	static void		cursorUp					(My_ScreenBufferPtr);
+	static void		deviceAttributes			(My_ScreenBufferPtr);
+	static void		deviceStatusReport			(My_ScreenBufferPtr);
+	static void		eraseInDisplay				(My_ScreenBufferPtr);
+	static void		eraseInLine					(My_ScreenBufferPtr);
+	static void		loadLEDs					(My_ScreenBufferPtr);
+	static void		modeSetReset				(My_ScreenBufferPtr, Boolean);
+	static void		reportTerminalParameters	(My_ScreenBufferPtr);
+	static void		setTopAndBottomMargins		(My_ScreenBufferPtr);
+	static void		vt52Mode					(My_ScreenBufferPtr);
 	
-	if (dataPtr != nullptr)
+	class VT52
 	{
-		SInt16 const	kPreviousScrollbackCount = STATIC_CAST(dataPtr->scrollbackBufferCachedSize, SInt16);
-		
+		friend class My_VT100;
 		
-		dataPtr->scrollbackBuffer.clear();
-		dataPtr->scrollbackBufferCachedSize = 0;
+	public:
+		static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
+		static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
 		
-		// notify listeners of the range of text that has gone away
+		static void		cursorBackward		(My_ScreenBufferPtr);
+		static void		cursorDown			(My_ScreenBufferPtr);
+		static void		cursorForward		(My_ScreenBufferPtr);
+		static void		cursorUp			(My_ScreenBufferPtr);
+		static void		identify			(My_ScreenBufferPtr);
+	
+	protected:
+		// The names of these constants use the same mnemonics from
+		// the programming manual of the original terminal.
+		enum State
 		{
-			Terminal_RangeDescription	range;
-			
-			
-			range.screen = dataPtr->selfRef;
-			range.firstRow = -kPreviousScrollbackCount;
-			range.firstColumn = 0;
-			range.columnCount = dataPtr->text.visibleScreen.numberOfColumnsPermitted;
-			range.rowCount = kPreviousScrollbackCount;
-			
-			changeNotifyForTerminal(dataPtr, kTerminal_ChangeTextRemoved, &range/* context */);
-		}
+			// VT100 sequences in VT52 compatibility mode (in the order they appear in the manual) - see VT100 manual for full details
+			kStateCU		= kMy_ParserStateSeenESCA,				//!< cursor up
+			kStateCD		= kMy_ParserStateSeenESCB,				//!< cursor down
+			kStateCR 		= kMy_ParserStateSeenESCC,				//!< cursor right
+			kStateCL 		= kMy_ParserStateSeenESCD,				//!< cursor left
+			kStateNGM		= kMy_ParserStateSeenESCF,				//!< enter graphics mode
+			kStateXGM		= kMy_ParserStateSeenESCG,				//!< exit graphics mode
+			kStateCH		= kMy_ParserStateSeenESCH,				//!< cursor home
+			kStateRLF		= kMy_ParserStateSeenESCI,				//!< reverse line feed
+			kStateEES		= kMy_ParserStateSeenESCJ,				//!< erase to end of screen
+			kStateEEL		= kMy_ParserStateSeenESCK,				//!< erase to end of line
+			kStateDCA		= kMy_ParserStateSeenESCY,				//!< direct cursor address
+			kStateDCAY		= 'DCAY',								//!< direct cursor address, seen first follow-up character (Y)
+			kStateDCAX		= 'DCAX',								//!< direct cursor address, seen second follow-up character (X)
+			kStateID		= kMy_ParserStateSeenESCZ,				//!< identify terminal
+			kStateNAKM		= kMy_ParserStateSeenESCEquals,			//!< enter alternate keypad mode
+			kStateXAKM		= kMy_ParserStateSeenESCGreaterThan,	//!< exit alternate keypad mode
+			kStateANSI		= kMy_ParserStateSeenESCLessThan,		//!< enter ANSI mode
+		};
+	};
+	
+	// The names of these constants use the same mnemonics from
+	// the programming manual of the original terminal.
+	enum State
+	{
+		// VT100 immediates (in order of the corresponding control character’s ASCII code)
+		kStateControlENQ		= 'VAns',				//!< transmit answerback message
+		kStateControlBEL		= 'VBel',				//!< audio event
+		kStateControlBS			= 'VBks',				//!< move cursor left if possible
+		kStateControlHT			= 'VTab',				//!< move cursor right to tab stop, or margin
+		kStateControlLFVTFF		= 'VLnF',				//!< newline or line feed, depending on LNM
+		kStateControlCR			= 'VCRt',				//!< move cursor down and to left margin
+		kStateControlSO			= 'VShO',				//!< shift out to G1 character set
+		kStateControlSI			= 'VShI',				//!< shift in to G0 character set
+		kStateControlXON		= 'VXON',				//!< resume transmission
+		kStateControlXOFF		= 'VXOF',				//!< suspend transmission
+		kStateControlCANSUB		= 'VCAN',				//!< terminate control seq. with error char.
 		
-		// notify listeners that scroll activity has taken place,
-		// though technically no remaining lines have been affected
-		{
-			Terminal_ScrollDescription	scrollInfo;
-			
-			
-			bzero(&scrollInfo, sizeof(scrollInfo));
-			scrollInfo.screen = dataPtr->selfRef;
-			scrollInfo.rowDelta = 0;
-			changeNotifyForTerminal(dataPtr, kTerminal_ChangeScrollActivity, &scrollInfo/* context */);
-		}
-	}
-}// DeleteAllSavedLines
-
+		// VT100 sequences (in the order they appear in the manual) - see VT100 manual for full details
+		kStateCSI				= kMy_ParserStateSeenESCLeftSqBracket,	//!< control sequence inducer
+		kStateCSIParamDigit0	= 'PNm0',				//!< digit has been encountered; define or extend current numerical parameter value;
+		kStateCSIParamDigit1	= 'PNm1',				//!  IMPORTANT: the 10 digit state values must be defined consecutively, as the code uses a
+		kStateCSIParamDigit2	= 'PNm2',				//!  short-cut that relies on arithmetic...
+		kStateCSIParamDigit3	= 'PNm3',
+		kStateCSIParamDigit4	= 'PNm4',
+		kStateCSIParamDigit5	= 'PNm5',
+		kStateCSIParamDigit6	= 'PNm6',
+		kStateCSIParamDigit7	= 'PNm7',
+		kStateCSIParamDigit8	= 'PNm8',
+		kStateCSIParamDigit9	= 'PNm9',
+		kStateCSIParamDigitSub	= 'PNm:',				//!< end of sub-parameter (colons can appear more than once)
+		kStateCSIParameterEnd	= kMy_ParserStateSeenESCLeftSqBracketSemicolon,		//!< end of parameter (semicolons can appear more than once)
+		kStateCSIPrivate		= kMy_ParserStateSeenESCLeftSqBracketQuestionMark,	//!< parameter list prefixed by '?' to indicate a private sequence
+		kStateCUB				= kMy_ParserStateSeenESCLeftSqBracketParamsD,	//!< cursor backward
+		kStateCUD				= kMy_ParserStateSeenESCLeftSqBracketParamsB,	//!< cursor down
+		kStateCUF				= kMy_ParserStateSeenESCLeftSqBracketParamsC,	//!< cursor forward
+		kStateCUP				= kMy_ParserStateSeenESCLeftSqBracketParamsH,	//!< cursor position
+		kStateCUU				= kMy_ParserStateSeenESCLeftSqBracketParamsA,	//!< cursor up
+		kStateDA				= kMy_ParserStateSeenESCLeftSqBracketParamsc,	//!< device attributes
+		kStateDECALN			= kMy_ParserStateSeenESCPound8,			//!< screen alignment display
+		kStateDECANM			= 'VANM',				//!< ANSI/VT52 mode
+		kStateDECARM			= 'VARM',				//!< auto repeat mode
+		kStateDECAWM			= 'VAWM',				//!< auto wrap mode
+		kStateDECCKM			= 'VCKM',				//!< cursor keys mode
+		kStateDECCOLM			= 'VCLM',				//!< column mode
+		kStateDECDHLT			= kMy_ParserStateSeenESCPound3,			//!< double height line, top half
+		kStateDECDHLB			= kMy_ParserStateSeenESCPound4,			//!< double height line, bottom half
+		kStateDECDWL			= kMy_ParserStateSeenESCPound6,			//!< double width line
+		kStateDECID				= kMy_ParserStateSeenESCZ,				//!< identify terminal
+		kStateDECKPAM			= kMy_ParserStateSeenESCEquals,			//!< keypad application mode
+		kStateDECKPNM			= kMy_ParserStateSeenESCGreaterThan,	//!< keypad numeric mode
+		kStateDECLL				= kMy_ParserStateSeenESCLeftSqBracketParamsq,	//!< load LEDs (keyboard lights)
+		kStateDECOM				= 'VOM ',				//!< origin mode
+		kStateDECRC				= kMy_ParserStateSeenESC8,				//!< restore cursor
+		kStateDECREPTPARM		= 'VRPM',				//!< report terminal parameters
+		kStateDECREQTPARM		= kMy_ParserStateSeenESCLeftSqBracketParamsx,	//!< request terminal parameters
+		kStateDECSC				= kMy_ParserStateSeenESC7,				//!< save cursor
+		kStateDECSTBM			= kMy_ParserStateSeenESCLeftSqBracketParamsr,	//!< set top and bottom margins
+		kStateDECSWL			= kMy_ParserStateSeenESCPound5,			//!< single width line
+		kStateDECTST			= 'VTST',				//!< invoke confidence test
+		kStateDSR				= kMy_ParserStateSeenESCLeftSqBracketParamsn,	//!< device status report
+		kStateED 				= kMy_ParserStateSeenESCLeftSqBracketParamsJ,	//!< erase in display
+		kStateEL 				= kMy_ParserStateSeenESCLeftSqBracketParamsK,	//!< erase in line
+		kStateHTS				= kMy_ParserStateSeenESCH,				//!< horizontal tabulation set
+		kStateHVP				= kMy_ParserStateSeenESCLeftSqBracketParamsf,	//!< horizontal and vertical position
+		kStateIND				= kMy_ParserStateSeenESCD,				//!< index
+		kStateNEL				= kMy_ParserStateSeenESCE,				//!< next line
+		kStateRI				= kMy_ParserStateSeenESCM,				//!< reverse index
+		kStateRIS				= kMy_ParserStateSeenESCc,				//!< reset to initial state
+		kStateRM				= kMy_ParserStateSeenESCLeftSqBracketParamsl,	//!< reset mode
+		kStateSCSG0UK			= kMy_ParserStateSeenESCLeftParenA,		//!< select character set for G0, U.K.
+		kStateSCSG0ASCII		= kMy_ParserStateSeenESCLeftParenB,		//!< select character set for G0, ASCII
+		kStateSCSG0SG			= kMy_ParserStateSeenESCLeftParen0,		//!< select character set for G0, special graphics
+		kStateSCSG0ACRStd		= kMy_ParserStateSeenESCLeftParen1,		//!< select character set for G0, alternate character ROM standard set
+		kStateSCSG0ACRSG		= kMy_ParserStateSeenESCLeftParen2,		//!< select character set for G0, alternate character ROM special graphics
+		kStateSCSG1UK			= kMy_ParserStateSeenESCRightParenA,	//!< select character set for G0, U.K.
+		kStateSCSG1ASCII		= kMy_ParserStateSeenESCRightParenB,	//!< select character set for G0, ASCII
+		kStateSCSG1SG			= kMy_ParserStateSeenESCRightParen0,	//!< select character set for G0, special graphics
+		kStateSCSG1ACRStd		= kMy_ParserStateSeenESCRightParen1,	//!< select character set for G0, alternate character ROM standard set
+		kStateSCSG1ACRSG		= kMy_ParserStateSeenESCRightParen2,	//!< select character set for G0, alternate character ROM special graphics
+		kStateSGR				= kMy_ParserStateSeenESCLeftSqBracketParamsm,	//!< select graphic rendition
+		kStateSM				= kMy_ParserStateSeenESCLeftSqBracketParamsh,	//!< set mode
+		kStateTBC				= kMy_ParserStateSeenESCLeftSqBracketParamsg,	//!< tabulation clear
+		
+		// ANSI hacks that should be in their own emulator, but for now are not
+		kStateANSISC			= kMy_ParserStateSeenESCLeftSqBracketParamss,	//!< save cursor
+		kStateANSIRC			= kMy_ParserStateSeenESCLeftSqBracketParamsu,	//!< restore cursor
+	};
+};
 
 /*!
-Sends a stream of characters originating in a
-C-style string to the specified screen’s terminal
-emulator, interpreting escape sequences, etc.
-which may affect the terminal display.
-
-USE WITH CARE.  Generally, you send data to this
-routine that comes directly from a program that
-knows what it’s doing.  There are more elegant
-ways to have specific effects on terminal screens
-in an emulator-independent fashion; you should
-use those routines before hacking up a string as
-input to this routine.
-
-\retval kTerminal_ResultOK
-if the text is processed without errors
-
-\retval kTerminal_ResultInvalidID
-if the given terminal screen reference is invalid
-
-(3.0)
+Manages state determination and transition for the VT102
+terminal emulator.
 */
-Terminal_Result
-Terminal_EmulatorProcessCString		(TerminalScreenRef	inRef,
-									 char const*		inCString)
+class My_VT102:
+public My_VT100
 {
-	return Terminal_EmulatorProcessData(inRef, REINTERPRET_CAST(inCString, UInt8 const*), CPP_STD::strlen(inCString));
-}// EmulatorProcessCString
+public:
+	static void		deleteCharacters	(My_ScreenBufferPtr);
+	static void		deleteLines			(My_ScreenBufferPtr);
+	static void		deviceAttributes	(My_ScreenBufferPtr);
+	static void		insertLines			(My_ScreenBufferPtr);
+	static void		loadLEDs			(My_ScreenBufferPtr);
+	
+	static My_ParserState	returnCSINextState	(My_ParserState, UnicodeScalarValue, Boolean&);
+	static UInt32			stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
+	static UInt32			stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
 
+protected:
+	// The names of these constants use the same mnemonics from
+	// the programming manual of the original terminal.
+	enum State
+	{
+		kStateDCH		= kMy_ParserStateSeenESCLeftSqBracketParamsP,	//!< delete characters on the cursor line
+		kStateDL		= kMy_ParserStateSeenESCLeftSqBracketParamsM,	//!< delete lines, including cursor line
+		kStateIL		= kMy_ParserStateSeenESCLeftSqBracketParamsL,	//!< insert lines below cursor line
+		kStateMC		= kMy_ParserStateSeenESCLeftSqBracketParamsi,	//!< media copy (printer access)
+	};
+};
 
 /*!
-Sends a stream of characters to the specified screen’s terminal
-emulator, interpreting escape sequences, etc. which may affect
-the terminal display.
-
-The given buffer is considered a fragment of an infinite stream
-that continues from text sent by previous calls.  So, do not
-assume that "inBuffer" will be the start or end of anything in
-particular!  For example, if the previous byte stream ended with
-an incomplete multi-byte code point then the first few bytes of
-"inBuffer" may act as the terminator of the previous sequence.
-
-If the encoding, as set by Terminal_SetTextEncoding(), is UTF-8
-then the specified buffer is decoded BEFORE any bytes are
-examined for things like control characters.  (Text in the 7-bit
-range of ASCII is considered valid UTF-8 and acts the same in
-any case.)  If you intend to include special sequences such as
-8-bit control characters, you MUST ensure they are encoded as
-proper multi-byte sequences in UTF-8 terminals.
-
-USE WITH CARE.  Generally, you send data to this routine that
-comes directly from a program that knows what it’s doing.  There
-are more elegant ways to have specific effects on terminal
-screens in an emulator-independent fashion; you should use those
-approaches before hacking up a string as input to this routine.
-
-\retval kTerminal_ResultOK
-if the text is processed without errors
-
-\retval kTerminal_ResultInvalidID
-if the given terminal screen reference is invalid
-
-(3.0)
+Manages state determination and transition for the VT220
+terminal emulator.
 */
-Terminal_Result
-Terminal_EmulatorProcessData	(TerminalScreenRef	inRef,
-								 UInt8 const*		inBuffer,
-								 size_t				inLength)
+class My_VT220
 {
-	Terminal_Result		result = kTerminal_ResultOK;
-	
+public:
+	static void				hardSoftReset		(My_EmulatorPtr, Boolean);
+	static My_ParserState	returnCSINextState	(My_ParserState, UnicodeScalarValue, Boolean&);
+	static UInt32			stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
+	static UInt32			stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
 	
-	if (0 != inLength)
+	static void		compatibilityLevel					(My_ScreenBufferPtr);
+	static void		deviceStatusReportKeyboardLanguage	(My_ScreenBufferPtr);
+	static void		deviceStatusReportPrinterPort		(My_ScreenBufferPtr);
+	static void		deviceStatusReportUserDefinedKeys	(My_ScreenBufferPtr);
+	static void		eraseCharacters						(My_ScreenBufferPtr);
+	static void		insertBlankCharacters				(My_ScreenBufferPtr);
+	static void		primaryDeviceAttributes				(My_ScreenBufferPtr);
+	static void		requestDECPrivateMode				(My_ScreenBufferPtr);
+	static void		secondaryDeviceAttributes			(My_ScreenBufferPtr);
+	static void		selectCharacterAttributes			(My_ScreenBufferPtr);
+	static void		selectCursorStyle					(My_ScreenBufferPtr);
+	static void		selectiveEraseInDisplay				(My_ScreenBufferPtr);
+	static void		selectiveEraseInLine				(My_ScreenBufferPtr);
+
+	// The names of these constants use the same mnemonics from
+	// the programming manual of the original terminal.
+	enum State
 	{
-		My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
-		
-		
-		if (nullptr == dataPtr)
-		{
-			result = kTerminal_ResultInvalidID;
-		}
-		else
-		{
-			Boolean const	kIsUTF8 = (kCFStringEncodingUTF8 == dataPtr->emulator.inputTextEncoding);
-			UInt8 const*	ptr = inBuffer;
-			UInt32			countRead = 0;
-			
-			
-			// hide cursor momentarily
-			setCursorVisible(dataPtr, false);
+		// Ideally these are "protected", but XTerm may require them.
+		kStateCSISecondaryDA	= kMy_ParserStateSeenESCLeftSqBracketGreaterThan,	//!< parameter list indicates secondary device attributes
+		kStateDCS				= kMy_ParserStateSeenESCP,				//!< device control string
+		kStateDCSAcquireStr		= 'VACS',								//!< state of reading bytes into string accumulator
+		kStateDECRQM			= 'VRQM',								//!< request DEC private mode
+		kStateDECSCA			= 'VSCA',								//!< select character attributes
+		kStateDECSCL			= 'VSCL',								//!< compatibility level
+		kStateDECSTR			= kMy_ParserStateSeenESCLeftSqBracketExPointp,	//!< soft terminal reset
+		kStateDECSCUSR			= 'VSCU',								//!< select cursor style
+		kStateECH				= kMy_ParserStateSeenESCLeftSqBracketParamsX,	//!< erase characters without insertion
+		kStateICH				= kMy_ParserStateSeenESCLeftSqBracketParamsAt,	//!< insert blank characters
+		kStateLS1R				= kMy_ParserStateSeenESCTilde,			//!< lock shift G1, right side
+		kStateLS2				= kMy_ParserStateSeenESCn,				//!< lock shift G2, left side
+		kStateLS2R				= kMy_ParserStateSeenESCRightBrace,		//!< lock shift G2, right side
+		kStateLS3				= kMy_ParserStateSeenESCo,				//!< lock shift G3, left side
+		kStateLS3R				= kMy_ParserStateSeenESCVerticalBar,	//!< lock shift G3, right side
+		kStateS7C1T				= kMy_ParserStateSeenESCSpaceF,			//!< direct terminal to emit 7-bit sequences only (CSI = "ESC[")
+		kStateS8C1T				= kMy_ParserStateSeenESCSpaceG,			//!< direct terminal to emit 8-bit sequences only (CSI = the CSI C1 code)
+		kStateSCSG0DECSupplemental	= kMy_ParserStateSeenESCLeftParenLessThan,	//!< select character set for G0, DEC supplemental
+		kStateSCSG0Dutch		= kMy_ParserStateSeenESCLeftParen4,		//!< select character set for G0, Dutch
+		kStateSCSG0Finnish1		= kMy_ParserStateSeenESCLeftParenC,		//!< select character set for G0, Finnish
+		kStateSCSG0Finnish2		= kMy_ParserStateSeenESCLeftParen5,		//!< select character set for G0, Finnish (alternate)
+		kStateSCSG0French		= kMy_ParserStateSeenESCLeftParenR,		//!< select character set for G0, French
+		kStateSCSG0FrenchCdn	= kMy_ParserStateSeenESCLeftParenQ,		//!< select character set for G0, French Canadian
+		kStateSCSG0German		= kMy_ParserStateSeenESCLeftParenK,		//!< select character set for G0, German
+		kStateSCSG0Italian		= kMy_ParserStateSeenESCLeftParenY,		//!< select character set for G0, Italian
+		kStateSCSG0Norwegian1	= kMy_ParserStateSeenESCLeftParenE,		//!< select character set for G0, Norwegian and Danish
+		kStateSCSG0Norwegian2	= kMy_ParserStateSeenESCLeftParen6,		//!< select character set for G0, Norwegian and Danish (alternate)
+		kStateSCSG0Spanish		= kMy_ParserStateSeenESCLeftParenZ,		//!< select character set for G0, Spanish
+		kStateSCSG0Swedish1		= kMy_ParserStateSeenESCLeftParenH,		//!< select character set for G0, Swedish
+		kStateSCSG0Swedish2		= kMy_ParserStateSeenESCLeftParen7,		//!< select character set for G0, Swedish (alternate)
+		kStateSCSG0Swiss		= kMy_ParserStateSeenESCLeftParenEquals,	//!< select character set for G0, Swiss
+		kStateSCSG1DECSupplemental	= kMy_ParserStateSeenESCRightParenLessThan,	//!< select character set for G1, DEC supplemental
+		kStateSCSG1Dutch		= kMy_ParserStateSeenESCRightParen4,	//!< select character set for G1, Dutch
+		kStateSCSG1Finnish1		= kMy_ParserStateSeenESCRightParenC,	//!< select character set for G1, Finnish
+		kStateSCSG1Finnish2		= kMy_ParserStateSeenESCRightParen5,	//!< select character set for G1, Finnish (alternate)
+		kStateSCSG1French		= kMy_ParserStateSeenESCRightParenR,	//!< select character set for G1, French
+		kStateSCSG1FrenchCdn	= kMy_ParserStateSeenESCRightParenQ,	//!< select character set for G1, French Canadian
+		kStateSCSG1German		= kMy_ParserStateSeenESCRightParenK,	//!< select character set for G1, German
+		kStateSCSG1Italian		= kMy_ParserStateSeenESCRightParenY,	//!< select character set for G1, Italian
+		kStateSCSG1Norwegian1	= kMy_ParserStateSeenESCRightParenE,	//!< select character set for G1, Norwegian and Danish
+		kStateSCSG1Norwegian2	= kMy_ParserStateSeenESCRightParen6,	//!< select character set for G1, Norwegian and Danish (alternate)
+		kStateSCSG1Spanish		= kMy_ParserStateSeenESCRightParenZ,	//!< select character set for G1, Spanish
+		kStateSCSG1Swedish1		= kMy_ParserStateSeenESCRightParenH,	//!< select character set for G1, Swedish
+		kStateSCSG1Swedish2		= kMy_ParserStateSeenESCRightParen7,	//!< select character set for G1, Swedish (alternate)
+		kStateSCSG1Swiss		= kMy_ParserStateSeenESCRightParenEquals,	//!< select character set for G1, Swiss
+		kStateSCSG2UK			= kMy_ParserStateSeenESCAsteriskA,		//!< select character set for G2, U.K.
+		kStateSCSG2ASCII		= kMy_ParserStateSeenESCAsteriskB,		//!< select character set for G2, ASCII
+		kStateSCSG2SG			= kMy_ParserStateSeenESCAsterisk0,		//!< select character set for G2, special graphics
+		kStateSCSG2DECSupplemental	= kMy_ParserStateSeenESCAsteriskLessThan,	//!< select character set for G2, DEC supplemental
+		kStateSCSG2Dutch		= kMy_ParserStateSeenESCAsterisk4,		//!< select character set for G2, Dutch
+		kStateSCSG2Finnish1		= kMy_ParserStateSeenESCAsteriskC,		//!< select character set for G2, Finnish
+		kStateSCSG2Finnish2		= kMy_ParserStateSeenESCAsterisk5,		//!< select character set for G2, Finnish (alternate)
+		kStateSCSG2French		= kMy_ParserStateSeenESCAsteriskR,		//!< select character set for G2, French
+		kStateSCSG2FrenchCdn	= kMy_ParserStateSeenESCAsteriskQ,		//!< select character set for G2, French Canadian
+		kStateSCSG2German		= kMy_ParserStateSeenESCAsteriskK,		//!< select character set for G2, German
+		kStateSCSG2Italian		= kMy_ParserStateSeenESCAsteriskY,		//!< select character set for G2, Italian
+		kStateSCSG2Norwegian1	= kMy_ParserStateSeenESCAsteriskE,		//!< select character set for G2, Norwegian and Danish
+		kStateSCSG2Norwegian2	= kMy_ParserStateSeenESCAsterisk6,		//!< select character set for G2, Norwegian and Danish (alternate)
+		kStateSCSG2Spanish		= kMy_ParserStateSeenESCAsteriskZ,		//!< select character set for G2, Spanish
+		kStateSCSG2Swedish1		= kMy_ParserStateSeenESCAsteriskH,		//!< select character set for G2, Swedish
+		kStateSCSG2Swedish2		= kMy_ParserStateSeenESCAsterisk7,		//!< select character set for G2, Swedish (alternate)
+		kStateSCSG2Swiss		= kMy_ParserStateSeenESCAsteriskEquals,	//!< select character set for G2, Swiss
+		kStateSCSG3UK			= kMy_ParserStateSeenESCPlusA,			//!< select character set for G3, U.K.
+		kStateSCSG3ASCII		= kMy_ParserStateSeenESCPlusB,			//!< select character set for G3, ASCII
+		kStateSCSG3SG			= kMy_ParserStateSeenESCPlus0,			//!< select character set for G3, special graphics
+		kStateSCSG3DECSupplemental	= kMy_ParserStateSeenESCPlusLessThan,	//!< select character set for G3, DEC supplemental
+		kStateSCSG3Dutch		= kMy_ParserStateSeenESCPlus4,			//!< select character set for G3, Dutch
+		kStateSCSG3Finnish1		= kMy_ParserStateSeenESCPlusC,			//!< select character set for G3, Finnish
+		kStateSCSG3Finnish2		= kMy_ParserStateSeenESCPlus5,			//!< select character set for G3, Finnish (alternate)
+		kStateSCSG3French		= kMy_ParserStateSeenESCPlusR,			//!< select character set for G3, French
+		kStateSCSG3FrenchCdn	= kMy_ParserStateSeenESCPlusQ,			//!< select character set for G3, French Canadian
+		kStateSCSG3German		= kMy_ParserStateSeenESCPlusK,			//!< select character set for G3, German
+		kStateSCSG3Italian		= kMy_ParserStateSeenESCPlusY,			//!< select character set for G3, Italian
+		kStateSCSG3Norwegian1	= kMy_ParserStateSeenESCPlusE,			//!< select character set for G3, Norwegian and Danish
+		kStateSCSG3Norwegian2	= kMy_ParserStateSeenESCPlus6,			//!< select character set for G3, Norwegian and Danish (alternate)
+		kStateSCSG3Spanish		= kMy_ParserStateSeenESCPlusZ,			//!< select character set for G3, Spanish
+		kStateSCSG3Swedish1		= kMy_ParserStateSeenESCPlusH,			//!< select character set for G3, Swedish
+		kStateSCSG3Swedish2		= kMy_ParserStateSeenESCPlus7,			//!< select character set for G3, Swedish (alternate)
+		kStateSCSG3Swiss		= kMy_ParserStateSeenESCPlusEquals,		//!< select character set for G3, Swiss
+		kStateST				= kMy_ParserStateSeenESCBackslash,		//!< string terminator
+	};
+};
+
+/*!
+Manages state determination and transition for the XTerm
+terminal emulator.  Automatically uses My_XTermCore for
+various basic features, but also implements the rest of
+the XTerm terminal type.
+*/
+class My_XTerm
+{
+public:
+	static My_ParserState	returnCSINextState	(My_ParserState, UnicodeScalarValue, Boolean&);
+	static UInt32			stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
+	static UInt32			stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
+	
+	static void		cursorBackwardTabulation		(My_ScreenBufferPtr);
+	static void		cursorCharacterAbsolute			(My_ScreenBufferPtr);
+	static void		cursorForwardTabulation			(My_ScreenBufferPtr);
+	static void		cursorNextLine					(My_ScreenBufferPtr);
+	static void		cursorPreviousLine				(My_ScreenBufferPtr);
+	static void		horizontalPositionAbsolute		(My_ScreenBufferPtr);
+	static void		reportCursorStyle				(My_ScreenBufferPtr);
+	static void		reportSelectionSettingNotUsed	(My_ScreenBufferPtr);
+	static void		reportTopBottomMargins			(My_ScreenBufferPtr);
+	static void		scrollDown						(My_ScreenBufferPtr);
+	static void		scrollUp						(My_ScreenBufferPtr);
+	static void		secondaryDeviceAttributes		(My_ScreenBufferPtr);
+	static void		verticalPositionAbsolute		(My_ScreenBufferPtr);
+	
+	enum State
+	{
+		// Ideally these are "protected", but loop evasion code requires them.
+		kStateCSITertiaryDA		= kMy_ParserStateSeenESCLeftSqBracketEquals,			//!< parameter list indicates tertiary device attributes (VT420)
+		kStateCBT				= kMy_ParserStateSeenESCLeftSqBracketParamsZ,			//!< cursor backward tabulation
+		kStateCHA				= kMy_ParserStateSeenESCLeftSqBracketParamsG,			//!< cursor character absolute
+		kStateCHT				= kMy_ParserStateSeenESCLeftSqBracketParamsI,			//!< cursor forward tabulation
+		kStateCNL				= kMy_ParserStateSeenESCLeftSqBracketParamsE,			//!< cursor next line
+		kStateCPL				= kMy_ParserStateSeenESCLeftSqBracketParamsF,			//!< cursor previous line
+		kStateHPA				= kMy_ParserStateSeenESCLeftSqBracketParamsBackquote,	//!< horizontal (character) position absolute
+		kStateSD				= kMy_ParserStateSeenESCLeftSqBracketParamsT,			//!< scroll down
+		kStateSU				= kMy_ParserStateSeenESCLeftSqBracketParamsS,			//!< scroll up
+		kStateVPA				= kMy_ParserStateSeenESCLeftSqBracketParamsd,			//!< vertical position absolute
+	};
+};
+
+/*!
+A lightweight terminal implementation, suitable ONLY as a
+pre-callback.  Implements certain basic features of XTerm,
+such as colors and window title changes, that can be safely
+superimposed onto other emulators like the VT100.  The state
+determinant and transition routines automatically use the
+My_Emulator class’ supportsVariant() method to determine if
+a particular XTerm sequence should be handled; otherwise,
+the sequences are ignored.  In addition, any more advanced
+sequences from XTerm are always ignored.
+
+NOTE:	Almost all of XTerm is ignored by this class.  See
+		the class "My_XTerm" for the full emulator.
+*/
+class My_XTermCore
+{
+public:
+	static UInt32	stateDeterminant	(My_EmulatorPtr, My_ParserStatePair&, Boolean&, Boolean&);
+	static UInt32	stateTransition		(My_ScreenBufferPtr, My_ParserStatePair const&, Boolean&);
+	
+	enum State
+	{
+		// Ideally these are "protected", but loop evasion code requires them.
+		kStateSWIT				= kMy_ParserStateSeenESCRightSqBracket0,				//!< subsequent string is for window title and icon title
+		kStateSWITAcquireStr	= kMy_ParserStateSeenESCRightSqBracket0Semi,			//!< seen ESC]0, gathering characters of string
+		kStateSIT				= kMy_ParserStateSeenESCRightSqBracket1,				//!< subsequent string is for icon title only
+		kStateSITAcquireStr		= kMy_ParserStateSeenESCRightSqBracket1Semi,			//!< seen ESC]1, gathering characters of string
+		kStateSWT				= kMy_ParserStateSeenESCRightSqBracket2,				//!< subsequent string is for window title only
+		kStateSWTAcquireStr		= kMy_ParserStateSeenESCRightSqBracket2Semi,			//!< seen ESC]2, gathering characters of string
+		kStateSetColor			= kMy_ParserStateSeenESCRightSqBracket4,				//!< subsequent string is a color specification
+		kStateColorAcquireStr	= kMy_ParserStateSeenESCRightSqBracket4Semi,			//!< seen ESC]4, gathering characters of string
+	};
+};
+
+/*!
+A query for Terminal_Search(), prepared once and then shared
+(read-only) by every search thread.
+
+Literal queries are matched directly against the characters
+of each line: candidate positions for the first character
+are found with vector instructions and only those positions
+are compared completely.  If the query is case-insensitive,
+this only applies to ASCII queries; any other literal query
+is given to Core Foundation (without copying the line).
+Regular expressions are compiled only once, since an
+NSRegularExpression may be used by several threads at once.
+*/
+class My_SearchPattern
+{
+public:
+	My_SearchPattern	(CFStringRef, Terminal_SearchFlags);
+	
+	void
+	findMatches		(UniChar const*, CFIndex, std::vector< CFRange >&) const;
+	
+	//! Returns true only if the query could be prepared (for
+	//! example, false for a regular expression with bad syntax).
+	bool
+	isValid ()
+	const
+	{
+		return ((nil != regularExpression) || (false == literalCharacters.empty()));
+	}
+	
+	bool
+	returnIndexTrigrams		(std::vector< My_ScrollbackSearchIndex::TrigramHash >&) const;
+
+private:
+	std::vector< UniChar >		literalCharacters;	//!< literal query; lowercase if "isFoldingASCII"
+	NSRegularExpression*		regularExpression;	//!< if not nil, the query is a pattern
+	CFRetainRelease				queryCFString;		//!< used if literal query cannot be matched directly
+	CFOptionFlags				queryCompareFlags;	//!< used if literal query cannot be matched directly
+	CFCharacterSetRef			whitespaceSet;		//!< characters ignored at the end of every line
+	bool						isAnchoredAtEnd;	//!< matches must end at the end of a line (minus whitespace)
+	bool						isBackwards;		//!< matches are found from the end of each line
+	bool						isDirect;			//!< literal query is compared without Core Foundation
+	bool						isFoldingASCII;		//!< letters A-Z are compared as a-z
+	
+	void
+	findLiteralMatches		(UniChar const*, CFIndex, std::vector< CFRange >&) const;
+	
+	CFIndex
+	returnLiteralMatchIndex	(UniChar const*, CFIndex, CFIndex) const;
+};
+
+/*!
+Shared by all chunks of a search, to pass batches of
+matches back to the thread that started the search.
+
+Batches are kept separately for each chunk so that
+they can be delivered in chunk order (which is the
+order of rows in the buffer) no matter which chunks
+the work pool finishes first.
+*/
+struct My_SearchResultsQueue
+{
+	enum
+	{
+		kBatchMatchLimit = 64,					//!< a chunk delivers its matches early once it has this many
+		kCancelCheckIntervalMilliseconds = 50	//!< how often the receiver is asked whether to stop
+	};
+	
+	typedef std::vector< Terminal_RangeDescription >	Batch;
+	
+	struct ChunkResults
+	{
+		std::deque< Batch >		pendingBatches;	//!< matches not yet seen by the receiver
+		bool					isFinished;		//!< if true, no more batches will be added
+	};
+	
+	pthread_mutex_t					mutex;			//!< protects all other fields
+	pthread_cond_t					condition;		//!< signaled when a batch is added or a chunk ends
+	std::vector< ChunkResults >		chunkResults;	//!< one per chunk of the search job
+};
+
+/*!
+Information shared by every chunk of a search (see
+searchChunk()).  The first chunk is the screen and
+the rest divide the scrollback into ranges that are
+small enough to stay in a processor cache.
+*/
+struct My_SearchContext
+{
+	enum
+	{
+		kScrollbackChunkRowCount = 512		//!< number of scrollback lines searched by each chunk
+	};
+	
+	My_ScreenBufferPtr							screenBufferPtr; // the terminal being searched
+	My_SearchPattern const*						patternPtr; // compiled query
+	My_SearchResultsQueue*						resultsQueuePtr; // destination for batches of matches
+	std::vector< My_ScreenBufferLinePtr const* > const*		screenLinesPtr; // every screen line, for random access
+	My_ScrollbackSearchIndex const*				searchIndexPtr; // if not nullptr, used to skip scrollback lines that cannot match
+	std::vector< My_ScrollbackSearchIndex::TrigramHash >	indexTrigrams; // trigrams of the query, if "searchIndexPtr" is defined
+	UInt32										invalidationCount; // for background searches, the value of "backgroundSearch.invalidationCount" at the start
+	bool										isInBackground; // if true, chunks read the buffer only while holding "backgroundSearch.lock"
+};
+typedef My_SearchContext*			My_SearchContextPtr;
+typedef My_SearchContext const*		My_SearchContextConstPtr;
+
+/*!
+Everything that one search needs (see searchRun()).  The
+constructor prepares the search, and must be called on the
+main thread (it may update the scrollback search index).
+
+A background search outlives the call that starts it, so
+this is always allocated separately for those (the context
+refers to other fields, so it cannot be copied).
+*/
+struct My_Search
+{
+	My_Search	(My_ScreenBufferPtr, CFStringRef, Terminal_SearchFlags, bool);
+	~My_Search ();
+	
+	My_Search	(My_Search const&) = delete;
+	
+	My_Search&
+	operator =	(My_Search const&) = delete;
+	
+	//! Returns true only if the query could be prepared; if not,
+	//! nothing else has been initialized and the search must not
+	//! be run.
+	bool
+	isValid ()
+	const
+	{
+		return pattern.isValid();
+	}
+	
+	My_SearchPattern								pattern;			//!< compiled query
+	My_SearchResultsQueue							resultsQueue;		//!< batches of matches
+	std::vector< My_ScreenBufferLinePtr const* >	screenLines;		//!< since a screen line list is not randomly accessible
+	My_SearchContext								context;			//!< shared by all chunks
+	std::atomic< bool >								isStopRequested;	//!< for background searches, set when the receiver stops the search
+};
+typedef std::shared_ptr< My_Search >	My_SearchPtr;
+
+} // anonymous namespace
+
+/*!
+The contents of a published snapshot (see Terminal.h).
+Rows that did not change since the previous snapshot are
+shared with it.
+*/
+struct Terminal_Snapshot
+{
+	UInt64				version;	//!< increases with each snapshot of the same screen
+	My_SnapshotRowList	rows;		//!< one entry per main screen row, topmost first
+};
+
+#pragma mark Internal Method Prototypes
+namespace {
+
+void						assertScrollingRegion					(My_ScreenBufferPtr);
+void						backgroundSearchBegin					(My_ScreenBufferPtr);
+void						backgroundSearchEnd						(My_ScreenBufferPtr);
+void						backgroundSearchLockAll					(CFRunLoopObserverRef, CFRunLoopActivity, void*);
+void						backgroundSearchUnlockAll				(CFRunLoopObserverRef, CFRunLoopActivity, void*);
+void*						benchmarkZoneCalloc						(malloc_zone_t*, size_t, size_t);
+void*						benchmarkZoneMalloc						(malloc_zone_t*, size_t);
+void*						benchmarkZoneMemalign					(malloc_zone_t*, size_t, size_t);
+void*						benchmarkZoneRealloc					(malloc_zone_t*, void*, size_t);
+void*						benchmarkZoneValloc						(malloc_zone_t*, size_t);
+void						bufferEraseAttributesInRange			(My_ScreenBufferPtr, My_BufferChanges, My_ScreenBufferLine&, UInt16, UInt16);
+void						bufferEraseCursorLine					(My_ScreenBufferPtr, My_BufferChanges);
+void						bufferEraseFromCursorColumn				(My_ScreenBufferPtr, My_BufferChanges, UInt16);
+void						bufferEraseFromCursorColumnToLineEnd	(My_ScreenBufferPtr, My_BufferChanges);
+void						bufferEraseFromCursorToEnd				(My_ScreenBufferPtr, My_BufferChanges);
+void						bufferEraseFromHomeToCursor				(My_ScreenBufferPtr, My_BufferChanges);
+void						bufferEraseFromLineBeginToCursorColumn  (My_ScreenBufferPtr, My_BufferChanges);
+void						bufferEraseLineWithoutUpdate			(My_ScreenBufferPtr, My_BufferChanges, My_ScreenBufferLine&);
+void						bufferEraseRange						(My_ScreenBufferPtr, Boolean, My_ScreenBufferLine&, My_CellBoundary);
+Boolean						bufferEraseSplitWideCharacter			(My_ScreenBufferPtr, My_ScreenBufferLine&, UInt16);
+void						bufferEraseVisibleScreen				(My_ScreenBufferPtr, My_BufferChanges);
+void						bufferInsertBlankLines					(My_ScreenBufferPtr, UInt16,
+																	 My_ScreenBufferLineList::iterator&,
+																	 My_AttributeRule);
+Boolean						bufferInsertBlanksAtCursorColumnWithoutUpdate	(My_ScreenBufferPtr, SInt16, My_AttributeRule);
+void						bufferInsertInlineImageWithoutUpdate	(My_ScreenBufferPtr, ImageStore_ImageID, UInt16, UInt16, UInt16, UInt16, Boolean, Boolean);
+void						bufferLineFill							(My_ScreenBufferPtr, My_ScreenBufferLine&, CFStringRef,
+																	 TextAttributes_Object = TextAttributes_Object(),
+																	 Boolean = true);
+void						bufferRemoveCharactersAtCursorColumn	(My_ScreenBufferPtr, SInt16, My_AttributeRule);
+void						bufferRemoveLines						(My_ScreenBufferPtr, UInt16,
+																	 My_ScreenBufferLineList::iterator&,
+																	 My_AttributeRule);
+void						changeLineAttributes					(My_ScreenBufferPtr, My_ScreenBufferLine&,
+																	 TextAttributes_Object, TextAttributes_Object);
+void						changeLineGlobalAttributes				(My_ScreenBufferPtr, My_ScreenBufferLine&,
+																	 TextAttributes_Object, TextAttributes_Object);
+void						changeLineRangeAttributes				(My_ScreenBufferPtr, My_ScreenBufferLine&, UInt16,
+																	 SInt16, TextAttributes_Object, TextAttributes_Object);
+void						changeNotifyForEcho						(My_ScreenBufferPtr, SInt16, My_ScreenRowIndex);
+void						changeNotifyForTerminal					(My_ScreenBufferPtr, Terminal_Change, void*);
+void						coalesceTerminalChange					(ListenerModel_Event, void*, ListenerModel_Event, void const*);
+Boolean						createBackgroundSearchObservers			();
+My_ScreenBufferLinePtr		createLinePtr							(My_ScreenBufferPtr);
+void						cursorRestore							(My_ScreenBufferPtr);
+void						cursorSave								(My_ScreenBufferPtr);
+void						cursorWrapIfNecessaryGetLocation		(My_ScreenBufferPtr, SInt16*, My_ScreenRowIndex*);
+Boolean						defineTrueColor							(My_ScreenBufferPtr, UInt8, UInt8, UInt8, TextAttributes_TrueColorID&);
+void						deleteLinePtr							(My_ScreenBufferLinePtr&);
+Boolean						echoBytesDirectly						(My_ScreenBufferPtr, UInt8 const*, UInt32);
+void						echoCell								(My_ScreenBufferPtr, My_ScreenBufferLineList::iterator&, SInt16&, UnicodeScalarValue, UInt16);
+void						echoCFString							(My_ScreenBufferPtr, CFStringRef);
+void						eraseRightHalfOfLine					(My_ScreenBufferPtr, My_ScreenBufferLine&);
+void						forEachLikeAttributeRunInLine			(CFStringRef, TerminalLine_AttributeRunList const&, TextAttributes_Object const&,
+																	 Terminal_LineRef, Terminal_ScreenRunBlock);
+inline My_LineIteratorPtr	getLineIterator							(Terminal_LineRef);
+void						getParametersFromStringAccumulator		(My_ScreenBufferPtr, ParameterDecoder_StateMachine&,
+																	 std::basic_string< UInt8 >::const_iterator&);
+void						getParametersFromStringRange			(std::basic_string< UInt8 >::const_iterator, std::basic_string< UInt8 >::const_iterator,
+																	 ParameterDecoder_StateMachine&, std::basic_string< UInt8 >::const_iterator&);
+My_ScreenBufferPtr			getVirtualScreenData					(TerminalScreenRef);
+void						highlightLED							(My_ScreenBufferPtr, SInt16);
+My_StringByPointer			initCallbackIDsByFuncPtr				();
+void						locateCursorLine						(My_ScreenBufferPtr, My_ScreenBufferLineList::iterator&);
+void						locateScrollingRegion					(My_ScreenBufferPtr, My_ScreenBufferLineList::iterator&,
+																	 My_ScreenBufferLineList::iterator&);
+void						locateScrollingRegionTop				(My_ScreenBufferPtr, My_ScreenBufferLineList::iterator&);
+void						moveCursor								(My_ScreenBufferPtr, SInt16, My_ScreenRowIndex);
+void						moveCursorDown							(My_ScreenBufferPtr);
+void						moveCursorDownOrScroll					(My_ScreenBufferPtr);
+void						moveCursorDownToEdge					(My_ScreenBufferPtr);
+void						moveCursorLeft							(My_ScreenBufferPtr);
+void						moveCursorLeftToEdge					(My_ScreenBufferPtr);
+void						moveCursorLeftToHalf					(My_ScreenBufferPtr);
+void						moveCursorLeftToNextTabStop				(My_ScreenBufferPtr);
+void						moveCursorRight							(My_ScreenBufferPtr);
+void						moveCursorRightToEdge					(My_ScreenBufferPtr);
+void						moveCursorRightToNextTabStop			(My_ScreenBufferPtr);
+void						moveCursorUpToEdge						(My_ScreenBufferPtr);
+void						moveCursorUp							(My_ScreenBufferPtr);
+void						moveCursorUpOrScroll					(My_ScreenBufferPtr);
+void						moveCursorX								(My_ScreenBufferPtr, SInt16);
+void						moveCursorY								(My_ScreenBufferPtr, My_ScreenRowIndex);
+void						releaseUnusedImages					(My_ScreenBufferPtr);
+void						resetTerminal							(My_ScreenBufferPtr, Boolean = false);
+SessionRef					returnListeningSession					(My_ScreenBufferPtr);
+TerminalScreenRef			returnNewTestScreen						(UInt16, UInt16, UInt32 = 100);
+size_t						returnPrintableRunLength				(UInt8 const*, size_t);
+size_t						returnPrintableUTF8RunLength			(UInt8 const*, size_t);
+Boolean						screenCopyLinesToScrollback				(My_ScreenBufferPtr);
+Boolean						screenInsertNewLines					(My_ScreenBufferPtr, My_ScreenBufferLineList::size_type);
+Boolean						screenMoveLinesToScrollback				(My_ScreenBufferPtr, My_ScreenBufferLineList::size_type);
+void						screenReflowLines						(My_ScreenBufferPtr, UInt16);
+void						screenScroll							(My_ScreenBufferPtr, SInt16 = 1);
+void						scrollbackReflowLines					(My_ScreenBufferPtr);
+void						searchChunk								(My_SearchContextConstPtr, size_t, std::atomic< bool > const&);
+CFIndex						searchReadRow							(My_SearchContextConstPtr, SInt64, std::vector< UniChar >&, UniChar const*&);
+UInt16						searchReturnSoftWrapColumnCount			(My_SearchContextConstPtr, SInt64);
+void						searchRun								(My_Search&, Terminal_SearchResultsBlock, Terminal_SearchCancelBlock);
+Boolean						setBenchmarkZoneHooksEnabled			(Boolean);
+void						setCursorVisible						(My_ScreenBufferPtr, Boolean);
+void						setScrollbackSize						(My_ScreenBufferPtr, UInt32);
+Terminal_Result				setVisibleColumnCount					(My_ScreenBufferPtr, UInt16);
+Terminal_Result				setVisibleRowCount						(My_ScreenBufferPtr, UInt16);
+void						streamStringAccumulator					(My_ScreenBufferPtr, Boolean);
+// IMPORTANT: Attribute bit manipulation is fully described in "TextAttributes.h".
+//            Changes must be kept consistent everywhere.  See below, for usage.
+inline TextAttributes_Object	styleOfVTParameter					(UInt16	inPs)
+{
+	return TextAttributes_Object(1 << (inPs - 1));
+}
+void						tabStopClearAll							(My_ScreenBufferPtr);
+UInt16						tabStopGetDistanceFromCursor			(My_ScreenBufferConstPtr, Boolean);
+void						tabStopInitialize						(My_ScreenBufferPtr);
+void						translateCell							(My_ScreenBufferPtr, My_ScreenBufferLinePtr&, StringUtilities_Cell, UnicodeScalarValue, TextAttributes_Object);
+Boolean						unitTest_Images_000						();
+Boolean						unitTest_Reflow_000						();
+Boolean						unitTest_Reflow_001						();
+Boolean						unitTest_Scrollback_000					();
+Boolean						unitTest_WideCharacters_000				();
+Boolean						unitTest_WideCharacters_001				();
+Boolean						unitTest_WideCharacters_002				();
+Boolean						unitTest_WideCharacters_003				();
+
+} // anonymous namespace
+
+#pragma mark Variables
+namespace {
+
+My_StringByPointer&				gCallbackIDsByFuncPtr ()	{ static My_StringByPointer x = initCallbackIDsByFuncPtr(); return x; }
+My_PrintableByUniChar&			gDumbTerminalRenderings ()	{ static My_PrintableByUniChar x; return x; }
+My_ScreenReferenceLocker&		gScreenRefLocks ()			{ static My_ScreenReferenceLocker x; return x; }
+My_RefTracker&					gTerminalScreenValidRefs ()	{ static My_RefTracker x; return x; }
+std::atomic< UInt64 >&			gBenchmarkAllocationCount ()	{ static std::atomic< UInt64 > x(0); return x; } // updated from any thread
+std::atomic< UInt64 >&			gBenchmarkAllocatedByteCount ()	{ static std::atomic< UInt64 > x(0); return x; } // updated from any thread
+malloc_zone_t&					gBenchmarkOriginalZone ()	{ static malloc_zone_t x; return x; } // copy of the default zone before hooks
+std::set< My_ScreenBufferPtr >&	gBackgroundSearchScreens ()	{ static std::set< My_ScreenBufferPtr > x; return x; } // main thread only
+Boolean							gBackgroundSearchObserversInstalled ()	{ static Boolean x = createBackgroundSearchObservers(); return x; }
+
+} // anonymous namespace
+
+
+
+#pragma mark Public Methods
+
+/*!
+A unit test for this module.  This should always be run
+before a release, after any substantial changes are made,
+or if you suspect bugs!  It should also be EXPANDED as
+new functionality is proposed (ideally, a test is written
+before the functionality is added).
+
+(2023.10)
+*/
+void
+Terminal_RunTests ()
+{
+	UInt16		totalTests = 0;
+	UInt16		failedTests = 0;
+	
+	
+	++totalTests; if (false == unitTest_Images_000()) ++failedTests;
+	++totalTests; if (false == unitTest_Reflow_000()) ++failedTests;
+	++totalTests; if (false == unitTest_Reflow_001()) ++failedTests;
+	++totalTests; if (false == unitTest_Scrollback_000()) ++failedTests;
+	++totalTests; if (false == unitTest_WideCharacters_000()) ++failedTests;
+	++totalTests; if (false == unitTest_WideCharacters_001()) ++failedTests;
+	++totalTests; if (false == unitTest_WideCharacters_002()) ++failedTests;
+	++totalTests; if (false == unitTest_WideCharacters_003()) ++failedTests;
+	
+	Console_WriteUnitTestReport("Terminal", failedTests, totalTests);
+}// RunTests
+
+
+/*!
+Creates a new terminal screen and initial view according
+to the given specifications.
+
+Version 3.0 is designed so that a terminal screen buffer
+can have multiple views, or vice-versa (a view can display
+the contents of multiple buffers).  Therefore, although a
+single buffer and view is created by this routine, more
+could be constructed later.
+
+\retval kTerminal_ResultOK
+if the screen was created successfully
+
+\retval kTerminal_ResultParameterError
+if any of the given storage pointers are nullptr
+
+\retval kTerminal_ResultNotEnoughMemory
+if there is a serious problem creating the screen
+
+(3.0)
+*/
+Terminal_Result
+Terminal_NewScreen	(Preferences_ContextRef		inTerminalConfig,
+					 Preferences_ContextRef		inTranslationConfig,
+					 TerminalScreenRef*			outScreenPtr)
+{
+	Terminal_Result		result = kTerminal_ResultOK;
+	
+	
+	if (outScreenPtr == nullptr) result = kTerminal_ResultParameterError;
+	else
+	{
+		*outScreenPtr = nullptr;
+		
+		try
+		{
+			*outScreenPtr = REINTERPRET_CAST(new My_ScreenBuffer(inTerminalConfig, inTranslationConfig), TerminalScreenRef);
+		}
+		catch (std::bad_alloc)
+		{
+			result = kTerminal_ResultNotEnoughMemory;
+			*outScreenPtr = nullptr;
+		}
+		catch (Terminal_Result		inConstructionError)
+		{
+			result = inConstructionError;
+			*outScreenPtr = nullptr;
+		}
+		
+		if (*outScreenPtr != nullptr)
+		{
+			// successfully created; set initial retain-count to 1
+			Terminal_RetainScreen(*outScreenPtr);
+		}
+	}
+	
+	return result;
+}// NewScreen
+
+
+/*!
+Adds a lock on the specified reference.  This indicates you
+are using the screen, so attempts by anyone else to delete
+the screen with Terminal_ReleaseScreen() will fail until you
+release your lock (and everyone else releases locks they
+may have).
+
+(4.1)
+*/
+void
+Terminal_RetainScreen	(TerminalScreenRef	inRef)
+{
+	gScreenRefLocks().acquireLock(inRef);
+}// RetainScreen
+
+
+/*!
+Releases one lock on the specified screen created with
+Terminal_NewScreen() and deletes the screen *if* no other
+locks remain.  Your copy of the reference is set to
+nullptr.
+
+(4.1)
+*/
+void
+Terminal_ReleaseScreen	(TerminalScreenRef*		inoutRefPtr)
+{
+	gScreenRefLocks().releaseLock(*inoutRefPtr);
+	unless (gScreenRefLocks().isLocked(*inoutRefPtr))
+	{
+		My_ScreenBufferPtr		ptr = getVirtualScreenData(*inoutRefPtr);
+		
+		
+		delete ptr;
+	}
+	*inoutRefPtr = nullptr;
+}// ReleaseScreen
+
+
+/*!
+Creates a special reference to the given line of the given
+terminal screen’s VISIBLE SCREEN buffer, or returns nullptr
+if the line is out of range or the iterator cannot be created
+for some other reason.
+
+Pass 0 to indicate you want the very topmost line (that is,
+the one that would be added to the scrollback buffer first if
+the screen scrolls), or larger values to ask for lines below
+it.  Currently, this routine takes linearly more time to
+figure out where the bottommost lines are.
+
+A main line iterator can be advanced using negative numbers
+to go backwards, and if this is done often enough, it will
+automatically enter the scrollback buffer (as if the iterator
+were constructed with Terminal_NewScrollbackLineIterator()).
+
+IMPORTANT:	An iterator is completely invalid once the
+			screen it was created for has been destroyed.
+
+(3.0)
+*/
+Terminal_LineRef
+Terminal_NewMainScreenLineIterator	(TerminalScreenRef				inRef,
+									 UInt16							inLineNumberZeroForTop,
+									 Terminal_LineStackStorage*		inStackAllocationOrNull)
+{
+	Terminal_LineRef		result = nullptr;
+	My_ScreenBufferPtr		ptr = getVirtualScreenData(inRef);
+	
+	
+	if (false == Terminal_IsValid(inRef))
+	{
+		Console_Warning(Console_WriteValueAddress, "attempt to construct iterator from invalid reference", inRef);
+	}
+	else if (nullptr != ptr)
+	{
+		// ensure the specified row is in range
+		if (inLineNumberZeroForTop < ptr->screenBuffer.size())
+		{
+			auto	startIterator = ptr->screenBuffer.begin();
+			
+			
+			std::advance(startIterator, STATIC_CAST(inLineNumberZeroForTop,
+													My_ScreenBufferLineList::difference_type));
+			if (nullptr != inStackAllocationOrNull)
+			{
+				new (inStackAllocationOrNull) My_LineIterator(false/* heap allocated */,
+																ptr->screenBuffer, ptr->scrollbackBuffer,
+																startIterator,
+																My_LineIterator::kScreenBufferDesignator);
+				result = REINTERPRET_CAST(inStackAllocationOrNull, Terminal_LineRef);
+			}
+			else
+			{
+				try
+				{
+					My_LineIteratorPtr		iteratorPtr = new My_LineIterator
+																(true/* heap allocated */,
+																	ptr->screenBuffer, ptr->scrollbackBuffer,
+																	startIterator,
+																	My_LineIterator::kScreenBufferDesignator);
+					
+					
+					if (nullptr != iteratorPtr)
+					{
+						result = REINTERPRET_CAST(iteratorPtr, Terminal_LineRef);
+					}
+				}
+				catch (std::bad_alloc)
+				{
+					result = nullptr;
+				}
+			}
+		}
+	}
+	return result;
+}// NewMainScreenLineIterator
+
+
+/*!
+Creates a special reference to the given line of the given
+terminal screen’s SCROLLBACK buffer, or returns nullptr if
+the line is out of range or the iterator cannot be created
+for some other reason.
+
+Pass 0 to indicate you want the very newest line (that is,
+the one that most recently scrolled off the top of the main
+screen), or larger values to ask for older lines.  Any line
+can be found in constant time.
+
+A scrollback line iterator can be advanced often enough to
+automatically enter the main screen buffer (as if the iterator
+were constructed with NewMainScreenLineIterator()).
+
+IMPORTANT:	An iterator is completely invalid once the screen
+			it was created for has been destroyed.  It can
+			also be invalidated in other ways, e.g. a call to
+			Terminal_DeleteAllSavedLines().
+
+(3.0)
+*/
+Terminal_LineRef
+Terminal_NewScrollbackLineIterator	(TerminalScreenRef				inRef,
+									 UInt64							inLineNumberZeroForNewest,
+									 Terminal_LineStackStorage*		inStackAllocationOrNull)
+{
+	Terminal_LineRef		result = nullptr;
+	My_ScreenBufferPtr		ptr = getVirtualScreenData(inRef);
+	
+	
+	// ensure the specified row is in range
+	if ((nullptr != ptr) && (inLineNumberZeroForNewest < ptr->scrollbackBuffer.size()))
+	{
+		My_ScrollbackBuffer::SequenceNumber const	kStartRow = ptr->scrollbackBuffer.returnSequenceNumber
+																(STATIC_CAST(inLineNumberZeroForNewest, My_ScrollbackBuffer::size_type));
+		
+		
+		if (nullptr != inStackAllocationOrNull)
+		{
+			new (inStackAllocationOrNull) My_LineIterator(false/* heap allocated */,
+															ptr->screenBuffer, ptr->scrollbackBuffer,
+															kStartRow);
+			result = REINTERPRET_CAST(inStackAllocationOrNull, Terminal_LineRef);
+		}
+		else
+		{
+			try
+			{
+				My_LineIteratorPtr		iteratorPtr = new My_LineIterator
+															(true/* heap allocated */,
+																ptr->screenBuffer, ptr->scrollbackBuffer,
+																kStartRow);
+				
+				
+				if (nullptr != iteratorPtr)
+				{
+					result = REINTERPRET_CAST(iteratorPtr, Terminal_LineRef);
+				}
+			}
+			catch (std::bad_alloc)
+			{
+				result = nullptr;
+			}
+		}
+	}
+	return result;
+}// NewScrollbackLineIterator
+
+
+/*!
+Destroys an iterator created with Terminal_NewLineIterator(),
+and sets your copy of the reference to nullptr.
+
+Note that no actual memory is deallocated by this call if
+stack storage was used to construct the iterator, although
+your copy of the reference is still nullified.
+
+(3.0)
+*/
+void
+Terminal_DisposeLineIterator	(Terminal_LineRef*		inoutRefPtr)
+{
+	if (nullptr != inoutRefPtr)
+	{
+		My_LineIteratorPtr		ptr = getLineIterator(*inoutRefPtr);
+		
+		
+		if (nullptr != ptr)
+		{
+			if (ptr->isHeapAllocated())
+			{
+				delete ptr;
+			}
+			*inoutRefPtr = nullptr;
+		}
+	}
+}// DisposeLineIterator
+
+
+/*!
+Returns "true" only if the given terminal’s bell is
+active.  An inactive bell completely ignores all
+bell signals - without giving any audible or visible
+indication that a bell has occurred.  This can be
+useful if you know you’ve just triggered a long string
+of bells and don’t want to be annoyed by a series of
+beeps or flashes.
+
+(3.0)
+*/
+Boolean
+Terminal_BellIsEnabled		(TerminalScreenRef	inRef)
+{
+	My_ScreenBufferPtr	dataPtr = getVirtualScreenData(inRef);
+	Boolean				result = false;
+	
+	
+	if (dataPtr != nullptr)
+	{
+		result = !dataPtr->bellDisabled;
+	}
+	return result;
+}// BellIsEnabled
+
+
+/*!
+Returns the bitmap image representation for the given ID,
+which is defined (usually along with several other bitmaps)
+if bitmap terminal sequences are received.  The ID may be
+used in more than one place.
+
+The bitmap is meant to have a resolution suitable for
+rendering within a single default-sized character cell,
+with no surrounding space except any defined by the pixels
+of the image itself.  It is considered read-only at this
+stage; anything that normally overwrites a terminal cell’s
+attributes may clear the cell’s bitmaps however.
+
+The returned image can be shared by many bitmap IDs but a
+particular sub-rectangle of the image is also given to
+specify the portion of the image that the ID represents.
+
+Note that since the entire image is available from any ID
+associated with any part of that image, user operations
+that depend on a whole image are easier to implement (for
+example, a contextual menu click or drag on a particular
+terminal cell).
+
+The TextAttributes_Object type can be used to extract the
+TextAttributes_BitmapID value for a section of text, and
+to determine what a bitmap is for.
+
+\retval kTerminal_ResultOK
+if no error occurred
+
+\retval kTerminal_ResultInvalidID
+if the specified screen reference is invalid
+
+\retval kTerminal_ResultParameterError
+if the specified ID is not valid
+
+\retval kTerminal_ResultUnsupported
+if the specified terminal was not configured for bitmaps
+
+(2017.11)
+*/
+Terminal_Result
+Terminal_BitmapGetFromID	(TerminalScreenRef			inRef,
+							 TextAttributes_BitmapID	inID,
+							 CGRect&					outImageSubRect,
+							 NSImage*&					outCompleteImage)
+{
+	Terminal_Result		result = kTerminal_ResultOK;
+	My_ScreenBufferPtr	dataPtr = getVirtualScreenData(inRef);
+	
+	
+	outImageSubRect = CGRectZero; // initially...
+	outCompleteImage = nil; // initially...
+	
+	if (nullptr == dataPtr)
+	{
+		result = kTerminal_ResultInvalidID;
+	}
+	else
+	{
+		ImageStore_ImageID	imageID = kImageStore_InvalidImageID;
+		
+		
+		// bitmap IDs are shared by all terminals (see "ImageStore.h")
+		if (false == ImageStore_GetSegment(inID, imageID, outImageSubRect))
+		{
+			result = kTerminal_ResultParameterError;
+		}
+		else
+		{
+			outCompleteImage = ImageStore_ReturnImage(imageID);
+		}
+	}
+	
+	return result;
+}// BitmapGetFromID
+
+
+/*!
+Applies the specified changes to every single attribute
+for a single line of the screen buffer (no effect on
+the display until the next redraw). Also updates the
+“current” attributes, if the cursor happens to be on
+the specified line.
+
+The row value may be negative, signifying a scrollback
+buffer row.
+
+Equivalent to invoking Terminal_ChangeLineRangeAttributes()
+with a range from first column to last column.
+
+You can use this to apply effects intended to be global
+to a line, like double-sized text.
+
+\retval kTerminal_ResultOK
+if the line attributes were changed successfully
+
+\retval kTerminal_ResultInvalidID
+if the specified screen reference is invalid
+
+\retval kTerminal_ResultInvalidIterator
+if the specified row reference is invalid
+
+(3.0)
+*/
+Terminal_Result
+Terminal_ChangeLineAttributes	(TerminalScreenRef			inRef,
+								 Terminal_LineRef			inRow,
+								 TextAttributes_Object		inSetTheseAttributes,
+								 TextAttributes_Object		inClearTheseAttributes)
+{
+	Terminal_Result			result = kTerminal_ResultOK;
+	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+	My_LineIteratorPtr		iteratorPtr = getLineIterator(inRow);
+	
+	
+	if (dataPtr == nullptr) result = kTerminal_ResultInvalidID;
+	else if (iteratorPtr == nullptr) result = kTerminal_ResultInvalidIterator;
+	else
+	{
+		changeLineAttributes(dataPtr, iteratorPtr->currentLine(), inSetTheseAttributes, inClearTheseAttributes);
+	}
+	
+	return result;
+}// ChangeLineAttributes
+
+
+/*!
+Applies the specified changes to every single attribute
+in the specified column range of the specified line
+screen buffer (no effect on the display until the next
+redraw).  Also updates the “current” attributes, if the
+cursor happens to be in the specified range.
+
+The row value may be negative, signifying a scrollback
+buffer row.
+
+Equivalent to invoking Terminal_ChangeRangeAttributes()
+with the same start and end rows.
+
+You can use this to apply effects intended to be applied
+to a series of characters on a line, like text coloring.
+
+\retval kTerminal_ResultOK
+if the line range attributes were changed successfully
+
+\retval kTerminal_ResultInvalidID
+if the specified screen reference is invalid
+
+\retval kTerminal_ResultInvalidIterator
+if the specified row reference is invalid
+
+(3.0)
+*/
+Terminal_Result
+Terminal_ChangeLineRangeAttributes	(TerminalScreenRef			inRef,
+									 Terminal_LineRef			inRow,
+									 UInt16						inZeroBasedStartColumn,
+									 SInt16						inZeroBasedPastTheEndColumnOrNegativeForLastColumn,
+									 TextAttributes_Object		inSetTheseAttributes,
+									 TextAttributes_Object		inClearTheseAttributes)
+{
+	Terminal_Result			result = kTerminal_ResultOK;
+	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+	My_LineIteratorPtr		iteratorPtr = getLineIterator(inRow);
+	
+	
+	if (dataPtr == nullptr) result = kTerminal_ResultInvalidID;
+	else if (iteratorPtr == nullptr) result = kTerminal_ResultInvalidIterator;
+	else
+	{
+		changeLineRangeAttributes(dataPtr, iteratorPtr->currentLine(), inZeroBasedStartColumn,
+									inZeroBasedPastTheEndColumnOrNegativeForLastColumn,
+									inSetTheseAttributes, inClearTheseAttributes);
+	}
+	
+	return result;
+}// ChangeLineRangeAttributes
+
+
+/*!
+Applies the specified changes to every single attribute
+within the specified range of the screen buffer (no
+effect on the display until the next redraw).  Also
+updates the “current” attributes, if the cursor happens
+to be in the specified range.
+
+The anchor points are automatically “sorted”, so despite
+their names it does not matter which point really marks
+the start or end of the range.
+
+If "inConstrainToRectangle" is true, the range is
+considered to be exact so no columns outside the range
+are filled in (normally, all lines in between the start
+and end points are filled completely, from column 0 to
+the last column).
+
+You can use this to apply effects to a large number of
+characters at once (e.g. when highlighting).
+
+\retval kTerminal_ResultOK
+if the range attributes were changed successfully
+
+\retval kTerminal_ResultInvalidID
+if the specified screen reference is invalid
+
+\retval kTerminal_ResultInvalidIterator
+if the specified row reference is invalid
+
+(3.0)
+*/
+Terminal_Result
+Terminal_ChangeRangeAttributes	(TerminalScreenRef			inRef,
+								 Terminal_LineRef			inStartRow,
+								 UInt32						inNumberOfRowsToConsider,
+								 UInt16						inZeroBasedStartColumn,
+								 UInt16						inZeroBasedPastTheEndColumn,
+								 Boolean					inConstrainToRectangle,
+								 TextAttributes_Object		inSetTheseAttributes,
+								 TextAttributes_Object		inClearTheseAttributes)
+{
+	Terminal_Result			result = kTerminal_ResultOK;
+	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+	My_LineIteratorPtr		iteratorPtr = getLineIterator(inStartRow);
+	
+	
+	// force anchors to be within valid screen boundaries
+	if (inZeroBasedStartColumn >= dataPtr->text.visibleScreen.numberOfColumnsPermitted)
+	{
+		inZeroBasedStartColumn = dataPtr->text.visibleScreen.numberOfColumnsPermitted - 1;
+	}
+	if (inZeroBasedPastTheEndColumn > dataPtr->text.visibleScreen.numberOfColumnsPermitted)
+	{
+		inZeroBasedPastTheEndColumn = dataPtr->text.visibleScreen.numberOfColumnsPermitted;
+	}
+	
+	if (inNumberOfRowsToConsider > 0)
+	{
+		// now apply changes to attributes of all specified cells, and to
+		// the “current” attributes (if the cursor is anywhere in the range)
+		if (nullptr == dataPtr) result = kTerminal_ResultInvalidID;
+		else if (nullptr == iteratorPtr) result = kTerminal_ResultInvalidIterator;
+		else
+		{
+			Boolean const		kSingleLineRange = (1 == inNumberOfRowsToConsider);
+			
+			
+			// figure out how to treat the first line
+			if (kSingleLineRange)
+			{
+				// same line - iterate only over certain columns
+				changeLineRangeAttributes(dataPtr, iteratorPtr->currentLine(), inZeroBasedStartColumn, inZeroBasedPastTheEndColumn,
+											inSetTheseAttributes, inClearTheseAttributes);
+			}
+			else
+			{
+				// multi-line range; start by creating some convenient anchors that
+				// are set correctly based on the rectangular/non-rectangular mode
+				UInt16		lineStartColumn = (inConstrainToRectangle)
+												? inZeroBasedStartColumn
+												: 0;
+				SInt16		linePastTheEndColumn = (inConstrainToRectangle)
+													? inZeroBasedPastTheEndColumn
+													: dataPtr->text.visibleScreen.numberOfColumnsPermitted;
+				Boolean		isEnd = false;
+				
+				
+				// fill in first line
+				changeLineRangeAttributes(dataPtr, iteratorPtr->currentLine(), inZeroBasedStartColumn, linePastTheEndColumn,
+											inSetTheseAttributes, inClearTheseAttributes);
+				iteratorPtr->goToNextLine(isEnd);
+				
+				if (false == isEnd)
+				{
+					// fill in remaining lines; the last line is special
+					// because it will end “early” at the end anchor
+					{
+						SInt16			i = 0;
+						SInt32 const	kLineEnd = (inNumberOfRowsToConsider - 1);
+						
+						
+						for (i = 0; i < kLineEnd; ++i, iteratorPtr->goToNextLine(isEnd))
+						{
+							if (isEnd)
+							{
+								//Console_Warning(Console_WriteLine, "exceeded row boundaries when changing attributes of a range");
+								break;
+							}
+							
+							// intermediate lines occupy the whole range; the last line
+							// only occupies up to the final anchor point
+							if (i < (kLineEnd - 1))
+							{
+								// fill in intermediate line
+								changeLineRangeAttributes(dataPtr, iteratorPtr->currentLine(), lineStartColumn, linePastTheEndColumn,
+															inSetTheseAttributes, inClearTheseAttributes);
+							}
+							else
+							{
+								// fill in last line
+								changeLineRangeAttributes(dataPtr, iteratorPtr->currentLine(), lineStartColumn, inZeroBasedPastTheEndColumn,
+															inSetTheseAttributes, inClearTheseAttributes);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	
+	return result;
+}// ChangeRangeAttributes
+
+
+/*!
+Returns the title assigned to the iconified version of this
+terminal.  In MacTerm this is symbolic, as no assumption is
+made that a terminal corresponds to a single minimized window;
+the exact usage of the “icon title” is not decided by this
+module.
+
+IMPORTANT:	You must eventually use CFRelease() on the returned
+			title string.
+
+(3.0)
+*/
+void
+Terminal_CopyTitleForIcon	(TerminalScreenRef	inRef,
+							 CFStringRef&		outTitle)
+{
+	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+	
+	
+	outTitle = dataPtr->iconTitleCFString.returnCFStringRef();
+	if (outTitle != nullptr)
+	{
+		CFRetain(outTitle);
+	}
+}// CopyTitleForIcon
+
+
+/*!
+Returns the title assigned to the window of this terminal.  In
+MacTerm this is symbolic, as no assumption is made that a
+terminal corresponds to a single window; the exact usage of the
+“window title” is not decided by this module.
+
+IMPORTANT:	You must eventually use CFRelease() on the returned
+			title string.
+
+(3.0)
+*/
+void
+Terminal_CopyTitleForWindow		(TerminalScreenRef	inRef,
+								 CFStringRef&		outTitle)
+{
+	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+	
+	
+	outTitle = dataPtr->windowTitleCFString.returnCFStringRef();
+	if (outTitle != nullptr)
+	{
+		CFRetain(outTitle);
+	}
+}// CopyTitleForWindow
+
+
+/*!
+Returns the zero-based column and line numbers of the
+terminal cursor in the given buffer.  Since the cursor
+is not allowed to enter the scrollback buffer, negative
+return values are not possible.
+
+Pass nullptr for one of the values if you do not want it.
+
+\retval kTerminal_ResultOK
+if no error occurred
+
+\retval kTerminal_ResultInvalidID
+if the specified screen reference is invalid
+
+(3.0)
+*/
+Terminal_Result
+Terminal_CursorGetLocation	(TerminalScreenRef		inRef,
+							 UInt16*				outZeroBasedColumnPtr,
+							 UInt16*				outZeroBasedRowPtr)
+{
+	Terminal_Result				result = kTerminal_ResultOK;
+	My_ScreenBufferConstPtr		dataPtr = getVirtualScreenData(inRef);
+	
+	
+	if (dataPtr == nullptr) result = kTerminal_ResultInvalidID;
+	else
+	{
+		if (outZeroBasedColumnPtr != nullptr) *outZeroBasedColumnPtr = dataPtr->current.cursorX;
+		if (outZeroBasedRowPtr != nullptr) *outZeroBasedRowPtr = STATIC_CAST(dataPtr->current.cursorY, UInt16);
+	}
+	
+	return result;
+}// CursorGetLocation
+
+
+/*!
+Returns "true" only if the terminal cursor is supposed
+to be visible in the specified screen buffer.  This is
+a logical state ONLY, and is set by interaction with the
+terminal emulator.  It is only guaranteed to correspond
+to a rendered cursor by virtue of the callback framework
+that links Terminal Views to screen buffers.
+
+(3.0)
+*/
+Boolean
+Terminal_CursorIsVisible	(TerminalScreenRef		inRef)
+{
+	Boolean						result = false;
+	My_ScreenBufferConstPtr		dataPtr = getVirtualScreenData(inRef);
+	
+	
+	if (nullptr != dataPtr)
+	{
+		result = dataPtr->cursorVisible;
+	}
+	return result;
+}// CursorIsVisible
+
+
+/*!
+Provides all the text attributes of the position currently
+occupied by the cursor.
+
+NOTE:	Admittedly this is a bit of a weird exception (since
+		all other style information is returned as part of a
+		Terminal_ForEachLikeAttributeRun() loop) but the
+		cursor is rendered at unusual times and has a special
+		appearance.
+
+(4.0)
+*/
+TextAttributes_Object
+Terminal_CursorReturnAttributes		(TerminalScreenRef		inRef)
+{
+	My_ScreenBufferPtr			dataPtr = getVirtualScreenData(inRef);
+	TextAttributes_Object		result = dataPtr->current.cursorAttributes;
+	
+	
+	return result;
+}// CursorReturnAttributes
+
+
+/*!
+Writes arbitrary debugging information to the console for the
+specified terminal screen.
+
+(4.0)
+*/
+void
+Terminal_DebugDumpDetailedSnapshot		(TerminalScreenRef		inRef)
+{
+	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+	
+	
+	Console_WriteValuePair("Visible boundary first and last columns", dataPtr->visibleBoundary.firstColumn,
+																		dataPtr->visibleBoundary.lastColumn);
+	Console_WriteValuePair("Visible boundary first and last rows", dataPtr->visibleBoundary.rows.firstRow,
+																	dataPtr->visibleBoundary.rows.lastRow);
+	Console_WriteValuePair("Defined scrolling region first and last rows", dataPtr->customScrollingRegion.firstRow,
+																			dataPtr->customScrollingRegion.lastRow);
+	Console_WriteValuePair("Current scrolling region first and last rows", dataPtr->originRegionPtr->firstRow,
+																			dataPtr->originRegionPtr->lastRow);
+	Console_WriteValue("Mode: ANSI", dataPtr->modeANSIEnabled);
+	Console_WriteValue("Mode: auto-wrap", dataPtr->modeAutoWrap);
+	Console_WriteValue("Mode: bracketed Paste", dataPtr->modeBracketedPaste);
+	Console_WriteValue("Mode: cursor keys for application", dataPtr->modeCursorKeysForApp);
+	Console_WriteValue("Mode: application keys", dataPtr->modeApplicationKeys);
+	Console_WriteValue("Mode: origin redefined", dataPtr->modeOriginRedefined);
+	Console_WriteValue("Mode: insert, not replace", dataPtr->modeInsertNotReplace);
+	Console_WriteValue("Mode: new-line option", dataPtr->modeNewLineOption);
+	Console_WriteValue("Emulator UTF-8 mode", dataPtr->emulator.isUTF8Encoding);
+	Console_WriteValue("Emulator UTF-8 locked", dataPtr->emulator.lockUTF8);
+	Console_WriteValue("Emulator ignores requests to shift character sets", dataPtr->emulator.disableShifts);
+	Console_WriteValue("Emulator accepts 8-bit and 7-bit codes", dataPtr->emulator.is8BitReceiver());
+	Console_WriteValue("Emulator transmits 8-bit codes", dataPtr->emulator.is8BitTransmitter());
+	Console_WriteValueBitFlags("Drawing attributes: current, upper 32 bits", dataPtr->current.drawingAttributes.returnValueInRange(TextAttributes_Object::BitRange(0xFFFFFFFF, 32)));
+	Console_WriteValueBitFlags("Drawing attributes: current, lower 32 bits", dataPtr->current.drawingAttributes.returnValueInRange(TextAttributes_Object::BitRange(0xFFFFFFFF, 0)));
+	Console_WriteValue("Scrollback: lines", dataPtr->scrollbackBuffer.size());
+	Console_WriteValue("Scrollback: compacted lines", dataPtr->scrollbackBuffer.returnCompactLineCount());
+	Console_WriteValue("Scrollback: bytes used by compacted lines", dataPtr->scrollbackBuffer.returnCompactByteCount());
+	Console_WriteValue("Scrollback: bytes used by other lines", dataPtr->scrollbackBuffer.returnExpandedByteCount());
+	Console_WriteValue("Scrollback: bytes that compacted lines would use if restored (no attributes)",
+						dataPtr->scrollbackBuffer.returnCompactLineCount() *
+						(sizeof(TerminalLine_Object) + (dataPtr->lineAllocator.returnCellCapacity() * sizeof(UniChar))));
+	Console_WriteValue("Scrollback: total line compactions", dataPtr->scrollbackBuffer.returnCompactionCount());
+	Console_WriteValue("Scrollback: total line restorations", dataPtr->scrollbackBuffer.returnRestorationCount());
+	if (nullptr != dataPtr->scrollbackBuffer.returnSearchIndex())
+	{
+		Console_WriteValue("Scrollback: bytes used by search index", dataPtr->scrollbackBuffer.returnSearchIndex()->returnByteCount());
+		Console_WriteValue("Scrollback: lines covered by search index", dataPtr->scrollbackBuffer.returnSearchIndex()->returnLineCount());
+	}
+	Console_WriteValue("Snapshots: published", dataPtr->snapshotPublisher.publishCount);
+	Console_WriteValue("Snapshots: latest version", dataPtr->snapshotPublisher.versionCounter);
+	Console_WriteValue("Snapshots: total rows copied", dataPtr->snapshotPublisher.rowCopyCount);
+	{
+		UInt64		dispatchedCount = 0;
+		UInt64		coalescedCount = 0;
+		
+		
+		if (kListenerModel_ResultOK == ListenerModel_GetNotificationCounts(dataPtr->changeListenerModel, &dispatchedCount, &coalescedCount))
+		{
+			Console_WriteValue("Change notifications: dispatched", dispatchedCount);
+			Console_WriteValue("Change notifications: coalesced", coalescedCount);
+		}
+	}
+	// INCOMPLETE - could put just about anything here, whatever is interesting to know
+}// DebugDumpDetailedSnapshot
+
+
+/*!
+Replays the given bytes through a new, scratch terminal screen
+(using default terminal and translation settings) as if they
+had arrived from a session, and writes throughput figures to
+the console: megabytes per second, nanoseconds per byte and
+allocation figures (see below).  The screen is destroyed
+afterwards.
+
+If "inMachineReadable" is true, the figures are instead written
+to standard output as a single line of JSON (one object per
+call, with fixed key names) so that runs can be compared by
+scripts; see Initialize_ApplicationStartup() for how to run the
+benchmark without any user interface.
+
+The data is fed in 4096-byte blocks (the size that is read
+from a local process) and the whole stream is replayed the
+given number of times on the same screen, so that scrollback
+is exercised as well.  Useful inputs are captures of “vttest”,
+“ls -lR”, “htop” frames or 24-bit color images.
+
+Allocations are counted by temporarily hooking the default
+malloc zone (see setBenchmarkZoneHooksEnabled()), so every
+"malloc", "new" and Core Foundation allocation is seen; since
+the hooks are process-wide, allocations by other threads during
+the run are included as well (this is why the benchmark is best
+run headless).  Also reported are the number of slabs that the
+line allocator of the screen obtained (see TerminalLine_Allocator)
+and the net growth of memory in use by all malloc zones.
+
+\retval kTerminal_ResultOK
+if the benchmark ran
+
+\retval kTerminal_ResultParameterError
+if the buffer is empty or the iteration count is zero
+
+\retval kTerminal_ResultNotEnoughMemory
+if the scratch screen could not be created
+
+(2023.10)
+*/
+Terminal_Result
+Terminal_DebugRunThroughputBenchmark	(CFStringRef		inDescription,
+										 UInt8 const*		inBuffer,
+										 size_t				inLength,
+										 UInt16				inIterationCount,
+										 Boolean			inMachineReadable)
+{
+	Terminal_Result		result = kTerminal_ResultOK;
+	
+	
+	if ((nullptr == inBuffer) || (0 == inLength) || (0 == inIterationCount))
+	{
+		result = kTerminal_ResultParameterError;
+	}
+	else
+	{
+		Preferences_ContextWrap		terminalConfig(Preferences_NewContext(Quills::Prefs::TERMINAL),
+													Preferences_ContextWrap::kAlreadyRetained);
+		Preferences_ContextWrap		translationConfig(Preferences_NewContext(Quills::Prefs::TRANSLATION),
+														Preferences_ContextWrap::kAlreadyRetained);
+		TerminalScreenRef			screen = nullptr;
+		
+		
+		result = Terminal_NewScreen(terminalConfig.returnRef(), translationConfig.returnRef(), &screen);
+		if (kTerminal_ResultOK == result)
+		{
+			size_t const		kBlockSize = 4096; // see "threadForLocalProcessDataLoop()" in "Local.cp"
+			UInt64 const		kTotalBytes = (STATIC_CAST(inLength, UInt64) * inIterationCount);
+			My_ScreenBufferPtr	dataPtr = getVirtualScreenData(screen);
+			size_t const		kInitialSlabCount = dataPtr->lineAllocator.returnSlabCount();
+			malloc_statistics_t	initialHeapStatistics;
+			malloc_statistics_t	finalHeapStatistics;
+			UInt64				allocationCount = 0;
+			UInt64				allocatedByteCount = 0;
+			size_t				slabCount = 0;
+			Boolean				isCounting = false;
+			CFAbsoluteTime		startTime = 0;
+			CFAbsoluteTime		elapsedTime = 0;
+			
+			
+			malloc_zone_statistics(nullptr/* all zones */, &initialHeapStatistics);
+			gBenchmarkAllocationCount() = 0;
+			gBenchmarkAllocatedByteCount() = 0;
+			isCounting = setBenchmarkZoneHooksEnabled(true);
+			startTime = CFAbsoluteTimeGetCurrent();
+			for (UInt16 i = 0; i < inIterationCount; ++i)
+			{
+				for (size_t offset = 0; offset < inLength; offset += kBlockSize)
+				{
+					UNUSED_RETURN(Terminal_Result)Terminal_EmulatorProcessData(screen, inBuffer + offset,
+																				std::min(kBlockSize, inLength - offset));
+				}
+			}
+			elapsedTime = (CFAbsoluteTimeGetCurrent() - startTime);
+			if (isCounting)
+			{
+				UNUSED_RETURN(Boolean)setBenchmarkZoneHooksEnabled(false);
+			}
+			allocationCount = gBenchmarkAllocationCount();
+			allocatedByteCount = gBenchmarkAllocatedByteCount();
+			slabCount = (dataPtr->lineAllocator.returnSlabCount() - kInitialSlabCount);
+			malloc_zone_statistics(nullptr/* all zones */, &finalHeapStatistics);
+			
+			Terminal_ReleaseScreen(&screen);
+			
+			// report results
+			{
+				double const		kHeapGrowth = (STATIC_CAST(finalHeapStatistics.size_in_use, double) -
+													STATIC_CAST(initialHeapStatistics.size_in_use, double));
+				double const		kMegabytesPerSecond = ((elapsedTime > 0)
+															? ((kTotalBytes / (1024.0 * 1024.0)) / elapsedTime)
+															: 0);
+				double const		kNanosecondsPerByte = ((elapsedTime * 1.0e9) / kTotalBytes);
+				std::ostringstream	reportSS;
+				std::string			reportStr;
+				
+				
+				if (inMachineReadable)
+				{
+					CFRetainRelease		descriptionUTF8((nullptr != inDescription)
+														? CFStringCreateExternalRepresentation
+															(kCFAllocatorDefault, inDescription, kCFStringEncodingUTF8, '?')
+														: nullptr,
+														CFRetainRelease::kAlreadyRetained);
+					
+					
+					reportSS << "{\"description\":\"";
+					if (descriptionUTF8.exists())
+					{
+						CFDataRef	asData = descriptionUTF8.returnCFDataRef();
+						
+						
+						for (CFIndex i = 0; i < CFDataGetLength(asData); ++i)
+						{
+							char const		kByte = STATIC_CAST(CFDataGetBytePtr(asData)[i], char);
+							
+							
+							if (('"' == kByte) || ('\\' == kByte))
+							{
+								reportSS << '\\' << kByte;
+							}
+							else if (STATIC_CAST(kByte, UInt8) >= 0x20)
+							{
+								reportSS << kByte;
+							}
+						}
+					}
+					reportSS << "\",\"bytes\":" << kTotalBytes
+								<< ",\"iterations\":" << inIterationCount
+								<< ",\"seconds\":" << elapsedTime
+								<< ",\"megabytes_per_second\":" << kMegabytesPerSecond
+								<< ",\"nanoseconds_per_byte\":" << kNanosecondsPerByte;
+					if (isCounting)
+					{
+						reportSS << ",\"allocations\":" << allocationCount
+									<< ",\"allocations_per_byte\":" << (STATIC_CAST(allocationCount, double) / kTotalBytes)
+									<< ",\"allocated_bytes\":" << allocatedByteCount;
+					}
+					else
+					{
+						reportSS << ",\"allocations\":null,\"allocations_per_byte\":null,\"allocated_bytes\":null";
+					}
+					reportSS << ",\"line_slabs\":" << slabCount
+								<< ",\"heap_growth_bytes\":" << kHeapGrowth
+								<< "}\n";
+					reportStr = reportSS.str();
+					UNUSED_RETURN(int)std::fputs(reportStr.c_str(), stdout);
+					UNUSED_RETURN(int)std::fflush(stdout);
+				}
+				else
+				{
+					Console_WriteValueCFString("Terminal throughput benchmark", inDescription);
+					reportSS << "  " << kTotalBytes << " bytes in " << elapsedTime << " s: "
+								<< kMegabytesPerSecond << " MB/s, "
+								<< kNanosecondsPerByte << " ns/byte";
+					reportStr = reportSS.str();
+					Console_WriteLine(reportStr.c_str());
+					reportSS.str("");
+					if (isCounting)
+					{
+						reportSS << "  " << allocationCount << " allocations ("
+									<< (STATIC_CAST(allocationCount, double) / kTotalBytes) << " per byte, "
+									<< allocatedByteCount << " bytes requested; all threads)";
+					}
+					else
+					{
+						reportSS << "  allocation count unavailable (unable to hook the default malloc zone)";
+					}
+					reportStr = reportSS.str();
+					Console_WriteLine(reportStr.c_str());
+					reportSS.str("");
+					reportSS << "  " << slabCount << " line slabs allocated, "
+								<< kHeapGrowth << " bytes of heap growth (all threads)";
+					reportStr = reportSS.str();
+					Console_WriteLine(reportStr.c_str());
+				}
+			}
+		}
+	}
+	
+	return result;
+}// DebugRunThroughputBenchmark
+
+
+/*!
+Destroys all scrollback buffer lines.  The “visible”
+lines are not affected.  This obviously invalidates any
+iterators pointing to scrollback lines.
+
+It follows that after invoking this routine, the return
+value of Terminal_ReturnInvisibleRowCount() should be zero.
+
+This triggers two events: "kTerminal_ChangeScrollActivity"
+to indicate that data has been removed, and also
+"kkTerminal_ChangeTextRemoved" (given a range consisting of
+all previous scrollback lines).
+
+(3.1)
+*/
+void
+Terminal_DeleteAllSavedLines	(TerminalScreenRef		inRef)
+{
+	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+	
+	
+	if (dataPtr != nullptr)
+	{
+		SInt16 const	kPreviousScrollbackCount = STATIC_CAST(dataPtr->scrollbackBuffer.size(), SInt16);
+		
+		
+		++(dataPtr->backgroundSearch.invalidationCount); // stop any search in progress
+		dataPtr->scrollbackBuffer.clear();
+		releaseUnusedImages(dataPtr);
+		
+		// notify listeners of the range of text that has gone away
+		{
+			Terminal_RangeDescription	range;
+			
+			
+			range.screen = dataPtr->selfRef;
+			range.firstRow = -kPreviousScrollbackCount;
+			range.firstColumn = 0;
+			range.columnCount = dataPtr->text.visibleScreen.numberOfColumnsPermitted;
+			range.rowCount = kPreviousScrollbackCount;
+			
+			changeNotifyForTerminal(dataPtr, kTerminal_ChangeTextRemoved, &range/* context */);
+		}
+		
+		// notify listeners that scroll activity has taken place,
+		// though technically no remaining lines have been affected
+		{
+			Terminal_ScrollDescription	scrollInfo;
+			
+			
+			bzero(&scrollInfo, sizeof(scrollInfo));
+			scrollInfo.screen = dataPtr->selfRef;
+			scrollInfo.rowDelta = 0;
+			changeNotifyForTerminal(dataPtr, kTerminal_ChangeScrollActivity, &scrollInfo/* context */);
+		}
+	}
+}// DeleteAllSavedLines
+
+
+/*!
+Sends a stream of characters originating in a
+C-style string to the specified screen’s terminal
+emulator, interpreting escape sequences, etc.
+which may affect the terminal display.
+
+USE WITH CARE.  Generally, you send data to this
+routine that comes directly from a program that
+knows what it’s doing.  There are more elegant
+ways to have specific effects on terminal screens
+in an emulator-independent fashion; you should
+use those routines before hacking up a string as
+input to this routine.
+
+\retval kTerminal_ResultOK
+if the text is processed without errors
+
+\retval kTerminal_ResultInvalidID
+if the given terminal screen reference is invalid
+
+(3.0)
+*/
+Terminal_Result
+Terminal_EmulatorProcessCString		(TerminalScreenRef	inRef,
+									 char const*		inCString)
+{
+	return Terminal_EmulatorProcessData(inRef, REINTERPRET_CAST(inCString, UInt8 const*), CPP_STD::strlen(inCString));
+}// EmulatorProcessCString
+
+
+/*!
+Sends a stream of characters to the specified screen’s terminal
+emulator, interpreting escape sequences, etc. which may affect
+the terminal display.
+
+The given buffer is considered a fragment of an infinite stream
+that continues from text sent by previous calls.  So, do not
+assume that "inBuffer" will be the start or end of anything in
+particular!  For example, if the previous byte stream ended with
+an incomplete multi-byte code point then the first few bytes of
+"inBuffer" may act as the terminator of the previous sequence.
+
+If the encoding, as set by Terminal_SetTextEncoding(), is UTF-8
+then the specified buffer is decoded BEFORE any bytes are
+examined for things like control characters.  (Text in the 7-bit
+range of ASCII is considered valid UTF-8 and acts the same in
+any case.)  If you intend to include special sequences such as
+8-bit control characters, you MUST ensure they are encoded as
+proper multi-byte sequences in UTF-8 terminals.
+
+USE WITH CARE.  Generally, you send data to this routine that
+comes directly from a program that knows what it’s doing.  There
+are more elegant ways to have specific effects on terminal
+screens in an emulator-independent fashion; you should use those
+approaches before hacking up a string as input to this routine.
+
+\retval kTerminal_ResultOK
+if the text is processed without errors
+
+\retval kTerminal_ResultInvalidID
+if the given terminal screen reference is invalid
+
+(3.0)
+*/
+Terminal_Result
+Terminal_EmulatorProcessData	(TerminalScreenRef	inRef,
+								 UInt8 const*		inBuffer,
+								 size_t				inLength)
+{
+	Terminal_Result		result = kTerminal_ResultOK;
+	
+	
+	if (0 != inLength)
+	{
+		My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+		
+		
+		if (nullptr == dataPtr)
+		{
+			result = kTerminal_ResultInvalidID;
+		}
+		else if (dataPtr->backgroundSearch.count > 0)
+		{
+			// new data would move rows that are being searched; it is
+			// processed as soon as the search ends (see backgroundSearchEnd())
+			dataPtr->backgroundSearch.deferredInput.append(inBuffer, inLength);
+		}
+		else
+		{
+			Boolean const	kIsUTF8 = (kCFStringEncodingUTF8 == dataPtr->emulator.inputTextEncoding);
+			UInt8 const*	ptr = inBuffer;
+			UInt32			countRead = 0;
+			Boolean const	kLogsInputChar = DebugInterface_LogsTerminalInputChar();
+			
+			
+			// hide cursor momentarily
+			setCursorVisible(dataPtr, false);
 			
 			// interpret the character stream, one character at a time; NOTE that
 			// since this is just a slice of a continuous and infinite stream,
@@ -2905,6 +4967,29 @@ Terminal_EmulatorProcessData	(TerminalScreenRef	inRef,
 				Boolean		skipEmulators = false;
 				
 				
+				// fast path: while accumulating for echo, plain printable text
+				// cannot cause a state change, so an entire run of it can be
+				// copied directly instead of being dispatched byte by byte
+				// (in UTF-8, this includes any valid non-control sequences);
+				// the last byte of the buffer is always left for the normal
+				// path below, so that the usual end-of-buffer flush occurs
+				if ((kMy_ParserStateAccumulateForEcho == dataPtr->emulator.currentState) &&
+					(i > 1) && (false == kLogsInputChar) &&
+					(false == dataPtr->emulator.multiByteDecoder.incompleteSequence()))
+				{
+					size_t const	kRunLength = ((kIsUTF8)
+													? returnPrintableUTF8RunLength(ptr, i - 1)
+													: returnPrintableRunLength(ptr, i - 1));
+					
+					
+					if (kRunLength > 0)
+					{
+						dataPtr->bytesToEcho.append(ptr, kRunLength);
+						i -= kRunLength;
+						ptr += kRunLength;
+					}
+				}
+				
 				dataPtr->emulator.recentCodePointByte = *ptr;
 				
 				// when UTF-8 is in use, the stream is decoded BEFORE anything processes
@@ -3026,21 +5111,14 @@ Terminal_EmulatorProcessData	(TerminalScreenRef	inRef,
 									{
 										interrupt = (dataPtr->emulator.stateRepetitions > 255/* arbitrary */);
 									}
-									else if (states.second == My_VT220::kStateDCSAcquireStr)
+									else if ((states.second == My_VT220::kStateDCSAcquireStr) ||
+												(states.second == My_ITermCore::kStateITermAcquireStr))
 									{
-										// arbitrarily allow massive image data sizes (TEMPORARY; make user-configurable?)
-										static UInt64 const		kMaxBytesPerImage = (20 * 1024 * 1024);
-										
-										
-										interrupt = (dataPtr->emulator.stateRepetitions > kMaxBytesPerImage);
-									}
-									else if (states.second == My_ITermCore::kStateITermAcquireStr)
-									{
-										// arbitrarily allow massive image data sizes (TEMPORARY; make user-configurable?)
-										static UInt64 const		kMaxBytesITerm2 = (20 * 1024 * 1024);
-										
-										
-										interrupt = (dataPtr->emulator.stateRepetitions > kMaxBytesITerm2);
+										// strings whose contents are streamed (such as image data) can
+										// be any size, since only a piece is in memory at any time;
+										// other strings are limited because they are kept in full
+										interrupt = ((nil == dataPtr->emulator.payloadHandler) &&
+														(dataPtr->emulator.stringAccumulator.size() > kMy_StringAccumulatorMaximum));
 									}
 								}
 								
@@ -3248,6 +5326,9 @@ Terminal_EmulatorProcessData	(TerminalScreenRef	inRef,
 			
 			// restore cursor
 			setCursorVisible(dataPtr, true);
+			
+			// images may have been erased or scrolled away
+			releaseUnusedImages(dataPtr);
 		}
 		
 		// to minimize spam, count certain classes of data error in
@@ -3593,93 +5674,22 @@ Terminal_ForEachLikeAttributeRun	(TerminalScreenRef			inRef,
 	}
 	else
 	{
-		// need to search line for style chunks
-		My_ScreenBufferLine&						currentLine = iteratorPtr->currentLine();
-		TerminalLine_TextIterator					textIterator = nullptr;
-		TerminalLine_TextAttributesList const&		currentAttributeVector = currentLine.returnAttributeVector();
-		auto										attrIterator = currentAttributeVector.begin();
-		TextAttributes_Object						previousAttributes;
-		TextAttributes_Object						currentAttributes;
-		SInt16										runStartCharacterIndex = 0;
-		SInt16										characterIndex = 0;
-		size_t										styleRunLength = 0;
+		My_ScreenBufferLine&	currentLine = iteratorPtr->currentLine();
 		
 		
 	#if 0
-		// DEBUGGING ONLY: if you suspect a bug in the incremental loop below,
-		// try asking the entire line to be drawn without formatting, first
+		// DEBUGGING ONLY: if you suspect a bug in the incremental loop of
+		// forEachLikeAttributeRunInLine(), try asking the entire line to be
+		// drawn without formatting, first
 		inDoWhat(CFStringGetLength(currentLine.returnCFStringRef()),
-					currentLine.returnCFStringRef(),
-					inStartRow,
-					0/* zero-based start column */,
-					currentLine.returnGlobalAttributes());
-	#endif
-		
-		// TEMPORARY - HIGHLY inefficient to search here, need to change this into a cache
-		//             (in fact, attribute bit arrays can probably be completely replaced by
-		//             style runs at some point in the future)
-		assert(nullptr != currentLine.textVectorBegin);
-		for (textIterator = currentLine.textVectorBegin,
-					attrIterator = currentAttributeVector.begin();
-				(textIterator != currentLine.textVectorEnd) &&
-					(attrIterator != currentAttributeVector.end());
-				++textIterator, ++attrIterator, ++characterIndex)
-		{
-			currentAttributes = *attrIterator;
-			if ((currentAttributes != previousAttributes) ||
-				(characterIndex == STATIC_CAST(CFStringGetLength(currentLine.returnCFStringRef()) - 1, SInt16)) ||
-				(characterIndex == STATIC_CAST(currentAttributeVector.size() - 1, SInt16)))
-			{
-				styleRunLength = characterIndex - runStartCharacterIndex;
-				
-				// found new style run; so handle the previous run
-				if (styleRunLength > 0)
-				{
-					TextAttributes_Object		rangeAttributes = previousAttributes;
-					NSRange						runRange = NSMakeRange(runStartCharacterIndex, styleRunLength);
-					CFStringRef					lineAsCFString = currentLine.returnCFStringRef();
-					NSString*					lineAsNSString = BRIDGE_CAST(lineAsCFString, NSString*);
-					NSString*					styleRunSubstring = [lineAsNSString substringWithRange:runRange];
-					
-					
-					rangeAttributes.addAttributes(currentLine.returnGlobalAttributes());
-					inDoWhat(STATIC_CAST(styleRunLength, UInt16)/* length */,
-								BRIDGE_CAST(styleRunSubstring, CFStringRef),
-								inStartRow,
-								runStartCharacterIndex/* zero-based start column */,
-								rangeAttributes);
-				}
-				
-				// reset for next run
-				previousAttributes = currentAttributes;
-				runStartCharacterIndex = characterIndex;
-			}
-		}
-		
-		// ask that the remainder of the line be handled as if it were blank
-		if (textIterator != currentLine.textVectorEnd)
-		{
-			styleRunLength = std::distance(textIterator, currentLine.textVectorEnd);
-			
-			// found new style run; so handle the previous run
-			if (styleRunLength > 0)
-			{
-				TextAttributes_Object		attributesForRemainder = currentLine.returnGlobalAttributes();
-				
-				
-				// the “selected” attribute is special; it persists regardless
-				if (previousAttributes.hasAttributes(kTextAttributes_Selected))
-				{
-					attributesForRemainder.addAttributes(kTextAttributes_Selected);
-				}
-				
-				inDoWhat(STATIC_CAST(styleRunLength, UInt16)/* length */,
-							nullptr/* text buffer, for non-blank space */,
-							inStartRow,
-							runStartCharacterIndex/* zero-based start column */,
-							attributesForRemainder);
-			}
-		}
+					currentLine.returnCFStringRef(),
+					inStartRow,
+					0/* zero-based start column */,
+					currentLine.returnGlobalAttributes());
+	#endif
+		
+		forEachLikeAttributeRunInLine(currentLine.returnCFStringRef(), currentLine.returnAttributeRuns(),
+										currentLine.returnGlobalAttributes(), inStartRow, inDoWhat);
 	}
 	return result;
 }// ForEachLikeAttributeRun
@@ -4169,6 +6179,129 @@ Terminal_PasteIsBracketed		(TerminalScreenRef	inRef)
 }// PasteIsBracketed
 
 
+/*!
+Returns an immutable copy of the main screen rows of the
+given terminal, for drawing.  The snapshot stays valid (and
+unchanged) for as long as it is retained, no matter what
+happens to the terminal afterwards.
+
+Publication costs time proportional to the number of rows
+that changed since the previous snapshot: unchanged rows are
+shared, and if nothing changed at all then the previous
+snapshot itself is returned (with the same version).
+
+The result is empty if the screen is invalid or memory is
+exhausted; callers should then read the screen directly.
+
+This must be called on the main thread, since it reads the
+live buffer (see the note on Terminal_Snapshot).
+
+(2023.10)
+*/
+Terminal_SnapshotPtr
+Terminal_PublishSnapshot	(TerminalScreenRef		inRef)
+{
+	Terminal_SnapshotPtr	result;
+	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+	
+	
+	if (nullptr != dataPtr)
+	{
+		My_SnapshotPublisher&	publisher = dataPtr->snapshotPublisher;
+		size_t const			kRowCount = dataPtr->screenBuffer.size();
+		Boolean					isUnchanged = false;
+		
+		
+		if ((nullptr == publisher.latestSnapshot) || (kRowCount != publisher.latestSnapshot->rows.size()))
+		{
+			publisher.markAllRowsChanged();
+		}
+		
+		// the previous snapshot can be reused only if every row is
+		// still in the same place and none were marked
+		isUnchanged = ((false == publisher.allRowsChanged) && (kRowCount == publisher.sourceRows.size()));
+		for (size_t i = 0; ((isUnchanged) && (i < kRowCount)); ++i)
+		{
+			isUnchanged = (STATIC_CAST(i, SInt32) == publisher.sourceRows[i]);
+		}
+		
+		if (isUnchanged)
+		{
+			// nothing changed; the previous snapshot is still accurate
+			result = publisher.latestSnapshot;
+		}
+		else
+		{
+			try
+			{
+				std::shared_ptr< Terminal_Snapshot >	newSnapshot = std::make_shared< Terminal_Snapshot >();
+				size_t									rowIndex = 0;
+				
+				
+				newSnapshot->version = ++(publisher.versionCounter);
+				newSnapshot->rows.reserve(kRowCount);
+				for (auto const& lineInfo : dataPtr->screenBuffer)
+				{
+					if ((publisher.allRowsChanged) || (rowIndex >= publisher.sourceRows.size()) ||
+						(My_SnapshotPublisher::kChangedRow == publisher.sourceRows[rowIndex]))
+					{
+						newSnapshot->rows.push_back(std::make_shared< My_SnapshotRow const >(*lineInfo, newSnapshot->version));
+						++(publisher.rowCopyCount);
+					}
+					else
+					{
+						// unchanged (but possibly moved) row
+						newSnapshot->rows.push_back(publisher.latestSnapshot->rows[publisher.sourceRows[rowIndex]]);
+					}
+					++rowIndex;
+				}
+				
+				publisher.sourceRows.resize(kRowCount);
+				std::iota(publisher.sourceRows.begin(), publisher.sourceRows.end(), 0);
+				publisher.allRowsChanged = false;
+				publisher.latestSnapshot = newSnapshot;
+				++(publisher.publishCount);
+				result = newSnapshot;
+			}
+			catch (std::bad_alloc const&)
+			{
+				// the rows remain marked, so the next attempt copies them
+				Console_Warning(Console_WriteLine, "not enough memory to publish terminal snapshot");
+			}
+		}
+	}
+	return result;
+}// PublishSnapshot
+
+
+/*!
+Removes every "kTerminal_WideCharacterContinuation" from
+the given range of text, which usually came from a line of
+the terminal (see Terminal_GetLineRange()).  Any text that
+leaves the terminal, such as copied text, should not have
+these placeholders.  Returns the number of placeholders
+that were removed.
+
+(2023.10)
+*/
+CFIndex
+Terminal_RemoveWideCharacterContinuations	(CFMutableStringRef		inoutText,
+											 CFRange				inRange)
+{
+	UniChar const		kPlaceholder = kTerminal_WideCharacterContinuation;
+	CFRetainRelease		placeholderString(CFStringCreateWithCharacters(kCFAllocatorDefault, &kPlaceholder, 1),
+											CFRetainRelease::kAlreadyRetained);
+	CFIndex				result = 0;
+	
+	
+	if (placeholderString.exists())
+	{
+		result = CFStringFindAndReplace(inoutText, placeholderString.returnCFStringRef(), CFSTR(""), inRange, 0/* comparison options */);
+	}
+	return result;
+}// RemoveWideCharacterContinuations
+
+
 /*!
 Resets the indicated terminal settings to their default
 states.  Pass "kTerminal_ResetFlagsAll" to do a standard
@@ -4192,8 +6325,10 @@ Terminal_Reset		(TerminalScreenRef		inRef,
 		//             and nothing more
 		if (inFlags == kTerminal_ResetFlagsAll)
 		{
+			++(dataPtr->backgroundSearch.invalidationCount); // stop any search in progress
 			setCursorVisible(dataPtr, false);
 			resetTerminal(dataPtr); // homes cursor, among other things
+			releaseUnusedImages(dataPtr);
 			setCursorVisible(dataPtr, true);
 			// ensure cursor is in visible screen area in all views - UNIMPLEMENTED
 		}
@@ -4204,7 +6339,9 @@ Terminal_Reset		(TerminalScreenRef		inRef,
 /*!
 Returns the maximum number of columns allowed
 (useful in order to limit a text field in a
-dialog box, for example).
+dialog box, for example).  Terminals do not
+allocate this many cells per line unless they
+are actually this wide.
 
 (3.0)
 */
@@ -4314,7 +6451,7 @@ Terminal_ReturnInvisibleRowCount	(TerminalScreenRef		inRef)
 	
 	if (nullptr != dataPtr)
 	{
-		result = STATIC_CAST(dataPtr->scrollbackBufferCachedSize, UInt32);
+		result = STATIC_CAST(dataPtr->scrollbackBuffer.size(), UInt32);
 	}
 	return result;
 }// ReturnInvisibleRowCount
@@ -4443,17 +6580,14 @@ Terminal_SaveLinesOnClearIsEnabled		(TerminalScreenRef		inRef)
 /*!
 Searches the specified terminal screen buffer using the given
 query and flags as a guide, and returns zero or more matches.
-All matching ranges are returned.
+All matching ranges are returned, with the main screen first
+(top to bottom) and then the scrollback (newest to oldest).
 
-Multiple threads may be spawned to perform searches of the
-terminal buffer but they will all terminate before this routine
-returns.
-
-This is not guaranteed to be perfectly efficient; in particular,
-currently the internal implementation needs to copy data in order
-to pass it to the scanner.  In the future, if the internal
-storage format is made to match that of the search engine, the
-search may be faster.
+This is a convenience for Terminal_SearchIncrementally(),
+which should be used instead if the results can be handled
+in pieces (such as highlighting them) since the first
+matches are then available before the entire buffer has
+been searched.
 
 \retval kTerminal_ResultOK
 if no error occurs
@@ -4464,9 +6598,6 @@ if the given terminal screen reference is invalid
 \retval kTerminal_ResultParameterError
 if the query string is invalid or an unrecognized flag is given
 
-\retval kTerminal_ResultNotEnoughMemory
-if the buffer is too large to search
-
 (3.1)
 */
 Terminal_Result
@@ -4474,250 +6605,208 @@ Terminal_Search		(TerminalScreenRef							inRef,
 					 CFStringRef								inQuery,
 					 Terminal_SearchFlags						inFlags,
 					 std::vector< Terminal_RangeDescription >&	outMatches)
+{
+	std::vector< Terminal_RangeDescription >*	matchesPtr = &outMatches; // (blocks cannot capture references)
+	Terminal_Result								result = Terminal_SearchIncrementally
+															(inRef, inQuery, inFlags,
+																^(std::vector< Terminal_RangeDescription > const& inMatchBatch,
+																	Boolean& UNUSED_ARGUMENT(outStopSearch))
+																{
+																	matchesPtr->insert(matchesPtr->end(), inMatchBatch.begin(), inMatchBatch.end());
+																});
+	
+	
+	return result;
+}// Search
+
+
+/*!
+Like Terminal_SearchIncrementally(), except that the search
+is done by other threads and this routine returns as soon as
+it has started.  This must be called on the main thread.
+
+The results handler is invoked on the main queue for every
+batch of matches, in the usual order.  Unlike the handler of
+Terminal_SearchIncrementally(), it may change the terminal
+(such as by highlighting the matches): the threads of the
+search only read the buffer while the main thread is waiting
+for events.  If rows are rearranged in the meantime (e.g. by
+resizing or resetting the terminal) the search stops, and no
+more batches are delivered.
+
+The cancel block, if any, is invoked regularly on another
+thread; so it must not do anything but read a value that is
+safe to use from any thread (such as a "std::atomic").
+
+Until the search ends, data given to the terminal is held
+and any reflow of the scrollback is paused, since both would
+move rows that are being searched; they resume as soon as
+the last search of the terminal ends.  The completion block
+(if any) is then invoked on the main queue, after the last
+batch, whether or not the search finished.
+
+The screen is retained until the search ends.
+
+\retval kTerminal_ResultOK
+if the search has started
+
+\retval kTerminal_ResultInvalidID
+if the given terminal screen reference is invalid
+
+\retval kTerminal_ResultParameterError
+if the query string is invalid or an unrecognized flag is given
+
+(2023.10)
+*/
+Terminal_Result
+Terminal_SearchInBackground		(TerminalScreenRef					inRef,
+								 CFStringRef						inQuery,
+								 Terminal_SearchFlags				inFlags,
+								 Terminal_SearchResultsBlock		inResultsHandler,
+								 Terminal_SearchCancelBlock			inCancelBlockOrNull,
+								 Terminal_SearchCompletionBlock		inCompletionBlockOrNull)
 {
 	My_ScreenBufferPtr	dataPtr = getVirtualScreenData(inRef);
 	Terminal_Result		result = kTerminal_ResultOK;
 	
 	
+	assert([NSThread isMainThread]);
 	if (nullptr == dataPtr) result = kTerminal_ResultInvalidID;
-	else if (nullptr == inQuery) result = kTerminal_ResultParameterError;
-	else if (kTerminal_ResultOK == result)
-	{
-		typedef std::vector< Terminal_RangeDescription >	RangeDescriptionVector;
-		CFStringRef					actualQuery = inQuery; // usually the same but could change below
-		CFOptionFlags				searchFlags = 0;
-		NSRegularExpressionOptions	regExOptions = 0;
-		Boolean						isRegEx = (0 != (inFlags & kTerminal_SearchFlagsRegularExpression));
-		pthread_attr_t				threadAttributes;
-		pthread_t					threadList[] =
-									{
-										// size according to maximum number of scrollback-search threads
-										nullptr,
-										nullptr,
-										nullptr,
-										nullptr,
-										nullptr
-									};
-		size_t const				kMaxThreads = sizeof(threadList) / sizeof(pthread_t);
-		RangeDescriptionVector*		matchVectorsList[] =
-									{
-										// one per thread, same size as "threadList"
-										nullptr,
-										nullptr,
-										nullptr,
-										nullptr,
-										nullptr
-									};
-		int							threadResult = 0;
-		Boolean						threadOK = true;
-		
+	else if ((nullptr == inQuery) || (nullptr == inResultsHandler)) result = kTerminal_ResultParameterError;
+	else
+	{
+		// the search is prepared here because the main thread has
+		// exclusive access to the buffer until it waits for events
+		My_SearchPtr	searchPtr = std::make_shared< My_Search >(dataPtr, inQuery, inFlags, true/* is in background */);
 		
-		// translate given flags to Core Foundation String search flags
-		if (0 == (inFlags & kTerminal_SearchFlagsCaseSensitive))
-		{
-			searchFlags |= kCFCompareCaseInsensitive;
-			regExOptions |= NSRegularExpressionCaseInsensitive;
-		}
-		if (inFlags & kTerminal_SearchFlagsSearchBackwards)
-		{
-			searchFlags |= kCFCompareBackwards;
-		}
-		if (inFlags & kTerminal_SearchFlagsMatchOnlyAtLineEnd)
-		{
-			NSCharacterSet*		newlineSet = [NSCharacterSet characterSetWithCharactersInString:@"\n\r\0"];
-			NSString*			asNSString = BRIDGE_CAST(actualQuery, NSString*);
-			
-			
-			searchFlags |= (kCFCompareAnchored | kCFCompareBackwards);
-			
-			// also strip any new-lines that may be at the end of the query string
-			// (technically this call strips the characters from ANYWHERE in the
-			// query but realistically they would only appear at the end and this
-			// is simpler than manually creating a copy of the string and stripping
-			// only ending characters that match)
-			actualQuery = BRIDGE_CAST([asNSString stringByTrimmingCharactersInSet:newlineSet], CFStringRef);
-			//NSLog(@"actual query changed to “%@”", (NSString*)actualQuery); // debug
-		}
 		
-		threadResult = pthread_attr_init(&threadAttributes);
-		if (-1 == threadResult)
+		if (false == searchPtr->isValid())
 		{
-			Console_Warning(Console_WriteValue, "failed to initialize thread attributes, errno", errno);
-			threadOK = false;
+			result = kTerminal_ResultParameterError;
 		}
 		else
 		{
-			threadResult = pthread_attr_setdetachstate(&threadAttributes, PTHREAD_CREATE_JOINABLE);
-			if (-1 == threadResult)
-			{
-				Console_Warning(Console_WriteValue, "failed to mark thread as 'joinable', errno", errno);
-				threadOK = false;
-			}
-			threadResult = pthread_attr_setstacksize(&threadAttributes, 1024/* arbitrary but needs to suffice! */);
-			if (-1 == threadResult)
-			{
-				Console_Warning(Console_WriteValue, "failed to set thread stack size, errno", errno);
-				threadOK = false;
-			}
-		}
-		
-		// threads are spawned to perform search in parallel; the first thread
-		// searches the main screen, and all subsequent threads search every
-		// Nth line of the scrollback buffer (e.g. if there are 3 scrollback
-		// threads, the first searches scrollback line 0, 3, 6, ..., the 2nd
-		// searches line 1, 4, 7, and so on); in this way it is relatively
-		// easy to experiment with additional threads to see where the best
-		// performance lies, as the search results should always be OK
-		if (threadOK)
-		{
-			My_SearchThreadContextPtr	threadContextPtr = nullptr;
+			TerminalScreenRef	screen = inRef;
 			
 			
-			matchVectorsList[0] = new RangeDescriptionVector();
-			
-			threadContextPtr = new My_SearchThreadContext; // contains C++ classes, must use "new"
-			threadContextPtr->screenBufferPtr = dataPtr;
-			threadContextPtr->matchesVectorPtr = matchVectorsList[0];
-			threadContextPtr->queryCFString = actualQuery;
-			threadContextPtr->searchFlags = searchFlags;
-			threadContextPtr->regExOptions = regExOptions;
-			threadContextPtr->isRegularExpression = isRegEx;
-			threadContextPtr->threadNumber = 0;
-			threadContextPtr->rangeStart = dataPtr->screenBuffer.begin();
-			threadContextPtr->startRowIndex = 0;
-			threadContextPtr->rowCount = STATIC_CAST(dataPtr->screenBuffer.size(), UInt32);
-			
-			threadResult = pthread_create(&threadList[0], &threadAttributes,
-											threadForTerminalSearch, threadContextPtr);
-			if (-1 == threadResult)
-			{
-				Console_Warning(Console_WriteValue, "failed to create thread 0, errno", errno);
-				threadOK = false;
-			}
-		}
-		if (false == dataPtr->scrollbackBuffer.empty())
-		{
-			size_t const	kScrollbackSize = dataPtr->scrollbackBufferCachedSize;
-			UInt16			scrollbackThreadCount = 1;
-			
-			
-			// set arbitrary thread allocations based on how big the search space is
-			if (kScrollbackSize > 10000/* arbitrary */)
-			{
-				++scrollbackThreadCount;
-			}
-			if (kScrollbackSize > 30000/* arbitrary */)
-			{
-				++scrollbackThreadCount;
-			}
-			if (kScrollbackSize > 50000/* arbitrary */)
-			{
-				++scrollbackThreadCount;
-			}
-			
-			if (scrollbackThreadCount >= kMaxThreads)
-			{
-				scrollbackThreadCount = kMaxThreads - 1;
-			}
-			UInt32		averageLinesPerThread = STATIC_CAST(kScrollbackSize, UInt32) / scrollbackThreadCount;
-			for (UInt16 i = 1; i <= scrollbackThreadCount; ++i)
-			{
-				if (threadOK)
-				{
-					My_SearchThreadContextPtr	threadContextPtr = nullptr;
-					
-					
-					matchVectorsList[i] = new RangeDescriptionVector();
+			Terminal_RetainScreen(screen);
+			backgroundSearchBegin(dataPtr);
+			dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0),
+			^{
+				searchRun(*searchPtr,
+							^(std::vector< Terminal_RangeDescription > const& inMatchBatch, Boolean& outStopSearch)
+							{
+								My_SearchResultsQueue::Batch const	kMatchBatch = inMatchBatch;
+								
+								
+								// the batch is highlighted (etc.) by the main thread, which
+								// stops the search if rows have moved since it started
+								dispatch_async(dispatch_get_main_queue(),
+								^{
+									if ((false == searchPtr->isStopRequested) &&
+										(searchPtr->context.invalidationCount == dataPtr->backgroundSearch.invalidationCount))
+									{
+										Boolean		stopSearch = false;
+										
+										
+										inResultsHandler(kMatchBatch, stopSearch);
+										if (stopSearch)
+										{
+											searchPtr->isStopRequested = true;
+										}
+									}
+								});
+								outStopSearch = searchPtr->isStopRequested;
+							},
+							^Boolean ()
+							{
+								return (searchPtr->isStopRequested ||
+										(searchPtr->context.invalidationCount != dataPtr->backgroundSearch.invalidationCount) ||
+										((nullptr != inCancelBlockOrNull) && inCancelBlockOrNull()));
+							});
+				
+				// no chunk is running anymore
+				dispatch_async(dispatch_get_main_queue(),
+				^{
+					TerminalScreenRef	releasedScreen = screen;
 					
-					threadContextPtr = new My_SearchThreadContext; // contains C++ classes, must use "new"
-					threadContextPtr->screenBufferPtr = dataPtr;
-					threadContextPtr->matchesVectorPtr = matchVectorsList[i];
-					threadContextPtr->queryCFString = actualQuery;
-					threadContextPtr->searchFlags = searchFlags;
-					threadContextPtr->regExOptions = regExOptions;
-					threadContextPtr->isRegularExpression = isRegEx;
-					threadContextPtr->threadNumber = i;
-					threadContextPtr->rangeStart = dataPtr->scrollbackBuffer.begin();
-					threadContextPtr->startRowIndex = (i - 1) * averageLinesPerThread;
-					if (i > 1)
-					{
-						std::advance(threadContextPtr->rangeStart, threadContextPtr->startRowIndex);
-					}
-					threadContextPtr->rowCount = averageLinesPerThread;
-					if (scrollbackThreadCount == i)
-					{
-						// since the scrollback size is unlikely to divide perfectly between
-						// threads, the last thread picks up the slack
-						threadContextPtr->rowCount = STATIC_CAST(kScrollbackSize, UInt32) - threadContextPtr->startRowIndex;
-					}
 					
-					threadResult = pthread_create(&threadList[i], &threadAttributes,
-													threadForTerminalSearch, threadContextPtr);
-					if (-1 == threadResult)
+					if (nullptr != inCompletionBlockOrNull)
 					{
-						Console_Warning(Console_WriteValue, "failed to create thread, errno", errno);
-						threadOK = false;
+						inCompletionBlockOrNull();
 					}
-				}
-			}
+					backgroundSearchEnd(dataPtr);
+					Terminal_ReleaseScreen(&releasedScreen);
+				});
+			});
 		}
+	}
+	return result;
+}// SearchInBackground
+
+
+/*!
+Searches the specified terminal screen buffer using the given
+query and flags as a guide, and passes matches to the given
+block in batches as soon as they are found.  The block runs
+on the calling thread while other chunks are still being
+searched, so it must not change the terminal (see the
+definition of Terminal_SearchResultsBlock).
+
+If a cancel block is given, it is also invoked regularly
+while waiting for matches (see the definition of
+Terminal_SearchCancelBlock); this is the only way to stop a
+search that finds nothing.
+
+The buffer is divided into chunks that are searched in parallel
+by the shared work pool (see WorkPool.h) but all chunks finish
+before this routine returns; if the block stops the search, any
+chunks that have not started are skipped.  The query is prepared
+only once for all chunks, and literal queries are compared
+directly with the characters that the terminal stores (compacted
+scrollback lines are decoded but otherwise no strings are created).
+
+\retval kTerminal_ResultOK
+if no error occurs (including if the search was stopped early)
+
+\retval kTerminal_ResultInvalidID
+if the given terminal screen reference is invalid
+
+\retval kTerminal_ResultParameterError
+if the query string is invalid or an unrecognized flag is given
+
+(2023.10)
+*/
+Terminal_Result
+Terminal_SearchIncrementally	(TerminalScreenRef				inRef,
+								 CFStringRef					inQuery,
+								 Terminal_SearchFlags			inFlags,
+								 Terminal_SearchResultsBlock	inResultsHandler,
+								 Terminal_SearchCancelBlock		inCancelBlockOrNull)
+{
+	My_ScreenBufferPtr	dataPtr = getVirtualScreenData(inRef);
+	Terminal_Result		result = kTerminal_ResultOK;
+	
+	
+	if (nullptr == dataPtr) result = kTerminal_ResultInvalidID;
+	else if ((nullptr == inQuery) || (nullptr == inResultsHandler)) result = kTerminal_ResultParameterError;
+	else
+	{
+		My_Search	search(dataPtr, inQuery, inFlags, false/* is in background */);
 		
-		// wait for all threads to complete
-		for (UInt16 i = 0; i < kMaxThreads; ++i)
-		{
-			if (nullptr == threadList[i])
-			{
-				break;
-			}
-			UNUSED_RETURN(int)pthread_join(threadList[i], nullptr);
-		}
 		
-		// process search results
-		if (false == threadOK)
+		if (false == search.isValid())
 		{
-			result = kTerminal_ResultNotEnoughMemory;
+			result = kTerminal_ResultParameterError;
 		}
 		else
 		{
-			result = kTerminal_ResultOK;
-			
-			// since all threads had their own vectors to avoid locking delays,
-			// it is now necessary to combine each thread’s results into one list
-			// (in the future it might make sense to expose this fact to the
-			// caller just to avoid pointless copies; the caller will most likely
-			// just iterate over it all anyway)
-			size_t	totalSize = 0;
-			for (UInt16 i = 0; i < kMaxThreads; ++i)
-			{
-				if (nullptr == matchVectorsList[i])
-				{
-					break;
-				}
-				totalSize += matchVectorsList[i]->size();
-			}
-			outMatches.reserve(totalSize);
-			for (UInt16 i = 0; i < kMaxThreads; ++i)
-			{
-				if (nullptr == matchVectorsList[i])
-				{
-					break;
-				}
-				outMatches.insert(outMatches.end(), matchVectorsList[i]->begin(), matchVectorsList[i]->end());
-			}
-		}
-		
-		// free space
-		for (UInt16 i = 0; i < kMaxThreads; ++i)
-		{
-			if (nullptr != matchVectorsList[i])
-			{
-				delete matchVectorsList[i], matchVectorsList[i] = nullptr;
-			}
+			searchRun(search, inResultsHandler, inCancelBlockOrNull);
 		}
 	}
 	
 	return result;
-}// Search
+}// SearchIncrementally
 
 
 /*!
@@ -4924,36 +7013,102 @@ if the terminal is resized without errors
 \retval kTerminal_ResultInvalidID
 if the given terminal screen reference is invalid
 
-\retval kTerminal_ResultParameterError
-if the given number of columns or rows is too small or too large
+\retval kTerminal_ResultParameterError
+if the given number of columns or rows is too small or too large
+
+\retval kTerminal_ResultNotEnoughMemory
+not currently returned because this routine does no memory
+reallocation; however a future implementation might decide to
+reallocate, and if such reallocation fails, this error should be
+returned
+
+(4.0)
+*/
+Terminal_Result
+Terminal_SetVisibleScreenDimensions		(TerminalScreenRef	inRef,
+										 UInt16				inNewNumberOfCharactersWide,
+										 UInt16				inNewNumberOfLinesHigh)
+{
+	Terminal_Result			result = kTerminal_ResultOK;
+	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+	
+	
+	if (nullptr == dataPtr) result = kTerminal_ResultInvalidID;
+	else
+	{
+		if ((inNewNumberOfCharactersWide != dataPtr->text.visibleScreen.numberOfColumnsPermitted) ||
+			(inNewNumberOfLinesHigh != dataPtr->screenBuffer.size()))
+		{
+			++(dataPtr->backgroundSearch.invalidationCount); // stop any search in progress
+		}
+		UNUSED_RETURN(Terminal_Result)setVisibleColumnCount(dataPtr, inNewNumberOfCharactersWide);
+		result = setVisibleRowCount(dataPtr, inNewNumberOfLinesHigh);
+		releaseUnusedImages(dataPtr); // rows may have been discarded
+		
+		changeNotifyForTerminal(dataPtr, kTerminal_ChangeScreenSize, dataPtr->selfRef/* context */);
+	}
+	return result;
+}// SetVisibleScreenDimensions
+
+
+/*!
+Like Terminal_ForEachLikeAttributeRun(), except that the
+text comes from a row of a snapshot (see
+Terminal_PublishSnapshot()) instead of the live screen.
+Since a snapshot row has no iterator, the row parameter of
+the block is always nullptr.
+
+\retval kTerminal_ResultOK
+if no error occurred
+
+\retval kTerminal_ResultParameterError
+if the snapshot or block is invalid, or the row is not part
+of the snapshot
+
+(2023.10)
+*/
+Terminal_Result
+Terminal_SnapshotForEachLikeAttributeRun	(Terminal_SnapshotPtr const&	inSnapshot,
+											 UInt16						inZeroBasedRow,
+											 Terminal_ScreenRunBlock	inDoWhat)
+{
+	Terminal_Result		result = kTerminal_ResultOK;
+	
+	
+	if ((nullptr == inDoWhat) || (nullptr == inSnapshot) || (inZeroBasedRow >= inSnapshot->rows.size()))
+	{
+		result = kTerminal_ResultParameterError;
+	}
+	else
+	{
+		My_SnapshotRow const&	kRow = *(inSnapshot->rows[inZeroBasedRow]);
+		
+		
+		forEachLikeAttributeRunInLine(kRow.textCFString.returnCFStringRef(), kRow.attributeRuns,
+										kRow.globalAttributes, nullptr/* row */, inDoWhat);
+	}
+	return result;
+}// SnapshotForEachLikeAttributeRun
+
 
-\retval kTerminal_ResultNotEnoughMemory
-not currently returned because this routine does no memory
-reallocation; however a future implementation might decide to
-reallocate, and if such reallocation fails, this error should be
-returned
+/*!
+Returns the number of main screen rows in the given
+snapshot, or 0 if the snapshot is empty.
 
-(4.0)
+(2023.10)
 */
-Terminal_Result
-Terminal_SetVisibleScreenDimensions		(TerminalScreenRef	inRef,
-										 UInt16				inNewNumberOfCharactersWide,
-										 UInt16				inNewNumberOfLinesHigh)
+UInt16
+Terminal_SnapshotReturnRowCount		(Terminal_SnapshotPtr const&	inSnapshot)
 {
-	Terminal_Result			result = kTerminal_ResultOK;
-	My_ScreenBufferPtr		dataPtr = getVirtualScreenData(inRef);
+	UInt16		result = 0;
 	
 	
-	if (nullptr == dataPtr) result = kTerminal_ResultInvalidID;
-	else
+	if (nullptr != inSnapshot)
 	{
-		UNUSED_RETURN(Terminal_Result)setVisibleColumnCount(dataPtr, inNewNumberOfCharactersWide);
-		result = setVisibleRowCount(dataPtr, inNewNumberOfLinesHigh);
-		
-		changeNotifyForTerminal(dataPtr, kTerminal_ChangeScreenSize, dataPtr->selfRef/* context */);
+		result = STATIC_CAST(inSnapshot->rows.size(), UInt16);
 	}
 	return result;
-}// SetVisibleScreenDimensions
+}// SnapshotReturnRowCount
 
 
 /*!
@@ -6006,6 +8161,7 @@ stateRepetitions(0),
 currentState(kMy_ParserStateInitial),
 stringAccumulatorState(kMy_ParserStateInitial),
 stringAccumulator(),
+payloadHandler(nil),
 multiByteDecoder(),
 recentCodePointByte('\0'),
 addedITerm(false),
@@ -6026,9 +8182,7 @@ trueColorTableReds(nullptr),
 trueColorTableGreens(nullptr),
 trueColorTableBlues(nullptr),
 trueColorTableNextID(0),
-bitmapTableNextID(0),
-bitmapImageTable(nil),
-bitmapSegmentTable(nil),
+retainedImages(),
 eightBitReceiver(false),
 eightBitTransmitter(false),
 lockSevenBitTransmit(false)
@@ -6049,6 +8203,11 @@ My_Emulator::~My_Emulator()
 	delete trueColorTableReds;
 	delete trueColorTableGreens;
 	delete trueColorTableBlues;
+	
+	for (ImageStore_ImageID imageID : retainedImages)
+	{
+		ImageStore_ReleaseImage(imageID);
+	}
 }// My_Emulator destructor
 
 
@@ -6098,6 +8257,7 @@ initializeParserStateStack ()
 {
 	this->currentState = kMy_ParserStateInitial;
 	this->stringAccumulatorState = kMy_ParserStateInitial;
+	this->payloadHandler = nil;
 }// initializeParserStateStack
 
 
@@ -6662,10 +8822,12 @@ iconTitleCFString(),
 changeListenerModel(ListenerModel_New(kListenerModel_StyleStandard, kConstantsRegistry_ListenerModelDescriptorTerminalChanges)),
 preferenceMonitor(ListenerModel_NewStandardListener(preferenceChanged, this/* context */),
 					ListenerModel_ListenerWrap::kAlreadyRetained),
-scrollbackBufferCachedSize(0),
-scrollbackBuffer(),
+lineAllocator(returnScreenColumns(inTerminalConfig)),
+scrollbackBuffer(lineAllocator),
 screenBuffer(),
+snapshotPublisher(),
 bytesToEcho(),
+echoUniChars(),
 debugStateHandlerSequence(),
 echoErrorCount(0),
 translationErrorCount(0),
@@ -6709,7 +8871,7 @@ current(*this),
 selfRef(REINTERPRET_CAST(this, TerminalScreenRef))
 // TEMPORARY: initialize other members here...
 {
-	this->text.visibleScreen.numberOfColumnsAllocated = Terminal_ReturnAllocatedColumnCount(); // always allocate max columns
+	this->text.visibleScreen.numberOfColumnsAllocated = this->lineAllocator.returnCellCapacity(); // grows with the screen width
 	
 	this->current.cursorX = 0; // initialized because moveCursor() depends on prior values...
 	this->current.cursorY = 0; // initialized because moveCursor() depends on prior values...
@@ -6730,9 +8892,11 @@ selfRef(REINTERPRET_CAST(this, TerminalScreenRef))
 	try
 	{
 		// it is important to make the list a multiple of the tab stop distance;
-		// see tabStopInitialize() to see why this is the case
-		this->tabSettings.resize(this->text.visibleScreen.numberOfColumnsAllocated +
-									(this->text.visibleScreen.numberOfColumnsAllocated % kMy_TabStop));
+		// see tabStopInitialize() to see why this is the case; there is a tab
+		// setting for every possible column (unlike lines, which only have
+		// enough cells for the current width)
+		this->tabSettings.resize(Terminal_ReturnAllocatedColumnCount() +
+									(Terminal_ReturnAllocatedColumnCount() % kMy_TabStop));
 		tabStopInitialize(this);
 	}
 	catch (std::bad_alloc)
@@ -6741,7 +8905,12 @@ selfRef(REINTERPRET_CAST(this, TerminalScreenRef))
 	}
 	
 	this->current.characterSetInfoPtr = &this->vtG0; // by definition, G0 is active initially
+	this->text.scrollback.reflowScheduled = false;
+	UNUSED_RETURN(int)pthread_rwlock_init(&this->backgroundSearch.lock, nullptr);
+	this->backgroundSearch.count = 0;
+	this->backgroundSearch.invalidationCount = 0;
 	setScrollbackSize(this, returnScrollbackRows(inTerminalConfig));
+	this->scrollbackBuffer.setSearchIndexEnabled(returnScrollbackSearchIndex(inTerminalConfig));
 	this->text.scrollback.enabled = (this->text.scrollback.enabled && returnForceSave(inTerminalConfig));
 	this->text.visibleScreen.numberOfColumnsPermitted = returnScreenColumns(inTerminalConfig);
 	this->current.cursorAttributes.clear();
@@ -6752,6 +8921,29 @@ selfRef(REINTERPRET_CAST(this, TerminalScreenRef))
 	// speech setup
 	this->speech.mode = kTerminal_SpeechModeSpeakNever;
 	
+	// changes that can happen thousands of times per second are merged
+	// and delivered at most once per turn of the run loop (see
+	// coalesceTerminalChange()); scrolling must be delivered first,
+	// because the rows of later edits assume that rows already moved
+	{
+		ListenerModel_CoalesceBlock		coalesceBlock = ^(ListenerModel_Event	inPendingChange,
+															void*					inoutPendingContextPtr,
+															ListenerModel_Event	inNewChange,
+															void const*			inNewContextPtr)
+														{
+															coalesceTerminalChange(inPendingChange, inoutPendingContextPtr,
+																					inNewChange, inNewContextPtr);
+														};
+		
+		
+		UNUSED_RETURN(ListenerModel_Result)ListenerModel_SetEventCoalescing(this->changeListenerModel, kTerminal_ChangeScrollActivity,
+																			sizeof(Terminal_ScrollDescription), coalesceBlock);
+		UNUSED_RETURN(ListenerModel_Result)ListenerModel_SetEventCoalescing(this->changeListenerModel, kTerminal_ChangeTextEdited,
+																			sizeof(Terminal_RangeDescription), coalesceBlock);
+		UNUSED_RETURN(ListenerModel_Result)ListenerModel_SetEventCoalescing(this->changeListenerModel, kTerminal_ChangeCursorLocation,
+																			0/* context is the screen itself */);
+	}
+	
 	// set up optional terminal emulator features
 	if (return24BitColor(inTerminalConfig))
 	{
@@ -6879,15 +9071,19 @@ My_ScreenBuffer::
 	TerminalSpeaker_Dispose(&this->speaker);
 	ListenerModel_Dispose(&this->changeListenerModel);
 	
-	for (My_ScreenBufferLinePtr& linePtrRef : this->scrollbackBuffer)
+	for (My_ScrollbackBuffer::Line& lineRef : this->scrollbackBuffer)
 	{
-		deleteLinePtr(linePtrRef);
+		deleteLinePtr(lineRef.handle);
 	}
 	for (My_ScreenBufferLinePtr& linePtrRef : this->screenBuffer)
 	{
 		deleteLinePtr(linePtrRef);
 	}
 	
+	// (background searches retain the screen, so none can be running)
+	assert(0 == this->backgroundSearch.count);
+	UNUSED_RETURN(int)pthread_rwlock_destroy(&this->backgroundSearch.lock);
+	
 	//Console_WriteValueAddress("invalidated screen", this);
 }// My_ScreenBuffer destructor
 
@@ -6921,6 +9117,7 @@ preferenceChanged	(ListenerModel_Ref		UNUSED_ARGUMENT(inUnusedModel),
 		Terminal_SetVisibleScreenDimensions(ptr->selfRef, ptr->returnScreenColumns(prefsContext),
 											ptr->returnScreenRows(prefsContext));
 		setScrollbackSize(ptr, ptr->returnScrollbackRows(prefsContext));
+		ptr->scrollbackBuffer.setSearchIndexEnabled(ptr->returnScrollbackSearchIndex(prefsContext));
 	}
 	else
 	{
@@ -7279,6 +9476,29 @@ returnScrollbackRows	(Preferences_ContextRef		inTerminalConfig,
 }// returnScrollbackRows
 
 
+/*!
+Reads "kPreferences_TagTerminalScreenScrollbackSearchIndex"
+from a Preferences context, and returns either that value or
+the default of false if none was found.
+
+(2023.10)
+*/
+Boolean
+My_ScreenBuffer::
+returnScrollbackSearchIndex		(Preferences_ContextRef		inTerminalConfig)
+{
+	Preferences_Result		prefsResult = kPreferences_ResultOK;
+	Boolean					result = false;
+	
+	
+	prefsResult = Preferences_ContextGetData(inTerminalConfig, kPreferences_TagTerminalScreenScrollbackSearchIndex,
+												sizeof(result), &result);
+	if (kPreferences_ResultOK != prefsResult) result = false; // arbitrary
+	
+	return result;
+}// returnScrollbackSearchIndex
+
+
 /*!
 Reads "kPreferences_TagSixelGraphicsEnabled" from a
 Preferences context, and returns either that value or the
@@ -7417,6 +9637,119 @@ returnXTermWindowAlteration		(Preferences_ContextRef		inTerminalConfig)
 }// returnXTermWindowAlteration
 
 
+/*!
+Copies the text and attributes of the given line, marking
+the copy with the given snapshot version.
+
+(2023.10)
+*/
+My_SnapshotRow::
+My_SnapshotRow	(My_ScreenBufferLine const&		inLine,
+				 UInt64							inVersion)
+:
+textCFString(CFStringCreateCopy(kCFAllocatorDefault, inLine.returnCFStringRef()), CFRetainRelease::kAlreadyRetained),
+attributeRuns(inLine.returnAttributeRuns()),
+globalAttributes(inLine.returnGlobalAttributes()),
+version(inVersion)
+{
+	unless (this->textCFString.exists())
+	{
+		throw std::bad_alloc();
+	}
+}// My_SnapshotRow 2-argument constructor
+
+
+/*!
+Creates a publisher that has not yet published anything
+(so the first snapshot copies every row).
+
+(2023.10)
+*/
+My_SnapshotPublisher::
+My_SnapshotPublisher ()
+:
+sourceRows(),
+allRowsChanged(true),
+versionCounter(0),
+latestSnapshot(),
+publishCount(0),
+rowCopyCount(0)
+{
+}// My_SnapshotPublisher default constructor
+
+
+/*!
+Ensures that the next snapshot copies every row, such as
+after the screen is resized or reset.
+
+(2023.10)
+*/
+void
+My_SnapshotPublisher::
+markAllRowsChanged ()
+{
+	this->allRowsChanged = true;
+}// markAllRowsChanged
+
+
+/*!
+Ensures that the next snapshot copies the specified rows
+(where 0 is the topmost main screen row).  Negative row
+numbers refer to the scrollback, which is not part of a
+snapshot, so they are ignored.
+
+(2023.10)
+*/
+void
+My_SnapshotPublisher::
+markRowsChanged		(SInt64		inFirstRow,
+					 SInt64		inRowCount)
+{
+	SInt64 const	kFirstRow = std::max(inFirstRow, STATIC_CAST(0, SInt64));
+	SInt64 const	kPastLastRow = std::min(inFirstRow + inRowCount, STATIC_CAST(this->sourceRows.size(), SInt64));
+	
+	
+	// (rows past the end are always copied, see Terminal_PublishSnapshot())
+	if ((false == this->allRowsChanged) && (kPastLastRow > kFirstRow))
+	{
+		std::fill(this->sourceRows.begin() + kFirstRow, this->sourceRows.begin() + kPastLastRow, kChangedRow);
+	}
+}// markRowsChanged
+
+
+/*!
+Records that every main screen row moved by the given number
+of rows (upward if negative), so that the next snapshot can
+share the moved rows of the previous one.  Rows that were
+exposed must then be marked with markRowsChanged().
+
+(2023.10)
+*/
+void
+My_SnapshotPublisher::
+moveRows	(SInt64		inRowDelta)
+{
+	unless (this->allRowsChanged)
+	{
+		std::vector< SInt32 >	movedRows(this->sourceRows.size(), kChangedRow);
+		SInt64 const			kRowCount = STATIC_CAST(this->sourceRows.size(), SInt64);
+		
+		
+		for (SInt64 i = 0; i < kRowCount; ++i)
+		{
+			SInt64 const	kOldRow = (i - inRowDelta);
+			
+			
+			if ((kOldRow >= 0) && (kOldRow < kRowCount))
+			{
+				movedRows[i] = this->sourceRows[kOldRow];
+			}
+		}
+		this->sourceRows.swap(movedRows);
+	}
+}// moveRows
+
+
 /*!
 Translates the specified buffer into Unicode (from the input
 text encoding of the terminal), and echoes it to the screen.
@@ -7441,8 +9774,10 @@ echoData	(My_ScreenBufferPtr		inDataPtr,
 	UInt32		result = inLength;
 	
 	
-	if (inLength > 0)
+	if ((inLength > 0) && (false == echoBytesDirectly(inDataPtr, inBuffer, inLength)))
 	{
+		// slower path; translate into a string object and then
+		// split the string into composed character sequences
 		CFIndex				bytesRequired = 0;
 		CFRetainRelease		bufferAsCFString(TextTranslation_PersistentCFStringCreate
 												(kCFAllocatorDefault, inBuffer, inLength, inDataPtr->emulator.inputTextEncoding,
@@ -8722,6 +11057,375 @@ stateTransition		(My_ScreenBufferPtr			inDataPtr,
 }// My_DumbTerminal::stateTransition
 
 
+/*!
+Examines the arguments of a custom iTerm2 file sequence
+(i.e. ESC ] 1337 ; File = <arguments> : <data>), which are
+in the accumulator, and sets up the emulator to decode the
+base64 data in pieces as it arrives (see
+streamStringAccumulator()) so that the encoded text is never
+held in full.  The arguments are removed from the
+accumulator.
+
+The decoded file is still collected until the end, since an
+image cannot be interpreted from part of its file; so if it
+grows beyond "kMy_ITermFileMaximum" bytes, or if the data
+turns out not to be base64, the transfer is abandoned and
+the rest of its data is discarded as it arrives.
+
+(2023.10)
+*/
+void
+My_ITermCore::
+beginFileStream		(My_ScreenBufferPtr		inDataPtr)
+{
+	// skip the "File=" prefix and the colon that ends the arguments
+	NSString*	argumentsString = [[NSString alloc] initWithBytes:(inDataPtr->emulator.stringAccumulator.c_str() + 5)
+																	length:(inDataPtr->emulator.stringAccumulator.size() - 6)
+																	encoding:NSUTF8StringEncoding];
+	NSArray*	semicolonSeparated = [argumentsString componentsSeparatedByString:@";"];
+	UInt16		totalPixelsH = 0; // reset below
+	UInt16		totalPixelsV = 0; // reset below
+	UInt16		defaultCellPixelsH = 9; // reset below
+	UInt16		defaultCellPixelsV = 12; // reset below
+	UInt16		suggestedCellCountH = 0;
+	UInt16		suggestedCellCountV = 0;
+	Boolean		dumpImage = false;
+	Boolean		ignoreAspectRatio = false;
+	
+	
+	for (id argObject in semicolonSeparated)
+	{
+		assert([argObject isKindOfClass:NSString.class]);
+		NSString*			argString = STATIC_CAST(argObject, NSString*);
+		NSMutableArray*		argKeyValue = [[argString componentsSeparatedByString:@"="] mutableCopy];
+		
+		
+		if (argKeyValue.count < 2)
+		{
+			Console_Warning(Console_WriteValueCFString, "expected key=value; unable to process string", BRIDGE_CAST(argumentsString, CFStringRef));
+		}
+		else
+		{
+			id			objectArgName = [argKeyValue objectAtIndex:0];
+			assert([objectArgName isKindOfClass:NSString.class]);
+			NSString*	argName = STATIC_CAST(objectArgName, NSString*);
+			NSString*	argValue = nil; // see below
+			
+			
+			[argKeyValue removeObjectAtIndex:0];
+			argValue = [argKeyValue componentsJoinedByString:@"="]; // allow equal signs in the value itself
+			
+			//Console_WriteValueCFString("received argument name", BRIDGE_CAST(argName, CFStringRef)); // debug
+			//Console_WriteValueCFString("received argument value", BRIDGE_CAST(argValue, CFStringRef)); // debug
+			
+			if ([argName isEqualToString:@"name"])
+			{
+				// the name is actually a string encoded in base64
+				NSData*		decodedName = [[NSData alloc]
+											initWithBase64EncodedString:argValue
+																		options:(NSDataBase64DecodingIgnoreUnknownCharacters)];
+				NSString*	decodedString = [[NSString alloc] initWithData:decodedName encoding:NSUTF8StringEncoding];
+				
+				
+				if (nil == decodedString)
+				{
+					Console_Warning(Console_WriteLine, "failed to decode base64 for 'name' argument");
+				}
+				else
+				{
+					SessionRef		session = returnListeningSession(inDataPtr);
+					
+					
+					if (nil == session)
+					{
+						Console_Warning(Console_WriteValueCFString, "no session found for terminal; ignoring file name",
+										BRIDGE_CAST(decodedString, CFStringRef));
+					}
+					else
+					{
+						Session_DisplayFileDownloadNameUI(session, BRIDGE_CAST(decodedString, CFStringRef));
+					}
+				}
+			}
+			else if ([argName isEqualToString:@"inline"])
+			{
+				if ([argValue isEqualToString:@"1"] || [argValue isEqualToString:@"true"])
+				{
+					dumpImage = true;
+				}
+			}
+			else if ([argName isEqualToString:@"size"])
+			{
+				// total image data size in bytes; not used right now
+				Console_Warning(Console_WriteLine, "ignored argument 'size'");
+			}
+			else if ([argName isEqualToString:@"preserveAspectRatio"])
+			{
+				if ([argValue isEqualToString:@"0"] || [argValue isEqualToString:@"false"])
+				{
+					ignoreAspectRatio = true;
+					Console_WriteLine("ignoring image aspect ratio"); // debug
+				}
+				else
+				{
+					ignoreAspectRatio = false;
+				}
+			}
+			else if ([argName isEqualToString:@"width"] || [argName isEqualToString:@"height"])
+			{
+				Boolean		isWidth = [argName isEqualToString:@"width"]; // otherwise, height
+				
+				
+				if ([argValue isEqualToString:@"auto"])
+				{
+					// implied for zero values (see below)
+					if (isWidth)
+					{
+						totalPixelsH = 0;
+					}
+					else
+					{
+						totalPixelsV = 0;
+					}
+				}
+				else
+				{
+					if ([argValue hasSuffix:@"px"])
+					{
+						// number of pixels
+						NSScanner*		valueScanner = [NSScanner scannerWithString:argValue];
+						NSString*		subValue = nil;
+						
+						
+						if ([valueScanner scanUpToString:@"px" intoString:&subValue])
+						{
+							UInt16 const	kPixelCount = STATIC_CAST([subValue integerValue], UInt16);
+							
+							
+							if (isWidth)
+							{
+								totalPixelsH = kPixelCount;
+							}
+							else
+							{
+								totalPixelsV = kPixelCount;
+							}
+							
+							//Console_WriteValue("set image pixel width/height", kPixelCount); // debug
+						}
+					}
+					else if ([argValue hasSuffix:@"%"])
+					{
+						// INCOMPLETE; percent not supported for arbitrary values but it is
+						// easy to support some common absolute percentages
+						if ([argValue isEqualToString:@"100%"])
+						{
+							if (isWidth)
+							{
+								suggestedCellCountH = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
+							}
+							else
+							{
+								suggestedCellCountV = inDataPtr->screenBuffer.size();
+							}
+						}
+						else
+						{
+							Console_Warning(Console_WriteValueCFString, "ignored unusual width/height percentage value (try '100%')", BRIDGE_CAST(argValue, CFStringRef));
+						}
+					}
+					else
+					{
+						// number of ordinary cells to occupy; this is handled by scaling
+						// the “pixels per cell” later, when the image dimensions are final
+						UInt16 const	kCellCount = STATIC_CAST([argValue integerValue], UInt16);
+						
+						
+						if (isWidth)
+						{
+							suggestedCellCountH = kCellCount;
+						}
+						else
+						{
+							suggestedCellCountV = kCellCount;
+						}
+						
+						//Console_WriteValue("set image cell count across/down", kCellCount); // debug
+					}
+				}
+			}
+			else
+			{
+				// ???
+				Console_Warning(Console_WriteValueCFString, "ignored argument with name", BRIDGE_CAST(argName, CFStringRef));
+				// INCOMPLETE; process arguments
+			}
+		}
+	}
+	
+	inDataPtr->emulator.stringAccumulator.clear();
+	
+	// the buffers are kept alive by the handler, which is released
+	// after the last piece (or when the string is interrupted);
+	// base64 text is decoded 4 characters at a time, so any
+	// incomplete group is held until the next piece arrives;
+	// the handler stays installed after a transfer is abandoned
+	// so that the rest of the string is still taken in pieces
+	// (and thrown away) instead of being accumulated
+	{
+		auto							pendingText = std::make_shared< std::basic_string< UInt8 > >();
+		__block NSMutableData*			decodedData = [[NSMutableData alloc] init];
+		__block ImageStore_ContentKey	contentKey;
+		__block size_t					decodedByteCount = 0;
+		__block Boolean					isBase64 = true;
+		__block Boolean					isTooLarge = false;
+		
+		
+		inDataPtr->emulator.payloadHandler =
+		^(My_ScreenBuffer* inHandlerDataPtr, UInt8 const* inBuffer, size_t inLength, Boolean inIsFinal)
+		{
+			if ((isBase64) && (false == isTooLarge))
+			{
+				for (size_t i = 0; i < inLength; ++i)
+				{
+					UInt8 const		kByte = inBuffer[i];
+					
+					
+					// ignore anything that base64 does not use (such as new-lines)
+					if (std::isalnum(kByte) || ('+' == kByte) || ('/' == kByte) || ('=' == kByte))
+					{
+						pendingText->push_back(kByte);
+					}
+				}
+				
+				size_t const	kDecodableLength = ((inIsFinal)
+													? pendingText->size()
+													: (pendingText->size() & ~STATIC_CAST(3, size_t)));
+				
+				
+				if (kDecodableLength > 0)
+				{
+					NSData*		decodedPiece = [[NSData alloc]
+												initWithBase64EncodedData:[NSData dataWithBytes:pendingText->data() length:kDecodableLength]
+																			options:(NSDataBase64DecodingIgnoreUnknownCharacters)];
+					
+					
+					if (nil == decodedPiece)
+					{
+						isBase64 = false;
+					}
+					else
+					{
+						decodedByteCount += decodedPiece.length;
+						if (decodedByteCount > kMy_ITermFileMaximum)
+						{
+							isTooLarge = true;
+						}
+						else if (dumpImage)
+						{
+							[decodedData appendData:decodedPiece];
+							contentKey.appendBytes(decodedPiece.bytes, decodedPiece.length);
+						}
+					}
+					pendingText->erase(0, kDecodableLength);
+				}
+				
+				if ((false == isBase64) || (isTooLarge))
+				{
+					// abandon the transfer; free everything now, since the
+					// rest of the string may still take a long time to arrive
+					decodedData = nil;
+					pendingText->clear();
+					pendingText->shrink_to_fit();
+				}
+			}
+			
+			if (inIsFinal)
+			{
+				if (false == isBase64)
+				{
+					Console_Warning(Console_WriteLine, "unable to process given string; expected base64 format");
+				}
+				else if (isTooLarge)
+				{
+					Console_Warning(Console_WriteValue, "ignored file that exceeds the maximum size in bytes", STATIC_CAST(kMy_ITermFileMaximum, SInt64));
+				}
+				else if (dumpImage)
+				{
+					Boolean const		kScrollWithImage = true;
+					Boolean const		kRestoreCursor = false;
+					ImageStore_ImageID	imageID = ImageStore_FindImage(contentKey); // a repeated file is not decoded again
+					NSImage*			decodedImage = nil;
+					UInt16				imagePixelsH = totalPixelsH;
+					UInt16				imagePixelsV = totalPixelsV;
+					UInt16				cellPixelsH = defaultCellPixelsH;
+					UInt16				cellPixelsV = defaultCellPixelsV;
+					
+					
+					if (kImageStore_InvalidImageID == imageID)
+					{
+						decodedImage = [[NSImage alloc] initWithData:decodedData];
+						imageID = ImageStore_AddImage(decodedImage, contentKey);
+					}
+					else
+					{
+						decodedImage = ImageStore_ReturnImage(imageID);
+					}
+					
+					if (0 == imagePixelsH)
+					{
+						// automatically determine width
+						imagePixelsH = STATIC_CAST(decodedImage.size.width, UInt16);
+					}
+					
+					if (0 == imagePixelsV)
+					{
+						// automatically determine height
+						imagePixelsV = STATIC_CAST(decodedImage.size.height, UInt16);
+					}
+					
+					if (false == ignoreAspectRatio)
+					{
+						Console_Warning(Console_WriteLine, "preservation of aspect ratio is not implemented");
+					}
+					
+					if (0 != suggestedCellCountH)
+					{
+						// use given number of cells across
+						cellPixelsH = std::max< UInt16 >(1, STATIC_CAST(roundf(STATIC_CAST(imagePixelsH, Float32) /
+																				STATIC_CAST(suggestedCellCountH, Float32)),
+																		UInt16));
+					}
+					
+					if (0 != suggestedCellCountV)
+					{
+						// use given number of cells down
+						cellPixelsV = std::max< UInt16 >(1, STATIC_CAST(roundf(STATIC_CAST(imagePixelsV, Float32) /
+																				STATIC_CAST(suggestedCellCountV, Float32)),
+																		UInt16));
+					}
+					
+					if (kImageStore_InvalidImageID == imageID)
+					{
+						Console_Warning(Console_WriteLine, "unable to create image from decoded file");
+					}
+					else
+					{
+						bufferInsertInlineImageWithoutUpdate(inHandlerDataPtr, imageID, imagePixelsH, imagePixelsV,
+																cellPixelsH, cellPixelsV,
+																kScrollWithImage, kRestoreCursor);
+					}
+				}
+				else
+				{
+					Console_Warning(Console_WriteLine, "recognized and decoded image but file downloading is not implemented; try using 'inline=1'");
+				}
+			}
+		};
+	}
+}// My_ITermCore::beginFileStream
+
+
 /*!
 A standard "My_EmulatorStateDeterminantProcPtr" that sets
 iTerm2-specific states based on the characters of the
@@ -8817,6 +11521,7 @@ stateTransition		(My_ScreenBufferPtr			inDataPtr,
 			
 			inDataPtr->emulator.stringAccumulator.clear();
 			inDataPtr->emulator.stringAccumulatorState = inOldNew.second;
+			inDataPtr->emulator.payloadHandler = nil; // any interrupted string is abandoned
 		}
 		break;
 	
@@ -8842,6 +11547,18 @@ stateTransition		(My_ScreenBufferPtr			inDataPtr,
 				inDataPtr->emulator.stringAccumulator.push_back(STATIC_CAST(inDataPtr->emulator.recentCodePoint(), UInt8));
 				result = 1;
 			}
+			
+			// the data of a file follows the first colon, so the
+			// arguments are complete when the colon is seen; the
+			// data is then decoded in pieces as it arrives
+			if ((nil == inDataPtr->emulator.payloadHandler) &&
+				(false == inDataPtr->emulator.stringAccumulator.empty()) && (':' == inDataPtr->emulator.stringAccumulator.back()) &&
+				((0 == inDataPtr->emulator.stringAccumulator.compare(0, 5, REINTERPRET_CAST("File=", UInt8 const*))) ||
+					(0 == inDataPtr->emulator.stringAccumulator.compare(0, 5, REINTERPRET_CAST("file=", UInt8 const*)))))
+			{
+				beginFileStream(inDataPtr);
+			}
+			streamStringAccumulator(inDataPtr, false/* is final */);
 		}
 		break;
 	
@@ -8864,7 +11581,12 @@ stateTransition		(My_ScreenBufferPtr			inDataPtr,
 				NSMutableArray*		equalsSeparated = [[asNSString componentsSeparatedByString:@"="] mutableCopy];
 				
 				
-				if (equalsSeparated.count < 2)
+				if (nil != inDataPtr->emulator.payloadHandler)
+				{
+					// file data has been arriving in pieces; give the rest
+					streamStringAccumulator(inDataPtr, true/* is final */);
+				}
+				else if (equalsSeparated.count < 2)
 				{
 					Console_Warning(Console_WriteValue, "unable to parse; expected key=value but fragment count", equalsSeparated.count);
 				}
@@ -8873,308 +11595,306 @@ stateTransition		(My_ScreenBufferPtr			inDataPtr,
 					id			objectKey = [equalsSeparated objectAtIndex:0];
 					assert([objectKey isKindOfClass:NSString.class]);
 					NSString*	stringKey = STATIC_CAST(objectKey, NSString*);
-					NSString*	stringValue = nil; // set below
 					
 					
-					[equalsSeparated removeObjectAtIndex:0];
-					stringValue = [equalsSeparated componentsJoinedByString:@"="]; // allow equal signs in the remainder
-					
 					if ([stringKey isEqualToString:@"File"] || [stringKey isEqualToString:@"file"])
 					{
-						// custom iTerm2 sequence for downloading file data
-						NSArray*	colonSeparated = [stringValue componentsSeparatedByString:@":"];
-						
-						
-						if (colonSeparated.count != 2)
-						{
-							Console_Warning(Console_WriteValue, "expected two colon-separated fragments but saw count", colonSeparated.count);
-						}
-						else
-						{
-							id			objectEntry0 = [colonSeparated objectAtIndex:0];
-							id			objectEntry1 = [colonSeparated objectAtIndex:1];
-							assert([objectEntry0 isKindOfClass:NSString.class]);
-							assert([objectEntry1 isKindOfClass:NSString.class]);
-							NSString*	argumentsString = STATIC_CAST(objectEntry0, NSString*);
-							NSArray*	semicolonSeparated = [argumentsString componentsSeparatedByString:@";"];
-							NSString*	dataString = STATIC_CAST(objectEntry1, NSString*);
-							UInt16		totalPixelsH = 0; // reset below
-							UInt16		totalPixelsV = 0; // reset below
-							UInt16		defaultCellPixelsH = 9; // reset below
-							UInt16		defaultCellPixelsV = 12; // reset below
-							UInt16		suggestedCellCountH = 0;
-							UInt16		suggestedCellCountV = 0;
-							Boolean		isBase64 = true; // see below
-							Boolean		dumpImage = false;
-							Boolean		ignoreAspectRatio = false;
-							
-							
-							for (id argObject in semicolonSeparated)
-							{
-								assert([argObject isKindOfClass:NSString.class]);
-								NSString*			argString = STATIC_CAST(argObject, NSString*);
-								NSMutableArray*		argKeyValue = [[argString componentsSeparatedByString:@"="] mutableCopy];
-								
-								
-								if (argKeyValue.count < 2)
-								{
-									Console_Warning(Console_WriteValueCFString, "expected key=value; unable to process string", BRIDGE_CAST(argumentsString, CFStringRef));
-								}
-								else
-								{
-									id			objectArgName = [argKeyValue objectAtIndex:0];
-									assert([objectArgName isKindOfClass:NSString.class]);
-									NSString*	argName = STATIC_CAST(objectArgName, NSString*);
-									NSString*	argValue = nil; // see below
-									
-									
-									[argKeyValue removeObjectAtIndex:0];
-									argValue = [argKeyValue componentsJoinedByString:@"="]; // allow equal signs in the value itself
-									
-									//Console_WriteValueCFString("received argument name", BRIDGE_CAST(argName, CFStringRef)); // debug
-									//Console_WriteValueCFString("received argument value", BRIDGE_CAST(argValue, CFStringRef)); // debug
-									
-									if ([argName isEqualToString:@"name"])
-									{
-										// the name is actually a string encoded in base64
-										NSData*		decodedName = [[NSData alloc]
-																	initWithBase64EncodedString:argValue
-																								options:(NSDataBase64DecodingIgnoreUnknownCharacters)];
-										NSString*	decodedString = [[NSString alloc] initWithData:decodedName encoding:NSUTF8StringEncoding];
-										
-										
-										if (nil == decodedString)
-										{
-											Console_Warning(Console_WriteLine, "failed to decode base64 for 'name' argument");
-										}
-										else
-										{
-											SessionRef		session = returnListeningSession(inDataPtr);
-											
-											
-											if (nil == session)
-											{
-												Console_Warning(Console_WriteValueCFString, "no session found for terminal; ignoring file name",
-																BRIDGE_CAST(decodedString, CFStringRef));
-											}
-											else
-											{
-												Session_DisplayFileDownloadNameUI(session, BRIDGE_CAST(decodedString, CFStringRef));
-											}
-										}
-									}
-									else if ([argName isEqualToString:@"inline"])
-									{
-										if ([argValue isEqualToString:@"1"] || [argValue isEqualToString:@"true"])
-										{
-											dumpImage = true;
-										}
-									}
-									else if ([argName isEqualToString:@"size"])
-									{
-										// total image data size in bytes; not used right now
-										Console_Warning(Console_WriteLine, "ignored argument 'size'");
-									}
-									else if ([argName isEqualToString:@"preserveAspectRatio"])
-									{
-										if ([argValue isEqualToString:@"0"] || [argValue isEqualToString:@"false"])
-										{
-											ignoreAspectRatio = true;
-											Console_WriteLine("ignoring image aspect ratio"); // debug
-										}
-										else
-										{
-											ignoreAspectRatio = false;
-										}
-									}
-									else if ([argName isEqualToString:@"width"] || [argName isEqualToString:@"height"])
-									{
-										Boolean		isWidth = [argName isEqualToString:@"width"]; // otherwise, height
-										
-										
-										if ([argValue isEqualToString:@"auto"])
-										{
-											// implied for zero values (see below)
-											if (isWidth)
-											{
-												totalPixelsH = 0;
-											}
-											else
-											{
-												totalPixelsV = 0;
-											}
-										}
-										else
-										{
-											if ([argValue hasSuffix:@"px"])
-											{
-												// number of pixels
-												NSScanner*		valueScanner = [NSScanner scannerWithString:argValue];
-												NSString*		subValue = nil;
-												
-												
-												if ([valueScanner scanUpToString:@"px" intoString:&subValue])
-												{
-													UInt16 const	kPixelCount = STATIC_CAST([subValue integerValue], UInt16);
-													
-													
-													if (isWidth)
-													{
-														totalPixelsH = kPixelCount;
-													}
-													else
-													{
-														totalPixelsV = kPixelCount;
-													}
-													
-													//Console_WriteValue("set image pixel width/height", kPixelCount); // debug
-												}
-											}
-											else if ([argValue hasSuffix:@"%"])
-											{
-												// INCOMPLETE; percent not supported for arbitrary values but it is
-												// easy to support some common absolute percentages
-												if ([argValue isEqualToString:@"100%"])
-												{
-													if (isWidth)
-													{
-														suggestedCellCountH = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
-													}
-													else
-													{
-														suggestedCellCountV = inDataPtr->screenBuffer.size();
-													}
-												}
-												else
-												{
-													Console_Warning(Console_WriteValueCFString, "ignored unusual width/height percentage value (try '100%')", BRIDGE_CAST(argValue, CFStringRef));
-												}
-											}
-											else
-											{
-												// number of ordinary cells to occupy; this is handled by scaling
-												// the “pixels per cell” later, when the image dimensions are final
-												UInt16 const	kCellCount = STATIC_CAST([argValue integerValue], UInt16);
-												
-												
-												if (isWidth)
-												{
-													suggestedCellCountH = kCellCount;
-												}
-												else
-												{
-													suggestedCellCountV = kCellCount;
-												}
-												
-												//Console_WriteValue("set image cell count across/down", kCellCount); // debug
-											}
-										}
-									}
-									else
-									{
-										// ???
-										Console_Warning(Console_WriteValueCFString, "ignored argument with name", BRIDGE_CAST(argName, CFStringRef));
-										// INCOMPLETE; process arguments
-									}
-								}
-							}
-							
-							if (isBase64)
-							{
-								NSData*		decodedData = [[NSData alloc]
-															initWithBase64EncodedString:dataString
-																						options:(NSDataBase64DecodingIgnoreUnknownCharacters)];
-								
-								
-								if (nil == decodedData)
-								{
-									Console_Warning(Console_WriteLine, "unable to process given string; expected base64 format");
-								}
-								else
-								{
-									if (dumpImage)
-									{
-										Boolean const	kScrollWithImage = true;
-										Boolean const	kRestoreCursor = false;
-										NSImage*		decodedImage = [[NSImage alloc] initWithData:decodedData];
-										
-										
-										if (0 == totalPixelsH)
-										{
-											// automatically determine width
-											totalPixelsH = STATIC_CAST(decodedImage.size.width, UInt16);
-										}
-										
-										if (0 == totalPixelsV)
-										{
-											// automatically determine height
-											totalPixelsV = STATIC_CAST(decodedImage.size.height, UInt16);
-										}
-										
-										if (false == ignoreAspectRatio)
-										{
-											Console_Warning(Console_WriteLine, "preservation of aspect ratio is not implemented");
-										}
-										
-										if (0 != suggestedCellCountH)
-										{
-											// use given number of cells across
-											defaultCellPixelsH = std::max< UInt16 >(1, STATIC_CAST(roundf(STATIC_CAST(totalPixelsH, Float32) /
-																											STATIC_CAST(suggestedCellCountH, Float32)),
-																									UInt16));
-										}
-										
-										if (0 != suggestedCellCountV)
-										{
-											// use given number of cells down
-											defaultCellPixelsV = std::max< UInt16 >(1, STATIC_CAST(roundf(STATIC_CAST(totalPixelsV, Float32) /
-																											STATIC_CAST(suggestedCellCountV, Float32)),
-																									UInt16));
-										}
-										
-										bufferInsertInlineImageWithoutUpdate(inDataPtr, decodedImage, totalPixelsH, totalPixelsV,
-																				defaultCellPixelsH, defaultCellPixelsV,
-																				kScrollWithImage, kRestoreCursor);
-									}
-									else
-									{
-										Console_Warning(Console_WriteLine, "recognized and decoded image but file downloading is not implemented; try using 'inline=1'");
-									}
-								}
-							}
+						// file data is normally streamed as it arrives (see beginFileStream()),
+						// which requires a colon between the arguments and the data
+						Console_Warning(Console_WriteLine, "expected two colon-separated fragments but saw no colon");
+					}
+					else
+					{
+						// ???
+						Console_Warning(Console_WriteValueCFString, "unable to process given string; unsupported key", BRIDGE_CAST(stringKey, CFStringRef));
+					}
+				}
+				
+				inDataPtr->emulator.stringAccumulator.clear();
+				inDataPtr->emulator.stringAccumulatorState = kMy_ParserStateInitial;
+			}
+			break;
+		
+		default:
+			// ignore
+			outHandled = false;
+			break;
+		}
+		break;
+	
+	default:
+		// other state transitions are not handled at all
+		outHandled = false;
+		break;
+	}
+	
+	// WARNING: Do not call any other full emulator here!  This is a
+	//          pre-callback ONLY, which is designed to fall through
+	//          to something else (such as a VT100).
+	
+	return result;
+}// My_ITermCore::stateTransition
+
+
+/*!
+Examines the parameters at the start of a device control
+string; if they end with "q" (i.e. ESC P <params> q) then the
+string is Sixel data, and the emulator is set up to give the
+rest of the string to a decoder in pieces as it arrives (see
+streamStringAccumulator()).  The parameters are removed from
+the accumulator.  Otherwise, nothing is changed.
+
+(2023.10)
+*/
+void
+My_SixelCore::
+beginImageStream	(My_ScreenBufferPtr		inDataPtr)
+{
+	// in order to represent a Sixel image, a device control string must
+	// contain the parameter terminator "q" (i.e. ESC P <params> q)
+	ParameterDecoder_StateMachine				paramDecoder;
+	std::basic_string< UInt8 >::const_iterator	pastEndParams = inDataPtr->emulator.stringAccumulator.end();
+	
+	
+	getParametersFromStringAccumulator(inDataPtr, paramDecoder, pastEndParams);
+	if ((inDataPtr->emulator.stringAccumulator.end() != pastEndParams) && ('q' == *pastEndParams))
+	{
+		UInt16								aspectRatioParameter = (paramDecoder.parameterValues.empty()
+																	? 0
+																	: paramDecoder.parameterValues[0]);
+		UInt16								initialAspectRatioV = 2; // see below
+		UInt16								initialAspectRatioH = 1; // see below
+		Boolean								zeroValuePixelsKeepColor = false; // see below
+		
+		
+		if (DebugInterface_LogsSixelDecoderState())
+		{
+			//Console_WriteLine("started reading Sixel data"); // debug
+		}
+		
+		// the following according to the VT330/VT340 manual
+		switch (aspectRatioParameter)
+		{
+		case 2:
+			initialAspectRatioV = 5;
+			initialAspectRatioH = 1;
+			break;
+		
+		case 3:
+		case 4:
+			initialAspectRatioV = 3;
+			initialAspectRatioH = 1;
+			break;
+		
+		case 7:
+		case 8:
+		case 9:
+			initialAspectRatioV = 1;
+			initialAspectRatioH = 1;
+			break;
+		
+		case 0:
+		case 1:
+		case 5:
+		case 6:
+		default:
+			// 2:1 (see above)
+			break;
+		}
+		
+		if (DebugInterface_LogsSixelDecoderSummary())
+		{
+			Console_WriteHorizontalRule();
+			Console_WriteValue("default pan (Sixel aspect ratio height) set to", initialAspectRatioV);
+			Console_WriteValue("default pad (Sixel aspect ratio width) set to", initialAspectRatioH);
+		}
+		
+		// determine if “off” bits use the current color or revert to the background color
+		zeroValuePixelsKeepColor = ((paramDecoder.parameterValues.size() > 0)
+									? (1 == paramDecoder.parameterValues[1])
+									: false);
+		if (zeroValuePixelsKeepColor)
+		{
+			if (DebugInterface_LogsSixelDecoderSummary())
+			{
+				Console_WriteLine("Sixel image is configured to not change the color of zero-value pixels"); // debug
+			}
+		}
+		
+		if (paramDecoder.parameterValues.size() > 2)
+		{
+			if (DebugInterface_LogsSixelDecoderErrors())
+			{
+				Console_Warning(Console_WriteValue, "ignoring Sixel grid size parameter", paramDecoder.parameterValues[2]);
+			}
+		}
+		
+		// only the data follows in the accumulator (usually nothing yet)
+		inDataPtr->emulator.stringAccumulator.erase(inDataPtr->emulator.stringAccumulator.cbegin(), pastEndParams + 1/* skip terminating 'q' */);
+		
+		// the decoder is kept alive by the handler, which is released
+		// after the last piece (or when the string is interrupted);
+		// the data is also hashed so that a repeated image is found
+		{
+			auto	stream = std::make_shared< SixelDecoder_Stream >(initialAspectRatioV, initialAspectRatioH);
+			auto	contentKey = std::make_shared< ImageStore_ContentKey >();
+			
+			
+			contentKey->appendBytes(&initialAspectRatioV, sizeof(initialAspectRatioV));
+			contentKey->appendBytes(&initialAspectRatioH, sizeof(initialAspectRatioH));
+			inDataPtr->emulator.payloadHandler =
+			^(My_ScreenBuffer* inHandlerDataPtr, UInt8 const* inBuffer, size_t inLength, Boolean inIsFinal)
+			{
+				if (DebugInterface_LogsSixelInput())
+				{
+					std::string		dataString(REINTERPRET_CAST(inBuffer, char const*), inLength);
+					
+					
+					Console_WriteValueCString("accumulated string", dataString.c_str());
+				}
+				
+				stream->appendData(inBuffer, inLength);
+				contentKey->appendBytes(inBuffer, inLength);
+				
+				if (inIsFinal)
+				{
+					finishImageStream(inHandlerDataPtr, *stream, *contentKey);
+				}
+			};
+		}
+	}
+}// My_SixelCore::beginImageStream
+
+
+/*!
+Places an image for the Sixel data that has been given to
+the specified stream, once all of the data has arrived.
+
+Only the size of the image is found right away (the stream
+tracks it as data arrives) so that terminal cells can be
+reserved for it and the cursor can move past it; the pixels
+are still being decoded on another thread, and the cells
+show the image as soon as it is ready.
+
+If the same data was seen before (according to the given
+key) then the stored image is displayed again instead, and
+the stream’s result is not used.
+
+(2023.10)
+*/
+void
+My_SixelCore::
+finishImageStream	(My_ScreenBufferPtr				inDataPtr,
+					 SixelDecoder_Stream&			inStream,
+					 ImageStore_ContentKey const&	inContentKey)
+{
+	// NOTE: the dimensions and ratio values chosen by default are
+	// based on what the VT300 series uses for 80-column mode; it
+	// may eventually be good to vary these values based on the
+	// purpose of input Sixel data (for instance, 132-column mode
+	// apparently uses 9 pixels wide instead of 15, and if custom
+	// character sets are ever supported then their default pixel
+	// height is 3:1 over the width)  
+	NSImage*				placeholderImage = nil;
+	TerminalScreenRef const	kScreenRef = inDataPtr->selfRef;
+	ImageStore_ImageID		imageID = ImageStore_FindImage(inContentKey);
+	UInt16					defaultCellPixelsH = 9; // number of dots across to define a terminal cell at normal width
+	UInt16					defaultCellPixelsV = 12; // number of dots down to define a terminal cell at normal height
+	UInt16					totalPixelsH = 0;
+	UInt16					totalPixelsV = 0;
+	
+	
+	inStream.getImageSize(totalPixelsH, totalPixelsV);
+	if (DebugInterface_LogsSixelDecoderSummary())
+	{
+		Console_WriteValue("Sixel image width (in screen pixels)", totalPixelsH);
+		Console_WriteValue("Sixel image height (in screen pixels)", totalPixelsV);
+	}
+	
+	// the cells refer to an image with no representation, which
+	// draws nothing; the decoded pixels are added to the same
+	// object later, so every cell is updated at once
+	if (kImageStore_InvalidImageID == imageID)
+	{
+		placeholderImage = [[NSImage alloc] initWithSize:NSMakeSize(totalPixelsH, totalPixelsV)];
+		imageID = ImageStore_AddImage(placeholderImage, inContentKey);
+	}
+	
+	// determine the terminal cells that will need to have a bitmap association
+	// scrolling is technically controlled by a terminal parameter sequence
+	// but in the future it may be good to let the user force image scrolling
+	Boolean const	kScrollWithImage = inDataPtr->emulator.allowSixelScrolling;
+	// according to VT300 series documentation, the text cursor does not move
+	// from its original position if scrolling is disabled
+	Boolean const	kRestoreCursor = (false == kScrollWithImage);
+	bufferInsertInlineImageWithoutUpdate(inDataPtr, imageID, totalPixelsH, totalPixelsV,
+											defaultCellPixelsH, defaultCellPixelsV,
+											kScrollWithImage, kRestoreCursor);
+	
+	// a repeated image is already (or will soon be) decoded, so
+	// the stream is only finished for a new image
+	if (nil != placeholderImage)
+	{
+		// the screen must not be destroyed before the image is ready
+		Terminal_RetainScreen(kScreenRef);
+		inStream.finishImage(^(CGImageRef inDecodedImage)
+		{
+			dispatch_async(dispatch_get_main_queue(),
+			^{
+				TerminalScreenRef	screenRef = kScreenRef;
+				My_ScreenBufferPtr	dataPtr = getVirtualScreenData(screenRef);
+				
+				
+				if (nullptr == inDecodedImage)
+				{
+					if (DebugInterface_LogsSixelDecoderErrors())
+					{
+						Console_Warning(Console_WriteLine, "failed to decode Sixel image");
+					}
+				}
+				else
+				{
+					[placeholderImage addRepresentation:[[NSBitmapImageRep alloc] initWithCGImage:inDecodedImage]];
+					CGImageRelease(inDecodedImage);
+					ImageStore_ImageChanged(imageID);
+					
+					// write complete image for debugging (helps to separate possible issues
+					// with terminal display from issues with raw image content)
+					if (DebugInterface_LogsSixelDecoderState())
+					{
+						NSData*		imageData = [placeholderImage TIFFRepresentation];
+						NSString*	filePath = @"/tmp/macterm_sixel_image.tiff";
+						
+						
+						if (NO == [[NSFileManager defaultManager] createFileAtPath:filePath contents:imageData attributes:nil])
+						{
+							Console_Warning(Console_WriteValueCFString, "failed to write debugging image, path", BRIDGE_CAST(filePath, CFStringRef));
 						}
 					}
-					else
+					
+					// the image may have scrolled anywhere by now, so
+					// redraw every row that could be showing it
+					if (nullptr != dataPtr)
 					{
-						// ???
-						Console_Warning(Console_WriteValueCFString, "unable to process given string; unsupported key", BRIDGE_CAST(stringKey, CFStringRef));
+						Terminal_RangeDescription	range;
+						
+						
+						bzero(&range, sizeof(range));
+						range.screen = dataPtr->selfRef;
+						range.firstRow = -STATIC_CAST(dataPtr->scrollbackBuffer.size(), SInt64);
+						range.firstColumn = 0;
+						range.columnCount = dataPtr->text.visibleScreen.numberOfColumnsPermitted;
+						range.rowCount = STATIC_CAST(dataPtr->scrollbackBuffer.size() + dataPtr->screenBuffer.size(), SInt64);
+						
+						changeNotifyForTerminal(dataPtr, kTerminal_ChangeTextEdited, &range);
 					}
 				}
 				
-				inDataPtr->emulator.stringAccumulator.clear();
-				inDataPtr->emulator.stringAccumulatorState = kMy_ParserStateInitial;
-			}
-			break;
-		
-		default:
-			// ignore
-			outHandled = false;
-			break;
-		}
-		break;
-	
-	default:
-		// other state transitions are not handled at all
-		outHandled = false;
-		break;
+				Terminal_ReleaseScreen(&screenRef);
+			});
+		});
 	}
-	
-	// WARNING: Do not call any other full emulator here!  This is a
-	//          pre-callback ONLY, which is designed to fall through
-	//          to something else (such as a VT100).
-	
-	return result;
-}// My_ITermCore::stateTransition
+}// My_SixelCore::finishImageStream
 
 
 /*!
@@ -9244,510 +11964,77 @@ stateTransition		(My_ScreenBufferPtr			inDataPtr,
 		{
 			Boolean const	kParameterIsSet = (My_VT100::kStateSM == inOldNew.second);
 			
-			
-			// defer the entire set/reset handler to the actual terminal emulator
-			// but check for a Sixel parameter here
-			outHandled = false;
-			
-			switch (inDataPtr->emulator.argList[0])
-			{
-			case kMy_ParamPrivate: // DEC-private control sequence
-				{
-					SInt16		i = 0;
-					
-					
-					for (i = 1/* skip the meta-parameter */; i <= inDataPtr->emulator.argLastIndex; ++i)
-					{
-						switch (inDataPtr->emulator.argList[i])
-						{
-						case 80:
-							// in Sixel mode, request to turn scrolling on/off
-							inDataPtr->emulator.allowSixelScrolling = kParameterIsSet;
-							if (kParameterIsSet)
-							{
-								Console_WriteLine("request to allow Sixel scrolling");
-							}
-							else
-							{
-								Console_WriteLine("request to prohibit Sixel scrolling");
-							}
-							outHandled = true;
-							break;
-						
-						case kMy_ParamUndefined:
-						default:
-							// (pass to parent emulator)
-							break;
-						}
-					}
-				}
-				break;
-			
-			default:
-				break;
-			}
-		}
-		break;
-	
-	case My_VT220::kStateST:
-		// when a Sixel image is complete, process the contents of the buffer
-		if (My_VT220::kStateDCS == inDataPtr->emulator.stringAccumulatorState)
-		{
-			// in order to represent a Sixel image, a device control string must
-			// contain the parameter terminator "q" (i.e. ESC P <params> q)
-			ParameterDecoder_StateMachine				paramDecoder;
-			std::basic_string< UInt8 >::const_iterator	pastEndParams = inDataPtr->emulator.stringAccumulator.end();
-			
-			
-			getParametersFromStringAccumulator(inDataPtr, paramDecoder, pastEndParams);
-			if ((inDataPtr->emulator.stringAccumulator.end() != pastEndParams) && ('q' == *pastEndParams))
-			{
-				typedef decltype(inDataPtr->emulator.stringAccumulator.size())	StringAccumulatorSize;
-				decltype(pastEndParams) const	kSixelDataBegin = (pastEndParams + 1/* skip terminating 'q' */);
-				decltype(pastEndParams) const	kPastEndSixelData = inDataPtr->emulator.stringAccumulator.end();
-				StringAccumulatorSize const		kSixelDataSize = std::distance(kSixelDataBegin, kPastEndSixelData);
-				
-				
-				if (DebugInterface_LogsSixelDecoderState())
-				{
-					//Console_WriteLine("stopped reading Sixel data"); // debug
-				}
-				
-				SixelDecoder_StateMachine			sixelDecoder;
-				SixelDecoder_StateMachine const&	decoderRef = sixelDecoder; // so copied blocks can refer to object without copying object
-				UInt16								aspectRatioParameter = (paramDecoder.parameterValues.empty()
-																			? 0
-																			: paramDecoder.parameterValues[0]);
-				UInt16								initialAspectRatioV = 2; // see below
-				UInt16								initialAspectRatioH = 1; // see below
-				Boolean								zeroValuePixelsKeepColor = false; // see below
-				
-				
-				// the following according to the VT330/VT340 manual
-				switch (aspectRatioParameter)
-				{
-				case 2:
-					initialAspectRatioV = 5;
-					initialAspectRatioH = 1;
-					break;
-				
-				case 3:
-				case 4:
-					initialAspectRatioV = 3;
-					initialAspectRatioH = 1;
-					break;
-				
-				case 7:
-				case 8:
-				case 9:
-					initialAspectRatioV = 1;
-					initialAspectRatioH = 1;
-					break;
-				
-				case 0:
-				case 1:
-				case 5:
-				case 6:
-				default:
-					// 2:1 (see above)
-					break;
-				}
-				
-				if (DebugInterface_LogsSixelDecoderSummary())
-				{
-					Console_WriteHorizontalRule();
-					Console_WriteValue("default pan (Sixel aspect ratio height) set to", initialAspectRatioV);
-					Console_WriteValue("default pad (Sixel aspect ratio width) set to", initialAspectRatioH);
-				}
-				
-				// determine if “off” bits use the current color or revert to the background color
-				zeroValuePixelsKeepColor = ((paramDecoder.parameterValues.size() > 0)
-											? (1 == paramDecoder.parameterValues[1])
-											: false);
-				if (zeroValuePixelsKeepColor)
-				{
-					if (DebugInterface_LogsSixelDecoderSummary())
-					{
-						Console_WriteLine("Sixel image is configured to not change the color of zero-value pixels"); // debug
-					}
-				}
-				
-				if (paramDecoder.parameterValues.size() > 2)
-				{
-					if (DebugInterface_LogsSixelDecoderErrors())
-					{
-						Console_Warning(Console_WriteValue, "ignoring Sixel grid size parameter", paramDecoder.parameterValues[2]);
-					}
-				}
-				
-				// process the Sixel data
-				// (TEMPORARY; may need to have a background thread that separates terminal
-				// cell processing from image processing so that control can return to the
-				// terminal while very large images are being constructed)
-				{
-					// NOTE: the dimensions and ratio values chosen by default are
-					// based on what the VT300 series uses for 80-column mode; it
-					// may eventually be good to vary these values based on the
-					// purpose of input Sixel data (for instance, 132-column mode
-					// apparently uses 9 pixels wide instead of 15, and if custom
-					// character sets are ever supported then their default pixel
-					// height is 3:1 over the width)  
-					__block NSColor*				currentColor = nil; // if "nil", use background color
-					__block NSMutableDictionary*	colorsByIndex = [[NSMutableDictionary alloc] init];
-					NSImage*						completeImage = nil;
-					CGContextRef					drawingContext = nullptr;
-					UInt16							defaultCellPixelsH = 9; // number of dots across to define a terminal cell at normal width
-					UInt16							defaultCellPixelsV = 12; // number of dots down to define a terminal cell at normal height
-					UInt16							totalPixelsH = 0;
-					UInt16							totalPixelsV = 0;
-					UInt16							sixelSizeH = 1; // number of normal pixels occupied horizontally for each “sixel”
-					UInt16							sixelSizeV = 1; // number of normal pixels occupied vertically for each “sixel”
-					size_t							processedBytes = 0;
-					
-					
-					if (DebugInterface_LogsSixelInput())
-					{
-						std::basic_string< UInt8 >		dataString(kSixelDataBegin, kPastEndSixelData);
-						
-						
-						Console_WriteValueCString("accumulated string", REINTERPRET_CAST(dataString.c_str(), char const*));
-					}
-					
-					// the exact size of the image cannot be determined without parsing
-					// all of the sixel data; therefore, this is done in two passes
-					// (at the end of the first pass, the configuration of the image
-					// and final graphics cursor position are used to find the size)
-					sixelDecoder.reset();
-					sixelDecoder.aspectRatioV = initialAspectRatioV; // default only; can change if raster attributes are parsed
-					sixelDecoder.aspectRatioH = initialAspectRatioH;
-					for (auto toByte = kSixelDataBegin; toByte != kPastEndSixelData; ++toByte)
-					{
-						SixelDecoder_StateMachine::State const	kOriginalState = sixelDecoder.returnState();
-						SInt16									loopGuard = 0;
-						Boolean									byteNotUsed = true;
-						
-						
-						while (byteNotUsed)
-						{
-							sixelDecoder.goNextState(*toByte, byteNotUsed);
-							if ((byteNotUsed) && (kOriginalState == sixelDecoder.returnState()))
-							{
-								// no way to proceed
-								break;
-							}
-							++loopGuard;
-							if (loopGuard > 100/* arbitrary */)
-							{
-								break;
-							}
-						}
-					}
-					
-					// now that the maximum movement of the graphics cursor and pixel aspect ratio
-					// are known, specify the image dimensions (consider both the locations that
-					// the graphics cursor has moved to, and any configured image size parameters;
-					// the real canvas size will be whichever is larger!)
-					sixelDecoder.getSixelSize(sixelSizeV, sixelSizeH);
-					totalPixelsH = ((1 + sixelDecoder.graphicsCursorMaxX) * sixelSizeH);
-					totalPixelsV = ((1 + sixelDecoder.graphicsCursorMaxY) * sixelSizeV * 6/* sixel has 6 bits, one per vertical plot */);
-					//totalPixelsH = std::max< UInt16 >(totalPixelsH, sixelDecoder.suggestedImageWidth);
-					//totalPixelsV = std::max< UInt16 >(totalPixelsV, sixelDecoder.suggestedImageHeight);
-					
-					// allocate a large enough bitmap image
-					{
-						NSInteger const		kBitsPerSample = 8; // currently, 0-255 values defined
-						NSInteger const		kSamplesPerPixel = 4; // red, green, blue, alpha
-						NSInteger const		kBitsPerPixel = (kBitsPerSample * kSamplesPerPixel);
-						NSInteger const		kBytesPerRow = ((kBitsPerPixel / 8) * totalPixelsH);
-						CGColorSpaceRef		colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
-						
-						
-						// note: casting kCGBitmapByteOrderDefault and kCGImageAlphaNoneSkipLast to
-						// the same base integer type to suppress compiler warning about combining
-						// different enum types with "|" (the API requires it so this has to be
-						// suppressed)
-						drawingContext = CGBitmapContextCreate(nullptr/* data or nullptr to auto-allocate */, totalPixelsH, totalPixelsV, kBitsPerSample, kBytesPerRow,
-																colorSpace,
-																(STATIC_CAST(kCGBitmapByteOrderDefault, uint32_t) |
-																	STATIC_CAST(kCGImageAlphaNoneSkipLast, uint32_t)));
-						assert(nullptr != drawingContext);
-						//NSLog(@"Sixel bitmap %lf x %lf, context@%p, colorspace@%p", (double)totalPixelsH, (double)totalPixelsV, drawingContext, colorSpace); // debug
-						CGColorSpaceRelease(colorSpace); colorSpace = nullptr;
-						
-						// transform to expected coordinate system
-						CGContextTranslateCTM(drawingContext, 0, totalPixelsV); // anchor at top
-						CGContextScaleCTM(drawingContext, 1.0, -1.0); // flip vertically
-						
-						// configure for bitmap drawing (otherwise, a line drawn at the same
-						// start and end coordinates will have no rendering)
-						CGContextSetLineWidth(drawingContext, 1.0);
-						CGContextSetLineCap(drawingContext, kCGLineCapSquare);
-						CGContextSetAllowsAntialiasing(drawingContext, false);
-					}
-					
-					// now reset the decoder and repeat the parsing sequence,
-					// this time with an appropriately-allocated image and
-					// blocks of code defined; this will cause the parser to
-					// call the blocks as key states are entered and ultimately
-					// set colored pixels in the bitmap buffer
-					sixelDecoder.reset();
-					sixelDecoder.aspectRatioV = initialAspectRatioV; // default only; can change if raster attributes are parsed
-					sixelDecoder.aspectRatioH = initialAspectRatioH;
-					sixelDecoder.setColorCreator(^(UInt16 colorIndex, SixelDecoder_ColorType colorType,
-													UInt16 component1, UInt16 component2, UInt16 component3)
-					{
-						// create and select non-default color
-						NSNumber*	colorNumber = [NSNumber numberWithInteger:colorIndex];
-						NSColor*	newColor = nil;
-						
-						
-						switch (colorType)
-						{
-						case kSixelDecoder_ColorTypeHLS:
-							// note: given in HLS order, not HSB order (flipping last two values)
-							newColor = [NSColor colorWithCalibratedHue:(component1 / 360.0) saturation:(component3 / 100.0)
-																		brightness:(component2 / 100.0) alpha:1.0];
-							break;
-						
-						case kSixelDecoder_ColorTypeRGB:
-							newColor = [NSColor colorWithCalibratedRed:(component1 / 100.0) green:(component2 / 100.0)
-																		blue:(component3 / 100.0) alpha:1.0];
-							break;
-						
-						default:
-							// ???
-							break;
-						}
-						if ((nil == newColor) || (nil == colorNumber))
-						{
-							if (DebugInterface_LogsSixelDecoderErrors())
-							{
-								Console_Warning(Console_WriteValue, "failed to define Sixel color, index", colorIndex);
-							}
-						}
-						else
-						{
-							// the VT330/340 manual says that a VT300 would only fill the width/height
-							// when zero-pixels are set to use the current background (as opposed to
-							// keeping their previous color); this isn’t practical though because image
-							// conversion utilities typically provide only the sixel data string and
-							// not the introductory terminal sequence that would specify a color mode,
-							// causing images to have large gaps if no background fill is performed
-							//Boolean const	kAutoFillBackground = (false == zeroValuePixelsKeepColor);
-							Boolean const	kAutoFillBackground = true;
-							Boolean const	kFirstColor = (0 == colorsByIndex.count);
-							
-							
-							newColor = [newColor colorUsingColorSpace:[NSColorSpace sRGBColorSpace]];
-							[colorsByIndex setObject:newColor forKey:colorNumber];
-							
-							if (DebugInterface_LogsSixelDecoderSummary())
-							{
-								Console_WriteValue("Sixel color defined with index", colorIndex);
-								Console_WriteValueFloat4("Sixel color components", newColor.redComponent, newColor.greenComponent, newColor.blueComponent, newColor.alphaComponent);
-							}
-							
-							CGContextSetRGBFillColor(drawingContext, newColor.redComponent, newColor.greenComponent, newColor.blueComponent, 1.0/* alpha */);
-							
-							if ((kAutoFillBackground) && (kFirstColor) &&
-								(decoderRef.suggestedImageWidth > 0) && (decoderRef.suggestedImageHeight > 0))
-							{
-								// the first time a color is defined, fill the image background
-								// (the VT300 manual specifies only the region that is filled, as
-								// the width/height from raster attributes; it isn’t clear what
-								// “background color” should be; this interpretation is somewhat
-								// arbitrary but it seems compatible with known image utilities)
-								if (DebugInterface_LogsSixelDecoderSummary())
-								{
-									Console_WriteLine("Sixel color definition will be used for background");
-								}
-								
-							#if 1
-								// can clear suggested area (relying on Sixel-provided dimensions)
-								// or erase the actual area traversed by graphics commands, which
-								// is more accurate overall
-								//CGContextFillRect(drawingContext, CGRectMake(0, 0, decoderRef.suggestedImageWidth * sixelSizeH, decoderRef.suggestedImageHeight * 6 * sixelSizeV));
-								CGContextFillRect(drawingContext, CGRectMake(0, 0, totalPixelsH, totalPixelsV));
-							#else
-								// debug: provide a way to tweak every pixel (at performance cost)
-								for (UInt16 i = 0; i < decoderRef.suggestedImageWidth; ++i)
-								{
-									auto const	kPixelX = (sixelSizeH * i);
-									
-									
-									for (UInt16 j = 0; j < decoderRef.suggestedImageHeight; ++j)
-									{
-										auto const	kPixelY = (sixelSizeV * (6/* bits per sixel */ * j));
-										
-										
-										CGContextFillRect(drawingContext, CGRectMake(kPixelX, kPixelY, sixelSizeH, 6 * sixelSizeV));
-									}
-								}
-							#endif
-							}
-						}
-					});
-					sixelDecoder.setColorChooser(^(UInt16 index)
-					{
-						// select color (see also the color creator above)
-						NSNumber*	colorNumber = [NSNumber numberWithInteger:index];
-						
-						
-						currentColor = [colorsByIndex objectForKey:colorNumber];
-					});
-					sixelDecoder.setSixelHandler(^(UInt8 rawChar, UInt16 repeatCount)
-					{
-						// process a sixel (render up to 6 points in a vertical line,
-						// where each position’s real pixel size depends on the aspect
-						// ratio that was defined)
-						std::bitset<6>	topToBottomOnOffFlags;
-						
-						
-						SixelDecoder_StateMachine::getSixelBits(rawChar, topToBottomOnOffFlags);
-						if (topToBottomOnOffFlags.none() && (zeroValuePixelsKeepColor))
-						{
-							// in this configuration, no pixels in the line of 6 are changing
-						}
-						else
-						{
-							// at least one pixel will change
-							auto			kSixelBitCount = topToBottomOnOffFlags.size();
-							CGFloat const	kForegroundRed = currentColor.redComponent;
-							CGFloat const	kForegroundGreen = currentColor.greenComponent;
-							CGFloat const	kForegroundBlue = currentColor.blueComponent;
-							
-							
-							for (UInt16 i = 0; i < repeatCount; ++i)
-							{
-								auto const	kPixelX = (sixelSizeH * (decoderRef.graphicsCursorX + i));
-								
-								
-								// see earlier definition; "nil" used to mean “use background” (also,
-								// there is no erase phase because off-pixels simply rely on the
-								// pre-filled background and/or any previous pixel at that location)
-								if (nil != currentColor)
-								{
-									CGContextSetRGBFillColor(drawingContext, kForegroundRed, kForegroundGreen, kForegroundBlue, 1.0/* alpha */);
-									if (topToBottomOnOffFlags.all())
-									{
-										// all 6 pixels are being drawn
-										CGContextFillRect(drawingContext, CGRectMake(kPixelX, (sixelSizeV * (decoderRef.graphicsCursorY * kSixelBitCount)),
-																						sixelSizeH, sixelSizeV * kSixelBitCount));
-									}
-									else
-									{
-										// some pixels are being drawn
-										for (decltype(kSixelBitCount) j = 0; j < kSixelBitCount; ++j)
-										{
-											auto const	kPixelY = (sixelSizeV * (decoderRef.graphicsCursorY * kSixelBitCount + j));
-											
-											
-											if (topToBottomOnOffFlags.test(j))
-											{
-												// draw
-											#if 0
-												CGContextFillRect(drawingContext, CGRectMake(kPixelX, kPixelY, sixelSizeH, sixelSizeV));
-											#else
-												// debug: provide a way to tweak every pixel (at performance cost)
-												for (auto k = 0; k < sixelSizeV; ++k)
-												{
-													for (auto l = 0; l < sixelSizeH; ++l)
-													{
-														CGContextFillRect(drawingContext, CGRectMake((kPixelX + l), (kPixelY + k), 1, 1));
-													}
-												}
-											#endif
-											}
-										}
-									}
-								}
-							}
-						}
-					});
-					for (auto toByte = kSixelDataBegin; toByte != kPastEndSixelData; ++toByte)
+			
+			// defer the entire set/reset handler to the actual terminal emulator
+			// but check for a Sixel parameter here
+			outHandled = false;
+			
+			switch (inDataPtr->emulator.argList[0])
+			{
+			case kMy_ParamPrivate: // DEC-private control sequence
+				{
+					SInt16		i = 0;
+					
+					
+					for (i = 1/* skip the meta-parameter */; i <= inDataPtr->emulator.argLastIndex; ++i)
 					{
-						SixelDecoder_StateMachine::State const	kOriginalState = sixelDecoder.returnState();
-						SInt16									loopGuard = 0;
-						Boolean									byteNotUsed = true;
-						
-						
-						while (byteNotUsed)
+						switch (inDataPtr->emulator.argList[i])
 						{
-							sixelDecoder.goNextState(*toByte, byteNotUsed);
-							if (DebugInterface_LogsSixelInput())
-							{
-								//Console_WriteValueFourChars("Sixel parser state", sixelDecoder.returnState());
-							}
-							
-							if ((byteNotUsed) && (kOriginalState == sixelDecoder.returnState()))
+						case 80:
+							// in Sixel mode, request to turn scrolling on/off
+							inDataPtr->emulator.allowSixelScrolling = kParameterIsSet;
+							if (kParameterIsSet)
 							{
-								// no way to proceed
-								break;
+								Console_WriteLine("request to allow Sixel scrolling");
 							}
-							
-							++loopGuard;
-							if (loopGuard > 100/* arbitrary */)
+							else
 							{
-								Sound_StandardAlert();
-								Console_Warning(Console_WriteLine, "Sixel decoder forced to break after unexpected tight loop");
-								break;
+								Console_WriteLine("request to prohibit Sixel scrolling");
 							}
-						}
-						++processedBytes;
-					}
-					if (processedBytes < kSixelDataSize)
-					{
-						Console_Warning(Console_WriteValue, "Sixel decoder did not handle entire data string; bytes left",
-										kSixelDataSize - processedBytes);
-					}
-					
-					if (DebugInterface_LogsSixelDecoderSummary())
-					{
-						Console_WriteValue("final cursor position relative to Sixel image: x", sixelDecoder.graphicsCursorX);
-						Console_WriteValue("final cursor position relative to Sixel image: y", sixelDecoder.graphicsCursorY);
-						Console_WriteValue("apparent width in “sixels”", 1 + sixelDecoder.graphicsCursorMaxX);
-						Console_WriteValue("apparent height in “sixels”", 1 + sixelDecoder.graphicsCursorMaxY);
-						Console_WriteValue("final pan (aspect ratio, vertical)", sixelDecoder.aspectRatioV);
-						Console_WriteValue("final pad (aspect ratio, horizontal)", sixelDecoder.aspectRatioH);
-						Console_WriteValue("calculated “sixel” width (in screen pixels)", sixelSizeH);
-						Console_WriteValue("calculated “sixel” height (in screen pixels)", sixelSizeV);
-					}
-					
-					// convert image for rendering
-					{
-						CGImageRef	snapshotCGImage = CGBitmapContextCreateImage(drawingContext);
-						
-						
-						completeImage = [[NSImage alloc] initWithCGImage:snapshotCGImage size:NSZeroSize/* if NSZeroSize, CGImage size is used */];
-						CGImageRelease(snapshotCGImage); snapshotCGImage = nullptr;
-					}
-					
-					// write complete image for debugging (helps to separate possible issues
-					// with terminal display from issues with raw image content)
-					if (DebugInterface_LogsSixelDecoderState())
-					{
-						NSData*		imageData = [completeImage TIFFRepresentation];
-						NSString*	filePath = @"/tmp/macterm_sixel_image.tiff";
-						
+							outHandled = true;
+							break;
 						
-						if (NO == [[NSFileManager defaultManager] createFileAtPath:filePath contents:imageData attributes:nil])
-						{
-							Console_Warning(Console_WriteValueCFString, "failed to write debugging image, path", BRIDGE_CAST(filePath, CFStringRef));
+						case kMy_ParamUndefined:
+						default:
+							// (pass to parent emulator)
+							break;
 						}
 					}
-					
-					// determine the terminal cells that will need to have a bitmap association
-					// scrolling is technically controlled by a terminal parameter sequence
-					// but in the future it may be good to let the user force image scrolling
-					Boolean const	kScrollWithImage = inDataPtr->emulator.allowSixelScrolling;
-					// according to VT300 series documentation, the text cursor does not move
-					// from its original position if scrolling is disabled
-					Boolean const	kRestoreCursor = (false == kScrollWithImage);
-					bufferInsertInlineImageWithoutUpdate(inDataPtr, completeImage, totalPixelsH, totalPixelsV,
-															defaultCellPixelsH, defaultCellPixelsV,
-															kScrollWithImage, kRestoreCursor);
 				}
-				
+				break;
+			
+			default:
+				break;
+			}
+		}
+		break;
+	
+	case My_VT220::kStateDCSAcquireStr:
+		// once the parameters of Sixel data have been read, the rest of
+		// the string is given to a decoder in pieces as it arrives; the
+		// string is recognized here, before the byte after "q" is added
+		// (the parent emulator accumulates the byte)
+		if ((nil == inDataPtr->emulator.payloadHandler) && (My_VT220::kStateDCS == inDataPtr->emulator.stringAccumulatorState) &&
+			(false == inDataPtr->emulator.stringAccumulator.empty()) && ('q' == inDataPtr->emulator.stringAccumulator.back()))
+		{
+			beginImageStream(inDataPtr);
+		}
+		outHandled = false;
+		break;
+	
+	case My_VT220::kStateST:
+		// when a Sixel image is complete, process the rest of the data
+		if (My_VT220::kStateDCS == inDataPtr->emulator.stringAccumulatorState)
+		{
+			if (nil == inDataPtr->emulator.payloadHandler)
+			{
+				// the data could be empty, ending right after the parameters
+				beginImageStream(inDataPtr);
+			}
+			
+			if (nil != inDataPtr->emulator.payloadHandler)
+			{
+				streamStringAccumulator(inDataPtr, true/* is final */);
 				inDataPtr->emulator.stringAccumulator.clear();
 				inDataPtr->emulator.stringAccumulatorState = kMy_ParserStateInitial;
 			}
@@ -13088,10 +15375,14 @@ insertBlankCharacters	(My_ScreenBufferPtr		inDataPtr)
 			characterCount = 1;
 		}
 		
-		bufferInsertBlanksAtCursorColumnWithoutUpdate(inDataPtr, characterCount,
-														inDataPtr->emulator.supportsVariant(My_Emulator::kVariantFlagXTermBCE)
-														? kMy_AttributeRuleCopyLatentBackground
-														: kMy_AttributeRuleInitialize);
+		if (bufferInsertBlanksAtCursorColumnWithoutUpdate(inDataPtr, characterCount,
+															inDataPtr->emulator.supportsVariant(My_Emulator::kVariantFlagXTermBCE)
+															? kMy_AttributeRuleCopyLatentBackground
+															: kMy_AttributeRuleInitialize))
+		{
+			// the first half of a split double-width character was erased
+			--preWriteCursorX;
+		}
 		
 		// add the effects of the insert to the text-change region;
 		// this should trigger things like Terminal View updates
@@ -13894,6 +16185,7 @@ stateTransition		(My_ScreenBufferPtr			inDataPtr,
 		inDataPtr->emulator.clearEscapeSequenceParameters(); // should not be needed; just avoiding side effects
 		inDataPtr->emulator.stringAccumulator.clear();
 		inDataPtr->emulator.stringAccumulatorState = inOldNew.second;
+		inDataPtr->emulator.payloadHandler = nil; // any interrupted string is abandoned
 		break;
 	
 	case kStateDCSAcquireStr:
@@ -13918,6 +16210,9 @@ stateTransition		(My_ScreenBufferPtr			inDataPtr,
 				inDataPtr->emulator.stringAccumulator.push_back(STATIC_CAST(inDataPtr->emulator.recentCodePoint(), UInt8));
 				result = 1;
 			}
+			
+			// if a handler recognized the string, pass it along in pieces
+			streamStringAccumulator(inDataPtr, false/* is final */);
 		}
 		break;
 	
@@ -15579,2638 +17874,3980 @@ stateTransition		(My_ScreenBufferPtr			inDataPtr,
 							outHandled = true;
 							break;
 						
-						case 1053:
-							// SCO function-key mode
-							if (kParameterIsSet)
-							{
-								Console_WriteLine("request to set SCO function-key mode");
-							}
-							else
-							{
-								Console_WriteLine("request to reset SCO function-key mode");
-							}
-							// UNIMPLEMENTED
-							outHandled = true;
-							break;
+						case 1053:
+							// SCO function-key mode
+							if (kParameterIsSet)
+							{
+								Console_WriteLine("request to set SCO function-key mode");
+							}
+							else
+							{
+								Console_WriteLine("request to reset SCO function-key mode");
+							}
+							// UNIMPLEMENTED
+							outHandled = true;
+							break;
+						
+						case 1060:
+							// legacy keyboard emulation (X11R6)
+							if (kParameterIsSet)
+							{
+								Console_WriteLine("request to set legacy keyboard emulation (X11R6)");
+							}
+							else
+							{
+								Console_WriteLine("request to reset legacy keyboard emulation (X11R6)");
+							}
+							// UNIMPLEMENTED
+							outHandled = true;
+							break;
+						
+						case 1061:
+							// Sun/PC keyboard emulation of VT220
+							if (kParameterIsSet)
+							{
+								Console_WriteLine("request to set Sun/PC keyboard emulation of VT220");
+							}
+							else
+							{
+								Console_WriteLine("request to reset Sun/PC keyboard emulation of VT220");
+							}
+							// UNIMPLEMENTED
+							outHandled = true;
+							break;
+						
+						case 2004:
+							// bracketed Paste mode
+							if (kParameterIsSet)
+							{
+								//Console_WriteLine("request to set bracketed Paste mode"); // debug
+							}
+							else
+							{
+								//Console_WriteLine("request to reset bracketed Paste mode"); // debug
+							}
+							inDataPtr->modeBracketedPaste = kParameterIsSet;
+							//changeNotifyForTerminal(inDataPtr, kTerminal_ChangePasteMode, inDataPtr->selfRef/* context */); // (not needed)
+							outHandled = true;
+							break;
+						
+						case 0:
+						case 1:
+						case 2:
+						case 3:
+						case 4:
+						case 5:
+						case 6:
+						case 7:
+						case 8:
+						case kMy_ParamUndefined:
+						default:
+							// (pass to parent emulator)
+							break;
+						}
+					}
+				}
+				break;
+			
+			default:
+				// 
+				break;
+			}
+		}
+		break;
+	
+	case kStateCBT:
+		cursorBackwardTabulation(inDataPtr);
+		break;
+	
+	case kStateCHA:
+		cursorCharacterAbsolute(inDataPtr);
+		break;
+	
+	case kStateCHT:
+		cursorForwardTabulation(inDataPtr);
+		break;
+	
+	case kStateCNL:
+		cursorNextLine(inDataPtr);
+		break;
+	
+	case kStateCPL:
+		cursorPreviousLine(inDataPtr);
+		break;
+	
+	case kStateCSITertiaryDA:
+		// flag to mark the control sequence as tertiary device attributes
+		inDataPtr->emulator.argList[inDataPtr->emulator.argLastIndex] = kMy_ParamTertiaryDA;
+		++(inDataPtr->emulator.argLastIndex);
+		break;
+	
+	case kStateHPA:
+		horizontalPositionAbsolute(inDataPtr);
+		break;
+	
+	case kStateSD:
+		scrollDown(inDataPtr);
+		break;
+	
+	case kStateSU:
+		scrollUp(inDataPtr);
+		break;
+	
+	case kStateVPA:
+		verticalPositionAbsolute(inDataPtr);
+		break;
+	
+	default:
+		// call the XTerm “core” to handle the sequence and update "outHandled" appropriately;
+		// note that the core IS NOT a complete emulator, which is why this routine falls
+		// back to a proper VT220 at the end instead of falling back to the core exclusively
+		result = invokeEmulatorStateTransitionProc
+					(My_XTermCore::stateTransition, inDataPtr,
+						inOldNew, outHandled);
+		break;
+	}
+	
+	if (false == outHandled)
+	{
+		// other state transitions should still basically be handled as if in VT100
+		result = invokeEmulatorStateTransitionProc
+					(My_VT220::stateTransition, inDataPtr,
+						inOldNew, outHandled);
+	}
+	
+	return result;
+}// My_XTerm::stateTransition
+
+
+/*!
+Handles the XTerm 'VPA' sequence.
+
+This should accept up to 2 parameters.  With no parameters, the
+cursor is moved to the first row, but the same cursor column.  If
+there is just one parameter, it is a one-based index for the new
+cursor row, using the same column.  And with two parameters, the
+parameters are the one-based indices of the new cursor row and
+column, in that order.
+
+See also the 'CUP' sequence in the VT terminal.
+
+(4.0)
+*/
+void
+My_XTerm::
+verticalPositionAbsolute	(My_ScreenBufferPtr		inDataPtr)
+{
+	SInt16 const		kParam0 = inDataPtr->emulator.argList[0];
+	SInt16 const		kParam1 = inDataPtr->emulator.argList[1];
+	SInt16				newX = inDataPtr->current.cursorX;
+	My_ScreenRowIndex	newY = 0;
+	
+	
+	// in the following definitions, 0 and 1 are considered the same number
+	if (kMy_ParamUndefined == kParam1)
+	{
+		// only one parameter was given, so it is the row and
+		// the cursor column does not change
+		newY = (0 == kParam0)
+				? 0
+				: (kMy_ParamUndefined != kParam0)
+					? kParam0 - 1
+					: 0/* default is row 1 in current column */;
+	}
+	else
+	{
+		// two parameters, giving (row, column)
+		newY = (0 == kParam0)
+				? 0
+				: (kMy_ParamUndefined != kParam0)
+					? kParam0 - 1
+					: 0/* default is the home cursor row */;
+		newX = (0 == kParam1)
+				? 0
+				: kParam1 - 1;
+	}
+	
+	// the new values are not checked for violation of constraints
+	// because constraints (including current origin mode) are
+	// automatically enforced by moveCursor...() routines
+	moveCursor(inDataPtr, newX, newY);
+}// My_XTerm::verticalPositionAbsolute
+
+
+/*!
+A standard "My_EmulatorStateDeterminantProcPtr" that sets
+XTerm-specific window states based on the characters of the
+given buffer.
+
+(4.0)
+*/
+UInt32
+My_XTermCore::
+stateDeterminant	(My_EmulatorPtr			inEmulatorPtr,
+					 My_ParserStatePair&	inNowOutNext,
+					 Boolean&				UNUSED_ARGUMENT(outInterrupt),
+					 Boolean&				outHandled)
+{
+	UInt32 const	kTriggerChar = inEmulatorPtr->recentCodePoint();
+	UInt32			result = 1; // the first character is *usually* “used”, so 1 is the default (it may change)
+	
+	
+	switch (inNowOutNext.first)
+	{
+	#if 0
+	case kMy_ParserStateSeenESC:
+	case kMy_ParserStateSeenESCRightSqBracket:
+		result = inEmulatorPtr->currentCallbacks.stateDeterminant(inEmulatorPtr, inBuffer, inLength,
+																	inNowOutNext, outInterrupt, outHandled);
+		break;
+	#endif
+	
+	case kStateSWITAcquireStr:
+		if (inEmulatorPtr->supportsVariant(My_Emulator::kVariantFlagXTermAlterWindow))
+		{
+			switch (kTriggerChar)
+			{
+			case '\007':
+				inNowOutNext.second = My_VT220::kStateST;
+				break;
+			
+			case '\033':
+				inNowOutNext.second = kMy_ParserStateSeenESC;
+				break;
+			
+			default:
+				// continue extending the string until a known terminator is found
+				inNowOutNext.second = kStateSWITAcquireStr;
+				result = 0; // do not absorb the unknown
+				break;
+			}
+		}
+		else
+		{
+			// ignore
+			outHandled = false;
+		}
+		break;
+	
+	case kStateSITAcquireStr:
+		if (inEmulatorPtr->supportsVariant(My_Emulator::kVariantFlagXTermAlterWindow))
+		{
+			switch (kTriggerChar)
+			{
+			case '\007':
+				inNowOutNext.second = My_VT220::kStateST;
+				break;
+			
+			case '\033':
+				inNowOutNext.second = kMy_ParserStateSeenESC;
+				break;
+			
+			default:
+				// continue extending the string until a known terminator is found
+				inNowOutNext.second = kStateSITAcquireStr;
+				result = 0; // do not absorb the unknown
+				break;
+			}
+		}
+		else
+		{
+			// ignore
+			outHandled = false;
+		}
+		break;
+	
+	case kStateSWTAcquireStr:
+		if (inEmulatorPtr->supportsVariant(My_Emulator::kVariantFlagXTermAlterWindow))
+		{
+			switch (kTriggerChar)
+			{
+			case '\007':
+				inNowOutNext.second = My_VT220::kStateST;
+				break;
+			
+			case '\033':
+				inNowOutNext.second = kMy_ParserStateSeenESC;
+				break;
+			
+			default:
+				// continue extending the string until a known terminator is found
+				inNowOutNext.second = kStateSWTAcquireStr;
+				result = 0; // do not absorb the unknown
+				break;
+			}
+		}
+		else
+		{
+			// ignore
+			outHandled = false;
+		}
+		break;
+	
+	case kStateColorAcquireStr:
+		if (inEmulatorPtr->supportsVariant(My_Emulator::kVariantFlagXTerm256Color))
+		{
+			switch (kTriggerChar)
+			{
+			case '\033':
+				inNowOutNext.second = kMy_ParserStateSeenESC;
+				break;
+			
+			default:
+				// continue extending the string; termination is an escape sequence (a different state)
+				inNowOutNext.second = kStateColorAcquireStr;
+				result = 0; // do not absorb the unknown
+				break;
+			}
+		}
+		else
+		{
+			// ignore
+			outHandled = false;
+		}
+		break;
+	
+	default:
+		// other states are not handled at all
+		outHandled = false;
+		break;
+	}
+	
+	// WARNING: Do not call any other full emulator here!  This is a
+	//          pre-callback ONLY, which is designed to fall through
+	//          to something else (such as a VT100).
+	
+	// debug
+	//Console_WriteValueFourChars("    <<< XTerm in state", inNowOutNext.first);
+	//Console_WriteValueFourChars(">>>     XTerm proposes state", inNowOutNext.second);
+	//Console_WriteValueUnicodePoint("        XTerm bases this at least on character", kTriggerChar);
+	
+	return result;
+}// My_XTermCore::stateDeterminant
+
+
+/*!
+A standard "My_EmulatorStateTransitionProcPtr" that responds to
+XTerm-specific window state changes.
+
+(4.0)
+*/
+UInt32
+My_XTermCore::
+stateTransition		(My_ScreenBufferPtr			inDataPtr,
+					 My_ParserStatePair const&	inOldNew,
+					 Boolean&					outHandled)
+{
+	UInt32		result = 0; // usually, no characters are consumed at the transition stage
+	
+	
+	// decide what to do based on the proposed transition
+	// INCOMPLETE
+	switch (inOldNew.second)
+	{
+	case kStateSWIT:
+	case kStateSIT:
+	case kStateSWT:
+	case kStateSetColor:
+		inDataPtr->emulator.stringAccumulator.clear();
+		inDataPtr->emulator.stringAccumulatorState = inOldNew.second;
+		break;
+	
+	case kStateColorAcquireStr:
+	case kStateSWITAcquireStr:
+	case kStateSITAcquireStr:
+	case kStateSWTAcquireStr:
+		// upon first entry to the state, ignore the code point (semicolon)
+		// that caused the state to be selected; only accumulate code points
+		// that occurred while the previous state was also accumulating
+		if (inOldNew.first == inOldNew.second)
+		{
+			if (inDataPtr->emulator.isUTF8Encoding)
+			{
+				if (UTF8Decoder_StateMachine::kStateUTF8ValidSequence == inDataPtr->emulator.multiByteDecoder.returnState())
+				{
+					std::copy(inDataPtr->emulator.multiByteDecoder.multiByteAccumulator.begin(),
+								inDataPtr->emulator.multiByteDecoder.multiByteAccumulator.end(),
+								std::back_inserter(inDataPtr->emulator.stringAccumulator));
+					result = 1;
+				}
+			}
+			else
+			{
+				inDataPtr->emulator.stringAccumulator.push_back(STATIC_CAST(inDataPtr->emulator.recentCodePoint(), UInt8));
+				result = 1;
+			}
+		}
+		break;
+	
+	case My_VT220::kStateST:
+		// a string-based terminal sequence can be terminated in multiple
+		// ways; if a new-style XTerm string terminator is seen, then the
+		// action must be chosen based on the state that most recently used
+		// the string buffer
+		switch (inDataPtr->emulator.stringAccumulatorState)
+		{
+		case My_VT220::kStateDCS:
+			{
+				// scan the device control string for the expected terminators;
+				// otherwise, pass to a parent handler (e.g. might be Sixel data);
+				// a string that is being streamed has already been recognized,
+				// and the accumulator only has its last piece
+				ParameterDecoder_StateMachine				paramDecoder;
+				std::basic_string< UInt8 >::const_iterator	pastEndParams = inDataPtr->emulator.stringAccumulator.end();
+				
+				
+				getParametersFromStringAccumulator(inDataPtr, paramDecoder, pastEndParams);
+				if ((nil == inDataPtr->emulator.payloadHandler) &&
+					(inDataPtr->emulator.stringAccumulator.end() != pastEndParams) && ('$' == *pastEndParams) &&
+					(inDataPtr->emulator.stringAccumulator.end() != (1 + pastEndParams)) && ('q' == *(1 + pastEndParams)))
+				{
+					// “ESC P $ q” (DECRQSS)
+					typedef decltype(inDataPtr->emulator.stringAccumulator.size())	StringAccumulatorSize;
+					decltype(pastEndParams) const	kMainStringBegin = (pastEndParams + 2/* skip terminating '$q' */);
+					decltype(pastEndParams) const	kPastEndMainString = inDataPtr->emulator.stringAccumulator.end();
+					StringAccumulatorSize const		kStringDataSize = std::distance(kMainStringBegin, kPastEndMainString);
+					Boolean							requestHandled = true;
+					
+					
+					if (DebugInterface_LogsTerminalState())
+					{
+						std::basic_string< UInt8 >		requestString(kMainStringBegin, kPastEndMainString);
+						
 						
-						case 1060:
-							// legacy keyboard emulation (X11R6)
-							if (kParameterIsSet)
-							{
-								Console_WriteLine("request to set legacy keyboard emulation (X11R6)");
-							}
-							else
-							{
-								Console_WriteLine("request to reset legacy keyboard emulation (X11R6)");
-							}
-							// UNIMPLEMENTED
-							outHandled = true;
-							break;
+						Console_WriteValueCString("received request for selection or setting, string", REINTERPRET_CAST(requestString.c_str(), char const*));
+					}
+					
+					if (1 == kStringDataSize)
+					{
+						if ('r' == *kMainStringBegin)
+						{
+							// report value for DECSTBM from XTerm (or VT100)
+							My_XTerm::reportTopBottomMargins(inDataPtr);
+							requestHandled = true;
+						}
+						else
+						{
+							// INCOMPLETE; dozens of other XTerm sequences should be supported here
+						}
+					}
+					else if (2 == kStringDataSize)
+					{
+						if ((' '/* space */ == *kMainStringBegin) && ('q' == *(1 + kMainStringBegin)))
+						{
+							// report value for DECSCUSR from XTerm (or VT520)
+							My_XTerm::reportCursorStyle(inDataPtr);
+							requestHandled = true;
+						}
+						else
+						{
+							// INCOMPLETE; dozens of other XTerm sequences should be supported here
+						}
+					}
+					
+					if (false == requestHandled)
+					{
+						// most requests are not recognized right now; give a default response
+						My_XTerm::reportSelectionSettingNotUsed(inDataPtr);
+					}
+					
+					inDataPtr->emulator.stringAccumulator.clear();
+					inDataPtr->emulator.stringAccumulatorState = kMy_ParserStateInitial;
+				}
+			}
+			break;
+		
+		case kStateSWIT:
+		case kStateSIT:
+		case kStateSWT:
+			if (inDataPtr->emulator.supportsVariant(My_Emulator::kVariantFlagXTermAlterWindow))
+			{
+				CFRetainRelease		titleCFString(CFStringCreateWithBytes(kCFAllocatorDefault,
+																			inDataPtr->emulator.stringAccumulator.c_str(),
+																			inDataPtr->emulator.stringAccumulator.size(),
+																			inDataPtr->emulator.inputTextEncoding,
+																			false/* is external representation */),
+													CFRetainRelease::kAlreadyRetained);
+				
+				
+				if (titleCFString.exists())
+				{
+					if ((kStateSWIT == inDataPtr->emulator.stringAccumulatorState) ||
+						(kStateSWT == inDataPtr->emulator.stringAccumulatorState))
+					{
+						inDataPtr->windowTitleCFString = titleCFString;
+						changeNotifyForTerminal(inDataPtr, kTerminal_ChangeWindowFrameTitle, inDataPtr->selfRef/* context */);
+					}
+					if ((kStateSWIT == inDataPtr->emulator.stringAccumulatorState) ||
+						(kStateSIT == inDataPtr->emulator.stringAccumulatorState))
+					{
+						inDataPtr->iconTitleCFString = titleCFString;
+						changeNotifyForTerminal(inDataPtr, kTerminal_ChangeWindowIconTitle, inDataPtr->selfRef/* context */);
+					}
+				}
+				
+				inDataPtr->emulator.stringAccumulator.clear();
+				inDataPtr->emulator.stringAccumulatorState = kMy_ParserStateInitial;
+			}
+			else
+			{
+				// ignore
+				outHandled = false;
+			}
+			break;
+		
+		case kStateSetColor:
+			if (inDataPtr->emulator.supportsVariant(My_Emulator::kVariantFlagXTerm256Color))
+			{
+				// the accumulated string up to this point actually needs to be parsed; currently,
+				// only strings of this form are allowed:
+				//		%d;rgb:%x/%x/%x - set color at index, to red, green, blue components in hex
+				char const*		stringPtr = REINTERPRET_CAST(inDataPtr->emulator.stringAccumulator.c_str(), char const*);
+				int				i = 0;
+				int				r = 0;
+				int				g = 0;
+				int				b = 0;
+				int				scanResult = sscanf(stringPtr, "%d;rgb:%x/%x/%x", &i, &r, &g, &b);
+				
+				
+				if (4 == scanResult)
+				{
+					if ((i > 255) || (r > 255) || (g > 255) || (b > 255) ||
+						(i < 16/* cannot overwrite base ANSI colors */) || (r < 0) || (g < 0) || (b < 0))
+					{
+						Console_Warning(Console_WriteValueFloat4, "one or more illegal indices found in request to set XTerm color: index, red, green, blue", i, r, g, b);
+					}
+					else
+					{
+						// success!
+						Terminal_XTermColorDescription		colorInfo;
 						
-						case 1061:
-							// Sun/PC keyboard emulation of VT220
-							if (kParameterIsSet)
-							{
-								Console_WriteLine("request to set Sun/PC keyboard emulation of VT220");
-							}
-							else
-							{
-								Console_WriteLine("request to reset Sun/PC keyboard emulation of VT220");
-							}
-							// UNIMPLEMENTED
-							outHandled = true;
-							break;
 						
-						case 2004:
-							// bracketed Paste mode
-							if (kParameterIsSet)
-							{
-								//Console_WriteLine("request to set bracketed Paste mode"); // debug
-							}
-							else
-							{
-								//Console_WriteLine("request to reset bracketed Paste mode"); // debug
-							}
-							inDataPtr->modeBracketedPaste = kParameterIsSet;
-							//changeNotifyForTerminal(inDataPtr, kTerminal_ChangePasteMode, inDataPtr->selfRef/* context */); // (not needed)
-							outHandled = true;
-							break;
+						bzero(&colorInfo, sizeof(colorInfo));
+						colorInfo.screen = inDataPtr->selfRef;
+						colorInfo.index = STATIC_CAST(i, UInt8);
+						colorInfo.redComponent = STATIC_CAST(r, UInt8);
+						colorInfo.greenComponent = STATIC_CAST(g, UInt8);
+						colorInfo.blueComponent = STATIC_CAST(b, UInt8);
 						
-						case 0:
-						case 1:
-						case 2:
-						case 3:
-						case 4:
-						case 5:
-						case 6:
-						case 7:
-						case 8:
-						case kMy_ParamUndefined:
-						default:
-							// (pass to parent emulator)
-							break;
-						}
+						changeNotifyForTerminal(inDataPtr, kTerminal_ChangeXTermColor, &colorInfo/* context */);
+						
+						//Console_WriteValueFloat4("set color at index to red, green, blue", i, r, g, b);
 					}
 				}
-				break;
+				else
+				{
+					Console_Warning(Console_WriteValue, "failed to parse XTerm color string; sscanf() result", scanResult);
+					Console_Warning(Console_WriteValueCString, "discarding unrecognized syntax for XTerm color string", stringPtr);
+				}
+				
+				inDataPtr->emulator.stringAccumulator.clear();
+				inDataPtr->emulator.stringAccumulatorState = kMy_ParserStateInitial;
+			}
+			else
+			{
+				// ignore
+				outHandled = false;
+			}
+			break;
+		
+		default:
+			// ignore
+			outHandled = false;
+			break;
+		}
+		break;
+	
+	default:
+		// other state transitions are not handled at all
+		outHandled = false;
+		break;
+	}
+	
+	// WARNING: Do not call any other full emulator here!  This is a
+	//          pre-callback ONLY, which is designed to fall through
+	//          to something else (such as a VT100).
+	
+	return result;
+}// My_XTermCore::stateTransition
+
+
+/*!
+Prepares a search of the given screen for the given query;
+see isValid().  If the search will run in the background,
+its chunks lock the screen while reading (see searchRun()).
+
+(2023.10)
+*/
+My_Search::
+My_Search	(My_ScreenBufferPtr		inDataPtr,
+			 CFStringRef			inQuery,
+			 Terminal_SearchFlags	inFlags,
+			 bool					inIsInBackground)
+:
+pattern(inQuery, inFlags),
+resultsQueue(),
+screenLines(),
+context(),
+isStopRequested(false)
+{
+	if (pattern.isValid())
+	{
+		size_t const	kScrollbackSize = inDataPtr->scrollbackBuffer.size();
+		size_t const	kChunkCount = 1/* screen */ + ((kScrollbackSize + My_SearchContext::kScrollbackChunkRowCount - 1)
+														/ My_SearchContext::kScrollbackChunkRowCount);
+		
+		
+		screenLines.reserve(inDataPtr->screenBuffer.size());
+		for (My_ScreenBufferLinePtr const& kLinePtr : inDataPtr->screenBuffer)
+		{
+			screenLines.push_back(&kLinePtr);
+		}
+		
+		UNUSED_RETURN(int)pthread_mutex_init(&resultsQueue.mutex, nullptr);
+		UNUSED_RETURN(int)pthread_cond_init(&resultsQueue.condition, nullptr);
+		resultsQueue.chunkResults.resize(kChunkCount);
+		for (auto& chunkResultsRef : resultsQueue.chunkResults)
+		{
+			chunkResultsRef.isFinished = false;
+		}
+		
+		context.screenBufferPtr = inDataPtr;
+		context.patternPtr = &pattern;
+		context.resultsQueuePtr = &resultsQueue;
+		context.screenLinesPtr = &screenLines;
+		context.searchIndexPtr = nullptr;
+		context.invalidationCount = inDataPtr->backgroundSearch.invalidationCount;
+		context.isInBackground = inIsInBackground;
+		
+		// if the scrollback is indexed then a literal query can skip most
+		// lines (parts of the index that may be out of date are rebuilt)
+		inDataPtr->scrollbackBuffer.updateSearchIndex();
+		if ((nullptr != inDataPtr->scrollbackBuffer.returnSearchIndex()) &&
+			pattern.returnIndexTrigrams(context.indexTrigrams))
+		{
+			context.searchIndexPtr = inDataPtr->scrollbackBuffer.returnSearchIndex();
+		}
+	}
+}// My_Search 4-argument constructor
+
+
+/*!
+Destructor.
+
+(2023.10)
+*/
+My_Search::
+~My_Search ()
+{
+	if (pattern.isValid())
+	{
+		UNUSED_RETURN(int)pthread_cond_destroy(&resultsQueue.condition);
+		UNUSED_RETURN(int)pthread_mutex_destroy(&resultsQueue.mutex);
+	}
+}// My_Search destructor
+
+
+/*!
+Prepares the given query for searches; see isValid().
+
+If the flags require matches at the end of a line, any
+new-line characters at the end of the query are ignored.
+
+(2023.10)
+*/
+My_SearchPattern::
+My_SearchPattern	(CFStringRef			inQuery,
+					 Terminal_SearchFlags	inFlags)
+:
+literalCharacters(),
+regularExpression(nil),
+queryCFString(inQuery, CFRetainRelease::kNotYetRetained),
+queryCompareFlags(0),
+whitespaceSet(CFCharacterSetGetPredefined(kCFCharacterSetWhitespaceAndNewline)),
+isAnchoredAtEnd(0 != (inFlags & kTerminal_SearchFlagsMatchOnlyAtLineEnd)),
+isBackwards(0 != (inFlags & kTerminal_SearchFlagsSearchBackwards)),
+isDirect(false),
+isFoldingASCII(false)
+{
+	bool const		kIsCaseSensitive = (0 != (inFlags & kTerminal_SearchFlagsCaseSensitive));
+	
+	
+	if (isAnchoredAtEnd)
+	{
+		NSCharacterSet*		newlineSet = [NSCharacterSet characterSetWithCharactersInString:@"\n\r\0"];
+		NSString*			asNSString = BRIDGE_CAST(inQuery, NSString*);
+		
+		
+		// strip any new-lines that may be at the end of the query string
+		// (technically this call strips the characters from ANYWHERE in the
+		// query but realistically they would only appear at the end and this
+		// is simpler than manually creating a copy of the string and stripping
+		// only ending characters that match)
+		queryCFString = CFRetainRelease(BRIDGE_CAST([asNSString stringByTrimmingCharactersInSet:newlineSet], CFStringRef),
+										CFRetainRelease::kNotYetRetained);
+		queryCompareFlags |= (kCFCompareAnchored | kCFCompareBackwards);
+	}
+	if (isBackwards)
+	{
+		queryCompareFlags |= kCFCompareBackwards;
+	}
+	if (false == kIsCaseSensitive)
+	{
+		queryCompareFlags |= kCFCompareCaseInsensitive;
+	}
+	
+	if (inFlags & kTerminal_SearchFlagsRegularExpression)
+	{
+		NSError* /*__autoreleasing*/	error = nil;
+		
+		
+		regularExpression = [NSRegularExpression regularExpressionWithPattern:BRIDGE_CAST(queryCFString.returnCFStringRef(), NSString*)
+																				options:((kIsCaseSensitive)
+																							? 0
+																							: NSRegularExpressionCaseInsensitive)
+																				error:&error];
+		if (nil == regularExpression)
+		{
+			Console_Warning(Console_WriteValueCFString, "failed to create regex, error", BRIDGE_CAST([error localizedDescription], CFStringRef));
+		}
+	}
+	else
+	{
+		CFStringRef const	kQueryCFString = queryCFString.returnCFStringRef();
+		CFIndex const		kQueryLength = CFStringGetLength(kQueryCFString);
+		
+		
+		literalCharacters.resize(STATIC_CAST(kQueryLength, size_t));
+		CFStringGetCharacters(kQueryCFString, CFRangeMake(0, kQueryLength), literalCharacters.data());
+		isDirect = true;
+		if (false == kIsCaseSensitive)
+		{
+			// only ASCII case differences are handled directly
+			for (UniChar& queryCharacterRef : literalCharacters)
+			{
+				if (queryCharacterRef >= 0x80)
+				{
+					isDirect = false;
+				}
+				else if ((queryCharacterRef >= 'A') && (queryCharacterRef <= 'Z'))
+				{
+					queryCharacterRef += ('a' - 'A');
+				}
+			}
+			isFoldingASCII = isDirect;
+		}
+	}
+}// My_SearchPattern 2-argument constructor
+
+
+/*!
+Finds matches for a literal query directly in the given
+text, as a sequence of ranges in the order implied by the
+search flags (either from the beginning or from the end).
+Matches do not overlap.
+
+(2023.10)
+*/
+void
+My_SearchPattern::
+findLiteralMatches	(UniChar const*				inText,
+					 CFIndex					inLength,
+					 std::vector< CFRange >&	outRanges)
+const
+{
+	CFIndex const	kQueryLength = STATIC_CAST(literalCharacters.size(), CFIndex);
+	
+	
+	if (isAnchoredAtEnd)
+	{
+		CFIndex const	kLastStartIndex = (inLength - kQueryLength);
+		
+		
+		if ((kLastStartIndex >= 0) && (kLastStartIndex == returnLiteralMatchIndex(inText, inLength, kLastStartIndex)))
+		{
+			outRanges.push_back(CFRangeMake(kLastStartIndex, kQueryLength));
+		}
+	}
+	else if (isBackwards)
+	{
+		std::vector< CFRange >::size_type const		kFirstNewRange = outRanges.size();
+		CFIndex										limitIndex = inLength;
+		
+		
+		// find all (possibly overlapping) matches, and then keep only
+		// those that do not overlap when chosen from the end
+		for (CFIndex i = returnLiteralMatchIndex(inText, inLength, 0); kCFNotFound != i;
+				i = returnLiteralMatchIndex(inText, inLength, i + 1))
+		{
+			outRanges.push_back(CFRangeMake(i, kQueryLength));
+		}
+		std::reverse(outRanges.begin() + kFirstNewRange, outRanges.end());
+		auto	toWrittenRange = outRanges.begin() + kFirstNewRange;
+		for (auto toRange = toWrittenRange; toRange != outRanges.end(); ++toRange)
+		{
+			if ((toRange->location + toRange->length) <= limitIndex)
+			{
+				limitIndex = toRange->location;
+				*toWrittenRange++ = *toRange;
+			}
+		}
+		outRanges.erase(toWrittenRange, outRanges.end());
+	}
+	else
+	{
+		for (CFIndex i = returnLiteralMatchIndex(inText, inLength, 0); kCFNotFound != i;
+				i = returnLiteralMatchIndex(inText, inLength, i + kQueryLength))
+		{
+			outRanges.push_back(CFRangeMake(i, kQueryLength));
+		}
+	}
+}// My_SearchPattern::findLiteralMatches
+
+
+/*!
+Appends to the given list the ranges of all matches in the
+given line text.  Whitespace at the end of the text is not
+searched.
+
+This may be called from several threads at once.
+
+(2023.10)
+*/
+void
+My_SearchPattern::
+findMatches		(UniChar const*				inText,
+				 CFIndex					inLength,
+				 std::vector< CFRange >&	outRanges)
+const
+{
+	CFIndex		textLength = inLength;
+	
+	
+	// there is no benefit to scanning beyond the text portion of a line
+	while ((textLength > 0) && CFCharacterSetIsCharacterMember(whitespaceSet, inText[textLength - 1]))
+	{
+		--textLength;
+	}
+	
+	if (isDirect)
+	{
+		findLiteralMatches(inText, textLength, outRanges);
+	}
+	else
+	{
+		// the line is given to the system without copying it
+		CFRetainRelease		lineCFString(CFStringCreateWithCharactersNoCopy(kCFAllocatorDefault, inText, textLength, kCFAllocatorNull),
+											CFRetainRelease::kAlreadyRetained);
+		
+		
+		if (nil != regularExpression)
+		{
+			// regular expression string matches
+			std::vector< CFRange >*		rangesPtr = &outRanges; // (blocks cannot capture references)
+			bool const					kIsAnchoredAtEnd = isAnchoredAtEnd;
 			
-			default:
-				// 
-				break;
+			
+			@autoreleasepool
+			{
+				[regularExpression enumerateMatchesInString:BRIDGE_CAST(lineCFString.returnCFStringRef(), NSString*)
+															options:(NSMatchingOptions)0
+															range:NSMakeRange(0, textLength)
+															usingBlock:^(NSTextCheckingResult* aMatch, NSMatchingFlags UNUSED_ARGUMENT(flags),
+																			BOOL* UNUSED_ARGUMENT(outStop))
+															{
+																if ((false == kIsAnchoredAtEnd) ||
+																	(STATIC_CAST(NSMaxRange(aMatch.range), CFIndex) == textLength))
+																{
+																	rangesPtr->push_back(CFRangeMake(aMatch.range.location, aMatch.range.length));
+																}
+															}];
+			}
+		}
+		else
+		{
+			// literal string matches that cannot be compared directly
+			CFRetainRelease		resultsArray(CFStringCreateArrayWithFindResults
+												(kCFAllocatorDefault, lineCFString.returnCFStringRef(),
+													queryCFString.returnCFStringRef(), CFRangeMake(0, textLength),
+													queryCompareFlags),
+												CFRetainRelease::kAlreadyRetained);
+			CFArrayRef const	kResultsArrayRef = resultsArray.returnCFArrayRef();
+			CFIndex const		kNumberOfMatches = ((nullptr == kResultsArrayRef)
+													? 0
+													: CFArrayGetCount(kResultsArrayRef));
+			
+			
+			for (CFIndex i = 0; i < kNumberOfMatches; ++i)
+			{
+				outRanges.push_back(*REINTERPRET_CAST(CFArrayGetValueAtIndex(kResultsArrayRef, i), CFRange const*));
+			}
+		}
+	}
+}// My_SearchPattern::findMatches
+
+
+/*!
+Finds the hashes of every trigram that must appear in
+the text of any match (see My_ScrollbackSearchIndex),
+without duplicates.  Returns false if the query cannot
+use an index, in which case every line must be searched.
+
+An index only helps literal queries with at least three
+characters.  Also, if case is ignored then the query
+must only contain ASCII characters, since other letters
+may have case variants that the index does not fold.
+
+(2023.10)
+*/
+bool
+My_SearchPattern::
+returnIndexTrigrams		(std::vector< My_ScrollbackSearchIndex::TrigramHash >&	outHashes)
+const
+{
+	bool	result = false;
+	
+	
+	outHashes.clear();
+	if (isDirect && (literalCharacters.size() >= 3))
+	{
+		for (size_t i = 2; i < literalCharacters.size(); ++i)
+		{
+			outHashes.push_back(My_ScrollbackSearchIndex::returnTrigramHash(literalCharacters[i - 2], literalCharacters[i - 1],
+																				literalCharacters[i]));
+		}
+		std::sort(outHashes.begin(), outHashes.end());
+		outHashes.erase(std::unique(outHashes.begin(), outHashes.end()), outHashes.end());
+		result = true;
+	}
+	return result;
+}// My_SearchPattern::returnIndexTrigrams
+
+
+/*!
+Returns the index of the first match for a literal query
+that starts at or after the given index of the given text,
+or "kCFNotFound".
+
+Vector instructions (if available) skip quickly over text
+that cannot contain the first character of the query, so
+that only likely positions are compared in full.
+
+(2023.10)
+*/
+CFIndex
+My_SearchPattern::
+returnLiteralMatchIndex		(UniChar const*		inText,
+							 CFIndex			inLength,
+							 CFIndex			inStartIndex)
+const
+{
+	CFIndex const	kQueryLength = STATIC_CAST(literalCharacters.size(), CFIndex);
+	CFIndex const	kLastStartIndex = (inLength - kQueryLength);
+	UniChar const	kFirstCharacter = literalCharacters[0];
+	UniChar const	kFirstCharacterAlternate = ((isFoldingASCII) && (kFirstCharacter >= 'a') && (kFirstCharacter <= 'z'))
+												? STATIC_CAST(kFirstCharacter - ('a' - 'A'), UniChar)
+												: kFirstCharacter;
+	bool const		kIsFoldingASCII = isFoldingASCII;
+	auto			foldedCharacter = [kIsFoldingASCII](UniChar inCharacter) -> UniChar
+									{
+										return ((kIsFoldingASCII) && (inCharacter >= 'A') && (inCharacter <= 'Z'))
+												? STATIC_CAST(inCharacter + ('a' - 'A'), UniChar)
+												: inCharacter;
+									};
+	CFIndex			i = inStartIndex;
+	
+	
+	while (i <= kLastStartIndex)
+	{
+#if defined(__SSE2__)
+		{
+			__m128i const	kFirst = _mm_set1_epi16(STATIC_CAST(kFirstCharacter, short));
+			__m128i const	kFirstAlternate = _mm_set1_epi16(STATIC_CAST(kFirstCharacterAlternate, short));
+			
+			
+			while ((inLength - i) >= 8)
+			{
+				__m128i const	kCharacters = _mm_loadu_si128(REINTERPRET_CAST(inText + i, __m128i const*));
+				__m128i const	kHits = _mm_or_si128(_mm_cmpeq_epi16(kCharacters, kFirst),
+														_mm_cmpeq_epi16(kCharacters, kFirstAlternate));
+				UInt32 const	kMask = STATIC_CAST(_mm_movemask_epi8(kHits), UInt32);
+				
+				
+				if (0 != kMask)
+				{
+					// each 16-bit lane sets 2 bits of the mask
+					i += (__builtin_ctz(kMask) / 2);
+					break;
+				}
+				i += 8;
+			}
+		}
+#elif defined(__ARM_NEON)
+		{
+			uint16x8_t const	kFirst = vdupq_n_u16(kFirstCharacter);
+			uint16x8_t const	kFirstAlternate = vdupq_n_u16(kFirstCharacterAlternate);
+			
+			
+			while ((inLength - i) >= 8)
+			{
+				uint16x8_t const	kCharacters = vld1q_u16(inText + i);
+				uint16x8_t const	kHits = vorrq_u16(vceqq_u16(kCharacters, kFirst), vceqq_u16(kCharacters, kFirstAlternate));
+				
+				
+				if (0 != vmaxvq_u16(kHits))
+				{
+					// NEON has no direct equivalent to "movemask" so the
+					// exact position is found by the scalar code below
+					break;
+				}
+				i += 8;
+			}
+		}
+#endif
+		if (i > kLastStartIndex)
+		{
+			break;
+		}
+		if (foldedCharacter(inText[i]) == kFirstCharacter)
+		{
+			CFIndex		j = 1;
+			
+			
+			while ((j < kQueryLength) && (foldedCharacter(inText[i + j]) == literalCharacters[j]))
+			{
+				++j;
+			}
+			if (j == kQueryLength)
+			{
+				return i;
 			}
 		}
-		break;
+		++i;
+	}
+	
+	return kCFNotFound;
+}// My_SearchPattern::returnLiteralMatchIndex
+
+
+/*!
+Performs various assertions on the current custom scrolling
+region range, to make sure all values are valid.
+
+This should be called if the range changes for any reason.
+
+(4.0)
+*/
+inline void
+assertScrollingRegion	(My_ScreenBufferPtr		inDataPtr)
+{
+	assert(inDataPtr->customScrollingRegion.lastRow >= inDataPtr->customScrollingRegion.firstRow);
+	assert(inDataPtr->customScrollingRegion.lastRow < inDataPtr->screenBuffer.size());
+	assert(inDataPtr->screenBuffer.size() >= (inDataPtr->customScrollingRegion.lastRow - inDataPtr->customScrollingRegion.firstRow));
+}// assertScrollingRegion
+
+
+/*!
+Arranges for the main thread to hold the lock of the given
+screen’s background searches whenever it is not waiting for
+events; chunks of the searches only read the buffer while
+they hold the same lock (see searchRun()).  This way, the
+main thread never has to be careful about what it changes
+(highlighting, restoring compacted lines, drawing, etc.) as
+the search threads can only run while it sleeps.
+
+Must be called on the main thread, when a search starts;
+see backgroundSearchEnd().
+
+(2023.10)
+*/
+void
+backgroundSearchBegin	(My_ScreenBufferPtr		inDataPtr)
+{
+	UNUSED_RETURN(Boolean)gBackgroundSearchObserversInstalled();
+	if (0 == inDataPtr->backgroundSearch.count)
+	{
+		// the main thread is running, so it takes the lock now
+		// (it is released by the observers, before waiting)
+		UNUSED_RETURN(int)pthread_rwlock_wrlock(&inDataPtr->backgroundSearch.lock);
+		gBackgroundSearchScreens().insert(inDataPtr);
+	}
+	++inDataPtr->backgroundSearch.count;
+}// backgroundSearchBegin
+
+
+/*!
+Balances a call to backgroundSearchBegin(), after the chunks
+of a search have all ended.  When the last search of the
+given screen ends, the screen is no longer locked and any
+data or reflow that was held during the search is handled.
+
+(2023.10)
+*/
+void
+backgroundSearchEnd		(My_ScreenBufferPtr		inDataPtr)
+{
+	assert(inDataPtr->backgroundSearch.count > 0);
+	--inDataPtr->backgroundSearch.count;
+	if (0 == inDataPtr->backgroundSearch.count)
+	{
+		My_ByteString	deferredInput;
+		
+		
+		// the main thread is running, so it holds the lock
+		gBackgroundSearchScreens().erase(inDataPtr);
+		UNUSED_RETURN(int)pthread_rwlock_unlock(&inDataPtr->backgroundSearch.lock);
+		
+		deferredInput.swap(inDataPtr->backgroundSearch.deferredInput);
+		unless (deferredInput.empty())
+		{
+			UNUSED_RETURN(Terminal_Result)Terminal_EmulatorProcessData(inDataPtr->selfRef, deferredInput.data(), deferredInput.size());
+		}
+		if (inDataPtr->scrollbackBuffer.isReflowPending())
+		{
+			scrollbackReflowLines(inDataPtr);
+		}
+	}
+}// backgroundSearchEnd
+
+
+/*!
+A main run loop observer that runs after the thread wakes
+up; it takes the lock of every screen being searched in
+the background, waiting for any chunks that are reading.
+
+(2023.10)
+*/
+void
+backgroundSearchLockAll		(CFRunLoopObserverRef	UNUSED_ARGUMENT(inObserver),
+							 CFRunLoopActivity		UNUSED_ARGUMENT(inActivity),
+							 void*					UNUSED_ARGUMENT(inContext))
+{
+	for (My_ScreenBufferPtr dataPtr : gBackgroundSearchScreens())
+	{
+		UNUSED_RETURN(int)pthread_rwlock_wrlock(&dataPtr->backgroundSearch.lock);
+	}
+}// backgroundSearchLockAll
+
+
+/*!
+A main run loop observer that runs just before the thread
+waits for events (after everything else, including any
+drawing); it releases the lock of every screen being
+searched in the background, so that chunks may read them.
+
+(2023.10)
+*/
+void
+backgroundSearchUnlockAll	(CFRunLoopObserverRef	UNUSED_ARGUMENT(inObserver),
+							 CFRunLoopActivity		UNUSED_ARGUMENT(inActivity),
+							 void*					UNUSED_ARGUMENT(inContext))
+{
+	for (My_ScreenBufferPtr dataPtr : gBackgroundSearchScreens())
+	{
+		UNUSED_RETURN(int)pthread_rwlock_unlock(&dataPtr->backgroundSearch.lock);
+	}
+}// backgroundSearchUnlockAll
+
+
+/*!
+A "calloc" hook for the default malloc zone, installed by
+setBenchmarkZoneHooksEnabled(); counts the allocation and
+then defers to the original zone.
+
+(2023.10)
+*/
+void*
+benchmarkZoneCalloc		(malloc_zone_t*		inZone,
+						 size_t				inItemCount,
+						 size_t				inItemSize)
+{
+	++gBenchmarkAllocationCount();
+	gBenchmarkAllocatedByteCount() += (inItemCount * inItemSize);
+	return gBenchmarkOriginalZone().calloc(inZone, inItemCount, inItemSize);
+}// benchmarkZoneCalloc
+
+
+/*!
+A "malloc" hook for the default malloc zone, installed by
+setBenchmarkZoneHooksEnabled(); counts the allocation and
+then defers to the original zone.  Since "new" and the
+default Core Foundation allocator also end up here, this
+covers nearly everything.
+
+(2023.10)
+*/
+void*
+benchmarkZoneMalloc		(malloc_zone_t*		inZone,
+						 size_t				inSize)
+{
+	++gBenchmarkAllocationCount();
+	gBenchmarkAllocatedByteCount() += inSize;
+	return gBenchmarkOriginalZone().malloc(inZone, inSize);
+}// benchmarkZoneMalloc
+
+
+/*!
+A "memalign" hook for the default malloc zone, installed by
+setBenchmarkZoneHooksEnabled(); counts the allocation and
+then defers to the original zone.
+
+(2023.10)
+*/
+void*
+benchmarkZoneMemalign	(malloc_zone_t*		inZone,
+						 size_t				inAlignment,
+						 size_t				inSize)
+{
+	++gBenchmarkAllocationCount();
+	gBenchmarkAllocatedByteCount() += inSize;
+	return gBenchmarkOriginalZone().memalign(inZone, inAlignment, inSize);
+}// benchmarkZoneMemalign
+
+
+/*!
+A "realloc" hook for the default malloc zone, installed by
+setBenchmarkZoneHooksEnabled(); counts each reallocation as
+an allocation (of the new size) and then defers to the
+original zone.
+
+(2023.10)
+*/
+void*
+benchmarkZoneRealloc	(malloc_zone_t*		inZone,
+						 void*				inPtr,
+						 size_t				inNewSize)
+{
+	++gBenchmarkAllocationCount();
+	gBenchmarkAllocatedByteCount() += inNewSize;
+	return gBenchmarkOriginalZone().realloc(inZone, inPtr, inNewSize);
+}// benchmarkZoneRealloc
+
+
+/*!
+A "valloc" hook for the default malloc zone, installed by
+setBenchmarkZoneHooksEnabled(); counts the allocation and
+then defers to the original zone.
+
+(2023.10)
+*/
+void*
+benchmarkZoneValloc		(malloc_zone_t*		inZone,
+						 size_t				inSize)
+{
+	++gBenchmarkAllocationCount();
+	gBenchmarkAllocatedByteCount() += inSize;
+	return gBenchmarkOriginalZone().valloc(inZone, inSize);
+}// benchmarkZoneValloc
+
+
+/*!
+Applies the attribute changes of an erase operation to the
+given range of cells (the first cell up to but not including
+the past-the-end cell): resetting to the line’s attributes
+if "kMy_BufferChangesResetCharacterAttributes" is set and
+then applying the latent background color if
+"kMy_BufferChangesKeepBackgroundColor" is set.  Since
+attributes are stored as style runs, the cost depends on
+the number of runs and not the number of cells.
+
+(2023.10)
+*/
+void
+bufferEraseAttributesInRange	(My_ScreenBufferPtr		inDataPtr,
+								 My_BufferChanges		inChanges,
+								 My_ScreenBufferLine&	inRow,
+								 UInt16					inFirstCell,
+								 UInt16					inPastEndCell)
+{
+	if (inChanges & kMy_BufferChangesResetCharacterAttributes)
+	{
+		if (false == inRow.sharesUniformAttributes(inRow.returnGlobalAttributes()))
+		{
+			inRow.returnMutableAttributeRuns().assign(inFirstCell, inPastEndCell, inRow.returnGlobalAttributes());
+		}
+	}
+	if (inChanges & kMy_BufferChangesKeepBackgroundColor)
+	{
+		TextAttributes_Object const		kLatentAttributes = inDataPtr->current.latentAttributes;
+		
+		
+		inRow.returnMutableAttributeRuns().modify(inFirstCell, inPastEndCell,
+													[=](TextAttributes_Object& inoutAttributes)
+													{
+														inoutAttributes.colorIndexBackgroundCopyFrom(kLatentAttributes);
+													});
+	}
+}// bufferEraseAttributesInRange
+
+
+/*!
+Erases the entire line containing the cursor.
+
+(2.6)
+*/
+void
+bufferEraseCursorLine	(My_ScreenBufferPtr		inDataPtr,
+						 My_BufferChanges		inChanges)
+{
+	My_ScreenBufferLineList::iterator	cursorLineIterator;
+	SInt16								postWrapCursorX = 0;
+	My_ScreenRowIndex					postWrapCursorY = inDataPtr->current.cursorY;
 	
-	case kStateCBT:
-		cursorBackwardTabulation(inDataPtr);
-		break;
 	
-	case kStateCHA:
-		cursorCharacterAbsolute(inDataPtr);
-		break;
+	// figure out where the cursor is, but first force it to
+	// wrap to the next line if a wrap is pending
+	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
+	locateCursorLine(inDataPtr, cursorLineIterator);
 	
-	case kStateCHT:
-		cursorForwardTabulation(inDataPtr);
-		break;
+	// clear appropriate attributes and text
+	bufferEraseLineWithoutUpdate(inDataPtr, inChanges | kMy_BufferChangesResetCursorAttributes, **cursorLineIterator);
 	
-	case kStateCNL:
-		cursorNextLine(inDataPtr);
-		break;
+	// add the entire row contents to the text-change region;
+	// this should trigger things like Terminal View updates
+	//Console_WriteLine("text changed event: erase line");
+	{
+		Terminal_RangeDescription	range;
+		
+		
+		range.screen = inDataPtr->selfRef;
+		range.firstRow = postWrapCursorY;
+		range.firstColumn = 0;
+		range.columnCount = inDataPtr->current.returnNumberOfColumnsPermitted();
+		range.rowCount = 1;
+		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+	}
+}// bufferEraseCursorLine
+
+
+/*!
+Erases the specified number of characters on the cursor row,
+starting from the cursor position.
+
+(4.0)
+*/
+void
+bufferEraseFromCursorColumn		(My_ScreenBufferPtr		inDataPtr,
+								 My_BufferChanges		inChanges,
+								 UInt16					inCharacterCount)
+{
+	My_ScreenBufferLineList::iterator	cursorLineIterator;
+	SInt16								postWrapCursorX = inDataPtr->current.cursorX;
+	My_ScreenRowIndex					postWrapCursorY = inDataPtr->current.cursorY;
+	UInt16								fillDistance = inCharacterCount;
 	
-	case kStateCPL:
-		cursorPreviousLine(inDataPtr);
-		break;
 	
-	case kStateCSITertiaryDA:
-		// flag to mark the control sequence as tertiary device attributes
-		inDataPtr->emulator.argList[inDataPtr->emulator.argLastIndex] = kMy_ParamTertiaryDA;
-		++(inDataPtr->emulator.argLastIndex);
-		break;
+	// figure out where the cursor is, but first force it to
+	// wrap to the next line if a wrap is pending
+	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
+	locateCursorLine(inDataPtr, cursorLineIterator);
 	
-	case kStateHPA:
-		horizontalPositionAbsolute(inDataPtr);
-		break;
+	// do not overflow the line buffer
+	fillDistance = std::min(fillDistance, STATIC_CAST(inDataPtr->current.returnNumberOfColumnsPermitted() - postWrapCursorX, UInt16));
 	
-	case kStateSD:
-		scrollDown(inDataPtr);
-		break;
+	// change attributes if appropriate; note that since a partial line is
+	// being erased, "kMy_BufferChangesResetLineAttributes" does NOT apply
+	bufferEraseAttributesInRange(inDataPtr, inChanges, *(*cursorLineIterator),
+									postWrapCursorX, STATIC_CAST(postWrapCursorX + fillDistance, UInt16));
 	
-	case kStateSU:
-		scrollUp(inDataPtr);
-		break;
+	// add the remainder of the row to the text-change region;
+	// this should trigger things like Terminal View updates
+	//Console_WriteLine("text changed event: erase from cursor column to line end");
+	{
+		Boolean const				eraseAllFlag = (0 != (inChanges & kMy_BufferChangesEraseAllText));
+		Terminal_RangeDescription	range;
+		
+		
+		range.screen = inDataPtr->selfRef;
+		range.firstRow = postWrapCursorY;
+		range.firstColumn = postWrapCursorX;
+		range.columnCount = fillDistance;
+		range.rowCount = 1;
+		
+		// a double-width character that is only partly erased is erased
+		// completely, since neither half can be shown by itself
+		if ((fillDistance > 0) &&
+			bufferEraseSplitWideCharacter(inDataPtr, *(*cursorLineIterator), STATIC_CAST(postWrapCursorX + fillDistance, UInt16)))
+		{
+			++range.columnCount;
+		}
+		if ((fillDistance > 0) && bufferEraseSplitWideCharacter(inDataPtr, *(*cursorLineIterator), postWrapCursorX))
+		{
+			--range.firstColumn;
+			++range.columnCount;
+		}
+		
+		bufferEraseRange(inDataPtr, eraseAllFlag, *(*cursorLineIterator), My_CellBoundary(postWrapCursorX, fillDistance));
+		
+		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+	}
+}// bufferEraseFromCursorColumn
+
+
+/*!
+Erases characters on the cursor row, from the cursor
+position to the end of the line.
+
+(2.6)
+*/
+void
+bufferEraseFromCursorColumnToLineEnd	(My_ScreenBufferPtr		inDataPtr,
+										 My_BufferChanges		inChanges)
+{
+	My_ScreenBufferLineList::iterator	cursorLineIterator;
+	SInt16								postWrapCursorX = inDataPtr->current.cursorX;
+	My_ScreenRowIndex					postWrapCursorY = inDataPtr->current.cursorY;
 	
-	case kStateVPA:
-		verticalPositionAbsolute(inDataPtr);
-		break;
 	
-	default:
-		// call the XTerm “core” to handle the sequence and update "outHandled" appropriately;
-		// note that the core IS NOT a complete emulator, which is why this routine falls
-		// back to a proper VT220 at the end instead of falling back to the core exclusively
-		result = invokeEmulatorStateTransitionProc
-					(My_XTermCore::stateTransition, inDataPtr,
-						inOldNew, outHandled);
-		break;
+	// if the cursor is positioned so as to trigger an erase
+	// of the entire top line, and forced saving is enabled,
+	// be sure to dump the screen contents into the scrollback
+	if ((inDataPtr->text.scrollback.enabled) &&
+		(inDataPtr->mayNeedToSaveToScrollback))
+	{
+		inDataPtr->mayNeedToSaveToScrollback = false;
+		screenCopyLinesToScrollback(inDataPtr);
+	}
+	
+	// figure out where the cursor is, but first force it to
+	// wrap to the next line if a wrap is pending
+	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
+	locateCursorLine(inDataPtr, cursorLineIterator);
+	
+	// change attributes if appropriate; note that since a partial line is
+	// being erased, "kMy_BufferChangesResetLineAttributes" does NOT apply
+	bufferEraseAttributesInRange(inDataPtr, inChanges, *(*cursorLineIterator),
+									postWrapCursorX, kTerminalLine_MaximumCharacterCount);
+	
+	// since the end of the line is erased, it no longer continues on the next line
+	(*cursorLineIterator)->softWrapColumnCount = 0;
+	
+	// add the remainder of the row to the text-change region;
+	// this should trigger things like Terminal View updates
+	//Console_WriteLine("text changed event: erase from cursor column to line end");
+	{
+		Boolean const				eraseAllFlag = (0 != (inChanges & kMy_BufferChangesEraseAllText));
+		Terminal_RangeDescription	range;
+		
+		
+		range.screen = inDataPtr->selfRef;
+		range.firstRow = postWrapCursorY;
+		range.firstColumn = postWrapCursorX;
+		range.columnCount = inDataPtr->current.returnNumberOfColumnsPermitted() - postWrapCursorX;
+		range.rowCount = 1;
+		
+		bufferEraseRange(inDataPtr, eraseAllFlag, *(*cursorLineIterator), My_CellBoundary(range.firstColumn, range.columnCount));
+		
+		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+	}
+}// bufferEraseFromCursorColumnToLineEnd
+
+
+/*!
+Erases characters from the current cursor position
+up to the end position (last line, last column).
+
+(2.6)
+*/
+void
+bufferEraseFromCursorToEnd  (My_ScreenBufferPtr		inDataPtr,
+							 My_BufferChanges		inChanges)
+{
+	My_ScreenRowIndex	postWrapCursorY = inDataPtr->current.cursorY + 1;
+	
+	
+	{
+		SInt16		postWrapCursorX = 0;
+		
+		
+		cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
+	}
+	
+	// if the cursor is in the home position, this action will
+	// erase the entire visible screen; so, check the preference
+	// for saving to scrollback, and copy the data if necessary
+ 	if ((inDataPtr->text.scrollback.enabled) &&
+		(inDataPtr->mayNeedToSaveToScrollback))
+	{
+		inDataPtr->mayNeedToSaveToScrollback = false;
+		screenCopyLinesToScrollback(inDataPtr);
+	}
+	
+	// blank out current line from cursor to end, and update
+	bufferEraseFromCursorColumnToLineEnd(inDataPtr, inChanges);
+	
+	// blank out following rows
+	{
+		My_ScreenBufferLineList::iterator	lineIterator;
+		
+		
+		locateCursorLine(inDataPtr, lineIterator);
+		
+		// skip cursor line
+		++postWrapCursorY;
+		++lineIterator;
+		for (; lineIterator != inDataPtr->screenBuffer.end(); ++lineIterator)
+		{
+			bufferEraseLineWithoutUpdate(inDataPtr, inChanges, **lineIterator);
+		}
 	}
 	
-	if (false == outHandled)
+	// add all the remaining rows to the text-change region;
+	// this should trigger things like Terminal View updates
+	//Console_WriteLine("text changed event: erase from cursor to screen end");
 	{
-		// other state transitions should still basically be handled as if in VT100
-		result = invokeEmulatorStateTransitionProc
-					(My_VT220::stateTransition, inDataPtr,
-						inOldNew, outHandled);
+		Terminal_RangeDescription	range;
+		
+		
+		range.screen = inDataPtr->selfRef;
+		range.firstRow = postWrapCursorY;
+		range.firstColumn = 0;
+		range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
+		range.rowCount = inDataPtr->screenBuffer.size() - postWrapCursorY + 1;
+		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
 	}
-	
-	return result;
-}// My_XTerm::stateTransition
+}// bufferEraseFromCursorToEnd
 
 
 /*!
-Handles the XTerm 'VPA' sequence.
-
-This should accept up to 2 parameters.  With no parameters, the
-cursor is moved to the first row, but the same cursor column.  If
-there is just one parameter, it is a one-based index for the new
-cursor row, using the same column.  And with two parameters, the
-parameters are the one-based indices of the new cursor row and
-column, in that order.
-
-See also the 'CUP' sequence in the VT terminal.
+Erases characters from the beginning of the screen
+up to and including the current cursor position.
+For example, if the cursor is at line 3, column 6,
+lines 1 and 2 are erased as well as the first 6
+columns of line 3.
 
-(4.0)
+(2.6)
 */
 void
-My_XTerm::
-verticalPositionAbsolute	(My_ScreenBufferPtr		inDataPtr)
+bufferEraseFromHomeToCursor		(My_ScreenBufferPtr		inDataPtr,
+								 My_BufferChanges		inChanges)
 {
-	SInt16 const		kParam0 = inDataPtr->emulator.argList[0];
-	SInt16 const		kParam1 = inDataPtr->emulator.argList[1];
-	SInt16				newX = inDataPtr->current.cursorX;
-	My_ScreenRowIndex	newY = 0;
+	My_ScreenRowIndex	postWrapCursorY = 0;
 	
 	
-	// in the following definitions, 0 and 1 are considered the same number
-	if (kMy_ParamUndefined == kParam1)
+	// figure out where the cursor is, but first force it to
+	// wrap to the next line if a wrap is pending
 	{
-		// only one parameter was given, so it is the row and
-		// the cursor column does not change
-		newY = (0 == kParam0)
-				? 0
-				: (kMy_ParamUndefined != kParam0)
-					? kParam0 - 1
-					: 0/* default is row 1 in current column */;
+		SInt16		postWrapCursorX = 0;
+		
+		
+		cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
 	}
-	else
+	
+	// blank out current line from beginning to cursor
+	bufferEraseFromLineBeginToCursorColumn(inDataPtr, inChanges);
+	
+	// blank out previous rows
 	{
-		// two parameters, giving (row, column)
-		newY = (0 == kParam0)
-				? 0
-				: (kMy_ParamUndefined != kParam0)
-					? kParam0 - 1
-					: 0/* default is the home cursor row */;
-		newX = (0 == kParam1)
-				? 0
-				: kParam1 - 1;
+		My_ScreenBufferLineList::iterator	lineIterator = inDataPtr->screenBuffer.begin();
+		My_ScreenBufferLineList::iterator	cursorLineIterator;
+		
+		
+		locateCursorLine(inDataPtr, cursorLineIterator);
+		for (; lineIterator != cursorLineIterator; ++lineIterator)
+		{
+			bufferEraseLineWithoutUpdate(inDataPtr, inChanges, **lineIterator);
+		}
 	}
 	
-	// the new values are not checked for violation of constraints
-	// because constraints (including current origin mode) are
-	// automatically enforced by moveCursor...() routines
-	moveCursor(inDataPtr, newX, newY);
-}// My_XTerm::verticalPositionAbsolute
+	// add all the pre-cursor rows to the text-change region;
+	// this should trigger things like Terminal View updates
+	//Console_WriteLine("text changed event: erase from home to cursor");
+	{
+		Terminal_RangeDescription	range;
+		
+		
+		range.screen = inDataPtr->selfRef;
+		range.firstRow = 0;
+		range.firstColumn = 0;
+		range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
+		range.rowCount = postWrapCursorY - 1;
+		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+	}
+}// bufferEraseFromHomeToCursor
 
 
 /*!
-A standard "My_EmulatorStateDeterminantProcPtr" that sets
-XTerm-specific window states based on the characters of the
-given buffer.
+Erases characters on the cursor row, from the start of
+the line up to and including the cursor position.
 
-(4.0)
+(2.6)
 */
-UInt32
-My_XTermCore::
-stateDeterminant	(My_EmulatorPtr			inEmulatorPtr,
-					 My_ParserStatePair&	inNowOutNext,
-					 Boolean&				UNUSED_ARGUMENT(outInterrupt),
-					 Boolean&				outHandled)
+void
+bufferEraseFromLineBeginToCursorColumn  (My_ScreenBufferPtr		inDataPtr,
+										 My_BufferChanges		inChanges)
 {
-	UInt32 const	kTriggerChar = inEmulatorPtr->recentCodePoint();
-	UInt32			result = 1; // the first character is *usually* “used”, so 1 is the default (it may change)
-	
-	
-	switch (inNowOutNext.first)
-	{
-	#if 0
-	case kMy_ParserStateSeenESC:
-	case kMy_ParserStateSeenESCRightSqBracket:
-		result = inEmulatorPtr->currentCallbacks.stateDeterminant(inEmulatorPtr, inBuffer, inLength,
-																	inNowOutNext, outInterrupt, outHandled);
-		break;
-	#endif
-	
-	case kStateSWITAcquireStr:
-		if (inEmulatorPtr->supportsVariant(My_Emulator::kVariantFlagXTermAlterWindow))
-		{
-			switch (kTriggerChar)
-			{
-			case '\007':
-				inNowOutNext.second = My_VT220::kStateST;
-				break;
-			
-			case '\033':
-				inNowOutNext.second = kMy_ParserStateSeenESC;
-				break;
-			
-			default:
-				// continue extending the string until a known terminator is found
-				inNowOutNext.second = kStateSWITAcquireStr;
-				result = 0; // do not absorb the unknown
-				break;
-			}
-		}
-		else
-		{
-			// ignore
-			outHandled = false;
-		}
-		break;
-	
-	case kStateSITAcquireStr:
-		if (inEmulatorPtr->supportsVariant(My_Emulator::kVariantFlagXTermAlterWindow))
-		{
-			switch (kTriggerChar)
-			{
-			case '\007':
-				inNowOutNext.second = My_VT220::kStateST;
-				break;
-			
-			case '\033':
-				inNowOutNext.second = kMy_ParserStateSeenESC;
-				break;
-			
-			default:
-				// continue extending the string until a known terminator is found
-				inNowOutNext.second = kStateSITAcquireStr;
-				result = 0; // do not absorb the unknown
-				break;
-			}
-		}
-		else
-		{
-			// ignore
-			outHandled = false;
-		}
-		break;
-	
-	case kStateSWTAcquireStr:
-		if (inEmulatorPtr->supportsVariant(My_Emulator::kVariantFlagXTermAlterWindow))
-		{
-			switch (kTriggerChar)
-			{
-			case '\007':
-				inNowOutNext.second = My_VT220::kStateST;
-				break;
-			
-			case '\033':
-				inNowOutNext.second = kMy_ParserStateSeenESC;
-				break;
-			
-			default:
-				// continue extending the string until a known terminator is found
-				inNowOutNext.second = kStateSWTAcquireStr;
-				result = 0; // do not absorb the unknown
-				break;
-			}
-		}
-		else
-		{
-			// ignore
-			outHandled = false;
-		}
-		break;
-	
-	case kStateColorAcquireStr:
-		if (inEmulatorPtr->supportsVariant(My_Emulator::kVariantFlagXTerm256Color))
-		{
-			switch (kTriggerChar)
-			{
-			case '\033':
-				inNowOutNext.second = kMy_ParserStateSeenESC;
-				break;
-			
-			default:
-				// continue extending the string; termination is an escape sequence (a different state)
-				inNowOutNext.second = kStateColorAcquireStr;
-				result = 0; // do not absorb the unknown
-				break;
-			}
-		}
-		else
-		{
-			// ignore
-			outHandled = false;
-		}
-		break;
+	My_ScreenBufferLineList::iterator	cursorLineIterator;
+	SInt16								postWrapCursorX = inDataPtr->current.cursorX;
+	My_ScreenRowIndex					postWrapCursorY = inDataPtr->current.cursorY;
+	UInt16								fillDistance = 0;
 	
-	default:
-		// other states are not handled at all
-		outHandled = false;
-		break;
-	}
 	
-	// WARNING: Do not call any other full emulator here!  This is a
-	//          pre-callback ONLY, which is designed to fall through
-	//          to something else (such as a VT100).
+	// figure out where the cursor is, but first force it to
+	// wrap to the next line if a wrap is pending
+	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
+	locateCursorLine(inDataPtr, cursorLineIterator);
+	fillDistance = 1 + postWrapCursorX;
 	
-	// debug
-	//Console_WriteValueFourChars("    <<< XTerm in state", inNowOutNext.first);
-	//Console_WriteValueFourChars(">>>     XTerm proposes state", inNowOutNext.second);
-	//Console_WriteValueUnicodePoint("        XTerm bases this at least on character", kTriggerChar);
+	// change attributes if appropriate; note that since a partial line is
+	// being erased, "kMy_BufferChangesResetLineAttributes" does NOT apply
+	bufferEraseAttributesInRange(inDataPtr, inChanges, *(*cursorLineIterator), 0, fillDistance);
 	
-	return result;
-}// My_XTermCore::stateDeterminant
+	// add the first part of the row to the text-change region;
+	// this should trigger things like Terminal View updates
+	//Console_WriteLine("text changed event: erase from line begin to cursor column");
+	{
+		Boolean const				eraseAllFlag = (0 != (inChanges & kMy_BufferChangesEraseAllText));
+		Terminal_RangeDescription	range;
+		
+		
+		range.screen = inDataPtr->selfRef;
+		range.firstRow = postWrapCursorY;
+		range.firstColumn = 0;
+		range.columnCount = fillDistance;
+		range.rowCount = 1;
+		
+		bufferEraseRange(inDataPtr, eraseAllFlag, *(*cursorLineIterator), My_CellBoundary(range.firstColumn, range.columnCount));
+		
+		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+	}
+}// bufferEraseFromLineBeginToCursorColumn
 
 
 /*!
-A standard "My_EmulatorStateTransitionProcPtr" that responds to
-XTerm-specific window state changes.
+Erases an entire line in the screen buffer without triggering
+a redraw.  See also bufferEraseCursorLine().
 
-(4.0)
+This should generally only be used as a helper to implement
+more specific "bufferErase...()" routines.
+
+(2.6)
 */
-UInt32
-My_XTermCore::
-stateTransition		(My_ScreenBufferPtr			inDataPtr,
-					 My_ParserStatePair const&	inOldNew,
-					 Boolean&					outHandled)
+void
+bufferEraseLineWithoutUpdate	(My_ScreenBufferPtr  	inDataPtr,
+								 My_BufferChanges		inChanges,
+								 My_ScreenBufferLine&	inRow)
 {
-	UInt32		result = 0; // usually, no characters are consumed at the transition stage
+	// if the cursor line has changed and the cursor is not going
+	// to move, remove previous global settings and update them
+	// afterward with the new values
+	if ((inChanges & kMy_BufferChangesResetCursorAttributes) &&
+		(inChanges & kMy_BufferChangesResetLineAttributes))
+	{
+		inDataPtr->current.cursorAttributes.removeAttributes(inRow.returnGlobalAttributes());
+		inDataPtr->current.drawingAttributes.removeAttributes(inRow.returnGlobalAttributes());
+	}
 	
+	// change attributes if appropriate
+	if (inChanges & kMy_BufferChangesResetLineAttributes)
+	{
+		inRow.returnMutableGlobalAttributes().clear();
+	}
+	bufferEraseAttributesInRange(inDataPtr, inChanges, inRow, 0, kTerminalLine_MaximumCharacterCount);
 	
-	// decide what to do based on the proposed transition
-	// INCOMPLETE
-	switch (inOldNew.second)
+	// if the cursor line has changed and the cursor is not going
+	// to move, attributes need to be updated here to reflect the
+	// new global line settings
+	if ((inChanges & kMy_BufferChangesResetCursorAttributes) &&
+		(inChanges & kMy_BufferChangesResetLineAttributes))
 	{
-	case kStateSWIT:
-	case kStateSIT:
-	case kStateSWT:
-	case kStateSetColor:
-		inDataPtr->emulator.stringAccumulator.clear();
-		inDataPtr->emulator.stringAccumulatorState = inOldNew.second;
-		break;
+		inDataPtr->current.cursorAttributes.addAttributes(inRow.returnGlobalAttributes());
+		inDataPtr->current.drawingAttributes.addAttributes(inRow.returnGlobalAttributes());
+	}
 	
-	case kStateColorAcquireStr:
-	case kStateSWITAcquireStr:
-	case kStateSITAcquireStr:
-	case kStateSWTAcquireStr:
-		// upon first entry to the state, ignore the code point (semicolon)
-		// that caused the state to be selected; only accumulate code points
-		// that occurred while the previous state was also accumulating
-		if (inOldNew.first == inOldNew.second)
-		{
-			if (inDataPtr->emulator.isUTF8Encoding)
-			{
-				if (UTF8Decoder_StateMachine::kStateUTF8ValidSequence == inDataPtr->emulator.multiByteDecoder.returnState())
-				{
-					std::copy(inDataPtr->emulator.multiByteDecoder.multiByteAccumulator.begin(),
-								inDataPtr->emulator.multiByteDecoder.multiByteAccumulator.end(),
-								std::back_inserter(inDataPtr->emulator.stringAccumulator));
-					result = 1;
-				}
-			}
-			else
-			{
-				inDataPtr->emulator.stringAccumulator.push_back(STATIC_CAST(inDataPtr->emulator.recentCodePoint(), UInt8));
-				result = 1;
-			}
-		}
-		break;
+	// clear out the screen line
+	{
+		Boolean const	eraseAllFlag = (0 != (inChanges & kMy_BufferChangesEraseAllText));
+		
+		
+		bufferEraseRange(inDataPtr, eraseAllFlag, inRow, My_CellBoundary(0, inDataPtr->text.visibleScreen.numberOfColumnsAllocated));
+	}
 	
-	case My_VT220::kStateST:
-		// a string-based terminal sequence can be terminated in multiple
-		// ways; if a new-style XTerm string terminator is seen, then the
-		// action must be chosen based on the state that most recently used
-		// the string buffer
-		switch (inDataPtr->emulator.stringAccumulatorState)
-		{
-		case My_VT220::kStateDCS:
-			{
-				// scan the device control string for the expected terminators;
-				// otherwise, pass to a parent handler (e.g. might be Sixel data)
-				ParameterDecoder_StateMachine				paramDecoder;
-				std::basic_string< UInt8 >::const_iterator	pastEndParams = inDataPtr->emulator.stringAccumulator.end();
-				
-				
-				getParametersFromStringAccumulator(inDataPtr, paramDecoder, pastEndParams);
-				if ((inDataPtr->emulator.stringAccumulator.end() != pastEndParams) && ('$' == *pastEndParams) &&
-					(inDataPtr->emulator.stringAccumulator.end() != (1 + pastEndParams)) && ('q' == *(1 + pastEndParams)))
-				{
-					// “ESC P $ q” (DECRQSS)
-					typedef decltype(inDataPtr->emulator.stringAccumulator.size())	StringAccumulatorSize;
-					decltype(pastEndParams) const	kMainStringBegin = (pastEndParams + 2/* skip terminating '$q' */);
-					decltype(pastEndParams) const	kPastEndMainString = inDataPtr->emulator.stringAccumulator.end();
-					StringAccumulatorSize const		kStringDataSize = std::distance(kMainStringBegin, kPastEndMainString);
-					Boolean							requestHandled = true;
-					
-					
-					if (DebugInterface_LogsTerminalState())
-					{
-						std::basic_string< UInt8 >		requestString(kMainStringBegin, kPastEndMainString);
-						
-						
-						Console_WriteValueCString("received request for selection or setting, string", REINTERPRET_CAST(requestString.c_str(), char const*));
-					}
-					
-					if (1 == kStringDataSize)
-					{
-						if ('r' == *kMainStringBegin)
-						{
-							// report value for DECSTBM from XTerm (or VT100)
-							My_XTerm::reportTopBottomMargins(inDataPtr);
-							requestHandled = true;
-						}
-						else
-						{
-							// INCOMPLETE; dozens of other XTerm sequences should be supported here
-						}
-					}
-					else if (2 == kStringDataSize)
-					{
-						if ((' '/* space */ == *kMainStringBegin) && ('q' == *(1 + kMainStringBegin)))
-						{
-							// report value for DECSCUSR from XTerm (or VT520)
-							My_XTerm::reportCursorStyle(inDataPtr);
-							requestHandled = true;
-						}
-						else
-						{
-							// INCOMPLETE; dozens of other XTerm sequences should be supported here
-						}
-					}
-					
-					if (false == requestHandled)
-					{
-						// most requests are not recognized right now; give a default response
-						My_XTerm::reportSelectionSettingNotUsed(inDataPtr);
-					}
-					
-					inDataPtr->emulator.stringAccumulator.clear();
-					inDataPtr->emulator.stringAccumulatorState = kMy_ParserStateInitial;
-				}
-			}
-			break;
+	// an erased line no longer continues on the next line
+	inRow.softWrapColumnCount = 0;
+}// bufferEraseLineWithoutUpdate
+
+
+/*!
+Erases only cells in the specified range that have not been
+marked with a “cannot erase” attribute (for protected areas
+in some terminals), unless "inEraseAll" is set (in which
+case the range is unconditionally erased).
+
+(2021.04)
+*/
+void
+bufferEraseRange	(My_ScreenBufferPtr  	inDataPtr,
+					 Boolean				inEraseAll,
+					 My_ScreenBufferLine&	inRow,
+					 My_CellBoundary		inCellRange)
+{
+	if (inCellRange.cellCount > 0)
+	{
+		assert(inCellRange.startCell < inDataPtr->text.visibleScreen.numberOfColumnsAllocated);
+		assert(inCellRange.cellCount <= inDataPtr->text.visibleScreen.numberOfColumnsAllocated);
+		CFRange		textRange = StringUtilities_ReturnSubstringRangeForCellRange
+								(inRow.returnCFStringRef(),
+									StringUtilities_Cell(inCellRange.startCell), StringUtilities_Cell(inCellRange.cellCount),
+									kStringUtilities_PartialSymbolRulePrevious, kStringUtilities_PartialSymbolRuleNext);
 		
-		case kStateSWIT:
-		case kStateSIT:
-		case kStateSWT:
-			if (inDataPtr->emulator.supportsVariant(My_Emulator::kVariantFlagXTermAlterWindow))
-			{
-				CFRetainRelease		titleCFString(CFStringCreateWithBytes(kCFAllocatorDefault,
-																			inDataPtr->emulator.stringAccumulator.c_str(),
-																			inDataPtr->emulator.stringAccumulator.size(),
-																			inDataPtr->emulator.inputTextEncoding,
-																			false/* is external representation */),
-													CFRetainRelease::kAlreadyRetained);
-				
-				
-				if (titleCFString.exists())
-				{
-					if ((kStateSWIT == inDataPtr->emulator.stringAccumulatorState) ||
-						(kStateSWT == inDataPtr->emulator.stringAccumulatorState))
-					{
-						inDataPtr->windowTitleCFString = titleCFString;
-						changeNotifyForTerminal(inDataPtr, kTerminal_ChangeWindowFrameTitle, inDataPtr->selfRef/* context */);
-					}
-					if ((kStateSWIT == inDataPtr->emulator.stringAccumulatorState) ||
-						(kStateSIT == inDataPtr->emulator.stringAccumulatorState))
-					{
-						inDataPtr->iconTitleCFString = titleCFString;
-						changeNotifyForTerminal(inDataPtr, kTerminal_ChangeWindowIconTitle, inDataPtr->selfRef/* context */);
-					}
-				}
-				
-				inDataPtr->emulator.stringAccumulator.clear();
-				inDataPtr->emulator.stringAccumulatorState = kMy_ParserStateInitial;
-			}
-			else
-			{
-				// ignore
-				outHandled = false;
-			}
-			break;
 		
-		case kStateSetColor:
-			if (inDataPtr->emulator.supportsVariant(My_Emulator::kVariantFlagXTerm256Color))
+		if (inEraseAll)
+		{
+			inRow.fillWith(CFSTR(" "), textRange);
+		}
+		else
+		{
+			TerminalLine_AttributeRunList const*	attributeRunsPtr = &inRow.returnAttributeRuns();
+			__block UInt16							cellIndex = inCellRange.startCell;
+			__block std::vector<CFRange>			erasedRanges;
+			
+			
+			
+			// since a replaced range may occupy more than one character
+			// but a blank space is exactly one character, erased ranges
+			// must first be identified and then erased in a 2nd loop
+			StringUtilities_ForEachComposedCellClusterInRange(inRow.returnCFStringRef(), textRange,
+			^(CFStringRef				UNUSED_ARGUMENT(substringRef),
+			  StringUtilities_Cell		cellCount,
+			  CFRange					substringRange,
+			  CGFloat					UNUSED_ARGUMENT(scaleFactor),
+			  Boolean&					UNUSED_ARGUMENT(stopFlag))
 			{
-				// the accumulated string up to this point actually needs to be parsed; currently,
-				// only strings of this form are allowed:
-				//		%d;rgb:%x/%x/%x - set color at index, to red, green, blue components in hex
-				char const*		stringPtr = REINTERPRET_CAST(inDataPtr->emulator.stringAccumulator.c_str(), char const*);
-				int				i = 0;
-				int				r = 0;
-				int				g = 0;
-				int				b = 0;
-				int				scanResult = sscanf(stringPtr, "%d;rgb:%x/%x/%x", &i, &r, &g, &b);
+				Boolean		noErase = false;
 				
 				
-				if (4 == scanResult)
+				for (auto i = 0; ((i < cellCount.columns_) && (cellIndex < kTerminalLine_MaximumCharacterCount)); ++i)
 				{
-					if ((i > 255) || (r > 255) || (g > 255) || (b > 255) ||
-						(i < 16/* cannot overwrite base ANSI colors */) || (r < 0) || (g < 0) || (b < 0))
-					{
-						Console_Warning(Console_WriteValueFloat4, "one or more illegal indices found in request to set XTerm color: index, red, green, blue", i, r, g, b);
-					}
-					else
+					if (attributeRunsPtr->returnAttributesForCell(cellIndex).hasAttributes(kTextAttributes_CannotErase))
 					{
-						// success!
-						Terminal_XTermColorDescription		colorInfo;
-						
-						
-						bzero(&colorInfo, sizeof(colorInfo));
-						colorInfo.screen = inDataPtr->selfRef;
-						colorInfo.index = STATIC_CAST(i, UInt8);
-						colorInfo.redComponent = STATIC_CAST(r, UInt8);
-						colorInfo.greenComponent = STATIC_CAST(g, UInt8);
-						colorInfo.blueComponent = STATIC_CAST(b, UInt8);
-						
-						changeNotifyForTerminal(inDataPtr, kTerminal_ChangeXTermColor, &colorInfo/* context */);
-						
-						//Console_WriteValueFloat4("set color at index to red, green, blue", i, r, g, b);
+						noErase = true;
 					}
+					++cellIndex;
 				}
-				else
+				if (false == noErase)
 				{
-					Console_Warning(Console_WriteValue, "failed to parse XTerm color string; sscanf() result", scanResult);
-					Console_Warning(Console_WriteValueCString, "discarding unrecognized syntax for XTerm color string", stringPtr);
+					erasedRanges.push_back(substringRange);
 				}
-				
-				inDataPtr->emulator.stringAccumulator.clear();
-				inDataPtr->emulator.stringAccumulatorState = kMy_ParserStateInitial;
-			}
-			else
+			});
+			
+			// order is important; to avoid invalidating ranges after deletion,
+			// they must be applied from back-to-front in the string (see the
+			// loop above)
+			for (auto toRange = erasedRanges.rbegin(); toRange != erasedRanges.rend(); ++toRange)
 			{
-				// ignore
-				outHandled = false;
+				inRow.fillWith(CFSTR(" "), *toRange);
 			}
-			break;
-		
-		default:
-			// ignore
-			outHandled = false;
-			break;
 		}
-		break;
-	
-	default:
-		// other state transitions are not handled at all
-		outHandled = false;
-		break;
 	}
-	
-	// WARNING: Do not call any other full emulator here!  This is a
-	//          pre-callback ONLY, which is designed to fall through
-	//          to something else (such as a VT100).
-	
-	return result;
-}// My_XTermCore::stateTransition
+}// bufferEraseOnlyErasableCells
 
 
 /*!
-Performs various assertions on the current custom scrolling
-region range, to make sure all values are valid.
+If the boundary just before the given column falls in the
+middle of a double-width character (that is, the column holds
+its second half), both halves are replaced by blank spaces;
+their attributes remain.  Edits that shift or erase part of a
+line must do this at each end of the affected cells, since
+otherwise the halves would be separated (see echoCell()).
 
-This should be called if the range changes for any reason.
+Returns true only if the line was changed, in which case the
+column before the given one has changed too.
 
-(4.0)
+(2023.10)
 */
-inline void
-assertScrollingRegion	(My_ScreenBufferPtr		inDataPtr)
+Boolean
+bufferEraseSplitWideCharacter	(My_ScreenBufferPtr		inDataPtr,
+								 My_ScreenBufferLine&	inRow,
+								 UInt16					inBoundaryColumn)
 {
-	assert(inDataPtr->customScrollingRegion.lastRow >= inDataPtr->customScrollingRegion.firstRow);
-	assert(inDataPtr->customScrollingRegion.lastRow < inDataPtr->screenBuffer.size());
-	assert(inDataPtr->screenBuffer.size() >= (inDataPtr->customScrollingRegion.lastRow - inDataPtr->customScrollingRegion.firstRow));
-}// assertScrollingRegion
+	Boolean		result = false;
+	
+	
+	if ((inBoundaryColumn > 0) && (inBoundaryColumn < inDataPtr->current.returnNumberOfColumnsPermitted()))
+	{
+		UniChar const	kCellText = inRow.textVectorBegin[inBoundaryColumn];
+		
+		
+		if ((kTerminal_WideCharacterContinuation == kCellText) || CFStringIsSurrogateLowCharacter(kCellText))
+		{
+			inRow.textVectorBegin[inBoundaryColumn - 1] = ' ';
+			inRow.textVectorBegin[inBoundaryColumn] = ' ';
+			result = true;
+		}
+	}
+	return result;
+}// bufferEraseSplitWideCharacter
 
 
 /*!
-Erases the entire line containing the cursor.
+Clears the screen, first saving its contents in the scrollback
+buffer if that flag is turned on.  A screen redraw is triggered.
 
 (2.6)
 */
 void
-bufferEraseCursorLine	(My_ScreenBufferPtr		inDataPtr,
-						 My_BufferChanges		inChanges)
+bufferEraseVisibleScreen	(My_ScreenBufferPtr		inDataPtr,
+							 My_BufferChanges		inChanges)
 {
-	My_ScreenBufferLineList::iterator	cursorLineIterator;
-	SInt16								postWrapCursorX = 0;
-	My_ScreenRowIndex					postWrapCursorY = inDataPtr->current.cursorY;
-	
+	//Console_WriteLine("bufferEraseVisibleScreen");
 	
-	// figure out where the cursor is, but first force it to
-	// wrap to the next line if a wrap is pending
-	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
-	locateCursorLine(inDataPtr, cursorLineIterator);
+	// save screen contents in scrollback buffer, if appropriate
+	if (inDataPtr->saveToScrollbackOnClear)
+	{
+		screenCopyLinesToScrollback(inDataPtr);
+	}
 	
-	// clear appropriate attributes and text
-	bufferEraseLineWithoutUpdate(inDataPtr, inChanges | kMy_BufferChangesResetCursorAttributes, **cursorLineIterator);
+	// clear buffer
+	for (auto& lineInfo : inDataPtr->screenBuffer)
+	{
+		// technically cursor attributes only need to change once but all
+		// lines are being erased anyway so it is easier to not try to
+		// identify the cursor line first
+		bufferEraseLineWithoutUpdate(inDataPtr, inChanges | kMy_BufferChangesResetCursorAttributes, *lineInfo);
+	}
 	
-	// add the entire row contents to the text-change region;
+	// add the entire visible buffer to the text-change region;
 	// this should trigger things like Terminal View updates
-	//Console_WriteLine("text changed event: erase line");
+	//Console_WriteLine("text changed event: erase visible screen");
 	{
 		Terminal_RangeDescription	range;
 		
 		
 		range.screen = inDataPtr->selfRef;
-		range.firstRow = postWrapCursorY;
+		range.firstRow = 0;
 		range.firstColumn = 0;
-		range.columnCount = inDataPtr->current.returnNumberOfColumnsPermitted();
-		range.rowCount = 1;
+		range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
+		range.rowCount = inDataPtr->screenBuffer.size();
 		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
 	}
-}// bufferEraseCursorLine
+}// bufferEraseVisibleScreen
 
 
 /*!
-Erases the specified number of characters on the cursor row,
-starting from the cursor position.
+Inserts the specified number of blank lines, scrolling the
+remaining ones down and dropping any that fall off the end
+of the scrolling region.  The display is updated.
 
-(4.0)
+New blank lines normally have cleared attributes.  If however
+"inAttributeRule" is set to "kMy_AttributeRuleCopyLast", they
+will instead copy the attributes of the given insertion line.
+
+See also bufferRemoveLines().
+
+NOTE:   You cannot use this to alter the scrollback.
+
+WARNING:	The specified line MUST be part of the terminal
+			scrolling region.
+
+(3.0)
 */
 void
-bufferEraseFromCursorColumn		(My_ScreenBufferPtr		inDataPtr,
-								 My_BufferChanges		inChanges,
-								 UInt16					inCharacterCount)
+bufferInsertBlankLines	(My_ScreenBufferPtr						inDataPtr,
+						 UInt16									inNumberOfLines,
+						 My_ScreenBufferLineList::iterator&		inInsertionLine,
+						 My_AttributeRule						inAttributeRule)
 {
-	TerminalLine_TextAttributesList::iterator		attrIterator;
-	TerminalLine_TextAttributesList::iterator		endAttrs;
-	My_ScreenBufferLineList::iterator				cursorLineIterator;
-	SInt16											postWrapCursorX = inDataPtr->current.cursorX;
-	My_ScreenRowIndex								postWrapCursorY = inDataPtr->current.cursorY;
-	UInt16											fillDistance = inCharacterCount;
+	My_ScreenBufferLineList::iterator	scrollingRegionBegin;
+	My_ScreenBufferLineList::iterator	scrollingRegionEnd;
 	
 	
-	// figure out where the cursor is, but first force it to
-	// wrap to the next line if a wrap is pending
-	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
-	locateCursorLine(inDataPtr, cursorLineIterator);
+	locateScrollingRegion(inDataPtr, scrollingRegionBegin, scrollingRegionEnd);
+	if (0 != inNumberOfLines)
+	{
+		// the row index MUST be calculated immediately, since inserting lines into the
+		// buffer might make it impossible to find this at the end (where this index is
+		// actually needed)
+		My_ScreenRowIndex const						kFirstInsertedRow = std::distance(inDataPtr->screenBuffer.begin(), inInsertionLine);
+		My_ScreenRowIndex const						kLinesUntilEnd = std::distance(inInsertionLine, scrollingRegionEnd);
+		My_ScreenRowIndex const						kMostLines = std::min(STATIC_CAST(inNumberOfLines, My_ScreenRowIndex), kLinesUntilEnd);
+		My_ScreenBufferLineList::size_type const	kBufferSize = inDataPtr->screenBuffer.size();
+		My_ScreenBufferLineList::iterator			pastLastKeptLine;
+		
+		
+		// insert blank lines
+		if ((kMy_AttributeRuleCopyLast == inAttributeRule) && (scrollingRegionEnd != scrollingRegionBegin))
+		{
+			My_ScreenBufferLinePtr		lineTemplate = createLinePtr(inDataPtr);
+			
+			
+			// copy attributes of the insertion line, making a special exception
+			// to prevent bitmaps from being copied
+			lineTemplate->returnMutableAttributeRuns() = (*inInsertionLine)->returnAttributeRuns();
+			lineTemplate->returnMutableAttributeRuns().modify(0, kTerminalLine_MaximumCharacterCount,
+																[](TextAttributes_Object& inoutAttributes)
+																{
+																	inoutAttributes.removeImageRelatedAttributes();
+																});
+			lineTemplate->returnMutableGlobalAttributes() = (*inInsertionLine)->returnGlobalAttributes();
+			inDataPtr->screenBuffer.insert(inInsertionLine, kMostLines, lineTemplate);
+		}
+		else if (kMy_AttributeRuleCopyLatentBackground == inAttributeRule)
+		{
+			My_ScreenBufferLinePtr		lineTemplate = createLinePtr(inDataPtr);
+			
+			
+			// the new lines have no attributes EXCEPT for a custom background color
+			lineTemplate->returnMutableAttributeRuns().modify(0, kTerminalLine_MaximumCharacterCount,
+																[inDataPtr](TextAttributes_Object& inoutAttributes)
+																{
+																	inoutAttributes.colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
+																});
+			inDataPtr->screenBuffer.insert(inInsertionLine, kMostLines, lineTemplate);
+		}
+		else
+		{
+			inDataPtr->screenBuffer.insert(inInsertionLine, kMostLines, createLinePtr(inDataPtr));
+		}
+		
+		// delete last lines
+		pastLastKeptLine = scrollingRegionEnd;
+		std::advance(pastLastKeptLine, -STATIC_CAST(kMostLines, SInt16));
+		inDataPtr->screenBuffer.erase(pastLastKeptLine, scrollingRegionEnd);
+		
+		assert(kBufferSize == inDataPtr->screenBuffer.size());
+		
+		// redraw the area
+		{
+			Terminal_RangeDescription	range;
+			
+			
+			range.screen = inDataPtr->selfRef;
+			range.firstRow = kFirstInsertedRow;
+			range.firstColumn = 0;
+			range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
+			range.rowCount = inDataPtr->customScrollingRegion.lastRow - range.firstRow + 1;
+			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+		}
+	}
+}// bufferInsertBlankLines
+
+
+/*!
+Inserts the specified number of blank characters at the current
+cursor position, truncating that many characters from the end of
+the line when the line is shifted.  The display is NOT updated.
+
+If "inAttributeRule" is "kMy_AttributeRuleCopyLatentBackground",
+then the background color attribute of each new blank character
+comes from the most recent background color setting.
+
+A double-width character that is split by the cursor column, or
+by the column where characters are truncated, is erased (see
+bufferEraseSplitWideCharacter()).  Returns true only if this
+changed the column before the cursor, which the caller should
+include when updating the display.
+
+(2.6)
+*/
+Boolean
+bufferInsertBlanksAtCursorColumnWithoutUpdate	(My_ScreenBufferPtr		inDataPtr,
+												 SInt16					inNumberOfBlankCharactersToInsert,
+												 My_AttributeRule		inAttributeRule)
+{
+	UInt16								numBlanksToAdd = inNumberOfBlankCharactersToInsert;
+	SInt16								postWrapCursorX = inDataPtr->current.cursorX;
+	My_ScreenRowIndex					postWrapCursorY = inDataPtr->current.cursorY;
+	My_ScreenBufferLineList::iterator	toCursorLine;
+	TextAttributes_Object				copiedAttributes;
+	Boolean								result = false;
 	
-	// do not overflow the line buffer
-	fillDistance = std::min(fillDistance, STATIC_CAST(inDataPtr->current.returnNumberOfColumnsPermitted() - postWrapCursorX, UInt16));
 	
-	// find the right line offset
-	attrIterator = (*cursorLineIterator)->returnMutableAttributeVector().begin();
-	std::advance(attrIterator, postWrapCursorX);
-	endAttrs = attrIterator;
-	std::advance(endAttrs, fillDistance);
+	// wrap cursor
+	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
+	locateCursorLine(inDataPtr, toCursorLine);
 	
-	// change attributes if appropriate; note that since a partial line is
-	// being erased, "kMy_BufferChangesResetLineAttributes" does NOT apply
-	if (inChanges & kMy_BufferChangesResetCharacterAttributes)
-	{
-		std::fill(attrIterator, endAttrs, (*cursorLineIterator)->returnGlobalAttributes());
-	}
-	if (inChanges & kMy_BufferChangesKeepBackgroundColor)
+	// since the caller cannot know for sure if the cursor wrapped,
+	// do bounds-checking between the screen edge and new location
+	if ((postWrapCursorX + numBlanksToAdd) >= inDataPtr->current.returnNumberOfColumnsPermitted())
 	{
-		TerminalLine_TextAttributesList::iterator		tmpAttrIterator;
-		
-		
-		for (tmpAttrIterator = attrIterator; tmpAttrIterator != endAttrs; ++tmpAttrIterator)
-		{
-			(*tmpAttrIterator).colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
-		}
+		numBlanksToAdd = inDataPtr->current.returnNumberOfColumnsPermitted() - postWrapCursorX;
 	}
 	
-	// add the remainder of the row to the text-change region;
-	// this should trigger things like Terminal View updates
-	//Console_WriteLine("text changed event: erase from cursor column to line end");
+	// a double-width character must not be separated by the insertion,
+	// or lose its second half when the end of the line is truncated
+	result = bufferEraseSplitWideCharacter(inDataPtr, *(*toCursorLine), postWrapCursorX);
+	UNUSED_RETURN(Boolean)bufferEraseSplitWideCharacter(inDataPtr, *(*toCursorLine),
+														STATIC_CAST(inDataPtr->current.returnNumberOfColumnsPermitted() - numBlanksToAdd, UInt16));
+	
+	// change attributes if necessary
+	copiedAttributes = (*toCursorLine)->returnGlobalAttributes();
+	if (kMy_AttributeRuleCopyLatentBackground == inAttributeRule)
 	{
-		Boolean const				eraseAllFlag = (0 != (inChanges & kMy_BufferChangesEraseAllText));
-		Terminal_RangeDescription	range;
-		
-		
-		range.screen = inDataPtr->selfRef;
-		range.firstRow = postWrapCursorY;
-		range.firstColumn = postWrapCursorX;
-		range.columnCount = fillDistance;
-		range.rowCount = 1;
-		
-		bufferEraseRange(inDataPtr, eraseAllFlag, *(*cursorLineIterator), My_CellBoundary(range.firstColumn, range.columnCount));
-		
-		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+		copiedAttributes.colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
 	}
-}// bufferEraseFromCursorColumn
+	
+	// update text and attributes
+	(*toCursorLine)->insertBlanks(StringUtilities_Cell(postWrapCursorX), StringUtilities_Cell(numBlanksToAdd),
+									copiedAttributes, StringUtilities_Cell(inDataPtr->current.returnNumberOfColumnsPermitted()));
+	
+	return result;
+}// bufferInsertBlanksAtCursorColumnWithoutUpdate
 
 
 /*!
-Erases characters on the cursor row, from the cursor
-position to the end of the line.
+Shifts the text cursor based on the number of terminal cells
+required to render the given image, updating the attributes
+of all affected cells to display individual segments of the
+image.  The display is NOT updated.
 
-(2.6)
+If "inAllowScrolling" is set to true, the terminal scrolls
+if the cursor shifts past the bottom of the screen and will
+continue to scroll as long as the image grows that way.
+
+If "inRestoreCursor" is set to true, the cursor returns to
+its original position after the image is inserted instead
+of having a new location at the end of the image.
+
+The terminal takes over one reference to the given image
+(see ImageStore_AddImage()), which is released once no line
+of the terminal shows the image (see releaseUnusedImages())
+or when the terminal is destroyed.
+
+(2017.12)
 */
 void
-bufferEraseFromCursorColumnToLineEnd	(My_ScreenBufferPtr		inDataPtr,
-										 My_BufferChanges		inChanges)
+bufferInsertInlineImageWithoutUpdate	(My_ScreenBufferPtr		inDataPtr,
+										 ImageStore_ImageID		inImageID,
+										 UInt16					inTotalPixelsH,
+										 UInt16					inTotalPixelsV,
+										 UInt16					inCellPixelsH,
+										 UInt16					inCellPixelsV,
+										 Boolean				inAllowScrolling,
+										 Boolean				inRestoreCursor)
 {
-	TerminalLine_TextAttributesList::iterator		attrIterator;
-	TerminalLine_TextAttributesList::iterator		endAttrs;
-	My_ScreenBufferLineList::iterator				cursorLineIterator;
-	SInt16											postWrapCursorX = inDataPtr->current.cursorX;
-	My_ScreenRowIndex								postWrapCursorY = inDataPtr->current.cursorY;
+	UInt16			cellsCoveredH = std::max< UInt16 >(1, STATIC_CAST(roundf(STATIC_CAST(inTotalPixelsH, Float32) /
+																				STATIC_CAST(inCellPixelsH, Float32)),
+																		UInt16));
+	UInt16			cellsCoveredV = std::max< UInt16 >(1, STATIC_CAST(roundf(STATIC_CAST(inTotalPixelsV, Float32) /
+																				STATIC_CAST(inCellPixelsV, Float32)),
+																		UInt16));
+	NSRect			subImageRect = NSZeroRect; // initialized below
+	NSImage*		completeImage = ImageStore_ReturnImage(inImageID);
 	
 	
-	// if the cursor is positioned so as to trigger an erase
-	// of the entire top line, and forced saving is enabled,
-	// be sure to dump the screen contents into the scrollback
-	if ((inDataPtr->text.scrollback.enabled) &&
-		(inDataPtr->mayNeedToSaveToScrollback))
+	// the image is retained once for all cells of this terminal
+	unless (inDataPtr->emulator.retainedImages.insert(inImageID).second)
 	{
-		inDataPtr->mayNeedToSaveToScrollback = false;
-		screenCopyLinesToScrollback(inDataPtr);
+		ImageStore_ReleaseImage(inImageID);
 	}
 	
-	// figure out where the cursor is, but first force it to
-	// wrap to the next line if a wrap is pending
-	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
-	locateCursorLine(inDataPtr, cursorLineIterator);
-	
-	// find the right line offset
-	attrIterator = (*cursorLineIterator)->returnMutableAttributeVector().begin();
-	std::advance(attrIterator, postWrapCursorX);
-	endAttrs = (*cursorLineIterator)->returnMutableAttributeVector().end();
+	if (DebugInterface_LogsSixelDecoderSummary())
+	{
+		Console_WriteValue("terminal columns covered by image", cellsCoveredH);
+		Console_WriteValue("terminal rows covered by image", cellsCoveredV);
+	}
 	
-	// change attributes if appropriate; note that since a partial line is
-	// being erased, "kMy_BufferChangesResetLineAttributes" does NOT apply
-	if (inChanges & kMy_BufferChangesResetCharacterAttributes)
+	if (cellsCoveredH > inDataPtr->text.visibleScreen.numberOfColumnsAllocated)
 	{
-		std::fill(attrIterator, endAttrs, (*cursorLineIterator)->returnGlobalAttributes());
+		cellsCoveredH = inDataPtr->text.visibleScreen.numberOfColumnsAllocated;
+		if (DebugInterface_LogsSixelDecoderErrors())
+		{
+			Console_Warning(Console_WriteLine, "the Sixel image has been clipped on the right side (terminal screen not wide enough)");
+			if (inDataPtr->text.visibleScreen.numberOfColumnsAllocated < inDataPtr->text.visibleScreen.numberOfColumnsPermitted)
+			{
+				Console_Warning(Console_WriteLine, "it may be possible to see the whole image by resizing the window first");
+			}
+		}
 	}
-	if (inChanges & kMy_BufferChangesKeepBackgroundColor)
+	if (cellsCoveredV > inDataPtr->screenBuffer.size())
 	{
-		TerminalLine_TextAttributesList::iterator		tmpAttrIterator;
-		
-		
-		for (tmpAttrIterator = attrIterator; tmpAttrIterator != endAttrs; ++tmpAttrIterator)
+		cellsCoveredV = inDataPtr->screenBuffer.size();
+		if (DebugInterface_LogsSixelDecoderErrors())
 		{
-			(*tmpAttrIterator).colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
+			Console_Warning(Console_WriteLine, "the Sixel image has been clipped or scrolled vertically (terminal screen not tall enough)");
 		}
 	}
 	
-	// add the remainder of the row to the text-change region;
-	// this should trigger things like Terminal View updates
-	//Console_WriteLine("text changed event: erase from cursor column to line end");
+	// initialize first sub-rectangle (rendered by one terminal cell)
+	subImageRect = NSMakeRect(0, completeImage.size.height - inCellPixelsV,
+								inCellPixelsH, inCellPixelsV);
+	
+	// since the image is being rendered inline by the terminal, shift the text
+	// cursor location according to the number of text cells that are occupied
+	UInt16 const		kOriginalCursorX = inDataPtr->current.cursorX;
+	UInt16 const		kOriginalCursorY = inDataPtr->current.cursorY;
+	for (UInt16 i = 0; i < cellsCoveredV; ++i)
 	{
-		Boolean const				eraseAllFlag = (0 != (inChanges & kMy_BufferChangesEraseAllText));
-		Terminal_RangeDescription	range;
-		
+		My_ScreenBufferLineList::iterator	cursorLineIterator;
 		
-		range.screen = inDataPtr->selfRef;
-		range.firstRow = postWrapCursorY;
-		range.firstColumn = postWrapCursorX;
-		range.columnCount = inDataPtr->current.returnNumberOfColumnsPermitted() - postWrapCursorX;
-		range.rowCount = 1;
 		
-		bufferEraseRange(inDataPtr, eraseAllFlag, *(*cursorLineIterator), My_CellBoundary(range.firstColumn, range.columnCount));
+		moveCursorX(inDataPtr, kOriginalCursorX);
+		subImageRect.origin.x = 0;
+		locateCursorLine(inDataPtr, cursorLineIterator);
+		for (UInt16 j = 0; j < cellsCoveredH; ++j)
+		{
+			TextAttributes_BitmapID		cellBitmapID;
+			TextAttributes_Object		newAttributes;
+			
+			
+			// set attributes on all affected text cells to allow them to render their
+			// assigned portion of the overall image
+			if (false == ImageStore_DefineSegment(inImageID, NSRectToCGRect(subImageRect), cellBitmapID))
+			{
+				if (DebugInterface_LogsSixelDecoderErrors())
+				{
+					Console_Warning(Console_WriteLine, "failed to allocate a cell bitmap");
+				}
+			}
+			else
+			{
+				newAttributes.bitmapIDSet(cellBitmapID);
+			}
+			changeLineRangeAttributes(inDataPtr, *(*cursorLineIterator),
+										inDataPtr->current.cursorX, 1 + inDataPtr->current.cursorX,
+										newAttributes/* attributes to set */,
+										TextAttributes_Object(0xFFFFFFFF, 0xFFFFFFFF)/* attributes to clear */);
+			
+			moveCursorRight(inDataPtr);
+			subImageRect.origin.x += subImageRect.size.width;
+		}
 		
-		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+		if (inAllowScrolling)
+		{
+			moveCursorDownOrScroll(inDataPtr);
+		}
+		else
+		{
+			moveCursorDown(inDataPtr);
+		}
+		subImageRect.origin.y -= subImageRect.size.height;
 	}
-}// bufferEraseFromCursorColumnToLineEnd
+	moveCursorX(inDataPtr, kOriginalCursorX);
+	if (inRestoreCursor)
+	{
+		moveCursorY(inDataPtr, kOriginalCursorY);
+	}
+}// bufferInsertInlineImageWithoutUpdate
 
 
 /*!
-Erases characters from the current cursor position
-up to the end position (last line, last column).
+Efficiently overwrites the entire buffer for the given
+line, such that every character on the line becomes the
+given fill character and every character’s attributes
+match the given fill attributes.  You may also update
+the line global attributes, which define the default
+attributes effective regardless of individual character
+attributes on the line.
 
-(2.6)
+(3.0)
 */
 void
-bufferEraseFromCursorToEnd  (My_ScreenBufferPtr		inDataPtr,
-							 My_BufferChanges		inChanges)
+bufferLineFill	(My_ScreenBufferPtr			UNUSED_ARGUMENT(inDataPtr),
+				 My_ScreenBufferLine&		inRow,
+				 CFStringRef				inFillCharacter,
+				 TextAttributes_Object		inFillAttributes,
+				 Boolean					inUpdateLineGlobalAttributesAlso)
 {
-	My_ScreenRowIndex	postWrapCursorY = inDataPtr->current.cursorY + 1;
-	
-	
+	inRow.fillWith(inFillCharacter);
+	inRow.returnMutableAttributeRuns().assign(0, kTerminalLine_MaximumCharacterCount, inFillAttributes);
+	if (inUpdateLineGlobalAttributesAlso)
 	{
-		SInt16		postWrapCursorX = 0;
-		
-		
-		cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
+		inRow.returnMutableGlobalAttributes() = inFillAttributes;
 	}
+}// bufferLineFill
+
+
+/*!
+Deletes characters starting at the current cursor position and
+moving forwards.  The rest of the line is shifted to the left
+as a result.
+
+If "inAttributeRule" is set to "kMy_AttributeRuleCopyLast",
+all new blank characters copy the attributes of the last
+character on the cursor line.  If the rule is set to
+"kMy_AttributeRuleCopyLatentBackground", then the background
+color attribute comes from the most recent background color
+setting.
+
+(3.0)
+*/
+void
+bufferRemoveCharactersAtCursorColumn	(My_ScreenBufferPtr		inDataPtr,
+										 SInt16					inNumberOfCharactersToDelete,
+										 My_AttributeRule		inAttributeRule)
+{
+	UInt16								numCharsToRemove = inNumberOfCharactersToDelete;
+	SInt16								postWrapCursorX = inDataPtr->current.cursorX;
+	My_ScreenRowIndex					postWrapCursorY = inDataPtr->current.cursorY;
+	My_ScreenBufferLineList::iterator	toCursorLine;
+	TextAttributes_Object				copiedAttributes;
+	Boolean								isPreviousColumnChanged = false;
 	
-	// if the cursor is in the home position, this action will
-	// erase the entire visible screen; so, check the preference
-	// for saving to scrollback, and copy the data if necessary
- 	if ((inDataPtr->text.scrollback.enabled) &&
-		(inDataPtr->mayNeedToSaveToScrollback))
-	{
-		inDataPtr->mayNeedToSaveToScrollback = false;
-		screenCopyLinesToScrollback(inDataPtr);
+	
+	// wrap cursor
+	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
+	locateCursorLine(inDataPtr, toCursorLine);
+	
+	// since the caller cannot know for sure if the cursor wrapped,
+	// do bounds-checking between the screen edge and new location
+	if ((postWrapCursorX + numCharsToRemove) >= inDataPtr->current.returnNumberOfColumnsPermitted())
+	{
+		numCharsToRemove = inDataPtr->current.returnNumberOfColumnsPermitted() - postWrapCursorX;
 	}
 	
-	// blank out current line from cursor to end, and update
-	bufferEraseFromCursorColumnToLineEnd(inDataPtr, inChanges);
+	// a double-width character that is only partly deleted is erased
+	// completely, since neither half can be shown by itself
+	isPreviousColumnChanged = bufferEraseSplitWideCharacter(inDataPtr, *(*toCursorLine), postWrapCursorX);
+	if (numCharsToRemove > 0)
+	{
+		UNUSED_RETURN(Boolean)bufferEraseSplitWideCharacter(inDataPtr, *(*toCursorLine),
+															STATIC_CAST(postWrapCursorX + numCharsToRemove, UInt16));
+	}
 	
-	// blank out following rows
+	// change attributes if necessary
+	copiedAttributes = (*toCursorLine)->returnGlobalAttributes();
+	if (kMy_AttributeRuleCopyLast == inAttributeRule)
 	{
-		My_ScreenBufferLineList::iterator	lineIterator;
-		
-		
-		locateCursorLine(inDataPtr, lineIterator);
-		
-		// skip cursor line
-		++postWrapCursorY;
-		++lineIterator;
-		for (; lineIterator != inDataPtr->screenBuffer.end(); ++lineIterator)
+		// copy attributes of the last character, making a special exception
+		// to prevent bitmaps from being copied
+		copiedAttributes = (*toCursorLine)->returnAttributeRuns().returnAttributesForCell(inDataPtr->current.returnNumberOfColumnsPermitted() - 1);
+		if (copiedAttributes.hasAttributes(kTextAttributes_ColorIndexIsBitmapID))
 		{
-			bufferEraseLineWithoutUpdate(inDataPtr, inChanges, **lineIterator);
+			copiedAttributes.removeImageRelatedAttributes();
 		}
 	}
+	else if (kMy_AttributeRuleCopyLatentBackground == inAttributeRule)
+	{
+		copiedAttributes.colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
+	}
 	
-	// add all the remaining rows to the text-change region;
-	// this should trigger things like Terminal View updates
-	//Console_WriteLine("text changed event: erase from cursor to screen end");
+	// update text and attributes
+	(*toCursorLine)->deleteRange(StringUtilities_Cell(postWrapCursorX), StringUtilities_Cell(numCharsToRemove),
+									copiedAttributes, StringUtilities_Cell(inDataPtr->current.returnNumberOfColumnsPermitted()));
+	
+	// add the entire line from the cursor to the end
+	// to the text-change region; this would trigger
+	// things like Terminal View updates
+	//Console_WriteLine("text changed event: remove characters at cursor column");
 	{
 		Terminal_RangeDescription	range;
 		
 		
 		range.screen = inDataPtr->selfRef;
 		range.firstRow = postWrapCursorY;
-		range.firstColumn = 0;
-		range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
-		range.rowCount = inDataPtr->screenBuffer.size() - postWrapCursorY + 1;
+		range.firstColumn = (isPreviousColumnChanged) ? (postWrapCursorX - 1) : postWrapCursorX;
+		range.columnCount = inDataPtr->current.returnNumberOfColumnsPermitted() - range.firstColumn;
+		range.rowCount = 1;
 		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
 	}
-}// bufferEraseFromCursorToEnd
+}// bufferRemoveCharactersAtCursorColumn
 
 
 /*!
-Erases characters from the beginning of the screen
-up to and including the current cursor position.
-For example, if the cursor is at line 3, column 6,
-lines 1 and 2 are erased as well as the first 6
-columns of line 3.
+Deletes lines from the screen buffer, scrolling up the
+remainder and inserting new blank lines at the bottom of the
+scrolling region.  The display is updated.
 
-(2.6)
+New blank lines normally have cleared attributes.  If however
+"inAttributeRule" is set to "kMy_AttributeRuleCopyLast", they
+will instead copy the attributes of the line that was at the
+end prior to new lines being inserted.
+
+See also bufferInsertBlankLines().
+
+NOTE:   You cannot use this to alter the scrollback.
+
+WARNING:	The specified line MUST be part of the terminal
+			scrolling region.
+
+(3.0)
 */
 void
-bufferEraseFromHomeToCursor		(My_ScreenBufferPtr		inDataPtr,
-								 My_BufferChanges		inChanges)
+bufferRemoveLines	(My_ScreenBufferPtr						inDataPtr,
+					 UInt16									inNumberOfLines,
+					 My_ScreenBufferLineList::iterator&		inFirstDeletionLine,
+					 My_AttributeRule						inAttributeRule)
 {
-	My_ScreenRowIndex	postWrapCursorY = 0;
-	
-	
-	// figure out where the cursor is, but first force it to
-	// wrap to the next line if a wrap is pending
-	{
-		SInt16		postWrapCursorX = 0;
-		
-		
-		cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
-	}
+	My_ScreenBufferLineList::iterator	scrollingRegionBegin;
+	My_ScreenBufferLineList::iterator	scrollingRegionEnd;
 	
-	// blank out current line from beginning to cursor
-	bufferEraseFromLineBeginToCursorColumn(inDataPtr, inChanges);
 	
-	// blank out previous rows
+	locateScrollingRegion(inDataPtr, scrollingRegionBegin, scrollingRegionEnd);
+	if (0 != inNumberOfLines)
 	{
-		My_ScreenBufferLineList::iterator	lineIterator = inDataPtr->screenBuffer.begin();
-		My_ScreenBufferLineList::iterator	cursorLineIterator;
+		// the row index MUST be calculated immediately, since removing lines from the
+		// buffer might make it impossible to find this at the end (where this index
+		// is actually needed)
+		My_ScreenRowIndex const						kFirstDeletedRow = std::distance(inDataPtr->screenBuffer.begin(), inFirstDeletionLine);
+		My_ScreenRowIndex const						kLinesUntilEnd = std::distance(inFirstDeletionLine, scrollingRegionEnd);
+		My_ScreenRowIndex const						kMostLines = std::min(STATIC_CAST(inNumberOfLines, My_ScreenRowIndex), kLinesUntilEnd);
+		My_ScreenBufferLineList::size_type const	kBufferSize = inDataPtr->screenBuffer.size();
+		My_ScreenBufferLineList::iterator			pastLastDeletionLine;
 		
 		
-		locateCursorLine(inDataPtr, cursorLineIterator);
-		for (; lineIterator != cursorLineIterator; ++lineIterator)
+		// insert blank lines
+		if ((kMy_AttributeRuleCopyLast == inAttributeRule) && (scrollingRegionEnd != scrollingRegionBegin))
 		{
-			bufferEraseLineWithoutUpdate(inDataPtr, inChanges, **lineIterator);
+			My_ScreenBufferLinePtr				lineTemplate = createLinePtr(inDataPtr);
+			My_ScreenBufferLineList::iterator	toCopiedLine = scrollingRegionEnd;
+			
+			
+			std::advance(toCopiedLine, -1);
+			// copy attributes of the previous last line, making a special
+			// exception to prevent bitmaps from being copied
+			lineTemplate->returnMutableAttributeRuns() = (*toCopiedLine)->returnAttributeRuns();
+			lineTemplate->returnMutableAttributeRuns().modify(0, kTerminalLine_MaximumCharacterCount,
+																[](TextAttributes_Object& inoutAttributes)
+																{
+																	inoutAttributes.removeImageRelatedAttributes();
+																});
+			lineTemplate->returnMutableGlobalAttributes() = (*toCopiedLine)->returnGlobalAttributes();
+			inDataPtr->screenBuffer.insert(scrollingRegionEnd, kMostLines, lineTemplate);
+		}
+		else if (kMy_AttributeRuleCopyLatentBackground == inAttributeRule)
+		{
+			My_ScreenBufferLinePtr		lineTemplate = createLinePtr(inDataPtr);
+			
+			
+			// the new lines have no attributes EXCEPT for a custom background color
+			lineTemplate->returnMutableAttributeRuns().modify(0, kTerminalLine_MaximumCharacterCount,
+																[inDataPtr](TextAttributes_Object& inoutAttributes)
+																{
+																	inoutAttributes.colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
+																});
+			inDataPtr->screenBuffer.insert(scrollingRegionEnd, kMostLines, lineTemplate);
+		}
+		else
+		{
+			inDataPtr->screenBuffer.insert(scrollingRegionEnd, kMostLines, createLinePtr(inDataPtr));
 		}
-	}
-	
-	// add all the pre-cursor rows to the text-change region;
-	// this should trigger things like Terminal View updates
-	//Console_WriteLine("text changed event: erase from home to cursor");
-	{
-		Terminal_RangeDescription	range;
 		
+		// delete first lines
+		pastLastDeletionLine = inFirstDeletionLine;
+		std::advance(pastLastDeletionLine, kMostLines);
+		inDataPtr->screenBuffer.erase(inFirstDeletionLine, pastLastDeletionLine);
 		
-		range.screen = inDataPtr->selfRef;
-		range.firstRow = 0;
-		range.firstColumn = 0;
-		range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
-		range.rowCount = postWrapCursorY - 1;
-		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+		assert(kBufferSize == inDataPtr->screenBuffer.size());
+		
+		// redraw the area
+		{
+			Terminal_RangeDescription	range;
+			
+			
+			range.screen = inDataPtr->selfRef;
+			range.firstRow = kFirstDeletedRow;
+			range.firstColumn = 0;
+			range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
+			range.rowCount = inDataPtr->customScrollingRegion.lastRow - range.firstRow + 1;
+			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+		}
 	}
-}// bufferEraseFromHomeToCursor
+}// bufferRemoveLines
 
 
 /*!
-Erases characters on the cursor row, from the start of
-the line up to and including the cursor position.
+Internal version of Terminal_ChangeLineAttributes().
 
-(2.6)
+(3.0)
 */
 void
-bufferEraseFromLineBeginToCursorColumn  (My_ScreenBufferPtr		inDataPtr,
-										 My_BufferChanges		inChanges)
+changeLineAttributes	(My_ScreenBufferPtr			inDataPtr,
+						 My_ScreenBufferLine&		inRow,
+						 TextAttributes_Object		inSetTheseAttributes,
+						 TextAttributes_Object		inClearTheseAttributes)
+{
+	changeLineRangeAttributes(inDataPtr, inRow, 0/* first column */, -1/* last column; negative means “very end” */,
+								inSetTheseAttributes, inClearTheseAttributes);
+}// changeLineAttributes
+
+
+/*!
+Sets attributes that are global to a line.  Unlike
+changeLineAttributes() which merely copies attributes
+to each character, this routine also remembers the
+specified changes as attributes for the entire line
+so that every time the cursor enters the line, the
+cursor attributes inherit the line’s global attributes.
+
+(3.0)
+*/
+void
+changeLineGlobalAttributes	(My_ScreenBufferPtr			inDataPtr,
+							 My_ScreenBufferLine&		inRow,
+							 TextAttributes_Object		inSetTheseAttributes,
+							 TextAttributes_Object		inClearTheseAttributes)
 {
-	TerminalLine_TextAttributesList::iterator		attrIterator;
-	TerminalLine_TextAttributesList::iterator		endAttrs;
-	My_ScreenBufferLineList::iterator				cursorLineIterator;
-	SInt16											postWrapCursorX = inDataPtr->current.cursorX;
-	My_ScreenRowIndex								postWrapCursorY = inDataPtr->current.cursorY;
-	UInt16											fillDistance = 0;
+	// first copy the attributes to every character in the line
+	changeLineAttributes(inDataPtr, inRow, inSetTheseAttributes, inClearTheseAttributes);
 	
+	// now remember these changes so that the cursor can inherit them automatically;
+	// currently attributes for scrollback lines do not exist, but negative indices
+	// are allowed; to avoid array overflow, check for nonnegativity here
+	inRow.returnMutableGlobalAttributes().removeAttributes(inClearTheseAttributes);
+	inRow.returnMutableGlobalAttributes().addAttributes(inSetTheseAttributes);
+}// changeLineGlobalAttributes
+
+
+/*!
+Internal version of Terminal_ChangeLineRangeAttributes().
+
+(3.0)
+*/
+void
+changeLineRangeAttributes	(My_ScreenBufferPtr			inDataPtr,
+							 My_ScreenBufferLine&		inRow,
+							 UInt16						inZeroBasedStartColumn,
+							 SInt16						inZeroBasedPastTheEndColumnOrNegativeForLastColumn,
+							 TextAttributes_Object		inSetTheseAttributes,
+							 TextAttributes_Object		inClearTheseAttributes)
+{
+	SInt16		pastTheEndColumn = (inZeroBasedPastTheEndColumnOrNegativeForLastColumn < 0)
+									? inDataPtr->text.visibleScreen.numberOfColumnsAllocated
+									: inZeroBasedPastTheEndColumnOrNegativeForLastColumn;
 	
-	// figure out where the cursor is, but first force it to
-	// wrap to the next line if a wrap is pending
-	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
-	locateCursorLine(inDataPtr, cursorLineIterator);
-	fillDistance = 1 + postWrapCursorX;
 	
-	// find the right line offset
-	attrIterator = (*cursorLineIterator)->returnMutableAttributeVector().begin();
-	endAttrs = attrIterator;
-	std::advance(endAttrs, fillDistance);
+	// update attributes for the specified columns of the given line
+	inRow.returnMutableAttributeRuns().modify(inZeroBasedStartColumn, STATIC_CAST(pastTheEndColumn, UInt16),
+												[=](TextAttributes_Object& inoutAttributes)
+												{
+													inoutAttributes.removeAttributes(inClearTheseAttributes);
+													inoutAttributes.addAttributes(inSetTheseAttributes);
+												});
 	
-	// change attributes if appropriate; note that since a partial line is
-	// being erased, "kMy_BufferChangesResetLineAttributes" does NOT apply
-	if (inChanges & kMy_BufferChangesResetCharacterAttributes)
-	{
-		std::fill(attrIterator, endAttrs, (*cursorLineIterator)->returnGlobalAttributes());
-	}
-	if (inChanges & kMy_BufferChangesKeepBackgroundColor)
+	// update current attributes too, if the cursor is in the given range
+	if ((inZeroBasedStartColumn <= inDataPtr->current.cursorX) && (inDataPtr->current.cursorX < pastTheEndColumn))
 	{
-		TerminalLine_TextAttributesList::iterator		tmpAttrIterator;
+		My_ScreenBufferLineList::iterator	cursorLineIterator;
 		
 		
-		for (tmpAttrIterator = attrIterator; tmpAttrIterator != endAttrs; ++tmpAttrIterator)
+		locateCursorLine(inDataPtr, cursorLineIterator);
+		if (*cursorLineIterator == &inRow)
 		{
-			(*tmpAttrIterator).colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
+			inDataPtr->current.drawingAttributes.removeAttributes(inClearTheseAttributes);
+			inDataPtr->current.drawingAttributes.addAttributes(inSetTheseAttributes);
+			
+			// ...however, do not propagate text highlighting to text rendered from now on
+			inDataPtr->current.drawingAttributes.removeAttributes(kTextAttributes_Selected);
+			
+			// ...do not propagate images either
+			inDataPtr->current.drawingAttributes.removeImageRelatedAttributes();
 		}
-	}
-	
-	// add the first part of the row to the text-change region;
-	// this should trigger things like Terminal View updates
-	//Console_WriteLine("text changed event: erase from line begin to cursor column");
-	{
-		Boolean const				eraseAllFlag = (0 != (inChanges & kMy_BufferChangesEraseAllText));
-		Terminal_RangeDescription	range;
-		
-		
-		range.screen = inDataPtr->selfRef;
-		range.firstRow = postWrapCursorY;
-		range.firstColumn = 0;
-		range.columnCount = fillDistance;
-		range.rowCount = 1;
+	}
+	
+	// attribute changes (such as highlighting) do not send change
+	// notifications, so mark the row for the next snapshot here;
+	// scrollback lines are not part of any snapshot
+	{
+		auto const	kRowIterator = std::find(inDataPtr->screenBuffer.begin(), inDataPtr->screenBuffer.end(), &inRow);
 		
-		bufferEraseRange(inDataPtr, eraseAllFlag, *(*cursorLineIterator), My_CellBoundary(range.firstColumn, range.columnCount));
 		
-		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+		if (inDataPtr->screenBuffer.end() != kRowIterator)
+		{
+			inDataPtr->snapshotPublisher.markRowsChanged(std::distance(inDataPtr->screenBuffer.begin(), kRowIterator), 1);
+		}
 	}
-}// bufferEraseFromLineBeginToCursorColumn
+	
+	// finally, if the end column is beyond the last character in the line,
+	// apply the attributes to EVERY column that does not have a valid character
+	// UNIMPLEMENTED
+}// changeLineRangeAttributes
 
 
 /*!
-Erases an entire line in the screen buffer without triggering
-a redraw.  See also bufferEraseCursorLine().
-
-This should generally only be used as a helper to implement
-more specific "bufferErase...()" routines.
+Notifies listeners that text was echoed, covering every cell
+between the given cursor location (captured prior to the echo)
+and the current cursor location.  This should trigger things
+like Terminal View updates.
 
-(2.6)
+(2023.10)
 */
 void
-bufferEraseLineWithoutUpdate	(My_ScreenBufferPtr  	inDataPtr,
-								 My_BufferChanges		inChanges,
-								 My_ScreenBufferLine&	inRow)
+changeNotifyForEcho		(My_ScreenBufferPtr		inDataPtr,
+						 SInt16					inPreWriteCursorX,
+						 My_ScreenRowIndex		inPreWriteCursorY)
 {
-	TerminalLine_TextAttributesList::iterator		attrIterator;
-	TerminalLine_TextAttributesList::iterator		endAttrs;
-	
-	
-	// if the cursor line has changed and the cursor is not going
-	// to move, remove previous global settings and update them
-	// afterward with the new values
-	if ((inChanges & kMy_BufferChangesResetCursorAttributes) &&
-		(inChanges & kMy_BufferChangesResetLineAttributes))
-	{
-		inDataPtr->current.cursorAttributes.removeAttributes(inRow.returnGlobalAttributes());
-		inDataPtr->current.drawingAttributes.removeAttributes(inRow.returnGlobalAttributes());
-	}
+	Terminal_RangeDescription	range;
 	
-	// find the right line offset
-	attrIterator = inRow.returnMutableAttributeVector().begin();
-	endAttrs = inRow.returnMutableAttributeVector().end();
 	
-	// change attributes if appropriate
-	if (inChanges & kMy_BufferChangesResetLineAttributes)
+	range.screen = inDataPtr->selfRef;
+	range.firstRow = inPreWriteCursorY;
+	if (inPreWriteCursorY != inDataPtr->current.cursorY)
 	{
-		inRow.returnMutableGlobalAttributes().clear();
+		// more than one line; just draw all lines completely
+		range.firstColumn = 0;
+		range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
+		range.rowCount = inDataPtr->current.cursorY - inPreWriteCursorY + 1;
 	}
-	if (inChanges & kMy_BufferChangesResetCharacterAttributes)
+	else
 	{
-		std::fill(attrIterator, endAttrs, inRow.returnGlobalAttributes());
+		range.firstColumn = inPreWriteCursorX;
+		if (inDataPtr->modeInsertNotReplace)
+		{
+			// invalidate the rest of the line
+			range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted - inPreWriteCursorX;
+		}
+		else
+		{
+			range.columnCount = inDataPtr->current.cursorX - inPreWriteCursorX + 1;
+		}
+		range.rowCount = 1;
 	}
-	if (inChanges & kMy_BufferChangesKeepBackgroundColor)
+	//Console_WriteValuePair("text changed event: add data starting at row, column", range.firstRow, range.firstColumn);
+	//Console_WriteValuePair("text changed event: add data for #rows, #columns", range.rowCount, range.columnCount);
+	changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+}// changeNotifyForEcho
+
+
+/*!
+Notifies all listeners for the specified Terminal
+state change, passing the given context to the
+listener.
+
+IMPORTANT:	The context must make sense for the
+			type of change; see "Terminal.h" for
+			the type of context associated with
+			each terminal change.
+
+(3.0)
+*/
+void
+changeNotifyForTerminal		(My_ScreenBufferPtr		inPtr,
+							 Terminal_Change		inWhatChanged,
+							 void*					inContextPtr)
+{
+	// the same notifications that cause views to redraw determine
+	// which rows must be copied into the next snapshot
+	switch (inWhatChanged)
 	{
-		TerminalLine_TextAttributesList::iterator		tmpAttrIterator;
-		
-		
-		for (tmpAttrIterator = attrIterator; tmpAttrIterator != endAttrs; ++tmpAttrIterator)
+	case kTerminal_ChangeTextEdited:
 		{
-			(*tmpAttrIterator).colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
+			Terminal_RangeDescriptionConstPtr	rangePtr = REINTERPRET_CAST(inContextPtr, Terminal_RangeDescriptionConstPtr);
+			SInt64 const						kScreenRowCount = STATIC_CAST(inPtr->screenBuffer.size(), SInt64);
+			
+			
+			inPtr->snapshotPublisher.markRowsChanged(rangePtr->firstRow, std::min(rangePtr->rowCount, kScreenRowCount - rangePtr->firstRow));
 		}
-	}
+		break;
 	
-	// if the cursor line has changed and the cursor is not going
-	// to move, attributes need to be updated here to reflect the
-	// new global line settings
-	if ((inChanges & kMy_BufferChangesResetCursorAttributes) &&
-		(inChanges & kMy_BufferChangesResetLineAttributes))
-	{
-		inDataPtr->current.cursorAttributes.addAttributes(inRow.returnGlobalAttributes());
-		inDataPtr->current.drawingAttributes.addAttributes(inRow.returnGlobalAttributes());
-	}
+	case kTerminal_ChangeScrollActivity:
+		{
+			Terminal_ScrollDescriptionConstPtr	scrollInfoPtr = REINTERPRET_CAST(inContextPtr, Terminal_ScrollDescriptionConstPtr);
+			
+			
+			inPtr->snapshotPublisher.moveRows(scrollInfoPtr->screenRowDelta);
+		}
+		break;
 	
-	// clear out the screen line
-	{
-		Boolean const	eraseAllFlag = (0 != (inChanges & kMy_BufferChangesEraseAllText));
-		
-		
-		bufferEraseRange(inDataPtr, eraseAllFlag, inRow, My_CellBoundary(0, inDataPtr->text.visibleScreen.numberOfColumnsAllocated));
+	case kTerminal_ChangeReset:
+	case kTerminal_ChangeScreenSize:
+		inPtr->snapshotPublisher.markAllRowsChanged();
+		break;
+	
+	default:
+		// ???
+		break;
 	}
-}// bufferEraseLineWithoutUpdate
+	
+	// invoke listener callback routines appropriately, from the specified terminal’s listener model
+	ListenerModel_NotifyListenersOfEvent(inPtr->changeListenerModel, inWhatChanged, inContextPtr);
+}// changeNotifyForTerminal
 
 
 /*!
-Erases only cells in the specified range that have not been
-marked with a “cannot erase” attribute (for protected areas
-in some terminals), unless "inEraseAll" is set (in which
-case the range is unconditionally erased).
+Updates the pending description of a terminal change that
+has not been delivered yet, to account for a newer change
+(see ListenerModel_SetEventCoalescing()).  Scroll distances
+are added together, edited ranges are combined into one
+range that covers both, and a pending edit is moved along
+with the rows of any scroll that follows it (since edits
+are delivered after scrolls).
 
-(2021.04)
+Zero has a special meaning in scroll descriptions, so if
+either scroll has a zero distance, so does the result; this
+means that the view redraws everything, which is always
+correct.  The same is done if a sum does not fit in the
+description, rather than reporting a wrong distance.
+
+(2023.10)
 */
 void
-bufferEraseRange	(My_ScreenBufferPtr  	inDataPtr,
-					 Boolean				inEraseAll,
-					 My_ScreenBufferLine&	inRow,
-					 My_CellBoundary		inCellRange)
+coalesceTerminalChange	(ListenerModel_Event	inPendingChange,
+						 void*					inoutPendingContextPtr,
+						 ListenerModel_Event	inNewChange,
+						 void const*			inNewContextPtr)
 {
-	if (inCellRange.cellCount > 0)
+	if ((kTerminal_ChangeScrollActivity == inPendingChange) && (kTerminal_ChangeScrollActivity == inNewChange))
 	{
-		assert(inCellRange.startCell < inDataPtr->text.visibleScreen.numberOfColumnsAllocated);
-		assert(inCellRange.cellCount <= inDataPtr->text.visibleScreen.numberOfColumnsAllocated);
-		CFRange		textRange = StringUtilities_ReturnSubstringRangeForCellRange
-								(inRow.returnCFStringRef(),
-									StringUtilities_Cell(inCellRange.startCell), StringUtilities_Cell(inCellRange.cellCount),
-									kStringUtilities_PartialSymbolRulePrevious, kStringUtilities_PartialSymbolRuleNext);
+		Terminal_ScrollDescription*			pendingPtr = REINTERPRET_CAST(inoutPendingContextPtr, Terminal_ScrollDescription*);
+		Terminal_ScrollDescriptionConstPtr	newPtr = REINTERPRET_CAST(inNewContextPtr, Terminal_ScrollDescriptionConstPtr);
+		SInt32 const						kRowDelta = STATIC_CAST(pendingPtr->rowDelta, SInt32) + newPtr->rowDelta;
+		SInt32 const						kScreenRowDelta = STATIC_CAST(pendingPtr->screenRowDelta, SInt32) + newPtr->screenRowDelta;
+		Boolean const						kOutOfRange = ((kRowDelta < INT16_MIN) || (kRowDelta > INT16_MAX) ||
+															(kScreenRowDelta < INT16_MIN) || (kScreenRowDelta > INT16_MAX));
 		
 		
-		if (inEraseAll)
+		if (kOutOfRange)
 		{
-			inRow.fillWith(CFSTR(" "), textRange);
+			// a sum that cannot be represented would cause listeners to
+			// move things by the wrong amount; instead, report that the
+			// scrollback changed in some unspecified way and that every
+			// row must be redrawn
+			pendingPtr->rowDelta = 0;
+			pendingPtr->screenRowDelta = 0;
 		}
 		else
 		{
-			TerminalLine_TextAttributesList const&		attributeVector = inRow.returnAttributeVector();
-			__block auto								attrIterator = attributeVector.begin();
-			auto										endAttrs = attributeVector.end();
-			__block std::vector<CFRange>				erasedRanges;
-			
-			
-			std::advance(attrIterator, inCellRange.startCell);
+			pendingPtr->rowDelta = (((0 == pendingPtr->rowDelta) || (0 == newPtr->rowDelta))
+									? 0
+									: STATIC_CAST(kRowDelta, SInt16));
+			pendingPtr->screenRowDelta = (((0 == pendingPtr->screenRowDelta) || (0 == newPtr->screenRowDelta))
+											? 0
+											: STATIC_CAST(kScreenRowDelta, SInt16));
+		}
+	}
+	else if ((kTerminal_ChangeTextEdited == inPendingChange) && (kTerminal_ChangeTextEdited == inNewChange))
+	{
+		Terminal_RangeDescription*			pendingPtr = REINTERPRET_CAST(inoutPendingContextPtr, Terminal_RangeDescription*);
+		Terminal_RangeDescriptionConstPtr	newPtr = REINTERPRET_CAST(inNewContextPtr, Terminal_RangeDescriptionConstPtr);
+		
+		
+		if ((newPtr->rowCount <= 0) || (0 == newPtr->columnCount))
+		{
+			// nothing new to draw
+		}
+		else if ((pendingPtr->rowCount <= 0) || (0 == pendingPtr->columnCount))
+		{
+			*pendingPtr = *newPtr;
+		}
+		else
+		{
+			SInt64 const	kPastLastRow = std::max(pendingPtr->firstRow + pendingPtr->rowCount,
+													newPtr->firstRow + newPtr->rowCount);
+			SInt32 const	kPastLastColumn = std::max(pendingPtr->firstColumn + pendingPtr->columnCount,
+														newPtr->firstColumn + newPtr->columnCount);
 			
-			// since a replaced range may occupy more than one character
-			// but a blank space is exactly one character, erased ranges
-			// must first be identified and then erased in a 2nd loop
-			StringUtilities_ForEachComposedCellClusterInRange(inRow.returnCFStringRef(), textRange,
-			^(CFStringRef				UNUSED_ARGUMENT(substringRef),
-			  StringUtilities_Cell		cellCount,
-			  CFRange					substringRange,
-			  CGFloat					UNUSED_ARGUMENT(scaleFactor),
-			  Boolean&					UNUSED_ARGUMENT(stopFlag))
-			{
-				Boolean		noErase = false;
-				
-				
-				for (auto i = 0; ((i < cellCount.columns_) && (endAttrs != attrIterator)); ++i)
-				{
-					if ((*attrIterator).hasAttributes(kTextAttributes_CannotErase))
-					{
-						noErase = true;
-					}
-					++attrIterator;
-				}
-				if (false == noErase)
-				{
-					erasedRanges.push_back(substringRange);
-				}
-			});
 			
-			// order is important; to avoid invalidating ranges after deletion,
-			// they must be applied from back-to-front in the string (see the
-			// loop above)
-			for (auto toRange = erasedRanges.rbegin(); toRange != erasedRanges.rend(); ++toRange)
+			pendingPtr->firstRow = std::min(pendingPtr->firstRow, newPtr->firstRow);
+			pendingPtr->rowCount = kPastLastRow - pendingPtr->firstRow;
+			pendingPtr->firstColumn = std::min(pendingPtr->firstColumn, newPtr->firstColumn);
+			pendingPtr->columnCount = STATIC_CAST(std::min< SInt32 >(kPastLastColumn - pendingPtr->firstColumn, 0xFFFF), UInt16);
+		}
+	}
+	else if ((kTerminal_ChangeTextEdited == inPendingChange) && (kTerminal_ChangeScrollActivity == inNewChange))
+	{
+		Terminal_RangeDescription*			pendingPtr = REINTERPRET_CAST(inoutPendingContextPtr, Terminal_RangeDescription*);
+		Terminal_ScrollDescriptionConstPtr	newPtr = REINTERPRET_CAST(inNewContextPtr, Terminal_ScrollDescriptionConstPtr);
+		
+		
+		// only main screen rows move (a range in the scrollback causes
+		// a full redraw anyway)
+		if ((0 != newPtr->screenRowDelta) && (pendingPtr->firstRow >= 0))
+		{
+			pendingPtr->firstRow += newPtr->screenRowDelta;
+			if (pendingPtr->firstRow < 0)
 			{
-				inRow.fillWith(CFSTR(" "), *toRange);
+				// rows that moved off the top no longer need drawing
+				pendingPtr->rowCount = std::max< SInt64 >(0, pendingPtr->rowCount + pendingPtr->firstRow);
+				pendingPtr->firstRow = 0;
 			}
 		}
 	}
-}// bufferEraseOnlyErasableCells
+}// coalesceTerminalChange
 
 
 /*!
-Clears the screen, first saving its contents in the scrollback
-buffer if that flag is turned on.  A screen redraw is triggered.
+Installs the main run loop observers that release and take
+the locks of screens being searched in the background (see
+backgroundSearchBegin()).  They are never removed, as they
+do nothing unless searches are running.  Returns true.
 
-(2.6)
+The lock is released after all other observers (so that, for
+instance, Core Animation has finished drawing) and taken
+before any of them.  Since all common modes are observed,
+a nested event loop (such as for a menu) works the same way.
+
+(2023.10)
 */
-void
-bufferEraseVisibleScreen	(My_ScreenBufferPtr		inDataPtr,
-							 My_BufferChanges		inChanges)
+Boolean
+createBackgroundSearchObservers ()
 {
-	//Console_WriteLine("bufferEraseVisibleScreen");
+	CFRunLoopObserverRef	beforeWaitingObserver = CFRunLoopObserverCreate(kCFAllocatorDefault, kCFRunLoopBeforeWaiting, true/* repeats */,
+																			LONG_MAX/* order */, backgroundSearchUnlockAll, nullptr/* context */);
+	CFRunLoopObserverRef	afterWaitingObserver = CFRunLoopObserverCreate(kCFAllocatorDefault, kCFRunLoopAfterWaiting, true/* repeats */,
+																			LONG_MIN/* order */, backgroundSearchLockAll, nullptr/* context */);
 	
-	// save screen contents in scrollback buffer, if appropriate
-	if (inDataPtr->saveToScrollbackOnClear)
-	{
-		screenCopyLinesToScrollback(inDataPtr);
-	}
 	
-	// clear buffer
-	for (auto& lineInfo : inDataPtr->screenBuffer)
-	{
-		// technically cursor attributes only need to change once but all
-		// lines are being erased anyway so it is easier to not try to
-		// identify the cursor line first
-		bufferEraseLineWithoutUpdate(inDataPtr, inChanges | kMy_BufferChangesResetCursorAttributes, *lineInfo);
-	}
+	CFRunLoopAddObserver(CFRunLoopGetMain(), beforeWaitingObserver, kCFRunLoopCommonModes);
+	CFRunLoopAddObserver(CFRunLoopGetMain(), afterWaitingObserver, kCFRunLoopCommonModes);
+	CFRelease(beforeWaitingObserver), beforeWaitingObserver = nullptr;
+	CFRelease(afterWaitingObserver), afterWaitingObserver = nullptr;
+	return true;
+}// createBackgroundSearchObservers
+
+
+/*!
+Uniform interface for creating new entries in line-lists.
+DO NOT attempt manual memory management, as the scheme
+may need to change over time to address performance and
+sharing of data.
+
+For instance, later the semantics of this function may be
+to return an already-allocated line that is no longer in
+use (as opposed to strictly allocating it here).
+
+The line is blank, and memory is only allocated (from the
+allocator of the given screen) when it is first changed;
+so the line has room for the width of that screen.
+
+(4.1)
+*/
+My_ScreenBufferLinePtr
+createLinePtr	(My_ScreenBufferPtr		inDataPtr)
+{
+	return My_ScreenBufferLinePtr(inDataPtr->lineAllocator); // see TerminalLine_Handle
+}// createLinePtr
+
+
+/*!
+Restores the last saved cursor position and
+attribute settings.  See cursorSave() to ensure
+this function does the opposite.
+
+(2.6)
+*/
+void
+cursorRestore  (My_ScreenBufferPtr		inPtr)
+{
+	moveCursor(inPtr, inPtr->previous.cursorX, inPtr->previous.cursorY);
 	
-	// add the entire visible buffer to the text-change region;
-	// this should trigger things like Terminal View updates
-	//Console_WriteLine("text changed event: erase visible screen");
+	// ??? this will clear the current graphics character set too, is that supposed to happen ???
+	inPtr->current.drawingAttributes = inPtr->previous.drawingAttributes;
+}// cursorRestore
+
+
+/*!
+Saves the current cursor position and attribute
+settings.  See cursorRestore() to ensure this
+function does the opposite.
+
+(2.6)
+*/
+void
+cursorSave  (My_ScreenBufferPtr  inPtr)
+{
+	inPtr->previous.cursorX = inPtr->current.cursorX;
+	inPtr->previous.cursorY = inPtr->current.cursorY;
+	inPtr->previous.drawingAttributes = inPtr->current.drawingAttributes;
+}// cursorSave
+
+
+/*!
+Returns the cursor location, first wrapping it to the
+following line if it is out of bounds (if a wrap is
+pending).
+
+(3.0)
+*/
+void
+cursorWrapIfNecessaryGetLocation	(My_ScreenBufferPtr		inDataPtr,
+									 SInt16*				outCursorXPtr,
+									 My_ScreenRowIndex*		outCursorYPtr)
+{
+	if (inDataPtr->current.cursorX >= inDataPtr->current.returnNumberOfColumnsPermitted()) 
 	{
-		Terminal_RangeDescription	range;
-		
-		
-		range.screen = inDataPtr->selfRef;
-		range.firstRow = 0;
-		range.firstColumn = 0;
-		range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
-		range.rowCount = inDataPtr->screenBuffer.size();
-		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+		moveCursorX(inDataPtr, 0);
+		moveCursorDownOrScroll(inDataPtr);
 	}
-}// bufferEraseVisibleScreen
+	*outCursorXPtr = inDataPtr->current.cursorX;
+	*outCursorYPtr = inDataPtr->current.cursorY;
+}// cursorWrapIfNecessaryGetLocation
 
 
 /*!
-Inserts the specified number of blank lines, scrolling the
-remaining ones down and dropping any that fall off the end
-of the scrolling region.  The display is updated.
-
-New blank lines normally have cleared attributes.  If however
-"inAttributeRule" is set to "kMy_AttributeRuleCopyLast", they
-will instead copy the attributes of the given insertion line.
-
-See also bufferRemoveLines().
+Provides the ID for the given RGB combination.  (See the
+public Terminal_TrueColorGetFromID() API.)  Returns true
+only if successful.
 
-NOTE:   You cannot use this to alter the scrollback.
+As noted in "TextAttributes.h", there is a limit to the
+number of possible IDs and they will be reused (oldest
+first) when the limit is exceeded.
 
-WARNING:	The specified line MUST be part of the terminal
-			scrolling region.
+The color components are used to find any existing ID
+for the same color however, preventing many individual
+requests for the same color from being assigned unique
+IDs.
 
-(3.0)
+(4.1)
 */
-void
-bufferInsertBlankLines	(My_ScreenBufferPtr						inDataPtr,
-						 UInt16									inNumberOfLines,
-						 My_ScreenBufferLineList::iterator&		inInsertionLine,
-						 My_AttributeRule						inAttributeRule)
+Boolean
+defineTrueColor		(My_ScreenBufferPtr				inDataPtr,
+					 UInt8							inRed,
+					 UInt8							inGreen,
+					 UInt8							inBlue,
+					 TextAttributes_TrueColorID&	outColorID)
 {
-	My_ScreenBufferLineList::iterator	scrollingRegionBegin;
-	My_ScreenBufferLineList::iterator	scrollingRegionEnd;
+	Boolean		result = false;
+	UInt32		rgbKey = (inBlue | (inGreen << 8) | (inRed << 16));
+	auto&		rgbMap = inDataPtr->emulator.trueColorIDsByRGB;
+	auto		rgbIter = inDataPtr->emulator.trueColorIDsByRGB.find(rgbKey);
 	
 	
-	locateScrollingRegion(inDataPtr, scrollingRegionBegin, scrollingRegionEnd);
-	if (0 != inNumberOfLines)
+	if (rgbIter != rgbMap.end())
 	{
-		// the row index MUST be calculated immediately, since inserting lines into the
-		// buffer might make it impossible to find this at the end (where this index is
-		// actually needed)
-		My_ScreenRowIndex const						kFirstInsertedRow = std::distance(inDataPtr->screenBuffer.begin(), inInsertionLine);
-		My_ScreenRowIndex const						kLinesUntilEnd = std::distance(inInsertionLine, scrollingRegionEnd);
-		My_ScreenRowIndex const						kMostLines = std::min(STATIC_CAST(inNumberOfLines, My_ScreenRowIndex), kLinesUntilEnd);
-		My_ScreenBufferLineList::size_type const	kBufferSize = inDataPtr->screenBuffer.size();
-		My_ScreenBufferLineList::iterator			pastLastKeptLine;
-		
+		// the specified R/G/B combination is currently in use
+		// and it has an ID; rather than wasting another ID,
+		// return the existing ID
+		outColorID = rgbIter->second;
+		result = true;
+	}
+	else if (nullptr != inDataPtr->emulator.trueColorTableReds)
+	{
+		outColorID = inDataPtr->emulator.trueColorTableNextID;
 		
-		// insert blank lines
-		if ((kMy_AttributeRuleCopyLast == inAttributeRule) && (scrollingRegionEnd != scrollingRegionBegin))
+		if (inDataPtr->emulator.trueColorTableReds->size() <= kTextAttributes_TrueColorIDMaximum)
 		{
-			My_ScreenBufferLinePtr		lineTemplate = createLinePtr();
-			
-			
-			// copy attributes of the insertion line, making a special exception
-			// to prevent bitmaps from being copied
-			std::copy((*inInsertionLine)->returnAttributeVector().begin(),
-						(*inInsertionLine)->returnAttributeVector().end(),
-						lineTemplate->returnMutableAttributeVector().begin());
-			for (auto& attributeFlags : lineTemplate->returnMutableAttributeVector())
+			// table is not yet big enough; allocate more space
+			inDataPtr->emulator.trueColorTableReds->push_back(inRed);
+			inDataPtr->emulator.trueColorTableGreens->push_back(inGreen);
+			inDataPtr->emulator.trueColorTableBlues->push_back(inBlue);
+			if (inDataPtr->emulator.trueColorTableNextID == kTextAttributes_TrueColorIDMaximum)
 			{
-				attributeFlags.removeImageRelatedAttributes();
+				// table has reached its maximum size; next one will overwrite
+				inDataPtr->emulator.trueColorTableNextID = 0;
 			}
-			lineTemplate->returnMutableGlobalAttributes() = (*inInsertionLine)->returnGlobalAttributes();
-			inDataPtr->screenBuffer.insert(inInsertionLine, kMostLines, lineTemplate);
-		}
-		else if (kMy_AttributeRuleCopyLatentBackground == inAttributeRule)
-		{
-			My_ScreenBufferLinePtr		lineTemplate = createLinePtr();
-			
-			
-			// the new lines have no attributes EXCEPT for a custom background color
-			for (auto& attributeFlags : lineTemplate->returnMutableAttributeVector())
+			else
 			{
-				attributeFlags.colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
+				// set next ID to match index of next new element
+				inDataPtr->emulator.trueColorTableNextID = STATIC_CAST(inDataPtr->emulator.trueColorTableReds->size(), UInt16);
 			}
-			inDataPtr->screenBuffer.insert(inInsertionLine, kMostLines, lineTemplate);
 		}
 		else
 		{
-			inDataPtr->screenBuffer.insert(inInsertionLine, kMostLines, createLinePtr());
+			// table is at maximum size; reuse the already-allocated space
+			(*(inDataPtr->emulator.trueColorTableReds))[inDataPtr->emulator.trueColorTableNextID] = inRed;
+			(*(inDataPtr->emulator.trueColorTableGreens))[inDataPtr->emulator.trueColorTableNextID] = inGreen;
+			(*(inDataPtr->emulator.trueColorTableBlues))[inDataPtr->emulator.trueColorTableNextID] = inBlue;
+			if (kTextAttributes_TrueColorIDMaximum == inDataPtr->emulator.trueColorTableNextID)
+			{
+				inDataPtr->emulator.trueColorTableNextID = 0;
+			}
+			else
+			{
+				++(inDataPtr->emulator.trueColorTableNextID);
+			}
+			
+			// remove any previous RGB mapping to the ID that is being reused
+			// (otherwise, a future request for the previous key color would
+			// continue to return the same ID)
+			auto	iterPair = inDataPtr->emulator.trueColorIDsByRGB.begin();
+			auto	endPairs = inDataPtr->emulator.trueColorIDsByRGB.end();
+			for (; iterPair != endPairs; ++iterPair)
+			{
+				if (outColorID == iterPair->second)
+				{
+					break;
+				}
+			}
+			if (iterPair != endPairs)
+			{
+				inDataPtr->emulator.trueColorIDsByRGB.erase(iterPair);
+			}
 		}
 		
-		// delete last lines
-		pastLastKeptLine = scrollingRegionEnd;
-		std::advance(pastLastKeptLine, -STATIC_CAST(kMostLines, SInt16));
-		inDataPtr->screenBuffer.erase(pastLastKeptLine, scrollingRegionEnd);
-		
-		assert(kBufferSize == inDataPtr->screenBuffer.size());
+		// create a mapping based on the RGB value back to this entry
+		// so that repeated requests for the same color do not exhaust
+		// the limited set of color ID entries
+		rgbMap[rgbKey] = outColorID;
 		
-		// redraw the area
-		{
-			Terminal_RangeDescription	range;
-			
-			
-			range.screen = inDataPtr->selfRef;
-			range.firstRow = kFirstInsertedRow;
-			range.firstColumn = 0;
-			range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
-			range.rowCount = inDataPtr->customScrollingRegion.lastRow - range.firstRow + 1;
-			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
-		}
+		result = true;
 	}
-}// bufferInsertBlankLines
+	
+	return result;
+}// defineTrueColor
 
 
 /*!
-Inserts the specified number of blank characters at the current
-cursor position, truncating that many characters from the end of
-the line when the line is shifted.  The display is NOT updated.
+Uniform interface for freeing the entries in line-lists.
+DO NOT attempt manual memory management, as the scheme
+may need to change over time to address performance and
+sharing of data.
 
-If "inAttributeRule" is "kMy_AttributeRuleCopyLatentBackground",
-then the background color attribute of each new blank character
-comes from the most recent background color setting.
+For instance, later the semantics of this function may be
+to mark an allocated line as available for reuse (as
+opposed to destroying it here).
 
-(2.6)
+(4.1)
 */
 void
-bufferInsertBlanksAtCursorColumnWithoutUpdate	(My_ScreenBufferPtr		inDataPtr,
-												 SInt16					inNumberOfBlankCharactersToInsert,
-												 My_AttributeRule		inAttributeRule)
+deleteLinePtr	(My_ScreenBufferLinePtr&	inoutLinePtr)
 {
-	UInt16								numBlanksToAdd = inNumberOfBlankCharactersToInsert;
-	SInt16								postWrapCursorX = inDataPtr->current.cursorX;
-	My_ScreenRowIndex					postWrapCursorY = inDataPtr->current.cursorY;
-	My_ScreenBufferLineList::iterator	toCursorLine;
-	TextAttributes_Object				copiedAttributes;
-	
-	
-	// wrap cursor
-	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
-	locateCursorLine(inDataPtr, toCursorLine);
-	
-	// since the caller cannot know for sure if the cursor wrapped,
-	// do bounds-checking between the screen edge and new location
-	if ((postWrapCursorX + numBlanksToAdd) >= inDataPtr->current.returnNumberOfColumnsPermitted())
-	{
-		numBlanksToAdd = inDataPtr->current.returnNumberOfColumnsPermitted() - postWrapCursorX;
-	}
-	
-	// change attributes if necessary
-	copiedAttributes = (*toCursorLine)->returnGlobalAttributes();
-	if (kMy_AttributeRuleCopyLatentBackground == inAttributeRule)
-	{
-		copiedAttributes.colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
-	}
-	
-	// update text and attributes
-	(*toCursorLine)->insertBlanks(StringUtilities_Cell(postWrapCursorX), StringUtilities_Cell(numBlanksToAdd),
-									copiedAttributes, StringUtilities_Cell(inDataPtr->current.returnNumberOfColumnsPermitted()));
-}// bufferInsertBlanksAtCursorColumnWithoutUpdate
+	// the line (if it is not shared) is destroyed along with this
+	// temporary handle, leaving the given handle blank
+	My_ScreenBufferLinePtr		releasedLinePtr(std::move(inoutLinePtr));
+}// deleteLinePtr
 
 
 /*!
-Shifts the text cursor based on the number of terminal cells
-required to render the given image, updating the attributes
-of all affected cells to display individual segments of the
-image.  The display is NOT updated.
-
-If "inAllowScrolling" is set to true, the terminal scrolls
-if the cursor shifts past the bottom of the screen and will
-continue to scroll as long as the image grows that way.
+An alternative to echoCFString() for the common case, used by
+My_DefaultEmulator::echoData(): the given bytes are decoded
+straight into Unicode values in reusable storage and written to
+the screen cells, without creating any string objects.
 
-If "inRestoreCursor" is set to true, the cursor returns to
-its original position after the image is inserted instead
-of having a new location at the end of the image.
+This only applies to UTF-8 and to encodings whose byte values
+are also Unicode values (ASCII and ISO Latin-1), and only when
+every character stands alone as a cluster (see
+UnicodeWidth_IsStandalone()); it also does not apply while text
+must be captured, printed or spoken, or while the print controller
+is on.  In any other case, nothing
+is written and false is returned, and the caller should fall
+back to echoCFString().
 
-(2017.12)
+(2023.10)
 */
-void
-bufferInsertInlineImageWithoutUpdate	(My_ScreenBufferPtr		inDataPtr,
-										 NSImage*				inCompleteImage,
-										 UInt16					inTotalPixelsH,
-										 UInt16					inTotalPixelsV,
-										 UInt16					inCellPixelsH,
-										 UInt16					inCellPixelsV,
-										 Boolean				inAllowScrolling,
-										 Boolean				inRestoreCursor)
+Boolean
+echoBytesDirectly	(My_ScreenBufferPtr		inDataPtr,
+					 UInt8 const*			inBuffer,
+					 UInt32					inLength)
 {
-	UInt16			cellsCoveredH = std::max< UInt16 >(1, STATIC_CAST(roundf(STATIC_CAST(inTotalPixelsH, Float32) /
-																				STATIC_CAST(inCellPixelsH, Float32)),
-																		UInt16));
-	UInt16			cellsCoveredV = std::max< UInt16 >(1, STATIC_CAST(roundf(STATIC_CAST(inTotalPixelsV, Float32) /
-																				STATIC_CAST(inCellPixelsV, Float32)),
-																		UInt16));
-	NSRect			subImageRect = NSZeroRect; // initialized below
-	
+	CFStringEncoding const	kEncoding = inDataPtr->emulator.inputTextEncoding;
+	My_UniCharList&			decodedText = inDataPtr->echoUniChars;
+	Boolean					result = true;
 	
-	if (DebugInterface_LogsSixelDecoderSummary())
-	{
-		Console_WriteValue("terminal columns covered by image", cellsCoveredH);
-		Console_WriteValue("terminal rows covered by image", cellsCoveredV);
-	}
 	
-	if (cellsCoveredH > inDataPtr->text.visibleScreen.numberOfColumnsAllocated)
-	{
-		cellsCoveredH = inDataPtr->text.visibleScreen.numberOfColumnsAllocated;
-		if (DebugInterface_LogsSixelDecoderErrors())
-		{
-			Console_Warning(Console_WriteLine, "the Sixel image has been clipped on the right side (terminal screen not wide enough)");
-			if (inDataPtr->text.visibleScreen.numberOfColumnsAllocated < inDataPtr->text.visibleScreen.numberOfColumnsPermitted)
-			{
-				Console_Warning(Console_WriteLine, "it may be possible to see the whole image by resizing the window first");
-			}
-		}
-	}
-	if (cellsCoveredV > inDataPtr->screenBuffer.size())
+	// capture files, printing and speech all consume strings; and
+	// in print controller mode, nothing may reach the screen at all
+	if ((nullptr != inDataPtr->captureStream) || (nullptr != inDataPtr->printingStream) ||
+		(0 != (inDataPtr->printingModes & kMy_PrintingModePrintController)) ||
+		(kTerminal_SpeechModeSpeakNever != inDataPtr->speech.mode))
 	{
-		cellsCoveredV = inDataPtr->screenBuffer.size();
-		if (DebugInterface_LogsSixelDecoderErrors())
-		{
-			Console_Warning(Console_WriteLine, "the Sixel image has been clipped or scrolled vertically (terminal screen not tall enough)");
-		}
+		result = false;
 	}
 	
-	// initialize first sub-rectangle (rendered by one terminal cell)
-	subImageRect = NSMakeRect(0, inCompleteImage.size.height - inCellPixelsV,
-								inCellPixelsH, inCellPixelsV);
-	
-	// since the image is being rendered inline by the terminal, shift the text
-	// cursor location according to the number of text cells that are occupied
-	UInt16 const		kOriginalCursorX = inDataPtr->current.cursorX;
-	UInt16 const		kOriginalCursorY = inDataPtr->current.cursorY;
-	for (UInt16 i = 0; i < cellsCoveredV; ++i)
+	// decode the entire buffer before writing anything, since
+	// any unexpected character means that nothing is written
+	decodedText.clear(); // note: storage is retained
+	if (false == result)
 	{
-		My_ScreenBufferLineList::iterator	cursorLineIterator;
+		// do nothing
+	}
+	else if (kCFStringEncodingUTF8 == kEncoding)
+	{
+		// the echo buffer only holds complete sequences (see
+		// Terminal_EmulatorProcessData()) so a new decoder is
+		// used; any error or surrogate pair uses the slow path
+		UTF8Decoder_StateMachine	decoder;
 		
 		
-		moveCursorX(inDataPtr, kOriginalCursorX);
-		subImageRect.origin.x = 0;
-		locateCursorLine(inDataPtr, cursorLineIterator);
-		for (UInt16 j = 0; j < cellsCoveredH; ++j)
+		if ((0 != decoder.decodeRun(inBuffer, inLength, decodedText)) || decoder.incompleteSequence())
 		{
-			TextAttributes_BitmapID		cellBitmapID;
-			TextAttributes_Object		newAttributes;
-			
-			
-			// set attributes on all affected text cells to allow them to render their
-			// assigned portion of the overall image
-			if (false == defineBitmap(inDataPtr, inCompleteImage, subImageRect, cellBitmapID))
+			result = false;
+		}
+		else
+		{
+			for (auto aCharacter : decodedText)
 			{
-				if (DebugInterface_LogsSixelDecoderErrors())
+				if (false == UnicodeWidth_IsStandalone(aCharacter))
 				{
-					Console_Warning(Console_WriteLine, "failed to allocate a cell bitmap");
+					result = false;
+					break;
 				}
 			}
+		}
+	}
+	else if ((kCFStringEncodingASCII == kEncoding) || (kCFStringEncodingISOLatin1 == kEncoding))
+	{
+		// in these encodings, byte values are equal to Unicode values
+		// (except that ASCII does not define anything above 0x7F)
+		for (UInt32 i = 0; ((result) && (i < inLength)); ++i)
+		{
+			if (((kCFStringEncodingASCII == kEncoding) && (false == UTF8Decoder_StateMachine::isSingleByteGlyph(inBuffer[i]))) ||
+				(false == UnicodeWidth_IsStandalone(inBuffer[i])))
+			{
+				result = false;
+			}
 			else
 			{
-				newAttributes.bitmapIDSet(cellBitmapID);
+				decodedText.push_back(inBuffer[i]);
 			}
-			changeLineRangeAttributes(inDataPtr, *(*cursorLineIterator),
-										inDataPtr->current.cursorX, 1 + inDataPtr->current.cursorX,
-										newAttributes/* attributes to set */,
-										TextAttributes_Object(0xFFFFFFFF, 0xFFFFFFFF)/* attributes to clear */);
-			
-			moveCursorRight(inDataPtr);
-			subImageRect.origin.x += subImageRect.size.width;
 		}
-		
-		if (inAllowScrolling)
-		{
-			moveCursorDownOrScroll(inDataPtr);
-		}
-		else
-		{
-			moveCursorDown(inDataPtr);
-		}
-		subImageRect.origin.y -= subImageRect.size.height;
 	}
-	moveCursorX(inDataPtr, kOriginalCursorX);
-	if (inRestoreCursor)
+	else
 	{
-		moveCursorY(inDataPtr, kOriginalCursorY);
+		result = false;
 	}
-}// bufferInsertInlineImageWithoutUpdate
-
-
-/*!
-Efficiently overwrites the entire buffer for the given
-line, such that every character on the line becomes the
-given fill character and every character’s attributes
-match the given fill attributes.  You may also update
-the line global attributes, which define the default
-attributes effective regardless of individual character
-attributes on the line.
-
-(3.0)
-*/
-void
-bufferLineFill	(My_ScreenBufferPtr			UNUSED_ARGUMENT(inDataPtr),
-				 My_ScreenBufferLine&		inRow,
-				 CFStringRef				inFillCharacter,
-				 TextAttributes_Object		inFillAttributes,
-				 Boolean					inUpdateLineGlobalAttributesAlso)
-{
-	inRow.fillWith(inFillCharacter);
-	std::fill(inRow.returnMutableAttributeVector().begin(), inRow.returnMutableAttributeVector().end(), inFillAttributes);
-	if (inUpdateLineGlobalAttributesAlso)
+	
+	// add each character to the terminal at the current cursor position
+	if (result)
 	{
-		inRow.returnMutableGlobalAttributes() = inFillAttributes;
+		My_ScreenBufferLineList::iterator	cursorLineIterator;
+		SInt16								preWriteCursorX = inDataPtr->current.cursorX;
+		My_ScreenRowIndex const				kPreWriteCursorY = inDataPtr->current.cursorY;
+		
+		
+		// WARNING: This is done once here, for efficiency, and is only
+		//          repeated by echoCell() if the cursor actually moves
+		//          vertically.
+		locateCursorLine(inDataPtr, cursorLineIterator);
+		for (auto aCharacter : decodedText)
+		{
+			echoCell(inDataPtr, cursorLineIterator, preWriteCursorX, aCharacter, UnicodeWidth_ReturnCellCount(aCharacter));
+		}
+		
+		// end of data; notify of a change (this will cause things like Terminal View updates)
+		changeNotifyForEcho(inDataPtr, preWriteCursorX, kPreWriteCursorY);
 	}
-}// bufferLineFill
+	
+	return result;
+}// echoBytesDirectly
 
 
 /*!
-Deletes characters starting at the current cursor position and
-moving forwards.  The rest of the line is shifted to the left
-as a result.
+Writes one character at the current cursor position and
+advances the cursor, being mindful of wrap settings (a wrap
+is pending after the last column is written, and occurs the
+next time data is written).
 
-If "inAttributeRule" is set to "kMy_AttributeRuleCopyLast",
-all new blank characters copy the attributes of the last
-character on the cursor line.  If the rule is set to
-"kMy_AttributeRuleCopyLatentBackground", then the background
-color attribute comes from the most recent background color
-setting.
+The cell count is the number of columns that the character
+occupies (see UnicodeWidth_ReturnCluster()); it should be 1
+or 2.  Every cell holds exactly one UTF-16 unit, so a
+double-width character outside the Basic Multilingual Plane
+is stored as a surrogate pair across its 2 cells, and any
+other double-width character is followed by the value
+"kTerminal_WideCharacterContinuation".  A double-width
+character never spans two lines: if only one column remains,
+the cursor wraps first (or, without auto-wrap, the character
+is written over the last 2 columns instead).  Overwriting
+either half of a double-width character erases the other
+half.
 
-(3.0)
+The line iterator must refer to the cursor line; it is
+updated if the cursor moves to another line.  The column
+tracker is set to zero if the cursor wraps, so that the
+caller can determine the range of cells that changed (see
+changeNotifyForEcho()).
+
+(2023.10)
 */
 void
-bufferRemoveCharactersAtCursorColumn	(My_ScreenBufferPtr		inDataPtr,
-										 SInt16					inNumberOfCharactersToDelete,
-										 My_AttributeRule		inAttributeRule)
-{
-	UInt16								numCharsToRemove = inNumberOfCharactersToDelete;
-	SInt16								postWrapCursorX = inDataPtr->current.cursorX;
-	My_ScreenRowIndex					postWrapCursorY = inDataPtr->current.cursorY;
-	My_ScreenBufferLineList::iterator	toCursorLine;
-	TextAttributes_Object				copiedAttributes;
+echoCell	(My_ScreenBufferPtr						inDataPtr,
+			 My_ScreenBufferLineList::iterator&		inoutCursorLineIterator,
+			 SInt16&								inoutPreWriteCursorX,
+			 UnicodeScalarValue						inCharacter,
+			 UInt16									inCellCount)
+{
+	SInt16 const	kColumnCount = inDataPtr->current.returnNumberOfColumnsPermitted();
+	SInt16 const	kCellCount = (((inCellCount > 1) && (kColumnCount > 1)) ? 2 : 1);
+	auto			isSecondHalf = ^(UniChar inCellText)
+					{
+						return ((kTerminal_WideCharacterContinuation == inCellText) || CFStringIsSurrogateLowCharacter(inCellText));
+					};
+	Boolean			isEarlyWrap = false;
 	
 	
-	// wrap cursor
-	cursorWrapIfNecessaryGetLocation(inDataPtr, &postWrapCursorX, &postWrapCursorY);
-	locateCursorLine(inDataPtr, toCursorLine);
+	// a double-width character cannot start in the last column
+	if ((2 == kCellCount) && (false == inDataPtr->wrapPending) &&
+		(inDataPtr->current.cursorX > (kColumnCount - 2)))
+	{
+		if (inDataPtr->modeAutoWrap)
+		{
+			inDataPtr->wrapPending = true;
+			isEarlyWrap = true;
+		}
+		else
+		{
+			moveCursorX(inDataPtr, kColumnCount - 2);
+			inoutPreWriteCursorX = std::min(inoutPreWriteCursorX, inDataPtr->current.cursorX);
+		}
+	}
 	
-	// since the caller cannot know for sure if the cursor wrapped,
-	// do bounds-checking between the screen edge and new location
-	if ((postWrapCursorX + numCharsToRemove) >= inDataPtr->current.returnNumberOfColumnsPermitted())
+	// if the cursor was about to wrap on the previous
+	// write, perform that wrap now
+	if (inDataPtr->wrapPending)
 	{
-		numCharsToRemove = inDataPtr->current.returnNumberOfColumnsPermitted() - postWrapCursorX;
+		// remember that the text of this line continues on the next
+		// line (e.g. so that searches can find text across the wrap);
+		// when wrapping early for a double-width character, the cursor
+		// column was never written so it is not part of the text
+		(*inoutCursorLineIterator)->softWrapColumnCount = STATIC_CAST((isEarlyWrap)
+																		? inDataPtr->current.cursorX
+																		: inDataPtr->current.cursorX + 1, UInt16);
+		
+		// autowrap to start of next line
+		moveCursorLeftToEdge(inDataPtr);
+		moveCursorDownOrScroll(inDataPtr);
+		locateCursorLine(inDataPtr, inoutCursorLineIterator); // cursor changed rows...
+		
+		// reset column tracker
+		inoutPreWriteCursorX = 0;
 	}
 	
-	// change attributes if necessary
-	copiedAttributes = (*toCursorLine)->returnGlobalAttributes();
-	if (kMy_AttributeRuleCopyLast == inAttributeRule)
+	// write characters on a single line
+	if (inDataPtr->modeInsertNotReplace)
 	{
-		// copy attributes of the last character, making a special exception
-		// to prevent bitmaps from being copied
-		copiedAttributes = (*toCursorLine)->returnAttributeVector()[inDataPtr->current.returnNumberOfColumnsPermitted() - 1];
-		if (copiedAttributes.hasAttributes(kTextAttributes_ColorIndexIsBitmapID))
+		if (bufferInsertBlanksAtCursorColumnWithoutUpdate(inDataPtr, kCellCount/* number of blank characters */, kMy_AttributeRuleInitialize))
 		{
-			copiedAttributes.removeImageRelatedAttributes();
+			inoutPreWriteCursorX = std::min< SInt16 >(inoutPreWriteCursorX, inDataPtr->current.cursorX - 1);
 		}
 	}
-	else if (kMy_AttributeRuleCopyLatentBackground == inAttributeRule)
+	
+	// if only half of an existing double-width character is about
+	// to be overwritten, erase the other half (its attributes remain)
 	{
-		copiedAttributes.colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
+		My_ScreenBufferLinePtr&		cursorLinePtr = *inoutCursorLineIterator;
+		SInt16 const				kFirstColumn = inDataPtr->current.cursorX;
+		SInt16 const				kPastEndColumn = (kFirstColumn + kCellCount);
+		
+		
+		if ((kFirstColumn > 0) && isSecondHalf(cursorLinePtr->textVectorBegin[kFirstColumn]))
+		{
+			cursorLinePtr->textVectorBegin[kFirstColumn - 1] = ' ';
+			inoutPreWriteCursorX = std::min< SInt16 >(inoutPreWriteCursorX, kFirstColumn - 1);
+		}
+		if ((kPastEndColumn < kColumnCount) && isSecondHalf(cursorLinePtr->textVectorBegin[kPastEndColumn]))
+		{
+			cursorLinePtr->textVectorBegin[kPastEndColumn] = ' ';
+		}
 	}
 	
-	// update text and attributes
-	(*toCursorLine)->deleteRange(StringUtilities_Cell(postWrapCursorX), StringUtilities_Cell(numCharsToRemove),
-									copiedAttributes, StringUtilities_Cell(inDataPtr->current.returnNumberOfColumnsPermitted()));
-	
-	// add the entire line from the cursor to the end
-	// to the text-change region; this would trigger
-	// things like Terminal View updates
-	//Console_WriteLine("text changed event: remove characters at cursor column");
+	if (2 == kCellCount)
 	{
-		Terminal_RangeDescription	range;
+		UniChar		cellText[2] = { STATIC_CAST(inCharacter, UniChar), kTerminal_WideCharacterContinuation };
 		
 		
-		range.screen = inDataPtr->selfRef;
-		range.firstRow = postWrapCursorY;
-		range.firstColumn = postWrapCursorX;
-		range.columnCount = inDataPtr->current.returnNumberOfColumnsPermitted() - postWrapCursorX;
-		range.rowCount = 1;
-		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+		if (inCharacter > 0xFFFF)
+		{
+			UNUSED_RETURN(Boolean)CFStringGetSurrogatePairForLongCharacter(inCharacter, cellText);
+		}
+		translateCell(inDataPtr, (*inoutCursorLineIterator), StringUtilities_Cell(inDataPtr->current.cursorX), cellText[0], inDataPtr->current.drawingAttributes);
+		(*inoutCursorLineIterator)->replaceCell(StringUtilities_Cell(inDataPtr->current.cursorX + 1), cellText[1], inDataPtr->current.drawingAttributes);
 	}
-}// bufferRemoveCharactersAtCursorColumn
+	else
+	{
+		// a narrow character outside the Basic Multilingual Plane
+		// cannot be stored in one cell; show a replacement instead
+		translateCell(inDataPtr, (*inoutCursorLineIterator), StringUtilities_Cell(inDataPtr->current.cursorX),
+						((inCharacter > 0xFFFF) ? 0xFFFD : inCharacter), inDataPtr->current.drawingAttributes);
+	}
+	
+	if (false == inDataPtr->wrapPending)
+	{
+		if ((inDataPtr->current.cursorX + kCellCount) < kColumnCount)
+		{
+			// advance the cursor position
+			moveCursorX(inDataPtr, inDataPtr->current.cursorX + kCellCount);
+		}
+		else
+		{
+			// hit right margin (a double-width character has
+			// just filled the last 2 columns so the cursor is
+			// moved to the last column)
+			if (kCellCount > 1)
+			{
+				moveCursorRightToEdge(inDataPtr);
+			}
+			if (inDataPtr->modeAutoWrap)
+			{
+				// the cursor just arrived here, so set up a pending
+				// wrap-and-scroll; it will only occur the next time
+				// data is actually written
+				inDataPtr->wrapPending = true;
+			}
+			else
+			{
+				// stay at right margin
+				moveCursorRightToEdge(inDataPtr);
+			}
+		}
+	}
+}// echoCell
 
 
 /*!
-Deletes lines from the screen buffer, scrolling up the
-remainder and inserting new blank lines at the bottom of the
-scrolling region.  The display is updated.
-
-New blank lines normally have cleared attributes.  If however
-"inAttributeRule" is set to "kMy_AttributeRuleCopyLast", they
-will instead copy the attributes of the line that was at the
-end prior to new lines being inserted.
-
-See also bufferInsertBlankLines().
-
-NOTE:   You cannot use this to alter the scrollback.
+Treats the specified string as “verbatim”, sending the
+characters wherever they need to go (any open print jobs
+or capture files, the terminal, etc.).
 
-WARNING:	The specified line MUST be part of the terminal
-			scrolling region.
+The given string is also analyzed for words in order to
+support future auto-completion.
 
-(3.0)
+(4.0)
 */
 void
-bufferRemoveLines	(My_ScreenBufferPtr						inDataPtr,
-					 UInt16									inNumberOfLines,
-					 My_ScreenBufferLineList::iterator&		inFirstDeletionLine,
-					 My_AttributeRule						inAttributeRule)
+echoCFString	(My_ScreenBufferPtr		inDataPtr,
+				 CFStringRef			inString)
 {
-	My_ScreenBufferLineList::iterator	scrollingRegionBegin;
-	My_ScreenBufferLineList::iterator	scrollingRegionEnd;
+	CFIndex const	kLength = CFStringGetLength(inString);
+	Boolean const	kPrinterOnly = (0 != (inDataPtr->printingModes & kMy_PrintingModePrintController));
 	
 	
-	locateScrollingRegion(inDataPtr, scrollingRegionBegin, scrollingRegionEnd);
-	if (0 != inNumberOfLines)
+	// append to capture file, if one is open; try to avoid conversion,
+	// but if necessary convert the bytes into a Unicode format
+	if ((nullptr != inDataPtr->captureStream) || (nullptr != inDataPtr->printingStream))
 	{
-		// the row index MUST be calculated immediately, since removing lines from the
-		// buffer might make it impossible to find this at the end (where this index
-		// is actually needed)
-		My_ScreenRowIndex const						kFirstDeletedRow = std::distance(inDataPtr->screenBuffer.begin(), inFirstDeletionLine);
-		My_ScreenRowIndex const						kLinesUntilEnd = std::distance(inFirstDeletionLine, scrollingRegionEnd);
-		My_ScreenRowIndex const						kMostLines = std::min(STATIC_CAST(inNumberOfLines, My_ScreenRowIndex), kLinesUntilEnd);
-		My_ScreenBufferLineList::size_type const	kBufferSize = inDataPtr->screenBuffer.size();
-		My_ScreenBufferLineList::iterator			pastLastDeletionLine;
+		CFStringEncoding const		kDesiredEncoding = kCFStringEncodingUTF8;
+		CFIndex						bytesNeeded = 0;
+		UInt8 const*				bufferReadOnly = REINTERPRET_CAST(CFStringGetCStringPtr(inString, kDesiredEncoding),
+																		UInt8 const*);
+		UInt8*						buffer = nullptr;
+		Boolean						freeBuffer = false;
 		
 		
-		// insert blank lines
-		if ((kMy_AttributeRuleCopyLast == inAttributeRule) && (scrollingRegionEnd != scrollingRegionBegin))
+		if (nullptr != bufferReadOnly)
 		{
-			My_ScreenBufferLinePtr				lineTemplate = createLinePtr();
-			My_ScreenBufferLineList::iterator	toCopiedLine = scrollingRegionEnd;
+			bytesNeeded = CPP_STD::strlen(REINTERPRET_CAST(bufferReadOnly, char const*));
+		}
+		else
+		{
+			CFIndex		conversionResult = CFStringGetBytes(inString, CFRangeMake(0, kLength),
+															kDesiredEncoding, '?'/* loss byte */,
+															true/* is external representation */,
+															nullptr/* buffer; do not use, just find size */, 0/* buffer size, ignored */,
+															&bytesNeeded);
 			
 			
-			std::advance(toCopiedLine, -1);
-			// copy attributes of the previous last line, making a special
-			// exception to prevent bitmaps from being copied
-			std::copy((*toCopiedLine)->returnAttributeVector().begin(),
-						(*toCopiedLine)->returnAttributeVector().end(),
-						lineTemplate->returnMutableAttributeVector().begin());
-			for (auto& attributeFlags : lineTemplate->returnMutableAttributeVector())
+			if (conversionResult > 0)
 			{
-				attributeFlags.removeImageRelatedAttributes();
+				buffer = new UInt8[bytesNeeded];
+				freeBuffer = true;
+				
+				conversionResult = CFStringGetBytes(inString, CFRangeMake(0, kLength),
+													kDesiredEncoding, '?'/* loss byte */,
+													true/* is external representation */,
+													buffer, bytesNeeded, &bytesNeeded);
+				assert(conversionResult > 0);
+				
+				bufferReadOnly = buffer;
 			}
-			lineTemplate->returnMutableGlobalAttributes() = (*toCopiedLine)->returnGlobalAttributes();
-			inDataPtr->screenBuffer.insert(scrollingRegionEnd, kMostLines, lineTemplate);
 		}
-		else if (kMy_AttributeRuleCopyLatentBackground == inAttributeRule)
+		
+		if (nullptr != bufferReadOnly)
 		{
-			My_ScreenBufferLinePtr		lineTemplate = createLinePtr();
-			
-			
-			// the new lines have no attributes EXCEPT for a custom background color
-			for (auto& attributeFlags : lineTemplate->returnMutableAttributeVector())
+			if ((false == kPrinterOnly) && (nullptr != inDataPtr->captureStream))
 			{
-				attributeFlags.colorIndexBackgroundCopyFrom(inDataPtr->current.latentAttributes);
+				StreamCapture_WriteUTF8Data(inDataPtr->captureStream, bufferReadOnly, bytesNeeded);
+			}
+			if (nullptr != inDataPtr->printingStream)
+			{
+				StreamCapture_WriteUTF8Data(inDataPtr->printingStream, bufferReadOnly, bytesNeeded);
 			}
-			inDataPtr->screenBuffer.insert(scrollingRegionEnd, kMostLines, lineTemplate);
 		}
-		else
+		
+		if (freeBuffer)
 		{
-			inDataPtr->screenBuffer.insert(scrollingRegionEnd, kMostLines, createLinePtr());
+			delete [] buffer, buffer = nullptr;
 		}
+	}
+	
+	// add each character to the terminal at the current cursor position, advancing
+	// the cursor each time (and therefore being mindful of wrap settings, etc.);
+	// the text is split into grapheme clusters directly from UTF-16 storage,
+	// and each cluster uses the number of cells given by the Unicode tables
+	if (false == kPrinterOnly)
+	{
+		My_ScreenBufferLineList::iterator	cursorLineIterator;
+		SInt16								preWriteCursorX = inDataPtr->current.cursorX;
+		My_ScreenRowIndex const				kPreWriteCursorY = inDataPtr->current.cursorY;
+		UniChar const*						textPtr = CFStringGetCharactersPtr(inString);
 		
-		// delete first lines
-		pastLastDeletionLine = inFirstDeletionLine;
-		std::advance(pastLastDeletionLine, kMostLines);
-		inDataPtr->screenBuffer.erase(inFirstDeletionLine, pastLastDeletionLine);
 		
-		assert(kBufferSize == inDataPtr->screenBuffer.size());
+		if (nullptr == textPtr)
+		{
+			My_UniCharList&		copiedText = inDataPtr->echoUniChars;
+			
+			
+			copiedText.resize(kLength); // note: storage is retained
+			CFStringGetCharacters(inString, CFRangeMake(0, kLength), copiedText.data());
+			textPtr = copiedText.data();
+		}
 		
-		// redraw the area
+		// WARNING: This is done once here, for efficiency, and is only
+		//          repeated by echoCell() if the cursor actually moves
+		//          vertically.
+		locateCursorLine(inDataPtr, cursorLineIterator);
+		for (CFIndex i = 0; i < kLength; )
 		{
-			Terminal_RangeDescription	range;
+			UnicodeWidth_Cluster const	kCluster = UnicodeWidth_ReturnCluster(textPtr + i, kLength - i);
+			UnicodeScalarValue			cellCharacter = kCluster.firstScalar;
 			
 			
-			range.screen = inDataPtr->selfRef;
-			range.firstRow = kFirstDeletedRow;
-			range.firstColumn = 0;
-			range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
-			range.rowCount = inDataPtr->customScrollingRegion.lastRow - range.firstRow + 1;
-			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+			// a cell holds one character so a base character and
+			// its combining marks are only kept together if there
+			// is an equivalent precomposed character
+			if ((kCluster.length > 1) && (cellCharacter <= 0xFFFF))
+			{
+				CFRetainRelease		composedString(CFStringCreateMutable(kCFAllocatorDefault, 0/* maximum length */),
+													CFRetainRelease::kAlreadyRetained);
+				
+				
+				CFStringAppendCharacters(composedString.returnCFMutableStringRef(), textPtr + i, kCluster.length);
+				CFStringNormalize(composedString.returnCFMutableStringRef(), kCFStringNormalizationFormC);
+				if (1 == CFStringGetLength(composedString.returnCFStringRef()))
+				{
+					cellCharacter = CFStringGetCharacterAtIndex(composedString.returnCFStringRef(), 0);
+				}
+			}
+			
+			// clusters with no width (such as stray combining
+			// marks or zero-width spaces) are not displayed
+			if (kCluster.cellCount > 0)
+			{
+				echoCell(inDataPtr, cursorLineIterator, preWriteCursorX, cellCharacter, kCluster.cellCount);
+			}
+			i += kCluster.length;
 		}
+		
+		// end of data; notify of a change (this will cause things like Terminal View updates)
+		changeNotifyForEcho(inDataPtr, preWriteCursorX, kPreWriteCursorY);
 	}
-}// bufferRemoveLines
+}// echoCFString
 
 
 /*!
-Internal version of Terminal_ChangeLineAttributes().
-
-(3.0)
-*/
-void
-changeLineAttributes	(My_ScreenBufferPtr			inDataPtr,
-						 My_ScreenBufferLine&		inRow,
-						 TextAttributes_Object		inSetTheseAttributes,
-						 TextAttributes_Object		inClearTheseAttributes)
-{
-	changeLineRangeAttributes(inDataPtr, inRow, 0/* first column */, -1/* last column; negative means “very end” */,
-								inSetTheseAttributes, inClearTheseAttributes);
-}// changeLineAttributes
-
+Erases the characters from the halfway point on the
+screen to the right edge of the specified line,
+clearing all attributes.  NO update events are sent.
 
-/*!
-Sets attributes that are global to a line.  Unlike
-changeLineAttributes() which merely copies attributes
-to each character, this routine also remembers the
-specified changes as attributes for the entire line
-so that every time the cursor enters the line, the
-cursor attributes inherit the line’s global attributes.
+This is required when switching to double-width
+mode, which specifies that the right half of the
+screen data on a double-width line be lost.
 
 (3.0)
 */
 void
-changeLineGlobalAttributes	(My_ScreenBufferPtr			inDataPtr,
-							 My_ScreenBufferLine&		inRow,
-							 TextAttributes_Object		inSetTheseAttributes,
-							 TextAttributes_Object		inClearTheseAttributes)
+eraseRightHalfOfLine	(My_ScreenBufferPtr		inDataPtr,
+						 My_ScreenBufferLine&	inRow)
 {
-	// first copy the attributes to every character in the line
-	changeLineAttributes(inDataPtr, inRow, inSetTheseAttributes, inClearTheseAttributes);
+	SInt16										midColumn = STATIC_CAST(INTEGER_DIV_2
+																		(inDataPtr->text.visibleScreen.numberOfColumnsPermitted),
+																			SInt16);
+	CFIndex										midStringIndex = StringUtilities_ReturnCharacterIndexForCell
+																	(inRow.returnCFStringRef(), StringUtilities_Cell(midColumn),
+														 				kStringUtilities_PartialSymbolRulePrevious);
+	CFRange										clearedRange = CFRangeMake(midStringIndex, CFStringGetLength(inRow.returnCFStringRef()) - midStringIndex);
 	
-	// now remember these changes so that the cursor can inherit them automatically;
-	// currently attributes for scrollback lines do not exist, but negative indices
-	// are allowed; to avoid array overflow, check for nonnegativity here
-	inRow.returnMutableGlobalAttributes().removeAttributes(inClearTheseAttributes);
-	inRow.returnMutableGlobalAttributes().addAttributes(inSetTheseAttributes);
-}// changeLineGlobalAttributes
+	
+	// clear from halfway point to end of line
+	inRow.fillWith(CFSTR(" "), clearedRange);
+	inRow.returnMutableAttributeRuns().assign(STATIC_CAST(midColumn, UInt16), kTerminalLine_MaximumCharacterCount, inRow.returnGlobalAttributes());
+}// eraseRightHalfOfLine
 
 
 /*!
-Internal version of Terminal_ChangeLineRangeAttributes().
+Invokes a block on each chunk of the given line text for
+which the attributes are all IDENTICAL (each stored style
+run is reported as-is, since runs never have the same
+attributes as their neighbors).  The global attributes are
+added to the attributes of every run.
 
-(3.0)
+This is shared by Terminal_ForEachLikeAttributeRun() and
+Terminal_SnapshotForEachLikeAttributeRun(), which differ
+only in where the line data comes from.
+
+(2023.10)
 */
 void
-changeLineRangeAttributes	(My_ScreenBufferPtr			inDataPtr,
-							 My_ScreenBufferLine&		inRow,
-							 UInt16						inZeroBasedStartColumn,
-							 SInt16						inZeroBasedPastTheEndColumnOrNegativeForLastColumn,
-							 TextAttributes_Object		inSetTheseAttributes,
-							 TextAttributes_Object		inClearTheseAttributes)
+forEachLikeAttributeRunInLine	(CFStringRef							inLineAsCFString,
+								 TerminalLine_AttributeRunList const&	inAttributeRuns,
+								 TextAttributes_Object const&			inGlobalAttributes,
+								 Terminal_LineRef						inRowOrNull,
+								 Terminal_ScreenRunBlock				inDoWhat)
 {
-	SInt16		pastTheEndColumn = (inZeroBasedPastTheEndColumnOrNegativeForLastColumn < 0)
-									? inDataPtr->text.visibleScreen.numberOfColumnsAllocated
-									: inZeroBasedPastTheEndColumnOrNegativeForLastColumn;
-	SInt16		i = 0;
+	NSString* const		kLineAsNSString = BRIDGE_CAST(inLineAsCFString, NSString*);
+	UInt16 const		kPastLastCell = STATIC_CAST(std::min(CFStringGetLength(inLineAsCFString),
+															STATIC_CAST(kTerminalLine_MaximumCharacterCount, CFIndex)),
+												UInt16);
 	
 	
-	// update attributes for the specified columns of the given line
-	for (i = inZeroBasedStartColumn; i < pastTheEndColumn; ++i)
-	{
-		inRow.returnMutableAttributeVector()[i].removeAttributes(inClearTheseAttributes);
-		inRow.returnMutableAttributeVector()[i].addAttributes(inSetTheseAttributes);
-	}
-	
-	// update current attributes too, if the cursor is in the given range
-	if ((inZeroBasedStartColumn <= inDataPtr->current.cursorX) && (inDataPtr->current.cursorX < pastTheEndColumn))
+	for (auto toRun = inAttributeRuns.begin(); toRun != inAttributeRuns.end(); ++toRun)
 	{
-		My_ScreenBufferLineList::iterator	cursorLineIterator;
+		UInt16 const	kRunStartCharacterIndex = toRun->firstCell;
+		UInt16 const	kRunPastEndCharacterIndex = std::min(inAttributeRuns.returnPastEndCell(toRun), kPastLastCell);
 		
 		
-		locateCursorLine(inDataPtr, cursorLineIterator);
-		if (*cursorLineIterator == &inRow)
+		if (kRunStartCharacterIndex >= kPastLastCell)
 		{
-			inDataPtr->current.drawingAttributes.removeAttributes(inClearTheseAttributes);
-			inDataPtr->current.drawingAttributes.addAttributes(inSetTheseAttributes);
+			break;
+		}
+		
+		if (kRunPastEndCharacterIndex > kRunStartCharacterIndex)
+		{
+			size_t const				kStyleRunLength = (kRunPastEndCharacterIndex - kRunStartCharacterIndex);
+			TextAttributes_Object		rangeAttributes = toRun->attributes;
+			NSRange						runRange = NSMakeRange(kRunStartCharacterIndex, kStyleRunLength);
+			NSString*					styleRunSubstring = [kLineAsNSString substringWithRange:runRange];
 			
-			// ...however, do not propagate text highlighting to text rendered from now on
-			inDataPtr->current.drawingAttributes.removeAttributes(kTextAttributes_Selected);
 			
-			// ...do not propagate images either
-			inDataPtr->current.drawingAttributes.removeImageRelatedAttributes();
+			rangeAttributes.addAttributes(inGlobalAttributes);
+			inDoWhat(STATIC_CAST(kStyleRunLength, UInt16)/* length */,
+						BRIDGE_CAST(styleRunSubstring, CFStringRef),
+						inRowOrNull,
+						kRunStartCharacterIndex/* zero-based start column */,
+						rangeAttributes);
 		}
 	}
-	
-	// finally, if the end column is beyond the last character in the line,
-	// apply the attributes to EVERY column that does not have a valid character
-	// UNIMPLEMENTED
-}// changeLineRangeAttributes
+}// forEachLikeAttributeRunInLine
 
 
 /*!
-Notifies all listeners for the specified Terminal
-state change, passing the given context to the
-listener.
-
-IMPORTANT:	The context must make sense for the
-			type of change; see "Terminal.h" for
-			the type of context associated with
-			each terminal change.
+Returns a pointer to the internal structure, given a
+reference to it.
 
 (3.0)
 */
-void
-changeNotifyForTerminal		(My_ScreenBufferConstPtr	inPtr,
-							 Terminal_Change			inWhatChanged,
-							 void*						inContextPtr)
+inline My_LineIteratorPtr
+getLineIterator		(Terminal_LineRef	inIterator)
 {
-	// invoke listener callback routines appropriately, from the specified terminal’s listener model
-	ListenerModel_NotifyListenersOfEvent(inPtr->changeListenerModel, inWhatChanged, inContextPtr);
-}// changeNotifyForTerminal
+	return REINTERPRET_CAST(inIterator, My_LineIteratorPtr);
+}// getLineIterator
 
 
 /*!
-Uniform interface for creating new entries in line-lists.
-DO NOT attempt manual memory management, as the scheme
-may need to change over time to address performance and
-sharing of data.
-
-For instance, later the semantics of this function may be
-to return an already-allocated line that is no longer in
-use (as opposed to strictly allocating it here).
+A convenience function that calls getParametersFromStringRange()
+on the "inDataPtr->emulator.stringAccumulator" string’s begin/end,
+which is often where parameter data comes from during parsing. 
 
-(4.1)
+(2017.12)
 */
-My_ScreenBufferLinePtr
-createLinePtr ()
+void
+getParametersFromStringAccumulator	(My_ScreenBufferPtr								inDataPtr,
+									 ParameterDecoder_StateMachine&					inoutParamDecoder,
+									 std::basic_string< UInt8 >::const_iterator&	outIterChar)
 {
-	return My_ScreenBufferLinePtr(); // see TerminalLine_Handle
-}// createLinePtr
+	getParametersFromStringRange(inDataPtr->emulator.stringAccumulator.begin(),
+									inDataPtr->emulator.stringAccumulator.end(),
+									inoutParamDecoder, outIterChar);
+}// getParametersFromStringAccumulator
 
 
 /*!
-Restores the last saved cursor position and
-attribute settings.  See cursorSave() to ensure
-this function does the opposite.
+Iterates over the first few characters of the given
+character range until a non-parameter character is found
+(typically this means capturing all numerical values
+delimited by semicolons and stopping at the first
+non-digit, non-semicolon).
 
-(2.6)
+Upon return, the state machine object can be used to
+see what was found, such as numerical parameters.
+
+For convenience the iterator’s final value is returned,
+as this is usually vital for understanding what the
+parameters mean.  If this is equal to "inEnd", all the
+given bytes were processed without finding a terminator
+(otherwise, this can be dereferenced to see the start
+of the terminating sequence).
+
+See also getParametersFromStringAccumulator().
+
+(2017.12)
 */
 void
-cursorRestore  (My_ScreenBufferPtr		inPtr)
+getParametersFromStringRange	(std::basic_string< UInt8 >::const_iterator		inBegin,
+								 std::basic_string< UInt8 >::const_iterator		inEnd,
+								 ParameterDecoder_StateMachine&					inoutParamDecoder,
+								 std::basic_string< UInt8 >::const_iterator&	outIterChar)
 {
-	moveCursor(inPtr, inPtr->previous.cursorX, inPtr->previous.cursorY);
-	
-	// ??? this will clear the current graphics character set too, is that supposed to happen ???
-	inPtr->current.drawingAttributes = inPtr->previous.drawingAttributes;
-}// cursorRestore
+	for (outIterChar = inBegin; outIterChar != inEnd; /* incremented below */)
+	{
+		ParameterDecoder_StateMachine::State const	kOriginalState = inoutParamDecoder.returnState();
+		SInt16										loopGuard = 0;
+		Boolean										byteNotUsed = true;
+		
+		
+		while (byteNotUsed)
+		{
+			inoutParamDecoder.goNextState(*outIterChar, byteNotUsed);
+			if ((byteNotUsed) && (kOriginalState == inoutParamDecoder.returnState()))
+			{
+				// no way to proceed
+				break;
+			}
+			++loopGuard;
+			if (loopGuard > 100/* arbitrary */)
+			{
+				break;
+			}
+		}
+		
+		if (byteNotUsed)
+		{
+			break;
+		}
+		
+		++outIterChar;
+	}
+}// getParametersFromStringRange
 
 
 /*!
-Saves the current cursor position and attribute
-settings.  See cursorRestore() to ensure this
-function does the opposite.
+Returns a pointer to the internal structure, given a
+reference to it.
 
-(2.6)
+(3.0)
 */
-void
-cursorSave  (My_ScreenBufferPtr  inPtr)
+inline My_ScreenBufferPtr
+getVirtualScreenData	(TerminalScreenRef		inScreen)
 {
-	inPtr->previous.cursorX = inPtr->current.cursorX;
-	inPtr->previous.cursorY = inPtr->current.cursorY;
-	inPtr->previous.drawingAttributes = inPtr->current.drawingAttributes;
-}// cursorSave
+	return REINTERPRET_CAST(inScreen, My_ScreenBufferPtr);
+}// getVirtualScreenData
 
 
 /*!
-Returns the cursor location, first wrapping it to the
-following line if it is out of bounds (if a wrap is
-pending).
+Turns on a specific terminal LED, or turns all LEDs
+off (if 0 is given as the LED number).  The meaning of
+an LED with a specific number is left to the caller.
+
+Currently, only 4 LEDs are defined.  Providing an LED
+number of 5 or greater will have no effect.  These 4
+refer to the user-defined LEDs, so although VT100 (for
+example) defines 3 other LEDs, you can only set the
+user-defined ones with this routine.
+
+Numbers less than zero are reserved.  Probably, they
+will one day be used to turn off specific LEDs.
 
 (3.0)
 */
 void
-cursorWrapIfNecessaryGetLocation	(My_ScreenBufferPtr		inDataPtr,
-									 SInt16*				outCursorXPtr,
-									 My_ScreenRowIndex*		outCursorYPtr)
+highlightLED	(My_ScreenBufferPtr		inDataPtr,
+				 SInt16					inOneBasedLEDNumberOrZeroToTurnOffAllLEDs)
 {
-	if (inDataPtr->current.cursorX >= inDataPtr->current.returnNumberOfColumnsPermitted()) 
+	switch (inOneBasedLEDNumberOrZeroToTurnOffAllLEDs)
 	{
-		moveCursorX(inDataPtr, 0);
-		moveCursorDownOrScroll(inDataPtr);
+	case 0:
+		inDataPtr->litLEDs = kMy_LEDBitsAllOff;
+		break;
+	
+	case 1:
+		inDataPtr->litLEDs |= kMy_LEDBitsLight1;
+		break;
+	
+	case 2:
+		inDataPtr->litLEDs |= kMy_LEDBitsLight2;
+		break;
+	
+	case 3:
+		inDataPtr->litLEDs |= kMy_LEDBitsLight3;
+		break;
+	
+	case 4:
+		inDataPtr->litLEDs |= kMy_LEDBitsLight4;
+		break;
+	
+	default:
+		// ???
+		break;
 	}
-	*outCursorXPtr = inDataPtr->current.cursorX;
-	*outCursorYPtr = inDataPtr->current.cursorY;
-}// cursorWrapIfNecessaryGetLocation
+	
+	changeNotifyForTerminal(inDataPtr, kTerminal_ChangeNewLEDState, inDataPtr->selfRef/* context */);
+}// highlightLED
 
 
 /*!
-Creates a bitmap and assigns it an ID.  (See the public
-Terminal_BitmapGetFromID() API.)  Returns true only if
-successful.
-
-As noted in "TextAttributes.h", there is a limit to the
-number of possible IDs and they will be reused (oldest
-first) when the limit is exceeded.
-
-Currently there is no mechanism for intelligently reusing
-bitmap IDs.  It is up to you to avoid calling this method
-if you can tell that the resulting bitmap already exists.
-
-Also, ideally you use simple color attributes (or even
-“true color” attributes via defineTrueColor()) to display
-solid colors, instead of bitmaps.  Keep track of what
-your pixel values ultimately are so that all-same-color
-bitmap requests can be converted into simpler cells.
-
-A bitmap may be constructed incrementally and grow its
-definition according to other coordinate systems prior to
-being finalized.  It may also be the case that a much
-larger image is constructed first, and then split into an
-appropriate number of terminal cell bitmaps.  If bitmaps
-are split in this way and the total dimensions are not
-even multiples of the cell, it is important to keep all
-bitmaps the same size; for instance, include transparent
-pixels in edge bitmaps to allow an image to appear to
-occupy less space than the bitmaps actually occupy.
+Returns a map initialized with keys equal to the function
+pointers used as callbacks, and values for constant strings
+describing those callbacks.  Used in debugging logs.  See
+the internal call gCallbackIDsByFuncPtr().
 
-(2017.11)
+(2017.12)
 */
-Boolean
-defineBitmap	(My_ScreenBufferPtr			inDataPtr,
-				 NSImage*					inSourceImage,
-				 NSRect						inSubRect,
-				 TextAttributes_BitmapID&	outBitmapID)
+My_StringByPointer
+initCallbackIDsByFuncPtr ()
 {
-	Boolean		result = false;
-	
-	
-	// define new ID within range of allowed IDs
-	outBitmapID = inDataPtr->emulator.bitmapTableNextID;
-	if (kTextAttributes_BitmapIDMaximum == inDataPtr->emulator.bitmapTableNextID)
-	{
-		inDataPtr->emulator.bitmapTableNextID = 0; // start reusing IDs
-	}
-	else
-	{
-		++(inDataPtr->emulator.bitmapTableNextID);
-	}
+	My_StringByPointer		result;
 	
-	// create bitmap storage if necessary
-	if (nil == inDataPtr->emulator.bitmapImageTable)
-	{
-		inDataPtr->emulator.bitmapImageTable = [[NSMutableArray alloc] init];
-	}
-	if (nil == inDataPtr->emulator.bitmapSegmentTable)
-	{
-		inDataPtr->emulator.bitmapSegmentTable = [[NSMutableArray alloc] init];
-	}
 	
-	// add objects to storage
-	if (nil != inSourceImage)
-	{
-		NSValue*	rectValue = [NSValue valueWithRect:inSubRect];
-		
-		
-		result = true;
-		if (inDataPtr->emulator.bitmapTableNextID >= inDataPtr->emulator.bitmapSegmentTable.count)
-		{
-			[inDataPtr->emulator.bitmapImageTable
-				addObject:inSourceImage];
-			[inDataPtr->emulator.bitmapSegmentTable
-				addObject:rectValue];
-		}
-		else
-		{
-			[inDataPtr->emulator.bitmapImageTable
-				replaceObjectAtIndex:inDataPtr->emulator.bitmapTableNextID
-										withObject:inSourceImage];
-			[inDataPtr->emulator.bitmapSegmentTable
-				replaceObjectAtIndex:inDataPtr->emulator.bitmapTableNextID
-										withObject:rectValue];
-		}
-	}
+	// insert descriptions of every available callback (for debugging);
+	// since the context for use already knows the purpose of the
+	// callback, the main important information is the emulator name
+	result[REINTERPRET_CAST(My_DefaultEmulator::stateDeterminant, void const*)] = "Default";
+	result[REINTERPRET_CAST(My_DefaultEmulator::stateTransition, void const*)] = "Default";
+	result[REINTERPRET_CAST(My_DumbTerminal::stateDeterminant, void const*)] = "Dumb";
+	result[REINTERPRET_CAST(My_DumbTerminal::stateTransition, void const*)] = "Dumb";
+	result[REINTERPRET_CAST(My_VT100::stateDeterminant, void const*)] = "VT100";
+	result[REINTERPRET_CAST(My_VT100::stateTransition, void const*)] = "VT100";
+	result[REINTERPRET_CAST(My_VT100::VT52::stateDeterminant, void const*)] = "VT100/VT52";
+	result[REINTERPRET_CAST(My_VT100::VT52::stateTransition, void const*)] = "VT100/VT52";
+	result[REINTERPRET_CAST(My_VT102::stateDeterminant, void const*)] = "VT102";
+	result[REINTERPRET_CAST(My_VT102::stateTransition, void const*)] = "VT102";
+	result[REINTERPRET_CAST(My_VT220::stateDeterminant, void const*)] = "VT220";
+	result[REINTERPRET_CAST(My_VT220::stateTransition, void const*)] = "VT220";
+	result[REINTERPRET_CAST(My_XTerm::stateDeterminant, void const*)] = "XTerm";
+	result[REINTERPRET_CAST(My_XTerm::stateTransition, void const*)] = "XTerm";
+	result[REINTERPRET_CAST(My_XTermCore::stateDeterminant, void const*)] = "XTermCore";
+	result[REINTERPRET_CAST(My_XTermCore::stateTransition, void const*)] = "XTermCore";
+	result[REINTERPRET_CAST(My_ITermCore::stateDeterminant, void const*)] = "ITermCore";
+	result[REINTERPRET_CAST(My_ITermCore::stateTransition, void const*)] = "ITermCore";
+	result[REINTERPRET_CAST(My_SixelCore::stateDeterminant, void const*)] = "SixelCore";
+	result[REINTERPRET_CAST(My_SixelCore::stateTransition, void const*)] = "SixelCore";
+	result[REINTERPRET_CAST(My_UTF8Core::stateDeterminant, void const*)] = "UTF8Core";
+	result[REINTERPRET_CAST(My_UTF8Core::stateTransition, void const*)] = "UTF8Core";
 	
 	return result;
-}// defineBitmap
+}// initCallbackIDsByFuncPtr
 
 
 /*!
-Provides the ID for the given RGB combination.  (See the
-public Terminal_TrueColorGetFromID() API.)  Returns true
-only if successful.
-
-As noted in "TextAttributes.h", there is a limit to the
-number of possible IDs and they will be reused (oldest
-first) when the limit is exceeded.
-
-The color components are used to find any existing ID
-for the same color however, preventing many individual
-requests for the same color from being assigned unique
-IDs.
+See the description for "My_EmulatorStateTransitionProcPtr".
 
-(4.1)
+(4.0)
 */
-Boolean
-defineTrueColor		(My_ScreenBufferPtr				inDataPtr,
-					 UInt8							inRed,
-					 UInt8							inGreen,
-					 UInt8							inBlue,
-					 TextAttributes_TrueColorID&	outColorID)
+inline UInt32
+invokeEmulatorStateTransitionProc	(My_EmulatorStateTransitionProcPtr	inProc,
+									 My_ScreenBuffer*					inDataPtr,
+									 My_ParserStatePair const&			inOldNew,
+									 Boolean&							outHandled)
 {
-	Boolean		result = false;
-	UInt32		rgbKey = (inBlue | (inGreen << 8) | (inRed << 16));
-	auto&		rgbMap = inDataPtr->emulator.trueColorIDsByRGB;
-	auto		rgbIter = inDataPtr->emulator.trueColorIDsByRGB.find(rgbKey);
+	UInt32		result = 0;
 	
 	
-	if (rgbIter != rgbMap.end())
-	{
-		// the specified R/G/B combination is currently in use
-		// and it has an ID; rather than wasting another ID,
-		// return the existing ID
-		outColorID = rgbIter->second;
-		result = true;
-	}
-	else if (nullptr != inDataPtr->emulator.trueColorTableReds)
+	outHandled = true; // initially...
+	result = (*inProc)(inDataPtr, inOldNew, outHandled);
+	
+	if (outHandled)
 	{
-		outColorID = inDataPtr->emulator.trueColorTableNextID;
+		Boolean const	kIsLogged = ((DebugInterface_LogsTerminalEcho() && (kMy_ParserStateAccumulateForEcho == inOldNew.second)) ||
+										(DebugInterface_LogsTerminalState() && (kMy_ParserStateAccumulateForEcho != inOldNew.second)));
 		
-		if (inDataPtr->emulator.trueColorTableReds->size() <= kTextAttributes_TrueColorIDMaximum)
-		{
-			// table is not yet big enough; allocate more space
-			inDataPtr->emulator.trueColorTableReds->push_back(inRed);
-			inDataPtr->emulator.trueColorTableGreens->push_back(inGreen);
-			inDataPtr->emulator.trueColorTableBlues->push_back(inBlue);
-			if (inDataPtr->emulator.trueColorTableNextID == kTextAttributes_TrueColorIDMaximum)
-			{
-				// table has reached its maximum size; next one will overwrite
-				inDataPtr->emulator.trueColorTableNextID = 0;
-			}
-			else
-			{
-				// set next ID to match index of next new element
-				inDataPtr->emulator.trueColorTableNextID = STATIC_CAST(inDataPtr->emulator.trueColorTableReds->size(), UInt16);
-			}
-		}
-		else
+		
+		if (kIsLogged)
 		{
-			// table is at maximum size; reuse the already-allocated space
-			(*(inDataPtr->emulator.trueColorTableReds))[inDataPtr->emulator.trueColorTableNextID] = inRed;
-			(*(inDataPtr->emulator.trueColorTableGreens))[inDataPtr->emulator.trueColorTableNextID] = inGreen;
-			(*(inDataPtr->emulator.trueColorTableBlues))[inDataPtr->emulator.trueColorTableNextID] = inBlue;
-			if (kTextAttributes_TrueColorIDMaximum == inDataPtr->emulator.trueColorTableNextID)
-			{
-				inDataPtr->emulator.trueColorTableNextID = 0;
-			}
-			else
-			{
-				++(inDataPtr->emulator.trueColorTableNextID);
-			}
-			
-			// remove any previous RGB mapping to the ID that is being reused
-			// (otherwise, a future request for the previous key color would
-			// continue to return the same ID)
-			auto	iterPair = inDataPtr->emulator.trueColorIDsByRGB.begin();
-			auto	endPairs = inDataPtr->emulator.trueColorIDsByRGB.end();
-			for (; iterPair != endPairs; ++iterPair)
-			{
-				if (outColorID == iterPair->second)
-				{
-					break;
-				}
-			}
-			if (iterPair != endPairs)
-			{
-				inDataPtr->emulator.trueColorIDsByRGB.erase(iterPair);
-			}
+			inDataPtr->debugStateHandlerSequence.push_front(REINTERPRET_CAST(inProc, void const*));
 		}
-		
-		// create a mapping based on the RGB value back to this entry
-		// so that repeated requests for the same color do not exhaust
-		// the limited set of color ID entries
-		rgbMap[rgbKey] = outColorID;
-		
-		result = true;
 	}
 	
 	return result;
-}// defineTrueColor
+}// invokeEmulatorStateTransitionProc
 
 
 /*!
-Uniform interface for freeing the entries in line-lists.
-DO NOT attempt manual memory management, as the scheme
-may need to change over time to address performance and
-sharing of data.
+Locates the screen buffer line that the cursor is on,
+providing an iterator into its list (which may be
+past-the-end, that is, invalid).
 
-For instance, later the semantics of this function may be
-to mark an allocated line as available for reuse (as
-opposed to destroying it here).
+This operation is linear with the size of the visible
+screen area.  Using this routine instead of retaining
+an iterator is recommended, since it is difficult to
+properly synchronize an iterator with cursor movement,
+(frequent) scroll activity and other list modifications.
+Plus, the cursor line iterator only needs to be found
+when data on the cursor line should actually be
+manipulated.
 
-(4.1)
+(3.0)
 */
 void
-deleteLinePtr	(My_ScreenBufferLinePtr&	inoutLinePtr)
+locateCursorLine	(My_ScreenBufferPtr						inDataPtr,
+					 My_ScreenBufferLineList::iterator&		outCursorLine)
 {
-	inoutLinePtr.reset(); // might be shared
-}// deleteLinePtr
+	My_ScreenBufferLineList::size_type const	kMaximumLines = inDataPtr->screenBuffer.size();
+	
+	
+	//assert(inDataPtr->current.cursorY >= 0);
+	assert(inDataPtr->current.cursorY <= kMaximumLines);
+	if (inDataPtr->current.cursorY < INTEGER_DIV_2(kMaximumLines))
+	{
+		// near the top; search from the beginning
+		// (NOTE: linear search is still horrible, but this makes it less horrible)
+		outCursorLine = inDataPtr->screenBuffer.begin();
+		std::advance(outCursorLine, inDataPtr->current.cursorY/* zero-based */);
+	}
+	else
+	{
+		// near the bottom; search from the end
+		// (NOTE: linear search is still horrible, but this makes it less horrible)
+		SInt64 const	kDelta = inDataPtr->current.cursorY/* zero-based */ - kMaximumLines;
+		
+		
+		outCursorLine = inDataPtr->screenBuffer.end();
+		std::advance(outCursorLine, kDelta);
+	}
+}// locateCursorLine
 
 
 /*!
-Treats the specified string as “verbatim”, sending the
-characters wherever they need to go (any open print jobs
-or capture files, the terminal, etc.).
+Locates the screen buffer lines bounding the cursor and
+scrolling activity (as defined by the terminal’s current
+origin setting), providing iterators into the list (each
+of which may be past-the-end, that is, invalid).  See
+also locateScrollingRegionTop().
 
-The given string is also analyzed for words in order to
-support future auto-completion.
+This operation is linear with the size of the visible
+screen area.  Using this routine instead of retaining
+iterators is recommended, since it is difficult to
+properly synchronize an iterator with origin changes,
+(frequent) scroll activity and other list modifications.
+Plus, the scrolling region iterators only need to be
+found rarely, in practice less frequently than most list
+modifications that would invalidate retained iterators.
 
-(4.0)
+(3.0)
 */
 void
-echoCFString	(My_ScreenBufferPtr		inDataPtr,
-				 CFStringRef			inString)
+locateScrollingRegion	(My_ScreenBufferPtr						inDataPtr,
+						 My_ScreenBufferLineList::iterator&		outTopLine,
+						 My_ScreenBufferLineList::iterator&		outPastBottomLine)
 {
-	CFIndex const	kLength = CFStringGetLength(inString);
-	Boolean const	kPrinterOnly = (0 != (inDataPtr->printingModes & kMy_PrintingModePrintController));
+	My_ScreenBufferLineList::size_type const	kMaximumLines = inDataPtr->screenBuffer.size();
 	
 	
-	// append to capture file, if one is open; try to avoid conversion,
-	// but if necessary convert the bytes into a Unicode format
-	if ((nullptr != inDataPtr->captureStream) || (nullptr != inDataPtr->printingStream))
-	{
-		CFStringEncoding const		kDesiredEncoding = kCFStringEncodingUTF8;
-		CFIndex						bytesNeeded = 0;
-		UInt8 const*				bufferReadOnly = REINTERPRET_CAST(CFStringGetCStringPtr(inString, kDesiredEncoding),
-																		UInt8 const*);
-		UInt8*						buffer = nullptr;
-		Boolean						freeBuffer = false;
-		
-		
-		if (nullptr != bufferReadOnly)
-		{
-			bytesNeeded = CPP_STD::strlen(REINTERPRET_CAST(bufferReadOnly, char const*));
-		}
-		else
-		{
-			CFIndex		conversionResult = CFStringGetBytes(inString, CFRangeMake(0, kLength),
-															kDesiredEncoding, '?'/* loss byte */,
-															true/* is external representation */,
-															nullptr/* buffer; do not use, just find size */, 0/* buffer size, ignored */,
-															&bytesNeeded);
-			
-			
-			if (conversionResult > 0)
-			{
-				buffer = new UInt8[bytesNeeded];
-				freeBuffer = true;
-				
-				conversionResult = CFStringGetBytes(inString, CFRangeMake(0, kLength),
-													kDesiredEncoding, '?'/* loss byte */,
-													true/* is external representation */,
-													buffer, bytesNeeded, &bytesNeeded);
-				assert(conversionResult > 0);
-				
-				bufferReadOnly = buffer;
-			}
-		}
-		
-		if (nullptr != bufferReadOnly)
-		{
-			if ((false == kPrinterOnly) && (nullptr != inDataPtr->captureStream))
-			{
-				StreamCapture_WriteUTF8Data(inDataPtr->captureStream, bufferReadOnly, bytesNeeded);
-			}
-			if (nullptr != inDataPtr->printingStream)
-			{
-				StreamCapture_WriteUTF8Data(inDataPtr->printingStream, bufferReadOnly, bytesNeeded);
-			}
-		}
-		
-		if (freeBuffer)
-		{
-			delete [] buffer, buffer = nullptr;
-		}
-	}
+	//assert(inDataPtr->customScrollingRegion.firstRow >= 0);
+	assertScrollingRegion(inDataPtr);
 	
-	// add each character to the terminal at the current cursor position, advancing
-	// the cursor each time (and therefore being mindful of wrap settings, etc.)
-	if (false == kPrinterOnly)
+	// find top line iterator in screen
+	outTopLine = inDataPtr->screenBuffer.begin();
+	std::advance(outTopLine, inDataPtr->customScrollingRegion.firstRow/* zero-based */);
+	
+#if 0
+	// slow, but definitely correct
+	outPastBottomLine = inDataPtr->screenBuffer.begin();
+	std::advance(outPastBottomLine, 1 + inDataPtr->customScrollingRegion.lastRow/* zero-based */);
+#else
 	{
-		__block My_ScreenBufferLineList::iterator	cursorLineIterator;
-		__block SInt16								preWriteCursorX = inDataPtr->current.cursorX;
-		__block My_ScreenRowIndex					preWriteCursorY = inDataPtr->current.cursorY;
-		
+		// note the region boundary is inclusive but past-the-end is exclusive;
+		// also, for efficiency, assume this will be much closer to the end and
+		// advance backwards to save some pointer iterations
+		SInt64 const	kDelta = inDataPtr->customScrollingRegion.lastRow/* zero-based */ - kMaximumLines + 1/* past-end */;
 		
-		// WARNING: This is done once here, for efficiency, and is only
-		//          repeated below if the cursor actually moves vertically
-		//          (as evidenced by some moveCursor...() call that would
-		//          affect the cursor row).  Keep this in sync!!!
-		locateCursorLine(inDataPtr, cursorLineIterator);
-		StringUtilities_ForEachComposedCharacterSequenceInRange
-		(inString, CFRangeMake(0, kLength),
-		^(CFStringRef	aSubstring,
-		  CFRange		UNUSED_ARGUMENT(aRange),
-		  Boolean&		UNUSED_ARGUMENT(outStopFlag))
-		{
-		#if 0
-			// debug
-			{
-				Console_WriteValueCFString("echo character: glyph", aSubstring);
-			}
-		#endif
-			
-			// if the cursor was about to wrap on the previous
-			// write, perform that wrap now
-			if (inDataPtr->wrapPending)
-			{
-				// autowrap to start of next line
-				moveCursorLeftToEdge(inDataPtr);
-				moveCursorDownOrScroll(inDataPtr);
-				locateCursorLine(inDataPtr, cursorLineIterator); // cursor changed rows...
-				
-				// reset column tracker
-				preWriteCursorX = 0;
-			}
-			
-			// write characters on a single line
-			if (inDataPtr->modeInsertNotReplace)
-			{
-				bufferInsertBlanksAtCursorColumnWithoutUpdate(inDataPtr, 1/* number of blank characters */, kMy_AttributeRuleInitialize);
-			}
-			translateCell(inDataPtr, (*cursorLineIterator), StringUtilities_Cell(inDataPtr->current.cursorX), aSubstring, inDataPtr->current.drawingAttributes);
-			
-			if (false == inDataPtr->wrapPending)
-			{
-				if (inDataPtr->current.cursorX < (inDataPtr->current.returnNumberOfColumnsPermitted() - 1))
-				{
-					// advance the cursor position
-					moveCursorRight(inDataPtr);
-				}
-				else
-				{
-					// hit right margin
-					if (inDataPtr->modeAutoWrap)
-					{
-						// the cursor just arrived here, so set up a pending
-						// wrap-and-scroll; it will only occur the next time
-						// data is actually written
-						inDataPtr->wrapPending = true;
-					}
-					else
-					{
-						// stay at right margin
-						moveCursorRightToEdge(inDataPtr);
-					}
-				}
-			}
-		});
 		
-		// end of data; notify of a change (this will cause things like Terminal View updates)
-		{
-			// add the new line of text to the text-change region;
-			// this should trigger things like Terminal View updates
-			Terminal_RangeDescription	range;
-			
-			
-			range.screen = inDataPtr->selfRef;
-			range.firstRow = preWriteCursorY;
-			if (preWriteCursorY != inDataPtr->current.cursorY)
-			{
-				// more than one line; just draw all lines completely
-				range.firstColumn = 0;
-				range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
-				range.rowCount = inDataPtr->current.cursorY - preWriteCursorY + 1;
-			}
-			else
-			{
-				range.firstColumn = preWriteCursorX;
-				if (inDataPtr->modeInsertNotReplace)
-				{
-					// invalidate the rest of the line
-					range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted - preWriteCursorX;
-				}
-				else
-				{
-					range.columnCount = inDataPtr->current.cursorX - preWriteCursorX + 1;
-				}
-				range.rowCount = 1;
-			}
-			//Console_WriteValuePair("text changed event: add data starting at row, column", range.firstRow, range.firstColumn);
-			//Console_WriteValuePair("text changed event: add data for #rows, #columns", range.rowCount, range.columnCount);
-			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
-		}
+		outPastBottomLine = inDataPtr->screenBuffer.end();
+		std::advance(outPastBottomLine, kDelta);
 	}
-}// echoCFString
+#endif
+}// locateScrollingRegion
 
 
 /*!
-Erases the characters from the halfway point on the
-screen to the right edge of the specified line,
-clearing all attributes.  NO update events are sent.
+Locates the screen origin line, providing an iterator
+into the list (which may be past-the-end, that is,
+invalid).  See also locateScrollingRegion().
 
-This is required when switching to double-width
-mode, which specifies that the right half of the
-screen data on a double-width line be lost.
+The origin is usually very close to the top of the
+screen buffer, so although this search is technically
+linear, in practice it will not be a slow operation.
 
 (3.0)
 */
 void
-eraseRightHalfOfLine	(My_ScreenBufferPtr		inDataPtr,
-						 My_ScreenBufferLine&	inRow)
+locateScrollingRegionTop	(My_ScreenBufferPtr						inDataPtr,
+							 My_ScreenBufferLineList::iterator&		outTopLine)
 {
-	SInt16										midColumn = STATIC_CAST(INTEGER_DIV_2
-																		(inDataPtr->text.visibleScreen.numberOfColumnsPermitted),
-																			SInt16);
-	CFIndex										midStringIndex = StringUtilities_ReturnCharacterIndexForCell
-																	(inRow.returnCFStringRef(), StringUtilities_Cell(midColumn),
-														 				kStringUtilities_PartialSymbolRulePrevious);
-	CFRange										clearedRange = CFRangeMake(midStringIndex, CFStringGetLength(inRow.returnCFStringRef()) - midStringIndex);
-	TerminalLine_TextAttributesList::iterator	attrIterator;
-	
-	
-	// clear from halfway point to end of line
-	attrIterator = inRow.returnMutableAttributeVector().begin();
-	std::advance(attrIterator, midColumn);
-	inRow.fillWith(CFSTR(" "), clearedRange);
-	std::fill(attrIterator, inRow.returnMutableAttributeVector().end(), inRow.returnGlobalAttributes());
-}// eraseRightHalfOfLine
+	// find top line iterator in screen
+	outTopLine = inDataPtr->screenBuffer.begin();
+	std::advance(outTopLine, inDataPtr->customScrollingRegion.firstRow/* zero-based */);
+}// locateScrollingRegionTop
 
 
 /*!
-Returns a pointer to the internal structure, given a
-reference to it.
+Changes both the row and column of the cursor in
+the specified terminal screen at the same time.
+
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
 
 (3.0)
 */
-inline My_LineIteratorPtr
-getLineIterator		(Terminal_LineRef	inIterator)
+inline void
+moveCursor		(My_ScreenBufferPtr		inDataPtr,
+				 SInt16					inNewX,
+				 My_ScreenRowIndex		inNewY)
 {
-	return REINTERPRET_CAST(inIterator, My_LineIteratorPtr);
-}// getLineIterator
+	moveCursorX(inDataPtr, inNewX);
+	moveCursorY(inDataPtr, inNewY);
+	//Console_WriteValuePair("new cursor x, y", inDataPtr->current.cursorX, inDataPtr->current.cursorY);
+}// moveCursor
 
 
 /*!
-A convenience function that calls getParametersFromStringRange()
-on the "inDataPtr->emulator.stringAccumulator" string’s begin/end,
-which is often where parameter data comes from during parsing. 
+Moves the cursor to the row below its current row.
+
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
 
-(2017.12)
+(3.0)
 */
-void
-getParametersFromStringAccumulator	(My_ScreenBufferPtr								inDataPtr,
-									 ParameterDecoder_StateMachine&					inoutParamDecoder,
-									 std::basic_string< UInt8 >::const_iterator&	outIterChar)
+inline void
+moveCursorDown		(My_ScreenBufferPtr		inDataPtr)
 {
-	getParametersFromStringRange(inDataPtr->emulator.stringAccumulator.begin(),
-									inDataPtr->emulator.stringAccumulator.end(),
-									inoutParamDecoder, outIterChar);
-}// getParametersFromStringAccumulator
+	moveCursorY(inDataPtr, inDataPtr->current.cursorY + 1);
+}// moveCursorDown
 
 
 /*!
-Iterates over the first few characters of the given
-character range until a non-parameter character is found
-(typically this means capturing all numerical values
-delimited by semicolons and stopping at the first
-non-digit, non-semicolon).
-
-Upon return, the state machine object can be used to
-see what was found, such as numerical parameters.
-
-For convenience the iterator’s final value is returned,
-as this is usually vital for understanding what the
-parameters mean.  If this is equal to "inEnd", all the
-given bytes were processed without finding a terminator
-(otherwise, this can be dereferenced to see the start
-of the terminating sequence).
+Moves the cursor to the row below its current row,
+or scrolls up one line if the cursor is already at
+the bottom of the scrolling region.
 
-See also getParametersFromStringAccumulator().
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
 
-(2017.12)
+(3.0)
 */
 void
-getParametersFromStringRange	(std::basic_string< UInt8 >::const_iterator		inBegin,
-								 std::basic_string< UInt8 >::const_iterator		inEnd,
-								 ParameterDecoder_StateMachine&					inoutParamDecoder,
-								 std::basic_string< UInt8 >::const_iterator&	outIterChar)
+moveCursorDownOrScroll	(My_ScreenBufferPtr		inDataPtr)
 {
-	for (outIterChar = inBegin; outIterChar != inEnd; /* incremented below */)
+	if (inDataPtr->current.cursorY == inDataPtr->customScrollingRegion.lastRow)
 	{
-		ParameterDecoder_StateMachine::State const	kOriginalState = inoutParamDecoder.returnState();
-		SInt16										loopGuard = 0;
-		Boolean										byteNotUsed = true;
-		
-		
-		while (byteNotUsed)
-		{
-			inoutParamDecoder.goNextState(*outIterChar, byteNotUsed);
-			if ((byteNotUsed) && (kOriginalState == inoutParamDecoder.returnState()))
-			{
-				// no way to proceed
-				break;
-			}
-			++loopGuard;
-			if (loopGuard > 100/* arbitrary */)
-			{
-				break;
-			}
-		}
-		
-		if (byteNotUsed)
-		{
-			break;
-		}
-		
-		++outIterChar;
+		screenScroll(inDataPtr, +1);
 	}
-}// getParametersFromStringRange
+	else if (inDataPtr->current.cursorY < (inDataPtr->screenBuffer.size() - 1))
+	{
+		moveCursorDown(inDataPtr);
+	}
+}// moveCursorDownOrScroll
 
 
 /*!
-Returns a pointer to the internal structure, given a
-reference to it.
+Moves the cursor to the last row (constrained by
+the current scrolling region).
+
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
 
 (3.0)
 */
-inline My_ScreenBufferPtr
-getVirtualScreenData	(TerminalScreenRef		inScreen)
+inline void
+moveCursorDownToEdge	(My_ScreenBufferPtr		inDataPtr)
 {
-	return REINTERPRET_CAST(inScreen, My_ScreenBufferPtr);
-}// getVirtualScreenData
+	moveCursorY(inDataPtr, inDataPtr->originRegionPtr->lastRow);
+}// moveCursorDownToEdge
 
 
 /*!
-Turns on a specific terminal LED, or turns all LEDs
-off (if 0 is given as the LED number).  The meaning of
-an LED with a specific number is left to the caller.
-
-Currently, only 4 LEDs are defined.  Providing an LED
-number of 5 or greater will have no effect.  These 4
-refer to the user-defined LEDs, so although VT100 (for
-example) defines 3 other LEDs, you can only set the
-user-defined ones with this routine.
+Moves the cursor to the column immediately preceding
+its current column.
 
-Numbers less than zero are reserved.  Probably, they
-will one day be used to turn off specific LEDs.
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
 
 (3.0)
 */
-void
-highlightLED	(My_ScreenBufferPtr		inDataPtr,
-				 SInt16					inOneBasedLEDNumberOrZeroToTurnOffAllLEDs)
+inline void
+moveCursorLeft		(My_ScreenBufferPtr		inDataPtr)
 {
-	switch (inOneBasedLEDNumberOrZeroToTurnOffAllLEDs)
-	{
-	case 0:
-		inDataPtr->litLEDs = kMy_LEDBitsAllOff;
-		break;
-	
-	case 1:
-		inDataPtr->litLEDs |= kMy_LEDBitsLight1;
-		break;
-	
-	case 2:
-		inDataPtr->litLEDs |= kMy_LEDBitsLight2;
-		break;
-	
-	case 3:
-		inDataPtr->litLEDs |= kMy_LEDBitsLight3;
-		break;
-	
-	case 4:
-		inDataPtr->litLEDs |= kMy_LEDBitsLight4;
-		break;
-	
-	default:
-		// ???
-		break;
-	}
-	
-	changeNotifyForTerminal(inDataPtr, kTerminal_ChangeNewLEDState, inDataPtr->selfRef/* context */);
-}// highlightLED
+	moveCursorX(inDataPtr, inDataPtr->current.cursorX - 1);
+}// moveCursorLeft
 
 
 /*!
-Returns a map initialized with keys equal to the function
-pointers used as callbacks, and values for constant strings
-describing those callbacks.  Used in debugging logs.  See
-the internal call gCallbackIDsByFuncPtr().
+Moves the cursor to the first column.
 
-(2017.12)
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
+
+(3.0)
 */
-My_StringByPointer
-initCallbackIDsByFuncPtr ()
+inline void
+moveCursorLeftToEdge	(My_ScreenBufferPtr		inDataPtr)
 {
-	My_StringByPointer		result;
-	
-	
-	// insert descriptions of every available callback (for debugging);
-	// since the context for use already knows the purpose of the
-	// callback, the main important information is the emulator name
-	result[REINTERPRET_CAST(My_DefaultEmulator::stateDeterminant, void const*)] = "Default";
-	result[REINTERPRET_CAST(My_DefaultEmulator::stateTransition, void const*)] = "Default";
-	result[REINTERPRET_CAST(My_DumbTerminal::stateDeterminant, void const*)] = "Dumb";
-	result[REINTERPRET_CAST(My_DumbTerminal::stateTransition, void const*)] = "Dumb";
-	result[REINTERPRET_CAST(My_VT100::stateDeterminant, void const*)] = "VT100";
-	result[REINTERPRET_CAST(My_VT100::stateTransition, void const*)] = "VT100";
-	result[REINTERPRET_CAST(My_VT100::VT52::stateDeterminant, void const*)] = "VT100/VT52";
-	result[REINTERPRET_CAST(My_VT100::VT52::stateTransition, void const*)] = "VT100/VT52";
-	result[REINTERPRET_CAST(My_VT102::stateDeterminant, void const*)] = "VT102";
-	result[REINTERPRET_CAST(My_VT102::stateTransition, void const*)] = "VT102";
-	result[REINTERPRET_CAST(My_VT220::stateDeterminant, void const*)] = "VT220";
-	result[REINTERPRET_CAST(My_VT220::stateTransition, void const*)] = "VT220";
-	result[REINTERPRET_CAST(My_XTerm::stateDeterminant, void const*)] = "XTerm";
-	result[REINTERPRET_CAST(My_XTerm::stateTransition, void const*)] = "XTerm";
-	result[REINTERPRET_CAST(My_XTermCore::stateDeterminant, void const*)] = "XTermCore";
-	result[REINTERPRET_CAST(My_XTermCore::stateTransition, void const*)] = "XTermCore";
-	result[REINTERPRET_CAST(My_ITermCore::stateDeterminant, void const*)] = "ITermCore";
-	result[REINTERPRET_CAST(My_ITermCore::stateTransition, void const*)] = "ITermCore";
-	result[REINTERPRET_CAST(My_SixelCore::stateDeterminant, void const*)] = "SixelCore";
-	result[REINTERPRET_CAST(My_SixelCore::stateTransition, void const*)] = "SixelCore";
-	result[REINTERPRET_CAST(My_UTF8Core::stateDeterminant, void const*)] = "UTF8Core";
-	result[REINTERPRET_CAST(My_UTF8Core::stateTransition, void const*)] = "UTF8Core";
-	
-	return result;
-}// initCallbackIDsByFuncPtr
+	moveCursorX(inDataPtr, 0);
+}// moveCursorLeftToEdge
 
 
 /*!
-See the description for "My_EmulatorStateTransitionProcPtr".
+Moves the cursor to the middle column, but only if
+this is possible by moving left.  In this way, the
+cursor stays put unless it is in the right half of
+the screen.  Useful for implementing double-width
+text mode.
 
-(4.0)
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
+
+(3.0)
 */
-inline UInt32
-invokeEmulatorStateTransitionProc	(My_EmulatorStateTransitionProcPtr	inProc,
-									 My_ScreenBuffer*					inDataPtr,
-									 My_ParserStatePair const&			inOldNew,
-									 Boolean&							outHandled)
+inline void
+moveCursorLeftToHalf	(My_ScreenBufferPtr		inDataPtr)
 {
-	UInt32		result = 0;
-	
+	SInt16		halfway = STATIC_CAST(INTEGER_DIV_2
+										(inDataPtr->text.visibleScreen.numberOfColumnsPermitted),
+											SInt16);
 	
-	outHandled = true; // initially...
-	result = (*inProc)(inDataPtr, inOldNew, outHandled);
 	
-	if (outHandled)
+	if (inDataPtr->current.cursorX >= halfway)
 	{
-		Boolean const	kIsLogged = ((DebugInterface_LogsTerminalEcho() && (kMy_ParserStateAccumulateForEcho == inOldNew.second)) ||
-										(DebugInterface_LogsTerminalState() && (kMy_ParserStateAccumulateForEcho != inOldNew.second)));
-		
-		
-		if (kIsLogged)
-		{
-			inDataPtr->debugStateHandlerSequence.push_front(REINTERPRET_CAST(inProc, void const*));
-		}
+		moveCursorX(inDataPtr, halfway);
 	}
-	
-	return result;
-}// invokeEmulatorStateTransitionProc
+}// moveCursorLeftToHalf
+
+
+/*!
+Moves the cursor in the opposite direction of a
+normal tab, to find the stop that is behind it.
+
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
+
+(3.0)
+*/
+inline void
+moveCursorLeftToNextTabStop	(My_ScreenBufferPtr		inDataPtr)
+{
+	moveCursorX(inDataPtr, inDataPtr->current.cursorX - tabStopGetDistanceFromCursor(inDataPtr, false/* forward */));
+}// moveCursorLeftToNextTabStop
 
 
 /*!
-Locates the screen buffer line that the cursor is on,
-providing an iterator into its list (which may be
-past-the-end, that is, invalid).
+Moves the cursor to the column immediately following
+its current column.
 
-This operation is linear with the size of the visible
-screen area.  Using this routine instead of retaining
-an iterator is recommended, since it is difficult to
-properly synchronize an iterator with cursor movement,
-(frequent) scroll activity and other list modifications.
-Plus, the cursor line iterator only needs to be found
-when data on the cursor line should actually be
-manipulated.
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
 
 (3.0)
 */
-void
-locateCursorLine	(My_ScreenBufferPtr						inDataPtr,
-					 My_ScreenBufferLineList::iterator&		outCursorLine)
+inline void
+moveCursorRight		(My_ScreenBufferPtr		inDataPtr)
 {
-	My_ScreenBufferLineList::size_type const	kMaximumLines = inDataPtr->screenBuffer.size();
-	
-	
-	//assert(inDataPtr->current.cursorY >= 0);
-	assert(inDataPtr->current.cursorY <= kMaximumLines);
-	if (inDataPtr->current.cursorY < INTEGER_DIV_2(kMaximumLines))
-	{
-		// near the top; search from the beginning
-		// (NOTE: linear search is still horrible, but this makes it less horrible)
-		outCursorLine = inDataPtr->screenBuffer.begin();
-		std::advance(outCursorLine, inDataPtr->current.cursorY/* zero-based */);
-	}
-	else
-	{
-		// near the bottom; search from the end
-		// (NOTE: linear search is still horrible, but this makes it less horrible)
-		SInt64 const	kDelta = inDataPtr->current.cursorY/* zero-based */ - kMaximumLines;
-		
-		
-		outCursorLine = inDataPtr->screenBuffer.end();
-		std::advance(outCursorLine, kDelta);
-	}
-}// locateCursorLine
+	moveCursorX(inDataPtr, inDataPtr->current.cursorX + 1);
+}// moveCursorRight
 
 
 /*!
-Locates the screen buffer lines bounding the cursor and
-scrolling activity (as defined by the terminal’s current
-origin setting), providing iterators into the list (each
-of which may be past-the-end, that is, invalid).  See
-also locateScrollingRegionTop().
+Moves the cursor to the last column.
 
-This operation is linear with the size of the visible
-screen area.  Using this routine instead of retaining
-iterators is recommended, since it is difficult to
-properly synchronize an iterator with origin changes,
-(frequent) scroll activity and other list modifications.
-Plus, the scrolling region iterators only need to be
-found rarely, in practice less frequently than most list
-modifications that would invalidate retained iterators.
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
 
 (3.0)
 */
-void
-locateScrollingRegion	(My_ScreenBufferPtr						inDataPtr,
-						 My_ScreenBufferLineList::iterator&		outTopLine,
-						 My_ScreenBufferLineList::iterator&		outPastBottomLine)
+inline void
+moveCursorRightToEdge		(My_ScreenBufferPtr		inDataPtr)
 {
-	My_ScreenBufferLineList::size_type const	kMaximumLines = inDataPtr->screenBuffer.size();
-	
-	
-	//assert(inDataPtr->customScrollingRegion.firstRow >= 0);
-	assertScrollingRegion(inDataPtr);
-	
-	// find top line iterator in screen
-	outTopLine = inDataPtr->screenBuffer.begin();
-	std::advance(outTopLine, inDataPtr->customScrollingRegion.firstRow/* zero-based */);
-	
-#if 0
-	// slow, but definitely correct
-	outPastBottomLine = inDataPtr->screenBuffer.begin();
-	std::advance(outPastBottomLine, 1 + inDataPtr->customScrollingRegion.lastRow/* zero-based */);
-#else
-	{
-		// note the region boundary is inclusive but past-the-end is exclusive;
-		// also, for efficiency, assume this will be much closer to the end and
-		// advance backwards to save some pointer iterations
-		SInt64 const	kDelta = inDataPtr->customScrollingRegion.lastRow/* zero-based */ - kMaximumLines + 1/* past-end */;
-		
-		
-		outPastBottomLine = inDataPtr->screenBuffer.end();
-		std::advance(outPastBottomLine, kDelta);
-	}
-#endif
-}// locateScrollingRegion
+	moveCursorX(inDataPtr, inDataPtr->current.returnNumberOfColumnsPermitted() - 1);
+}// moveCursorRightToEdge
 
 
 /*!
-Locates the screen origin line, providing an iterator
-into the list (which may be past-the-end, that is,
-invalid).  See also locateScrollingRegion().
+Moves the cursor to the next column that has a
+tab stop set for it.
 
-The origin is usually very close to the top of the
-screen buffer, so although this search is technically
-linear, in practice it will not be a slow operation.
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
 
 (3.0)
 */
-void
-locateScrollingRegionTop	(My_ScreenBufferPtr						inDataPtr,
-							 My_ScreenBufferLineList::iterator&		outTopLine)
+inline void
+moveCursorRightToNextTabStop	(My_ScreenBufferPtr		inDataPtr)
 {
-	// find top line iterator in screen
-	outTopLine = inDataPtr->screenBuffer.begin();
-	std::advance(outTopLine, inDataPtr->customScrollingRegion.firstRow/* zero-based */);
-}// locateScrollingRegionTop
+	moveCursorX(inDataPtr, inDataPtr->current.cursorX + tabStopGetDistanceFromCursor(inDataPtr, true/* forward */));
+}// moveCursorRightToNextTabStop
 
 
 /*!
-Changes both the row and column of the cursor in
-the specified terminal screen at the same time.
+Moves the cursor to the row above its current row.
 
 IMPORTANT:	ALWAYS use moveCursor...() routines
 			to set the cursor value; otherwise,
@@ -18220,18 +21857,41 @@ IMPORTANT:	ALWAYS use moveCursor...() routines
 (3.0)
 */
 inline void
-moveCursor		(My_ScreenBufferPtr		inDataPtr,
-				 SInt16					inNewX,
-				 My_ScreenRowIndex		inNewY)
+moveCursorUp	(My_ScreenBufferPtr		inDataPtr)
 {
-	moveCursorX(inDataPtr, inNewX);
-	moveCursorY(inDataPtr, inNewY);
-	//Console_WriteValuePair("new cursor x, y", inDataPtr->current.cursorX, inDataPtr->current.cursorY);
-}// moveCursor
+	moveCursorY(inDataPtr, inDataPtr->current.cursorY - 1);
+}// moveCursorUp
 
 
 /*!
-Moves the cursor to the row below its current row.
+Moves the cursor to the row above its current row,
+or scrolls down one line if the cursor is already
+at the top of the scrolling region.
+
+IMPORTANT:	ALWAYS use moveCursor...() routines
+			to set the cursor value; otherwise,
+			cursor-dependent stuff could become
+			out of sync.
+
+(3.0)
+*/
+void
+moveCursorUpOrScroll	(My_ScreenBufferPtr		inDataPtr)
+{
+	if (inDataPtr->current.cursorY == inDataPtr->customScrollingRegion.firstRow)
+	{
+		screenScroll(inDataPtr, -1);
+	}
+	else
+	{
+		moveCursorUp(inDataPtr);
+	}
+}// moveCursorUpOrScroll
+
+
+/*!
+Moves the cursor to the first row (constrained by
+the current scrolling region).
 
 IMPORTANT:	ALWAYS use moveCursor...() routines
 			to set the cursor value; otherwise,
@@ -18241,792 +21901,1613 @@ IMPORTANT:	ALWAYS use moveCursor...() routines
 (3.0)
 */
 inline void
-moveCursorDown		(My_ScreenBufferPtr		inDataPtr)
+moveCursorUpToEdge	(My_ScreenBufferPtr		inDataPtr)
 {
-	moveCursorY(inDataPtr, inDataPtr->current.cursorY + 1);
-}// moveCursorDown
+	moveCursorY(inDataPtr, inDataPtr->originRegionPtr->firstRow);
+}// moveCursorUpToEdge
+
+
+/*!
+Changes the column of the cursor, within the boundaries of
+the screen.  All cursor-dependent data is automatically
+synchronized if necessary.
+
+This has no effect if print controller mode (VT102 or later)
+is active.
+
+IMPORTANT:	ALWAYS use moveCursor...() routines to set the
+			cursor value; otherwise, cursor-dependent stuff
+			could become out of sync.
+
+(3.0)
+*/
+inline void
+moveCursorX		(My_ScreenBufferPtr		inDataPtr,
+				 SInt16					inNewX)
+{
+	if (0 == (inDataPtr->printingModes & kMy_PrintingModePrintController))
+	{
+		// arbitrarily check the state of password mode whenever the cursor
+		// moves to a different column (TEMPORARY; may need a more intelligent
+		// way to check this, such as a periodic timer?)
+		{
+			Boolean		currentPasswordMode = Session_IsInPasswordMode(inDataPtr->listeningSession);
+			
+			
+			if (currentPasswordMode != inDataPtr->passwordMode)
+			{
+				inDataPtr->passwordMode = currentPasswordMode;
+				// do not notify; change-location notification occurs below
+				//changeNotifyForTerminal(inDataPtr, kTerminal_ChangeCursorState, inDataPtr->selfRef);
+			}
+		}
+		
+		if ((inDataPtr->mayNeedToSaveToScrollback) && (inNewX != 0))
+		{
+			// once the cursor leaves the home position, there is no
+			// chance of having to save the top line into scrollback
+			inDataPtr->mayNeedToSaveToScrollback = false;
+		}
+		inDataPtr->current.cursorX = inNewX;
+		if ((inDataPtr->current.cursorX == 0) && (inDataPtr->current.cursorY == 0))
+		{
+			// if the cursor moves into the home position, flag this
+			// and prepare to possibly save the line contents if any
+			// subsequent erase commands show up
+			inDataPtr->mayNeedToSaveToScrollback = true;
+		}
+		
+		// TEMPORARY - the inefficiency of this is ugly, but it
+		// is definitely known to work
+		{
+			My_ScreenBufferLineList::iterator	cursorLineIterator;
+			
+			
+			locateCursorLine(inDataPtr, cursorLineIterator);
+			inDataPtr->current.cursorAttributes = (*cursorLineIterator)->returnAttributeRuns().returnAttributesForCell(inDataPtr->current.cursorX);
+		}
+		
+		// reset wrap flag, now that the cursor is moving
+		inDataPtr->wrapPending = false;
+		
+		//if (inDataPtr->cursorVisible)
+		{
+			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeCursorLocation, inDataPtr->selfRef);
+		}
+		
+	#if 0
+		// DEBUG
+		Console_WriteValuePair("cursor trace (dx)", inDataPtr->current.cursorX, inDataPtr->current.cursorY);
+	#endif
+	}
+}// moveCursorX
 
 
-/*!
-Moves the cursor to the row below its current row,
-or scrolls up one line if the cursor is already at
-the bottom of the scrolling region.
+/*!
+Changes the row of the cursor, within the boundaries of the
+screen and any current margins.  All cursor-dependent data is
+automatically synchronized if necessary.
+
+This has no effect if print controller mode (VT102 or later)
+is active.
 
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
+IMPORTANT:	ALWAYS use moveCursor...() routines to set the
+			cursor value; otherwise, cursor-dependent stuff
+			could become out of sync.
 
 (3.0)
 */
-void
-moveCursorDownOrScroll	(My_ScreenBufferPtr		inDataPtr)
+inline void
+moveCursorY		(My_ScreenBufferPtr		inDataPtr,
+				 My_ScreenRowIndex		inNewY)
 {
-	if (inDataPtr->current.cursorY == inDataPtr->customScrollingRegion.lastRow)
-	{
-		screenScroll(inDataPtr, +1);
-	}
-	else if (inDataPtr->current.cursorY < (inDataPtr->screenBuffer.size() - 1))
+	if (0 == (inDataPtr->printingModes & kMy_PrintingModePrintController))
 	{
-		moveCursorDown(inDataPtr);
+		My_ScreenBufferLineList::iterator	cursorLineIterator;
+		
+		
+		locateCursorLine(inDataPtr, cursorLineIterator);
+		
+		if ((inDataPtr->mayNeedToSaveToScrollback) && (0 != inNewY))
+		{
+			// once the cursor leaves the home position, there is no
+			// chance of having to save the top line into scrollback
+			inDataPtr->mayNeedToSaveToScrollback = false;
+		}
+		inDataPtr->current.drawingAttributes.removeAttributes((*cursorLineIterator)->returnGlobalAttributes());
+		
+		// don’t allow the cursor to fall off the screen (in origin
+		// mode, it cannot fall outside the scrolling region)
+		{
+			SInt16		newCursorY = STATIC_CAST(inNewY, SInt16);
+			
+			
+			newCursorY = std::max< SInt16 >(newCursorY, STATIC_CAST(inDataPtr->originRegionPtr->firstRow, SInt16));
+			newCursorY = std::min< SInt16 >(newCursorY, STATIC_CAST(inDataPtr->originRegionPtr->lastRow, SInt16));
+			inDataPtr->current.cursorY = newCursorY;
+		}
+		
+		// cursor has moved, so find the data for its new row
+		locateCursorLine(inDataPtr, cursorLineIterator);
+		
+		inDataPtr->current.drawingAttributes.addAttributes((*cursorLineIterator)->returnGlobalAttributes());
+		if ((0 == inDataPtr->current.cursorY) && (0 == inDataPtr->current.cursorX))
+		{
+			// if the cursor moves into the home position, flag this
+			// and prepare to possibly save the line contents if any
+			// subsequent erase commands show up
+			inDataPtr->mayNeedToSaveToScrollback = true;
+		}
+		
+		inDataPtr->current.cursorAttributes = (*cursorLineIterator)->returnAttributeRuns().returnAttributesForCell(inDataPtr->current.cursorX);
+		
+		// reset wrap flag, now that the cursor is moving
+		inDataPtr->wrapPending = false;
+		
+		//if (inDataPtr->cursorVisible)
+		{
+			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeCursorLocation, inDataPtr->selfRef);
+		}
+		
+	#if 0
+		// DEBUG
+		Console_WriteValuePair("cursor trace (dy)", inDataPtr->current.cursorX, inDataPtr->current.cursorY);
+	#endif
 	}
-}// moveCursorDownOrScroll
+}// moveCursorY
 
 
 /*!
-Moves the cursor to the last row (constrained by
-the current scrolling region).
+Releases every image that this terminal retained (see
+bufferInsertInlineImageWithoutUpdate()) that no line shows
+anymore.  Lines in the scrollback are counted as they are
+added and removed (see My_ScrollbackBuffer::returnImageLineCount())
+and the lines of the screen are checked here.  Once every
+terminal has released an image, the image store is free to
+discard it and reuse the IDs of its segments.
 
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
+This should be called after lines may have been discarded or
+cleared; it does nothing if the terminal has no images.
 
-(3.0)
+(2023.10)
 */
-inline void
-moveCursorDownToEdge	(My_ScreenBufferPtr		inDataPtr)
+void
+releaseUnusedImages		(My_ScreenBufferPtr		inDataPtr)
 {
-	moveCursorY(inDataPtr, inDataPtr->originRegionPtr->lastRow);
-}// moveCursorDownToEdge
+	unless (inDataPtr->emulator.retainedImages.empty())
+	{
+		std::vector< ImageStore_ImageID >	screenImageIDs;
+		
+		
+		for (My_ScreenBufferLinePtr const& kLinePtr : inDataPtr->screenBuffer)
+		{
+			TerminalLine_AttributeRunList const&	kRuns = kLinePtr->returnAttributeRuns();
+			
+			
+			My_ScrollbackBuffer::appendLineImages(kRuns.begin(), kRuns.end(), screenImageIDs);
+		}
+		
+		for (auto toImageID = inDataPtr->emulator.retainedImages.begin();
+				toImageID != inDataPtr->emulator.retainedImages.end(); )
+		{
+			if ((screenImageIDs.end() == std::find(screenImageIDs.begin(), screenImageIDs.end(), *toImageID)) &&
+				(0 == inDataPtr->scrollbackBuffer.returnImageLineCount(*toImageID)))
+			{
+				ImageStore_ReleaseImage(*toImageID);
+				toImageID = inDataPtr->emulator.retainedImages.erase(toImageID);
+			}
+			else
+			{
+				++toImageID;
+			}
+		}
+	}
+}// releaseUnusedImages
 
 
 /*!
-Moves the cursor to the column immediately preceding
-its current column.
+Resets terminal modes to defaults, and (for hard resets) clears
+the screen and returns all settings to factory defaults.
+Also notifies any listeners of reset events.
 
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
+The effect of a soft and hard reset can vary by terminal type.
 
-(3.0)
+(2.6)
 */
-inline void
-moveCursorLeft		(My_ScreenBufferPtr		inDataPtr)
+void
+resetTerminal   (My_ScreenBufferPtr		inDataPtr,
+				 Boolean				inSoftReset)
 {
-	moveCursorX(inDataPtr, inDataPtr->current.cursorX - 1);
-}// moveCursorLeft
+	inDataPtr->customScrollingRegion = inDataPtr->visibleBoundary.rows;
+	assertScrollingRegion(inDataPtr);
+	My_VT100::ansiMode(inDataPtr);
+	//inDataPtr->modeAutoWrap = false; // 3.0 - do not touch the auto-wrap setting
+	inDataPtr->modeCursorKeysForApp = false;
+	inDataPtr->modeApplicationKeys = false;
+	inDataPtr->modeOriginRedefined = false; // also requires cursor homing (below), according to manual
+	inDataPtr->originRegionPtr = &inDataPtr->visibleBoundary.rows;
+	inDataPtr->previous.drawingAttributes = kTextAttributes_Invalid;
+	inDataPtr->current.drawingAttributes.clear();
+	inDataPtr->current.latentAttributes.clear();
+	inDataPtr->modeBracketedPaste = false;
+	inDataPtr->modeInsertNotReplace = false;
+	inDataPtr->modeNewLineOption = false;
+	inDataPtr->emulator.isUTF8Encoding = (kCFStringEncodingUTF8 == inDataPtr->emulator.inputTextEncoding);
+	inDataPtr->emulator.lockUTF8 = false;
+	inDataPtr->emulator.disableShifts = false;
+	inDataPtr->current.characterSetInfoPtr = &inDataPtr->vtG0;
+	inDataPtr->printingModes = 0;
+	inDataPtr->printingEnd();
+	
+	// reset the base emulator, and then (rare) perform any emulator-specific actions
+	inDataPtr->emulator.reset(inSoftReset);
+	invokeEmulatorResetProc(inDataPtr->emulator.currentCallbacks.resetHandler, &inDataPtr->emulator, inSoftReset);
+	
+	unless (inSoftReset)
+	{
+		moveCursor(inDataPtr, 0, 0);
+		bufferEraseVisibleScreen(inDataPtr, inDataPtr->emulator.returnEraseEffectsForNormalUse());
+	}
+	tabStopInitialize(inDataPtr);
+	highlightLED(inDataPtr, 0/* zero means “turn off all LEDs” */);
+	
+	//changeNotifyForTerminal(inDataPtr, kTerminal_ChangePasteMode, inDataPtr->selfRef/* context */); // (not needed)
+	changeNotifyForTerminal(inDataPtr, kTerminal_ChangeReset, inDataPtr->selfRef/* context */);
+}// resetTerminal
 
 
 /*!
-Moves the cursor to the first column.
-
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
+Returns the currently attached SessionRef, or nullptr
+if none is attached.  This is necessary for a small
+number of terminal features that need to report data
+back to a requester (e.g. VT100 Device Attributes).
 
-(3.0)
+(3.1)
 */
-inline void
-moveCursorLeftToEdge	(My_ScreenBufferPtr		inDataPtr)
+SessionRef
+returnListeningSession	(My_ScreenBufferPtr		inDataPtr)
 {
-	moveCursorX(inDataPtr, 0);
-}// moveCursorLeftToEdge
+	return inDataPtr->listeningSession;
+}// returnListeningSession
 
 
 /*!
-Moves the cursor to the middle column, but only if
-this is possible by moving left.  In this way, the
-cursor stays put unless it is in the right half of
-the screen.  Useful for implementing double-width
-text mode.
-
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
+Creates a screen for unit tests, with the given number of
+columns and rows, a scrollback of the given size (small,
+by default) that has a search index, and UTF-8 text
+encoding.  Returns nullptr if the
+screen cannot be created.  Use Terminal_ReleaseScreen()
+when finished with it.
 
-(3.0)
+(2023.10)
 */
-inline void
-moveCursorLeftToHalf	(My_ScreenBufferPtr		inDataPtr)
+TerminalScreenRef
+returnNewTestScreen		(UInt16		inColumnCount,
+						 UInt16		inRowCount,
+						 UInt32		inScrollbackRowCount)
 {
-	SInt16		halfway = STATIC_CAST(INTEGER_DIV_2
-										(inDataPtr->text.visibleScreen.numberOfColumnsPermitted),
-											SInt16);
+	Preferences_ContextWrap		terminalConfig(Preferences_NewContext(Quills::Prefs::TERMINAL),
+												Preferences_ContextWrap::kAlreadyRetained);
+	Preferences_ContextWrap		translationConfig(Preferences_NewContext(Quills::Prefs::TRANSLATION),
+													Preferences_ContextWrap::kAlreadyRetained);
+	UInt32 const				kScrollbackRowCount = inScrollbackRowCount;
+	Boolean const				kSearchIndex = true;
+	TerminalScreenRef			result = nullptr;
 	
 	
-	if (inDataPtr->current.cursorX >= halfway)
+	UNUSED_RETURN(Preferences_Result)Preferences_ContextSetData(terminalConfig.returnRef(), kPreferences_TagTerminalScreenColumns,
+																sizeof(inColumnCount), &inColumnCount);
+	UNUSED_RETURN(Preferences_Result)Preferences_ContextSetData(terminalConfig.returnRef(), kPreferences_TagTerminalScreenRows,
+																sizeof(inRowCount), &inRowCount);
+	UNUSED_RETURN(Preferences_Result)Preferences_ContextSetData(terminalConfig.returnRef(), kPreferences_TagTerminalScreenScrollbackRows,
+																sizeof(kScrollbackRowCount), &kScrollbackRowCount);
+	UNUSED_RETURN(Preferences_Result)Preferences_ContextSetData(terminalConfig.returnRef(), kPreferences_TagTerminalScreenScrollbackSearchIndex,
+																sizeof(kSearchIndex), &kSearchIndex);
+	if (kTerminal_ResultOK == Terminal_NewScreen(terminalConfig.returnRef(), translationConfig.returnRef(), &result))
 	{
-		moveCursorX(inDataPtr, halfway);
+		UNUSED_RETURN(Terminal_Result)Terminal_SetTextEncoding(result, kCFStringEncodingUTF8);
 	}
-}// moveCursorLeftToHalf
+	return result;
+}// returnNewTestScreen
 
 
 /*!
-Moves the cursor in the opposite direction of a
-normal tab, to find the stop that is behind it.
-
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
-
-(3.0)
-*/
-inline void
-moveCursorLeftToNextTabStop	(My_ScreenBufferPtr		inDataPtr)
-{
-	moveCursorX(inDataPtr, inDataPtr->current.cursorX - tabStopGetDistanceFromCursor(inDataPtr, false/* forward */));
-}// moveCursorLeftToNextTabStop
-
+Returns the number of bytes at the start of the given buffer
+that are printable 7-bit ASCII (0x20 through 0x7E), stopping
+at the first C0 control, ESC, DEL or byte with the high bit
+set (a C1 control or part of a multi-byte sequence).
 
-/*!
-Moves the cursor to the column immediately following
-its current column.
+This is used by Terminal_EmulatorProcessData() to skip the
+per-byte parser dispatch for long runs of ordinary text while
+the emulator is accumulating data for echo: no emulator can
+react to bytes in this range in that state, so a run found
+here is equivalent to feeding every byte in one at a time.
 
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
+Where available, vector instructions test 16 or 32 bytes at
+a time; any remainder is scanned one byte at a time.
 
-(3.0)
+(2023.10)
 */
-inline void
-moveCursorRight		(My_ScreenBufferPtr		inDataPtr)
+size_t
+returnPrintableRunLength	(UInt8 const*	inBuffer,
+							 size_t			inLength)
 {
-	moveCursorX(inDataPtr, inDataPtr->current.cursorX + 1);
-}// moveCursorRight
+	size_t		result = 0;
+	
+	
+#if defined(__AVX2__)
+	{
+		// signed comparison: anything below 0x20 is a C0 control and
+		// anything with the high bit set appears negative
+		__m256i const	kSpace = _mm256_set1_epi8(0x20);
+		__m256i const	kDelete = _mm256_set1_epi8(0x7F);
+		
+		
+		while ((inLength - result) >= 32)
+		{
+			__m256i const	kBytes = _mm256_loadu_si256(REINTERPRET_CAST(inBuffer + result, __m256i const*));
+			__m256i const	kBadBytes = _mm256_or_si256(_mm256_cmpgt_epi8(kSpace, kBytes),
+														_mm256_cmpeq_epi8(kBytes, kDelete));
+			UInt32 const	kMask = STATIC_CAST(_mm256_movemask_epi8(kBadBytes), UInt32);
+			
+			
+			if (0 != kMask)
+			{
+				return (result + __builtin_ctz(kMask));
+			}
+			result += 32;
+		}
+	}
+#endif
+#if defined(__SSE2__)
+	{
+		// signed comparison: anything below 0x20 is a C0 control and
+		// anything with the high bit set appears negative
+		__m128i const	kSpace = _mm_set1_epi8(0x20);
+		__m128i const	kDelete = _mm_set1_epi8(0x7F);
+		
+		
+		while ((inLength - result) >= 16)
+		{
+			__m128i const	kBytes = _mm_loadu_si128(REINTERPRET_CAST(inBuffer + result, __m128i const*));
+			__m128i const	kBadBytes = _mm_or_si128(_mm_cmplt_epi8(kBytes, kSpace),
+													_mm_cmpeq_epi8(kBytes, kDelete));
+			UInt32 const	kMask = STATIC_CAST(_mm_movemask_epi8(kBadBytes), UInt32);
+			
+			
+			if (0 != kMask)
+			{
+				return (result + __builtin_ctz(kMask));
+			}
+			result += 16;
+		}
+	}
+#elif defined(__ARM_NEON)
+	{
+		uint8x16_t const	kSpace = vdupq_n_u8(0x20);
+		uint8x16_t const	kDelete = vdupq_n_u8(0x7F);
+		
+		
+		while ((inLength - result) >= 16)
+		{
+			uint8x16_t const	kBytes = vld1q_u8(inBuffer + result);
+			uint8x16_t const	kBadBytes = vorrq_u8(vcltq_u8(kBytes, kSpace), vcgeq_u8(kBytes, kDelete));
+			
+			
+			if (0 != vmaxvq_u8(kBadBytes))
+			{
+				// NEON has no direct equivalent to "movemask" so the
+				// exact position is found by the scalar loop below
+				break;
+			}
+			result += 16;
+		}
+	}
+#endif
+	
+	while ((result < inLength) && (inBuffer[result] >= 0x20) && (inBuffer[result] < 0x7F))
+	{
+		++result;
+	}
+	
+	return result;
+}// returnPrintableRunLength
 
 
 /*!
-Moves the cursor to the last column.
+Like returnPrintableRunLength(), but for UTF-8 input: the
+run may also include any valid multi-byte sequence except
+for the C1 controls (U+0080 through U+009F), which some
+emulators treat as commands.  The run ends before any
+invalid sequence, or a sequence that is incomplete at the
+end of the buffer, so that the decoder in the main loop
+reports errors exactly as before.
 
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
+Validation is done with vector instructions where available
+(see UTF8Decoder_StateMachine::returnValidPrefixLength()).
+Since the caller may find a control character very soon, the
+first window that is validated is small, and the window grows
+for as long as the text remains printable.
 
-(3.0)
+(2023.10)
 */
-inline void
-moveCursorRightToEdge		(My_ScreenBufferPtr		inDataPtr)
+size_t
+returnPrintableUTF8RunLength	(UInt8 const*	inBuffer,
+								 size_t			inLength)
 {
-	moveCursorX(inDataPtr, inDataPtr->current.returnNumberOfColumnsPermitted() - 1);
-}// moveCursorRightToEdge
+	size_t		result = 0;
+	size_t		windowSize = 64; // arbitrary
+	Boolean		isDone = false;
+	
+	
+	while ((false == isDone) && (result < inLength))
+	{
+		size_t const	kValidEnd = (result + UTF8Decoder_StateMachine::returnValidPrefixLength
+											(inBuffer + result, std::min(inLength - result, windowSize)));
+		
+		
+		if (kValidEnd == result)
+		{
+			// invalid or incomplete sequence
+			isDone = true;
+		}
+		
+		while ((false == isDone) && (result < kValidEnd))
+		{
+			if (UTF8Decoder_StateMachine::isSingleByteGlyph(inBuffer[result]))
+			{
+				size_t const	kRunLength = returnPrintableRunLength(inBuffer + result, kValidEnd - result);
+				
+				
+				if (0 == kRunLength)
+				{
+					// C0 control or DEL
+					isDone = true;
+				}
+				result += kRunLength;
+			}
+			else if ((0xC2 == inBuffer[result]) && (inBuffer[result + 1] < 0xA0))
+			{
+				// C1 control
+				isDone = true;
+			}
+			else
+			{
+				// skip the rest of the sequence (known to be valid)
+				do
+				{
+					++result;
+				} while ((result < kValidEnd) && UTF8Decoder_StateMachine::isContinuationByte(inBuffer[result]));
+			}
+		}
+		
+		windowSize = std::min(STATIC_CAST(4096, size_t), 2 * windowSize);
+	}
+	
+	return result;
+}// returnPrintableUTF8RunLength
 
 
 /*!
-Moves the cursor to the next column that has a
-tab stop set for it.
+Appends the visible screen to the scrollback buffer, usually in
+preparation for then blanking the visible screen area.
 
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
+Returns "true" only if successful.
 
 (3.0)
 */
-inline void
-moveCursorRightToNextTabStop	(My_ScreenBufferPtr		inDataPtr)
+Boolean
+screenCopyLinesToScrollback		(My_ScreenBufferPtr		inDataPtr)
 {
-	moveCursorX(inDataPtr, inDataPtr->current.cursorX + tabStopGetDistanceFromCursor(inDataPtr, true/* forward */));
-}// moveCursorRightToNextTabStop
+	Boolean		result = true;
+	
+	
+	if ((inDataPtr->text.scrollback.enabled) &&
+		(inDataPtr->customScrollingRegion == inDataPtr->visibleBoundary.rows))
+	{
+		SInt16 const	kLineCount = STATIC_CAST(inDataPtr->screenBuffer.size(), SInt16);
+		
+		
+		// the topmost screen line becomes the oldest of the new scrollback lines;
+		// since line handles never copy contents, the line data is copied here
+		for (My_ScreenBufferLinePtr const& kScreenLinePtr : inDataPtr->screenBuffer)
+		{
+			My_ScreenBufferLinePtr	newLinePtr = createLinePtr(inDataPtr);
+			
+			
+			if (false == kScreenLinePtr.isDefault())
+			{
+				*newLinePtr = *kScreenLinePtr;
+			}
+			inDataPtr->scrollbackBuffer.pushNewest(newLinePtr);
+		}
+		
+		if (inDataPtr->scrollbackBuffer.size() > inDataPtr->text.scrollback.numberOfRowsPermitted)
+		{
+			inDataPtr->scrollbackBuffer.resize(inDataPtr->text.scrollback.numberOfRowsPermitted);
+		}
+		
+		if (result)
+		{
+			Terminal_ScrollDescription	scrollInfo;
+			
+			
+			bzero(&scrollInfo, sizeof(scrollInfo));
+			scrollInfo.screen = inDataPtr->selfRef;
+			scrollInfo.rowDelta = -kLineCount;
+			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeScrollActivity, &scrollInfo/* context */);
+		}
+	}
+	return result;
+}// screenCopyLinesToScrollback
 
 
 /*!
-Moves the cursor to the row above its current row.
-
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
-
-(3.0)
-*/
-inline void
-moveCursorUp	(My_ScreenBufferPtr		inDataPtr)
-{
-	moveCursorY(inDataPtr, inDataPtr->current.cursorY - 1);
-}// moveCursorUp
+Modifies only the screen buffer, to include the specified
+number of additional lines (at the end).  The new lines are
+cleared.
 
+This is rarely required, because scrolling will rotate the
+oldest lines to the bottom.  However, if the screen buffer
+becomes physically larger, or a screen is being created for
+the first time, this can be useful.
 
-/*!
-Moves the cursor to the row above its current row,
-or scrolls down one line if the cursor is already
-at the top of the scrolling region.
+The resultant lines may share a large memory block.  So, it
+is usually better to invoke this routine once for the number
+of lines you’ll ultimately need, than to invoke it many
+times to add a single line.
 
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
+Returns "true" only if successful.
 
 (3.0)
 */
-void
-moveCursorUpOrScroll	(My_ScreenBufferPtr		inDataPtr)
+Boolean
+screenInsertNewLines	(My_ScreenBufferPtr						inDataPtr,
+						 My_ScreenBufferLineList::size_type		inNumberOfElements)
 {
-	if (inDataPtr->current.cursorY == inDataPtr->customScrollingRegion.firstRow)
-	{
-		screenScroll(inDataPtr, -1);
-	}
-	else
+	Boolean		result = true;
+	
+	
+	//Console_WriteValue("request to insert new lines", inNumberOfElements);
+	if (0 != inNumberOfElements)
 	{
-		moveCursorUp(inDataPtr);
+		My_ScreenBufferLineList::size_type   kOldSize = inDataPtr->screenBuffer.size();
+		
+		
+		// start by allocating more lines if necessary, or freeing unneeded lines
+		inDataPtr->screenBuffer.resize(kOldSize + inNumberOfElements, createLinePtr(inDataPtr));
+		
+		// make sure the cursor line doesn’t fall off the end
+		if (inDataPtr->current.cursorY >= inDataPtr->screenBuffer.size())
+		{
+			moveCursorY(inDataPtr, inDataPtr->screenBuffer.size() - 1);
+		}
+		
+		// stop now if the resize failed
+		if (inDataPtr->screenBuffer.size() != (kOldSize + inNumberOfElements))
+		{
+			// failed to resize!
+			result = false;
+		}
+		else
+		{
+			//Console_WriteValue("append new lines", inNumberOfElements);
+			//Console_WriteValue("final size", inDataPtr->screenBuffer.size());
+		}
 	}
-}// moveCursorUpOrScroll
+	return result;
+}// screenInsertNewLines
 
 
 /*!
-Moves the cursor to the first row (constrained by
-the current scrolling region).
+Removes lines from the top of the screen buffer, to the
+adjacent part of the scrollback buffer, and replaces the
+lost lines with blank ones at the bottom (so that the overall
+screen buffer size is unchanged).
 
-IMPORTANT:	ALWAYS use moveCursor...() routines
-			to set the cursor value; otherwise,
-			cursor-dependent stuff could become
-			out of sync.
+The data structures used for the “new” lines may actually
+exist already, stripped from the oldest lines of the
+scrollback buffer.
+
+Returns "true" only if successful.
+
+See also screenCopyLinesToScrollback().
 
 (3.0)
 */
-inline void
-moveCursorUpToEdge	(My_ScreenBufferPtr		inDataPtr)
+Boolean
+screenMoveLinesToScrollback		(My_ScreenBufferPtr						inDataPtr,
+								 My_ScreenBufferLineList::size_type		inNumberOfElements)
 {
-	moveCursorY(inDataPtr, inDataPtr->originRegionPtr->firstRow);
-}// moveCursorUpToEdge
+	Boolean		result = true;
+	
+	
+	//Console_WriteValue("request to move lines to the scrollback", inNumberOfElements);
+	if (0 != inNumberOfElements)
+	{
+		Boolean		recycleLines = false;
+		
+		
+		// scrolling will be done; figure out whether or not to recycle old lines
+		recycleLines = (!(inDataPtr->text.scrollback.enabled)) ||
+						(!(inDataPtr->scrollbackBuffer.empty()) &&
+							(inDataPtr->scrollbackBuffer.size() >= inDataPtr->text.scrollback.numberOfRowsPermitted));
+		
+		// adjust screen and scrollback buffers appropriately; new lines
+		// will either be rotated in from the oldest scrollback, or
+		// allocated anew; in either case, they'll end up initialized
+		if (recycleLines)
+		{
+			//Console_WriteValue("recycled lines", inNumberOfElements);
+			
+			// get the line destined for the new bottom of the main screen;
+			// either extract it from elsewhere, or allocate a new line
+			for (My_ScreenBufferLineList::size_type i = 0; i < inNumberOfElements; ++i)
+			{
+				// extract the oldest line
+				assert(!inDataPtr->screenBuffer.empty());
+				if (inDataPtr->scrollbackBuffer.empty())
+				{
+					// make the oldest screen line the newest one
+					inDataPtr->screenBuffer.splice(inDataPtr->screenBuffer.end()/* the next newest screen line */,
+													inDataPtr->screenBuffer/* the list to move from */,
+													inDataPtr->screenBuffer.begin()/* the line to move */);
+				}
+				else
+				{
+					My_ScreenBufferLinePtr&		recycledLinePtr = inDataPtr->screenBuffer.front();
+					
+					
+					// make the oldest screen line the newest scrollback line, and
+					// make the oldest scrollback line take its place; the list node
+					// is then moved to become the newest screen line (no allocation)
+					inDataPtr->scrollbackBuffer.pushNewest(recycledLinePtr);
+					inDataPtr->scrollbackBuffer.popOldest(recycledLinePtr);
+					inDataPtr->screenBuffer.splice(inDataPtr->screenBuffer.end()/* the next newest screen line */,
+													inDataPtr->screenBuffer/* the list to move from */,
+													inDataPtr->screenBuffer.begin()/* the line to move */);
+				}
+				
+				// the recycled line may have data in it, so clear it out
+				inDataPtr->screenBuffer.back()->structureInitialize();
+			}
+			
+			//Console_WriteValue("post-recycle scrollback size", inDataPtr->scrollbackBuffer.size());
+		}
+		else
+		{
+			//Console_WriteValue("moved-and-reallocated lines", inNumberOfElements);
+			
+			// make the oldest screen lines the newest scrollback lines, in order
+			// (the topmost screen line is the oldest of the lines being moved)
+			for (My_ScreenBufferLineList::size_type i = 0; ((i < inNumberOfElements) && (false == inDataPtr->screenBuffer.empty())); ++i)
+			{
+				inDataPtr->scrollbackBuffer.pushNewest(inDataPtr->screenBuffer.front());
+				inDataPtr->screenBuffer.pop_front();
+			}
+			
+			if (inDataPtr->scrollbackBuffer.size() > inDataPtr->text.scrollback.numberOfRowsPermitted)
+			{
+				inDataPtr->scrollbackBuffer.resize(inDataPtr->text.scrollback.numberOfRowsPermitted);
+			}
+			
+			//Console_WriteValue("post-move scrollback size", inDataPtr->scrollbackBuffer.size());
+			
+			// allocate new lines
+			try
+			{
+				inDataPtr->screenBuffer.resize(inDataPtr->screenBuffer.size() + inNumberOfElements, createLinePtr(inDataPtr));
+			}
+			catch (std::bad_alloc)
+			{
+				// abort
+				result = false;
+			}
+			
+			//Console_WriteValue("post-allocation screen size", inDataPtr->screenBuffer.size());
+		}
+	}
+	return result;
+}// screenMoveLinesToScrollback
 
 
 /*!
-Changes the column of the cursor, within the boundaries of
-the screen.  All cursor-dependent data is automatically
-synchronized if necessary.
+Rewraps the lines of the main screen to the given number of
+columns: the rows of each logical line (every row of which,
+except the last, is soft-wrapped) are joined and then split
+again at the new width.  The cursor stays on the same cell
+of its logical line.
 
-This has no effect if print controller mode (VT102 or later)
-is active.
+If the new rows do not fit on the screen, rows from the top
+are moved into the scrollback (or discarded if the scrollback
+is disabled); otherwise, rows are added at the bottom.  Rows
+below the cursor that are blank do not count.
 
-IMPORTANT:	ALWAYS use moveCursor...() routines to set the
-			cursor value; otherwise, cursor-dependent stuff
-			could become out of sync.
+Call this before the new width takes effect, and send a
+"kTerminal_ChangeScreenSize" notification afterwards (the
+display is updated for the changed rows).  The scrollback is
+not changed; see scrollbackReflowLines().
 
-(3.0)
+(2023.10)
 */
-inline void
-moveCursorX		(My_ScreenBufferPtr		inDataPtr,
-				 SInt16					inNewX)
+void
+screenReflowLines	(My_ScreenBufferPtr		inDataPtr,
+					 UInt16					inNewColumnCount)
 {
-	if (0 == (inDataPtr->printingModes & kMy_PrintingModePrintController))
+	My_ScreenRowIndex const						kRowCount = inDataPtr->screenBuffer.size();
+	My_ScreenRowIndex const						kCursorRow = inDataPtr->current.cursorY;
+	UInt16 const								kCursorColumn = STATIC_CAST(std::max(inDataPtr->current.cursorX, STATIC_CAST(0, SInt16)), UInt16);
+	std::vector< My_ScreenBufferLinePtr >		originalLines;
+	std::vector< My_ScreenBufferLinePtr > const&	kOriginalLines = originalLines; // for reading without allocating blank lines
+	std::vector< My_ScreenBufferLinePtr >		reflowedLines;
+	std::vector< TerminalLine_Object const* >	groupRows;
+	std::vector< UInt16 >						groupCellCounts;
+	My_ScreenRowIndex							pastLastRow = 0;
+	My_ScreenRowIndex							newCursorRow = kCursorRow;
+	UInt16										newCursorColumn = kCursorColumn;
+	size_t										scrolledRowCount = 0;
+	Boolean										isChanged = false;
+	
+	
+	// take the lines out of the list (its nodes are kept) and
+	// find the last row that has text or is wrapped
+	originalLines.reserve(kRowCount);
+	for (My_ScreenBufferLinePtr& linePtr : inDataPtr->screenBuffer)
 	{
-		// arbitrarily check the state of password mode whenever the cursor
-		// moves to a different column (TEMPORARY; may need a more intelligent
-		// way to check this, such as a periodic timer?)
+		originalLines.emplace_back(createLinePtr(inDataPtr));
+		originalLines.back().swap(linePtr);
+		if ((0 != kOriginalLines.back()->softWrapColumnCount) || (0 != kOriginalLines.back()->returnTrimmedCellCount()))
 		{
-			Boolean		currentPasswordMode = Session_IsInPasswordMode(inDataPtr->listeningSession);
+			pastLastRow = originalLines.size();
+		}
+	}
+	pastLastRow = std::min(std::max(pastLastRow, STATIC_CAST(kCursorRow + 1, My_ScreenRowIndex)), kRowCount);
+	
+	// rewrap each logical line; lines that already fit are moved as-is
+	for (My_ScreenRowIndex groupFirstRow = 0; groupFirstRow < pastLastRow; )
+	{
+		My_ScreenRowIndex	groupPastEndRow = (groupFirstRow + 1);
+		UInt32				cellCount = 0;
+		UInt32				cursorCell = kCursorColumn;
+		Boolean				hasCursor = false;
+		Boolean				isGroupChanged = false;
+		Boolean				isDoubleSize = false;
+		
+		
+		while ((groupPastEndRow < pastLastRow) &&
+				(0 != kOriginalLines[groupPastEndRow - 1]->softWrapColumnCount))
+		{
+			++groupPastEndRow;
+		}
+		hasCursor = ((kCursorRow >= groupFirstRow) && (kCursorRow < groupPastEndRow));
+		
+		groupRows.clear();
+		groupCellCounts.clear();
+		for (My_ScreenRowIndex row = groupFirstRow; row < groupPastEndRow; ++row)
+		{
+			TerminalLine_Object const&	kLine = *(kOriginalLines[row]);
+			UInt16 const				kCellCount = (0 != kLine.softWrapColumnCount)
+														? kLine.softWrapColumnCount
+														: kLine.returnTrimmedCellCount();
 			
 			
-			if (currentPasswordMode != inDataPtr->passwordMode)
+			groupRows.push_back(&kLine);
+			groupCellCounts.push_back(kCellCount);
+			cellCount += kCellCount;
+			isGroupChanged = (isGroupChanged || (((row + 1) < groupPastEndRow)
+													? (kCellCount != inNewColumnCount)
+													: (kCellCount > inNewColumnCount)));
+			isDoubleSize = (isDoubleSize || kLine.returnGlobalAttributes().hasDoubleAny());
+			if (row < kCursorRow)
 			{
-				inDataPtr->passwordMode = currentPasswordMode;
-				// do not notify; change-location notification occurs below
-				//changeNotifyForTerminal(inDataPtr, kTerminal_ChangeCursorState, inDataPtr->selfRef);
+				cursorCell += kCellCount;
 			}
 		}
 		
-		if ((inDataPtr->mayNeedToSaveToScrollback) && (inNewX != 0))
+		if (isGroupChanged && (false == isDoubleSize))
 		{
-			// once the cursor leaves the home position, there is no
-			// chance of having to save the top line into scrollback
-			inDataPtr->mayNeedToSaveToScrollback = false;
+			UInt32		minimumCellCount = 0;
+			
+			
+			if (hasCursor)
+			{
+				// double-width characters may move to the next row, so
+				// the cursor cell is found in terms of the new rows
+				UInt32 const	kTargetCursorCell = My_ScrollbackBuffer::returnReflowTargetCell
+													(groupRows, groupCellCounts, inNewColumnCount, cursorCell);
+				
+				
+				if ((cursorCell > 0) && (cursorCell == cellCount) && (0 == (kTargetCursorCell % inNewColumnCount)))
+				{
+					// the cursor follows text that now fills its last row
+					// exactly, so it waits to wrap (as if just written)
+					newCursorRow = reflowedLines.size() + ((kTargetCursorCell - 1) / inNewColumnCount);
+					newCursorColumn = (inNewColumnCount - 1);
+					inDataPtr->wrapPending = true;
+				}
+				else
+				{
+					newCursorRow = reflowedLines.size() + (kTargetCursorCell / inNewColumnCount);
+					newCursorColumn = STATIC_CAST(kTargetCursorCell % inNewColumnCount, UInt16);
+					minimumCellCount = (cursorCell + 1);
+				}
+			}
+			My_ScrollbackBuffer::reflowRows(groupRows, groupCellCounts, inNewColumnCount,
+											(0 != groupRows.back()->softWrapColumnCount),
+											minimumCellCount, inDataPtr->lineAllocator, reflowedLines);
+			isChanged = true;
 		}
-		inDataPtr->current.cursorX = inNewX;
-		if ((inDataPtr->current.cursorX == 0) && (inDataPtr->current.cursorY == 0))
+		else
 		{
-			// if the cursor moves into the home position, flag this
-			// and prepare to possibly save the line contents if any
-			// subsequent erase commands show up
-			inDataPtr->mayNeedToSaveToScrollback = true;
+			if (hasCursor)
+			{
+				newCursorRow = reflowedLines.size() + (kCursorRow - groupFirstRow);
+				if ((kCursorColumn == inNewColumnCount) && (kCursorColumn == groupCellCounts[kCursorRow - groupFirstRow]))
+				{
+					// the cursor follows text that now fills the row exactly
+					inDataPtr->wrapPending = true;
+				}
+			}
+			for (My_ScreenRowIndex row = groupFirstRow; row < groupPastEndRow; ++row)
+			{
+				reflowedLines.emplace_back(createLinePtr(inDataPtr));
+				reflowedLines.back().swap(originalLines[row]);
+			}
+		}
+		groupFirstRow = groupPastEndRow;
+	}
+	
+	// if the cursor was waiting to wrap but the row now has room,
+	// the next character simply follows the previous one
+	if ((inDataPtr->wrapPending) && ((newCursorColumn + 1) < inNewColumnCount))
+	{
+		++newCursorColumn;
+		inDataPtr->wrapPending = false;
+	}
+	newCursorColumn = std::min(newCursorColumn, STATIC_CAST(inNewColumnCount - 1, UInt16));
+	
+	if (reflowedLines.size() > kRowCount)
+	{
+		// scroll rows off the top, but never the cursor row (if it
+		// would go, rows are removed from the bottom instead)
+		scrolledRowCount = std::min(reflowedLines.size() - kRowCount, newCursorRow);
+		for (size_t i = 0; i < scrolledRowCount; ++i)
+		{
+			if (inDataPtr->text.scrollback.enabled)
+			{
+				inDataPtr->scrollbackBuffer.pushNewest(reflowedLines[i]);
+			}
+		}
+		if (inDataPtr->scrollbackBuffer.size() > inDataPtr->text.scrollback.numberOfRowsPermitted)
+		{
+			inDataPtr->scrollbackBuffer.resize(inDataPtr->text.scrollback.numberOfRowsPermitted);
 		}
+		reflowedLines.erase(reflowedLines.begin(), reflowedLines.begin() + scrolledRowCount);
+		newCursorRow -= scrolledRowCount;
+	}
+	else
+	{
+		// keep the original blank rows at the bottom (they may have
+		// erased backgrounds, for instance)
+		for (My_ScreenRowIndex row = pastLastRow; ((row < kRowCount) && (reflowedLines.size() < kRowCount)); ++row)
+		{
+			reflowedLines.emplace_back(createLinePtr(inDataPtr));
+			reflowedLines.back().swap(originalLines[row]);
+		}
+	}
+	reflowedLines.resize(kRowCount, createLinePtr(inDataPtr));
+	
+	// put the lines back into the list
+	{
+		auto	toReflowedLinePtr = reflowedLines.begin();
 		
-		// TEMPORARY - the inefficiency of this is ugly, but it
-		// is definitely known to work
+		
+		for (My_ScreenBufferLinePtr& linePtr : inDataPtr->screenBuffer)
 		{
-			My_ScreenBufferLineList::iterator	cursorLineIterator;
+			linePtr.swap(*toReflowedLinePtr);
+			++toReflowedLinePtr;
+		}
+	}
+	moveCursor(inDataPtr, newCursorColumn, newCursorRow);
+	
+	if (isChanged)
+	{
+		if (scrolledRowCount > 0)
+		{
+			Terminal_ScrollDescription	scrollInfo;
 			
 			
-			locateCursorLine(inDataPtr, cursorLineIterator);
-			inDataPtr->current.cursorAttributes = (*cursorLineIterator)->returnAttributeVector()[inDataPtr->current.cursorX];
+			bzero(&scrollInfo, sizeof(scrollInfo));
+			scrollInfo.screen = inDataPtr->selfRef;
+			scrollInfo.rowDelta = -STATIC_CAST(scrolledRowCount, SInt16);
+			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeScrollActivity, &scrollInfo/* context */);
 		}
 		
-		// reset wrap flag, now that the cursor is moving
-		inDataPtr->wrapPending = false;
-		
-		//if (inDataPtr->cursorVisible)
+		// every screen row may have changed
 		{
-			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeCursorLocation, inDataPtr->selfRef);
+			Terminal_RangeDescription	range;
+			
+			
+			bzero(&range, sizeof(range));
+			range.screen = inDataPtr->selfRef;
+			range.firstRow = 0;
+			range.firstColumn = 0;
+			range.columnCount = inNewColumnCount;
+			range.rowCount = STATIC_CAST(kRowCount, SInt64);
+			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range/* context */);
 		}
-		
-	#if 0
-		// DEBUG
-		Console_WriteValuePair("cursor trace (dx)", inDataPtr->current.cursorX, inDataPtr->current.cursorY);
-	#endif
 	}
-}// moveCursorX
+}// screenReflowLines
 
 
 /*!
-Changes the row of the cursor, within the boundaries of the
-screen and any current margins.  All cursor-dependent data is
-automatically synchronized if necessary.
+Removes the specified positive number of rows from the top of the
+scrolling region, or the specified magnitude of rows from the
+bottom when the value is negative.
 
-This has no effect if print controller mode (VT102 or later)
-is active.
+When rows disappear from the top, blank lines appear at the
+bottom.  Lines scrolled off the top are lost unless the terminal
+is set to save them, in which case the lines are inserted into
+the scrollback buffer.
 
-IMPORTANT:	ALWAYS use moveCursor...() routines to set the
-			cursor value; otherwise, cursor-dependent stuff
-			could become out of sync.
+When rows disappear from the bottom, blank lines appear at the
+top.  Lines scrolled off the bottom are lost.
+
+The display is updated.
 
 (3.0)
 */
-inline void
-moveCursorY		(My_ScreenBufferPtr		inDataPtr,
-				 My_ScreenRowIndex		inNewY)
+void
+screenScroll	(My_ScreenBufferPtr		inDataPtr,
+				 SInt16					inLineCount)
 {
-	if (0 == (inDataPtr->printingModes & kMy_PrintingModePrintController))
+	if (inLineCount > 0)
 	{
-		My_ScreenBufferLineList::iterator	cursorLineIterator;
-		
-		
-		locateCursorLine(inDataPtr, cursorLineIterator);
-		
-		if ((inDataPtr->mayNeedToSaveToScrollback) && (0 != inNewY))
-		{
-			// once the cursor leaves the home position, there is no
-			// chance of having to save the top line into scrollback
-			inDataPtr->mayNeedToSaveToScrollback = false;
-		}
-		inDataPtr->current.drawingAttributes.removeAttributes((*cursorLineIterator)->returnGlobalAttributes());
-		
-		// don’t allow the cursor to fall off the screen (in origin
-		// mode, it cannot fall outside the scrolling region)
-		{
-			SInt16		newCursorY = STATIC_CAST(inNewY, SInt16);
-			
-			
-			newCursorY = std::max< SInt16 >(newCursorY, STATIC_CAST(inDataPtr->originRegionPtr->firstRow, SInt16));
-			newCursorY = std::min< SInt16 >(newCursorY, STATIC_CAST(inDataPtr->originRegionPtr->lastRow, SInt16));
-			inDataPtr->current.cursorY = newCursorY;
-		}
-		
-		// cursor has moved, so find the data for its new row
-		locateCursorLine(inDataPtr, cursorLineIterator);
-		
-		inDataPtr->current.drawingAttributes.addAttributes((*cursorLineIterator)->returnGlobalAttributes());
-		if ((0 == inDataPtr->current.cursorY) && (0 == inDataPtr->current.cursorX))
+		// remove lines from the top of the scrolling region,
+		// and possibly save them
+		if (inDataPtr->current.cursorY < inDataPtr->screenBuffer.size())
 		{
-			// if the cursor moves into the home position, flag this
-			// and prepare to possibly save the line contents if any
-			// subsequent erase commands show up
-			inDataPtr->mayNeedToSaveToScrollback = true;
+			if ((inDataPtr->text.scrollback.enabled) &&
+				(inDataPtr->customScrollingRegion == inDataPtr->visibleBoundary.rows))
+			{
+				// scrolling region is entire screen, and lines are being saved off the top
+				UNUSED_RETURN(Boolean)screenMoveLinesToScrollback(inDataPtr, inLineCount);
+				
+				// notify about the scrolling amount; since every screen row
+				// moved up, listeners can move what they already have
+				{
+					Terminal_ScrollDescription	scrollInfo;
+					
+					
+					bzero(&scrollInfo, sizeof(scrollInfo));
+					scrollInfo.screen = inDataPtr->selfRef;
+					scrollInfo.rowDelta = -inLineCount;
+					scrollInfo.screenRowDelta = -inLineCount;
+					changeNotifyForTerminal(inDataPtr, kTerminal_ChangeScrollActivity, &scrollInfo/* context */);
+				}
+				
+				// the rows that appeared at the bottom are the only new text
+				//Console_WriteLine("text changed event: scroll terminal buffer");
+				{
+					Terminal_RangeDescription	range;
+					SInt64 const				kScreenRowCount = (inDataPtr->visibleBoundary.rows.lastRow -
+																	inDataPtr->visibleBoundary.rows.firstRow + 1);
+					SInt64 const				kExposedRowCount = std::min(STATIC_CAST(inLineCount, SInt64), kScreenRowCount);
+					
+					
+					bzero(&range, sizeof(range));
+					range.screen = inDataPtr->selfRef;
+					range.firstRow = kScreenRowCount - kExposedRowCount;
+					range.firstColumn = 0;
+					range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
+					range.rowCount = kExposedRowCount;
+					changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
+				}
+			}
+			else
+			{
+				My_ScreenBufferLineList::iterator	scrollingRegionBegin;
+				
+				
+				// region being scrolled is not entire screen; no saving of lines
+				locateScrollingRegionTop(inDataPtr, scrollingRegionBegin);
+				bufferRemoveLines(inDataPtr, inLineCount, scrollingRegionBegin,
+									inDataPtr->emulator.supportsVariant(My_Emulator::kVariantFlagXTermBCE)
+									? kMy_AttributeRuleCopyLatentBackground
+									: kMy_AttributeRuleInitialize);
+			}
 		}
+	}
+	else if (inLineCount < 0)
+	{
+		// remove lines from the bottom of the scrolling region (they are lost)
+		// and add blank lines at the top
+		My_ScreenBufferLineList::iterator	scrollingRegionBegin;
 		
-		inDataPtr->current.cursorAttributes = (*cursorLineIterator)->returnAttributeVector()[inDataPtr->current.cursorX];
-		
-		// reset wrap flag, now that the cursor is moving
-		inDataPtr->wrapPending = false;
-		
-		//if (inDataPtr->cursorVisible)
-		{
-			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeCursorLocation, inDataPtr->selfRef);
-		}
 		
-	#if 0
-		// DEBUG
-		Console_WriteValuePair("cursor trace (dy)", inDataPtr->current.cursorX, inDataPtr->current.cursorY);
-	#endif
+		locateScrollingRegionTop(inDataPtr, scrollingRegionBegin);
+		bufferInsertBlankLines(inDataPtr, -inLineCount, scrollingRegionBegin/* insertion row */,
+								inDataPtr->emulator.supportsVariant(My_Emulator::kVariantFlagXTermBCE)
+								? kMy_AttributeRuleCopyLatentBackground
+								: kMy_AttributeRuleInitialize);
 	}
-}// moveCursorY
+}// screenScroll
 
 
 /*!
-Resets terminal modes to defaults, and (for hard resets) clears
-the screen and returns all settings to factory defaults.
-Also notifies any listeners of reset events.
+Rewraps some of the scrollback lines that were present when
+the terminal width last changed, notifying listeners if any
+rows changed, and arranges to be called again shortly (on
+the main queue) until all lines are done; see the method
+My_ScrollbackBuffer::continueReflow().
 
-The effect of a soft and hard reset can vary by terminal type.
+Since the newest lines are done first, the first call (made
+while resizing) handles any scrollback rows that are likely
+to be visible, and the rest of a large scrollback follows
+without making the terminal unresponsive.
 
-(2.6)
+(2023.10)
 */
 void
-resetTerminal   (My_ScreenBufferPtr		inDataPtr,
-				 Boolean				inSoftReset)
+scrollbackReflowLines	(My_ScreenBufferPtr		inDataPtr)
 {
-	inDataPtr->customScrollingRegion = inDataPtr->visibleBoundary.rows;
-	assertScrollingRegion(inDataPtr);
-	My_VT100::ansiMode(inDataPtr);
-	//inDataPtr->modeAutoWrap = false; // 3.0 - do not touch the auto-wrap setting
-	inDataPtr->modeCursorKeysForApp = false;
-	inDataPtr->modeApplicationKeys = false;
-	inDataPtr->modeOriginRedefined = false; // also requires cursor homing (below), according to manual
-	inDataPtr->originRegionPtr = &inDataPtr->visibleBoundary.rows;
-	inDataPtr->previous.drawingAttributes = kTextAttributes_Invalid;
-	inDataPtr->current.drawingAttributes.clear();
-	inDataPtr->current.latentAttributes.clear();
-	inDataPtr->modeBracketedPaste = false;
-	inDataPtr->modeInsertNotReplace = false;
-	inDataPtr->modeNewLineOption = false;
-	inDataPtr->emulator.isUTF8Encoding = (kCFStringEncodingUTF8 == inDataPtr->emulator.inputTextEncoding);
-	inDataPtr->emulator.lockUTF8 = false;
-	inDataPtr->emulator.disableShifts = false;
-	inDataPtr->current.characterSetInfoPtr = &inDataPtr->vtG0;
-	inDataPtr->printingModes = 0;
-	inDataPtr->printingEnd();
-	
-	// reset the base emulator, and then (rare) perform any emulator-specific actions
-	inDataPtr->emulator.reset(inSoftReset);
-	invokeEmulatorResetProc(inDataPtr->emulator.currentCallbacks.resetHandler, &inDataPtr->emulator, inSoftReset);
-	
-	unless (inSoftReset)
+	if (inDataPtr->backgroundSearch.count > 0)
 	{
-		moveCursor(inDataPtr, 0, 0);
-		bufferEraseVisibleScreen(inDataPtr, inDataPtr->emulator.returnEraseEffectsForNormalUse());
+		// rewrapping would move rows that are being searched; this
+		// is called again when the search ends (see backgroundSearchEnd())
+	}
+	else if (inDataPtr->scrollbackBuffer.continueReflow())
+	{
+		Terminal_ScrollDescription	scrollInfo;
+		
+		
+		// narrower lines may have pushed the oldest lines out
+		if (inDataPtr->scrollbackBuffer.size() > inDataPtr->text.scrollback.numberOfRowsPermitted)
+		{
+			inDataPtr->scrollbackBuffer.resize(inDataPtr->text.scrollback.numberOfRowsPermitted);
+		}
+		
+		// the number of scrollback rows has changed in some way
+		bzero(&scrollInfo, sizeof(scrollInfo));
+		scrollInfo.screen = inDataPtr->selfRef;
+		scrollInfo.rowDelta = 0;
+		changeNotifyForTerminal(inDataPtr, kTerminal_ChangeScrollActivity, &scrollInfo/* context */);
 	}
-	tabStopInitialize(inDataPtr);
-	highlightLED(inDataPtr, 0/* zero means “turn off all LEDs” */);
 	
-	//changeNotifyForTerminal(inDataPtr, kTerminal_ChangePasteMode, inDataPtr->selfRef/* context */); // (not needed)
-	changeNotifyForTerminal(inDataPtr, kTerminal_ChangeReset, inDataPtr->selfRef/* context */);
-}// resetTerminal
+	if ((inDataPtr->scrollbackBuffer.isReflowPending()) && (false == inDataPtr->text.scrollback.reflowScheduled) &&
+		(0 == inDataPtr->backgroundSearch.count))
+	{
+		TerminalScreenRef const		kScreen = inDataPtr->selfRef;
+		
+		
+		// a short delay allows user input and new data to be
+		// handled between each part of the reflow
+		inDataPtr->text.scrollback.reflowScheduled = true;
+		dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_MSEC), dispatch_get_main_queue(),
+		^{
+			// the terminal may have been destroyed in the meantime
+			if (Terminal_IsValid(kScreen))
+			{
+				My_ScreenBufferPtr	dataPtr = getVirtualScreenData(kScreen);
+				
+				
+				dataPtr->text.scrollback.reflowScheduled = false;
+				scrollbackReflowLines(dataPtr);
+			}
+		});
+	}
+}// scrollbackReflowLines
 
 
 /*!
-Returns the currently attached SessionRef, or nullptr
-if none is attached.  This is necessary for a small
-number of terminal features that need to report data
-back to a requester (e.g. VT100 Device Attributes).
+Searches one chunk of a terminal buffer (see
+Terminal_SearchIncrementally()).  This runs on a thread
+of the shared work pool, at the same time as other
+chunks of the same search.
 
-(3.1)
-*/
-SessionRef
-returnListeningSession	(My_ScreenBufferPtr		inDataPtr)
-{
-	return inDataPtr->listeningSession;
-}// returnListeningSession
+Chunk 0 is the screen and every other chunk is a range
+of up to My_SearchContext::kScrollbackChunkRowCount
+scrollback lines, starting from the newest.
 
+Matches are collected locally and given to the shared
+results queue in batches (see My_SearchResultsQueue).
+The chunk returns early if the search is canceled.
 
-/*!
-Appends the visible screen to the scrollback buffer, usually in
-preparation for then blanking the visible screen area.
+Rows whose text was wrapped automatically are joined
+with the rows that follow, so that matches may span
+several rows; a chunk searches each such line only if
+its first row is in the chunk’s range (even if it then
+reads rows from another chunk, or from the screen).
 
-Returns "true" only if successful.
+WARNING:	As this runs on a preemptable thread, you
+		MUST NOT use thread-unsafe system calls here.
 
-(3.0)
+(2023.10)
 */
-Boolean
-screenCopyLinesToScrollback		(My_ScreenBufferPtr		inDataPtr)
-{
-	Boolean		result = true;
-	
-	
-	if ((inDataPtr->text.scrollback.enabled) &&
-		(inDataPtr->customScrollingRegion == inDataPtr->visibleBoundary.rows))
-	{
-		SInt16 const			kLineCount = STATIC_CAST(inDataPtr->screenBuffer.size(), SInt16);
-		My_ScreenBufferLinePtr	templateLine = createLinePtr();
+void
+searchChunk		(My_SearchContextConstPtr	inContextPtr,
+				 size_t						inChunkIndex,
+				 std::atomic< bool > const&	inIsCanceled)
+{
+	My_SearchPattern const&		kPattern = *(inContextPtr->patternPtr);
+	My_SearchResultsQueue&		resultsQueue = *(inContextPtr->resultsQueuePtr);
+	My_SearchResultsQueue::ChunkResults&	chunkResults = resultsQueue.chunkResults[inChunkIndex]; // IMPORTANT: only use while locked
+	Boolean const				kIsScreen = (0 == inChunkIndex); // else scrollback
+	SInt32 const				kStartRowIndex = (kIsScreen)
+													? 0
+													: STATIC_CAST((inChunkIndex - 1) * My_SearchContext::kScrollbackChunkRowCount, SInt32);
+	SInt32 const				kPastEndRowIndex = (kIsScreen)
+													? STATIC_CAST(inContextPtr->screenLinesPtr->size(), SInt32)
+													: std::min(kStartRowIndex + STATIC_CAST(My_SearchContext::kScrollbackChunkRowCount, SInt32),
+																STATIC_CAST(inContextPtr->screenBufferPtr->scrollbackBuffer.size(), SInt32));
+	SInt32						rowIndex = kStartRowIndex;
+	std::vector< UniChar >		rowCharacters; // reused for rows that cannot be read in place
+	std::vector< UniChar >		logicalLineCharacters; // reused for text that wraps across rows
+	std::vector< CFIndex >		rowStartOffsets; // for each row of the text being searched, offset of its first character
+	std::vector< UniChar >		searchedCharacters; // reused for text that has placeholders removed
+	std::vector< CFIndex >		searchedOffsets; // for each character in "searchedCharacters" (and past the end), offset in the text
+	std::vector< CFRange >		matchRanges; // reused for every line
+	My_SearchResultsQueue::Batch	pendingMatches;
+	
+	
+	for (; ((false == inIsCanceled) && (rowIndex < kPastEndRowIndex)); ++rowIndex)
+	{
+		// deliver matches early if there are a lot of them
+		if (pendingMatches.size() >= My_SearchResultsQueue::kBatchMatchLimit)
+		{
+			pthread_mutex_lock(&resultsQueue.mutex);
+			chunkResults.pendingBatches.emplace_back();
+			chunkResults.pendingBatches.back().swap(pendingMatches);
+			pthread_cond_signal(&resultsQueue.condition);
+			pthread_mutex_unlock(&resultsQueue.mutex);
+			pendingMatches.clear();
+		}
+		
+		// rows are numbered as in Terminal_RangeDescription, so that the
+		// row below any row (even the newest scrollback row) is "row + 1"
+		SInt64 const	kFirstRow = (kIsScreen) ? rowIndex : (-rowIndex - 1);
+		SInt64			lastRow = kFirstRow;
+		UniChar const*	textPtr = nullptr;
+		CFIndex			textLength = 0;
+		UInt16			wrapColumnCount = 0;
+		
+		
+		// a row that continues the text of the previous row is searched
+		// as part of that row (by whichever chunk has the first row)
+		if (searchReturnSoftWrapColumnCount(inContextPtr, kFirstRow - 1) > 0)
+		{
+			continue;
+		}
+		
+		// if there is an index, skip scrollback text that cannot match
+		// without even reading it (the text may wrap onto other rows)
+		if ((nullptr != inContextPtr->searchIndexPtr) && (false == kIsScreen))
+		{
+			My_ScrollbackBuffer const&	kScrollbackBuffer = inContextPtr->screenBufferPtr->scrollbackBuffer;
+			
+			
+			while (searchReturnSoftWrapColumnCount(inContextPtr, lastRow) > 0)
+			{
+				++lastRow;
+			}
+			if ((lastRow < 0) &&
+				(false == inContextPtr->searchIndexPtr->isCandidate
+							(kScrollbackBuffer.returnSequenceNumber(STATIC_CAST(-kFirstRow - 1, My_ScrollbackBuffer::size_type)),
+								kScrollbackBuffer.returnSequenceNumber(STATIC_CAST(-lastRow - 1, My_ScrollbackBuffer::size_type)),
+								inContextPtr->indexTrigrams)))
+			{
+				continue;
+			}
+			lastRow = kFirstRow;
+		}
 		
+		// find the characters of the line, copying them only if necessary
+		textLength = searchReadRow(inContextPtr, kFirstRow, rowCharacters, textPtr);
+		wrapColumnCount = searchReturnSoftWrapColumnCount(inContextPtr, kFirstRow);
+		rowStartOffsets.clear();
+		rowStartOffsets.push_back(0);
+		if (wrapColumnCount > 0)
+		{
+			// the text wraps onto following rows, so the rows are joined
+			// into one logical line that can be searched as a whole (each
+			// row contributes exactly the columns that were in use when it
+			// wrapped, since any trailing spaces are part of the text)
+			logicalLineCharacters.clear();
+			while (wrapColumnCount > 0)
+			{
+				logicalLineCharacters.insert(logicalLineCharacters.end(), textPtr,
+												textPtr + std::min(textLength, STATIC_CAST(wrapColumnCount, CFIndex)));
+				logicalLineCharacters.resize(STATIC_CAST(rowStartOffsets.back() + wrapColumnCount, size_t), ' ');
+				rowStartOffsets.push_back(STATIC_CAST(logicalLineCharacters.size(), CFIndex));
+				++lastRow;
+				textLength = searchReadRow(inContextPtr, lastRow, rowCharacters, textPtr);
+				wrapColumnCount = searchReturnSoftWrapColumnCount(inContextPtr, lastRow);
+			}
+			logicalLineCharacters.insert(logicalLineCharacters.end(), textPtr, textPtr + textLength);
+			textPtr = logicalLineCharacters.data();
+			textLength = STATIC_CAST(logicalLineCharacters.size(), CFIndex);
+		}
 		
-		inDataPtr->scrollbackBuffer.insert(inDataPtr->scrollbackBuffer.begin(), kLineCount/* number of lines */, templateLine);
-		inDataPtr->scrollbackBufferCachedSize += kLineCount;
-		std::copy(inDataPtr->screenBuffer.rbegin(), inDataPtr->screenBuffer.rend(), inDataPtr->scrollbackBuffer.begin());
+		if (0 == textLength)
+		{
+			// do not even try to search blank lines (initial state);
+			// this will save some time, especially in new terminals
+			// that have gigantic unused scrollback buffers
+			continue;
+		}
 		
-		if (inDataPtr->scrollbackBufferCachedSize > inDataPtr->text.scrollback.numberOfRowsPermitted)
+		// the second cell of a double-width character only holds a
+		// placeholder that is not part of the text, so it is removed
+		// before searching (and matches are then translated back into
+		// offsets that count every cell)
+		searchedOffsets.clear();
+		if ((textPtr + textLength) != std::find(textPtr, textPtr + textLength, kTerminal_WideCharacterContinuation))
 		{
-			inDataPtr->scrollbackBuffer.resize(inDataPtr->text.scrollback.numberOfRowsPermitted);
-			inDataPtr->scrollbackBufferCachedSize = inDataPtr->text.scrollback.numberOfRowsPermitted;
+			searchedCharacters.clear();
+			for (CFIndex i = 0; i < textLength; ++i)
+			{
+				if (kTerminal_WideCharacterContinuation != textPtr[i])
+				{
+					searchedCharacters.push_back(textPtr[i]);
+					searchedOffsets.push_back(i);
+				}
+			}
+			searchedOffsets.push_back(textLength);
 		}
 		
-		if (result)
+		// find ALL matches
+		matchRanges.clear();
+		if (searchedOffsets.empty())
 		{
-			Terminal_ScrollDescription	scrollInfo;
+			kPattern.findMatches(textPtr, textLength, matchRanges);
+		}
+		else if (false == searchedCharacters.empty())
+		{
+			kPattern.findMatches(searchedCharacters.data(), STATIC_CAST(searchedCharacters.size(), CFIndex), matchRanges);
+			for (CFRange& matchRange : matchRanges)
+			{
+				CFIndex const	kFirstOffset = searchedOffsets[matchRange.location];
+				
+				
+				matchRange.length = (searchedOffsets[matchRange.location + matchRange.length] - kFirstOffset);
+				matchRange.location = kFirstOffset;
+			}
+		}
+		
+		// translate all results ranges into external form; the
+		// caller understands rows and columns, etc. not offsets
+		// into a giant buffer
+		for (CFRange const& kRange : matchRanges)
+		{
+			CFIndex const				kLastOffset = std::max(kRange.location, kRange.location + kRange.length - 1);
+			auto const					kFirstRowOffset = std::upper_bound(rowStartOffsets.begin(), rowStartOffsets.end(), kRange.location) - 1;
+			auto const					kLastRowOffset = std::upper_bound(kFirstRowOffset, rowStartOffsets.end(), kLastOffset) - 1;
+			Terminal_RangeDescription	textRegion;
 			
 			
-			bzero(&scrollInfo, sizeof(scrollInfo));
-			scrollInfo.screen = inDataPtr->selfRef;
-			scrollInfo.rowDelta = -kLineCount;
-			changeNotifyForTerminal(inDataPtr, kTerminal_ChangeScrollActivity, &scrollInfo/* context */);
+			bzero(&textRegion, sizeof(textRegion));
+			textRegion.screen = inContextPtr->screenBufferPtr->selfRef;
+			textRegion.firstRow = kFirstRow + (kFirstRowOffset - rowStartOffsets.begin());
+			textRegion.firstColumn = STATIC_CAST(kRange.location - *kFirstRowOffset, UInt16);
+			textRegion.columnCount = STATIC_CAST(kRange.length, UInt16);
+			textRegion.rowCount = 1 + (kLastRowOffset - kFirstRowOffset);
+			if (textRegion.rowCount > 1)
+			{
+				// the match continues across a wrap
+				textRegion.lastRowPastEndColumn = STATIC_CAST(kRange.location + kRange.length - *kLastRowOffset, UInt16);
+			}
+			pendingMatches.push_back(textRegion);
 		}
 	}
-	return result;
-}// screenCopyLinesToScrollback
+	
+	// deliver any remaining matches and announce that the chunk is finished
+	pthread_mutex_lock(&resultsQueue.mutex);
+	if (false == pendingMatches.empty())
+	{
+		chunkResults.pendingBatches.emplace_back();
+		chunkResults.pendingBatches.back().swap(pendingMatches);
+	}
+	chunkResults.isFinished = true;
+	pthread_cond_signal(&resultsQueue.condition);
+	pthread_mutex_unlock(&resultsQueue.mutex);
+}// searchChunk
 
 
 /*!
-Modifies only the screen buffer, to include the specified
-number of additional lines (at the end).  The new lines are
-cleared.
+Finds the text of the given row for a search, where rows
+are numbered as in Terminal_RangeDescription (negative for
+the scrollback).  The row must exist.  Returns the number
+of characters, and sets the text pointer to either the
+line storage or the given buffer (if the line had to be
+decoded).  Blank lines have no characters at all.
 
-This is rarely required, because scrolling will rotate the
-oldest lines to the bottom.  However, if the screen buffer
-becomes physically larger, or a screen is being created for
-the first time, this can be useful.
+Since several threads search at once, compacted scrollback
+lines are read directly instead of being restored.
 
-The resultant lines may share a large memory block.  So, it
-is usually better to invoke this routine once for the number
-of lines you’ll ultimately need, than to invoke it many
-times to add a single line.
+(2023.10)
+*/
+CFIndex
+searchReadRow	(My_SearchContextConstPtr		inContextPtr,
+				 SInt64								inRow,
+				 std::vector< UniChar >&			inoutBuffer,
+				 UniChar const*&					outText)
+{
+	My_ScrollbackBuffer const&			kScrollbackBuffer = inContextPtr->screenBufferPtr->scrollbackBuffer; // IMPORTANT: must be "const" (never restores lines)
+	My_ScrollbackBuffer::size_type const	kScrollbackIndex = STATIC_CAST(-inRow - 1, My_ScrollbackBuffer::size_type);
+	My_ScreenBufferLinePtr const&		kLinePtr = (inRow >= 0)
+												? *((*inContextPtr->screenLinesPtr)[STATIC_CAST(inRow, size_t)])
+												: kScrollbackBuffer[kScrollbackIndex];
+	TerminalLine_CompactLine const*		kCompactLinePtr = (inRow >= 0)
+															? nullptr
+															: kScrollbackBuffer.returnCompactLine(kScrollbackIndex);
+	
+	
+	return My_ScrollbackBuffer::returnLineText(kLinePtr, kCompactLinePtr, inoutBuffer, outText);
+}// searchReadRow
 
-Returns "true" only if successful.
 
-(3.0)
+/*!
+Returns the column after which the given row was wrapped
+automatically (see TerminalLine_Object::softWrapColumnCount),
+or zero if the row does not continue on the next row or if
+the row does not exist.  Rows are numbered as they are for
+searchReadRow().
+
+(2023.10)
 */
-Boolean
-screenInsertNewLines	(My_ScreenBufferPtr						inDataPtr,
-						 My_ScreenBufferLineList::size_type		inNumberOfElements)
+UInt16
+searchReturnSoftWrapColumnCount		(My_SearchContextConstPtr		inContextPtr,
+									 SInt64								inRow)
 {
-	Boolean		result = true;
+	My_ScrollbackBuffer const&	kScrollbackBuffer = inContextPtr->screenBufferPtr->scrollbackBuffer; // IMPORTANT: must be "const" (never restores lines)
+	UInt16						result = 0;
 	
 	
-	//Console_WriteValue("request to insert new lines", inNumberOfElements);
-	if (0 != inNumberOfElements)
+	if (inRow >= 0)
 	{
-		My_ScreenBufferLineList::size_type   kOldSize = inDataPtr->screenBuffer.size();
-		
-		
-		// start by allocating more lines if necessary, or freeing unneeded lines
-		inDataPtr->screenBuffer.resize(kOldSize + inNumberOfElements);
-		
-		// make sure the cursor line doesn’t fall off the end
-		if (inDataPtr->current.cursorY >= inDataPtr->screenBuffer.size())
+		if (STATIC_CAST(inRow, size_t) < inContextPtr->screenLinesPtr->size())
 		{
-			moveCursorY(inDataPtr, inDataPtr->screenBuffer.size() - 1);
+			result = (*(*inContextPtr->screenLinesPtr)[STATIC_CAST(inRow, size_t)])->softWrapColumnCount;
 		}
+	}
+	else if (STATIC_CAST(-inRow - 1, My_ScrollbackBuffer::size_type) < kScrollbackBuffer.size())
+	{
+		My_ScrollbackBuffer::size_type const	kScrollbackIndex = STATIC_CAST(-inRow - 1, My_ScrollbackBuffer::size_type);
+		TerminalLine_CompactLine const*			kCompactLinePtr = kScrollbackBuffer.returnCompactLine(kScrollbackIndex);
 		
-		// stop now if the resize failed
-		if (inDataPtr->screenBuffer.size() != (kOldSize + inNumberOfElements))
-		{
-			// failed to resize!
-			result = false;
-		}
-		else
-		{
-			//Console_WriteValue("append new lines", inNumberOfElements);
-			//Console_WriteValue("final size", inDataPtr->screenBuffer.size());
-		}
+		
+		result = (nullptr != kCompactLinePtr)
+					? kCompactLinePtr->returnSoftWrapColumnCount()
+					: kScrollbackBuffer[kScrollbackIndex]->softWrapColumnCount;
+	}
+	
+	// the last row cannot continue anywhere
+	if ((result > 0) && ((inRow + 1) >= STATIC_CAST(inContextPtr->screenLinesPtr->size(), SInt64)))
+	{
+		result = 0;
 	}
 	return result;
-}// screenInsertNewLines
+}// searchReturnSoftWrapColumnCount
 
 
 /*!
-Removes lines from the top of the screen buffer, to the
-adjacent part of the scrollback buffer, and replaces the
-lost lines with blank ones at the bottom (so that the overall
-screen buffer size is unchanged).
+Searches the buffer of a prepared search, using the shared
+work pool, and passes matches to the given block in batches
+(in the order of rows).  The cancel block, if any, is also
+invoked regularly.  Both blocks run on the calling thread,
+and this returns only when every chunk has ended.
 
-The data structures used for the “new” lines may actually
-exist already, stripped from the oldest lines of the
-scrollback buffer.
-
-Returns "true" only if successful.
-
-See also screenCopyLinesToScrollback().
+For background searches, each chunk holds the lock of the
+screen’s background searches while it reads the buffer (see
+backgroundSearchBegin()), and reads nothing if rows have
+been rearranged since the search started.
 
-(3.0)
+(2023.10)
 */
-Boolean
-screenMoveLinesToScrollback		(My_ScreenBufferPtr						inDataPtr,
-								 My_ScreenBufferLineList::size_type		inNumberOfElements)
-{
-	Boolean		result = true;
-	
-	
-	//Console_WriteValue("request to move lines to the scrollback", inNumberOfElements);
-	if (0 != inNumberOfElements)
-	{
-		Boolean		recycleLines = false;
-		
-		
-		// scrolling will be done; figure out whether or not to recycle old lines
-		recycleLines = (!(inDataPtr->text.scrollback.enabled)) ||
-						(!(inDataPtr->scrollbackBuffer.empty()) &&
-							(inDataPtr->scrollbackBufferCachedSize >= inDataPtr->text.scrollback.numberOfRowsPermitted));
-		
-		// adjust screen and scrollback buffers appropriately; new lines
-		// will either be rotated in from the oldest scrollback, or
-		// allocated anew; in either case, they'll end up initialized
-		if (recycleLines)
-		{
-			//Console_WriteValue("recycled lines", inNumberOfElements);
-			
-			// get the line destined for the new bottom of the main screen;
-			// either extract it from elsewhere, or allocate a new line
-			for (My_ScreenBufferLineList::size_type i = 0; i < inNumberOfElements; ++i)
-			{
-				// extract the oldest line
-				assert(!inDataPtr->screenBuffer.empty());
-				if (inDataPtr->scrollbackBuffer.empty())
-				{
-					// make the oldest screen line the newest one
-					inDataPtr->screenBuffer.splice(inDataPtr->screenBuffer.end()/* the next newest screen line */,
-													inDataPtr->screenBuffer/* the list to move from */,
-													inDataPtr->screenBuffer.begin()/* the line to move */);
-				}
-				else
-				{
-					My_ScrollbackBufferLineList::iterator	oldestScrollbackLine;
-					
-					
-					// make the oldest screen line the newest scrollback line
-					inDataPtr->scrollbackBuffer.splice(inDataPtr->scrollbackBuffer.begin()/* the next oldest scrollback line */,
-														inDataPtr->screenBuffer/* the list to move from */,
-														inDataPtr->screenBuffer.begin()/* the line to move */);
-					++(inDataPtr->scrollbackBufferCachedSize);
-					
-					// end() points one past the end, so nudge it back
-					oldestScrollbackLine = inDataPtr->scrollbackBuffer.end();
-					std::advance(oldestScrollbackLine, -1);
-					
-					// make the oldest scrollback line the newest screen line
-					inDataPtr->screenBuffer.splice(inDataPtr->screenBuffer.end()/* the next newest screen line */,
-													inDataPtr->scrollbackBuffer/* the list to move from */,
-													oldestScrollbackLine/* the line to move */);
-					--(inDataPtr->scrollbackBufferCachedSize);
-				}
-				
-				// the recycled line may have data in it, so clear it out
-				inDataPtr->screenBuffer.back()->structureInitialize();
-			}
-			
-			//Console_WriteValue("post-recycle scrollback size (actual)", inDataPtr->scrollbackBuffer.size());
-			//Console_WriteValue("post-recycle scrollback size (cached)", inDataPtr->scrollbackBufferCachedSize);
-		}
-		else
+void
+searchRun	(My_Search&						inoutSearch,
+			 Terminal_SearchResultsBlock	inResultsHandler,
+			 Terminal_SearchCancelBlock		inCancelBlockOrNull)
+{
+	My_SearchContextConstPtr	searchContextPtr = &inoutSearch.context;
+	My_SearchResultsQueue&		resultsQueue = inoutSearch.resultsQueue;
+	size_t const				kChunkCount = resultsQueue.chunkResults.size();
+	WorkPool_JobRef				searchJob = nullptr;
+	CFAbsoluteTime				nextCancelCheckTime = 0;
+	
+	
+	// the screen and every range of scrollback lines are searched
+	// in parallel by the shared work pool, which balances chunks
+	// across all available processor cores
+	searchJob = WorkPool_StartJob(kChunkCount,
+									[searchContextPtr] (size_t inChunkIndex, std::atomic< bool > const& inIsCanceled)
+									{
+										if (searchContextPtr->isInBackground)
+										{
+											My_ScreenBufferPtr	dataPtr = searchContextPtr->screenBufferPtr;
+											
+											
+											UNUSED_RETURN(int)pthread_rwlock_rdlock(&dataPtr->backgroundSearch.lock);
+											if (searchContextPtr->invalidationCount == dataPtr->backgroundSearch.invalidationCount)
+											{
+												searchChunk(searchContextPtr, inChunkIndex, inIsCanceled);
+											}
+											else
+											{
+												std::atomic< bool > const	kIsSkipped(true);
+												
+												
+												// the chunk still announces that it is finished
+												searchChunk(searchContextPtr, inChunkIndex, kIsSkipped);
+											}
+											UNUSED_RETURN(int)pthread_rwlock_unlock(&dataPtr->backgroundSearch.lock);
+										}
+										else
+										{
+											searchChunk(searchContextPtr, inChunkIndex, inIsCanceled);
+										}
+									});
+	
+	// deliver batches of matches as chunks produce them; since every
+	// chunk keeps its own matches until a batch is ready, the lock is
+	// rarely contended; batches from one chunk are held until all
+	// previous chunks are finished, so that rows arrive in order
+	pthread_mutex_lock(&resultsQueue.mutex);
+	nextCancelCheckTime = CFAbsoluteTimeGetCurrent() + (My_SearchResultsQueue::kCancelCheckIntervalMilliseconds / 1000.0);
+	for (size_t deliveringChunk = 0; deliveringChunk < kChunkCount; )
+	{
+		My_SearchResultsQueue::ChunkResults&	chunkResultsRef = resultsQueue.chunkResults[deliveringChunk];
+		
+		
+		if ((nullptr != inCancelBlockOrNull) && (CFAbsoluteTimeGetCurrent() >= nextCancelCheckTime))
 		{
-			//Console_WriteValue("moved-and-reallocated lines", inNumberOfElements);
+			Boolean		stopSearch = false;
 			
-			My_ScreenBufferLineList::iterator	pastLastLineToScroll = inDataPtr->screenBuffer.begin();
-			My_ScreenBufferLineList				movedLines;
 			
+			// this does not depend on any matches being found, so
+			// that a search can be stopped even if it finds nothing
+			pthread_mutex_unlock(&resultsQueue.mutex);
+			stopSearch = inCancelBlockOrNull();
+			pthread_mutex_lock(&resultsQueue.mutex);
+			nextCancelCheckTime = CFAbsoluteTimeGetCurrent() + (My_SearchResultsQueue::kCancelCheckIntervalMilliseconds / 1000.0);
+			if (stopSearch)
+			{
+				// skip all chunks not yet started and ignore other results
+				WorkPool_CancelJob(searchJob);
+				break;
+			}
+		}
+		else if (false == chunkResultsRef.pendingBatches.empty())
+		{
+			My_SearchResultsQueue::Batch	currentBatch;
+			Boolean							stopSearch = false;
 			
-			// find the last line that will remain in the screen buffer
-			std::advance(pastLastLineToScroll, inNumberOfElements);
 			
-			// make the oldest screen lines the newest scrollback lines; since the
-			// “front” scrollback line is adjacent to the “front” screen line, a
-			// single splice is wrong; the lines have to insert in reverse order
-			movedLines.splice(movedLines.begin()/* where to insert */,
-								inDataPtr->screenBuffer/* the list to move from */,
-								inDataPtr->screenBuffer.begin()/* the first line to move */,
-								pastLastLineToScroll/* the first line that will not be moved */);
-			movedLines.reverse();
-			inDataPtr->scrollbackBuffer.splice(inDataPtr->scrollbackBuffer.begin()/* the next oldest scrollback line */,
-												movedLines/* the list to move from */,
-												movedLines.begin(), movedLines.end());
-			inDataPtr->scrollbackBufferCachedSize += movedLines.size();
+			currentBatch.swap(chunkResultsRef.pendingBatches.front());
+			chunkResultsRef.pendingBatches.pop_front();
 			
-			if (inDataPtr->scrollbackBufferCachedSize > inDataPtr->text.scrollback.numberOfRowsPermitted)
+			// the handler runs without the lock so that chunks may continue
+			pthread_mutex_unlock(&resultsQueue.mutex);
+			inResultsHandler(currentBatch, stopSearch);
+			pthread_mutex_lock(&resultsQueue.mutex);
+			if (stopSearch)
 			{
-				inDataPtr->scrollbackBuffer.resize(inDataPtr->text.scrollback.numberOfRowsPermitted);
-				inDataPtr->scrollbackBufferCachedSize = inDataPtr->text.scrollback.numberOfRowsPermitted;
+				// skip all chunks not yet started and ignore other results
+				WorkPool_CancelJob(searchJob);
+				break;
 			}
+		}
+		else if (chunkResultsRef.isFinished)
+		{
+			++deliveringChunk;
+		}
+		else
+		{
+			Boolean		ranChunk = false;
 			
-			//Console_WriteValue("post-move scrollback size (actual)", inDataPtr->scrollbackBuffer.size());
-			//Console_WriteValue("post-move scrollback size (cached)", inDataPtr->scrollbackBufferCachedSize);
 			
-			// allocate new lines
-			try
+			// rather than only waiting, run a chunk on this thread if
+			// no worker has started it; this also guarantees progress
+			// when all workers are busy (for example, with chunks of a
+			// background search that cannot read until the main thread
+			// is idle, which is a problem if the main thread is here)
+			pthread_mutex_unlock(&resultsQueue.mutex);
+			ranChunk = WorkPool_RunPendingChunk(searchJob);
+			pthread_mutex_lock(&resultsQueue.mutex);
+			if (ranChunk)
 			{
-				inDataPtr->screenBuffer.resize(inDataPtr->screenBuffer.size() + inNumberOfElements);
+				// look for results again
 			}
-			catch (std::bad_alloc)
+			else if (nullptr == inCancelBlockOrNull)
 			{
-				// abort
-				result = false;
+				pthread_cond_wait(&resultsQueue.condition, &resultsQueue.mutex);
+			}
+			else
+			{
+				// wake up in time to ask whether the search should stop
+				struct timespec const	kWaitTime = { 0, My_SearchResultsQueue::kCancelCheckIntervalMilliseconds * 1000000L };
+				
+				
+				UNUSED_RETURN(int)pthread_cond_timedwait_relative_np(&resultsQueue.condition, &resultsQueue.mutex, &kWaitTime);
 			}
-			
-			//Console_WriteValue("post-allocation screen size", inDataPtr->screenBuffer.size());
 		}
 	}
-	return result;
-}// screenMoveLinesToScrollback
+	pthread_mutex_unlock(&resultsQueue.mutex);
+	
+	// chunks may still be running (e.g. if the search was stopped)
+	// and they use the queue, so wait for the job to end completely
+	WorkPool_WaitForJob(searchJob);
+}// searchRun
 
 
 /*!
-Removes the specified positive number of rows from the top of the
-scrolling region, or the specified magnitude of rows from the
-bottom when the value is negative.
-
-When rows disappear from the top, blank lines appear at the
-bottom.  Lines scrolled off the top are lost unless the terminal
-is set to save them, in which case the lines are inserted into
-the scrollback buffer.
+Installs (or removes) counting hooks in the default malloc
+zone, so that Terminal_DebugRunThroughputBenchmark() can see
+every allocation made through "malloc", "new" or the default
+Core Foundation allocator.  Allocations by all threads are
+counted while the hooks are installed.
 
-When rows disappear from the bottom, blank lines appear at the
-top.  Lines scrolled off the bottom are lost.
+The zone found first by "malloc_get_all_zones()" is used,
+because "malloc_default_zone()" may return a zone that only
+forwards to it.  Zone structures are read-only on recent
+systems so they are made writable briefly.
 
-The display is updated.
+Returns true only if the hooks were changed.  DEBUGGING USE
+ONLY: this is not safe to do while other threads might be
+calling into the zone’s functions table, and hooks must be
+removed before the original zone is used again.
 
-(3.0)
+(2023.10)
 */
-void
-screenScroll	(My_ScreenBufferPtr		inDataPtr,
-				 SInt16					inLineCount)
+Boolean
+setBenchmarkZoneHooksEnabled	(Boolean	inIsEnabled)
 {
-	if (inLineCount > 0)
+	Boolean				result = false;
+	vm_address_t*		zoneAddresses = nullptr;
+	unsigned int		zoneCount = 0;
+	
+	
+	if ((KERN_SUCCESS == malloc_get_all_zones(mach_task_self(), nullptr/* reader; nullptr for this task */,
+												&zoneAddresses, &zoneCount)) &&
+		(zoneCount > 0))
 	{
-		// remove lines from the top of the scrolling region,
-		// and possibly save them
-		if (inDataPtr->current.cursorY < inDataPtr->screenBuffer.size())
+		malloc_zone_t*		defaultZone = REINTERPRET_CAST(zoneAddresses[0], malloc_zone_t*);
+		
+		
+		if (KERN_SUCCESS == vm_protect(mach_task_self(), REINTERPRET_CAST(defaultZone, vm_address_t), sizeof(malloc_zone_t),
+										false/* set maximum */, (VM_PROT_READ | VM_PROT_WRITE)))
 		{
-			if ((inDataPtr->text.scrollback.enabled) &&
-				(inDataPtr->customScrollingRegion == inDataPtr->visibleBoundary.rows))
+			if (inIsEnabled)
 			{
-				// scrolling region is entire screen, and lines are being saved off the top
-				UNUSED_RETURN(Boolean)screenMoveLinesToScrollback(inDataPtr, inLineCount);
-				
-				// displaying right from top of scrollback buffer; topmost line being shown
-				// has in fact vanished; update the display to show this
-				//Console_WriteLine("text changed event: scroll terminal buffer");
-				{
-					Terminal_RangeDescription	range;
-					
-					
-					range.screen = inDataPtr->selfRef;
-					range.firstRow = 0;
-					range.firstColumn = 0;
-					range.columnCount = inDataPtr->text.visibleScreen.numberOfColumnsPermitted;
-					range.rowCount = inDataPtr->visibleBoundary.rows.lastRow - inDataPtr->visibleBoundary.rows.firstRow + 1;
-					changeNotifyForTerminal(inDataPtr, kTerminal_ChangeTextEdited, &range);
-				}
-				
-				// notify about the scrolling amount
+				gBenchmarkOriginalZone() = *defaultZone;
+				defaultZone->malloc = benchmarkZoneMalloc;
+				defaultZone->calloc = benchmarkZoneCalloc;
+				defaultZone->valloc = benchmarkZoneValloc;
+				defaultZone->realloc = benchmarkZoneRealloc;
+				if (defaultZone->version >= 5)
 				{
-					Terminal_ScrollDescription	scrollInfo;
-					
-					
-					bzero(&scrollInfo, sizeof(scrollInfo));
-					scrollInfo.screen = inDataPtr->selfRef;
-					scrollInfo.rowDelta = -inLineCount;
-					changeNotifyForTerminal(inDataPtr, kTerminal_ChangeScrollActivity, &scrollInfo/* context */);
+					defaultZone->memalign = benchmarkZoneMemalign;
 				}
 			}
 			else
 			{
-				My_ScreenBufferLineList::iterator	scrollingRegionBegin;
-				
-				
-				// region being scrolled is not entire screen; no saving of lines
-				locateScrollingRegionTop(inDataPtr, scrollingRegionBegin);
-				bufferRemoveLines(inDataPtr, inLineCount, scrollingRegionBegin,
-									inDataPtr->emulator.supportsVariant(My_Emulator::kVariantFlagXTermBCE)
-									? kMy_AttributeRuleCopyLatentBackground
-									: kMy_AttributeRuleInitialize);
+				defaultZone->malloc = gBenchmarkOriginalZone().malloc;
+				defaultZone->calloc = gBenchmarkOriginalZone().calloc;
+				defaultZone->valloc = gBenchmarkOriginalZone().valloc;
+				defaultZone->realloc = gBenchmarkOriginalZone().realloc;
+				if (defaultZone->version >= 5)
+				{
+					defaultZone->memalign = gBenchmarkOriginalZone().memalign;
+				}
 			}
+			UNUSED_RETURN(kern_return_t)vm_protect(mach_task_self(), REINTERPRET_CAST(defaultZone, vm_address_t), sizeof(malloc_zone_t),
+													false/* set maximum */, VM_PROT_READ);
+			result = true;
 		}
 	}
-	else if (inLineCount < 0)
-	{
-		// remove lines from the bottom of the scrolling region (they are lost)
-		// and add blank lines at the top
-		My_ScreenBufferLineList::iterator	scrollingRegionBegin;
-		
-		
-		locateScrollingRegionTop(inDataPtr, scrollingRegionBegin);
-		bufferInsertBlankLines(inDataPtr, -inLineCount, scrollingRegionBegin/* insertion row */,
-								inDataPtr->emulator.supportsVariant(My_Emulator::kVariantFlagXTermBCE)
-								? kMy_AttributeRuleCopyLatentBackground
-								: kMy_AttributeRuleInitialize);
-	}
-}// screenScroll
+	
+	return result;
+}// setBenchmarkZoneHooksEnabled
 
 
 /*!
@@ -19064,7 +23545,7 @@ void
 setScrollbackSize	(My_ScreenBufferPtr		inDataPtr,
 					 UInt32					inLineCount)
 {
-	My_ScreenBufferLineList::size_type const	kPreviousScrollbackCount = inDataPtr->scrollbackBufferCachedSize;
+	My_ScrollbackBuffer::size_type const	kPreviousScrollbackCount = inDataPtr->scrollbackBuffer.size();
 	
 	
 	inDataPtr->text.scrollback.numberOfRowsPermitted = inLineCount;
@@ -19088,7 +23569,7 @@ setScrollbackSize	(My_ScreenBufferPtr		inDataPtr,
 	}
 	
 	inDataPtr->scrollbackBuffer.resize(inLineCount);
-	inDataPtr->scrollbackBufferCachedSize = inLineCount;
+	releaseUnusedImages(inDataPtr);
 	
 	// notify listeners that scroll activity has taken place,
 	// though technically no remaining lines have been affected
@@ -19106,12 +23587,13 @@ setScrollbackSize	(My_ScreenBufferPtr		inDataPtr,
 
 /*!
 Changes the number of characters of text per line for a
-screen buffer.  This operation is currently trivial
-because all line arrays are allocated to maximum size
-when a buffer is created, and this simply adjusts the
-percentage of the total that should be usable.  Although,
-this also forces the cursor into the new region, if
-necessary.
+screen buffer.  Lines are only as wide as the widest that
+the screen has been, so a wider screen gives new lines more
+room (existing lines grow as they are changed; see the
+TerminalLine_Allocator class) but a narrower one does not
+release anything.  Text is rewrapped to the new width (see
+the routines screenReflowLines() and scrollbackReflowLines()),
+and the cursor is forced into the new region, if necessary.
 
 IMPORTANT:	This is a low-level routine for internal use;
 			send a "kTerminal_ChangeScreenSize" notification
@@ -19129,10 +23611,8 @@ if the given terminal screen reference is invalid
 if the given number of columns is too small or too large
 
 \retval kTerminal_ResultNotEnoughMemory
-not currently returned because this routine does no memory
-reallocation; however a future implementation might decide
-to reallocate, and if such reallocation fails, this error
-should be returned
+if the screen is wider than before and there is not enough
+memory for new lines of that width (the width is unchanged)
 
 (2.6)
 */
@@ -19146,19 +23626,56 @@ setVisibleColumnCount	(My_ScreenBufferPtr		inPtr,
 	if (nullptr == inPtr) result = kTerminal_ResultInvalidID;
 	else
 	{
+		UInt16		clampedNumberOfCharactersWide = inNewNumberOfCharactersWide;
+		
+		
+		if (clampedNumberOfCharactersWide > Terminal_ReturnAllocatedColumnCount())
+		{
+			// flag an error, but set a reasonable value anyway
+			result = kTerminal_ResultParameterError;
+			clampedNumberOfCharactersWide = Terminal_ReturnAllocatedColumnCount();
+		}
+		
+		// new lines must have room for the new width (existing lines
+		// are enlarged as they are changed)
+		if (clampedNumberOfCharactersWide > inPtr->text.visibleScreen.numberOfColumnsAllocated)
+		{
+			try
+			{
+				inPtr->lineAllocator.setCellCapacity(clampedNumberOfCharactersWide);
+				inPtr->text.visibleScreen.numberOfColumnsAllocated = inPtr->lineAllocator.returnCellCapacity();
+			}
+			catch (std::bad_alloc)
+			{
+				// flag an error, and keep the current width
+				result = kTerminal_ResultNotEnoughMemory;
+				clampedNumberOfCharactersWide = inPtr->text.visibleScreen.numberOfColumnsPermitted;
+			}
+		}
+		
+		// rewrap text to the new width: the main screen immediately
+		// and the scrollback gradually (newest lines first); if the
+		// scrolling region has been changed, a program (such as a
+		// text editor) is arranging the screen and will redraw it
+		if ((clampedNumberOfCharactersWide > 0) &&
+			(clampedNumberOfCharactersWide != inPtr->text.visibleScreen.numberOfColumnsPermitted))
+		{
+			inPtr->scrollbackBuffer.startReflow(clampedNumberOfCharactersWide);
+			if (inPtr->customScrollingRegion == inPtr->visibleBoundary.rows)
+			{
+				screenReflowLines(inPtr, clampedNumberOfCharactersWide);
+			}
+			inPtr->text.visibleScreen.numberOfColumnsPermitted = clampedNumberOfCharactersWide;
+			scrollbackReflowLines(inPtr);
+		}
+		
 		// move cursor, if necessary
 		if (inNewNumberOfCharactersWide <= inPtr->current.cursorX)
 		{
 			moveCursorX(inPtr, inNewNumberOfCharactersWide - 1);
 		}
 		
-		if (inNewNumberOfCharactersWide > Terminal_ReturnAllocatedColumnCount())
-		{
-			// flag an error, but set a reasonable value anyway
-			result = kTerminal_ResultParameterError;
-			inNewNumberOfCharactersWide = Terminal_ReturnAllocatedColumnCount();
-		}
-		inPtr->text.visibleScreen.numberOfColumnsPermitted = inNewNumberOfCharactersWide;
+		inPtr->text.visibleScreen.numberOfColumnsPermitted = clampedNumberOfCharactersWide;
 	}
 	return result;
 }// setVisibleColumnCount
@@ -19287,43 +23804,38 @@ setVisibleRowCount	(My_ScreenBufferPtr		inPtr,
 
 
 /*!
-Returns an autoreleased string that is a substring of the
-given string, keeping all leading whitespace but stopping
-before all trailing whitespace.
+Passes the string that has been accumulated so far to the
+"payloadHandler" of the emulator (if there is one), and then
+empties the accumulator so that its memory is reused for the
+next piece.  This way, a long string (such as image data)
+never occupies more than a piece of memory, no matter how
+large it is.
 
-This is useful when searching, for example, as there is no
-benefit to scanning beyond the text portion of a line.
+Unless this is the final piece, nothing happens until enough
+bytes have been accumulated (see "kMy_PayloadPieceSize"), so
+that the handler is not invoked for every byte.  After the
+final piece, the handler is removed.
 
-TEMPORARY:	Could move this to String Utilities module but
-			that file is pure C++ right now.
-
-(4.1)
+(2023.10)
 */
-CFStringRef
-stringByStrippingEndWhitespace		(CFStringRef	inSourceString)
+void
+streamStringAccumulator		(My_ScreenBufferPtr		inDataPtr,
+							 Boolean				inIsFinal)
 {
-	CFStringRef		result = inSourceString;
+	My_EmulatorPayloadBlock		handler = inDataPtr->emulator.payloadHandler;
 	
 	
-	if (nullptr != inSourceString)
+	if ((nil != handler) &&
+		((inIsFinal) || (inDataPtr->emulator.stringAccumulator.size() >= kMy_PayloadPieceSize)))
 	{
-		CFIndex const		kStringLength = CFStringGetLength(inSourceString);
-		NSCharacterSet*		whitespaceSet = [NSCharacterSet whitespaceAndNewlineCharacterSet];
-		NSString*			asNSString = BRIDGE_CAST(inSourceString, NSString*);
-		NSInteger			i = 0;
-		
-		
-		for (i = (kStringLength - 1);
-				((i >= 0) && [whitespaceSet characterIsMember:[asNSString characterAtIndex:i]]); --i)
+		if (inIsFinal)
 		{
-			// empty loop
+			inDataPtr->emulator.payloadHandler = nil;
 		}
-		
-		result = BRIDGE_CAST([asNSString substringToIndex:(i + 1)], CFStringRef);
+		handler(inDataPtr, inDataPtr->emulator.stringAccumulator.data(), inDataPtr->emulator.stringAccumulator.size(), inIsFinal);
+		inDataPtr->emulator.stringAccumulator.clear();
 	}
-	
-	return result;
-}// stringByStrippingEndWhitespace
+}// streamStringAccumulator
 
 
 /*!
@@ -19359,210 +23871,65 @@ tabStopGetDistanceFromCursor	(My_ScreenBufferConstPtr	inDataPtr,
 {
 	UInt16		result = 0;
 	
-	
-	if (inForwardDirection)
-	{
-		if (inDataPtr->current.cursorX < (inDataPtr->current.returnNumberOfColumnsPermitted() - 1))
-		{
-			result = inDataPtr->current.cursorX + 1;
-			while ((inDataPtr->tabSettings[result] != kMy_TabSet) &&
-					(result < (inDataPtr->current.returnNumberOfColumnsPermitted() - 1)))
-			{
-				++result;
-			}
-			result = (result - inDataPtr->current.cursorX);
-		}
-	}
-	else
-	{
-		if (inDataPtr->current.cursorX > 0)
-		{
-			result = inDataPtr->current.cursorX - 1;
-			while ((inDataPtr->tabSettings[result] != kMy_TabSet) && (result > 0))
-			{
-				--result;
-			}
-			result = (inDataPtr->current.cursorX - result);
-		}
-	}
-	return result;
-}// tabStopGetDistanceFromCursor
-
-
-/*!
-Reset tabs to default stops (one every "kMy_TabStop"
-columns starting at the first column, and one at the
-last column).
-
-(3.0)
-*/
-void
-tabStopInitialize	(My_ScreenBufferPtr		inDataPtr)
-{
-	My_TabStopList::size_type	i = 0;
-	
-	
-	for (auto& tabStopChar : inDataPtr->tabSettings)
-	{
-		if (0 == (i % kMy_TabStop))
-		{
-			tabStopChar = kMy_TabSet;
-		}
-		else
-		{
-			tabStopChar = kMy_TabClear;
-		}
-		++i;
-	}
-	assert(!inDataPtr->tabSettings.empty());
-	inDataPtr->tabSettings.back() = kMy_TabSet; // also make last column a tab
-}// tabStopInitialize
-
-
-/*!
-A POSIX thread (which can be preempted) that handles
-dynamic search for a portion of a terminal buffer.
-
-WARNING:	As this is a preemptable thread, you MUST
-		NOT use thread-unsafe system calls here.
-		On the other hand, you can arrange for
-		events to be handled (e.g. with queues).
-
-(4.1)
-*/
-void*
-threadForTerminalSearch		(void*	inSearchThreadContextPtr)
-{
-	My_SearchThreadContextPtr	contextPtr = REINTERPRET_CAST(inSearchThreadContextPtr, My_SearchThreadContextPtr);
-	Boolean const				kIsScreen = (0 == contextPtr->threadNumber); // else scrollback
-	SInt32 const				kPastEndRowIndex = (contextPtr->startRowIndex + contextPtr->rowCount);
-	SInt32						rowIndex = contextPtr->startRowIndex;
-	
-	
-	for (auto toLine = contextPtr->rangeStart; rowIndex < kPastEndRowIndex; ++toLine, ++rowIndex)
-	{
-		if (toLine->isDefault())
-		{
-			// do not even try to search blank lines (initial state);
-			// this will save some time, especially in new terminals
-			// that have gigantic unused scrollback buffers
-			continue;
-		}
-		
-		// find ALL matches; NOTE that this technically will not find words
-		// that begin at the end of one line and continue at the start of
-		// the next, but that is a known limitation right now (TEMPORARY)
-		My_ScreenBufferLine const&	kLine = **toLine;
-		CFStringRef const			kCFStringToSearch = stringByStrippingEndWhitespace(kLine.returnCFStringRef());
-		std::vector<CFRange>		matchRanges;
-		
-		
-		if (contextPtr->isRegularExpression)
-		{
-			// regular expression string matches
-			NSError* /*__autoreleasing*/	error = nil;
-			NSRegularExpression*			expressionMatcher = [NSRegularExpression
-																	regularExpressionWithPattern:BRIDGE_CAST(contextPtr->queryCFString, NSString*)
-																									options:contextPtr->regExOptions
-																									error:&error];
-			
-			
-			if (nil == expressionMatcher)
-			{
-				Console_Warning(Console_WriteValueCFString, "failed to create regex, error", BRIDGE_CAST([error localizedDescription], CFStringRef));
-			}
-			else
-			{
-				NSArray<NSTextCheckingResult*>*		matchObjects = [expressionMatcher
-																	matchesInString:BRIDGE_CAST(kCFStringToSearch, NSString*)
-																					options:(NSMatchingOptions)0
-																					range:NSMakeRange(0, CFStringGetLength(kCFStringToSearch))];
-				
-				
-				if (nil != matchObjects)
-				{
-					matchRanges.reserve(matchObjects.count);
-					for (NSTextCheckingResult* aMatch in matchObjects)
-					{
-						matchRanges.push_back(CFRangeMake(aMatch.range.location, aMatch.range.length));
-					}
-				}
-				else
-				{
-					Console_Warning(Console_WriteLine, "regular expression not created");
-				}
-			}
-		}
-		else
+	
+	if (inForwardDirection)
+	{
+		if (inDataPtr->current.cursorX < (inDataPtr->current.returnNumberOfColumnsPermitted() - 1))
 		{
-			// literal string matches
-			CFRetainRelease		resultsArray(CFStringCreateArrayWithFindResults
-												(kCFAllocatorDefault, kCFStringToSearch, contextPtr->queryCFString,
-													CFRangeMake(0, CFStringGetLength(kCFStringToSearch)),
-													contextPtr->searchFlags),
-												CFRetainRelease::kAlreadyRetained);
-			CFArrayRef const	kResultsArrayRef = resultsArray.returnCFArrayRef();
-			CFIndex const		kNumberOfMatches = ((nullptr == kResultsArrayRef)
-													? 0
-													: CFArrayGetCount(kResultsArrayRef));
-			
-			
-			matchRanges.reserve(kNumberOfMatches);
-			for (CFIndex i = 0; i < kNumberOfMatches; ++i)
+			result = inDataPtr->current.cursorX + 1;
+			while ((inDataPtr->tabSettings[result] != kMy_TabSet) &&
+					(result < (inDataPtr->current.returnNumberOfColumnsPermitted() - 1)))
 			{
-				CFRange const*		toRange = REINTERPRET_CAST(CFArrayGetValueAtIndex(kResultsArrayRef, i),
-																CFRange const*);
-				
-				
-				matchRanges.push_back(*toRange);
+				++result;
 			}
+			result = (result - inDataPtr->current.cursorX);
 		}
-		
-		if (false == matchRanges.empty())
+	}
+	else
+	{
+		if (inDataPtr->current.cursorX > 0)
 		{
-			// return the range of text that was found
-			
-			// extend the size of the results vector
-			contextPtr->matchesVectorPtr->reserve(contextPtr->matchesVectorPtr->size() + matchRanges.size());
-			
-			// figure out where all the matches are on the screen
-			for (CFRange aRange : matchRanges)
+			result = inDataPtr->current.cursorX - 1;
+			while ((inDataPtr->tabSettings[result] != kMy_TabSet) && (result > 0))
 			{
-				SInt32						firstRow = rowIndex;
-				UInt16						firstColumn = 0;
-				Terminal_RangeDescription	textRegion;
-				
-				
-				// translate all results ranges into external form; the
-				// caller understands rows and columns, etc. not offsets
-				// into a giant buffer
-				firstColumn = STATIC_CAST(aRange.location, UInt16);
-				if (false == kIsScreen)
-				{
-					// translate scrollback into negative coordinates (zero-based)
-					firstRow = -firstRow - 1;
-				}
-				bzero(&textRegion, sizeof(textRegion));
-				textRegion.screen = contextPtr->screenBufferPtr->selfRef;
-				textRegion.firstRow = firstRow;
-				textRegion.firstColumn = firstColumn;
-				textRegion.columnCount = STATIC_CAST(aRange.length, UInt16);
-				textRegion.rowCount = 1;
-				contextPtr->matchesVectorPtr->push_back(textRegion);
+				--result;
 			}
+			result = (inDataPtr->current.cursorX - result);
+		}
+	}
+	return result;
+}// tabStopGetDistanceFromCursor
+
+
+/*!
+Reset tabs to default stops (one every "kMy_TabStop"
+columns starting at the first column, and one at the
+last column).
+
+(3.0)
+*/
+void
+tabStopInitialize	(My_ScreenBufferPtr		inDataPtr)
+{
+	My_TabStopList::size_type	i = 0;
+	
+	
+	for (auto& tabStopChar : inDataPtr->tabSettings)
+	{
+		if (0 == (i % kMy_TabStop))
+		{
+			tabStopChar = kMy_TabSet;
 		}
 		else
 		{
-			// text was not found
-			//Console_WriteLine("string not found");
+			tabStopChar = kMy_TabClear;
 		}
+		++i;
 	}
-	
-	// since the thread is finished, dispose of dynamically-allocated memory
-	delete contextPtr;
-	
-	return nullptr;
-}// threadForTerminalSearch
+	assert(!inDataPtr->tabSettings.empty());
+	inDataPtr->tabSettings.back() = kMy_TabSet; // also make last column a tab
+}// tabStopInitialize
+
 
 
 /*!
@@ -19586,26 +23953,24 @@ requesting translation.
 In most cases, the cell will simply copy the given text
 and attributes to the buffer without making any changes.
 
+The character is given as a Unicode value so that the
+direct echo path (see echoBytesDirectly()) never has to
+create string objects; no allocation occurs here.
+
 (2021.07)
 */
 inline void
 translateCell	(My_ScreenBufferPtr			inDataPtr,
 				 My_ScreenBufferLinePtr&	inoutUpdatedTerminalLinePtr, // note: using "&" due to TerminalLine_Handle wrapper object type
 				 StringUtilities_Cell		inFirstUpdatedCell,
-				 CFStringRef				inCellCharacter,
+				 UnicodeScalarValue			inCellCharacter,
 				 TextAttributes_Object		inAttributes)
 {
-	UnicodeScalarValue				glyphType = StringUtilities_ReturnUnicodeSymbol(inCellCharacter);
-	NSString*						newString = nil;
+	UnicodeScalarValue const		glyphType = inCellCharacter;
+	UniChar							newCharacter = 0; // if nonzero, this is stored instead of the original character
 	__block TextAttributes_Object	tmpAttributes = inAttributes; // used as needed below
 	__block TextAttributes_Object*	newAttributes = nil; // if any attributes must change, set this to "&tmpAttributes" and modify "tmpAttributes"
 	
-	auto stringWithCharacter = ^(UniChar aChar)
-	{
-		// short-cut for creating string from up to two-byte Unicode value
-		return/* from lambda */ [NSString stringWithCharacters:&aChar length:1];
-	};
-	
 	auto removeVTGraphicsAttribute = ^()
 	{
 		// remove VT graphics flag and then note that attributes have been
@@ -19626,7 +23991,7 @@ translateCell	(My_ScreenBufferPtr			inDataPtr,
 		// the pound sign (#) is a British currency symbol (£)
 		if (glyphType == '#')
 		{
-			newString = stringWithCharacter(0x00A3);
+			newCharacter = 0x00A3;
 		}
 		break;
 	
@@ -19660,19 +24025,19 @@ translateCell	(My_ScreenBufferPtr			inDataPtr,
 		switch (glyphType)
 		{
 		case '_':
-			newString = stringWithCharacter(' '); // blank (same in VT52)
+			newCharacter = ' '; // blank (same in VT52)
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case '`':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(' '); // (reserved in VT52; render as a space)
+				newCharacter = ' '; // (reserved in VT52; render as a space)
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x2666); // filled diamond
+				newCharacter = 0x2666; // filled diamond
 				//removeVTGraphicsAttribute(); // render normally
 			}
 			break;
@@ -19680,275 +24045,275 @@ translateCell	(My_ScreenBufferPtr			inDataPtr,
 		case 'a':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2588); // solid block
+				newCharacter = 0x2588; // solid block
 			}
 			else
 			{
-				newString = stringWithCharacter(0x2592); // checkerboard
+				newCharacter = 0x2592; // checkerboard
 			}
 			break;
 		
 		case 'b':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x215F); // fraction numerator one
+				newCharacter = 0x215F; // fraction numerator one
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x21E5); // horizontal tab (international symbol is a right-pointing arrow with a terminating line)
+				newCharacter = 0x21E5; // horizontal tab (international symbol is a right-pointing arrow with a terminating line)
 			}
 			break;
 		
 		case 'c':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x00B3); // fraction numerator three (not in Unicode; render as a superscript '3')
+				newCharacter = 0x00B3; // fraction numerator three (not in Unicode; render as a superscript '3')
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x21DF); // form feed (international symbol is an arrow pointing top to bottom with two horizontal lines through it)
+				newCharacter = 0x21DF; // form feed (international symbol is an arrow pointing top to bottom with two horizontal lines through it)
 			}
 			break;
 		
 		case 'd':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2075); // fraction numerator five (not in Unicode; render as a superscript '5')
+				newCharacter = 0x2075; // fraction numerator five (not in Unicode; render as a superscript '5')
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x2190); // carriage return (international symbol is an arrow pointing right to left)
+				newCharacter = 0x2190; // carriage return (international symbol is an arrow pointing right to left)
 			}
 			break;
 		
 		case 'e':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2077); // fraction numerator seven (not in Unicode; render as a superscript '7')
+				newCharacter = 0x2077; // fraction numerator seven (not in Unicode; render as a superscript '7')
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x2193); // line feed (international symbol is an arrow pointing top to bottom)
+				newCharacter = 0x2193; // line feed (international symbol is an arrow pointing top to bottom)
 			}
 			break;
 		
 		case 'f':
-			newString = stringWithCharacter(0x00B0); // degrees (same in VT52)
+			newCharacter = 0x00B0; // degrees (same in VT52)
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 'g':
-			newString = stringWithCharacter(0x00B1); // plus or minus (same in VT52)
+			newCharacter = 0x00B1; // plus or minus (same in VT52)
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 'h':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2192); // rightwards arrow
+				newCharacter = 0x2192; // rightwards arrow
 			}
 			else
 			{
-				newString = stringWithCharacter(0x21B5); // new line (international symbol is an arrow that hooks from mid-top to mid-left)
+				newCharacter = 0x21B5; // new line (international symbol is an arrow that hooks from mid-top to mid-left)
 			}
 			break;
 		
 		case 'i':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2026); // ellipsis
+				newCharacter = 0x2026; // ellipsis
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x2913); // vertical tab (international symbol is a down-pointing arrow with a terminating line)
+				newCharacter = 0x2913; // vertical tab (international symbol is a down-pointing arrow with a terminating line)
 			}
 			break;
 		
 		case 'j':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x00F7); // division
+				newCharacter = 0x00F7; // division
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter((kIsBold) ? 0x251B : 0x2518); // hook mid-top to mid-left
+				newCharacter = (kIsBold) ? 0x251B : 0x2518; // hook mid-top to mid-left
 			}
 			break;
 		
 		case 'k':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2193); // downwards arrow
+				newCharacter = 0x2193; // downwards arrow
 			}
 			else
 			{
-				newString = stringWithCharacter((kIsBold) ? 0x2513 : 0x2510); // hook mid-left to mid-bottom
+				newCharacter = (kIsBold) ? 0x2513 : 0x2510; // hook mid-left to mid-bottom
 			}
 			break;
 		
 		case 'l':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x23BA); // bar at scan 0
+				newCharacter = 0x23BA; // bar at scan 0
 			}
 			else
 			{
-				newString = stringWithCharacter((kIsBold) ? 0x250F : 0x250C); // hook mid-right to mid-bottom
+				newCharacter = (kIsBold) ? 0x250F : 0x250C; // hook mid-right to mid-bottom
 			}
 			break;
 		
 		case 'm':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x23BA); // bar at scan 1 (not enough lines in Unicode; assign arbitrarily)
+				newCharacter = 0x23BA; // bar at scan 1 (not enough lines in Unicode; assign arbitrarily)
 			}
 			else
 			{
-				newString = stringWithCharacter((kIsBold) ? 0x2517 : 0x2514); // hook mid-top to mid-right
+				newCharacter = (kIsBold) ? 0x2517 : 0x2514; // hook mid-top to mid-right
 			}
 			break;
 		
 		case 'n':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x23BB); // bar at scan 2 (not enough lines in Unicode; assign arbitrarily)
+				newCharacter = 0x23BB; // bar at scan 2 (not enough lines in Unicode; assign arbitrarily)
 			}
 			else
 			{
-				newString = stringWithCharacter((kIsBold) ? 0x254B : 0x253C); // cross
+				newCharacter = (kIsBold) ? 0x254B : 0x253C; // cross
 			}
 			break;
 		
 		case 'o':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x23BB); // bar at scan 3 (not enough lines in Unicode; assign arbitrarily)
+				newCharacter = 0x23BB; // bar at scan 3 (not enough lines in Unicode; assign arbitrarily)
 			}
 			else
 			{
-				newString = stringWithCharacter(0x23BA); // top line
+				newCharacter = 0x23BA; // top line
 			}
 			break;
 		
 		case 'p':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x23BC); // bar at scan 4 (not enough lines in Unicode; assign arbitrarily)
+				newCharacter = 0x23BC; // bar at scan 4 (not enough lines in Unicode; assign arbitrarily)
 			}
 			else
 			{
-				newString = stringWithCharacter(0x23BB); // line between top and middle regions
+				newCharacter = 0x23BB; // line between top and middle regions
 			}
 			break;
 		
 		case 'q':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x23BC); // bar at scan 5 (not enough lines in Unicode; assign arbitrarily)
+				newCharacter = 0x23BC; // bar at scan 5 (not enough lines in Unicode; assign arbitrarily)
 			}
 			else
 			{
-				newString = stringWithCharacter((kIsBold) ? 0x2501 : 0x2500); // middle line
+				newCharacter = (kIsBold) ? 0x2501 : 0x2500; // middle line
 			}
 			break;
 		
 		case 'r':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x23BD); // bar at scan 6 (not enough lines in Unicode; assign arbitrarily)
+				newCharacter = 0x23BD; // bar at scan 6 (not enough lines in Unicode; assign arbitrarily)
 			}
 			else
 			{
-				newString = stringWithCharacter(0x23BC); // line between middle and bottom regions
+				newCharacter = 0x23BC; // line between middle and bottom regions
 			}
 			break;
 		
 		case 's':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x23BD); // bar at scan 7 (not enough lines in Unicode but largest in VT52 is scan 7; assign arbitrarily)
+				newCharacter = 0x23BD; // bar at scan 7 (not enough lines in Unicode but largest in VT52 is scan 7; assign arbitrarily)
 			}
 			else
 			{
-				newString = stringWithCharacter(0x23BD); // bottom line
+				newCharacter = 0x23BD; // bottom line
 			}
 			break;
 		
 		case 't':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2080); // superscript 0
+				newCharacter = 0x2080; // superscript 0
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter((kIsBold) ? 0x2523 : 0x251C); // cross minus the left piece
+				newCharacter = (kIsBold) ? 0x2523 : 0x251C; // cross minus the left piece
 			}
 			break;
 		
 		case 'u':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2081); // superscript 1
+				newCharacter = 0x2081; // superscript 1
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter((kIsBold) ? 0x252B : 0x2524); // cross minus the right piece
+				newCharacter = (kIsBold) ? 0x252B : 0x2524; // cross minus the right piece
 			}
 			break;
 		
 		case 'v':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2082); // superscript 2
+				newCharacter = 0x2082; // superscript 2
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter((kIsBold) ? 0x253B : 0x2534); // cross minus the bottom piece
+				newCharacter = (kIsBold) ? 0x253B : 0x2534; // cross minus the bottom piece
 			}
 			break;
 		
 		case 'w':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2083); // superscript 3
+				newCharacter = 0x2083; // superscript 3
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter((kIsBold) ? 0x2533 : 0x252C); // cross minus the top piece
+				newCharacter = (kIsBold) ? 0x2533 : 0x252C; // cross minus the top piece
 			}
 			break;
 		
 		case 'x':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2084); // superscript 4
+				newCharacter = 0x2084; // superscript 4
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter((kIsBold) ? 0x2503 : 0x2502); // vertical line
+				newCharacter = (kIsBold) ? 0x2503 : 0x2502; // vertical line
 			}
 			break;
 		
 		case 'y':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2085); // superscript 5
+				newCharacter = 0x2085; // superscript 5
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x2264); // less than or equal to
+				newCharacter = 0x2264; // less than or equal to
 				removeVTGraphicsAttribute(); // render normally
 			}
 			break;
@@ -19956,12 +24321,12 @@ translateCell	(My_ScreenBufferPtr			inDataPtr,
 		case 'z':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2086); // superscript 6
+				newCharacter = 0x2086; // superscript 6
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x2265); // greater than or equal to
+				newCharacter = 0x2265; // greater than or equal to
 				removeVTGraphicsAttribute(); // render normally
 			}
 			break;
@@ -19969,12 +24334,12 @@ translateCell	(My_ScreenBufferPtr			inDataPtr,
 		case '{':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2087); // superscript 7
+				newCharacter = 0x2087; // superscript 7
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x03C0); // pi
+				newCharacter = 0x03C0; // pi
 				removeVTGraphicsAttribute(); // render normally
 			}
 			break;
@@ -19982,12 +24347,12 @@ translateCell	(My_ScreenBufferPtr			inDataPtr,
 		case '|':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2088); // superscript 8
+				newCharacter = 0x2088; // superscript 8
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x2260); // not equal to
+				newCharacter = 0x2260; // not equal to
 				removeVTGraphicsAttribute(); // render normally
 			}
 			break;
@@ -19995,12 +24360,12 @@ translateCell	(My_ScreenBufferPtr			inDataPtr,
 		case '}':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x2089); // superscript 9
+				newCharacter = 0x2089; // superscript 9
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x00A3); // British pounds (currency) symbol
+				newCharacter = 0x00A3; // British pounds (currency) symbol
 				removeVTGraphicsAttribute(); // render normally
 			}
 			break;
@@ -20008,93 +24373,93 @@ translateCell	(My_ScreenBufferPtr			inDataPtr,
 		case '~':
 			if (kVT52)
 			{
-				newString = stringWithCharacter(0x00B6); // pilcrow (paragraph) sign
+				newCharacter = 0x00B6; // pilcrow (paragraph) sign
 				removeVTGraphicsAttribute(); // render normally
 			}
 			else
 			{
-				newString = stringWithCharacter(0x2027); // centered dot
+				newCharacter = 0x2027; // centered dot
 				removeVTGraphicsAttribute(); // render normally
 			}
 			break;
 		
 		case 159:
-			newString = stringWithCharacter(0x0192); // small 'f' with hook
+			newCharacter = 0x0192; // small 'f' with hook
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 224:
-			newString = stringWithCharacter(0x03B1); // alpha
+			newCharacter = 0x03B1; // alpha
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 225:
-			newString = stringWithCharacter(0x00DF); // beta
+			newCharacter = 0x00DF; // beta
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 226:
-			newString = stringWithCharacter(0x0393); // capital gamma
+			newCharacter = 0x0393; // capital gamma
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 227:
-			newString = stringWithCharacter(0x03C0); // pi
+			newCharacter = 0x03C0; // pi
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 228:
-			newString = stringWithCharacter(0x03A3); // capital sigma
+			newCharacter = 0x03A3; // capital sigma
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 229:
-			newString = stringWithCharacter(0x03C3); // sigma
+			newCharacter = 0x03C3; // sigma
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 230:
-			newString = stringWithCharacter(0x00B5); // mu
+			newCharacter = 0x00B5; // mu
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 231:
-			newString = stringWithCharacter(0x03C4); // tau
+			newCharacter = 0x03C4; // tau
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 232:
-			newString = stringWithCharacter(0x03A6); // capital phi
+			newCharacter = 0x03A6; // capital phi
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 233:
-			newString = stringWithCharacter(0x0398); // capital theta
+			newCharacter = 0x0398; // capital theta
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 234:
-			newString = stringWithCharacter(0x03A9); // capital omega
+			newCharacter = 0x03A9; // capital omega
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 235:
-			newString = stringWithCharacter(0x03B4); // delta
+			newCharacter = 0x03B4; // delta
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 237:
-			newString = stringWithCharacter(0x03C6); // phi
+			newCharacter = 0x03C6; // phi
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 238:
-			newString = stringWithCharacter(0x03B5); // epsilon
+			newCharacter = 0x03B5; // epsilon
 			removeVTGraphicsAttribute(); // render normally
 			break;
 		
 		case 251:
-			newString = stringWithCharacter(0x221A); // square root left edge
+			newCharacter = 0x221A; // square root left edge
 			break;
 		
 		default:
@@ -20345,35 +24710,640 @@ translateCell	(My_ScreenBufferPtr			inDataPtr,
 	}
 	
 	// replace attributes at this cell location, and optionally
-	// update the character as well (if "newString" is defined)
-	if (nil != newString)
+	// update the character as well (if "newCharacter" is defined)
+	inoutUpdatedTerminalLinePtr->replaceCell(inFirstUpdatedCell,
+												((0 != newCharacter) ? newCharacter : STATIC_CAST(glyphType, UniChar)),
+												((nil != newAttributes) ? *newAttributes : inAttributes));
+}// translateCell
+
+
+/*!
+Tests that an image is retained by a terminal only while
+some line (on the screen or in the scrollback) shows part
+of it, so that the image store can reuse its segment IDs.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_Images_000 ()
+{
+	Boolean				result = true;
+	TerminalScreenRef	screen = returnNewTestScreen(10, 3);
+	
+	
+	Console_TestAssertUpdate(result, nullptr != screen, Console_WriteLine, "test screen is created");
+	if (nullptr != screen)
+	{
+		My_ScreenBufferPtr		dataPtr = getVirtualScreenData(screen);
+		NSImage*				image = [[NSImage alloc] initWithSize:NSMakeSize(20, 20)];
+		ImageStore_ContentKey	contentKey;
+		ImageStore_ImageID		imageID = kImageStore_InvalidImageID;
+		
+		
+		contentKey.appendBytes("terminal image test", 19);
+		
+		// an image that covers 2 rows stays retained after those
+		// rows scroll into the scrollback, until they are cleared
+		imageID = ImageStore_AddImage(image, contentKey);
+		bufferInsertInlineImageWithoutUpdate(dataPtr, imageID, 20/* pixels wide */, 20/* pixels high */,
+												10/* cell width */, 10/* cell height */,
+												true/* allow scrolling */, false/* restore cursor */);
+		Console_TestAssertUpdate(result, 1 == dataPtr->emulator.retainedImages.count(imageID),
+									Console_WriteLine, "inserted image is retained");
+		Terminal_EmulatorProcessCString(screen, "\015\012\015\012\015\012");
+		Console_TestAssertUpdate(result, 2 == dataPtr->scrollbackBuffer.returnImageLineCount(imageID),
+									Console_WriteValue, "scrollback lines that show image", dataPtr->scrollbackBuffer.returnImageLineCount(imageID));
+		Console_TestAssertUpdate(result, 1 == dataPtr->emulator.retainedImages.count(imageID),
+									Console_WriteLine, "image in scrollback is retained");
+		Terminal_DeleteAllSavedLines(screen);
+		Console_TestAssertUpdate(result, 0 == dataPtr->emulator.retainedImages.count(imageID),
+									Console_WriteLine, "image is released when scrollback is cleared");
+		
+		// an image is released when the screen is erased
+		Terminal_EmulatorProcessCString(screen, "\033[H"); // home cursor
+		imageID = ImageStore_AddImage(image, contentKey);
+		bufferInsertInlineImageWithoutUpdate(dataPtr, imageID, 20/* pixels wide */, 20/* pixels high */,
+												10/* cell width */, 10/* cell height */,
+												false/* allow scrolling */, true/* restore cursor */);
+		Terminal_EmulatorProcessCString(screen, "\033[H"); // any processed data causes a check
+		Console_TestAssertUpdate(result, 1 == dataPtr->emulator.retainedImages.count(imageID),
+									Console_WriteLine, "image on screen is retained");
+		Terminal_EmulatorProcessCString(screen, "\033[2J");
+		Console_TestAssertUpdate(result, 0 == dataPtr->emulator.retainedImages.count(imageID),
+									Console_WriteLine, "image is released when screen is erased");
+		
+		Terminal_ReleaseScreen(&screen);
+	}
+	
+	return result;
+}// unitTest_Images_000
+
+
+/*!
+Tests rewrapping scrollback lines to a narrower width and
+back again, including a line of double-width characters
+that cannot be split at the new wrap column (such rows
+wrap one column early).
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_Reflow_000 ()
+{
+	Boolean				result = true;
+	TerminalScreenRef	screen = returnNewTestScreen(10, 3);
+	
+	
+	Console_TestAssertUpdate(result, nullptr != screen, Console_WriteLine, "test screen is created");
+	if (nullptr != screen)
 	{
-		// text changed, and possibly attributes as well
-		CFStringRef		asCFString = BRIDGE_CAST(newString, CFStringRef);
+		My_ScreenBufferPtr		dataPtr = getVirtualScreenData(screen);
+		My_ScrollbackBuffer&	scrollback = dataPtr->scrollbackBuffer;
 		
 		
-		if (nil != newAttributes)
+		// a line of 15 cells (wrapped once), then "pq" and 4 CJK ideographs
+		// (U+4E2D) in exactly 10 cells; both scroll into the scrollback
+		Terminal_EmulatorProcessCString(screen, "abcdefghijklmno\015\012pq\xE4\xB8\xAD\xE4\xB8\xAD\xE4\xB8\xAD\xE4\xB8\xAD");
+		Terminal_EmulatorProcessCString(screen, "\015\012\015\012\015\012");
+		Console_TestAssertUpdate(result, 3 == scrollback.size(), Console_WriteValue, "initial scrollback size", scrollback.size());
+		
+		// shrink; the rewrapped rows are (oldest first): "abcde", "fghij",
+		// "klmno", "pq" and an ideograph, 2 ideographs, 1 ideograph
+		UNUSED_RETURN(Terminal_Result)Terminal_SetVisibleScreenDimensions(screen, 5, 3);
+		while (scrollback.isReflowPending())
 		{
-			inoutUpdatedTerminalLinePtr->replaceCell(inFirstUpdatedCell, asCFString, *newAttributes);
+			UNUSED_RETURN(bool)scrollback.continueReflow();
 		}
-		else
+		Console_TestAssertUpdate(result, 6 == scrollback.size(), Console_WriteValue, "scrollback size after shrinking", scrollback.size());
+		if (6 == scrollback.size())
+		{
+			Console_TestAssertUpdate(result, 5 == scrollback[5]->softWrapColumnCount,
+										Console_WriteValue, "wrap column of first row", scrollback[5]->softWrapColumnCount);
+			Console_TestAssertUpdate(result, 'f' == scrollback[4]->textVectorBegin[0],
+										Console_WriteValue, "first cell of second row", scrollback[4]->textVectorBegin[0]);
+			Console_TestAssertUpdate(result, ('k' == scrollback[3]->textVectorBegin[0]) && (0 == scrollback[3]->softWrapColumnCount),
+										Console_WriteValue, "first cell of last row of first line", scrollback[3]->textVectorBegin[0]);
+			Console_TestAssertUpdate(result, 4 == scrollback[2]->softWrapColumnCount,
+										Console_WriteValue, "wrap column before split ideograph", scrollback[2]->softWrapColumnCount);
+			Console_TestAssertUpdate(result, ' ' == scrollback[2]->textVectorBegin[4],
+										Console_WriteValue, "unused last cell", scrollback[2]->textVectorBegin[4]);
+			Console_TestAssertUpdate(result, (0x4E2D == scrollback[1]->textVectorBegin[0]) &&
+												(kTerminal_WideCharacterContinuation == scrollback[1]->textVectorBegin[1]),
+										Console_WriteValue, "first cell of row after split ideograph", scrollback[1]->textVectorBegin[0]);
+			Console_TestAssertUpdate(result, 4 == scrollback[1]->softWrapColumnCount,
+										Console_WriteValue, "wrap column of second row of ideographs", scrollback[1]->softWrapColumnCount);
+			Console_TestAssertUpdate(result, (0x4E2D == scrollback[0]->textVectorBegin[0]) && (0 == scrollback[0]->softWrapColumnCount),
+										Console_WriteValue, "first cell of last row", scrollback[0]->textVectorBegin[0]);
+		}
+		
+		// grow; each line fits in one row again
+		UNUSED_RETURN(Terminal_Result)Terminal_SetVisibleScreenDimensions(screen, 20, 3);
+		while (scrollback.isReflowPending())
+		{
+			UNUSED_RETURN(bool)scrollback.continueReflow();
+		}
+		Console_TestAssertUpdate(result, 2 == scrollback.size(), Console_WriteValue, "scrollback size after growing", scrollback.size());
+		if (2 == scrollback.size())
 		{
-			inoutUpdatedTerminalLinePtr->replaceCell(inFirstUpdatedCell, asCFString, inAttributes);
+			Console_TestAssertUpdate(result, ('k' == scrollback[1]->textVectorBegin[10]) && ('o' == scrollback[1]->textVectorBegin[14]),
+										Console_WriteValue, "cell 11 of rejoined line", scrollback[1]->textVectorBegin[10]);
+			Console_TestAssertUpdate(result, 0 == scrollback[1]->softWrapColumnCount,
+										Console_WriteValue, "wrap column of rejoined line", scrollback[1]->softWrapColumnCount);
+			Console_TestAssertUpdate(result, (0x4E2D == scrollback[0]->textVectorBegin[8]) &&
+												(kTerminal_WideCharacterContinuation == scrollback[0]->textVectorBegin[9]),
+										Console_WriteValue, "last ideograph of rejoined line", scrollback[0]->textVectorBegin[8]);
+			Console_TestAssertUpdate(result, 0 == scrollback[0]->softWrapColumnCount,
+										Console_WriteValue, "wrap column of rejoined ideographs", scrollback[0]->softWrapColumnCount);
 		}
+		
+		Terminal_ReleaseScreen(&screen);
 	}
-	else
+	
+	return result;
+}// unitTest_Reflow_000
+
+
+/*!
+Tests rewrapping a scrollback that is long enough to have
+compacted lines and to need more than one slice of work:
+compacted lines must be rewrapped correctly, and a line
+that was restored before the reflow must still be counted
+as restored after older rows are renumbered.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_Reflow_001 ()
+{
+	Boolean				result = true;
+	TerminalScreenRef	screen = returnNewTestScreen(10, 3, 5000/* scrollback rows */);
+	
+	
+	Console_TestAssertUpdate(result, nullptr != screen, Console_WriteLine, "test screen is created");
+	if (nullptr != screen)
 	{
-		// sometimes text is not changed but attributes do change
-		if (nil != newAttributes)
+		My_ScreenBufferPtr		dataPtr = getVirtualScreenData(screen);
+		My_ScrollbackBuffer&	scrollback = dataPtr->scrollbackBuffer;
+		UInt16 const			kLineCount = (My_ScrollbackBuffer::kExpandedLineLimit + 102);
+		size_t					lineCount = 0;
+		
+		
+		// lines of exactly 10 cells, numbered so that each is distinct
+		for (UInt16 i = 0; i < kLineCount; ++i)
 		{
-			inoutUpdatedTerminalLinePtr->replaceCell(inFirstUpdatedCell, inCellCharacter, *newAttributes);
+			char	lineText[16];
+			
+			
+			UNUSED_RETURN(int)snprintf(lineText, sizeof(lineText), "%04uabcdef\015\012", STATIC_CAST(i, unsigned int));
+			Terminal_EmulatorProcessCString(screen, lineText);
 		}
-		else
+		lineCount = scrollback.size();
+		Console_TestAssertUpdate(result, (kLineCount - 2) == lineCount, Console_WriteValue, "initial scrollback size", lineCount);
+		Console_TestAssertUpdate(result, scrollback.returnCompactLineCount() > 0,
+									Console_WriteValue, "compact lines", scrollback.returnCompactLineCount());
+		
+		// restore the oldest line, then shrink; the first slice of the
+		// reflow only rewraps the newest lines, and renumbers the rest
+		UNUSED_RETURN(My_ScreenBufferLinePtr&)scrollback.oldest();
+		Console_TestAssertUpdate(result, scrollback.isRestoredLine(scrollback.returnSequenceNumber(lineCount - 1)),
+									Console_WriteLine, "oldest line is restored");
+		UNUSED_RETURN(Terminal_Result)Terminal_SetVisibleScreenDimensions(screen, 5, 3);
+		Console_TestAssertUpdate(result, scrollback.isReflowPending(), Console_WriteLine, "reflow takes more than one slice");
+		Console_TestAssertUpdate(result, scrollback.isRestoredLine(scrollback.returnSequenceNumber(scrollback.size() - 1)),
+									Console_WriteLine, "oldest line is still restored after renumbering");
+		while (scrollback.isReflowPending())
+		{
+			UNUSED_RETURN(bool)scrollback.continueReflow();
+		}
+		
+		// every line now takes 2 rows; older rows are compacted again
+		Console_TestAssertUpdate(result, (2 * lineCount) == scrollback.size(),
+									Console_WriteValue, "scrollback size after shrinking", scrollback.size());
+		Console_TestAssertUpdate(result, scrollback.returnCompactLineCount() > 0,
+									Console_WriteValue, "compact lines after reflow", scrollback.returnCompactLineCount());
+		if ((2 * lineCount) == scrollback.size())
 		{
-			inoutUpdatedTerminalLinePtr->replaceCell(inFirstUpdatedCell, inCellCharacter, inAttributes);
+			size_t const	kOldestRow = (scrollback.size() - 1);
+			
+			
+			// (reading a row restores it, if it was compacted)
+			Console_TestAssertUpdate(result, ('0' == scrollback[kOldestRow]->textVectorBegin[3]) && ('a' == scrollback[kOldestRow]->textVectorBegin[4]),
+										Console_WriteValue, "fifth cell of oldest row", scrollback[kOldestRow]->textVectorBegin[4]);
+			Console_TestAssertUpdate(result, 5 == scrollback[kOldestRow]->softWrapColumnCount,
+										Console_WriteValue, "wrap column of oldest row", scrollback[kOldestRow]->softWrapColumnCount);
+			Console_TestAssertUpdate(result, ('b' == scrollback[kOldestRow - 1]->textVectorBegin[0]) && ('f' == scrollback[kOldestRow - 1]->textVectorBegin[4]),
+										Console_WriteValue, "first cell of second row", scrollback[kOldestRow - 1]->textVectorBegin[0]);
+			Console_TestAssertUpdate(result, 0 == scrollback[kOldestRow - 1]->softWrapColumnCount,
+										Console_WriteValue, "wrap column of second row", scrollback[kOldestRow - 1]->softWrapColumnCount);
+			Console_TestAssertUpdate(result, ('1' == scrollback[kOldestRow - 2]->textVectorBegin[3]),
+										Console_WriteValue, "fourth cell of third row", scrollback[kOldestRow - 2]->textVectorBegin[3]);
 		}
+		
+		Terminal_ReleaseScreen(&screen);
 	}
-}// translateCell
+	
+	return result;
+}// unitTest_Reflow_001
+
+
+/*!
+Tests the limit on restored scrollback lines: restoring more
+than kRestoredLineLimit compacted lines must immediately compact
+the least recently used restored line again, and using a
+restored line again must protect it from being the next one.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_Scrollback_000 ()
+{
+	Boolean				result = true;
+	TerminalScreenRef	screen = returnNewTestScreen(20, 3, 5000/* scrollback rows */);
+	
+	
+	Console_TestAssertUpdate(result, nullptr != screen, Console_WriteLine, "test screen is created");
+	if (nullptr != screen)
+	{
+		typedef My_ScrollbackBuffer::SequenceNumber		SequenceNumber;
+		My_ScreenBufferPtr		dataPtr = getVirtualScreenData(screen);
+		My_ScrollbackBuffer&	scrollback = dataPtr->scrollbackBuffer;
+		size_t const			kLimit = My_ScrollbackBuffer::kRestoredLineLimit;
+		UInt16 const			kLineCount = STATIC_CAST(My_ScrollbackBuffer::kExpandedLineLimit + kLimit + 20, UInt16);
+		size_t					lineCount = 0;
+		size_t					compactLineCount = 0;
+		
+		
+		for (UInt16 i = 0; i < kLineCount; ++i)
+		{
+			char	lineText[16];
+			
+			
+			UNUSED_RETURN(int)snprintf(lineText, sizeof(lineText), "%04uabcdef\015\012", STATIC_CAST(i, unsigned int));
+			Terminal_EmulatorProcessCString(screen, lineText);
+		}
+		lineCount = scrollback.size();
+		compactLineCount = scrollback.returnCompactLineCount();
+		Console_TestAssertUpdate(result, compactLineCount > (kLimit + 1),
+									Console_WriteValue, "compact lines", compactLineCount);
+		if (compactLineCount > (kLimit + 1))
+		{
+			SequenceNumber const	kOldestNumber = scrollback.returnSequenceNumber(lineCount - 1);
+			SequenceNumber const	kSecondNumber = scrollback.returnSequenceNumber(lineCount - 2);
+			
+			
+			// restore exactly as many lines as the limit, oldest first
+			for (size_t i = 0; i < kLimit; ++i)
+			{
+				UNUSED_RETURN(My_ScreenBufferLinePtr&)scrollback[lineCount - 1 - i];
+			}
+			Console_TestAssertUpdate(result, (compactLineCount - kLimit) == scrollback.returnCompactLineCount(),
+										Console_WriteValue, "compact lines after restoring up to the limit",
+										scrollback.returnCompactLineCount());
+			Console_TestAssertUpdate(result, scrollback.isRestoredLine(kOldestNumber) && scrollback.isRestoredLine(kSecondNumber),
+										Console_WriteLine, "oldest lines are restored");
+			
+			// use the oldest line again, then restore one more line; the
+			// second-oldest is now the least recently used so it is evicted
+			UNUSED_RETURN(My_ScreenBufferLinePtr&)scrollback[lineCount - 1];
+			UNUSED_RETURN(My_ScreenBufferLinePtr&)scrollback[lineCount - 1 - kLimit];
+			Console_TestAssertUpdate(result, (compactLineCount - kLimit) == scrollback.returnCompactLineCount(),
+										Console_WriteValue, "compact lines after restoring past the limit",
+										scrollback.returnCompactLineCount());
+			Console_TestAssertUpdate(result, scrollback.isRestoredLine(kOldestNumber),
+										Console_WriteLine, "recently used line is still restored");
+			Console_TestAssertUpdate(result, false == scrollback.isRestoredLine(kSecondNumber),
+										Console_WriteLine, "least recently used line is compacted again");
+			Console_TestAssertUpdate(result, (nullptr != scrollback.returnCompactLine(lineCount - 2)),
+										Console_WriteLine, "least recently used line has a compact form");
+		}
+		
+		Terminal_ReleaseScreen(&screen);
+	}
+	
+	return result;
+}// unitTest_Scrollback_000
+
+
+/*!
+Tests a line with double-width characters: the placeholder
+in the second cell of each one must not prevent searches
+(on the screen, or in the indexed scrollback) from finding
+text, and must be removable from copied text.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_WideCharacters_000 ()
+{
+	Boolean				result = true;
+	TerminalScreenRef	screen = returnNewTestScreen(10, 3);
+	
+	
+	Console_TestAssertUpdate(result, nullptr != screen, Console_WriteLine, "test screen is created");
+	if (nullptr != screen)
+	{
+		My_ScreenBufferPtr							dataPtr = getVirtualScreenData(screen);
+		std::vector< Terminal_RangeDescription >	matches;
+		
+		
+		// "ab", 2 CJK ideographs (U+4E2D, U+6587) and "cd"
+		Terminal_EmulatorProcessCString(screen, "ab\xE4\xB8\xAD\xE6\x96\x87" "cd");
+		{
+			My_ScreenBufferLinePtr const&	kRowPtr = dataPtr->screenBuffer.front();
+			
+			
+			Console_TestAssertUpdate(result, 0x4E2D == kRowPtr->textVectorBegin[2], Console_WriteValue, "third cell", kRowPtr->textVectorBegin[2]);
+			Console_TestAssertUpdate(result, kTerminal_WideCharacterContinuation == kRowPtr->textVectorBegin[3],
+										Console_WriteValue, "fourth cell", kRowPtr->textVectorBegin[3]);
+			Console_TestAssertUpdate(result, 0x6587 == kRowPtr->textVectorBegin[4], Console_WriteValue, "fifth cell", kRowPtr->textVectorBegin[4]);
+		}
+		
+		// search the screen
+		UNUSED_RETURN(Terminal_Result)Terminal_Search(screen, CFSTR("\u4E2D\u6587"), 0/* flags */, matches);
+		Console_TestAssertUpdate(result, 1 == matches.size(), Console_WriteValue, "screen match count", matches.size());
+		if (1 == matches.size())
+		{
+			Console_TestAssertUpdate(result, 0 == matches[0].firstRow, Console_WriteValue, "screen match row", matches[0].firstRow);
+			Console_TestAssertUpdate(result, 2 == matches[0].firstColumn, Console_WriteValue, "screen match column", matches[0].firstColumn);
+			Console_TestAssertUpdate(result, 4 == matches[0].columnCount, Console_WriteValue, "screen match width", matches[0].columnCount);
+		}
+		matches.clear();
+		UNUSED_RETURN(Terminal_Result)Terminal_Search(screen, CFSTR("\u6587cd"), 0/* flags */, matches);
+		Console_TestAssertUpdate(result, 1 == matches.size(), Console_WriteValue, "screen match count (after ideograph)", matches.size());
+		if (1 == matches.size())
+		{
+			Console_TestAssertUpdate(result, 4 == matches[0].firstColumn, Console_WriteValue, "screen match column (after ideograph)", matches[0].firstColumn);
+			Console_TestAssertUpdate(result, 4 == matches[0].columnCount, Console_WriteValue, "screen match width (after ideograph)", matches[0].columnCount);
+		}
+		
+		// copy the text
+		{
+			Terminal_LineRef	lineIterator = Terminal_NewMainScreenLineIterator(screen, 0/* starting row */);
+			CFStringRef			lineCFString = nullptr;
+			CFRange				lineRange = CFRangeMake(0, 0);
+			
+			
+			if (nullptr != lineIterator)
+			{
+				if (kTerminal_ResultOK == Terminal_GetLine(screen, lineIterator, lineCFString, lineRange, kTerminal_TextFilterFlagsNoEndWhitespace))
+				{
+					CFRetainRelease		copiedText(CFStringCreateMutable(kCFAllocatorDefault, 0/* size limit */),
+													CFRetainRelease::kAlreadyRetained);
+					CFRetainRelease		lineText(CFStringCreateWithSubstring(kCFAllocatorDefault, lineCFString, lineRange),
+													CFRetainRelease::kAlreadyRetained);
+					CFIndex				removedCount = 0;
+					
+					
+					CFStringAppend(copiedText.returnCFMutableStringRef(), lineText.returnCFStringRef());
+					removedCount = Terminal_RemoveWideCharacterContinuations(copiedText.returnCFMutableStringRef(),
+																				CFRangeMake(0, CFStringGetLength(copiedText.returnCFStringRef())));
+					Console_TestAssertUpdate(result, 2 == removedCount, Console_WriteValue, "placeholders removed from copy", removedCount);
+					Console_TestAssertUpdate(result, kCFCompareEqualTo == CFStringCompare(copiedText.returnCFStringRef(), CFSTR("ab\u4E2D\u6587cd"), 0/* options */),
+												Console_WriteValueCFString, "copied text", copiedText.returnCFStringRef());
+				}
+				Terminal_DisposeLineIterator(&lineIterator);
+			}
+		}
+		
+		// search the line after it scrolls into the (indexed) scrollback;
+		// the query is long enough to use the index
+		Terminal_EmulatorProcessCString(screen, "\015\012\015\012\015\012");
+		Console_TestAssertUpdate(result, 1 == dataPtr->scrollbackBuffer.size(), Console_WriteValue, "scrollback size", dataPtr->scrollbackBuffer.size());
+		matches.clear();
+		UNUSED_RETURN(Terminal_Result)Terminal_Search(screen, CFSTR("b\u4E2D\u6587"), 0/* flags */, matches);
+		Console_TestAssertUpdate(result, 1 == matches.size(), Console_WriteValue, "scrollback match count", matches.size());
+		if (1 == matches.size())
+		{
+			Console_TestAssertUpdate(result, -1 == matches[0].firstRow, Console_WriteValue, "scrollback match row", matches[0].firstRow);
+			Console_TestAssertUpdate(result, 1 == matches[0].firstColumn, Console_WriteValue, "scrollback match column", matches[0].firstColumn);
+			Console_TestAssertUpdate(result, 5 == matches[0].columnCount, Console_WriteValue, "scrollback match width", matches[0].columnCount);
+		}
+		
+		Terminal_ReleaseScreen(&screen);
+	}
+	
+	return result;
+}// unitTest_WideCharacters_000
+
+
+/*!
+Tests a double-width character that arrives when only the
+last column remains: it must wrap early, and the unused
+last column must not become part of the wrapped text (so
+that a search can find text across the wrap).
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_WideCharacters_001 ()
+{
+	Boolean				result = true;
+	TerminalScreenRef	screen = returnNewTestScreen(5, 3);
+	
+	
+	Console_TestAssertUpdate(result, nullptr != screen, Console_WriteLine, "test screen is created");
+	if (nullptr != screen)
+	{
+		My_ScreenBufferPtr							dataPtr = getVirtualScreenData(screen);
+		std::vector< Terminal_RangeDescription >	matches;
+		
+		
+		// "abcd" and a CJK ideograph (U+4E2D)
+		Terminal_EmulatorProcessCString(screen, "abcd\xE4\xB8\xAD");
+		{
+			My_ScreenBufferLinePtr const&	kFirstRowPtr = dataPtr->screenBuffer.front();
+			My_ScreenBufferLinePtr const&	kSecondRowPtr = *(std::next(dataPtr->screenBuffer.begin()));
+			
+			
+			Console_TestAssertUpdate(result, 4 == kFirstRowPtr->softWrapColumnCount,
+										Console_WriteValue, "wrap column", kFirstRowPtr->softWrapColumnCount);
+			Console_TestAssertUpdate(result, 0x4E2D == kSecondRowPtr->textVectorBegin[0],
+										Console_WriteValue, "first cell of next row", kSecondRowPtr->textVectorBegin[0]);
+			Console_TestAssertUpdate(result, kTerminal_WideCharacterContinuation == kSecondRowPtr->textVectorBegin[1],
+										Console_WriteValue, "second cell of next row", kSecondRowPtr->textVectorBegin[1]);
+		}
+		
+		UNUSED_RETURN(Terminal_Result)Terminal_Search(screen, CFSTR("d\u4E2D"), 0/* flags */, matches);
+		Console_TestAssertUpdate(result, 1 == matches.size(), Console_WriteValue, "match count", matches.size());
+		if (1 == matches.size())
+		{
+			Console_TestAssertUpdate(result, 0 == matches[0].firstRow, Console_WriteValue, "match row", matches[0].firstRow);
+			Console_TestAssertUpdate(result, 3 == matches[0].firstColumn, Console_WriteValue, "match column", matches[0].firstColumn);
+			Console_TestAssertUpdate(result, 2 == matches[0].rowCount, Console_WriteValue, "match row count", matches[0].rowCount);
+			Console_TestAssertUpdate(result, 2 == matches[0].lastRowPastEndColumn,
+										Console_WriteValue, "match end column", matches[0].lastRowPastEndColumn);
+		}
+		
+		Terminal_ReleaseScreen(&screen);
+	}
+	
+	return result;
+}// unitTest_WideCharacters_001
+
+
+/*!
+Tests rewrapping a line with double-width characters to a
+width that would split one of them: the character must
+move to the next row as a whole, and the row before it
+must wrap one column early.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_WideCharacters_002 ()
+{
+	Boolean				result = true;
+	TerminalScreenRef	screen = returnNewTestScreen(6, 3);
+	
+	
+	Console_TestAssertUpdate(result, nullptr != screen, Console_WriteLine, "test screen is created");
+	if (nullptr != screen)
+	{
+		My_ScreenBufferPtr							dataPtr = getVirtualScreenData(screen);
+		std::vector< Terminal_RangeDescription >	matches;
+		
+		
+		// "ab" and 2 CJK ideographs (U+4E2D, U+6587) fill 6 columns;
+		// at 5 columns, the second ideograph would start in the last one
+		Terminal_EmulatorProcessCString(screen, "ab\xE4\xB8\xAD\xE6\x96\x87");
+		UNUSED_RETURN(Terminal_Result)Terminal_SetVisibleScreenDimensions(screen, 5, 3);
+		{
+			My_ScreenBufferLinePtr const&	kFirstRowPtr = dataPtr->screenBuffer.front();
+			My_ScreenBufferLinePtr const&	kSecondRowPtr = *(std::next(dataPtr->screenBuffer.begin()));
+			
+			
+			Console_TestAssertUpdate(result, 4 == kFirstRowPtr->softWrapColumnCount,
+										Console_WriteValue, "wrap column", kFirstRowPtr->softWrapColumnCount);
+			Console_TestAssertUpdate(result, kTerminal_WideCharacterContinuation == kFirstRowPtr->textVectorBegin[3],
+										Console_WriteValue, "fourth cell of first row", kFirstRowPtr->textVectorBegin[3]);
+			Console_TestAssertUpdate(result, ' ' == kFirstRowPtr->textVectorBegin[4],
+										Console_WriteValue, "last cell of first row", kFirstRowPtr->textVectorBegin[4]);
+			Console_TestAssertUpdate(result, 0x6587 == kSecondRowPtr->textVectorBegin[0],
+										Console_WriteValue, "first cell of second row", kSecondRowPtr->textVectorBegin[0]);
+			Console_TestAssertUpdate(result, kTerminal_WideCharacterContinuation == kSecondRowPtr->textVectorBegin[1],
+										Console_WriteValue, "second cell of second row", kSecondRowPtr->textVectorBegin[1]);
+		}
+		
+		UNUSED_RETURN(Terminal_Result)Terminal_Search(screen, CFSTR("\u4E2D\u6587"), 0/* flags */, matches);
+		Console_TestAssertUpdate(result, 1 == matches.size(), Console_WriteValue, "match count", matches.size());
+		if (1 == matches.size())
+		{
+			Console_TestAssertUpdate(result, 2 == matches[0].firstColumn, Console_WriteValue, "match column", matches[0].firstColumn);
+			Console_TestAssertUpdate(result, 2 == matches[0].rowCount, Console_WriteValue, "match row count", matches[0].rowCount);
+			Console_TestAssertUpdate(result, 2 == matches[0].lastRowPastEndColumn,
+										Console_WriteValue, "match end column", matches[0].lastRowPastEndColumn);
+		}
+		
+		Terminal_ReleaseScreen(&screen);
+	}
+	
+	return result;
+}// unitTest_WideCharacters_002
+
+
+/*!
+Tests inserting, deleting and erasing characters (as with
+ICH, DCH and ECH) at a column that splits a double-width
+character: both halves of that character must become blank,
+so that no row is left with half of a character.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_WideCharacters_003 ()
+{
+	Boolean				result = true;
+	TerminalScreenRef	screen = returnNewTestScreen(12, 3);
+	
+	
+	Console_TestAssertUpdate(result, nullptr != screen, Console_WriteLine, "test screen is created");
+	if (nullptr != screen)
+	{
+		My_ScreenBufferPtr				dataPtr = getVirtualScreenData(screen);
+		My_ScreenBufferLinePtr const&	kFirstRowPtr = *(dataPtr->screenBuffer.begin());
+		My_ScreenBufferLinePtr const&	kSecondRowPtr = *(std::next(dataPtr->screenBuffer.begin(), 1));
+		My_ScreenBufferLinePtr const&	kThirdRowPtr = *(std::next(dataPtr->screenBuffer.begin(), 2));
+		
+		
+		// on every row, 2 CJK ideographs (U+4E2D, U+6587) and "xy"
+		Terminal_EmulatorProcessCString(screen, "\xE4\xB8\xAD\xE6\x96\x87xy\015\012"
+												"\xE4\xB8\xAD\xE6\x96\x87xy\015\012"
+												"\xE4\xB8\xAD\xE6\x96\x87xy");
+		
+		// insert one blank in the middle of the first ideograph; the
+		// rest of the row, including the second ideograph, shifts over
+		moveCursorY(dataPtr, 0);
+		moveCursorX(dataPtr, 1);
+		UNUSED_RETURN(Boolean)bufferInsertBlanksAtCursorColumnWithoutUpdate(dataPtr, 1, kMy_AttributeRuleInitialize);
+		Console_TestAssertUpdate(result, (' ' == kFirstRowPtr->textVectorBegin[0]) && (' ' == kFirstRowPtr->textVectorBegin[1]) &&
+											(' ' == kFirstRowPtr->textVectorBegin[2]),
+									Console_WriteValue, "ICH: first cell", kFirstRowPtr->textVectorBegin[0]);
+		Console_TestAssertUpdate(result, (0x6587 == kFirstRowPtr->textVectorBegin[3]) &&
+											(kTerminal_WideCharacterContinuation == kFirstRowPtr->textVectorBegin[4]) &&
+											('x' == kFirstRowPtr->textVectorBegin[5]),
+									Console_WriteValue, "ICH: shifted ideograph", kFirstRowPtr->textVectorBegin[3]);
+		
+		// delete one character in the middle of the first ideograph
+		moveCursorY(dataPtr, 1);
+		moveCursorX(dataPtr, 1);
+		bufferRemoveCharactersAtCursorColumn(dataPtr, 1, kMy_AttributeRuleInitialize);
+		Console_TestAssertUpdate(result, ' ' == kSecondRowPtr->textVectorBegin[0],
+									Console_WriteValue, "DCH: first cell", kSecondRowPtr->textVectorBegin[0]);
+		Console_TestAssertUpdate(result, (0x6587 == kSecondRowPtr->textVectorBegin[1]) &&
+											(kTerminal_WideCharacterContinuation == kSecondRowPtr->textVectorBegin[2]) &&
+											('x' == kSecondRowPtr->textVectorBegin[3]),
+									Console_WriteValue, "DCH: shifted ideograph", kSecondRowPtr->textVectorBegin[1]);
+		
+		// erase 2 characters, from the second half of the first
+		// ideograph to the first half of the second one
+		moveCursorY(dataPtr, 2);
+		moveCursorX(dataPtr, 1);
+		bufferEraseFromCursorColumn(dataPtr, dataPtr->emulator.returnEraseEffectsForNormalUse(), 2);
+		for (UInt16 i = 0; i < 4; ++i)
+		{
+			Console_TestAssertUpdate(result, ' ' == kThirdRowPtr->textVectorBegin[i],
+										Console_WriteValue, "ECH: erased cell", i);
+		}
+		Console_TestAssertUpdate(result, 'x' == kThirdRowPtr->textVectorBegin[4],
+									Console_WriteValue, "ECH: cell after erased ideographs", kThirdRowPtr->textVectorBegin[4]);
+		
+		Terminal_ReleaseScreen(&screen);
+	}
+	
+	return result;
+}// unitTest_WideCharacters_003
 
 } // anonymous namespace
 
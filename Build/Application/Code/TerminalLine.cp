@@ -33,6 +33,10 @@
 #include "TerminalLine.h"
 #include <UniversalDefines.h>
 
+// standard-C++ includes
+#include <cstdlib>
+#include <new>
+
 // library includes
 #include <Console.h>
 
@@ -43,7 +47,6 @@ namespace {
 
 
 TerminalLine_AttributeInfo&		gEmptyLineAttributes ()		{ static TerminalLine_AttributeInfo x; return x; }
-TerminalLine_Object const&		gEmptyLineData ()			{ static TerminalLine_Object x; return x; }
 
 
 } // anonymous namespace
@@ -52,20 +55,311 @@ TerminalLine_Object const&		gEmptyLineData ()			{ static TerminalLine_Object x;
 #pragma mark Public Methods
 
 /*!
-Creates a new screen buffer line.
+Creates an allocator whose text buffers initially have room
+for the given number of cells (see setCellCapacity()).  The
+default is the maximum, which suits lines that do not belong
+to any particular terminal.
+
+(2023.10)
+*/
+TerminalLine_Allocator::
+TerminalLine_Allocator	(UInt16		inCellCapacity)
+:
+sizeClasses(),
+slabs(),
+slabByteCount(0),
+blockCount(0),
+cellCapacity(returnCellCapacityFor(inCellCapacity)),
+blankLinePtr(nullptr) // see below
+{
+	this->blankLinePtr = this->newLine();
+}// TerminalLine_Allocator constructor
+
+
+/*!
+Frees every slab.  All lines from this allocator should have
+been deleted already (other than the blank line).
+
+(2023.10)
+*/
+TerminalLine_Allocator::
+~TerminalLine_Allocator ()
+{
+	this->deleteLine(this->blankLinePtr), this->blankLinePtr = nullptr;
+	if (0 != this->blockCount)
+	{
+		Console_Warning(Console_WriteValue, "line allocator destroyed while blocks were still in use, count", this->blockCount);
+	}
+	for (void* slabPtr : this->slabs)
+	{
+		std::free(slabPtr);
+	}
+}// TerminalLine_Allocator destructor
+
+
+/*!
+Returns a block of the given size, taking it from the list of
+released blocks of that size if possible and otherwise from a
+new slab.
+
+Throws "std::bad_alloc" if memory is not available.
+
+(2023.10)
+*/
+void*
+TerminalLine_Allocator::
+allocateBlock	(size_t		inByteCount)
+{
+	SizeClass&		sizeClass = this->returnSizeClass(inByteCount);
+	void*			result = nullptr;
+	
+	
+	if (nullptr == sizeClass.firstFreeBlock)
+	{
+		size_t const	kSlabByteCount = (sizeClass.blockSize * sizeClass.nextSlabBlockCount);
+		UInt8*			slabPtr = nullptr;
+		
+		
+		this->slabs.reserve(this->slabs.size() + 1); // so that saving the slab cannot fail
+		slabPtr = REINTERPRET_CAST(std::malloc(kSlabByteCount), UInt8*);
+		if (nullptr == slabPtr)
+		{
+			throw std::bad_alloc();
+		}
+		this->slabs.push_back(slabPtr);
+		this->slabByteCount += kSlabByteCount;
+		
+		// the list is threaded backwards so that blocks are
+		// handed out in address order
+		for (size_t i = sizeClass.nextSlabBlockCount; i > 0; --i)
+		{
+			void*	blockPtr = (slabPtr + ((i - 1) * sizeClass.blockSize));
+			
+			
+			*(REINTERPRET_CAST(blockPtr, void**)) = sizeClass.firstFreeBlock;
+			sizeClass.firstFreeBlock = blockPtr;
+		}
+		
+		// each slab is twice the size of the previous one, up to a limit
+		sizeClass.nextSlabBlockCount = std::max< size_t >(sizeClass.nextSlabBlockCount,
+															std::min< size_t >(2 * sizeClass.nextSlabBlockCount,
+																				kMaximumSlabByteCount / sizeClass.blockSize));
+	}
+	
+	result = sizeClass.firstFreeBlock;
+	sizeClass.firstFreeBlock = *(REINTERPRET_CAST(result, void**));
+	++(this->blockCount);
+	return result;
+}// TerminalLine_Allocator::allocateBlock
+
+
+/*!
+Returns a block with room for the given number of cells, which
+should be a value returned by returnCellCapacityFor().  The
+contents are undefined.  Use releaseCells() when finished.
+
+Throws "std::bad_alloc" if memory is not available.
+
+(2023.10)
+*/
+UniChar*
+TerminalLine_Allocator::
+allocateCells	(UInt16		inCellCount)
+{
+	return REINTERPRET_CAST(this->allocateBlock(inCellCount * sizeof(UniChar)), UniChar*);
+}// TerminalLine_Allocator::allocateCells
+
+
+/*!
+Destroys a line that was returned by newLine().
+
+(2023.10)
+*/
+void
+TerminalLine_Allocator::
+deleteLine	(TerminalLine_Object*	inLinePtr)
+{
+	assert(this == inLinePtr->allocator);
+	inLinePtr->~TerminalLine_Object();
+	this->releaseBlock(inLinePtr, sizeof(TerminalLine_Object));
+}// TerminalLine_Allocator::deleteLine
+
+
+/*!
+Creates a blank line whose text buffer has the current cell
+capacity.  Use deleteLine() to destroy it.
+
+Throws "std::bad_alloc" if memory is not available.
+
+(2023.10)
+*/
+TerminalLine_Object*
+TerminalLine_Allocator::
+newLine ()
+{
+	void*					blockPtr = this->allocateBlock(sizeof(TerminalLine_Object));
+	TerminalLine_Object*	result = nullptr;
+	
+	
+	try
+	{
+		result = new (blockPtr) TerminalLine_Object(*this);
+	}
+	catch (...)
+	{
+		this->releaseBlock(blockPtr, sizeof(TerminalLine_Object));
+		throw;
+	}
+	return result;
+}// TerminalLine_Allocator::newLine
+
+
+/*!
+Makes a block from allocateBlock() available for reuse.  The
+size must match the original request.
+
+(2023.10)
+*/
+void
+TerminalLine_Allocator::
+releaseBlock	(void*		inBlockPtr,
+				 size_t		inByteCount)
+{
+	SizeClass&		sizeClass = this->returnSizeClass(inByteCount);
+	
+	
+	*(REINTERPRET_CAST(inBlockPtr, void**)) = sizeClass.firstFreeBlock;
+	sizeClass.firstFreeBlock = inBlockPtr;
+	--(this->blockCount);
+}// TerminalLine_Allocator::releaseBlock
+
+
+/*!
+Makes a block from allocateCells() available for reuse.  The
+cell count must match the original request.
+
+(2023.10)
+*/
+void
+TerminalLine_Allocator::
+releaseCells	(UniChar*	inCells,
+				 UInt16		inCellCount)
+{
+	this->releaseBlock(inCells, inCellCount * sizeof(UniChar));
+}// TerminalLine_Allocator::releaseCells
+
+
+/*!
+Returns the number of cells that a text buffer should have
+in order to hold the given number of cells: the count is
+limited to "kTerminalLine_MaximumCharacterCount" and then
+rounded up so that no part of a block is wasted.
+
+(2023.10)
+*/
+UInt16
+TerminalLine_Allocator::
+returnCellCapacityFor	(UInt16		inCellCount)
+{
+	UInt16 const	kCellsPerUnit = (kBlockAlignment / sizeof(UniChar));
+	UInt16 const	kCellCount = std::min(std::max(inCellCount, STATIC_CAST(1, UInt16)),
+											STATIC_CAST(kTerminalLine_MaximumCharacterCount, UInt16));
+	
+	
+	return STATIC_CAST(((kCellCount + kCellsPerUnit - 1) / kCellsPerUnit) * kCellsPerUnit, UInt16);
+}// TerminalLine_Allocator::returnCellCapacityFor
+
+
+/*!
+Returns the allocator used by handles that are not given one,
+whose lines have the maximum cell capacity.
+
+(2023.10)
+*/
+TerminalLine_Allocator&
+TerminalLine_Allocator::
+returnDefaultAllocator ()
+{
+	static TerminalLine_Allocator	gDefaultAllocator;
+	
+	
+	return gDefaultAllocator;
+}// TerminalLine_Allocator::returnDefaultAllocator
+
+
+/*!
+Returns the size class for blocks of the given size (rounded
+up to the block alignment), creating the class if necessary.
+The reference is only valid until the next class is created.
+
+(2023.10)
+*/
+TerminalLine_Allocator::SizeClass&
+TerminalLine_Allocator::
+returnSizeClass		(size_t		inByteCount)
+{
+	size_t const	kBlockSize = ((std::max(inByteCount, sizeof(void*)) + kBlockAlignment - 1) / kBlockAlignment) * kBlockAlignment;
+	auto			toClass = std::find_if(this->sizeClasses.begin(), this->sizeClasses.end(),
+											[=](SizeClass const& inClass) { return (kBlockSize == inClass.blockSize); });
+	
+	
+	if (this->sizeClasses.end() == toClass)
+	{
+		SizeClass const		kNewClass =
+							{
+								kBlockSize,
+								std::max< size_t >(1, std::min< size_t >(kFirstSlabBlockCount, kMaximumSlabByteCount / kBlockSize)),
+								nullptr
+							};
+		
+		
+		toClass = this->sizeClasses.insert(this->sizeClasses.end(), kNewClass);
+	}
+	return *toClass;
+}// TerminalLine_Allocator::returnSizeClass
+
+
+/*!
+Increases the number of cells given to new text buffers to
+at least the given count (rounded up; see the method
+returnCellCapacityFor()).  The capacity never decreases.
+
+The shared blank line grows immediately; other existing lines
+are not changed, and grow when a handle to them is dereferenced
+for writing.
+
+Throws "std::bad_alloc" if memory is not available.
+
+(2023.10)
+*/
+void
+TerminalLine_Allocator::
+setCellCapacity		(UInt16		inCellCount)
+{
+	this->cellCapacity = std::max(this->cellCapacity, returnCellCapacityFor(inCellCount));
+	this->blankLinePtr->reserveCells(this->cellCapacity);
+}// TerminalLine_Allocator::setCellCapacity
+
+
+/*!
+Creates a new screen buffer line, using the given allocator
+for the line’s text buffer.  Normally this is only called
+by TerminalLine_Allocator::newLine().
 
 (3.1)
 */
 TerminalLine_Object::
-TerminalLine_Object ()
+TerminalLine_Object		(TerminalLine_Allocator&	inAllocator)
 :
-textVectorBegin(REINTERPRET_CAST(malloc(kTerminalLine_MaximumCharacterCount * sizeof(UniChar)), UniChar*)),
-textVectorEnd(textVectorBegin + kTerminalLine_MaximumCharacterCount),
+textVectorBegin(inAllocator.allocateCells(inAllocator.returnCellCapacity())),
+textVectorEnd(textVectorBegin + inAllocator.returnCellCapacity()),
+softWrapColumnCount(0),
 textCFString(CFStringCreateMutableWithExternalCharactersNoCopy
-				(kCFAllocatorDefault, textVectorBegin, kTerminalLine_MaximumCharacterCount,
-					kTerminalLine_MaximumCharacterCount/* capacity */, kCFAllocatorMalloc/* reallocator/deallocator */),
+				(kCFAllocatorDefault, textVectorBegin, inAllocator.returnCellCapacity(),
+					inAllocator.returnCellCapacity()/* capacity */, kCFAllocatorNull/* buffer belongs to allocator */),
 				CFRetainRelease::kAlreadyRetained),
-attributeInfo(nullptr)
+attributeInfo(nullptr),
+allocator(&inAllocator)
 {
 	assert(textCFString.exists());
 	clearAttributes();
@@ -75,20 +369,22 @@ attributeInfo(nullptr)
 
 /*!
 Creates a new screen buffer line by copying an
-existing one.
+existing one (using the same allocator).
 
 (3.1)
 */
 TerminalLine_Object::
 TerminalLine_Object	(TerminalLine_Object const&		inCopy)
 :
-textVectorBegin(REINTERPRET_CAST(malloc(kTerminalLine_MaximumCharacterCount * sizeof(UniChar)), UniChar*)),
-textVectorEnd(textVectorBegin + kTerminalLine_MaximumCharacterCount),
+textVectorBegin(inCopy.allocator->allocateCells(inCopy.returnCellCapacity())),
+textVectorEnd(textVectorBegin + inCopy.returnCellCapacity()),
+softWrapColumnCount(inCopy.softWrapColumnCount),
 textCFString(CFStringCreateMutableWithExternalCharactersNoCopy
-				(kCFAllocatorDefault, textVectorBegin, kTerminalLine_MaximumCharacterCount,
-					kTerminalLine_MaximumCharacterCount/* capacity */, kCFAllocatorMalloc/* reallocator/deallocator */),
+				(kCFAllocatorDefault, textVectorBegin, inCopy.returnCellCapacity(),
+					inCopy.returnCellCapacity()/* capacity */, kCFAllocatorNull/* buffer belongs to allocator */),
 				CFRetainRelease::kAlreadyRetained),
-attributeInfo(nullptr)
+attributeInfo(nullptr),
+allocator(inCopy.allocator)
 {
 	assert(textCFString.exists());
 	this->copyAttributes(inCopy.attributeInfo);
@@ -108,6 +404,8 @@ TerminalLine_Object::
 ~TerminalLine_Object ()
 {
 	this->clearAttributes();
+	this->textCFString.clear();
+	this->allocator->releaseCells(this->textVectorBegin, this->returnCellCapacity());
 }// TerminalLine_Object destructor
 
 
@@ -128,9 +426,11 @@ operator =	(TerminalLine_Object const&		inCopy)
 		
 		// since the CFMutableStringRef uses the internal buffer, overwriting
 		// the buffer contents will implicitly update the CFStringRef as well;
-		// also, since the lines are all the same size, there is no need to
-		// copy the start/end and size information
-		std::copy(inCopy.textVectorBegin, inCopy.textVectorEnd, this->textVectorBegin);
+		// lines may have different capacities so this line might have to
+		// grow first, and any cells that the copy does not have are blank
+		this->reserveCells(inCopy.returnCellCapacity());
+		std::fill(std::copy(inCopy.textVectorBegin, inCopy.textVectorEnd, this->textVectorBegin), this->textVectorEnd, ' ');
+		this->softWrapColumnCount = inCopy.softWrapColumnCount;
 	}
 	return *this;
 }// TerminalLine_Object::operator =
@@ -223,7 +523,7 @@ createAttributes	(TerminalLine_AttributeInfo const*		inSourceOrNull)
 Returns true if the specified line attribute storage matches any
 known shared source of attributes (such as the set of attributes
 that describe lines with no attributes at all).  This determines
-if returnMutableAttributeVector() will need to do any allocation.
+if returnMutableAttributeRuns() will need to do any allocation.
 
 If a source is shared, its non-"const" version is returned so
 that it may be assigned.  This DOES NOT MEAN IT CAN BE CHANGED!!!
@@ -254,8 +554,88 @@ const
 
 
 /*!
-Resets a line to its initial state (clearing all text and
-removing attribute bits).
+Ensures that the text buffer has room for at least the given
+number of cells (rounded up; see the method returnCellCapacityFor()
+of TerminalLine_Allocator).  Any new cells are blank, and the
+string from returnCFStringRef() is updated to use the new buffer.
+
+Throws "std::bad_alloc" if memory is not available.
+
+(2023.10)
+*/
+void
+TerminalLine_Object::
+reserveCells	(UInt16		inCellCount)
+{
+	UInt16 const	kOldCapacity = this->returnCellCapacity();
+	
+	
+	if (inCellCount > kOldCapacity)
+	{
+		UInt16 const	kNewCapacity = TerminalLine_Allocator::returnCellCapacityFor(inCellCount);
+		UniChar* const	kNewCells = this->allocator->allocateCells(kNewCapacity);
+		
+		
+		std::fill(std::copy(this->textVectorBegin, this->textVectorEnd, kNewCells), kNewCells + kNewCapacity, ' ');
+		this->allocator->releaseCells(this->textVectorBegin, kOldCapacity);
+		this->textVectorBegin = kNewCells;
+		this->textVectorEnd = (kNewCells + kNewCapacity);
+		CFStringSetExternalCharactersNoCopy(this->textCFString.returnCFMutableStringRef(), kNewCells, kNewCapacity, kNewCapacity/* capacity */);
+	}
+}// TerminalLine_Object::reserveCells
+
+
+/*!
+Returns the approximate number of bytes allocated for this
+line, including its text buffer and any unique attributes
+(but not the overhead of the string object that wraps the
+text buffer).
+
+(2023.10)
+*/
+size_t
+TerminalLine_Object::
+returnByteCount ()
+const
+{
+	size_t		result = sizeof(*this) + (this->returnCellCapacity() * sizeof(UniChar));
+	
+	
+	if (false == isSharedAttributeSource(this->attributeInfo))
+	{
+		result += sizeof(TerminalLine_AttributeInfo);
+		result += this->attributeInfo->attributeRuns.returnByteCount();
+	}
+	return result;
+}// TerminalLine_Object::returnByteCount
+
+
+/*!
+Returns the number of cells up to and including the last
+cell that is not a space; this is zero for a blank line.
+Attributes are not considered.
+
+(2023.10)
+*/
+UInt16
+TerminalLine_Object::
+returnTrimmedCellCount ()
+const
+{
+	TerminalLine_TextIterator	pastLastCell = this->textVectorEnd;
+	
+	
+	while ((pastLastCell != this->textVectorBegin) && (' ' == *(pastLastCell - 1)))
+	{
+		--pastLastCell;
+	}
+	return STATIC_CAST(pastLastCell - this->textVectorBegin, UInt16);
+}// TerminalLine_Object::returnTrimmedCellCount
+
+
+/*!
+Resets a line to its initial state (clearing all text,
+removing attribute bits and forgetting any soft wrap).
 
 (3.1)
 */
@@ -264,10 +644,184 @@ TerminalLine_Object::
 structureInitialize ()
 {
 	std::fill(textVectorBegin, textVectorEnd, ' ');
+	softWrapColumnCount = 0;
 	clearAttributes();
 }// TerminalLine_Object::structureInitialize
 
 
+/*!
+Creates a compact copy of the given line.
+
+(2023.10)
+*/
+TerminalLine_CompactLine::
+TerminalLine_CompactLine	(TerminalLine_Object const&		inLine)
+:
+text(),
+attributeRuns(),
+globalAttributes(),
+cellCount(0),
+softWrapColumnCount(inLine.softWrapColumnCount)
+{
+	TerminalLine_TextIterator	pastLastCell = inLine.textVectorEnd;
+	
+	
+	// trailing spaces are implied
+	while ((pastLastCell != inLine.textVectorBegin) && (' ' == *(pastLastCell - 1)))
+	{
+		--pastLastCell;
+	}
+	this->cellCount = STATIC_CAST(pastLastCell - inLine.textVectorBegin, UInt16);
+	
+	// encode each cell as UTF-8 (surrogates are encoded separately)
+	this->text.reserve(this->cellCount);
+	for (TerminalLine_TextIterator toCell = inLine.textVectorBegin; toCell != pastLastCell; ++toCell)
+	{
+		UniChar const	kValue = *toCell;
+		
+		
+		if (kValue < 0x80)
+		{
+			this->text.push_back(STATIC_CAST(kValue, char));
+		}
+		else if (kValue < 0x800)
+		{
+			this->text.push_back(STATIC_CAST(0xC0 | (kValue >> 6), char));
+			this->text.push_back(STATIC_CAST(0x80 | (kValue & 0x3F), char));
+		}
+		else
+		{
+			this->text.push_back(STATIC_CAST(0xE0 | (kValue >> 12), char));
+			this->text.push_back(STATIC_CAST(0x80 | ((kValue >> 6) & 0x3F), char));
+			this->text.push_back(STATIC_CAST(0x80 | (kValue & 0x3F), char));
+		}
+	}
+	this->text.shrink_to_fit();
+	
+	// attributes are only stored when they are not shared
+	if (false == inLine.isSharedAttributeSource(inLine.attributeInfo))
+	{
+		TerminalLine_AttributeRunList const&	kRuns = inLine.attributeInfo->attributeRuns;
+		
+		
+		this->globalAttributes = inLine.attributeInfo->globalAttributes;
+		this->attributeRuns.assign(kRuns.begin(), kRuns.end());
+	}
+}// TerminalLine_CompactLine constructor
+
+
+/*!
+Writes the text of the line, without any trailing spaces,
+to the given buffer (which must have room for at least
+"kTerminalLine_MaximumCharacterCount" values), and returns
+the number of characters written.
+
+(2023.10)
+*/
+UInt16
+TerminalLine_CompactLine::
+copyCharacters	(UniChar*	outCells)
+const
+{
+	this->decodeText(outCells);
+	return this->cellCount;
+}// TerminalLine_CompactLine::copyCharacters
+
+
+/*!
+Writes the encoded cells to the given buffer, which must
+have room for "cellCount" values.
+
+(2023.10)
+*/
+void
+TerminalLine_CompactLine::
+decodeText	(UniChar*	outCells)
+const
+{
+	UInt8 const*	toByte = REINTERPRET_CAST(this->text.data(), UInt8 const*);
+	UInt8 const*	pastEnd = toByte + this->text.size();
+	
+	
+	// the encoding is produced by the constructor so it is
+	// trusted to be complete and valid
+	while (toByte != pastEnd)
+	{
+		UInt8 const		kLead = *toByte++;
+		
+		
+		if (kLead < 0x80)
+		{
+			*outCells++ = kLead;
+		}
+		else if (kLead < 0xE0)
+		{
+			*outCells++ = STATIC_CAST(((kLead & 0x1F) << 6) | (toByte[0] & 0x3F), UniChar);
+			toByte += 1;
+		}
+		else
+		{
+			*outCells++ = STATIC_CAST(((kLead & 0x0F) << 12) | ((toByte[0] & 0x3F) << 6) | (toByte[1] & 0x3F), UniChar);
+			toByte += 2;
+		}
+	}
+}// TerminalLine_CompactLine::decodeText
+
+
+/*!
+Overwrites the given line with the contents that were
+captured when this compact copy was created.  The line is
+enlarged if it has fewer cells than the original.
+
+(2023.10)
+*/
+void
+TerminalLine_CompactLine::
+restore		(TerminalLine_Object&	inoutLine)
+const
+{
+	inoutLine.reserveCells(this->cellCount);
+	inoutLine.structureInitialize();
+	this->decodeText(inoutLine.textVectorBegin);
+	inoutLine.softWrapColumnCount = this->softWrapColumnCount;
+	if (false == this->attributeRuns.empty())
+	{
+		TerminalLine_AttributeRunList::RunList::size_type const		kRunCount = this->attributeRuns.size();
+		
+		
+		// (the line has just released any unique attributes)
+		inoutLine.createAttributes(nullptr);
+		inoutLine.attributeInfo->globalAttributes = this->globalAttributes;
+		for (TerminalLine_AttributeRunList::RunList::size_type i = 0; i < kRunCount; ++i)
+		{
+			UInt16 const	kPastEndCell = ((i + 1) < kRunCount)
+											? this->attributeRuns[i + 1].firstCell
+											: STATIC_CAST(kTerminalLine_MaximumCharacterCount, UInt16);
+			
+			
+			inoutLine.attributeInfo->attributeRuns.assign(this->attributeRuns[i].firstCell, kPastEndCell,
+															this->attributeRuns[i].attributes);
+		}
+	}
+}// TerminalLine_CompactLine::restore
+
+
+/*!
+Returns the approximate number of bytes allocated for this
+compact line.
+
+(2023.10)
+*/
+size_t
+TerminalLine_CompactLine::
+returnByteCount ()
+const
+{
+	return (sizeof(*this) + this->text.capacity() +
+			(this->attributeRuns.capacity() * sizeof(TerminalLine_AttributeRunList::Run)));
+}// TerminalLine_CompactLine::returnByteCount
+
+
 /*!
 Creates a new screen buffer line handle by making it point
 to a shared, immutable empty-line data structure.  This
@@ -280,12 +834,28 @@ unique allocations are performed).
 TerminalLine_Handle::
 TerminalLine_Handle ()
 :
-linePtr(nullptr) // see below
+linePtr(TerminalLine_Allocator::returnDefaultAllocator().returnBlankLine())
 {
-	this->reset(); // set to shared empty-line data
+	assert(this->isDefault());
 }// TerminalLine_Handle constructor
 
 
+/*!
+Creates a new screen buffer line handle that shares the
+blank line of the given allocator until it is changed;
+at that point, the allocator provides the unique line.
+
+(2023.10)
+*/
+TerminalLine_Handle::
+TerminalLine_Handle		(TerminalLine_Allocator&	inAllocator)
+:
+linePtr(inAllocator.returnBlankLine())
+{
+	assert(this->isDefault());
+}// TerminalLine_Handle allocator constructor
+
+
 /*!
 Handles copy construction by making the data pointer
 unique if necessary.  (Should be consistent with all
@@ -296,23 +866,38 @@ other code that mutates the pointer value.)
 TerminalLine_Handle::
 TerminalLine_Handle		(TerminalLine_Handle const&		inOther)
 :
-linePtr(nullptr) // see below
+linePtr(inOther.linePtr->allocator->returnBlankLine()) // shared empty-line data (but see below)
 {
-	if (inOther.isDefault())
-	{
-		this->reset(); // set to shared empty-line data
-	}
-	else
+	unless (inOther.isDefault())
 	{
 		// make unique (should be consistent with the allocation
 		// behavior of the non-const "operator *()")
-		linePtr = new TerminalLine_Object();
+		linePtr = linePtr->allocator->newLine();
 		assert(false == this->isDefault());
 		//Console_WriteValueAddress("upon copy, allocating unique line data for handle", this); // debug
 	}
 }// TerminalLine_Handle copy constructor
 
 
+/*!
+Handles move construction by taking ownership of the
+other handle’s line data, leaving the other handle in
+the shared empty-line state.  Unlike a copy, this keeps
+the line contents; it allows containers to relocate
+lines without reallocating or clearing them.
+
+(2023.10)
+*/
+TerminalLine_Handle::
+TerminalLine_Handle		(TerminalLine_Handle&&		inOther)
+noexcept
+:
+linePtr(inOther.linePtr)
+{
+	inOther.reset(); // set to shared empty-line data
+}// TerminalLine_Handle move constructor
+
+
 /*!
 Creates a new screen buffer line handle by making it point
 to a shared, immutable empty-line data structure.  This
@@ -331,7 +916,7 @@ TerminalLine_Handle::
 		// they may simply *mark* an allocated line as available
 		// and not necessarily deallocate (the behavior of the
 		// non-const "operator *()" should be consistent)
-		delete linePtr, linePtr = nullptr;
+		linePtr->allocator->deleteLine(linePtr), linePtr = nullptr;
 	}
 }// TerminalLine_Handle destructor
 
@@ -339,7 +924,9 @@ TerminalLine_Handle::
 /*!
 Handles assignment by making the data pointer unique
 if necessary.  (Should be consistent with all other
-code that mutates the pointer value.)
+code that mutates the pointer value.)  Any unique line
+that this handle had is destroyed, and the allocator
+of the other handle is used from now on.
 
 (4.1)
 */
@@ -347,22 +934,42 @@ TerminalLine_Handle&
 TerminalLine_Handle::
 operator = (TerminalLine_Handle const&		inOther)
 {
-	if (inOther.isDefault())
+	if (this != &inOther)
 	{
-		this->reset(); // set to shared empty-line data
-	}
-	else
-	{
-		// make unique (should be consistent with the allocation
-		// behavior of the non-const "operator *()")
-		linePtr = new TerminalLine_Object();
-		assert(false == this->isDefault());
-		//Console_WriteValueAddress("upon assignment, allocating unique line data for handle", this); // debug
+		TerminalLine_Handle		releasedLine(std::move(*this)); // destroyed on return
+		
+		
+		this->linePtr = inOther.linePtr->allocator->returnBlankLine(); // shared empty-line data
+		unless (inOther.isDefault())
+		{
+			// make unique (should be consistent with the allocation
+			// behavior of the non-const "operator *()")
+			linePtr = linePtr->allocator->newLine();
+			assert(false == this->isDefault());
+			//Console_WriteValueAddress("upon assignment, allocating unique line data for handle", this); // debug
+		}
 	}
 	return *this;
 }// TerminalLine_Handle::operator =
 
 
+/*!
+Handles move assignment by exchanging line data with the
+other handle; the other handle therefore owns (and will
+eventually destroy) whatever this handle referred to.
+
+(2023.10)
+*/
+TerminalLine_Handle&
+TerminalLine_Handle::
+operator = (TerminalLine_Handle&&		inOther)
+noexcept
+{
+	this->swap(inOther);
+	return *this;
+}// TerminalLine_Handle::operator = (move)
+
+
 /*!
 Returns the line data that this handle refers to.
 
@@ -372,6 +979,11 @@ allocate a unique value and return that.  Always use "const"
 references to read lines if you do not need to make changes so
 that handles will share the empty line as long as possible.
 
+Similarly, a line with fewer cells than its allocator now gives
+to new lines (because the terminal has become wider since the
+line was created) is enlarged before it is returned; so any line
+returned by this version has room for the full terminal width.
+
 NOTE: The "const" version is trivial and inlined, as it does
 not have the same complex semantics.
 
@@ -385,10 +997,14 @@ operator * ()
 	{
 		// copy-on-write semantics; auto-allocate a unique version
 		// IMPORTANT: should match logic of destructor
-		linePtr = new TerminalLine_Object();
+		linePtr = linePtr->allocator->newLine();
 		assert(false == this->isDefault());
 		//Console_WriteValueAddress("allocating unique line data for handle", this); // debug
 	}
+	else if (linePtr->returnCellCapacity() < linePtr->allocator->returnCellCapacity())
+	{
+		linePtr->reserveCells(linePtr->allocator->returnCellCapacity());
+	}
 	return *linePtr;
 }// TerminalLine_Handle::operator * (non-const)
 
@@ -405,14 +1021,15 @@ TerminalLine_Handle::
 isDefault ()
 const
 {
-	return (&gEmptyLineData() == this->linePtr);
+	return (this->linePtr->allocator->returnBlankLine() == this->linePtr);
 }// TerminalLine_Handle::isDefault
 
 
 /*!
 Conceptually the same as deleting a heap-allocated line structure
 except that the resulting object may be marked for reuse instead
-(and the line data may not even be on the heap).
+(and the line data may not even be on the heap).  The handle then
+shares the blank line of the same allocator.
 
 (4.1)
 */
@@ -423,8 +1040,23 @@ reset ()
 	// IMPORTANT: immutability of shared empty-line data is ensured
 	// by the code in this class; in any case, the shared empty line
 	// must NEVER be modified (otherwise all empty lines would change)
-	this->linePtr = CONST_CAST(&gEmptyLineData(), TerminalLine_Object*);
+	this->linePtr = this->linePtr->allocator->returnBlankLine();
 	assert(this->isDefault());
 }// TerminalLine_Handle::reset
 
+
+/*!
+Exchanges the line data of two handles without allocating
+or copying anything.
+
+(2023.10)
+*/
+void
+TerminalLine_Handle::
+swap	(TerminalLine_Handle&	inOther)
+noexcept
+{
+	std::swap(this->linePtr, inOther.linePtr);
+}// TerminalLine_Handle::swap
+
 // BELOW IS REQUIRED NEWLINE TO END FILE
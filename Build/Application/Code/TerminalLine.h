@@ -40,7 +40,10 @@
 #pragma once
 
 // standard-C++ includes
+#include <algorithm>
 #include <list>
+#include <string>
+#include <utility>
 #include <vector>
 
 // library includes
@@ -56,14 +59,84 @@
 
 enum
 {
-	// NOTE: this is a constant for historical reasons but that may change
-	kTerminalLine_MaximumCharacterCount = 256		//!< maximum number of columns allowed; must be a multiple of "kMy_TabStop"
+	kTerminalLine_MaximumCharacterCount = 1024		//!< maximum number of columns allowed; must be a multiple of "kMy_TabStop"
+													//!  (lines only allocate as many cells as their terminal uses)
 };
 
 #pragma mark Types
 
 typedef UniChar*								TerminalLine_TextIterator;
-typedef std::vector< TextAttributes_Object >	TerminalLine_TextAttributesList;
+
+struct TerminalLine_Object;
+
+
+/*!
+The attributes of every cell on a line, stored as a sorted
+list of “style runs”: each run gives the attributes of all
+cells from its first cell up to the first cell of the next
+run (or the end of the line).  Adjacent runs never have the
+same attributes, so a line with uniform attributes has one
+run no matter how many cells it has.
+
+Changes split runs where necessary and merge runs that have
+become equal.  Finding the attributes of one cell is a binary
+search, and iterating over runs takes time proportional to
+the number of runs instead of the number of cells.
+*/
+class TerminalLine_AttributeRunList
+{
+public:
+	struct Run
+	{
+		UInt16					firstCell;	//!< zero-based cell where the run begins
+		TextAttributes_Object	attributes;	//!< attributes of every cell in the run
+	};
+	
+	typedef std::vector< Run >			RunList;
+	typedef RunList::const_iterator		const_iterator;
+	
+	inline TerminalLine_AttributeRunList ();
+	
+	inline void
+	assign (UInt16, UInt16, TextAttributes_Object const&);
+	
+	inline const_iterator
+	begin () const;
+	
+	inline const_iterator
+	end () const;
+	
+	template < typename change_function >
+	inline void
+	modify (UInt16, UInt16, change_function);
+	
+	inline void
+	move (UInt16, UInt16, UInt16);
+	
+	inline TextAttributes_Object const&
+	returnAttributesForCell (UInt16) const;
+	
+	inline size_t
+	returnByteCount () const;
+	
+	inline UInt16
+	returnPastEndCell (const_iterator) const;
+	
+	inline RunList::size_type
+	size () const;
+
+private:
+	RunList		runs;	//!< sorted by "firstCell"; never empty, and the first run always begins at cell zero
+	
+	inline void
+	mergeRuns (RunList::size_type, RunList::size_type);
+	
+	inline RunList::size_type
+	returnRunIndexForCell (UInt16) const;
+	
+	inline RunList::size_type
+	splitAt (UInt16);
+};
 
 
 /*!
@@ -79,6 +152,7 @@ instance, even if the lines themselves are unique.
 */
 struct TerminalLine_AttributeInfo
 {
+	friend struct TerminalLine_CompactLine;
 	friend struct TerminalLine_Object;
 	
 	inline TerminalLine_AttributeInfo ();
@@ -87,7 +161,108 @@ struct TerminalLine_AttributeInfo
 
 private:
 	TextAttributes_Object				globalAttributes;   //!< attributes that apply to every character (e.g. double-sized text)
-	TerminalLine_TextAttributesList		attributeVector;	//!< where character attributes exist
+	TerminalLine_AttributeRunList		attributeRuns;		//!< where character attributes exist
+};
+
+
+/*!
+Supplies the memory for the lines of one terminal.  Line
+objects and text buffers are carved out of large “slabs”
+of equal blocks, and released blocks are kept for reuse,
+so lines are normally created and destroyed without any
+call to malloc().  Slabs are only freed when the allocator
+is destroyed.
+
+Text buffers have room for the current cell capacity (see
+setCellCapacity()), which the terminal keeps equal to the
+widest that it has been, so a narrow terminal uses a small
+fraction of the memory of a wide one.  The capacity never
+shrinks.  Lines that were created before the capacity grew
+are enlarged when a handle next allows them to be changed
+(see TerminalLine_Handle).
+
+The allocator also owns the blank line that its handles
+share until they are changed, so it must outlive every
+handle that refers to it.  It is not thread-safe; lines
+should only be created or changed by one thread.
+*/
+class TerminalLine_Allocator
+{
+public:
+	explicit TerminalLine_Allocator (UInt16 = kTerminalLine_MaximumCharacterCount);
+	~TerminalLine_Allocator ();
+	
+	TerminalLine_Allocator (TerminalLine_Allocator const&) = delete;
+	
+	TerminalLine_Allocator&
+	operator = (TerminalLine_Allocator const&) = delete;
+	
+	UniChar*
+	allocateCells (UInt16);
+	
+	void
+	deleteLine (TerminalLine_Object*);
+	
+	TerminalLine_Object*
+	newLine ();
+	
+	void
+	releaseCells (UniChar*, UInt16);
+	
+	inline TerminalLine_Object*
+	returnBlankLine () const;
+	
+	inline size_t
+	returnBlockCount () const;
+	
+	inline size_t
+	returnByteCount () const;
+	
+	inline UInt16
+	returnCellCapacity () const;
+	
+	static UInt16
+	returnCellCapacityFor (UInt16);
+	
+	static TerminalLine_Allocator&
+	returnDefaultAllocator ();
+	
+	inline size_t
+	returnSlabCount () const;
+	
+	void
+	setCellCapacity (UInt16);
+
+private:
+	struct SizeClass
+	{
+		size_t		blockSize;			//!< number of bytes in every block of this class
+		size_t		nextSlabBlockCount;	//!< number of blocks to carve out of the next slab
+		void*		firstFreeBlock;		//!< start of a list threaded through the released blocks
+	};
+	
+	enum
+	{
+		kBlockAlignment = 16,				//!< every block size is a multiple of this
+		kFirstSlabBlockCount = 16,			//!< slabs start small so that small terminals stay small...
+		kMaximumSlabByteCount = 64 * 1024	//!< ...and double until they reach this size
+	};
+	
+	std::vector< SizeClass >	sizeClasses;	//!< a handful of classes (one for lines, one per cell capacity)
+	std::vector< void* >		slabs;			//!< every allocation from the system, for the destructor
+	size_t						slabByteCount;	//!< total size of "slabs"
+	size_t						blockCount;		//!< number of blocks that are currently in use
+	UInt16						cellCapacity;	//!< number of cells given to new text buffers
+	TerminalLine_Object*		blankLinePtr;	//!< shared by handles until they are changed
+	
+	void*
+	allocateBlock (size_t);
+	
+	void
+	releaseBlock (void*, size_t);
+	
+	SizeClass&
+	returnSizeClass (size_t);
 };
 
 
@@ -112,23 +287,25 @@ NOTE:	Traditionally NCSA Telnet has used bits to
 		represent the style of every single terminal
 		cell.  This is memory-inefficient (albeit
 		convenient at times), and also worsens linearly
-		as the size of the screen increases.  It may be
-		nice to implement a “style run”-based approach
-		that sets attributes for ranges of text (which
-		is pretty much how they’re defined anyway, when
-		VT sequences arrive).  That would greatly
-		reduce the number of attribute words in memory!
-		The first part of this is implemented, in the
-		sense that Terminal Views only see terminal data
-		in terms of style runs (see the new routine
-		Terminal_ForEachLikeAttributeRun()).
+		as the size of the screen increases.  Attributes
+		are now stored as style runs instead (see
+		TerminalLine_AttributeRunList), which is pretty
+		much how they are defined anyway when VT
+		sequences arrive, and is also how Terminal Views
+		see them (see Terminal_ForEachLikeAttributeRun()).
 */
 struct TerminalLine_Object
 {
+	friend class TerminalLine_Allocator;
+	friend struct TerminalLine_CompactLine;
+	friend struct TerminalLine_Handle;
+	
 	TerminalLine_TextIterator		textVectorBegin;	//!< where characters exist
 	TerminalLine_TextIterator		textVectorEnd;		//!< for convenience; past-the-end of this buffer
+	UInt16							softWrapColumnCount;	//!< if nonzero, text was automatically wrapped after this many
+															//!  columns and continues on the following line
 	
-	TerminalLine_Object ();
+	explicit TerminalLine_Object (TerminalLine_Allocator&);
 	~TerminalLine_Object ();
 	
 	TerminalLine_Object (TerminalLine_Object const&);
@@ -160,8 +337,11 @@ struct TerminalLine_Object
 	inline void
 	replaceCell (StringUtilities_Cell, CFStringRef, TextAttributes_Object const&);
 	
-	inline TerminalLine_TextAttributesList const&
-	returnAttributeVector () const;
+	inline void
+	replaceCell (StringUtilities_Cell, UniChar, TextAttributes_Object const&);
+	
+	inline TerminalLine_AttributeRunList const&
+	returnAttributeRuns () const;
 	
 	inline CFStringRef
 	returnCFStringRef() const;
@@ -169,12 +349,27 @@ struct TerminalLine_Object
 	inline TextAttributes_Object
 	returnGlobalAttributes () const;
 	
-	inline TerminalLine_TextAttributesList&
-	returnMutableAttributeVector ();
+	inline TerminalLine_AttributeRunList&
+	returnMutableAttributeRuns ();
 	
 	inline TextAttributes_Object&
 	returnMutableGlobalAttributes ();
 	
+	size_t
+	returnByteCount () const;
+	
+	inline UInt16
+	returnCellCapacity () const;
+	
+	UInt16
+	returnTrimmedCellCount () const;
+	
+	void
+	reserveCells (UInt16);
+	
+	inline bool
+	sharesUniformAttributes (TextAttributes_Object const&) const;
+	
 	void
 	structureInitialize ();
 
@@ -182,6 +377,7 @@ private:
 	CFRetainRelease					textCFString;		//!< mutable string object for which "textVectorBegin" is the storage,
 														//!  so the buffer can be manipulated directly if desired
 	TerminalLine_AttributeInfo*		attributeInfo;
+	TerminalLine_Allocator*			allocator;			//!< source of this line and its text buffer
 	
 	void
 	copyAttributes (TerminalLine_AttributeInfo const*);
@@ -201,6 +397,51 @@ private:
 };
 
 
+/*!
+An immutable, compact copy of a TerminalLine_Object, for
+lines that are not expected to change again (such as old
+scrollback lines).  The text is kept as UTF-8 without any
+trailing spaces, and attributes as runs of equal values,
+so a typical line needs tens of bytes instead of the many
+hundreds used by a complete line.
+
+Each cell is encoded separately (so even an unpaired
+surrogate survives a round trip through this form).
+*/
+struct TerminalLine_CompactLine
+{
+	explicit TerminalLine_CompactLine (TerminalLine_Object const&);
+	
+	UInt16
+	copyCharacters (UniChar*) const;
+	
+	void
+	restore (TerminalLine_Object&) const;
+	
+	inline TerminalLine_AttributeRunList::RunList const&
+	returnAttributeRuns () const;
+	
+	size_t
+	returnByteCount () const;
+	
+	inline UInt16
+	returnCellCount () const;
+	
+	inline UInt16
+	returnSoftWrapColumnCount () const;
+
+private:
+	std::string								text;				//!< UTF-8 encoding of every cell up to the last non-space
+	TerminalLine_AttributeRunList::RunList	attributeRuns;		//!< empty if the line uses shared (default) attributes
+	TextAttributes_Object					globalAttributes;	//!< only used if "attributeRuns" is not empty
+	UInt16									cellCount;			//!< number of cells encoded in "text"
+	UInt16									softWrapColumnCount;	//!< copy of TerminalLine_Object::softWrapColumnCount
+	
+	void
+	decodeText (UniChar*) const;
+};
+
+
 /*!
 Semantically this is like a pointer to TerminalLine_Object
 except that it has special nullability support.
@@ -209,17 +450,27 @@ By default, ALL handles that are not constructed with a
 particular pointer will be assigned to the SAME global,
 shared, empty-line data.
 
+A handle can also be given the allocator of a terminal,
+in which case it shares the blank line of that allocator
+and any line it creates comes from that allocator.  This
+is passed on to copies and to handles that are reset.
 */
 struct TerminalLine_Handle
 {
 	TerminalLine_Handle ();
+	explicit TerminalLine_Handle (TerminalLine_Allocator&);
 	~TerminalLine_Handle ();
 	
 	TerminalLine_Handle	(TerminalLine_Handle const&);
 	
+	TerminalLine_Handle	(TerminalLine_Handle&&) noexcept;
+	
 	TerminalLine_Handle&
 	operator = (TerminalLine_Handle const&);
 	
+	TerminalLine_Handle&
+	operator = (TerminalLine_Handle&&) noexcept;
+	
 	inline TerminalLine_Object const&
 	operator * () const;
 	
@@ -249,6 +500,9 @@ struct TerminalLine_Handle
 	
 	void
 	reset ();
+	
+	void
+	swap (TerminalLine_Handle&) noexcept;
 
 private:
 	mutable TerminalLine_Object*	linePtr;
@@ -258,6 +512,306 @@ private:
 
 #pragma mark Inline Methods
 
+/*!
+Creates a list with a single run of default attributes
+that covers the entire line.
+
+(2023.10)
+*/
+TerminalLine_AttributeRunList::
+TerminalLine_AttributeRunList ()
+:
+runs(1, Run{0, TextAttributes_Object()})
+{
+}// TerminalLine_AttributeRunList constructor
+
+
+/*!
+Gives the specified attributes to every cell from the first
+cell up to (but not including) the past-the-end cell.
+
+(2023.10)
+*/
+void
+TerminalLine_AttributeRunList::
+assign	(UInt16							inFirstCell,
+		 UInt16							inPastEndCell,
+		 TextAttributes_Object const&	inAttributes)
+{
+	UInt16 const	kPastEndCell = std::min(inPastEndCell, STATIC_CAST(kTerminalLine_MaximumCharacterCount, UInt16));
+	
+	
+	if (inFirstCell < kPastEndCell)
+	{
+		RunList::size_type const	kContainingRun = returnRunIndexForCell(inFirstCell);
+		
+		
+		// the most common case is a cell that already has
+		// the right attributes, which requires no change
+		if ((runs[kContainingRun].attributes != inAttributes) ||
+			(returnPastEndCell(runs.begin() + kContainingRun) < kPastEndCell))
+		{
+			RunList::size_type const	kFirstRun = splitAt(inFirstCell);
+			RunList::size_type const	kPastEndRun = splitAt(kPastEndCell);
+			
+			
+			runs[kFirstRun].attributes = inAttributes;
+			runs.erase(runs.begin() + kFirstRun + 1, runs.begin() + kPastEndRun);
+			mergeRuns(kFirstRun, kFirstRun + 1);
+		}
+	}
+}// TerminalLine_AttributeRunList::assign
+
+
+/*!
+For iterating over runs; see also returnPastEndCell().
+
+(2023.10)
+*/
+TerminalLine_AttributeRunList::const_iterator
+TerminalLine_AttributeRunList::
+begin ()
+const
+{
+	return runs.begin();
+}// TerminalLine_AttributeRunList::begin
+
+
+/*!
+For iterating over runs.
+
+(2023.10)
+*/
+TerminalLine_AttributeRunList::const_iterator
+TerminalLine_AttributeRunList::
+end ()
+const
+{
+	return runs.end();
+}// TerminalLine_AttributeRunList::end
+
+
+/*!
+Merges equal neighbors among the runs in the given range
+of indices and the runs immediately before and after it.
+
+(2023.10)
+*/
+void
+TerminalLine_AttributeRunList::
+mergeRuns	(RunList::size_type		inFirstRun,
+			 RunList::size_type		inPastEndRun)
+{
+	RunList::size_type const	kFirstRun = (inFirstRun > 0) ? (inFirstRun - 1) : 0;
+	RunList::size_type const	kLastRun = std::min(inPastEndRun, runs.size() - 1);
+	RunList::size_type			keptRun = kFirstRun;
+	
+	
+	for (RunList::size_type i = (kFirstRun + 1); i <= kLastRun; ++i)
+	{
+		if (runs[i].attributes != runs[keptRun].attributes)
+		{
+			++keptRun;
+			runs[keptRun] = runs[i];
+		}
+	}
+	runs.erase(runs.begin() + keptRun + 1, runs.begin() + kLastRun + 1);
+}// TerminalLine_AttributeRunList::mergeRuns
+
+
+/*!
+Calls the given function on the attributes of every cell
+from the first cell up to (but not including) the past-the-
+end cell; the function is given a "TextAttributes_Object&"
+that it can change, and it is called once per affected run
+(not once per cell).
+
+(2023.10)
+*/
+template < typename change_function >
+void
+TerminalLine_AttributeRunList::
+modify	(UInt16				inFirstCell,
+		 UInt16				inPastEndCell,
+		 change_function	inChangeFunction)
+{
+	UInt16 const	kPastEndCell = std::min(inPastEndCell, STATIC_CAST(kTerminalLine_MaximumCharacterCount, UInt16));
+	
+	
+	if (inFirstCell < kPastEndCell)
+	{
+		RunList::size_type const	kFirstRun = splitAt(inFirstCell);
+		RunList::size_type const	kPastEndRun = splitAt(kPastEndCell);
+		
+		
+		for (RunList::size_type i = kFirstRun; i < kPastEndRun; ++i)
+		{
+			inChangeFunction(runs[i].attributes);
+		}
+		mergeRuns(kFirstRun, kPastEndRun);
+	}
+}// TerminalLine_AttributeRunList::modify
+
+
+/*!
+Copies the attributes of the given range of cells to the
+range starting at the destination cell; the ranges may
+overlap.  Anything copied beyond the end of the line is
+ignored.
+
+(2023.10)
+*/
+void
+TerminalLine_AttributeRunList::
+move	(UInt16		inSourceFirstCell,
+		 UInt16		inSourcePastEndCell,
+		 UInt16		inDestinationFirstCell)
+{
+	UInt16 const	kSourcePastEndCell = std::min(inSourcePastEndCell, STATIC_CAST(kTerminalLine_MaximumCharacterCount, UInt16));
+	
+	
+	if (inSourceFirstCell < kSourcePastEndCell)
+	{
+		UInt16 const	kDestinationPastEndCell = STATIC_CAST(inDestinationFirstCell + (kSourcePastEndCell - inSourceFirstCell), UInt16);
+		RunList			movedRuns;
+		
+		
+		// since the ranges may overlap, the source runs are
+		// captured (with destination positions) before any
+		// of them are changed
+		for (RunList::size_type i = returnRunIndexForCell(inSourceFirstCell);
+				((i < runs.size()) && (runs[i].firstCell < kSourcePastEndCell)); ++i)
+		{
+			UInt16 const	kOffset = STATIC_CAST(std::max(runs[i].firstCell, inSourceFirstCell) - inSourceFirstCell, UInt16);
+			
+			
+			movedRuns.push_back(Run{STATIC_CAST(inDestinationFirstCell + kOffset, UInt16), runs[i].attributes});
+		}
+		
+		for (RunList::size_type i = 0; i < movedRuns.size(); ++i)
+		{
+			UInt16 const	kPastEndCell = ((i + 1) < movedRuns.size())
+											? movedRuns[i + 1].firstCell
+											: kDestinationPastEndCell;
+			
+			
+			assign(movedRuns[i].firstCell, kPastEndCell, movedRuns[i].attributes);
+		}
+	}
+}// TerminalLine_AttributeRunList::move
+
+
+/*!
+Returns the attributes of the specified cell.
+
+(2023.10)
+*/
+TextAttributes_Object const&
+TerminalLine_AttributeRunList::
+returnAttributesForCell		(UInt16		inCell)
+const
+{
+	return runs[returnRunIndexForCell(inCell)].attributes;
+}// TerminalLine_AttributeRunList::returnAttributesForCell
+
+
+/*!
+Returns the number of bytes allocated for runs.
+
+(2023.10)
+*/
+size_t
+TerminalLine_AttributeRunList::
+returnByteCount ()
+const
+{
+	return (runs.capacity() * sizeof(Run));
+}// TerminalLine_AttributeRunList::returnByteCount
+
+
+/*!
+Returns the cell after the last cell of the given run.
+
+(2023.10)
+*/
+UInt16
+TerminalLine_AttributeRunList::
+returnPastEndCell	(const_iterator		inRun)
+const
+{
+	const_iterator		nextRun = inRun;
+	
+	
+	++nextRun;
+	return (runs.end() == nextRun)
+			? STATIC_CAST(kTerminalLine_MaximumCharacterCount, UInt16)
+			: nextRun->firstCell;
+}// TerminalLine_AttributeRunList::returnPastEndCell
+
+
+/*!
+Returns the index of the run that contains the given cell.
+
+(2023.10)
+*/
+TerminalLine_AttributeRunList::RunList::size_type
+TerminalLine_AttributeRunList::
+returnRunIndexForCell	(UInt16		inCell)
+const
+{
+	auto	pastRun = std::upper_bound(runs.begin(), runs.end(), inCell,
+										[](UInt16 inValue, Run const& inRun) { return (inValue < inRun.firstCell); });
+	
+	
+	return (std::distance(runs.begin(), pastRun) - 1);
+}// TerminalLine_AttributeRunList::returnRunIndexForCell
+
+
+/*!
+Returns the number of runs.
+
+(2023.10)
+*/
+TerminalLine_AttributeRunList::RunList::size_type
+TerminalLine_AttributeRunList::
+size ()
+const
+{
+	return runs.size();
+}// TerminalLine_AttributeRunList::size
+
+
+/*!
+Ensures that a run begins at the given cell (splitting the
+run that contains it if necessary), and returns the index
+of that run.  If the cell is past the end of the line, the
+number of runs is returned.
+
+(2023.10)
+*/
+TerminalLine_AttributeRunList::RunList::size_type
+TerminalLine_AttributeRunList::
+splitAt		(UInt16		inCell)
+{
+	RunList::size_type		result = runs.size();
+	
+	
+	if (inCell < kTerminalLine_MaximumCharacterCount)
+	{
+		result = returnRunIndexForCell(inCell);
+		if (runs[result].firstCell != inCell)
+		{
+			Run const	kNewRun = {inCell, runs[result].attributes};
+			
+			
+			++result;
+			runs.insert(runs.begin() + result, kNewRun);
+		}
+	}
+	return result;
+}// TerminalLine_AttributeRunList::splitAt
+
+
 /*!
 Initializes a structure that contains attribute data for
 a single line of a terminal buffer.
@@ -268,7 +822,7 @@ TerminalLine_AttributeInfo::
 TerminalLine_AttributeInfo ()
 :
 globalAttributes(),
-attributeVector(kTerminalLine_MaximumCharacterCount)
+attributeRuns()
 {
 }// TerminalLine_AttributeInfo constructor
 
@@ -283,11 +837,86 @@ TerminalLine_AttributeInfo::
 TerminalLine_AttributeInfo	(TerminalLine_AttributeInfo const&	inCopy)
 :
 globalAttributes(inCopy.globalAttributes),
-attributeVector(inCopy.attributeVector)
+attributeRuns(inCopy.attributeRuns)
 {
 }// TerminalLine_AttributeInfo copy constructor
 
 
+/*!
+Returns the blank line that handles refer to until they
+are changed.  It must never be modified.
+
+(2023.10)
+*/
+TerminalLine_Object*
+TerminalLine_Allocator::
+returnBlankLine ()
+const
+{
+	return this->blankLinePtr;
+}// TerminalLine_Allocator::returnBlankLine
+
+
+/*!
+Returns the number of blocks (for line objects or for text)
+that are currently in use.
+
+(2023.10)
+*/
+size_t
+TerminalLine_Allocator::
+returnBlockCount ()
+const
+{
+	return this->blockCount;
+}// TerminalLine_Allocator::returnBlockCount
+
+
+/*!
+Returns the number of bytes that have been allocated from
+the system, whether or not they are currently in use.
+
+(2023.10)
+*/
+size_t
+TerminalLine_Allocator::
+returnByteCount ()
+const
+{
+	return this->slabByteCount;
+}// TerminalLine_Allocator::returnByteCount
+
+
+/*!
+Returns the number of cells that new text buffers have.
+See setCellCapacity().
+
+(2023.10)
+*/
+UInt16
+TerminalLine_Allocator::
+returnCellCapacity ()
+const
+{
+	return this->cellCapacity;
+}// TerminalLine_Allocator::returnCellCapacity
+
+
+/*!
+Returns the number of times that memory was allocated from
+the system.
+
+(2023.10)
+*/
+size_t
+TerminalLine_Allocator::
+returnSlabCount ()
+const
+{
+	return this->slabs.size();
+}// TerminalLine_Allocator::returnSlabCount
+
+
 /*!
 Returns true only if the specified line is considered
 equal to this line.
@@ -352,25 +981,15 @@ deleteRange		(StringUtilities_Cell			inRangeStartCell,
 {
 	assert(inEndLimit.columns_ >= (inRangeStartCell + inRangeCellCount).columns_);
 	
-	// update attributes
+	// update attributes (nothing changes if they are uniform and
+	// the copied attributes are the same)
+	if (false == sharesUniformAttributes(inCopiedAttributes))
 	{
-		TerminalLine_TextAttributesList::iterator	pastVisibleEnd = returnMutableAttributeVector().begin();
-		TerminalLine_TextAttributesList::iterator	toCursorAttr = returnMutableAttributeVector().begin();
-		TerminalLine_TextAttributesList::iterator	toFirstPreservedAttr;
-		TerminalLine_TextAttributesList::iterator	pastLastRelocatedAttr;
-		
+		TerminalLine_AttributeRunList&	runs = returnMutableAttributeRuns();
 		
-		std::advance(pastVisibleEnd, inEndLimit.columns_);
 		
-		pastLastRelocatedAttr = pastVisibleEnd;
-		
-		std::advance(toCursorAttr, inRangeStartCell.columns_);
-		toFirstPreservedAttr = toCursorAttr;
-		std::advance(toFirstPreservedAttr, inRangeCellCount.columns_);
-		std::advance(pastLastRelocatedAttr, -STATIC_CAST(inRangeCellCount.columns_, SInt16));
-		
-		std::copy(toFirstPreservedAttr, pastVisibleEnd, toCursorAttr);
-		std::fill(pastLastRelocatedAttr, pastVisibleEnd, inCopiedAttributes);
+		runs.move((inRangeStartCell + inRangeCellCount).columns_, inEndLimit.columns_, inRangeStartCell.columns_);
+		runs.assign(inEndLimit.columns_ - inRangeCellCount.columns_, inEndLimit.columns_, inCopiedAttributes);
 	}
 	
 #if 1
@@ -424,7 +1043,7 @@ fillWith	(CFStringRef	inString)
 
 /*!
 Overwrites the specified range with copies of the given string,
-up to the maximum character count.  Note that any existing
+up to the end of the line.  Note that any existing
 attributes still apply; see also clearAttributes().
 
 (2021.04)
@@ -434,10 +1053,11 @@ TerminalLine_Object::
 fillWith	(CFStringRef	inString,
 			 CFRange		inRange)
 {
-	CFRange		fillRange = CFRangeMake(std::min(inRange.location, STATIC_CAST(kTerminalLine_MaximumCharacterCount, CFIndex)), 0);
+	CFIndex const	kCellCapacity = this->returnCellCapacity();
+	CFRange			fillRange = CFRangeMake(std::min(inRange.location, kCellCapacity), 0);
 	
 	
-	fillRange.length = std::min(STATIC_CAST(kTerminalLine_MaximumCharacterCount, CFIndex) - fillRange.location, inRange.length);
+	fillRange.length = std::min(kCellCapacity - fillRange.location, inRange.length);
 	
 #if 1
 	// for now, fill buffer directly (this also won’t work for
@@ -502,25 +1122,15 @@ insertBlanks	(StringUtilities_Cell			inRangeStartCell,
 {
 	assert(inEndLimit.columns_ >= (inRangeStartCell + inRangeCellCount).columns_);
 	
-	// update attributes
+	// update attributes (nothing changes if they are uniform and
+	// the copied attributes are the same)
+	if (false == sharesUniformAttributes(inCopiedAttributes))
 	{
-		TerminalLine_TextAttributesList::iterator		pastVisibleEnd = returnMutableAttributeVector().begin();
-		TerminalLine_TextAttributesList::iterator		toCursorAttr = returnMutableAttributeVector().begin();
-		TerminalLine_TextAttributesList::iterator		toFirstRelocatedAttr;
-		TerminalLine_TextAttributesList::iterator		pastLastPreservedAttr;
-		
-		
-		std::advance(pastVisibleEnd, inEndLimit.columns_);
+		TerminalLine_AttributeRunList&	runs = returnMutableAttributeRuns();
 		
-		pastLastPreservedAttr = pastVisibleEnd;
 		
-		std::advance(toCursorAttr, inRangeStartCell.columns_);
-		toFirstRelocatedAttr = toCursorAttr;
-		std::advance(toFirstRelocatedAttr, inRangeCellCount.columns_);
-		std::advance(pastLastPreservedAttr, -STATIC_CAST(inRangeCellCount.columns_, SInt16));
-		
-		std::copy_backward(toCursorAttr, pastLastPreservedAttr, pastVisibleEnd);
-		std::fill(toCursorAttr, toFirstRelocatedAttr, inCopiedAttributes);
+		runs.move(inRangeStartCell.columns_, (inEndLimit - inRangeCellCount).columns_, (inRangeStartCell + inRangeCellCount).columns_);
+		runs.assign(inRangeStartCell.columns_, (inRangeStartCell + inRangeCellCount).columns_, inCopiedAttributes);
 	}
 	
 #if 1
@@ -573,7 +1183,10 @@ replaceCell		(StringUtilities_Cell			inRangeStartCell,
 				 TextAttributes_Object const&	inNewAttributes)
 {
 	// update attributes
-	returnMutableAttributeVector()[inRangeStartCell.columns_] = inNewAttributes;
+	if (false == sharesUniformAttributes(inNewAttributes))
+	{
+		returnMutableAttributeRuns().assign(inRangeStartCell.columns_, inRangeStartCell.columns_ + 1, inNewAttributes);
+	}
 	
 #if 1
 	// for now, access buffer directly (this won’t work for
@@ -594,6 +1207,31 @@ replaceCell		(StringUtilities_Cell			inRangeStartCell,
 }// TerminalLine_Object::replaceCell
 
 
+/*!
+Variant that stores a single Unicode value directly, so that no
+string object is required.  This has the same effect as the
+string version for any string whose first symbol is the given
+character.
+
+(2023.10)
+*/
+void
+TerminalLine_Object::
+replaceCell		(StringUtilities_Cell			inRangeStartCell,
+				 UniChar						inReplacementValue,
+				 TextAttributes_Object const&	inNewAttributes)
+{
+	// update attributes
+	if (false == sharesUniformAttributes(inNewAttributes))
+	{
+		returnMutableAttributeRuns().assign(inRangeStartCell.columns_, inRangeStartCell.columns_ + 1, inNewAttributes);
+	}
+	
+	// update text
+	textVectorBegin[inRangeStartCell.columns_] = inReplacementValue;
+}// TerminalLine_Object::replaceCell
+
+
 /*!
 Returns the character-by-character and line-global attributes that
 apply to this screen buffer line.  The data is not guaranteed to be
@@ -612,19 +1250,20 @@ const
 
 
 /*!
-Returns the set of attributes that applies to the line.  This set
-is not guaranteed to be unique for all lines (as an optimization,
-common sets may be shared until they are modified).
+Returns the style runs that describe the attributes of every
+cell on the line.  The runs are not guaranteed to be unique for
+all lines (as an optimization, common sets may be shared until
+they are modified).
 
-(4.1)
+(2023.10)
 */
-TerminalLine_TextAttributesList const&
+TerminalLine_AttributeRunList const&
 TerminalLine_Object::
-returnAttributeVector ()
+returnAttributeRuns ()
 const
 {
-	return this->returnAttributeInfo().attributeVector;
-}// TerminalLine_Object::returnAttributeVector
+	return this->returnAttributeInfo().attributeRuns;
+}// TerminalLine_Object::returnAttributeRuns
 
 
 /*!
@@ -641,6 +1280,21 @@ const
 }// TerminalLine_Object::returnCFStringRef
 
 
+/*!
+Returns the number of cells in the text buffer of this line
+(which is also the length of returnCFStringRef()).
+
+(2023.10)
+*/
+UInt16
+TerminalLine_Object::
+returnCellCapacity ()
+const
+{
+	return STATIC_CAST(this->textVectorEnd - this->textVectorBegin, UInt16);
+}// TerminalLine_Object::returnCellCapacity
+
+
 /*!
 Returns the set of attributes that applies to the entire line by
 default.  This is for information only, and it is sometimes used
@@ -682,11 +1336,11 @@ returnMutableAttributeInfo ()
 
 
 /*!
-Returns the set of attributes that applies to the line, in a form
-that can be directly modified.  This has the same potential side
-effects as returnMutableAttributeInfo().
+Returns the style runs of the line, in a form that can be directly
+modified.  This has the same potential side effects as
+returnMutableAttributeInfo().
 
-See also the read-only version, returnAttributeVector(), and the
+See also the read-only version, returnAttributeRuns(), and the
 line-global version, returnMutableGlobalAttributes().
 
 NOTE:	Although technically this does not need a different name
@@ -694,14 +1348,14 @@ NOTE:	Although technically this does not need a different name
 		name so that it is easier to see when the mutable variant
 		is in use and when memory allocation may be occurring.
 
-(4.1)
+(2023.10)
 */
-TerminalLine_TextAttributesList&
+TerminalLine_AttributeRunList&
 TerminalLine_Object::
-returnMutableAttributeVector ()
+returnMutableAttributeRuns ()
 {
-	return this->returnMutableAttributeInfo().attributeVector;
-}// TerminalLine_Object::returnMutableAttributeVector
+	return this->returnMutableAttributeInfo().attributeRuns;
+}// TerminalLine_Object::returnMutableAttributeRuns
 
 
 /*!
@@ -710,7 +1364,7 @@ change the global attribute values.  This has the same potential side
 effects as returnMutableAttributeInfo().
 
 See also the read-only version, returnGlobalAttributes(), and the
-character-by-character version, returnMutableAttributeVector().
+character-by-character version, returnMutableAttributeRuns().
 
 (4.1)
 */
@@ -722,6 +1376,72 @@ returnMutableGlobalAttributes ()
 }// TerminalLine_Object::returnMutableGlobalAttributes
 
 
+/*!
+Returns true only if the line is still using shared attribute
+data in which every cell has the given attributes; in that
+case, giving any cells those attributes would not change
+anything (and should not cause an allocation).
+
+(2023.10)
+*/
+bool
+TerminalLine_Object::
+sharesUniformAttributes		(TextAttributes_Object const&	inAttributes)
+const
+{
+	return (isSharedAttributeSource(this->attributeInfo) &&
+			(1 == this->attributeInfo->attributeRuns.size()) &&
+			(inAttributes == this->attributeInfo->attributeRuns.returnAttributesForCell(0)));
+}// TerminalLine_Object::sharesUniformAttributes
+
+
+/*!
+Returns the attribute runs that the line had when it was
+compacted; this is empty if the line had default attributes
+(so no run has any attributes set).
+
+(2023.10)
+*/
+TerminalLine_AttributeRunList::RunList const&
+TerminalLine_CompactLine::
+returnAttributeRuns ()
+const
+{
+	return this->attributeRuns;
+}// TerminalLine_CompactLine::returnAttributeRuns
+
+
+/*!
+Returns the number of cells that were encoded, which is the
+same as TerminalLine_Object::returnTrimmedCellCount() for
+the original line.
+
+(2023.10)
+*/
+UInt16
+TerminalLine_CompactLine::
+returnCellCount ()
+const
+{
+	return this->cellCount;
+}// TerminalLine_CompactLine::returnCellCount
+
+
+/*!
+Returns the value that TerminalLine_Object::softWrapColumnCount
+had when the line was compacted.
+
+(2023.10)
+*/
+UInt16
+TerminalLine_CompactLine::
+returnSoftWrapColumnCount ()
+const
+{
+	return this->softWrapColumnCount;
+}// TerminalLine_CompactLine::returnSoftWrapColumnCount
+
+
 /*!
 Returns the line data that this handle refers to.  If the handle
 is in a reset state, the line is blank and the returned pointer
@@ -46,7 +46,12 @@ struct Terminal_RangeDescription
 											//!  a negative line number is in the scrollback buffer
 	UInt16				firstColumn;		//!< zero-based column number where range begins
 	UInt16				columnCount;		//!< number of columns wide the range is; if 0, the range is empty
-	SInt64				rowCount;			//!< number of rows the range covers (it is rectangular, not flush to the edges)
+	SInt64				rowCount;			//!< number of rows the range covers (it is rectangular, not flush to the edges,
+											//!  unless "lastRowPastEndColumn" is nonzero)
+	UInt16				lastRowPastEndColumn;	//!< if nonzero, the range instead follows text that wraps across several rows: it
+												//!  starts at "firstColumn", includes every following column of all rows except
+												//!  the last, and ends before this column of the last row (and "columnCount" is
+												//!  then the total number of cells); only search results use this form
 };
 typedef Terminal_RangeDescription const*	Terminal_RangeDescriptionConstPtr;
 
@@ -41,6 +41,7 @@
 // standard-C includes
 #import <algorithm>
 #import <cctype>
+#import <memory>
 #import <set>
 #import <vector>
 
@@ -96,6 +97,7 @@
 namespace {
 
 CGFloat const	kMy_LargeIBeamMinimumFontSize = 16.0;					//!< mouse I-beam cursor is 32x32 only if the font is at least this size
+CFTimeInterval const	kMy_DamageFrameInterval = 1.0 / 60.0;			//!< minimum time between invalidations of changed text (see flushDamage())
 
 /*!
 Indices into the "colors" array of the main structure.
@@ -216,6 +218,48 @@ typedef std::vector< NSTimeInterval >			My_TimeIntervalList;
 
 class My_XTerm256Table;
 
+/*!
+Accumulates the parts of a terminal screen that have changed
+since the view last invalidated anything, so that a view can
+invalidate them at most once per display frame instead of
+once per change notification (see flushDamage()).
+
+Rows are main screen rows (0 is the topmost).  Each changed
+row has a span of changed columns.  When the screen scrolls,
+everything is marked: the existing rendering of the rows
+that only moved is NOT copied (the content view is layer-
+backed, and AppKit offers no reliable way to move part of
+its rendering), so every row is drawn again anyway.
+*/
+struct My_DamageTracker
+{
+	struct ColumnSpan
+	{
+		UInt16		firstColumn;		// zero-based first changed column
+		UInt16		pastLastColumn;		// zero-based column past the last changed column
+	};
+	
+	My_DamageTracker ();
+	
+	bool
+	isEmpty () const;
+	
+	void
+	markAll ();
+	
+	void
+	markRows	(SInt64, SInt64, UInt16, UInt16);
+	
+	void
+	reset ();
+	
+	std::vector< bool >			dirtyRows;		// for each main screen row, true if any of its columns changed
+	std::vector< ColumnSpan >	columnSpans;	// for each row in "dirtyRows", the changed columns
+	Boolean						allDamaged;		// if true, the rest is ignored and the entire view is redrawn
+	Boolean						flushScheduled;	// if true, flushDamage() will be called at the next frame
+	CFAbsoluteTime				lastFlushTime;	// when flushDamage() last ran, for limiting the rate of invalidation
+};
+
 // TEMPORARY: This structure is transitioning to C++, and so initialization
 // and maintenance of it is downright ugly for the time being.  It *will*
 // be simplified and become more object-oriented in the future.
@@ -278,6 +322,7 @@ struct My_TerminalView
 		Boolean						isReverseVideo;			// are foreground and background colors temporarily swapped?
 		
 		ListenerModel_ListenerWrap	contentMonitor;			// listener for changes to the contents of the screen buffer
+		std::shared_ptr< My_DamageTracker >	damage;	// changes from the listener above that are not yet invalidated
 		ListenerModel_ListenerWrap	cursorMonitor;			// listener for changes to the terminal cursor position or visible state
 		ListenerModel_ListenerWrap	preferenceMonitor;		// listener for changes to preferences that affect a particular view
 		ListenerModel_ListenerWrap	bellHandler;			// listener for bell signals from the terminal screen
@@ -307,6 +352,7 @@ TerminalView_RowIndex	currentRenderedLine;	// only defined while drawing; the ro
 		Boolean			currentRenderDragColors;	// only defined while drawing; if true, drag highlight text colors are used
 		Boolean			currentRenderNoBackground;	// only defined while drawing; if true, text is using the ordinary background color
 		CGContextRef	currentRenderContext;		// only defined while drawing; if not nullptr, the context from the view draw event
+		Terminal_SnapshotPtr	currentRenderSnapshot;	// main screen rows as of the most recent draw event (see Terminal_PublishSnapshot())
 		CGFloat			paddingLeftEmScale;			// left padding between text and focus ring; multiplies against normal (undoubled) character width
 		CGFloat			paddingRightEmScale;		// right padding between text and focus ring; multiplies against normal (undoubled) character width
 		CGFloat			paddingTopEmScale;			// top padding between text and focus ring; multiplies against normal (undoubled) character height
@@ -434,6 +480,7 @@ Terminal_LineRef	findRowIterator						(My_TerminalViewPtr, TerminalView_RowIndex
 Terminal_LineRef	findRowIteratorRelativeTo			(My_TerminalViewPtr, TerminalView_RowIndex, TerminalView_RowIndex,
 														 Terminal_LineStackStorage*);
 Boolean				findVirtualCellFromScreenPoint		(My_TerminalViewPtr, HIPoint, TerminalView_Cell&, SInt16* = nullptr, SInt16* = nullptr);
+void				flushDamage							(My_TerminalViewPtr);
 void				getBlinkAnimationColor				(My_TerminalViewPtr, UInt16, CGFloatRGBColor*);
 void				getImagesInVirtualRange				(My_TerminalViewPtr, TerminalView_CellRange const&, NSMutableArray*);
 void				getRowBounds						(My_TerminalViewPtr, TerminalView_RowIndex, CGRect&);
@@ -466,6 +513,7 @@ void				receiveVideoModeChange				(ListenerModel_Ref, ListenerModel_Event, void*
 void				releaseRowIterator					(My_TerminalViewPtr, Terminal_LineRef*);
 Boolean				removeDataSource					(My_TerminalViewPtr, TerminalScreenRef);
 CFStringRef			returnSelectedTextCopyAsUnicode		(My_TerminalViewPtr, UInt16, TerminalView_TextFlags);
+void				scheduleDamageFlush					(My_TerminalViewPtr);
 void				screenBufferChanged					(ListenerModel_Ref, ListenerModel_Event, void*, void*);
 void				screenCursorChanged					(ListenerModel_Ref, ListenerModel_Event, void*, void*);
 Boolean				selectionExists						(My_TerminalViewPtr);
@@ -1033,13 +1081,19 @@ TerminalView_DisplayCompletionsUI	(TerminalViewRef	inView)
 						// (scrollback or screen), discarding duplicates
 						for (auto resultRange: searchResults)
 						{
+							SInt64 const		kLastRow = (resultRange.firstRow + std::max< SInt64 >(1, resultRange.rowCount) - 1);
+							UInt16 const		kPastEndColumn = ((0 != resultRange.lastRowPastEndColumn)
+																	? resultRange.lastRowPastEndColumn // result wraps across rows
+																	: STATIC_CAST(resultRange.firstColumn + resultRange.columnCount, UInt16));
 							CFRetainRelease		completionCFString;
 							
 							
-							// “select” this result
+							// “select” the start of this result
 							viewPtr->text.selection.range.first.first = resultRange.firstColumn;
 							viewPtr->text.selection.range.first.second = resultRange.firstRow;
-							viewPtr->text.selection.range.second.first = resultRange.firstColumn + resultRange.columnCount;
+							viewPtr->text.selection.range.second.first = ((kLastRow == resultRange.firstRow)
+																			? kPastEndColumn
+																			: (resultRange.firstColumn + 1));
 							viewPtr->text.selection.range.second.second = resultRange.firstRow + 1;
 							
 							// “double-click” this result to find a word (TEMPORARY; should
@@ -1047,9 +1101,35 @@ TerminalView_DisplayCompletionsUI	(TerminalViewRef	inView)
 							// the text selection does not have to change; although, this is
 							// a very convenient way to produce exactly the right behavior)
 							handleMultiClick(viewPtr, 2);
-							completionCFString = CFRetainRelease(TerminalView_ReturnSelectedTextCopyAsUnicode
-																	(inView, 0/* spaces to replace with tab */, 0/* flags */),
-																	CFRetainRelease::kAlreadyRetained);
+							if (kLastRow == resultRange.firstRow)
+							{
+								completionCFString = CFRetainRelease(TerminalView_ReturnSelectedTextCopyAsUnicode
+																		(inView, 0/* spaces to replace with tab */, 0/* flags */),
+																		CFRetainRelease::kAlreadyRetained);
+							}
+							else
+							{
+								// since a word is only found on one row, a result that wraps
+								// is completed by the word that starts on its first row and
+								// the word that ends on its last row (joined without any
+								// line separators, as the rows are soft-wrapped)
+								TerminalView_Cell const		kWordStart = viewPtr->text.selection.range.first;
+								Boolean const				kWasRectangular = viewPtr->text.selection.isRectangular;
+								
+								
+								viewPtr->text.selection.range.first.first = (kPastEndColumn - 1);
+								viewPtr->text.selection.range.first.second = kLastRow;
+								viewPtr->text.selection.range.second.first = kPastEndColumn;
+								viewPtr->text.selection.range.second.second = kLastRow + 1;
+								handleMultiClick(viewPtr, 2);
+								viewPtr->text.selection.range.first = kWordStart;
+								viewPtr->text.selection.isRectangular = false; // follow the text from row to row
+								completionCFString = CFRetainRelease(TerminalView_ReturnSelectedTextCopyAsUnicode
+																		(inView, 0/* spaces to replace with tab */,
+																			kTerminalView_TextFlagInline),
+																		CFRetainRelease::kAlreadyRetained);
+								viewPtr->text.selection.isRectangular = kWasRectangular;
+							}
 							TerminalView_SelectNothing(inView); // fix any highlighting changes caused by the “selection” above
 							if (false == completionCFString.exists())
 							{
@@ -3589,7 +3669,9 @@ TerminalView_TranslateTerminalScreenRange	(TerminalViewRef					inView,
 	else
 	{
 		outRange.first = TerminalView_Cell(inRange.firstColumn, inRange.firstRow);
-		outRange.second = TerminalView_Cell(outRange.first.first + inRange.columnCount,
+		outRange.second = TerminalView_Cell((0 != inRange.lastRowPastEndColumn)
+											? inRange.lastRowPastEndColumn // text range that wraps (e.g. a search result)
+											: (outRange.first.first + inRange.columnCount),
 											outRange.first.second + inRange.rowCount);
 	}
 	return result;
@@ -3670,6 +3752,117 @@ TerminalView_ZoomToSearchResults	(TerminalViewRef	inView)
 #pragma mark Internal Methods
 namespace {
 
+/*!
+Creates a tracker with no damage.
+
+(2023.10)
+*/
+My_DamageTracker::
+My_DamageTracker ()
+:
+// IMPORTANT: THESE ARE EXECUTED IN THE ORDER MEMBERS APPEAR IN THE CLASS.
+dirtyRows(),
+columnSpans(),
+allDamaged(false),
+flushScheduled(false),
+lastFlushTime(0)
+{
+}// My_DamageTracker default constructor
+
+
+/*!
+Returns true only if nothing needs to be redrawn.
+
+(2023.10)
+*/
+bool
+My_DamageTracker::
+isEmpty ()
+const
+{
+	return ((false == this->allDamaged) &&
+			(this->dirtyRows.end() == std::find(this->dirtyRows.begin(), this->dirtyRows.end(), true)));
+}// My_DamageTracker::isEmpty
+
+
+/*!
+Arranges for the entire view to be redrawn.
+
+(2023.10)
+*/
+void
+My_DamageTracker::
+markAll ()
+{
+	this->allDamaged = true;
+}// My_DamageTracker::markAll
+
+
+/*!
+Adds the given columns of the given rows to the damage.  Row
+numbers are main screen rows; if any row is in the scrollback
+(negative), the entire view is marked instead.
+
+(2023.10)
+*/
+void
+My_DamageTracker::
+markRows	(SInt64		inFirstRow,
+			 SInt64		inRowCount,
+			 UInt16		inFirstColumn,
+			 UInt16		inColumnCount)
+{
+	if (inFirstRow < 0)
+	{
+		this->markAll();
+	}
+	else if ((false == this->allDamaged) && (inRowCount > 0) && (inColumnCount > 0))
+	{
+		size_t const	kPastLastRow = STATIC_CAST(inFirstRow + inRowCount, size_t);
+		UInt16 const	kPastLastColumn = STATIC_CAST(std::min(inFirstColumn + inColumnCount, 0xFFFF), UInt16);
+		
+		
+		if (kPastLastRow > this->dirtyRows.size())
+		{
+			this->dirtyRows.resize(kPastLastRow, false);
+			this->columnSpans.resize(kPastLastRow);
+		}
+		
+		for (size_t i = STATIC_CAST(inFirstRow, size_t); i < kPastLastRow; ++i)
+		{
+			ColumnSpan&		span = this->columnSpans[i];
+			
+			
+			if (this->dirtyRows[i])
+			{
+				span.firstColumn = std::min(span.firstColumn, inFirstColumn);
+				span.pastLastColumn = std::max(span.pastLastColumn, kPastLastColumn);
+			}
+			else
+			{
+				this->dirtyRows[i] = true;
+				span.firstColumn = inFirstColumn;
+				span.pastLastColumn = kPastLastColumn;
+			}
+		}
+	}
+}// My_DamageTracker::markRows
+
+
+/*!
+Forgets all damage (after it has been invalidated).
+
+(2023.10)
+*/
+void
+My_DamageTracker::
+reset ()
+{
+	this->dirtyRows.assign(this->dirtyRows.size(), false);
+	this->allDamaged = false;
+}// My_DamageTracker::reset
+
+
 /*!
 Initializes all tables, after which they can be used to
 conveniently translate received parameter values in XTerm
@@ -3903,6 +4096,7 @@ initialize		(TerminalScreenRef			inScreenDataSource,
 	this->screen.cursor.isCustomColor = false;
 	this->screen.mouse.pointerColor = kTerminalView_MousePointerColorRed; // set later
 	this->screen.currentRenderContext = nullptr;
+	this->screen.damage = std::make_shared< My_DamageTracker >();
 	this->text.toCurrentSearchResult = this->text.searchResults.end();
 	
 	// read user preferences for the spacing around the edges
@@ -5120,8 +5314,20 @@ drawSection		(My_TerminalViewPtr		inTerminalViewPtr,
 			
 			if (nullptr != lineIterator)
 			{
-				TextAttributes_Object	lineGlobalAttributes;
+				TextAttributes_Object			lineGlobalAttributes;
+				Terminal_ScreenRunBlock const	kDrawRunBlock =
+				^(UInt16					inLineTextBufferLength,
+				  CFStringRef				inLineTextBufferAsCFStringOrNull,
+				  Terminal_LineRef			UNUSED_ARGUMENT(inRow),
+				  UInt16					inZeroBasedStartColumnNumber,
+				  TextAttributes_Object		inAttributes)
+				{
+					drawTerminalScreenRunOp(inTerminalViewPtr, inLineTextBufferLength, inLineTextBufferAsCFStringOrNull,
+											inZeroBasedStartColumnNumber, inAttributes);
+				};
+				
 				
+				releaseRowIterator(inTerminalViewPtr, &lineIterator);
 				
 				// unfortunately rendering requires knowledge of the physical location of
 				// a row in the view area, and this is something that a terminal screen
@@ -5133,26 +5339,35 @@ drawSection		(My_TerminalViewPtr		inTerminalViewPtr,
 						inTerminalViewPtr->screen.currentRenderedLine < inZeroBasedPastTheBottommostRowToDraw;
 						++(inTerminalViewPtr->screen.currentRenderedLine))
 				{
-					// TEMPORARY: extremely inefficient, but necessary for
-					// correct scrollback behavior at the moment
-					lineIterator = findRowIterator(inTerminalViewPtr, inTerminalViewPtr->screen.currentRenderedLine,
-													&lineIteratorData);
-					if (nullptr == lineIterator)
+					TerminalView_RowIndex const		kActualIndex = (inTerminalViewPtr->screen.topVisibleEdgeInRows +
+																	inTerminalViewPtr->screen.currentRenderedLine);
+					
+					
+					if ((kActualIndex >= 0) &&
+						(kActualIndex < Terminal_SnapshotReturnRowCount(inTerminalViewPtr->screen.currentRenderSnapshot)))
+					{
+						// main screen rows come from the snapshot of this frame
+						// (see drawRect:) instead of the live screen buffer
+						iteratorResult = Terminal_SnapshotForEachLikeAttributeRun
+											(inTerminalViewPtr->screen.currentRenderSnapshot,
+												STATIC_CAST(kActualIndex, UInt16), kDrawRunBlock);
+					}
+					else
 					{
-						break;
+						// TEMPORARY: extremely inefficient, but necessary for
+						// correct scrollback behavior at the moment
+						lineIterator = findRowIterator(inTerminalViewPtr, inTerminalViewPtr->screen.currentRenderedLine,
+														&lineIteratorData);
+						if (nullptr == lineIterator)
+						{
+							break;
+						}
+						
+						iteratorResult = Terminal_ForEachLikeAttributeRun(inTerminalViewPtr->screen.ref, lineIterator, kDrawRunBlock);
+						
+						releaseRowIterator(inTerminalViewPtr, &lineIterator);
 					}
 					
-					iteratorResult = Terminal_ForEachLikeAttributeRun
-										(inTerminalViewPtr->screen.ref, lineIterator,
-											^(UInt16					inLineTextBufferLength,
-											  CFStringRef				inLineTextBufferAsCFStringOrNull,
-											  Terminal_LineRef			UNUSED_ARGUMENT(inRow),
-											  UInt16					inZeroBasedStartColumnNumber,
-											  TextAttributes_Object		inAttributes)
-											{
-												drawTerminalScreenRunOp(inTerminalViewPtr, inLineTextBufferLength, inLineTextBufferAsCFStringOrNull,
-																		inZeroBasedStartColumnNumber, inAttributes);
-											});
 					if (iteratorResult != kTerminal_ResultOK)
 					{
 						// did not draw successfully...?
@@ -5161,8 +5376,6 @@ drawSection		(My_TerminalViewPtr		inTerminalViewPtr,
 					{
 						result = true;
 					}
-					
-					releaseRowIterator(inTerminalViewPtr, &lineIterator);
 				}
 			}
 		}
@@ -6314,6 +6527,55 @@ findVirtualCellFromScreenPoint	(My_TerminalViewPtr		inTerminalViewPtr,
 }// findVirtualCellFromScreenPoint
 
 
+/*!
+Invalidates everything that has been accumulated by the
+damage tracker of the given view, then resets the tracker.
+
+Scrolling always redraws everything (see My_DamageTracker),
+so only text changes are invalidated row by row.
+
+This is called at most once per display frame (see
+scheduleDamageFlush()), no matter how often the screen
+changes in between.
+
+(2023.10)
+*/
+void
+flushDamage		(My_TerminalViewPtr		inTerminalViewPtr)
+{
+	My_DamageTracker&	damage = *(inTerminalViewPtr->screen.damage);
+	
+	
+	damage.flushScheduled = false;
+	damage.lastFlushTime = CFAbsoluteTimeGetCurrent();
+	
+	if (damage.isEmpty())
+	{
+		// nothing to do
+	}
+	else if (damage.allDamaged)
+	{
+		updateDisplay(inTerminalViewPtr);
+	}
+	else
+	{
+		for (size_t i = 0; i < damage.dirtyRows.size(); ++i)
+		{
+			if (damage.dirtyRows[i])
+			{
+				My_DamageTracker::ColumnSpan const&		kSpan = damage.columnSpans[i];
+				
+				
+				invalidateRowSection(inTerminalViewPtr, STATIC_CAST(i, TerminalView_RowIndex) - inTerminalViewPtr->screen.topVisibleEdgeInRows,
+										kSpan.firstColumn, kSpan.pastLastColumn - kSpan.firstColumn);
+			}
+		}
+	}
+	
+	damage.reset();
+}// flushDamage
+
+
 /*!
 Given a stage of blink animation, returns its rendering color.
 
@@ -8202,8 +8464,16 @@ returnSelectedTextCopyAsUnicode		(My_TerminalViewPtr			inTerminalViewPtr,
 						
 						if (substringObject.exists())
 						{
+							CFIndex const	kAppendedLocation = CFStringGetLength(resultMutable);
+							
+							
 							CFStringAppend(resultMutable, substringObject.returnCFStringRef());
 							
+							// the second cell of a double-width character only holds a
+							// placeholder that is not part of the original text
+							UNUSED_RETURN(CFIndex)Terminal_RemoveWideCharacterContinuations
+													(resultMutable, CFRangeMake(kAppendedLocation, CFStringGetLength(resultMutable) - kAppendedLocation));
+							
 							// perform spaces-to-tabs substitution; this could be done while
 							// appending text in the first place but instead it is done as a
 							// lazy post-processing step (also, no effort is made to perform
@@ -8285,6 +8555,46 @@ returnSelectedTextCopyAsUnicode		(My_TerminalViewPtr			inTerminalViewPtr,
 }// returnSelectedTextCopyAsUnicode
 
 
+/*!
+Arranges for flushDamage() to be called for the given view
+at the start of the next display frame, unless that has
+already been arranged.  The frame rate is fixed (see
+"kMy_DamageFrameInterval"), so a view invalidates changes
+at most that often no matter how quickly they arrive.
+
+(2023.10)
+*/
+void
+scheduleDamageFlush		(My_TerminalViewPtr		inTerminalViewPtr)
+{
+	My_DamageTracker&	damage = *(inTerminalViewPtr->screen.damage);
+	
+	
+	unless (damage.flushScheduled)
+	{
+		std::weak_ptr< My_DamageTracker >	weakDamage = inTerminalViewPtr->screen.damage;
+		TerminalViewRef const				kView = inTerminalViewPtr->selfRef;
+		CFTimeInterval const				kDelay = std::max(0.0, damage.lastFlushTime + kMy_DamageFrameInterval -
+																	CFAbsoluteTimeGetCurrent());
+		
+		
+		damage.flushScheduled = true;
+		CocoaExtensions_RunLater(kDelay,
+									^{
+										// the tracker is destroyed with the view, so this
+										// detects a view that no longer exists
+										unless (weakDamage.expired())
+										{
+											My_TerminalViewAutoLocker	viewPtr(gTerminalViewPtrLocks(), kView);
+											
+											
+											flushDamage(viewPtr);
+										}
+									});
+	}
+}// scheduleDamageFlush
+
+
 /*!
 Receives notification whenever a monitored terminal
 screen buffer’s text changes, and responds by
@@ -8339,23 +8649,19 @@ screenBufferChanged		(ListenerModel_Ref		UNUSED_ARGUMENT(inUnusedModel),
 		{
 			Terminal_RangeDescriptionConstPtr	rangeInfoPtr = REINTERPRET_CAST(inEventContextPtr,
 																				Terminal_RangeDescriptionConstPtr);
-			SInt64								i = 0;
+			SInt64 const						kScreenRowCount = Terminal_ReturnRowCount(viewPtr->screen.ref);
 			
 			
 			// debug
 			//Console_WriteValuePair("first changed row, number of changed rows",
 			//						rangeInfoPtr->firstRow, rangeInfoPtr->rowCount);
-			for (i = rangeInfoPtr->firstRow - viewPtr->screen.topVisibleEdgeInRows;
-					i < (rangeInfoPtr->firstRow - viewPtr->screen.topVisibleEdgeInRows + STATIC_CAST(rangeInfoPtr->rowCount, SInt32)); ++i)
-			{
-				invalidateRowSection(viewPtr, i, rangeInfoPtr->firstColumn, rangeInfoPtr->columnCount);
-			}
 			
-			// when multiple rows change, just redraw everything
-			if (rangeInfoPtr->rowCount > 1)
-			{
-				updateDisplay(viewPtr);
-			}
+			// changes are only recorded here; they are invalidated at
+			// most once per display frame (see flushDamage())
+			viewPtr->screen.damage->markRows(rangeInfoPtr->firstRow,
+												std::min(rangeInfoPtr->rowCount, kScreenRowCount - rangeInfoPtr->firstRow),
+												rangeInfoPtr->firstColumn, rangeInfoPtr->columnCount);
+			scheduleDamageFlush(viewPtr);
 		}
 		break;
 	
@@ -8376,7 +8682,10 @@ screenBufferChanged		(ListenerModel_Ref		UNUSED_ARGUMENT(inUnusedModel),
 			viewPtr->text.selection.range.second.second += rangeInfoPtr->rowDelta;
 			highlightCurrentSelection(viewPtr, true/* highlight */, true/* draw */);
 			
-			updateDisplay(viewPtr);
+			// the rendering is not moved, so everything is drawn again at
+			// the next frame (however many times the screen scrolls first)
+			viewPtr->screen.damage->markAll();
+			scheduleDamageFlush(viewPtr);
 		}
 		break;
 	
@@ -13599,6 +13908,10 @@ drawRect:(NSRect)	aRect
 			UNUSED_RETURN(Boolean)findVirtualCellFromScreenPoint(viewPtr, kTopLeftAnchor, leftTopCell);
 			UNUSED_RETURN(Boolean)findVirtualCellFromScreenPoint(viewPtr, kBottomRightAnchor, rightBottomCell);
 			
+			// main screen rows are drawn from one snapshot per frame, which
+			// only copies the rows that changed since the previous frame
+			viewPtr->screen.currentRenderSnapshot = Terminal_PublishSnapshot(viewPtr->screen.ref);
+			
 			// draw the text in the clipped area
 			UNUSED_RETURN(Boolean)drawSection(viewPtr, drawingContext, leftTopCell.first - viewPtr->screen.leftVisibleEdgeInColumns,
 												leftTopCell.second - viewPtr->screen.topVisibleEdgeInRows,
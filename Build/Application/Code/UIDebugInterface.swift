@@ -38,6 +38,11 @@ import SwiftUI
 	// implement these functions to bind to button actions
 	func dumpStateOfActiveTerminal()
 	func launchNewCallPythonClient()
+	func runMemoryBlockLockerBenchmark()
+	func runTerminalThroughputBenchmark()
+	func runUTF8DecoderBenchmark()
+	func runUTF8EncoderBenchmark()
+	func runSixelDecoderBenchmark()
 	func showTestTerminalToolbar()
 	func updateSettingCache()
 }
@@ -46,6 +51,11 @@ class UIDebugInterface_RunnerDummy : NSObject, UIDebugInterface_ActionHandling {
 	// dummy used for debugging in playground (just prints function that is called)
 	func dumpStateOfActiveTerminal() { print(#function) }
 	func launchNewCallPythonClient() { print(#function) }
+	func runMemoryBlockLockerBenchmark() { print(#function) }
+	func runTerminalThroughputBenchmark() { print(#function) }
+	func runUTF8DecoderBenchmark() { print(#function) }
+	func runUTF8EncoderBenchmark() { print(#function) }
+	func runSixelDecoderBenchmark() { print(#function) }
 	func showTestTerminalToolbar() { print(#function) }
 	func updateSettingCache() { print(#function) }
 }
@@ -203,6 +213,41 @@ public struct UIDebugInterface_View : View {
 							.macTermToolTipText("Print debugging summary of frontmost terminal window.")
 					}.padding([.bottom], -6) // not debugging alignment guides; for now, just do this
 				}
+				UICommon_OptionLineView("Performance", noDefaultSpacing: true) {
+					Button(action: { viewModel.runner.runTerminalThroughputBenchmark() }) {
+						Text("Replay Captured Output…")
+							.frame(minWidth: 160)
+							.macTermToolTipText("Feed files of captured terminal output through a scratch terminal and print throughput (MB/s, ns/byte and allocation figures).")
+					}.padding([.bottom], -6) // not debugging alignment guides; for now, just do this
+				}
+				UICommon_OptionLineView("", noDefaultSpacing: true) {
+					Button(action: { viewModel.runner.runUTF8DecoderBenchmark() }) {
+						Text("Benchmark UTF-8 Decoder")
+							.frame(minWidth: 160)
+							.macTermToolTipText("Decode generated ASCII, CJK and emoji text one byte at a time and in blocks, and print throughput (MB/s) of each.")
+					}.padding([.bottom], -6) // not debugging alignment guides; for now, just do this
+				}
+				UICommon_OptionLineView("", noDefaultSpacing: true) {
+					Button(action: { viewModel.runner.runUTF8EncoderBenchmark() }) {
+						Text("Benchmark UTF-8 Encoder")
+							.frame(minWidth: 160)
+							.macTermToolTipText("Encode generated ASCII, CJK and emoji text one character at a time and in runs, and print throughput (MB/s) of each.")
+					}.padding([.bottom], -6) // not debugging alignment guides; for now, just do this
+				}
+				UICommon_OptionLineView("", noDefaultSpacing: true) {
+					Button(action: { viewModel.runner.runSixelDecoderBenchmark() }) {
+						Text("Benchmark Sixel Decoder")
+							.frame(minWidth: 160)
+							.macTermToolTipText("Size and decode generated photo-like and chart-like Sixel images, and print throughput (MB/s and megapixels/s).")
+					}.padding([.bottom], -6) // not debugging alignment guides; for now, just do this
+				}
+				UICommon_OptionLineView("", noDefaultSpacing: true) {
+					Button(action: { viewModel.runner.runMemoryBlockLockerBenchmark() }) {
+						Text("Benchmark Reference Locks")
+							.frame(minWidth: 160)
+							.macTermToolTipText("Validate and lock opaque references with hashed lock counts and with generation-checked slots, and print the cost (ns/call) of each.")
+					}.padding([.bottom], -6) // not debugging alignment guides; for now, just do this
+				}
 			}
 			Spacer().asMacTermSectionSpacingV()
 			Group {
@@ -1249,6 +1249,11 @@ UIStrings_Copy	(UIStrings_TerminalCFString		inWhichString,
 													CFSTR("kUIStrings_TerminalNewCommandsKeyCharacter; used for some menu command keys, this should be only one lowercase Unicode character"));
 		break;
 	
+	case kUIStrings_TerminalPasteProgress:
+		outString = CFCopyLocalizedStringFromTable(CFSTR("[Pasting: %1$u%%]"), CFSTR("Terminal"),
+													CFSTR("kUIStrings_TerminalPasteProgress; %1$u is the percentage of the text that has been sent so far"));
+		break;
+	
 	case kUIStrings_TerminalPrintFromTerminalJobTitle:
 		outString = CFCopyLocalizedStringFromTable(CFSTR("Print From Terminal: MacTerm"), CFSTR("Terminal"),
 													CFSTR("kUIStrings_TerminalPrintFromTerminalJobTitle"));
@@ -330,6 +330,7 @@ enum UIStrings_TerminalCFString
 	kUIStrings_TerminalDynamicResizeWidthHeight				= 'DRWH',
 	kUIStrings_TerminalInterruptProcess						= 'Intr',
 	kUIStrings_TerminalNewCommandsKeyCharacter				= 'NewK',
+	kUIStrings_TerminalPasteProgress						= 'PPrg',
 	kUIStrings_TerminalPrintFromTerminalJobTitle			= 'PTrm',
 	kUIStrings_TerminalPrintScreenJobTitle					= 'PScr',
 	kUIStrings_TerminalPrintSelectionJobTitle				= 'PSel',
@@ -0,0 +1,404 @@
+/*!	\file ByteRing.cp
+	\brief Lock-free single-producer, single-consumer ring.
+*/
+/*###############################################################
+
+	Data Access Library
+	© 1998-2023 by Kevin Grant
+	
+	This library is free software; you can redistribute it or
+	modify it under the terms of the GNU Lesser Public License
+	as published by the Free Software Foundation; either version
+	2.1 of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be
+	useful, but WITHOUT ANY WARRANTY; without even the implied
+	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+	PURPOSE.  See the GNU Lesser Public License for details.
+	
+	You should have received a copy of the GNU Lesser Public
+	License along with this library; if not, write to:
+	
+		Free Software Foundation, Inc.
+		59 Temple Place, Suite 330
+		Boston, MA  02111-1307
+		USA
+
+###############################################################*/
+
+#include "ByteRing.h"
+#include <UniversalDefines.h>
+
+// standard-C++ includes
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Mac includes
+#include <CoreServices/CoreServices.h>
+
+// library includes
+#include <Console.h>
+
+
+
+#pragma mark Internal Method Prototypes
+namespace {
+
+size_t		returnPowerOfTwoAtLeast			(size_t);
+Boolean		unitTest_ReadWrite_000			();
+Boolean		unitTest_ReadWrite_001			();
+
+} // anonymous namespace
+
+
+
+#pragma mark Public Methods
+
+/*!
+A unit test for this module.  This should always
+be run before a release, after any substantial
+changes are made, or if you suspect bugs!  It
+should also be EXPANDED as new functionality is
+proposed (ideally, a test is written before the
+functionality is added).
+
+(2023.10)
+*/
+void
+ByteRing_RunTests ()
+{
+	UInt16		totalTests = 0;
+	UInt16		failedTests = 0;
+	
+	
+	++totalTests; if (false == unitTest_ReadWrite_000()) ++failedTests;
+	++totalTests; if (false == unitTest_ReadWrite_001()) ++failedTests;
+	
+	Console_WriteUnitTestReport("Byte Ring", failedTests, totalTests);
+}// RunTests
+
+
+#pragma mark Public Methods: ByteRing_Buffer
+
+/*!
+Creates a ring that can hold at least the given number of
+bytes (the capacity is rounded up to a power of two, and is
+at least 2).
+
+(2023.10)
+*/
+ByteRing_Buffer::
+ByteRing_Buffer		(size_t		inMinimumCapacity)
+:
+_storage(),
+_capacity(returnPowerOfTwoAtLeast(std::max< size_t >(inMinimumCapacity, 2))),
+_writeCount(0),
+_readCount(0)
+{
+	_storage.reset(new UInt8[_capacity]);
+}// ByteRing_Buffer 1-argument constructor
+
+
+/*!
+Frees the given number of bytes from the start of the
+span most recently returned by returnReadableSpan().
+
+IMPORTANT:	Only the consumer thread may call this.
+
+(2023.10)
+*/
+void
+ByteRing_Buffer::
+commitRead	(size_t		inByteCount)
+{
+	size_t const	kReadCount = _readCount.load(std::memory_order_relaxed);
+	
+	
+	assert(inByteCount <= (_writeCount.load(std::memory_order_acquire) - kReadCount));
+	_readCount.store(kReadCount + inByteCount, std::memory_order_release);
+}// commitRead
+
+
+/*!
+Makes the given number of bytes, starting from the
+span most recently returned by returnWritableSpan(),
+visible to the consumer.
+
+IMPORTANT:	Only the producer thread may call this.
+
+(2023.10)
+*/
+void
+ByteRing_Buffer::
+commitWrite		(size_t		inByteCount)
+{
+	size_t const	kWriteCount = _writeCount.load(std::memory_order_relaxed);
+	
+	
+	assert(inByteCount <= (_capacity - (kWriteCount - _readCount.load(std::memory_order_acquire))));
+	_writeCount.store(kWriteCount + inByteCount, std::memory_order_release);
+}// commitWrite
+
+
+/*!
+Returns the number of unread bytes that are stored
+contiguously from the next byte to be read, and sets
+the given pointer to that byte.  This is 0 only if
+the ring is empty.
+
+All of the returned bytes remain valid until they are
+freed by commitRead().
+
+IMPORTANT:	Only the consumer thread may call this.
+
+(2023.10)
+*/
+size_t
+ByteRing_Buffer::
+returnReadableSpan	(UInt8 const*&	outBytes)
+{
+	size_t const	kReadCount = _readCount.load(std::memory_order_relaxed);
+	size_t const	kUnreadCount = (_writeCount.load(std::memory_order_acquire) - kReadCount);
+	size_t const	kOffset = (kReadCount & (_capacity - 1));
+	
+	
+	outBytes = _storage.get() + kOffset;
+	return std::min(kUnreadCount, _capacity - kOffset);
+}// returnReadableSpan
+
+
+/*!
+Returns the number of free bytes that are stored
+contiguously from the next byte to be written, and
+sets the given pointer to that byte.  This is 0 only
+if the ring is full.
+
+Any bytes that are filled must be committed with
+commitWrite() before the consumer can see them.
+
+IMPORTANT:	Only the producer thread may call this.
+
+(2023.10)
+*/
+size_t
+ByteRing_Buffer::
+returnWritableSpan	(UInt8*&	outBytes)
+{
+	size_t const	kWriteCount = _writeCount.load(std::memory_order_relaxed);
+	size_t const	kFreeCount = (_capacity - (kWriteCount - _readCount.load(std::memory_order_acquire)));
+	size_t const	kOffset = (kWriteCount & (_capacity - 1));
+	
+	
+	outBytes = _storage.get() + kOffset;
+	return std::min(kFreeCount, _capacity - kOffset);
+}// returnWritableSpan
+
+
+/*!
+Copies as many of the given bytes as there is room
+for (wrapping around the end of the ring if necessary)
+and commits them.  Returns the number of bytes copied,
+which is less than the given count if the ring fills.
+
+IMPORTANT:	Only the producer thread may call this.
+
+(2023.10)
+*/
+size_t
+ByteRing_Buffer::
+write	(UInt8 const*	inBytes,
+		 size_t			inByteCount)
+{
+	size_t		result = 0;
+	
+	
+	// at most two spans are needed (before and after the wrap)
+	for (UInt16 i = 0; ((i < 2) && (result < inByteCount)); ++i)
+	{
+		UInt8*			spanPtr = nullptr;
+		size_t const	kSpanSize = std::min(returnWritableSpan(spanPtr), inByteCount - result);
+		
+		
+		if (0 == kSpanSize)
+		{
+			break;
+		}
+		std::memcpy(spanPtr, inBytes + result, kSpanSize);
+		commitWrite(kSpanSize);
+		result += kSpanSize;
+	}
+	
+	return result;
+}// write
+
+
+#pragma mark Internal Methods
+namespace {
+
+/*!
+Returns the smallest power of two that is at least
+the given value.
+
+(2023.10)
+*/
+size_t
+returnPowerOfTwoAtLeast		(size_t		inValue)
+{
+	size_t		result = 1;
+	
+	
+	while (result < inValue)
+	{
+		result <<= 1;
+	}
+	return result;
+}// returnPowerOfTwoAtLeast
+
+
+/*!
+Tests writes and reads on one thread, including spans
+that wrap around the end of the ring.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_ReadWrite_000 ()
+{
+	Boolean				result = true;
+	ByteRing_Buffer		ring(10); // rounded up to 16
+	UInt8 const			kData[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+	UInt8*				writePtr = nullptr;
+	UInt8 const*		readPtr = nullptr;
+	size_t				spanSize = 0;
+	
+	
+	Console_TestAssertUpdate(result, 16 == ring.returnCapacity(), Console_WriteValue, "capacity", ring.returnCapacity());
+	Console_TestAssertUpdate(result, 0 == ring.returnReadableSpan(readPtr), Console_WriteLine, "new ring is empty");
+	Console_TestAssertUpdate(result, 16 == ring.returnWritableSpan(writePtr), Console_WriteLine, "new ring is writable");
+	
+	// fill most of the ring and read part of it
+	Console_TestAssertUpdate(result, 12 == ring.write(kData, sizeof(kData)), Console_WriteLine, "first write");
+	spanSize = ring.returnReadableSpan(readPtr);
+	Console_TestAssertUpdate(result, (12 == spanSize) && (1 == readPtr[0]) && (12 == readPtr[11]), Console_WriteValue, "first read span", spanSize);
+	ring.commitRead(10);
+	Console_TestAssertUpdate(result, 2 == ring.returnSizeInUse(), Console_WriteValue, "size after first read", ring.returnSizeInUse());
+	
+	// the free space now wraps; only 4 bytes are contiguous
+	spanSize = ring.returnWritableSpan(writePtr);
+	Console_TestAssertUpdate(result, 4 == spanSize, Console_WriteValue, "writable span before wrap", spanSize);
+	Console_TestAssertUpdate(result, 12 == ring.write(kData, sizeof(kData)), Console_WriteLine, "wrapped write");
+	Console_TestAssertUpdate(result, 14 == ring.returnSizeInUse(), Console_WriteValue, "size after wrapped write", ring.returnSizeInUse());
+	Console_TestAssertUpdate(result, 2 == ring.write(kData, sizeof(kData)), Console_WriteLine, "write into full ring is truncated");
+	Console_TestAssertUpdate(result, 0 == ring.returnWritableSpan(writePtr), Console_WriteLine, "full ring is not writable");
+	
+	// reads see the bytes in order, in two spans
+	{
+		std::vector< UInt8 >	readBytes;
+		
+		
+		while (0 != (spanSize = ring.returnReadableSpan(readPtr)))
+		{
+			readBytes.insert(readBytes.end(), readPtr, readPtr + spanSize);
+			ring.commitRead(spanSize);
+		}
+		Console_TestAssertUpdate(result, 16 == readBytes.size(), Console_WriteValue, "bytes read", readBytes.size());
+		if (16 == readBytes.size())
+		{
+			UInt8 const		kExpected[] = { 11, 12, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 1, 2 };
+			
+			
+			Console_TestAssertUpdate(result, 0 == std::memcmp(kExpected, readBytes.data(), sizeof(kExpected)), Console_WriteLine, "bytes read in order");
+		}
+	}
+	Console_TestAssertUpdate(result, 0 == ring.returnSizeInUse(), Console_WriteValue, "size after reads", ring.returnSizeInUse());
+	
+	return result;
+}// unitTest_ReadWrite_000
+
+
+/*!
+Tests one producer thread and one consumer thread that
+transfer a large amount of data through a small ring.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_ReadWrite_001 ()
+{
+	Boolean				result = true;
+	ByteRing_Buffer		ring(256);
+	size_t const		kTotalBytes = 4 * 1024 * 1024;
+	size_t				mismatchCount = 0;
+	size_t				bytesRead = 0;
+	std::thread			producer([&ring, kTotalBytes]()
+						{
+							UInt8		chunk[97]; // odd size so that writes often wrap
+							size_t		bytesWritten = 0;
+							
+							
+							while (bytesWritten < kTotalBytes)
+							{
+								size_t const	kChunkSize = std::min(sizeof(chunk), kTotalBytes - bytesWritten);
+								size_t			chunkOffset = 0;
+								
+								
+								for (size_t i = 0; i < kChunkSize; ++i)
+								{
+									chunk[i] = STATIC_CAST((bytesWritten + i) % 251, UInt8);
+								}
+								while (chunkOffset < kChunkSize)
+								{
+									chunkOffset += ring.write(chunk + chunkOffset, kChunkSize - chunkOffset);
+									if (chunkOffset < kChunkSize)
+									{
+										std::this_thread::yield();
+									}
+								}
+								bytesWritten += kChunkSize;
+							}
+						});
+	
+	
+	while (bytesRead < kTotalBytes)
+	{
+		UInt8 const*	readPtr = nullptr;
+		size_t const	kSpanSize = ring.returnReadableSpan(readPtr);
+		
+		
+		if (0 == kSpanSize)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		for (size_t i = 0; i < kSpanSize; ++i)
+		{
+			if (readPtr[i] != STATIC_CAST((bytesRead + i) % 251, UInt8))
+			{
+				++mismatchCount;
+			}
+		}
+		ring.commitRead(kSpanSize);
+		bytesRead += kSpanSize;
+	}
+	producer.join();
+	
+	Console_TestAssertUpdate(result, kTotalBytes == bytesRead, Console_WriteValue, "threaded transfer, bytes read", bytesRead);
+	Console_TestAssertUpdate(result, 0 == mismatchCount, Console_WriteValue, "threaded transfer, mismatched bytes", mismatchCount);
+	Console_TestAssertUpdate(result, 0 == ring.returnSizeInUse(), Console_WriteValue, "threaded transfer, final size", ring.returnSizeInUse());
+	
+	return result;
+}// unitTest_ReadWrite_001
+
+} // anonymous namespace
+
+// BELOW IS REQUIRED NEWLINE TO END FILE
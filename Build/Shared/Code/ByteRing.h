@@ -0,0 +1,140 @@
+/*!	\file ByteRing.h
+	\brief A fixed-size ring of bytes that one thread fills
+	while another thread empties it, without locks.
+	
+	There must be exactly one producer thread (which calls only
+	the “write” methods) and one consumer thread (which calls
+	only the “read” methods) at any time.  Each side publishes
+	its progress with a single atomic counter, so neither side
+	ever waits for the other; when the ring is full or empty,
+	the caller decides how to wait (for instance, by using a
+	semaphore or by scheduling work on a queue).
+	
+	The producer can write straight into the ring (for example,
+	by calling read() on a file descriptor with the span that
+	is returned by returnWritableSpan()) and the consumer can
+	process bytes straight out of the ring, so that data need
+	not be copied on either side.
+*/
+/*###############################################################
+
+	Data Access Library
+	© 1998-2023 by Kevin Grant
+	
+	This library is free software; you can redistribute it or
+	modify it under the terms of the GNU Lesser Public License
+	as published by the Free Software Foundation; either version
+	2.1 of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be
+	useful, but WITHOUT ANY WARRANTY; without even the implied
+	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+	PURPOSE.  See the GNU Lesser Public License for details.
+	
+	You should have received a copy of the GNU Lesser Public
+	License along with this library; if not, write to:
+	
+		Free Software Foundation, Inc.
+		59 Temple Place, Suite 330
+		Boston, MA  02111-1307
+		USA
+
+###############################################################*/
+
+#include <UniversalDefines.h>
+
+#pragma once
+
+// standard-C++ includes
+#include <atomic>
+#include <memory>
+
+// Mac includes
+#include <CoreServices/CoreServices.h>
+
+
+
+#pragma mark Types
+
+/*!
+A single-producer, single-consumer ring of bytes.  The
+capacity is fixed at construction time (and rounded up to a
+power of two).
+
+The counters of bytes written and read only ever increase;
+their difference is the number of bytes in the ring, and the
+low bits of each counter locate the next byte to access.
+*/
+class ByteRing_Buffer
+{
+public:
+	explicit ByteRing_Buffer	(size_t);
+	
+	// producer side
+	
+	//! Makes the given number of bytes (from the start of the
+	//! most recent writable span) available to the consumer.
+	void
+	commitWrite		(size_t);
+	
+	//! Finds the largest contiguous free space (which may be
+	//! less than the total free space if it wraps around);
+	//! returns its size, or 0 if the ring is full.
+	size_t
+	returnWritableSpan	(UInt8*&);
+	
+	//! Copies as many of the given bytes as will fit and
+	//! commits them; returns the number of bytes copied.
+	size_t
+	write	(UInt8 const*, size_t);
+	
+	// consumer side
+	
+	//! Frees the given number of bytes (from the start of the
+	//! most recent readable span) for reuse by the producer.
+	void
+	commitRead	(size_t);
+	
+	//! Finds the largest contiguous block of unread bytes
+	//! (which may be less than the total if it wraps around);
+	//! returns its size, or 0 if the ring is empty.
+	size_t
+	returnReadableSpan	(UInt8 const*&);
+	
+	// either side
+	
+	//! Returns the total number of bytes that can be stored.
+	size_t
+	returnCapacity () const
+	{
+		return _capacity;
+	}
+	
+	//! Returns the number of unread bytes; this is only a
+	//! snapshot, since the other side may change it at once.
+	size_t
+	returnSizeInUse () const
+	{
+		return (_writeCount.load(std::memory_order_acquire) - _readCount.load(std::memory_order_acquire));
+	}
+
+private:
+	std::unique_ptr< UInt8[] >		_storage;		//!< the bytes of the ring
+	size_t							_capacity;		//!< a power of two
+	alignas(64) std::atomic< size_t >	_writeCount;	//!< total bytes ever committed by the producer
+	alignas(64) std::atomic< size_t >	_readCount;		//!< total bytes ever committed by the consumer
+};
+
+
+
+#pragma mark Public Methods
+
+//!\name Module Tests
+//@{
+
+void
+	ByteRing_RunTests	();
+
+//@}
+
+// BELOW IS REQUIRED NEWLINE TO END FILE
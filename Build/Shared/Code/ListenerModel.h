@@ -70,7 +70,8 @@ enum ListenerModel_Result
 {
 	kListenerModel_ResultOK							= 0,	//!< no error occurred
 	kListenerModel_ResultInvalidModelReference		= 1,	//!< listener model is not recognized
-	kListenerModel_ResultInvalidListenerReference	= 2		//!< listener is not recognized
+	kListenerModel_ResultInvalidListenerReference	= 2,	//!< listener is not recognized
+	kListenerModel_ResultStyleMismatch				= 3		//!< operation is not possible for the style of the model
 };
 
 /*!
@@ -202,6 +203,28 @@ ListenerModel_InvokeBooleanProc		(ListenerModel_BooleanProcPtr	inUserRoutine,
 	return (*inUserRoutine)(inFromWhichModel, inEventThatOccurred, inEventContextPtr, inListenerContextPtr);
 }
 
+/*!
+Coalescing Block
+
+Used with events that have been made coalescible by
+ListenerModel_SetEventCoalescing().  While an event is
+pending (that is, waiting to be delivered), its block
+is invoked for every coalescible event that is notified
+after it, including another instance of itself.
+
+The pending context is the model’s own copy, and it
+should be changed to account for the new event: when
+both events are the same, the new context is typically
+merged into the pending one (e.g. by finding the union
+of two ranges, or the sum of two distances), and when
+they are different the pending context may need to be
+adjusted (e.g. because rows have since moved).
+*/
+typedef void (^ListenerModel_CoalesceBlock)		(ListenerModel_Event	inPendingEvent,
+												 void*					inoutPendingContextPtr,
+												 ListenerModel_Event	inNewEvent,
+												 void const*			inNewContextPtr);
+
 
 
 #pragma mark Public Methods
@@ -270,6 +293,20 @@ ListenerModel_Result
 
 //@}
 
+//!\name Coalescing Events
+//@{
+
+ListenerModel_Result
+	ListenerModel_FlushCoalescedEvents		(ListenerModel_Ref				inForWhichModel);
+
+ListenerModel_Result
+	ListenerModel_SetEventCoalescing		(ListenerModel_Ref				inForWhichModel,
+											 ListenerModel_Event			inForWhichEvent,
+											 size_t							inContextSize,
+											 ListenerModel_CoalesceBlock	inCoalesceBlockOrNull = nullptr);
+
+//@}
+
 //!\name Accessing Listeners
 //@{
 
@@ -277,6 +314,11 @@ ListenerModel_Result
 	ListenerModel_GetDescriptor				(ListenerModel_Ref				inForWhichModel,
 											 ListenerModel_Descriptor*		outDescriptorPtr);
 
+ListenerModel_Result
+	ListenerModel_GetNotificationCounts		(ListenerModel_Ref				inForWhichModel,
+											 UInt64*						outDispatchedCountPtr,
+											 UInt64*						outCoalescedCountPtr);
+
 //@}
 
 
@@ -31,16 +31,14 @@
 
 // standard-C++ includes
 #import <algorithm>
-#import <map>
+#import <cstring>
+#import <memory>
 #import <vector>
 
 // library includes
 #import <CocoaExtensions.objc++.h>
 #import <Console.h>
-#import <MemoryBlockPtrLocker.template.h>
-#import <MemoryBlockReferenceLocker.template.h>
-#import <MemoryBlockReferenceTracker.template.h>
-#import <Registrar.template.h>
+#import <MemoryBlockSlotLocker.template.h>
 
 
 
@@ -82,37 +80,68 @@ Private properties.
 namespace {
 
 typedef std::vector< ListenerModel_ListenerRef >			My_ListenerList;
-typedef My_ListenerList*									My_ListenerListPtr;
-typedef std::map< ListenerModel_Event, My_ListenerListPtr >	My_EventToListenerListPtrMap;
 
-typedef MemoryBlockReferenceTracker< ListenerModel_Ref >			ListenerModelRefTracker;
-typedef Registrar< ListenerModel_Ref, ListenerModelRefTracker >		ListenerModelRefRegistrar;
+/*!
+The listeners for one event.  A model keeps these in a flat
+array that is sorted by event, which is much faster to search
+than a tree of separately-allocated nodes.  (Events are
+arbitrary four-character codes, so they are too sparse to be
+used directly as array indices.)
+*/
+struct My_EventListeners
+{
+	ListenerModel_Event		event;		// the event that these listeners respond to
+	My_ListenerList			listeners;	// notified in the order that they were added
+};
+typedef std::vector< My_EventListeners >	My_EventListenersList;
+
+/*!
+An event that is delivered after a delay instead of as soon
+as it is notified, so that any number of notifications in
+between can be merged into one (see
+ListenerModel_SetEventCoalescing()).
+*/
+struct My_CoalescedEvent
+{
+	void
+	setContext	(void*);
+	
+	ListenerModel_Event				event;				// the event that is deferred
+	size_t							contextSize;		// number of bytes to copy from each context; if 0, the pointer is saved
+	ListenerModel_CoalesceBlock		coalesceBlock;		// accounts for later notifications; may be nullptr
+	std::vector< UInt8 >			contextStorage;		// copy of the pending context, if "contextSize" is nonzero
+	void*							pendingContextPtr;	// the context that will be delivered
+	bool							isPending;			// if true, the event will be delivered at the next flush
+};
+typedef std::vector< My_CoalescedEvent >	My_CoalescedEventList;
 
 struct ListenerModel
 {
 	inline
 	ListenerModel ();
 	
-	ListenerModelRefRegistrar		refValidator;			// ensures this reference is recognized as a valid one
+	My_ListenerList*
+	returnListeners		(ListenerModel_Event, bool);
+	
 	ListenerModel_Descriptor		descriptor;				// user-defined identifier for this model
 	ListenerModelBehavior			notificationBehavior;	// a "kListenerModelBehavior..." constant describing how to notify listeners
 	ListenerModelCallbackType		callbackType;			// what kind all listeners must be
-	My_EventToListenerListPtrMap	eventListeners;			// associative array of one or more "Listener" structures per event type
+	My_EventListenersList			eventListeners;			// one or more "Listener" structures per event type, sorted by event
+	My_CoalescedEventList			coalescedEvents;		// events that are deferred, in the order that they are delivered
+	UInt64							dispatchCount;			// number of times that listeners were notified of an event
+	UInt64							coalesceCount;			// number of deferred notifications that were merged into pending ones
+	bool							flushScheduled;			// if true, pending events will be delivered soon
 };
 typedef ListenerModel*		ListenerModelPtr;
 
-typedef MemoryBlockPtrLocker< ListenerModel_Ref, ListenerModel >			ListenerModelPtrLocker;
+typedef MemoryBlockSlotLocker< ListenerModel_Ref, ListenerModel >			ListenerModelPtrLocker;
 typedef LockAcquireRelease< ListenerModel_Ref, ListenerModel >				ListenerModelAutoLocker;
 
-typedef MemoryBlockReferenceTracker< ListenerModel_ListenerRef >			ListenerReferenceTracker;
-typedef Registrar< ListenerModel_ListenerRef, ListenerReferenceTracker >	ListenerReferenceRegistrar;
-
 struct Listener
 {
 	inline
 	Listener ();
 	
-	ListenerReferenceRegistrar	refValidator;	// ensures this reference is recognized as a valid one
 	ListenerModelCallbackType	callbackType;	// a "kListenerModelCallbackType..." constant specifying the legal union member
 	void*						context;		// context assigned at creation time to help callback code figure out what, specifically, this is for
 	union
@@ -124,18 +153,23 @@ struct Listener
 typedef Listener*		ListenerPtr;
 typedef ListenerPtr*	ListenerHandle;
 
-typedef MemoryBlockPtrLocker< ListenerModel_ListenerRef, Listener >			ListenerPtrLocker;
+typedef MemoryBlockSlotLocker< ListenerModel_ListenerRef, Listener >		ListenerPtrLocker;	// also holds retain counts
 typedef LockAcquireRelease< ListenerModel_ListenerRef, Listener >			ListenerAutoLocker;
-typedef MemoryBlockReferenceLocker< ListenerModel_ListenerRef, Listener >	ListenerReferenceLocker;
 
 } // anonymous namespace
 
 #pragma mark Internal Method Prototypes
 namespace {
 
-void		objectiveCStandardListener	(ListenerModel_Ref, ListenerModel_Event, void*, void*);
-Boolean		unitTest000_Begin			();
-void		unitTest000_Callback1		(ListenerModel_Ref, ListenerModel_Event, void*, void*);
+void					deferEvent					(ListenerModel_Ref, ListenerModelPtr, My_CoalescedEvent&, void*);
+ListenerModel_Result	flushCoalescedEvents		(ListenerModel_Ref, ListenerModelPtr);
+ListenerModel_ListenerRef	newListenerRef			();
+ListenerModel_Result	notifyListeners				(ListenerModel_Ref, ListenerModelPtr, ListenerModel_Event, void*, void*);
+void					objectiveCStandardListener	(ListenerModel_Ref, ListenerModel_Event, void*, void*);
+Boolean					unitTest000_Begin			();
+void					unitTest000_Callback1		(ListenerModel_Ref, ListenerModel_Event, void*, void*);
+Boolean					unitTest001_Begin			();
+void					unitTest001_Callback1		(ListenerModel_Ref, ListenerModel_Event, void*, void*);
 
 } // anonymous namespace
 
@@ -143,13 +177,11 @@ void		unitTest000_Callback1		(ListenerModel_Ref, ListenerModel_Event, void*, voi
 namespace {
 
 ListenerModelPtrLocker&		gListenerModelPtrLocks ()	{ static ListenerModelPtrLocker x; return x; }
-ListenerModelRefTracker&	gListenerModelValidRefs ()	{ static ListenerModelRefTracker x; return x; }
 ListenerPtrLocker&			gListenerPtrLocks ()		{ static ListenerPtrLocker x; return x; }
-ListenerReferenceLocker&	gListenerRefLocks ()		{ static ListenerReferenceLocker x; return x; }
-ListenerReferenceTracker&	gListenerValidRefs ()		{ static ListenerReferenceTracker x; return x; }
 SInt32						gUnitTest000_CallCount = 0;
 ListenerModel_Ref			gUnitTest000_Model = nullptr;
 Boolean						gUnitTest000_Result = false;
+std::vector< SInt32 >		gUnitTest001_Deliveries;
 
 } // anonymous namespace
 
@@ -183,7 +215,7 @@ public:
 		bool				result = false;
 		
 		
-		if (gListenerValidRefs().end() == gListenerValidRefs().find(inListener))
+		if (false == gListenerPtrLocks().isValid(inListener))
 		{
 			Console_Warning(Console_WriteValueAddress, "attempt to notify nonexistent Boolean listener",
 							inListener);
@@ -238,7 +270,7 @@ public:
 		ListenerAutoLocker	listenerPtr(gListenerPtrLocks(), inListener);
 		
 		
-		if (gListenerValidRefs().end() == gListenerValidRefs().find(inListener))
+		if (false == gListenerPtrLocks().isValid(inListener))
 		{
 			Console_Warning(Console_WriteValueAddress, "attempt to notify nonexistent standard listener",
 							inListener);
@@ -287,6 +319,7 @@ ListenerModel_RunTests ()
 	
 	
 	++totalTests; if (false == unitTest000_Begin()) ++failedTests;
+	++totalTests; if (false == unitTest001_Begin()) ++failedTests;
 	
 	Console_WriteUnitTestReport("ListenerModel", failedTests, totalTests);
 }// RunTests
@@ -320,9 +353,15 @@ ListenerModel_New	(ListenerModel_Style		inStyle,
 	
 	try
 	{
-		result = REINTERPRET_CAST(new ListenerModel, ListenerModel_Ref);
+		std::unique_ptr< ListenerModel >	newModel(new ListenerModel);
+		
+		
+		// the locker only takes ownership once it has returned a
+		// reference, so the model is destroyed if that fails
+		result = gListenerModelPtrLocks().addBlock(newModel.get());
+		UNUSED_RETURN(ListenerModel*)newModel.release();
 	}
-	catch (std::bad_alloc)
+	catch (std::bad_alloc const&)
 	{
 		result = nullptr;
 	}
@@ -367,7 +406,7 @@ ListenerModel_Dispose	(ListenerModel_Ref*		inoutRefPtr)
 	}
 	else
 	{
-		delete *(REINTERPRET_CAST(inoutRefPtr, ListenerModel**));
+		delete gListenerModelPtrLocks().removeBlock(*inoutRefPtr);
 		*inoutRefPtr = nullptr;
 	}
 }// Dispose
@@ -393,7 +432,7 @@ ListenerModel_ListenerRef
 ListenerModel_NewBooleanListener	(ListenerModel_BooleanProcPtr	inCallback,
 									 void*							inContextOrNull)
 {
-	ListenerModel_ListenerRef	result = REINTERPRET_CAST(new Listener, ListenerModel_ListenerRef);
+	ListenerModel_ListenerRef	result = newListenerRef();
 	
 	
 	if (nullptr != result)
@@ -428,7 +467,7 @@ ListenerModel_ListenerRef
 ListenerModel_NewStandardListener	(ListenerModel_StandardProcPtr	inCallback,
 									 void*							inContextOrNull)
 {
-	ListenerModel_ListenerRef	result = REINTERPRET_CAST(new Listener, ListenerModel_ListenerRef);
+	ListenerModel_ListenerRef	result = newListenerRef();
 	
 	
 	if (nullptr != result)
@@ -463,13 +502,13 @@ void
 ListenerModel_RetainListener	(ListenerModel_ListenerRef		inRef)
 {
 	if ((nullptr == inRef) ||
-		(gListenerValidRefs().end() == gListenerValidRefs().find(inRef)))
+		(false == gListenerPtrLocks().isValid(inRef)))
 	{
 		Console_Warning(Console_WriteValueAddress, "attempt to retain a nonexistent listener", inRef);
 	}
 	else
 	{
-		gListenerRefLocks().acquireLock(inRef);
+		UNUSED_RETURN(UInt16)gListenerPtrLocks().retain(inRef);
 	}
 }// RetainListener
 
@@ -492,17 +531,16 @@ ListenerModel_ReleaseListener	(ListenerModel_ListenerRef*		inoutRefPtr)
 	if (nullptr != inoutRefPtr)
 	{
 		if ((nullptr == *inoutRefPtr) ||
-			(gListenerValidRefs().end() == gListenerValidRefs().find(*inoutRefPtr)))
+			(false == gListenerPtrLocks().isValid(*inoutRefPtr)))
 		{
 			Console_Warning(Console_WriteValueAddress, "attempt to release a nonexistent listener",
 							*inoutRefPtr);
 		}
 		else
 		{
-			gListenerRefLocks().releaseLock(*inoutRefPtr);
-			unless (gListenerRefLocks().isLocked(*inoutRefPtr))
+			if (0 == gListenerPtrLocks().release(*inoutRefPtr))
 			{
-				delete (REINTERPRET_CAST(*inoutRefPtr, Listener*));
+				delete gListenerPtrLocks().removeBlock(*inoutRefPtr);
 			}
 		}
 		*inoutRefPtr = nullptr;
@@ -557,31 +595,27 @@ ListenerModel_AddListenerForEvent	(ListenerModel_Ref			inToWhichModel,
 			}
 			else
 			{
-				if (ptr->eventListeners.end() == ptr->eventListeners.find(inForWhichEvent))
+				My_ListenerList*	listenerListPtr = nullptr;
+				
+				
+				try
 				{
-					// list does not yet exist - create it
-					try
-					{
-						My_ListenerList*	newListPtr = new My_ListenerList();
-						
-						
-						ptr->eventListeners.insert(My_EventToListenerListPtrMap::value_type(inForWhichEvent, newListPtr));
-						assert(ptr->eventListeners.end() != ptr->eventListeners.find(inForWhichEvent));
-					}
-					catch (std::bad_alloc)
-					{
-						// not enough memory?!?!?
-					}
+					// the list is created if it does not yet exist
+					listenerListPtr = ptr->returnListeners(inForWhichEvent, true/* create */);
 				}
-				if ((ptr->eventListeners.end() == ptr->eventListeners.find(inForWhichEvent)) ||
-						(nullptr == ptr->eventListeners[inForWhichEvent]))
+				catch (std::bad_alloc)
+				{
+					// not enough memory?!?!?
+				}
+				
+				if (nullptr == listenerListPtr)
 				{
 					result = false;
 				}
 				else
 				{
 					// add to the sequence of callbacks for this event
-					ptr->eventListeners[inForWhichEvent]->push_back(inListenerToAdd);
+					listenerListPtr->push_back(inListenerToAdd);
 				}
 			}
 		}
@@ -590,6 +624,47 @@ ListenerModel_AddListenerForEvent	(ListenerModel_Ref			inToWhichModel,
 }// AddListenerForEvent
 
 
+/*!
+Immediately notifies listeners of every coalescible event that
+is pending in the given model, in the order that the events
+were made coalescible.  This is done automatically at the next
+turn of the main run loop, and before any other event of the
+same model is delivered, so it is only necessary to call this
+if listeners must be up-to-date right away.
+
+\retval kListenerModel_ResultOK
+if no errors occur
+
+\retval kListenerModel_InvalidModelReference
+if "inForWhichModel" is not valid
+
+\retval kListenerModel_InvalidListenerReference
+if some listener found in the model is no longer valid
+
+(2023.10)
+*/
+ListenerModel_Result
+ListenerModel_FlushCoalescedEvents	(ListenerModel_Ref		inForWhichModel)
+{
+	ListenerModelAutoLocker		ptr(gListenerModelPtrLocks(), inForWhichModel);
+	ListenerModel_Result		result = kListenerModel_ResultOK;
+	
+	
+	if ((nullptr == ptr) ||
+		(false == gListenerModelPtrLocks().isValid(inForWhichModel)))
+	{
+		Console_Warning(Console_WriteLine, "attempt to flush events of nonexistent listener model");
+		result = kListenerModel_ResultInvalidModelReference;
+	}
+	else
+	{
+		result = flushCoalescedEvents(inForWhichModel, ptr);
+	}
+	
+	return result;
+}// FlushCoalescedEvents
+
+
 /*!
 Returns the unique ID assigned to the specified Listener
 Model when it was constructed.  You might use this to
@@ -610,6 +685,44 @@ ListenerModel_GetDescriptor		(ListenerModel_Ref			inForWhichModel,
 }// GetDescriptor
 
 
+/*!
+Returns the number of times that listeners of the given
+model were notified of some event, and the number of
+notifications of coalescible events that were merged into
+pending ones instead (see ListenerModel_SetEventCoalescing()).
+The sum of the two is the number of notifications that would
+have been delivered without coalescing.
+
+\retval kListenerModel_ResultOK
+if no errors occur
+
+\retval kListenerModel_InvalidModelReference
+if "inForWhichModel" is not valid
+
+(2023.10)
+*/
+ListenerModel_Result
+ListenerModel_GetNotificationCounts		(ListenerModel_Ref		inForWhichModel,
+										 UInt64*				outDispatchedCountPtr,
+										 UInt64*				outCoalescedCountPtr)
+{
+	ListenerModelAutoLocker		ptr(gListenerModelPtrLocks(), inForWhichModel);
+	ListenerModel_Result		result = kListenerModel_ResultOK;
+	
+	
+	if (nullptr == ptr)
+	{
+		result = kListenerModel_ResultInvalidModelReference;
+	}
+	else
+	{
+		if (nullptr != outDispatchedCountPtr) *outDispatchedCountPtr = ptr->dispatchCount;
+		if (nullptr != outCoalescedCountPtr) *outCoalescedCountPtr = ptr->coalesceCount;
+	}
+	return result;
+}// GetNotificationCounts
+
+
 /*!
 Returns "true" only if there is at least one listener
 installed in the given model for the specified event.
@@ -623,14 +736,14 @@ ListenerModel_IsAnyListenerForEvent		(ListenerModel_Ref		inForWhichModel,
 										 ListenerModel_Event	inEventThatOccurred)
 {
 	ListenerModelAutoLocker		ptr(gListenerModelPtrLocks(), inForWhichModel);
-	auto						toEventToListenerListPtr = ptr->eventListeners.find(inEventThatOccurred);
+	My_ListenerList const*		listenerListPtr = ptr->returnListeners(inEventThatOccurred, false/* create */);
 	Boolean						result = false;
 	
 	
-	if (ptr->eventListeners.end() != toEventToListenerListPtr)
+	if (nullptr != listenerListPtr)
 	{
 		// are any listeners in this list?
-		result = (false == toEventToListenerListPtr->second->empty());
+		result = (false == listenerListPtr->empty());
 	}
 	return result;
 }// IsAnyListenerForEvent
@@ -690,7 +803,15 @@ considered, it is purely an informational return value
 (but in the future, this routine may automatically remove
 listeners found to be invalid)
 
-(1.1)
+If the event has been made coalescible with
+ListenerModel_SetEventCoalescing(), listeners are not
+notified yet: the event is merged with any pending
+notification and delivered at the next turn of the main
+run loop (or sooner, if a non-coalescible event is
+notified or ListenerModel_FlushCoalescedEvents() is
+called).
+
+(2023.10)
 */
 ListenerModel_Result
 ListenerModel_NotifyListenersOfEvent	(ListenerModel_Ref		inForWhichModel,
@@ -703,7 +824,7 @@ ListenerModel_NotifyListenersOfEvent	(ListenerModel_Ref		inForWhichModel,
 	
 	
 	if ((nullptr == ptr) ||
-		(gListenerModelValidRefs().end() == gListenerModelValidRefs().find(inForWhichModel)))
+		(false == gListenerModelPtrLocks().isValid(inForWhichModel)))
 	{
 		Console_Warning(Console_WriteValueFourChars, "attempt to notify listeners in nonexistent model of event",
 						inEventThatOccurred);
@@ -711,66 +832,27 @@ ListenerModel_NotifyListenersOfEvent	(ListenerModel_Ref		inForWhichModel,
 	}
 	else
 	{
-		switch (ptr->callbackType)
-		{
-		case kListenerModelCallbackTypeStandard:
-			{
-				auto	toEventToListenerListPtr = ptr->eventListeners.find(inEventThatOccurred);
-				
-				
-				if (ptr->eventListeners.end() != toEventToListenerListPtr)
-				{
-					standardListenerInvoker		perListenerFunction(inForWhichModel, inEventThatOccurred,
-																	inEventContextPtr);
-					
-					
-					// invoke each Standard listener in turn
-					perListenerFunction = std::for_each(toEventToListenerListPtr->second->begin(),
-														toEventToListenerListPtr->second->end(), perListenerFunction);
-					
-					if (perListenerFunction.anyInvalidListeners())
-					{
-						result = kListenerModel_ResultInvalidListenerReference;
-					}
-				}
-			}
-			break;
+		auto	toCoalescedEvent = std::find_if(ptr->coalescedEvents.begin(), ptr->coalescedEvents.end(),
+												[=](My_CoalescedEvent const& inEvent) { return (inEvent.event == inEventThatOccurred); });
 		
-		case kListenerModelCallbackTypeBoolean:
+		
+		if (ptr->coalescedEvents.end() != toCoalescedEvent)
+		{
+			deferEvent(inForWhichModel, ptr, *toCoalescedEvent, inEventContextPtr);
+		}
+		else
+		{
+			ListenerModel_Result	notifyResult = kListenerModel_ResultOK;
+			
+			
+			// anything that is still deferred happened first, so it
+			// must be seen by listeners before this event is
+			result = flushCoalescedEvents(inForWhichModel, ptr);
+			notifyResult = notifyListeners(inForWhichModel, ptr, inEventThatOccurred, inEventContextPtr, outReturnValuePtrOrNull);
+			if (kListenerModel_ResultOK != notifyResult)
 			{
-				auto	toEventToListenerListPtr = ptr->eventListeners.find(inEventThatOccurred);
-				
-				
-				if (ptr->eventListeners.end() != toEventToListenerListPtr)
-				{
-					// invoke each Boolean listener and stop as soon as one returns true;
-					// the fact that the callback invoker is modeled as a Predicate allows
-					// the STL find_if() algorithm to be exploited to do the right thing here
-					booleanListenerInvoker		perListenerFunction(inForWhichModel, inEventThatOccurred,
-																			inEventContextPtr);
-					auto						toListener = std::find_if(toEventToListenerListPtr->second->begin(),
-																			toEventToListenerListPtr->second->end(),
-																			perListenerFunction);
-					Boolean						someListenerReturnedTrue = false;
-					
-					
-					someListenerReturnedTrue = (toEventToListenerListPtr->second->end() != toListener);
-					if (nullptr != outReturnValuePtrOrNull)
-					{
-						*(REINTERPRET_CAST(outReturnValuePtrOrNull, Boolean*)) = someListenerReturnedTrue;
-					}
-					
-					if (perListenerFunction.anyInvalidListeners())
-					{
-						result = kListenerModel_ResultInvalidListenerReference;
-					}
-				}
+				result = notifyResult;
 			}
-			break;
-		
-		default:
-			// ???
-			break;
 		}
 	}
 	
@@ -809,14 +891,14 @@ ListenerModel_RemoveListenerForEvent	(ListenerModel_Ref			inFromWhichModel,
 	
 	
 	if ((nullptr == ptr) ||
-		(gListenerModelValidRefs().end() == gListenerModelValidRefs().find(inFromWhichModel)))
+		(false == gListenerModelPtrLocks().isValid(inFromWhichModel)))
 	{
 		Console_Warning(Console_WriteValueFourChars, "attempt to remove listener from nonexistent model for event",
 						inForWhichEvent);
 		result = kListenerModel_ResultInvalidModelReference;
 	}
 	else if ((nullptr == inListenerToRemove) ||
-				(gListenerValidRefs().end() == gListenerValidRefs().find(inListenerToRemove)))
+				(false == gListenerPtrLocks().isValid(inListenerToRemove)))
 	{
 		Console_Warning(Console_WriteValueFourChars, "attempt to remove nonexistent listener for event",
 						inForWhichEvent);
@@ -824,14 +906,11 @@ ListenerModel_RemoveListenerForEvent	(ListenerModel_Ref			inFromWhichModel,
 	}
 	else
 	{
-		auto	toEventToListenerListPtr = ptr->eventListeners.find(inForWhichEvent);
+		My_ListenerList*	listenerListPtr = ptr->returnListeners(inForWhichEvent, false/* create */);
 		
 		
-		if (ptr->eventListeners.end() != toEventToListenerListPtr)
+		if (nullptr != listenerListPtr)
 		{
-			My_EventToListenerListPtrMap::mapped_type	listenerListPtr = toEventToListenerListPtr->second;
-			
-			
 			// delete occurrences of the given listener in the list for this event
 			listenerListPtr->erase(std::remove(listenerListPtr->begin(), listenerListPtr->end(), inListenerToRemove),
 									listenerListPtr->end());
@@ -842,19 +921,112 @@ ListenerModel_RemoveListenerForEvent	(ListenerModel_Ref			inFromWhichModel,
 }// RemoveListenerForEvent
 
 
+/*!
+Makes the specified event of the given model coalescible:
+instead of notifying listeners right away, the event is
+delivered at the next turn of the main run loop, so that
+everything notified in between is seen by listeners only
+once.  Use this for events that can occur many times in a
+row, when listeners only care about the net effect.
+
+Since the event context usually describes something that
+only exists at notification time, a copy is made of the
+given number of bytes (e.g. the size of a structure that
+the context points to).  If the size is zero, the context
+pointer itself is saved instead, and only the most recent
+one is delivered; this is appropriate when the context is
+simply a reference to the object that changed.
+
+While the event is pending, the given block (if any) is
+invoked for each coalescible event of the model that is
+notified, and it must update the copy of the context to
+account for the new event.  Without a block, the context
+of the most recent notification is delivered.
+
+Coalescible events of the same model are always delivered
+in the order that they were made coalescible, which matters
+if one event changes the meaning of another (for example, a
+scroll should be delivered before text changes whose ranges
+assume that rows have already moved).  Any non-coalescible
+event causes pending events to be delivered first.
+
+IMPORTANT:	Deferred events cannot return values, so only
+			models of the standard style (where every
+			listener is notified regardless) can have
+			coalescible events.  Also, the model must
+			only be used from the main thread.
+
+\retval kListenerModel_ResultOK
+if no errors occur
+
+\retval kListenerModel_InvalidModelReference
+if "inForWhichModel" is not valid
+
+\retval kListenerModel_ResultStyleMismatch
+if the model does not have the standard style
+
+(2023.10)
+*/
+ListenerModel_Result
+ListenerModel_SetEventCoalescing	(ListenerModel_Ref				inForWhichModel,
+									 ListenerModel_Event			inForWhichEvent,
+									 size_t							inContextSize,
+									 ListenerModel_CoalesceBlock	inCoalesceBlockOrNull)
+{
+	ListenerModelAutoLocker		ptr(gListenerModelPtrLocks(), inForWhichModel);
+	ListenerModel_Result		result = kListenerModel_ResultOK;
+	
+	
+	if ((nullptr == ptr) ||
+		(false == gListenerModelPtrLocks().isValid(inForWhichModel)))
+	{
+		Console_Warning(Console_WriteValueFourChars, "attempt to coalesce event of nonexistent listener model",
+						inForWhichEvent);
+		result = kListenerModel_ResultInvalidModelReference;
+	}
+	else if (kListenerModelCallbackTypeStandard != ptr->callbackType)
+	{
+		Console_Warning(Console_WriteValueFourChars, "attempt to coalesce event of listener model that requires return values",
+						inForWhichEvent);
+		result = kListenerModel_ResultStyleMismatch;
+	}
+	else
+	{
+		// anything pending is delivered before the rules change
+		result = flushCoalescedEvents(inForWhichModel, ptr);
+		{
+			auto	toCoalescedEvent = std::find_if(ptr->coalescedEvents.begin(), ptr->coalescedEvents.end(),
+													[=](My_CoalescedEvent const& inEvent) { return (inEvent.event == inForWhichEvent); });
+			
+			
+			if (ptr->coalescedEvents.end() == toCoalescedEvent)
+			{
+				toCoalescedEvent = ptr->coalescedEvents.insert(ptr->coalescedEvents.end(), My_CoalescedEvent());
+			}
+			toCoalescedEvent->event = inForWhichEvent;
+			toCoalescedEvent->contextSize = inContextSize;
+			toCoalescedEvent->coalesceBlock = inCoalesceBlockOrNull;
+			toCoalescedEvent->contextStorage.resize(inContextSize);
+			toCoalescedEvent->pendingContextPtr = nullptr;
+			toCoalescedEvent->isPending = false;
+		}
+	}
+	
+	return result;
+}// SetEventCoalescing
+
+
 #pragma mark Internal Methods
 namespace {
 
 /*!
-Initializes a new Listener instance and registers
-its address in a table of valid references.  At
-destruction time, the address is automatically
-unregistered.
+Initializes a new Listener instance.  Its reference
+comes from gListenerPtrLocks() (see
+ListenerModel_NewStandardListener()).
 */
 Listener::
 Listener ()
 :
-refValidator(REINTERPRET_CAST(this, ListenerModel_ListenerRef), gListenerValidRefs()),
 callbackType(kListenerModelCallbackTypeStandard),
 context(nullptr)
 {
@@ -863,23 +1035,312 @@ context(nullptr)
 
 
 /*!
-Initializes a new ListenerModel instance and
-registers its address in a table of valid
-references.  At destruction time, the address
-is automatically unregistered.
+Initializes a new ListenerModel instance.  Its
+reference comes from gListenerModelPtrLocks()
+(see ListenerModel_New()).
 */
 ListenerModel::
 ListenerModel ()
 :
-refValidator(REINTERPRET_CAST(this, ListenerModel_Ref), gListenerModelValidRefs()),
 descriptor(kListenerModel_InvalidDescriptor),
 notificationBehavior(kListenerModelBehaviorNotifyAllSequentially),
 callbackType(kListenerModelCallbackTypeStandard),
-eventListeners()
+eventListeners(),
+coalescedEvents(),
+dispatchCount(0),
+coalesceCount(0),
+flushScheduled(false)
 {
 }// ListenerModel default constructor
 
 
+/*!
+Returns the list of listeners for the specified event, or
+nullptr if there is no such list.  If "inCreate" is true,
+an empty list is inserted when there is no list (this may
+throw "std::bad_alloc").
+
+IMPORTANT:	The result is only valid until the next time
+			that a list is created.
+
+(2023.10)
+*/
+My_ListenerList*
+ListenerModel::
+returnListeners		(ListenerModel_Event	inEvent,
+					 bool					inCreate)
+{
+	auto				toEventListeners = std::lower_bound(this->eventListeners.begin(), this->eventListeners.end(), inEvent,
+															[](My_EventListeners const& inEntry, ListenerModel_Event inKey)
+															{ return (inEntry.event < inKey); });
+	My_ListenerList*	result = nullptr;
+	
+	
+	if ((this->eventListeners.end() != toEventListeners) && (inEvent == toEventListeners->event))
+	{
+		result = &(toEventListeners->listeners);
+	}
+	else if (inCreate)
+	{
+		My_EventListeners	newEntry;
+		
+		
+		newEntry.event = inEvent;
+		toEventListeners = this->eventListeners.insert(toEventListeners, newEntry);
+		result = &(toEventListeners->listeners);
+	}
+	return result;
+}// ListenerModel::returnListeners
+
+
+/*!
+Saves the given context as the one to be delivered for this
+event, copying what it points to if the event requires that.
+
+(2023.10)
+*/
+void
+My_CoalescedEvent::
+setContext	(void*		inContextPtr)
+{
+	if (0 == this->contextSize)
+	{
+		this->pendingContextPtr = inContextPtr;
+	}
+	else
+	{
+		std::memcpy(this->contextStorage.data(), inContextPtr, this->contextSize);
+		this->pendingContextPtr = this->contextStorage.data();
+	}
+}// My_CoalescedEvent::setContext
+
+
+/*!
+Records a notification of a coalescible event without
+notifying any listeners: every pending event is given
+the chance to account for it, and the event becomes
+pending itself if it was not already.  If necessary,
+flushCoalescedEvents() is arranged to be called at the
+next turn of the main run loop.
+
+(2023.10)
+*/
+void
+deferEvent	(ListenerModel_Ref		inModel,
+			 ListenerModelPtr		inPtr,
+			 My_CoalescedEvent&		inoutEvent,
+			 void*					inEventContextPtr)
+{
+	// every pending event may have to account for the new one
+	// (including an earlier notification of the same event)
+	for (auto& pendingEvent : inPtr->coalescedEvents)
+	{
+		if ((pendingEvent.isPending) && (nullptr != pendingEvent.coalesceBlock))
+		{
+			pendingEvent.coalesceBlock(pendingEvent.event, pendingEvent.pendingContextPtr,
+										inoutEvent.event, inEventContextPtr);
+		}
+	}
+	
+	if (inoutEvent.isPending)
+	{
+		// without a block, the most recent context wins
+		if (nullptr == inoutEvent.coalesceBlock)
+		{
+			inoutEvent.setContext(inEventContextPtr);
+		}
+		++(inPtr->coalesceCount);
+	}
+	else
+	{
+		inoutEvent.setContext(inEventContextPtr);
+		inoutEvent.isPending = true;
+	}
+	
+	unless (inPtr->flushScheduled)
+	{
+		ListenerModel_Ref const		kModel = inModel;
+		
+		
+		inPtr->flushScheduled = true;
+		CocoaExtensions_RunLater(0/* seconds */,
+									^{
+										ListenerModelAutoLocker		ptr(gListenerModelPtrLocks(), kModel);
+										
+										
+										// the model may have been destroyed in the meantime, in
+										// which case any pending events are simply dropped
+										if (nullptr != ptr)
+										{
+											ptr->flushScheduled = false;
+											UNUSED_RETURN(ListenerModel_Result)flushCoalescedEvents(kModel, ptr);
+										}
+									});
+	}
+}// deferEvent
+
+
+/*!
+Notifies listeners of every pending coalescible event of
+the given model, in the order that the events were made
+coalescible.
+
+Listeners may cause events to be deferred again while
+this is in progress; an event that is not yet delivered
+simply absorbs them, and anything else is delivered at
+the next flush.
+
+(2023.10)
+*/
+ListenerModel_Result
+flushCoalescedEvents	(ListenerModel_Ref		inModel,
+						 ListenerModelPtr		inPtr)
+{
+	ListenerModel_Result	result = kListenerModel_ResultOK;
+	
+	
+	// an index is used because listeners could change the list
+	for (size_t i = 0; i < inPtr->coalescedEvents.size(); ++i)
+	{
+		My_CoalescedEvent&	coalescedEvent = inPtr->coalescedEvents[i];
+		
+		
+		if (coalescedEvent.isPending)
+		{
+			// listeners receive their own copy of the context, since the
+			// model’s copy is reused if the event is deferred again
+			std::vector< UInt8 >	contextCopy(coalescedEvent.contextStorage);
+			ListenerModel_Event		event = coalescedEvent.event;
+			void*					contextPtr = ((0 == coalescedEvent.contextSize)
+													? coalescedEvent.pendingContextPtr
+													: contextCopy.data());
+			ListenerModel_Result	notifyResult = kListenerModel_ResultOK;
+			
+			
+			coalescedEvent.isPending = false;
+			notifyResult = notifyListeners(inModel, inPtr, event, contextPtr, nullptr/* return value */);
+			if (kListenerModel_ResultOK != notifyResult)
+			{
+				result = notifyResult;
+			}
+		}
+	}
+	
+	return result;
+}// flushCoalescedEvents
+
+
+/*!
+Creates a new Listener and returns its reference from
+gListenerPtrLocks(), or nullptr if either could not be
+allocated (in which case nothing is leaked).
+
+(2023.10)
+*/
+ListenerModel_ListenerRef
+newListenerRef ()
+{
+	ListenerModel_ListenerRef	result = nullptr;
+	
+	
+	try
+	{
+		std::unique_ptr< Listener >		newListener(new Listener);
+		
+		
+		// the locker only takes ownership once it has returned a reference
+		result = gListenerPtrLocks().addBlock(newListener.get());
+		UNUSED_RETURN(Listener*)newListener.release();
+	}
+	catch (std::bad_alloc const&)
+	{
+		result = nullptr;
+	}
+	return result;
+}// newListenerRef
+
+
+/*!
+Invokes callback routines registered as listeners for the
+given event right away, as described for the public routine
+ListenerModel_NotifyListenersOfEvent().
+
+(2023.10)
+*/
+ListenerModel_Result
+notifyListeners		(ListenerModel_Ref		inModel,
+					 ListenerModelPtr		inPtr,
+					 ListenerModel_Event	inEventThatOccurred,
+					 void*					inEventContextPtr,
+					 void*					outReturnValuePtrOrNull)
+{
+	My_ListenerList*		listenerListPtr = inPtr->returnListeners(inEventThatOccurred, false/* create */);
+	ListenerModel_Result	result = kListenerModel_ResultOK;
+	
+	
+	if (nullptr != listenerListPtr)
+	{
+		// iterators are kept because listeners might add lists for other
+		// events, which moves every list (but not their contents)
+		auto const	kFirstListener = listenerListPtr->begin();
+		auto const	kPastLastListener = listenerListPtr->end();
+		
+		
+		if (kFirstListener != kPastLastListener)
+		{
+			++(inPtr->dispatchCount);
+		}
+		
+		switch (inPtr->callbackType)
+		{
+		case kListenerModelCallbackTypeStandard:
+			{
+				standardListenerInvoker		perListenerFunction(inModel, inEventThatOccurred, inEventContextPtr);
+				
+				
+				// invoke each Standard listener in turn
+				perListenerFunction = std::for_each(kFirstListener, kPastLastListener, perListenerFunction);
+				
+				if (perListenerFunction.anyInvalidListeners())
+				{
+					result = kListenerModel_ResultInvalidListenerReference;
+				}
+			}
+			break;
+		
+		case kListenerModelCallbackTypeBoolean:
+			{
+				// invoke each Boolean listener and stop as soon as one returns true;
+				// the fact that the callback invoker is modeled as a Predicate allows
+				// the STL find_if() algorithm to be exploited to do the right thing here
+				booleanListenerInvoker		perListenerFunction(inModel, inEventThatOccurred, inEventContextPtr);
+				auto						toListener = std::find_if(kFirstListener, kPastLastListener, perListenerFunction);
+				Boolean						someListenerReturnedTrue = false;
+				
+				
+				someListenerReturnedTrue = (kPastLastListener != toListener);
+				if (nullptr != outReturnValuePtrOrNull)
+				{
+					*(REINTERPRET_CAST(outReturnValuePtrOrNull, Boolean*)) = someListenerReturnedTrue;
+				}
+				
+				if (perListenerFunction.anyInvalidListeners())
+				{
+					result = kListenerModel_ResultInvalidListenerReference;
+				}
+			}
+			break;
+		
+		default:
+			// ???
+			break;
+		}
+	}
+	
+	return result;
+}// notifyListeners
+
+
 /*!
 This C-based callback is invoked by a listener model in the
 usual way, and it forwards the event to a particular object
@@ -1017,6 +1478,133 @@ unitTest000_Callback1	(ListenerModel_Ref		inModel,
 	++gUnitTest000_CallCount;
 }// unitTest000_Callback1
 
+
+/*!
+Tests coalescible events: they must not be delivered until a
+flush, they must be merged in between, and they must arrive in
+the order that coalescing was set up (and before any other
+event that is notified later).
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest001_Begin ()
+{
+	Boolean						result = true;
+	ListenerModel_ListenerWrap	callbackWrapper;
+	ListenerModel_Ref			model = ListenerModel_New(kListenerModel_StyleStandard, 'u001');
+	ListenerModel_Ref			booleanModel = ListenerModel_New(kListenerModel_StyleLogicalOR, 'u001');
+	ListenerModel_Result		modelError = kListenerModel_ResultOK;
+	UInt64						dispatchedCount = 0;
+	UInt64						coalescedCount = 0;
+	SInt32						value = 0;
+	
+	
+	callbackWrapper.setWithNoRetain(ListenerModel_NewStandardListener(unitTest001_Callback1));
+	result &= Console_Assert("wrapper constructed", nullptr != callbackWrapper.returnRef());
+	result &= Console_Assert("model constructed", nullptr != model);
+	result &= Console_Assert("listener installed for sum", ListenerModel_AddListenerForEvent(model, 'sum ', callbackWrapper.returnRef()));
+	result &= Console_Assert("listener installed for last", ListenerModel_AddListenerForEvent(model, 'last', callbackWrapper.returnRef()));
+	result &= Console_Assert("listener installed for sync", ListenerModel_AddListenerForEvent(model, 'sync', callbackWrapper.returnRef()));
+	
+	// "sum " events are added together; "last" events deliver only
+	// the most recent context pointer; and "sum " comes first
+	modelError = ListenerModel_SetEventCoalescing(model, 'sum ', sizeof(SInt32),
+	^(ListenerModel_Event	inPendingEvent,
+	  void*					inoutPendingContextPtr,
+	  ListenerModel_Event	inNewEvent,
+	  void const*			inNewContextPtr)
+	{
+		if (inPendingEvent == inNewEvent)
+		{
+			*(REINTERPRET_CAST(inoutPendingContextPtr, SInt32*)) += *(REINTERPRET_CAST(inNewContextPtr, SInt32 const*));
+		}
+	});
+	result &= Console_Assert("no errors coalescing sum", kListenerModel_ResultOK == modelError);
+	modelError = ListenerModel_SetEventCoalescing(model, 'last', 0/* context size */);
+	result &= Console_Assert("no errors coalescing last", kListenerModel_ResultOK == modelError);
+	modelError = ListenerModel_SetEventCoalescing(booleanModel, 'last', 0/* context size */);
+	result &= Console_Assert("no coalescing for Boolean models", kListenerModel_ResultStyleMismatch == modelError);
+	
+	// nothing is delivered until a non-coalescible event occurs
+	gUnitTest001_Deliveries.clear();
+	UNUSED_RETURN(ListenerModel_Result)ListenerModel_NotifyListenersOfEvent(model, 'last', REINTERPRET_CAST(7, void*));
+	value = 1;
+	UNUSED_RETURN(ListenerModel_Result)ListenerModel_NotifyListenersOfEvent(model, 'sum ', &value);
+	value = 2;
+	UNUSED_RETURN(ListenerModel_Result)ListenerModel_NotifyListenersOfEvent(model, 'sum ', &value);
+	value = 3;
+	UNUSED_RETURN(ListenerModel_Result)ListenerModel_NotifyListenersOfEvent(model, 'sum ', &value);
+	UNUSED_RETURN(ListenerModel_Result)ListenerModel_NotifyListenersOfEvent(model, 'last', REINTERPRET_CAST(9, void*));
+	result &= Console_Assert("no deliveries before flush", gUnitTest001_Deliveries.empty());
+	modelError = ListenerModel_NotifyListenersOfEvent(model, 'sync', nullptr/* context */);
+	result &= Console_Assert("no errors on notify", kListenerModel_ResultOK == modelError);
+	result &= Console_Assert("three deliveries", 3 == gUnitTest001_Deliveries.size());
+	if (3 == gUnitTest001_Deliveries.size())
+	{
+		result &= Console_Assert("sum delivered first", 6 == gUnitTest001_Deliveries[0]);
+		result &= Console_Assert("last delivered second", 9 == gUnitTest001_Deliveries[1]);
+		result &= Console_Assert("sync delivered third", -1 == gUnitTest001_Deliveries[2]);
+	}
+	modelError = ListenerModel_GetNotificationCounts(model, &dispatchedCount, &coalescedCount);
+	result &= Console_Assert("no errors getting counts", kListenerModel_ResultOK == modelError);
+	result &= Console_Assert("proper dispatch count", 3 == dispatchedCount);
+	result &= Console_Assert("proper coalesce count", 3 == coalescedCount);
+	
+	// explicit flushes deliver pending events once
+	value = 4;
+	UNUSED_RETURN(ListenerModel_Result)ListenerModel_NotifyListenersOfEvent(model, 'sum ', &value);
+	value = 0; // the model must have made a copy
+	modelError = ListenerModel_FlushCoalescedEvents(model);
+	result &= Console_Assert("no errors on flush", kListenerModel_ResultOK == modelError);
+	modelError = ListenerModel_FlushCoalescedEvents(model);
+	result &= Console_Assert("no errors on second flush", kListenerModel_ResultOK == modelError);
+	result &= Console_Assert("one more delivery", 4 == gUnitTest001_Deliveries.size());
+	if (4 == gUnitTest001_Deliveries.size())
+	{
+		result &= Console_Assert("copied context delivered", 4 == gUnitTest001_Deliveries[3]);
+	}
+	
+	ListenerModel_Dispose(&booleanModel);
+	ListenerModel_Dispose(&model);
+	result &= Console_Assert("model nullified", nullptr == model);
+	
+	return result;
+}// unitTest001_Begin
+
+
+/*!
+Test callback used with unitTest001_Begin(); records
+what was delivered.
+
+(2023.10)
+*/
+void
+unitTest001_Callback1	(ListenerModel_Ref		UNUSED_ARGUMENT(inModel),
+						 ListenerModel_Event	inEvent,
+						 void*					inEventContext,
+						 void*					UNUSED_ARGUMENT(inListenerContext))
+{
+	switch (inEvent)
+	{
+	case 'sum ':
+		gUnitTest001_Deliveries.push_back(*(REINTERPRET_CAST(inEventContext, SInt32*)));
+		break;
+	
+	case 'last':
+		gUnitTest001_Deliveries.push_back(STATIC_CAST(REINTERPRET_CAST(inEventContext, intptr_t), SInt32));
+		break;
+	
+	default:
+		gUnitTest001_Deliveries.push_back(-1);
+		break;
+	}
+}// unitTest001_Callback1
+
 }// anonymous namespace
 
 
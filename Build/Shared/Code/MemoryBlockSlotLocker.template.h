@@ -0,0 +1,754 @@
+/*!	\file MemoryBlockSlotLocker.template.h
+	\brief A refinement of MemoryBlockLocker that stores memory
+	blocks in a table of slots, so that references can be
+	validated and locked without any hashing.
+	
+	An opaque reference created by this class is not a pointer;
+	it combines the index of a slot with a “generation” number
+	that changes whenever the slot is reused.  A reference to a
+	block that has been removed therefore never validates, even
+	if its slot now holds a different block.  Lock counts and
+	retain counts are kept in the slot itself, so every lookup
+	is a bounds check and a comparison.
+	
+	This replaces the combination of a MemoryBlockPtrLocker (for
+	lock counts), a MemoryBlockReferenceLocker (for retain counts)
+	and a MemoryBlockReferenceTracker with a Registrar (for
+	validity checks).
+*/
+/*###############################################################
+
+	Data Access Library
+	© 1998-2023 by Kevin Grant
+	
+	This library is free software; you can redistribute it or
+	modify it under the terms of the GNU Lesser Public License
+	as published by the Free Software Foundation; either version
+	2.1 of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be
+	useful, but WITHOUT ANY WARRANTY; without even the implied
+	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+	PURPOSE.  See the GNU Lesser Public License for details.
+	
+	You should have received a copy of the GNU Lesser Public
+	License along with this library; if not, write to:
+	
+		Free Software Foundation, Inc.
+		59 Temple Place, Suite 330
+		Boston, MA  02111-1307
+		USA
+
+###############################################################*/
+
+#include <UniversalDefines.h>
+
+#pragma once
+
+// standard-C++ includes
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Mac includes
+#include <CoreServices/CoreServices.h>
+
+// library includes
+#include <Console.h>
+#include <MemoryBlockLocker.template.h>
+#include <MemoryBlockPtrLocker.template.h>
+#include <MemoryBlockReferenceTracker.template.h>
+
+
+
+#pragma mark Types
+
+/*!
+Stores pointers to memory blocks in numbered slots, giving
+each block a reference that encodes its slot index and the
+generation of that slot.  Use addBlock() to create a reference
+and removeBlock() to invalidate it (the memory block itself is
+not allocated or freed by this class).
+
+Locks (see acquireLock() and releaseLock(), or more typically
+LockAcquireRelease) are counted separately from retains (see
+retain() and release()), matching the way that a module would
+use a MemoryBlockPtrLocker and a MemoryBlockReferenceLocker
+for the same references.
+
+Unlike the parent class, a lock is only acquired for a valid
+reference; acquireLock() returns nullptr if the reference was
+never added or has been removed.
+*/
+template < typename structure_reference_type, typename structure_type, bool debugged = false >
+class MemoryBlockSlotLocker:
+public MemoryBlockLocker< structure_reference_type, structure_type, debugged >
+{
+public:
+	typedef void (*DisposeProcPtr)(structure_type*);
+	
+	//! create a locker that optionally calls a dispose routine when lock count returns to zero
+	MemoryBlockSlotLocker	(DisposeProcPtr = nullptr);
+	
+	//! returns the block for a valid reference after incrementing its lock count (or "null", if invalid)
+	structure_type*
+	acquireLock				(structure_reference_type	inReference) override;
+	
+	//! stores the given block in a free slot and returns its new reference
+	structure_reference_type
+	addBlock				(structure_type*			inBlock);
+	
+	//! removes every block and invalidates every reference; USE WITH CARE
+	void
+	clear					() override;
+	
+	//! determines if there are any locks on the specified reference’s memory block
+	bool
+	isLocked				(structure_reference_type	inReference) const override;
+	
+	//! determines if the reference was returned by addBlock() and has not been removed since
+	inline bool
+	isValid					(structure_reference_type	inReference) const;
+	
+	//! decrements the retain count of a valid reference, returning the new value
+	UInt16
+	release					(structure_reference_type	inReference);
+	
+	//! decrements the lock count and nullifies the given pointer
+	void
+	releaseLock				(structure_reference_type	inReference,
+							 structure_type**			inoutPtrPtr) override;
+	
+	//! invalidates the reference (and every copy of it) and returns its block, which the caller may then destroy
+	structure_type*
+	removeBlock				(structure_reference_type	inReference);
+	
+	//! increments the retain count of a valid reference, returning the new value
+	UInt16
+	retain					(structure_reference_type	inReference);
+	
+	//! returns the block for a valid reference without locking it (or "null", if invalid)
+	inline structure_type*
+	returnBlock				(structure_reference_type	inReference) const;
+	
+	//! the number of locks acquired without being released (0 for invalid references)
+	UInt16
+	returnLockCount			(structure_reference_type	inReference) const override;
+	
+	//! the number of retains without releases (0 for invalid references)
+	UInt16
+	returnRetainCount		(structure_reference_type	inReference) const;
+	
+	//! test routine
+	static Boolean
+	unitTest ();
+
+protected:
+
+private:
+	struct Slot
+	{
+		structure_type*		block;			//!< if nullptr, the slot is free
+		UInt32				generation;		//!< incremented each time the slot is freed
+		UInt16				lockCount;		//!< see acquireLock()
+		UInt16				retainCount;	//!< see retain()
+	};
+	
+	//! finds the slot for a valid reference (or returns nullptr)
+	inline Slot*
+	returnSlot		(structure_reference_type	inReference);
+	
+	//! finds the slot for a valid reference (or returns nullptr)
+	inline Slot const*
+	returnSlot		(structure_reference_type	inReference) const;
+	
+	std::vector< Slot >		_slots;			//!< every slot ever used; index is part of each reference
+	std::vector< UInt32 >	_freeIndices;	//!< slots that can be reused by addBlock()
+	DisposeProcPtr			_disposer;
+	bool					_requireLocks;	//!< cleared while the disposer runs (see MemoryBlockPtrLocker)
+};
+
+struct MemoryBlockSlotLocker_TestClass
+{
+	int		x;
+};
+typedef struct MemoryBlockSlotLocker_TestClass*		MemoryBlockSlotLocker_TestClassRef;
+
+
+
+#pragma mark Public Methods
+
+/*!
+Measures the cost of validating, locking and unlocking
+references in typical patterns (as used for every
+keystroke, block of terminal data and listener callback),
+comparing a MemoryBlockSlotLocker to the combination of
+a MemoryBlockPtrLocker and MemoryBlockReferenceTracker
+that it replaces.  Results are logged to the console.
+
+(2023.10)
+*/
+inline void
+MemoryBlockSlotLocker_RunBenchmarks ()
+{
+	typedef MemoryBlockSlotLocker_TestClass									SlotTestClass;
+	typedef MemoryBlockSlotLocker_TestClassRef								SlotTestClassRef;
+	typedef MemoryBlockPtrLocker< SlotTestClassRef, SlotTestClass >			HashLockerClass;
+	typedef MemoryBlockReferenceTracker< SlotTestClassRef >					HashTrackerClass;
+	typedef MemoryBlockSlotLocker< SlotTestClassRef, SlotTestClass >		SlotLockerClass;
+	typedef LockAcquireRelease< SlotTestClassRef, SlotTestClass >			AutoLockerClass;
+	UInt16 const	kObjectCounts[] = { 16, 1024 };
+	UInt32 const	kCallCount = 4000000;
+	
+	
+	for (UInt16 objectCount : kObjectCounts)
+	{
+		std::vector< SlotTestClass >		objects(objectCount);
+		std::vector< SlotTestClassRef >		hashRefs;
+		std::vector< SlotTestClassRef >		slotRefs;
+		HashLockerClass						hashLocker;
+		HashTrackerClass					hashTracker;
+		SlotLockerClass						slotLocker;
+		CFAbsoluteTime						hashTime = 0;
+		CFAbsoluteTime						slotTime = 0;
+		long								hashSum = 0;
+		long								slotSum = 0;
+		
+		
+		for (auto& anObject : objects)
+		{
+			anObject.x = STATIC_CAST(hashRefs.size(), int);
+			hashRefs.push_back(REINTERPRET_CAST(&anObject, SlotTestClassRef));
+			hashTracker.insert(hashRefs.back());
+			slotRefs.push_back(slotLocker.addBlock(&anObject));
+		}
+		
+		// validate and lock with hashed containers (object addresses are keys)
+		{
+			CFAbsoluteTime const	kStartTime = CFAbsoluteTimeGetCurrent();
+			
+			
+			for (UInt32 i = 0; i < kCallCount; ++i)
+			{
+				SlotTestClassRef const	kRef = hashRefs[(i * 7) % objectCount];
+				
+				
+				if (hashTracker.end() != hashTracker.find(kRef))
+				{
+					AutoLockerClass		ptr(hashLocker, kRef);
+					
+					
+					hashSum += ptr->x;
+				}
+			}
+			hashTime = (CFAbsoluteTimeGetCurrent() - kStartTime);
+		}
+		
+		// validate and lock with slots (references encode slot indices)
+		{
+			CFAbsoluteTime const	kStartTime = CFAbsoluteTimeGetCurrent();
+			
+			
+			for (UInt32 i = 0; i < kCallCount; ++i)
+			{
+				SlotTestClassRef const	kRef = slotRefs[(i * 7) % objectCount];
+				
+				
+				if (slotLocker.isValid(kRef))
+				{
+					AutoLockerClass		ptr(slotLocker, kRef);
+					
+					
+					slotSum += ptr->x;
+				}
+			}
+			slotTime = (CFAbsoluteTimeGetCurrent() - kStartTime);
+		}
+		
+		// report results
+		{
+			double const		kNanosecondsPerCall = (1000000000.0 / kCallCount);
+			std::ostringstream	reportSS;
+			std::string			reportStr;
+			
+			
+			reportSS << "Memory block locker benchmark, " << objectCount << " objects:"
+						<< " hashed " << (hashTime * kNanosecondsPerCall) << " ns/call,"
+						<< " slots " << (slotTime * kNanosecondsPerCall) << " ns/call"
+						<< ((hashSum == slotSum) ? "" : " (MISMATCHED OUTPUT)");
+			reportStr = reportSS.str();
+			Console_WriteLine(reportStr.c_str());
+		}
+	}
+}// RunBenchmarks
+
+
+/*!
+A unit test for this module.  This should always
+be run before a release, after any substantial
+changes are made, or if you suspect bugs!  It
+should also be EXPANDED as new functionality is
+proposed (ideally, a test is written before the
+functionality is added).
+
+(2023.10)
+*/
+inline void
+MemoryBlockSlotLocker_RunTests ()
+{
+	UInt16		totalTests = 0;
+	UInt16		failedTests = 0;
+	
+	
+	++totalTests;
+	if (false == MemoryBlockSlotLocker<MemoryBlockSlotLocker_TestClassRef, MemoryBlockSlotLocker_TestClass>::unitTest())
+	{
+		++failedTests;
+	}
+	
+	Console_WriteUnitTestReport("Memory Block Slot Locker", failedTests, totalTests);
+}// RunTests
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+MemoryBlockSlotLocker	(DisposeProcPtr		inDisposer)
+:
+_slots(),
+_freeIndices(),
+_disposer(inDisposer),
+_requireLocks(true)
+{
+}// MemoryBlockSlotLocker 1-argument constructor
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+structure_type*
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+acquireLock	(structure_reference_type	inReference)
+{
+	Slot*				slotPtr = returnSlot(inReference);
+	structure_type*		result = nullptr;
+	
+	
+	if (nullptr != slotPtr)
+	{
+		result = slotPtr->block;
+		if (_requireLocks)
+		{
+			assert(slotPtr->lockCount < 0xFFFF);
+			++(slotPtr->lockCount);
+			if (debugged)
+			{
+				// log that a lock was acquired, and show where the lock came from
+				this->logLockState("acquired lock", inReference, slotPtr->lockCount);
+			}
+		}
+	}
+	return result;
+}// acquireLock
+
+
+/*!
+Stores the given memory block and returns a reference to it
+that remains valid until removeBlock() is called.  Slots that
+have been freed are reused, but with a new generation (so the
+old references to those slots stay invalid).
+
+(2023.10)
+*/
+template < typename structure_reference_type, typename structure_type, bool debugged >
+structure_reference_type
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+addBlock	(structure_type*	inBlock)
+{
+	UInt32		slotIndex = 0;
+	Slot*		slotPtr = nullptr;
+	
+	
+	if (_freeIndices.empty())
+	{
+		slotIndex = STATIC_CAST(_slots.size(), UInt32);
+		_slots.push_back(Slot{ nullptr, 1/* generation; never 0 */, 0/* lock count */, 0/* retain count */ });
+	}
+	else
+	{
+		slotIndex = _freeIndices.back();
+		_freeIndices.pop_back();
+	}
+	slotPtr = &_slots[slotIndex];
+	slotPtr->block = inBlock;
+	slotPtr->lockCount = 0;
+	slotPtr->retainCount = 0;
+	
+	// the index is stored off by one so that no reference is nullptr
+	return REINTERPRET_CAST((STATIC_CAST(slotPtr->generation, uintptr_t) << 32) | (slotIndex + 1), structure_reference_type);
+}// addBlock
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+void
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+clear ()
+{
+	_freeIndices.clear();
+	for (UInt32 i = 0; i < _slots.size(); ++i)
+	{
+		if (nullptr != _slots[i].block)
+		{
+			_slots[i].block = nullptr;
+			++(_slots[i].generation);
+		}
+		_freeIndices.push_back(i);
+	}
+}// clear
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+bool
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+isLocked	(structure_reference_type	inReference)
+const
+{
+	return (returnLockCount(inReference) > 0);
+}// isLocked
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+bool
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+isValid		(structure_reference_type	inReference)
+const
+{
+	return (nullptr != returnSlot(inReference));
+}// isValid
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+UInt16
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+release		(structure_reference_type	inReference)
+{
+	Slot*		slotPtr = returnSlot(inReference);
+	UInt16		result = 0;
+	
+	
+	if (nullptr != slotPtr)
+	{
+		if (debugged)
+		{
+			if (slotPtr->retainCount <= 0)
+			{
+				this->logLockState("assertion failure for reference", inReference, slotPtr->retainCount);
+			}
+		}
+		assert(slotPtr->retainCount > 0);
+		if (slotPtr->retainCount > 0)
+		{
+			--(slotPtr->retainCount);
+		}
+		result = slotPtr->retainCount;
+	}
+	return result;
+}// release
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+void
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+releaseLock		(structure_reference_type	inReference,
+				 structure_type**			inoutPtrPtr)
+{
+	if (_requireLocks)
+	{
+		Slot*		slotPtr = returnSlot(inReference);
+		
+		
+		// a lock on an invalid reference was never counted
+		if (nullptr != slotPtr)
+		{
+			assert(slotPtr->lockCount > 0);
+			--(slotPtr->lockCount);
+			if (debugged)
+			{
+				// log that a lock was released, and show where the release came from
+				this->logLockState("released lock", inReference, slotPtr->lockCount);
+			}
+			if ((0 == slotPtr->lockCount) && (nullptr != _disposer))
+			{
+				_requireLocks = false;
+				(*_disposer)(slotPtr->block);
+			}
+		}
+		if (inoutPtrPtr != nullptr) *inoutPtrPtr = nullptr;
+	}
+}// releaseLock
+
+
+/*!
+Invalidates the given reference, and every copy of it, by
+freeing its slot.  The memory block that was stored in the
+slot is returned, so that the caller can destroy it (if the
+reference was not valid, the result is nullptr).
+
+(2023.10)
+*/
+template < typename structure_reference_type, typename structure_type, bool debugged >
+structure_type*
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+removeBlock		(structure_reference_type	inReference)
+{
+	Slot*				slotPtr = returnSlot(inReference);
+	structure_type*		result = nullptr;
+	
+	
+	if (nullptr != slotPtr)
+	{
+		result = slotPtr->block;
+		slotPtr->block = nullptr;
+		slotPtr->lockCount = 0;
+		slotPtr->retainCount = 0;
+		++(slotPtr->generation);
+		if (0 == slotPtr->generation)
+		{
+			// zero is never used (see addBlock())
+			slotPtr->generation = 1;
+		}
+		_freeIndices.push_back(STATIC_CAST(slotPtr - _slots.data(), UInt32));
+	}
+	return result;
+}// removeBlock
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+UInt16
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+retain	(structure_reference_type	inReference)
+{
+	Slot*		slotPtr = returnSlot(inReference);
+	UInt16		result = 0;
+	
+	
+	if (nullptr != slotPtr)
+	{
+		assert(slotPtr->retainCount < 0xFFFF);
+		++(slotPtr->retainCount);
+		if (debugged)
+		{
+			// log that a retain was added, and show where the retain came from
+			this->logLockState("retained", inReference, slotPtr->retainCount);
+		}
+		result = slotPtr->retainCount;
+	}
+	return result;
+}// retain
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+structure_type*
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+returnBlock		(structure_reference_type	inReference)
+const
+{
+	Slot const*			slotPtr = returnSlot(inReference);
+	structure_type*		result = nullptr;
+	
+	
+	if (nullptr != slotPtr)
+	{
+		result = slotPtr->block;
+	}
+	return result;
+}// returnBlock
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+UInt16
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+returnLockCount		(structure_reference_type	inReference)
+const
+{
+	Slot const*		slotPtr = returnSlot(inReference);
+	UInt16			result = 0;
+	
+	
+	if (nullptr != slotPtr)
+	{
+		result = slotPtr->lockCount;
+	}
+	return result;
+}// returnLockCount
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+UInt16
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+returnRetainCount	(structure_reference_type	inReference)
+const
+{
+	Slot const*		slotPtr = returnSlot(inReference);
+	UInt16			result = 0;
+	
+	
+	if (nullptr != slotPtr)
+	{
+		result = slotPtr->retainCount;
+	}
+	return result;
+}// returnRetainCount
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+typename MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::Slot*
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+returnSlot	(structure_reference_type	inReference)
+{
+	return const_cast< Slot* >(STATIC_CAST(this, MemoryBlockSlotLocker const*)->returnSlot(inReference));
+}// returnSlot
+
+
+template < typename structure_reference_type, typename structure_type, bool debugged >
+typename MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::Slot const*
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+returnSlot	(structure_reference_type	inReference)
+const
+{
+	uintptr_t const		kValue = REINTERPRET_CAST(inReference, uintptr_t);
+	UInt32 const		kIndexPlusOne = STATIC_CAST(kValue & 0xFFFFFFFF, UInt32);
+	UInt32 const		kGeneration = STATIC_CAST(kValue >> 32, UInt32);
+	Slot const*			result = nullptr;
+	
+	
+	// the index is stored off by one, so this also rejects nullptr
+	if ((kIndexPlusOne > 0) && (kIndexPlusOne <= _slots.size()))
+	{
+		Slot const&		slot = _slots[kIndexPlusOne - 1];
+		
+		
+		if ((kGeneration == slot.generation) && (nullptr != slot.block))
+		{
+			result = &slot;
+		}
+	}
+	return result;
+}// returnSlot const
+
+
+/*!
+Tests an instance of this template class.  Returns true only
+if successful.  Information on failures is printed to the
+console.
+
+(2023.10)
+*/
+template < typename structure_reference_type, typename structure_type, bool debugged >
+Boolean
+MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >::
+unitTest ()
+{
+	typedef LockAcquireRelease< structure_reference_type, structure_type, debugged >	TestAutoLockerClass;
+	typedef MemoryBlockSlotLocker< structure_reference_type, structure_type, debugged >	TestLockerClass;
+	Boolean		result = true;
+	
+	
+	// validity and reuse of slots
+	{
+		TestLockerClass				locker;
+		structure_type				object1;
+		structure_type				object2;
+		structure_reference_type	ref1 = nullptr;
+		structure_reference_type	ref2 = nullptr;
+		structure_reference_type	ref3 = nullptr;
+		
+		
+		result &= Console_Assert("nullptr is invalid", false == locker.isValid(nullptr));
+		result &= Console_Assert("arbitrary value is invalid", false == locker.isValid(REINTERPRET_CAST(0x1234DEAD, structure_reference_type)));
+		ref1 = locker.addBlock(&object1);
+		ref2 = locker.addBlock(&object2);
+		result &= Console_Assert("ref1 is not nullptr", nullptr != ref1);
+		result &= Console_Assert("ref1 is valid", locker.isValid(ref1));
+		result &= Console_Assert("ref2 is valid", locker.isValid(ref2));
+		result &= Console_Assert("ref1 and ref2 differ", ref1 != ref2);
+		result &= Console_Assert("ref1 finds object1", &object1 == locker.returnBlock(ref1));
+		result &= Console_Assert("ref2 finds object2", &object2 == locker.returnBlock(ref2));
+		result &= Console_Assert("removal returns object1", &object1 == locker.removeBlock(ref1));
+		result &= Console_Assert("ref1 is invalid after removal", false == locker.isValid(ref1));
+		result &= Console_Assert("ref1 finds nothing after removal", nullptr == locker.returnBlock(ref1));
+		result &= Console_Assert("second removal returns nothing", nullptr == locker.removeBlock(ref1));
+		result &= Console_Assert("ref2 is still valid", locker.isValid(ref2));
+		ref3 = locker.addBlock(&object2);
+		result &= Console_Assert("reused slot has a new reference", ref1 != ref3);
+		result &= Console_Assert("stale reference does not find new block", false == locker.isValid(ref1));
+		result &= Console_Assert("ref3 is valid", locker.isValid(ref3));
+		locker.clear();
+		result &= Console_Assert("ref2 is invalid after clear", false == locker.isValid(ref2));
+		result &= Console_Assert("ref3 is invalid after clear", false == locker.isValid(ref3));
+	}
+	
+	// basic locking
+	{
+		TestLockerClass				locker;
+		structure_type				object1;
+		structure_type				object2;
+		structure_reference_type	ref1 = locker.addBlock(&object1);
+		structure_reference_type	ref2 = locker.addBlock(&object2);
+		structure_type*				ptr1 = nullptr;
+		structure_type*				ptr2 = nullptr;
+		
+		
+		result &= Console_Assert("initial lock count of zero for ref1", !locker.isLocked(ref1));
+		result &= Console_Assert("initial lock count of zero for ref2", !locker.isLocked(ref2));
+		ptr1 = locker.acquireLock(ref1);
+		result &= Console_Assert("lock returns object1", &object1 == ptr1);
+		result &= Console_Assert("lock count is up to one for ref1", 1 == locker.returnLockCount(ref1));
+		ptr2 = locker.acquireLock(ref2);
+		locker.releaseLock(ref1, &ptr1);
+		result &= Console_Assert("ptr1 is nullified", nullptr == ptr1);
+		result &= Console_Assert("ptr2 is not nullified", nullptr != ptr2);
+		result &= Console_Assert("lock count is down to zero for ref1", 0 == locker.returnLockCount(ref1));
+		ptr1 = locker.acquireLock(ref2);
+		result &= Console_Assert("lock count is up to two for ref2", 2 == locker.returnLockCount(ref2));
+		locker.releaseLock(ref2, &ptr2);
+		locker.releaseLock(ref2, &ptr1);
+		result &= Console_Assert("lock count is down to zero for ref2", 0 == locker.returnLockCount(ref2));
+		UNUSED_RETURN(structure_type*)locker.removeBlock(ref2);
+		ptr2 = locker.acquireLock(ref2);
+		result &= Console_Assert("lock on invalid reference fails", nullptr == ptr2);
+		result &= Console_Assert("lock on invalid reference is not counted", 0 == locker.returnLockCount(ref2));
+		locker.releaseLock(ref2, &ptr2);
+	}
+	
+	// automatic locking and retain counts
+	{
+		TestLockerClass				locker;
+		structure_type				object1;
+		structure_reference_type	ref1 = locker.addBlock(&object1);
+		
+		
+		{
+			TestAutoLockerClass		ptr1(locker, ref1);
+			
+			
+			result &= Console_Assert("automatic lock finds object1", &object1 == &*ptr1);
+			result &= Console_Assert("automatic lock count is one", 1 == locker.returnLockCount(ref1));
+			{
+				TestAutoLockerClass		alsoPtr1(locker, ref1);
+				
+				
+				result &= Console_Assert("automatic lock count is two", 2 == locker.returnLockCount(ref1));
+			}
+			result &= Console_Assert("automatic lock count is back to one", 1 == locker.returnLockCount(ref1));
+		}
+		result &= Console_Assert("automatic lock count is back to zero", 0 == locker.returnLockCount(ref1));
+		result &= Console_Assert("first retain", 1 == locker.retain(ref1));
+		result &= Console_Assert("second retain", 2 == locker.retain(ref1));
+		result &= Console_Assert("retains are separate from locks", 0 == locker.returnLockCount(ref1));
+		result &= Console_Assert("first release", 1 == locker.release(ref1));
+		result &= Console_Assert("second release", 0 == locker.release(ref1));
+		result &= Console_Assert("retain count is zero", 0 == locker.returnRetainCount(ref1));
+	}
+	
+	return result;
+}// unitTest
+
+// BELOW IS REQUIRED NEWLINE TO END FILE
@@ -34,6 +34,7 @@
 
 // standard-C++ includes
 #import <string>
+#import <vector>
 
 // Mac includes
 @import CoreServices;
@@ -41,6 +42,7 @@
 // library includes
 #import <CFRetainRelease.h>
 #import <Console.h>
+#import <UnicodeWidth.h>
 #import <UTF8Decoder.h>
 
 
@@ -190,45 +192,64 @@ details are provided on the number of cells (terminal columns)
 that are likely to be needed and the scaling that will be
 necessary in Core Text to occupy that integral cell count.
 
-This does not only use Core Text; it also adds in heuristics to
-better match intent.  For instance, Unicode specifies (and legacy
-applications expect) that all box-drawing characters in the range
-of 0x2500 to 0x259F are a single column, even though the Mac will
-typically try to make them double-width when rendered by fonts.
-This function will force such corrections and ignore the fonts.
-
-This uses StringUtilities_ForEachComposedCharacterSequenceInRange()
-so it has that function’s documented advantages over an ordinary
-NSString call: typically covering all composed character sequences
-(even invalid ones that have replacement characters).
-
-(2021.04)
+Sequences and cell counts come from the Unicode tables of the
+UnicodeWidth module rather than from fonts, so that terminal
+columns always line up the way that applications expect.  For
+instance, Unicode specifies (and legacy applications expect)
+that all box-drawing characters in the range of 0x2500 to 0x259F
+are a single column, even though the Mac will typically try to
+make them double-width when rendered by fonts; East Asian wide
+characters and emoji use 2 columns; and combining marks, joined
+emoji sequences and flags are kept with their base characters.
+Every sequence is visited, including those with replacement
+characters or unpaired surrogates (which use one column each).
+
+The text is scanned directly as UTF-16 so the only string
+objects created are the substrings that are given to the block.
+
+(2023.10)
 */
 void
 StringUtilities_ForEachComposedCellClusterInRange	(CFStringRef				inStringData,
 													 CFRange					inRange,
 													 StringUtilities_CellBlock	inBlock)
 {
-	// iterate over the composed character sequences and call the
-	// given block on each one
-	StringUtilities_ForEachComposedCharacterSequenceInRange
-	(inStringData, inRange,
-	^(CFStringRef	inSubstring,
-	  CFRange		inSubstringRange,
-	  Boolean&		outStop)
+	if ((nullptr != inStringData) && (inRange.length > 0))
 	{
-		// TEMPORARY; this is a partial port of work done elsewhere
-		// that is excluding attributes used to compute different
-		// values depending on the contents of the string; for now,
-		// to ease porting, these parameters are fixed
-		// (INCOMPLETE)
-		UInt16 const	kCellCount = 1;
-		CGFloat const	kWidthScaleFactor = 1.0;
+		// the scale factor is reserved for fonts whose glyphs do not
+		// match the cell count; no such adjustments are made yet
+		CGFloat const			kWidthScaleFactor = 1.0;
+		UniChar const*			directBuffer = CFStringGetCharactersPtr(inStringData);
+		std::vector< UniChar >	copiedBuffer;
+		UniChar const*			clusterPtr = nullptr;
+		Boolean					stopFlag = false;
 		
 		
-		inBlock(inSubstring, StringUtilities_Cell(kCellCount), inSubstringRange,
-				kWidthScaleFactor, outStop);
-	});
+		if (nullptr != directBuffer)
+		{
+			clusterPtr = directBuffer + inRange.location;
+		}
+		else
+		{
+			copiedBuffer.resize(inRange.length);
+			CFStringGetCharacters(inStringData, inRange, copiedBuffer.data());
+			clusterPtr = copiedBuffer.data();
+		}
+		
+		for (CFIndex i = 0; ((false == stopFlag) && (i < inRange.length)); )
+		{
+			UnicodeWidth_Cluster const	kCluster = UnicodeWidth_ReturnCluster(clusterPtr + i, inRange.length - i);
+			CFRange const				kClusterRange = CFRangeMake(inRange.location + i, kCluster.length);
+			CFRetainRelease				subString(CFStringCreateWithSubstring
+													(kCFAllocatorDefault, inStringData, kClusterRange),
+													CFRetainRelease::kAlreadyRetained);
+			
+			
+			inBlock(subString.returnCFStringRef(), StringUtilities_Cell(kCluster.cellCount), kClusterRange,
+					kWidthScaleFactor, stopFlag);
+			i += kCluster.length;
+		}
+	}
 }// ForEachComposedCellClusterInRange
 
 
@@ -29,6 +29,19 @@
 #include "UTF8Decoder.h"
 #include <UniversalDefines.h>
 
+// standard-C++ includes
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+// compiler includes
+#if defined(__SSE2__)
+#	include <immintrin.h>
+#elif defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
 // Mac includes
 #include <ApplicationServices/ApplicationServices.h>
 #include <CoreServices/CoreServices.h>
@@ -38,8 +51,292 @@
 
 
 
+#pragma mark Constants
+namespace {
+
+UniChar const	kMy_ReplacementCharacter = 0xFFFD;	//!< the UTF-16 form of the sequence given by UTF8Decoder_StateMachine::appendErrorCharacter()
+size_t const	kMy_VectorBlockSize = 16;			//!< number of bytes checked at once by returnVectorValidLength()
+
+/*!
+Bits that classify problems with each pair of adjacent
+bytes, for the vectorized validator; this is the “lookup”
+algorithm from Keiser and Lemire, “Validating UTF-8 In
+Less Than One Instruction Per Byte” (2021).  A pair is an
+error only if all three table lookups (for the high and
+low nibbles of the first byte and the high nibble of the
+second byte) agree on at least one bit.
+*/
+enum : UInt8
+{
+	kMy_ErrorTooShort			= (1 << 0),		//!< 11______ 0_______ or 11______ 11______
+	kMy_ErrorTooLong			= (1 << 1),		//!< 0_______ 10______
+	kMy_ErrorOverLong3			= (1 << 2),		//!< 11100000 100_____
+	kMy_ErrorTooLarge			= (1 << 3),		//!< 11110100 1001____ or 11110100 101_____ or 11110101+ 1_______
+	kMy_ErrorSurrogate			= (1 << 4),		//!< 11101101 101_____
+	kMy_ErrorOverLong2			= (1 << 5),		//!< 1100000_ 10______
+	kMy_ErrorTooLarge1000		= (1 << 6),		//!< 11110101+ 1000____
+	kMy_ErrorOverLong4			= (1 << 6),		//!< 11110000 1000____
+	kMy_ErrorTwoContinuations	= (1 << 7),		//!< 10______ 10______ (an error only where a third or fourth byte is not expected)
+	kMy_ErrorCarry				= (kMy_ErrorTooShort | kMy_ErrorTooLong | kMy_ErrorTwoContinuations),
+};
+
+UInt8 const		kMy_FirstByteHighNibbleErrors[] =
+				{
+					// 0_______ (ASCII)
+					kMy_ErrorTooLong, kMy_ErrorTooLong, kMy_ErrorTooLong, kMy_ErrorTooLong,
+					kMy_ErrorTooLong, kMy_ErrorTooLong, kMy_ErrorTooLong, kMy_ErrorTooLong,
+					// 10______ (continuation)
+					kMy_ErrorTwoContinuations, kMy_ErrorTwoContinuations, kMy_ErrorTwoContinuations, kMy_ErrorTwoContinuations,
+					// 1100____ (first of 2, possibly over-long)
+					kMy_ErrorTooShort | kMy_ErrorOverLong2,
+					// 1101____ (first of 2)
+					kMy_ErrorTooShort,
+					// 1110____ (first of 3)
+					kMy_ErrorTooShort | kMy_ErrorOverLong3 | kMy_ErrorSurrogate,
+					// 1111____ (first of 4)
+					kMy_ErrorTooShort | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000 | kMy_ErrorOverLong4,
+				};
+UInt8 const		kMy_FirstByteLowNibbleErrors[] =
+				{
+					// ____0000
+					kMy_ErrorCarry | kMy_ErrorOverLong3 | kMy_ErrorOverLong2 | kMy_ErrorOverLong4,
+					// ____0001
+					kMy_ErrorCarry | kMy_ErrorOverLong2,
+					// ____001_
+					kMy_ErrorCarry,
+					kMy_ErrorCarry,
+					// ____0100
+					kMy_ErrorCarry | kMy_ErrorTooLarge,
+					// ____0101 through ____1100
+					kMy_ErrorCarry | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000,
+					kMy_ErrorCarry | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000,
+					kMy_ErrorCarry | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000,
+					kMy_ErrorCarry | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000,
+					kMy_ErrorCarry | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000,
+					kMy_ErrorCarry | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000,
+					kMy_ErrorCarry | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000,
+					kMy_ErrorCarry | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000,
+					// ____1101
+					kMy_ErrorCarry | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000 | kMy_ErrorSurrogate,
+					// ____111_
+					kMy_ErrorCarry | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000,
+					kMy_ErrorCarry | kMy_ErrorTooLarge | kMy_ErrorTooLarge1000,
+				};
+UInt8 const		kMy_SecondByteHighNibbleErrors[] =
+				{
+					// 0_______ (ASCII)
+					kMy_ErrorTooShort, kMy_ErrorTooShort, kMy_ErrorTooShort, kMy_ErrorTooShort,
+					kMy_ErrorTooShort, kMy_ErrorTooShort, kMy_ErrorTooShort, kMy_ErrorTooShort,
+					// 1000____
+					kMy_ErrorTooLong | kMy_ErrorOverLong2 | kMy_ErrorTwoContinuations |
+						kMy_ErrorOverLong3 | kMy_ErrorTooLarge1000 | kMy_ErrorOverLong4,
+					// 1001____
+					kMy_ErrorTooLong | kMy_ErrorOverLong2 | kMy_ErrorTwoContinuations |
+						kMy_ErrorOverLong3 | kMy_ErrorTooLarge,
+					// 101_____
+					kMy_ErrorTooLong | kMy_ErrorOverLong2 | kMy_ErrorTwoContinuations |
+						kMy_ErrorSurrogate | kMy_ErrorTooLarge,
+					kMy_ErrorTooLong | kMy_ErrorOverLong2 | kMy_ErrorTwoContinuations |
+						kMy_ErrorSurrogate | kMy_ErrorTooLarge,
+					// 11______ (not a continuation)
+					kMy_ErrorTooShort, kMy_ErrorTooShort, kMy_ErrorTooShort, kMy_ErrorTooShort,
+				};
+UInt8 const		kMy_IncompleteSequenceLimits[] =
+				{
+					// a block is incomplete if its last 3 bytes begin
+					// sequences longer than the bytes that remain
+					0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+					0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+				};
+
+} // anonymous namespace
+
+#pragma mark Internal Method Prototypes
+namespace {
+
+void		appendUTF16								(UnicodeScalarValue, UTF8Decoder_UniCharList&);
+void		appendUTF8								(UnicodeScalarValue, UTF8Decoder_ByteString&);
+UInt32		decodeByte								(UTF8Decoder_StateMachine&, UInt8, UTF8Decoder_UniCharList&);
+UInt32		decodeByteByByte						(UTF8Decoder_StateMachine&, UInt8 const*, size_t, UTF8Decoder_UniCharList&);
+UniChar*	decodeValidBytes						(UInt8 const*, size_t, UniChar*);
+void		fillRandomBytes							(std::minstd_rand&, size_t, UTF8Decoder_ByteString&);
+size_t		returnScalarValidLength					(UInt8 const*, size_t);
+size_t		returnVectorValidLength					(UInt8 const*, size_t);
+Boolean		unitTest_DecodeRun_000					();
+Boolean		unitTest_DecodeRun_001					();
+Boolean		unitTest_ReturnValidPrefixLength_000	();
+
+} // anonymous namespace
+
+
+
 #pragma mark Public Methods
 
+/*!
+Decodes large, generated samples of ASCII, CJK and
+emoji-heavy text, both one byte at a time (the way the
+terminal parser has traditionally fed its decoder, with
+nextState()) and with decodeRun(), and logs the speed of
+each to the console.  Data is given to each decoder in
+4 KB blocks, as it is read from a process.
+
+(2023.10)
+*/
+void
+UTF8Decoder_RunBenchmarks ()
+{
+	size_t const		kCorpusByteCount = (4 * 1024 * 1024);
+	size_t const		kBlockSize = 4096;
+	UInt16 const		kIterationCount = 10;
+	std::minstd_rand	generator(2023/* arbitrary, but fixed */);
+	
+	
+	for (UInt16 corpusIndex = 0; corpusIndex < 3; ++corpusIndex)
+	{
+		char const*				corpusName = "";
+		UTF8Decoder_ByteString	corpus;
+		UTF8Decoder_UniCharList	decodedText;
+		CFAbsoluteTime			perByteTime = 0;
+		CFAbsoluteTime			runTime = 0;
+		size_t					perByteCount = 0;
+		size_t					runCount = 0;
+		
+		
+		corpus.reserve(kCorpusByteCount + 8);
+		decodedText.reserve(kBlockSize + 2);
+		while (corpus.size() < kCorpusByteCount)
+		{
+			// words of a few characters, separated by spaces and newlines
+			for (UInt16 i = STATIC_CAST(2 + (generator() % 8), UInt16); i > 0; --i)
+			{
+				switch (corpusIndex)
+				{
+				case 0:
+					corpusName = "ASCII";
+					corpus.push_back(STATIC_CAST('a' + (generator() % 26), UInt8));
+					break;
+				
+				case 1:
+					// mostly ideographs, with some kana and punctuation
+					corpusName = "CJK";
+					if (0 == (generator() % 4))
+					{
+						appendUTF8(0x3041 + (generator() % 0x56)/* Hiragana */, corpus);
+					}
+					else if (0 == (generator() % 16))
+					{
+						appendUTF8(0x3001/* ideographic comma */, corpus);
+					}
+					else
+					{
+						appendUTF8(0x4E00 + (generator() % 0x5200)/* CJK unified ideographs */, corpus);
+					}
+					break;
+				
+				case 2:
+				default:
+					// emoji, some with a variation selector or joined
+					corpusName = "emoji";
+					appendUTF8(0x1F300 + (generator() % 0x350), corpus);
+					if (0 == (generator() % 8))
+					{
+						appendUTF8(0xFE0F/* variation selector 16 */, corpus);
+					}
+					else if (0 == (generator() % 8))
+					{
+						appendUTF8(0x200D/* zero-width joiner */, corpus);
+					}
+					break;
+				}
+			}
+			corpus.push_back((0 == (generator() % 10)) ? '\n' : ' ');
+		}
+		
+		// decode one byte at a time
+		{
+			CFAbsoluteTime const	kStartTime = CFAbsoluteTimeGetCurrent();
+			
+			
+			for (UInt16 i = 0; i < kIterationCount; ++i)
+			{
+				UTF8Decoder_StateMachine	decoder;
+				
+				
+				for (size_t offset = 0; offset < corpus.size(); offset += kBlockSize)
+				{
+					decodedText.clear();
+					UNUSED_RETURN(UInt32)decodeByteByByte(decoder, corpus.data() + offset,
+															std::min(kBlockSize, corpus.size() - offset), decodedText);
+					perByteCount += decodedText.size();
+				}
+			}
+			perByteTime = (CFAbsoluteTimeGetCurrent() - kStartTime);
+		}
+		
+		// decode entire blocks
+		{
+			CFAbsoluteTime const	kStartTime = CFAbsoluteTimeGetCurrent();
+			
+			
+			for (UInt16 i = 0; i < kIterationCount; ++i)
+			{
+				UTF8Decoder_StateMachine	decoder;
+				
+				
+				for (size_t offset = 0; offset < corpus.size(); offset += kBlockSize)
+				{
+					decodedText.clear();
+					UNUSED_RETURN(UInt32)decoder.decodeRun(corpus.data() + offset,
+															std::min(kBlockSize, corpus.size() - offset), decodedText);
+					runCount += decodedText.size();
+				}
+			}
+			runTime = (CFAbsoluteTimeGetCurrent() - kStartTime);
+		}
+		
+		// report results
+		{
+			double const		kMegabytes = ((STATIC_CAST(corpus.size(), double) * kIterationCount) / (1024.0 * 1024.0));
+			std::ostringstream	reportSS;
+			std::string			reportStr;
+			
+			
+			reportSS << "UTF-8 decoder benchmark, " << corpusName << " (" << corpus.size() << " bytes):"
+						<< " per-byte " << ((perByteTime > 0) ? (kMegabytes / perByteTime) : 0) << " MB/s,"
+						<< " run " << ((runTime > 0) ? (kMegabytes / runTime) : 0) << " MB/s"
+						<< ((perByteCount == runCount) ? "" : " (MISMATCHED OUTPUT)");
+			reportStr = reportSS.str();
+			Console_WriteLine(reportStr.c_str());
+		}
+	}
+}// RunBenchmarks
+
+
+/*!
+A unit test for this module.  This should always
+be run before a release, after any substantial
+changes are made, or if you suspect bugs!  It
+should also be EXPANDED as new functionality is
+proposed (ideally, a test is written before the
+functionality is added).
+
+(2023.10)
+*/
+void
+UTF8Decoder_RunTests ()
+{
+	UInt16		totalTests = 0;
+	UInt16		failedTests = 0;
+	
+	
+	++totalTests; if (false == unitTest_DecodeRun_000()) ++failedTests;
+	++totalTests; if (false == unitTest_DecodeRun_001()) ++failedTests;
+	++totalTests; if (false == unitTest_ReturnValidPrefixLength_000()) ++failedTests;
+	
+	Console_WriteUnitTestReport("UTF-8 Decoder", failedTests, totalTests);
+}// RunTests
+
+
 /*!
 Constructor.
 
@@ -55,6 +352,82 @@ currentState(kStateInitial)
 }// UTF8Decoder_StateMachine default constructor
 
 
+/*!
+Decodes an entire buffer of bytes, appending UTF-16 values
+to the given list.  Errors are reported exactly as they
+would be by calling nextState() for each byte, and each one
+appends the replacement character that is otherwise given
+by appendErrorCharacter(); the return value is the number
+of errors.
+
+This continues any sequence that was incomplete at the end
+of the previous buffer, and a sequence that is incomplete
+at the end of this buffer is kept in "multiByteAccumulator"
+so that the next call (or nextState()) can finish it.
+
+Runs of valid text are found by returnValidPrefixLength()
+and decoded without checking each byte; only the bytes near
+an error or the end of the buffer go through the usual state
+machine.
+
+(2023.10)
+*/
+UInt32
+UTF8Decoder_StateMachine::
+decodeRun	(UInt8 const*				inBytes,
+			 size_t						inByteCount,
+			 UTF8Decoder_UniCharList&	outText)
+{
+	UInt8 const* const	kPastEnd = (inBytes + inByteCount);
+	UInt8 const*		bytePtr = inBytes;
+	UInt32				result = 0;
+	
+	
+	// a completed sequence is never carried over
+	unless (this->incompleteSequence())
+	{
+		this->reset();
+	}
+	
+	while (bytePtr != kPastEnd)
+	{
+		UInt8 const*	slowPathEnd = bytePtr;
+		
+		
+		unless (this->incompleteSequence())
+		{
+			size_t const	kValidLength = returnValidPrefixLength(bytePtr, STATIC_CAST(kPastEnd - bytePtr, size_t));
+			
+			
+			if (kValidLength > 0)
+			{
+				size_t const	kOldSize = outText.size();
+				
+				
+				// no valid byte produces more than one UTF-16 value
+				outText.resize(kOldSize + kValidLength);
+				outText.resize(STATIC_CAST(decodeValidBytes(bytePtr, kValidLength, outText.data() + kOldSize) - outText.data(), size_t));
+				bytePtr += kValidLength;
+			}
+			
+			// anything that follows is an error or an incomplete sequence
+			// at the end of the buffer; at least a block of bytes is given
+			// to the state machine before looking for valid text again, so
+			// that mostly-invalid data cannot be scanned repeatedly
+			slowPathEnd = std::min(bytePtr + kMy_VectorBlockSize, kPastEnd);
+		}
+		
+		while ((bytePtr != kPastEnd) && ((bytePtr < slowPathEnd) || this->incompleteSequence()))
+		{
+			result += decodeByte(*this, *bytePtr, outText);
+			++bytePtr;
+		}
+	}
+	
+	return result;
+}// UTF8Decoder_StateMachine::decodeRun
+
+
 /*!
 Returns true only if the current sequence of bytes is
 incomplete.
@@ -103,26 +476,6 @@ isOverLong ()
 			// always means the sequence is over-long
 			result = true;
 		}
-		else if (kSequenceLength > 5)
-		{
-			if ((0xFC == kBuffer[kStartIndex]) &&
-				(byteSequenceTotalValue(kBuffer, kStartIndex, 6) <= 0x03FFFFFF))
-			{
-				// a sequence that starts with 0xFC cannot decode to a value
-				// in the 5-byte range (0x03FFFFFF) unless it is over-long
-				result = true;
-			}
-		}
-		else if (kSequenceLength > 4)
-		{
-			if ((0xF8 == kBuffer[kStartIndex]) &&
-				(byteSequenceTotalValue(kBuffer, kStartIndex, 5) <= 0x001FFFFF))
-			{
-				// a sequence that starts with 0xF8 cannot decode to a value
-				// in the 4-byte range (0x001FFFFF) unless it is over-long
-				result = true;
-			}
-		}
 		else if (kSequenceLength > 3)
 		{
 			if ((0xF0 == kBuffer[kStartIndex]) &&
@@ -192,7 +545,8 @@ nextState	(UInt8		inNextByte,
 	}
 	else if (isIllegalByte(inNextByte))
 	{
-		// a byte value that is never allowed in a valid UTF-8 sequence;
+		// a byte value that is never allowed in a valid UTF-8 sequence
+		// (including the start of an obsolete 5-byte or 6-byte form);
 		// note that this must be checked relatively early because other
 		// checks that follow examine just a few bits that could well be
 		// set for byte values in the illegal range
@@ -238,28 +592,6 @@ nextState	(UInt8		inNextByte,
 		this->multiByteAccumulator.push_back(inNextByte);
 		this->currentState = kStateUTF8ExpectingFour;
 	}
-	else if (isFirstOfFive(inNextByte))
-	{
-		// first byte in a sequence of 5
-		if (this->incompleteSequence())
-		{
-			++outErrorCount;
-			this->reset();
-		}
-		this->multiByteAccumulator.push_back(inNextByte);
-		this->currentState = kStateUTF8ExpectingFive;
-	}
-	else if (isFirstOfSix(inNextByte))
-	{
-		// first byte in a sequence of 6
-		if (this->incompleteSequence())
-		{
-			++outErrorCount;
-			this->reset();
-		}
-		this->multiByteAccumulator.push_back(inNextByte);
-		this->currentState = kStateUTF8ExpectingSix;
-	}
 	else if (isContinuationByte(inNextByte))
 	{
 		// continuation byte, possibly the final byte; the next state
@@ -285,14 +617,6 @@ nextState	(UInt8		inNextByte,
 			endSize = 4;
 			break;
 		
-		case kStateUTF8ExpectingFive:
-			endSize = 5;
-			break;
-		
-		case kStateUTF8ExpectingSix:
-			endSize = 6;
-			break;
-		
 		default:
 			// ???
 			isIllegal = true;
@@ -323,7 +647,7 @@ nextState	(UInt8		inNextByte,
 																			this->multiByteAccumulator.size());
 			
 			
-			if ((kCodePoint >= 0x10FFFF)/* high range of illegal UTF-8 values */ ||
+			if ((kCodePoint > 0x10FFFF)/* high range of illegal UTF-8 values */ ||
 				((kCodePoint >= 0xD800) && (kCodePoint <= 0xDFFF))/* surrogate halves used by UTF-16 */)
 			{
 				// a technically valid sequence of UTF-8 bytes, but it resolves to an illegal code point
@@ -353,4 +677,760 @@ nextState	(UInt8		inNextByte,
 	//Console_WriteValue("                      UTF-8 next state", this->currentState);
 }// UTF8Decoder_StateMachine::nextState
 
+
+/*!
+Returns the number of bytes at the start of the given buffer
+that form complete and valid UTF-8 sequences; the byte that
+follows (if any) is either invalid or begins a sequence that
+the buffer does not finish.  The same sequences are accepted
+as nextState() would accept, so this is a quick way to find
+out how much of a buffer can be decoded without errors.
+
+Where available, 16 bytes at a time are checked with vector
+instructions (see returnVectorValidLength()).
+
+(2023.10)
+*/
+size_t
+UTF8Decoder_StateMachine::
+returnValidPrefixLength		(UInt8 const*	inBytes,
+							 size_t			inByteCount)
+{
+	size_t		result = returnVectorValidLength(inBytes, inByteCount);
+	
+	
+	// the vector scan stops on a block boundary that may split a
+	// sequence (and an error in the next block may really be in
+	// that sequence), so back up to the start of any sequence
+	// that does not end within the checked blocks
+	for (size_t i = 1; ((i <= 3) && (i <= result)); ++i)
+	{
+		UInt8 const		kByte = inBytes[result - i];
+		
+		
+		if (isStartingByte(kByte))
+		{
+			size_t const	kSequenceLength = (isSingleByteGlyph(kByte)
+												? 1
+												: (isFirstOfTwo(kByte)
+													? 2
+													: (isFirstOfThree(kByte) ? 3 : 4)));
+			
+			
+			if (kSequenceLength > i)
+			{
+				result -= i;
+			}
+			break;
+		}
+	}
+	
+	// find exactly where the valid data ends
+	result += returnScalarValidLength(inBytes + result, inByteCount - result);
+	
+	return result;
+}// UTF8Decoder_StateMachine::returnValidPrefixLength
+
+
+#pragma mark Internal Methods
+namespace {
+
+/*!
+Appends the given code point in UTF-16 form: one value, or
+a surrogate pair for code points beyond the Basic
+Multilingual Plane.
+
+(2023.10)
+*/
+void
+appendUTF16		(UnicodeScalarValue			inCodePoint,
+				 UTF8Decoder_UniCharList&	inoutText)
+{
+	if (inCodePoint < 0x10000)
+	{
+		inoutText.push_back(STATIC_CAST(inCodePoint, UniChar));
+	}
+	else
+	{
+		inoutText.push_back(STATIC_CAST(0xD800 + ((inCodePoint - 0x10000) >> 10), UniChar));
+		inoutText.push_back(STATIC_CAST(0xDC00 + ((inCodePoint - 0x10000) & 0x03FF), UniChar));
+	}
+}// appendUTF16
+
+
+/*!
+Appends the given code point in UTF-8 form.  This is only
+used to create test data.
+
+(2023.10)
+*/
+void
+appendUTF8		(UnicodeScalarValue			inCodePoint,
+				 UTF8Decoder_ByteString&	inoutBytes)
+{
+	if (inCodePoint < 0x80)
+	{
+		inoutBytes.push_back(STATIC_CAST(inCodePoint, UInt8));
+	}
+	else if (inCodePoint < 0x800)
+	{
+		inoutBytes.push_back(STATIC_CAST(0xC0 | (inCodePoint >> 6), UInt8));
+		inoutBytes.push_back(STATIC_CAST(0x80 | (inCodePoint & 0x3F), UInt8));
+	}
+	else if (inCodePoint < 0x10000)
+	{
+		inoutBytes.push_back(STATIC_CAST(0xE0 | (inCodePoint >> 12), UInt8));
+		inoutBytes.push_back(STATIC_CAST(0x80 | ((inCodePoint >> 6) & 0x3F), UInt8));
+		inoutBytes.push_back(STATIC_CAST(0x80 | (inCodePoint & 0x3F), UInt8));
+	}
+	else
+	{
+		inoutBytes.push_back(STATIC_CAST(0xF0 | (inCodePoint >> 18), UInt8));
+		inoutBytes.push_back(STATIC_CAST(0x80 | ((inCodePoint >> 12) & 0x3F), UInt8));
+		inoutBytes.push_back(STATIC_CAST(0x80 | ((inCodePoint >> 6) & 0x3F), UInt8));
+		inoutBytes.push_back(STATIC_CAST(0x80 | (inCodePoint & 0x3F), UInt8));
+	}
+}// appendUTF8
+
+
+/*!
+Gives one byte to the state machine, appending a replacement
+character for each error and the code point of any sequence
+that the byte completes.  Returns the number of errors.
+
+(2023.10)
+*/
+UInt32
+decodeByte	(UTF8Decoder_StateMachine&	inoutDecoder,
+			 UInt8						inByte,
+			 UTF8Decoder_UniCharList&	inoutText)
+{
+	UInt32		result = 0;
+	
+	
+	inoutDecoder.nextState(inByte, result);
+	for (UInt32 i = 0; i < result; ++i)
+	{
+		inoutText.push_back(kMy_ReplacementCharacter);
+	}
+	
+	if (UTF8Decoder_StateMachine::kStateUTF8ValidSequence == inoutDecoder.returnState())
+	{
+		appendUTF16(UTF8Decoder_StateMachine::byteSequenceTotalValue(inoutDecoder.multiByteAccumulator, 0/* offset */,
+																		inoutDecoder.multiByteAccumulator.size()),
+					inoutText);
+		inoutDecoder.reset();
+	}
+	
+	return result;
+}// decodeByte
+
+
+/*!
+Decodes the given bytes by calling decodeByte() for each
+one; this is the reference that decodeRun() must agree with.
+Returns the number of errors.
+
+(2023.10)
+*/
+UInt32
+decodeByteByByte	(UTF8Decoder_StateMachine&	inoutDecoder,
+					 UInt8 const*				inBytes,
+					 size_t						inByteCount,
+					 UTF8Decoder_UniCharList&	inoutText)
+{
+	UInt32		result = 0;
+	
+	
+	for (size_t i = 0; i < inByteCount; ++i)
+	{
+		result += decodeByte(inoutDecoder, inBytes[i], inoutText);
+	}
+	
+	return result;
+}// decodeByteByByte
+
+
+/*!
+Decodes bytes that are known to form complete and valid
+sequences (see UTF8Decoder_StateMachine::returnValidPrefixLength())
+into UTF-16, returning a pointer just past the last value
+written.  The output must have room for as many values as
+there are bytes.
+
+Where available, ASCII is converted 16 bytes at a time.
+
+(2023.10)
+*/
+UniChar*
+decodeValidBytes	(UInt8 const*	inBytes,
+					 size_t			inByteCount,
+					 UniChar*		outText)
+{
+	UInt8 const* const	kPastEnd = (inBytes + inByteCount);
+	UInt8 const*		bytePtr = inBytes;
+	UniChar*			result = outText;
+	
+	
+	while (bytePtr != kPastEnd)
+	{
+		UInt8 const		kLeadByte = *bytePtr;
+		
+		
+		if (kLeadByte < 0x80)
+		{
+			size_t		asciiCount = 1;
+			
+			
+			*result = kLeadByte;
+			
+			// a whole block is always widened, even if only part of it
+			// is ASCII; this is safe because no byte decodes to more
+			// than one value, so the output has room for at least as
+			// many values as there are bytes left
+#if defined(__SSE2__)
+			if ((kPastEnd - bytePtr) >= STATIC_CAST(kMy_VectorBlockSize, ptrdiff_t))
+			{
+				__m128i const	kBlock = _mm_loadu_si128(REINTERPRET_CAST(bytePtr, __m128i const*));
+				UInt32 const	kNonASCIIMask = STATIC_CAST(_mm_movemask_epi8(kBlock), UInt32);
+				
+				
+				_mm_storeu_si128(REINTERPRET_CAST(result, __m128i*), _mm_unpacklo_epi8(kBlock, _mm_setzero_si128()));
+				_mm_storeu_si128(REINTERPRET_CAST(result + 8, __m128i*), _mm_unpackhi_epi8(kBlock, _mm_setzero_si128()));
+				asciiCount = ((0 == kNonASCIIMask) ? kMy_VectorBlockSize : __builtin_ctz(kNonASCIIMask));
+			}
+#elif defined(__ARM_NEON)
+			if ((kPastEnd - bytePtr) >= STATIC_CAST(kMy_VectorBlockSize, ptrdiff_t))
+			{
+				uint8x16_t const	kBlock = vld1q_u8(bytePtr);
+				
+				
+				vst1q_u16(result, vmovl_u8(vget_low_u8(kBlock)));
+				vst1q_u16(result + 8, vmovl_high_u8(kBlock));
+				
+				// NEON has no direct equivalent to "movemask" so a block
+				// that is not entirely ASCII only advances by one byte
+				if (vmaxvq_u8(kBlock) < 0x80)
+				{
+					asciiCount = kMy_VectorBlockSize;
+				}
+			}
+#endif
+			bytePtr += asciiCount;
+			result += asciiCount;
+		}
+		else if (kLeadByte < 0xE0)
+		{
+			*result = STATIC_CAST(((kLeadByte & 0x1F) << 6) | (bytePtr[1] & 0x3F), UniChar);
+			++result;
+			bytePtr += 2;
+		}
+		else if (kLeadByte < 0xF0)
+		{
+			*result = STATIC_CAST(((kLeadByte & 0x0F) << 12) | ((bytePtr[1] & 0x3F) << 6) | (bytePtr[2] & 0x3F), UniChar);
+			++result;
+			bytePtr += 3;
+		}
+		else
+		{
+			UnicodeScalarValue const	kOffsetCodePoint = ((((kLeadByte & 0x07) << 18) | ((bytePtr[1] & 0x3F) << 12) |
+																((bytePtr[2] & 0x3F) << 6) | (bytePtr[3] & 0x3F)) - 0x10000);
+			
+			
+			// beyond the Basic Multilingual Plane, a surrogate pair is required
+			result[0] = STATIC_CAST(0xD800 + (kOffsetCodePoint >> 10), UniChar);
+			result[1] = STATIC_CAST(0xDC00 + (kOffsetCodePoint & 0x03FF), UniChar);
+			result += 2;
+			bytePtr += 4;
+		}
+	}
+	
+	return result;
+}// decodeValidBytes
+
+
+/*!
+Appends the given number of bytes to the string, in a way
+that exercises every interesting case for a decoder: short
+runs of valid text of every sequence length (including the
+highest and lowest values of each), boundary errors such as
+over-long forms and surrogates, obsolete 5-byte and 6-byte
+forms, stray continuation bytes, truncated sequences and
+completely random bytes.  This is only used by tests.
+
+(2023.10)
+*/
+void
+fillRandomBytes		(std::minstd_rand&			inoutGenerator,
+					 size_t						inByteCount,
+					 UTF8Decoder_ByteString&	inoutBytes)
+{
+	static UInt8 const				kTroubleBytes[] = { 0x80, 0xBF, 0xC0, 0xC1, 0xC2, 0xDF, 0xE0, 0xED, 0xEF,
+														0xF0, 0xF4, 0xF5, 0xF7, 0xF8, 0xFC, 0xFE, 0xFF };
+	static UnicodeScalarValue const	kEdgeCodePoints[] = { 0x00, 0x1B, 0x7F, 0x80, 0x9F, 0x7FF, 0x800, 0xD7FF,
+															0xE000, 0xFFFD, 0xFFFF, 0x10000, 0x10FFFF };
+	size_t const					kPastEnd = (inoutBytes.size() + inByteCount);
+	
+	
+	while (inoutBytes.size() < kPastEnd)
+	{
+		switch (inoutGenerator() % 8)
+		{
+		case 0:
+			// a random byte
+			inoutBytes.push_back(STATIC_CAST(inoutGenerator(), UInt8));
+			break;
+		
+		case 1:
+			inoutBytes.push_back(kTroubleBytes[inoutGenerator() % (sizeof(kTroubleBytes) / sizeof(UInt8))]);
+			break;
+		
+		case 2:
+			appendUTF8(kEdgeCodePoints[inoutGenerator() % (sizeof(kEdgeCodePoints) / sizeof(UnicodeScalarValue))], inoutBytes);
+			break;
+		
+		case 3:
+			{
+				// a valid sequence with its last byte missing
+				UTF8Decoder_ByteString		sequence;
+				
+				
+				appendUTF8(0x80 + (inoutGenerator() % 0x10FF80), sequence);
+				if (sequence.size() > 1)
+				{
+					inoutBytes.append(sequence, 0, sequence.size() - 1);
+				}
+			}
+			break;
+		
+		case 4:
+			// a run of ASCII, long enough to span vector blocks
+			for (UInt16 i = STATIC_CAST(inoutGenerator() % 40, UInt16); i > 0; --i)
+			{
+				inoutBytes.push_back(STATIC_CAST(0x20 + (inoutGenerator() % 0x5F), UInt8));
+			}
+			break;
+		
+		default:
+			// usually valid text of every length (this may produce
+			// encoded surrogates, which are also an error)
+			for (UInt16 i = STATIC_CAST(inoutGenerator() % 12, UInt16); i > 0; --i)
+			{
+				static UnicodeScalarValue const		kRangeSizes[] = { 0x80, 0x800, 0x10000, 0x110000 };
+				
+				
+				appendUTF8(inoutGenerator() % kRangeSizes[inoutGenerator() % 4], inoutBytes);
+			}
+			break;
+		}
+	}
+	inoutBytes.resize(kPastEnd);
+}// fillRandomBytes
+
+
+/*!
+Returns the number of bytes at the start of the given buffer
+that form complete and valid UTF-8 sequences, checking one
+sequence at a time.
+
+(2023.10)
+*/
+size_t
+returnScalarValidLength		(UInt8 const*	inBytes,
+							 size_t			inByteCount)
+{
+	size_t		result = 0;
+	
+	
+	while (result < inByteCount)
+	{
+		UInt8 const		kLeadByte = inBytes[result];
+		size_t			sequenceLength = 0;
+		UInt8			secondByteMinimum = 0x80; // restricted to exclude over-long forms
+		UInt8			secondByteMaximum = 0xBF; // restricted to exclude surrogates and values beyond 0x10FFFF
+		
+		
+		if (kLeadByte < 0x80)
+		{
+			++result;
+			continue;
+		}
+		
+		if ((kLeadByte >= 0xC2) && (kLeadByte <= 0xDF))
+		{
+			sequenceLength = 2;
+		}
+		else if ((kLeadByte >= 0xE0) && (kLeadByte <= 0xEF))
+		{
+			sequenceLength = 3;
+			if (0xE0 == kLeadByte)
+			{
+				secondByteMinimum = 0xA0;
+			}
+			else if (0xED == kLeadByte)
+			{
+				secondByteMaximum = 0x9F;
+			}
+		}
+		else if ((kLeadByte >= 0xF0) && (kLeadByte <= 0xF4))
+		{
+			sequenceLength = 4;
+			if (0xF0 == kLeadByte)
+			{
+				secondByteMinimum = 0x90;
+			}
+			else if (0xF4 == kLeadByte)
+			{
+				secondByteMaximum = 0x8F;
+			}
+		}
+		else
+		{
+			// continuation byte, over-long 2-byte form, or a value
+			// that is never allowed
+			break;
+		}
+		
+		if ((inByteCount - result) < sequenceLength)
+		{
+			// incomplete
+			break;
+		}
+		
+		if ((inBytes[result + 1] < secondByteMinimum) || (inBytes[result + 1] > secondByteMaximum) ||
+			((sequenceLength > 2) && (false == UTF8Decoder_StateMachine::isContinuationByte(inBytes[result + 2]))) ||
+			((sequenceLength > 3) && (false == UTF8Decoder_StateMachine::isContinuationByte(inBytes[result + 3]))))
+		{
+			break;
+		}
+		
+		result += sequenceLength;
+	}
+	
+	return result;
+}// returnScalarValidLength
+
+
+/*!
+Returns the number of bytes at the start of the given buffer
+that are in whole 16-byte blocks with no UTF-8 errors, using
+vector instructions (zero if they are not available).  This
+always stops at the block where an error is first noticed,
+but an error may be noticed one block late (for instance, if
+a block ends in the middle of an invalid sequence); and, the
+last block that is accepted may end in the middle of a
+sequence.  See UTF8Decoder_StateMachine::returnValidPrefixLength().
+
+Each block is checked against the one before it: all pairs
+of adjacent bytes are classified by table lookups (see
+"kMy_FirstByteHighNibbleErrors", etc.), and bytes that are
+2 or 3 positions after the start of a 3-byte or 4-byte
+sequence must be continuation bytes.  A block that is only
+ASCII can only be an error if the previous block ended in
+an incomplete sequence.
+
+(2023.10)
+*/
+size_t
+#if defined(__SSSE3__) || defined(__ARM_NEON)
+returnVectorValidLength		(UInt8 const*	inBytes,
+							 size_t			inByteCount)
+#else
+returnVectorValidLength		(UInt8 const*	UNUSED_ARGUMENT(inBytes),
+							 size_t			UNUSED_ARGUMENT(inByteCount))
+#endif
+{
+	size_t		result = 0;
+	
+	
+#if defined(__SSSE3__)
+	{
+		__m128i const	kFirstByteHighTable = _mm_loadu_si128(REINTERPRET_CAST(kMy_FirstByteHighNibbleErrors, __m128i const*));
+		__m128i const	kFirstByteLowTable = _mm_loadu_si128(REINTERPRET_CAST(kMy_FirstByteLowNibbleErrors, __m128i const*));
+		__m128i const	kSecondByteHighTable = _mm_loadu_si128(REINTERPRET_CAST(kMy_SecondByteHighNibbleErrors, __m128i const*));
+		__m128i const	kIncompleteLimits = _mm_loadu_si128(REINTERPRET_CAST(kMy_IncompleteSequenceLimits, __m128i const*));
+		__m128i const	kLowNibbleMask = _mm_set1_epi8(0x0F);
+		__m128i			previousBlock = _mm_setzero_si128();
+		__m128i			previousIncomplete = _mm_setzero_si128();
+		
+		
+		while ((inByteCount - result) >= kMy_VectorBlockSize)
+		{
+			__m128i const	kBlock = _mm_loadu_si128(REINTERPRET_CAST(inBytes + result, __m128i const*));
+			__m128i			errors = previousIncomplete;
+			
+			
+			if (0 != _mm_movemask_epi8(kBlock))
+			{
+				__m128i const	kPrevious1 = _mm_alignr_epi8(kBlock, previousBlock, 15);
+				__m128i const	kSpecialCases = _mm_and_si128(_mm_and_si128(_mm_shuffle_epi8(kFirstByteHighTable,
+																								_mm_and_si128(_mm_srli_epi16(kPrevious1, 4), kLowNibbleMask)),
+																				_mm_shuffle_epi8(kFirstByteLowTable,
+																								_mm_and_si128(kPrevious1, kLowNibbleMask))),
+																_mm_shuffle_epi8(kSecondByteHighTable,
+																				_mm_and_si128(_mm_srli_epi16(kBlock, 4), kLowNibbleMask)));
+				__m128i const	kIsThirdByte = _mm_subs_epu8(_mm_alignr_epi8(kBlock, previousBlock, 14), _mm_set1_epi8(0xE0 - 0x80));
+				__m128i const	kIsFourthByte = _mm_subs_epu8(_mm_alignr_epi8(kBlock, previousBlock, 13), _mm_set1_epi8(0xF0 - 0x80));
+				__m128i const	kMustContinue = _mm_and_si128(_mm_or_si128(kIsThirdByte, kIsFourthByte), _mm_set1_epi8(STATIC_CAST(0x80, char)));
+				
+				
+				// a continuation byte that is expected is not an error, and
+				// one that is missing is an error (the tables cannot tell)
+				errors = _mm_xor_si128(kMustContinue, kSpecialCases);
+			}
+			
+			if (0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi8(errors, _mm_setzero_si128())))
+			{
+				break;
+			}
+			
+			previousIncomplete = _mm_subs_epu8(kBlock, kIncompleteLimits);
+			previousBlock = kBlock;
+			result += kMy_VectorBlockSize;
+		}
+	}
+#elif defined(__ARM_NEON)
+	{
+		uint8x16_t const	kFirstByteHighTable = vld1q_u8(kMy_FirstByteHighNibbleErrors);
+		uint8x16_t const	kFirstByteLowTable = vld1q_u8(kMy_FirstByteLowNibbleErrors);
+		uint8x16_t const	kSecondByteHighTable = vld1q_u8(kMy_SecondByteHighNibbleErrors);
+		uint8x16_t const	kIncompleteLimits = vld1q_u8(kMy_IncompleteSequenceLimits);
+		uint8x16_t const	kLowNibbleMask = vdupq_n_u8(0x0F);
+		uint8x16_t			previousBlock = vdupq_n_u8(0);
+		uint8x16_t			previousIncomplete = vdupq_n_u8(0);
+		
+		
+		while ((inByteCount - result) >= kMy_VectorBlockSize)
+		{
+			uint8x16_t const	kBlock = vld1q_u8(inBytes + result);
+			uint8x16_t			errors = previousIncomplete;
+			
+			
+			if (vmaxvq_u8(kBlock) >= 0x80)
+			{
+				uint8x16_t const	kPrevious1 = vextq_u8(previousBlock, kBlock, 15);
+				uint8x16_t const	kSpecialCases = vandq_u8(vandq_u8(vqtbl1q_u8(kFirstByteHighTable, vshrq_n_u8(kPrevious1, 4)),
+																	vqtbl1q_u8(kFirstByteLowTable, vandq_u8(kPrevious1, kLowNibbleMask))),
+															vqtbl1q_u8(kSecondByteHighTable, vshrq_n_u8(kBlock, 4)));
+				uint8x16_t const	kIsThirdByte = vqsubq_u8(vextq_u8(previousBlock, kBlock, 14), vdupq_n_u8(0xE0 - 0x80));
+				uint8x16_t const	kIsFourthByte = vqsubq_u8(vextq_u8(previousBlock, kBlock, 13), vdupq_n_u8(0xF0 - 0x80));
+				uint8x16_t const	kMustContinue = vandq_u8(vorrq_u8(kIsThirdByte, kIsFourthByte), vdupq_n_u8(0x80));
+				
+				
+				// a continuation byte that is expected is not an error, and
+				// one that is missing is an error (the tables cannot tell)
+				errors = veorq_u8(kMustContinue, kSpecialCases);
+			}
+			
+			if (0 != vmaxvq_u8(errors))
+			{
+				break;
+			}
+			
+			previousIncomplete = vqsubq_u8(kBlock, kIncompleteLimits);
+			previousBlock = kBlock;
+			result += kMy_VectorBlockSize;
+		}
+	}
+#endif
+	
+	return result;
+}// returnVectorValidLength
+
+
+/*!
+Tests decodeRun() with specific sequences whose decoded
+values and error counts are known.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_DecodeRun_000 ()
+{
+	struct My_TestCase
+	{
+		char const*		description;
+		char const*		bytes;
+		size_t			errorCount;
+		UniChar			text[8];
+	};
+	My_TestCase const	kTestCases[] =
+						{
+							{ "ASCII", "Ab~", 0, { 'A', 'b', '~' } },
+							{ "2-byte", "\xC3\xA9", 0, { 0x00E9 } },
+							{ "3-byte", "\xE6\x97\xA5\xE6\x9C\xAC", 0, { 0x65E5, 0x672C } },
+							{ "4-byte", "\xF0\x9F\x98\x80", 0, { 0xD83D, 0xDE00 } },
+							{ "highest code point", "\xF4\x8F\xBF\xBF", 0, { 0xDBFF, 0xDFFF } },
+							{ "over-long 2-byte", "\xC0\x80" "A", 1, { 0xFFFD, 'A' } },
+							{ "over-long 3-byte", "\xE0\x9F\xBF" "A", 1, { 0xFFFD, 'A' } },
+							{ "over-long 4-byte", "\xF0\x8F\xBF\xBF", 1, { 0xFFFD } },
+							{ "surrogate", "\xED\xA0\x80", 1, { 0xFFFD } },
+							{ "beyond 0x10FFFF", "\xF4\x90\x80\x80", 1, { 0xFFFD } },
+							{ "5-byte form", "\xF8\x88\x80\x80\x80", 5, { 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD } },
+							{ "6-byte form", "\xFC\x84\x80\x80\x80\x80" "A", 6, { 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 0xFFFD, 'A' } },
+							{ "stray continuation", "A\x80" "B", 1, { 'A', 0xFFFD, 'B' } },
+							{ "truncated", "\xE6\x97" "A", 1, { 0xFFFD, 'A' } },
+							{ "truncated then illegal", "\xE6\x97\xFF", 2, { 0xFFFD, 0xFFFD } },
+						};
+	Boolean				result = true;
+	
+	
+	for (auto const& testCase : kTestCases)
+	{
+		UTF8Decoder_StateMachine	decoder;
+		UTF8Decoder_UniCharList		expectedText;
+		UTF8Decoder_UniCharList		actualText;
+		size_t const				kErrorCount = decoder.decodeRun(REINTERPRET_CAST(testCase.bytes, UInt8 const*),
+																	std::strlen(testCase.bytes), actualText);
+		
+		
+		for (size_t i = 0; ((i < (sizeof(testCase.text) / sizeof(UniChar))) && (0 != testCase.text[i])); ++i)
+		{
+			expectedText.push_back(testCase.text[i]);
+		}
+		Console_TestAssertUpdate(result, testCase.errorCount == kErrorCount, Console_WriteValue, testCase.description, kErrorCount);
+		Console_TestAssertUpdate(result, expectedText == actualText, Console_WriteValue, testCase.description, actualText.size());
+		Console_TestAssertUpdate(result, false == decoder.incompleteSequence(), Console_WriteLine, testCase.description);
+	}
+	
+	// a sequence that is split across buffers is carried over
+	{
+		UInt8 const					kEmoji[] = { 0xF0, 0x9F, 0x98, 0x80 };
+		UTF8Decoder_StateMachine	decoder;
+		UTF8Decoder_UniCharList		actualText;
+		
+		
+		for (size_t i = 0; i < sizeof(kEmoji); ++i)
+		{
+			UInt32 const	kErrorCount = decoder.decodeRun(kEmoji + i, 1, actualText);
+			
+			
+			Console_TestAssertUpdate(result, 0 == kErrorCount, Console_WriteValue, "split emoji, errors at byte", i);
+			Console_TestAssertUpdate(result, (i + 1 < sizeof(kEmoji)) == decoder.incompleteSequence(), Console_WriteValue, "split emoji, incomplete at byte", i);
+		}
+		Console_TestAssertUpdate(result, (2 == actualText.size()) && (0xD83D == actualText[0]) && (0xDE00 == actualText[1]),
+									Console_WriteValue, "split emoji, text size", actualText.size());
+	}
+	
+	return result;
+}// unitTest_DecodeRun_000
+
+
+/*!
+Tests decodeRun() with randomly-generated data that is
+given to the decoder in randomly-sized pieces, checking
+that the results always match those of the per-byte
+state machine.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_DecodeRun_001 ()
+{
+	std::minstd_rand	generator(1998/* arbitrary, but fixed */);
+	Boolean				result = true;
+	
+	
+	for (UInt16 i = 0; ((result) && (i < 2000)); ++i)
+	{
+		UTF8Decoder_ByteString		bytes;
+		UTF8Decoder_StateMachine	expectedDecoder;
+		UTF8Decoder_StateMachine	actualDecoder;
+		UTF8Decoder_UniCharList		expectedText;
+		UTF8Decoder_UniCharList		actualText;
+		UInt32						expectedErrorCount = 0;
+		UInt32						actualErrorCount = 0;
+		
+		
+		fillRandomBytes(generator, generator() % 300, bytes);
+		expectedErrorCount = decodeByteByByte(expectedDecoder, bytes.data(), bytes.size(), expectedText);
+		for (size_t offset = 0; offset < bytes.size(); )
+		{
+			size_t const	kPieceSize = std::min(STATIC_CAST(1 + (generator() % 70), size_t), bytes.size() - offset);
+			
+			
+			actualErrorCount += actualDecoder.decodeRun(bytes.data() + offset, kPieceSize, actualText);
+			offset += kPieceSize;
+		}
+		
+		Console_TestAssertUpdate(result, expectedErrorCount == actualErrorCount, Console_WriteValue, "random data, error count", actualErrorCount);
+		Console_TestAssertUpdate(result, expectedText == actualText, Console_WriteValue, "random data, iteration", i);
+		Console_TestAssertUpdate(result, expectedDecoder.incompleteSequence() == actualDecoder.incompleteSequence(),
+									Console_WriteValue, "random data, incomplete sequence at end, iteration", i);
+	}
+	
+	return result;
+}// unitTest_DecodeRun_001
+
+
+/*!
+Tests returnValidPrefixLength() with randomly-generated
+data, comparing the result with the number of bytes that
+the per-byte state machine consumes before its first error.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_ReturnValidPrefixLength_000 ()
+{
+	std::minstd_rand	generator(2023/* arbitrary, but fixed */);
+	Boolean				result = true;
+	
+	
+	for (UInt16 i = 0; ((result) && (i < 5000)); ++i)
+	{
+		UTF8Decoder_ByteString		bytes;
+		UTF8Decoder_StateMachine	decoder;
+		size_t						expectedLength = 0;
+		
+		
+		// mostly valid text, so that errors appear in all block positions
+		for (UInt16 j = STATIC_CAST(generator() % 20, UInt16); j > 0; --j)
+		{
+			appendUTF8(generator() % ((0 == (generator() % 2)) ? 0x80 : 0x110000), bytes);
+		}
+		fillRandomBytes(generator, generator() % 80, bytes);
+		
+		for (size_t j = 0; j < bytes.size(); ++j)
+		{
+			UInt32		errorCount = 0;
+			
+			
+			decoder.nextState(bytes[j], errorCount);
+			if (0 != errorCount)
+			{
+				break;
+			}
+			if (UTF8Decoder_StateMachine::kStateUTF8ValidSequence == decoder.returnState())
+			{
+				expectedLength = (j + 1);
+				decoder.reset();
+			}
+		}
+		
+		{
+			size_t const	kActualLength = UTF8Decoder_StateMachine::returnValidPrefixLength(bytes.data(), bytes.size());
+			
+			
+			Console_TestAssertUpdate(result, expectedLength == kActualLength, Console_WriteValue, "valid prefix length", kActualLength);
+		}
+	}
+	
+	return result;
+}// unitTest_ReturnValidPrefixLength_000
+
+} // anonymous namespace
+
 // BELOW IS REQUIRED NEWLINE TO END FILE
@@ -32,6 +32,7 @@
 
 // standard-C++ includes
 #include <string>
+#include <vector>
 
 // Mac includes
 #include <CoreServices/CoreServices.h>
@@ -49,6 +50,7 @@ UnicodeScalarValue const	kUTF8Decoder_InvalidUnicodeCodePoint = 0xFFFF;
 #pragma mark Types
 
 typedef std::basic_string<UInt8>	UTF8Decoder_ByteString;
+typedef std::vector< UniChar >		UTF8Decoder_UniCharList;
 
 /*!
 Represents the state of a UTF-8 code point that is in the
@@ -61,18 +63,20 @@ struct UTF8Decoder_StateMachine
 		kStateInitial				= 'init',	//!< the very first state, no bytes have yet been seen
 		kStateUTF8IllegalSequence	= 'U8XX',	//!< single illegal byte was seen (0xC0, 0xC1, or a value of 0xF5 or greater), or illegal sequence;
 												//!  in this case, the "multiByteAccumulator" contains a valid sequence for an error character
-		kStateUTF8ValidSequence		= 'U8OK',	//!< the "multiByteAccumulator" contains a valid sequence of 0-6 bytes in UTF-8 encoding
+		kStateUTF8ValidSequence		= 'U8OK',	//!< the "multiByteAccumulator" contains a valid sequence of 0-4 bytes in UTF-8 encoding
 		kStateUTF8ExpectingTwo		= 'U82B',	//!< byte with high bits of "110" received; one more continuation byte (only) should follow
 		kStateUTF8ExpectingThree	= 'U83B',	//!< byte with high bits of "1110" received; two more continuation bytes (only) should follow
 		kStateUTF8ExpectingFour		= 'U84B',	//!< byte with high bits of "11110" received; three more continuation bytes (only) should follow
-		kStateUTF8ExpectingFive		= 'U85B',	//!< byte with high bits of "111110" received; four more continuation bytes (only) should follow
-		kStateUTF8ExpectingSix		= 'U86B',	//!< byte with high bits of "1111110" received; five more continuation bytes (only) should follow
 	};
 	
 	UTF8Decoder_ByteString		multiByteAccumulator;		//!< shows all bytes that comprise the most-recently-started UTF-8 code point
 	
 	UTF8Decoder_StateMachine ();
 	
+	//! Decodes an entire buffer into UTF-16, continuing (or leaving) an incomplete sequence; returns the error count.
+	UInt32
+	decodeRun	(UInt8 const*, size_t, UTF8Decoder_UniCharList&);
+	
 	//! Returns true if the current sequence is incomplete.
 	Boolean
 	incompleteSequence ();
@@ -109,11 +113,11 @@ struct UTF8Decoder_StateMachine
 	static Boolean	isFirstOfTwo		(UInt8);	//!< true only for a byte that must be followed by exactly one continuation byte to complete its sequence
 	static Boolean	isFirstOfThree		(UInt8);	//!< true only for a byte that must be followed by exactly 2 continuation bytes to complete its sequence
 	static Boolean	isFirstOfFour		(UInt8);	//!< true only for a byte that must be followed by exactly 3 continuation bytes to complete its sequence
-	static Boolean	isFirstOfFive		(UInt8);	//!< true only for a byte that must be followed by exactly 4 continuation bytes to complete its sequence
-	static Boolean	isFirstOfSix		(UInt8);	//!< true only for a byte that must be followed by exactly 5 continuation bytes to complete its sequence
 	static Boolean	isIllegalByte		(UInt8);	//!< true for byte values that will never be valid in any situation in UTF-8
 	static Boolean	isSingleByteGlyph	(UInt8);	//!< true only for a byte that is itself a complete sequence (normal ASCII)
 	static Boolean	isStartingByte		(UInt8);	//!< if false, implies that this is a continuation byte
+	
+	static size_t	returnValidPrefixLength		(UInt8 const*, size_t);		//!< number of leading bytes that form complete, valid sequences
 
 protected:
 	Boolean
@@ -124,6 +128,21 @@ private:
 };
 
 
+
+#pragma mark Public Methods
+
+//!\name Module Tests
+//@{
+
+void
+	UTF8Decoder_RunBenchmarks	();
+
+void
+	UTF8Decoder_RunTests		();
+
+//@}
+
+
 /*!
 Appends a valid sequence of bytes to the specified string, that
 represent the “invalid character” code point.
@@ -231,40 +250,6 @@ byteSequenceTotalValue	(indexable_container const&		inBytes,
 			*outBytesUsedOrNull = 4;
 		}
 	}
-	else if ((inByteCount >= 5) && isFirstOfFive(inBytes[inOffset]) &&
-				isContinuationByte(inBytes[inOffset + 1]) &&
-				isContinuationByte(inBytes[inOffset + 2]) &&
-				isContinuationByte(inBytes[inOffset + 3]) &&
-				isContinuationByte(inBytes[inOffset + 4]))
-	{
-		result = (((inBytes[inOffset] & 0x03) << 24) +
-					((inBytes[inOffset + 1] & 0x3F) << 18) +
-					((inBytes[inOffset + 2] & 0x3F) << 12) +
-					((inBytes[inOffset + 3] & 0x3F) << 6) +
-					((inBytes[inOffset + 4] & 0x3F) << 0));
-		if (nullptr != outBytesUsedOrNull)
-		{
-			*outBytesUsedOrNull = 5;
-		}
-	}
-	else if ((inByteCount >= 6) && isFirstOfSix(inBytes[inOffset]) &&
-				isContinuationByte(inBytes[inOffset + 1]) &&
-				isContinuationByte(inBytes[inOffset + 2]) &&
-				isContinuationByte(inBytes[inOffset + 3]) &&
-				isContinuationByte(inBytes[inOffset + 4]) &&
-				isContinuationByte(inBytes[inOffset + 5]))
-	{
-		result = (((inBytes[inOffset] & 0x01) << 30) +
-					((inBytes[inOffset + 1] & 0x3F) << 24) +
-					((inBytes[inOffset + 2] & 0x3F) << 18) +
-					((inBytes[inOffset + 3] & 0x3F) << 12) +
-					((inBytes[inOffset + 4] & 0x3F) << 6) +
-					((inBytes[inOffset + 5] & 0x3F) << 0));
-		if (nullptr != outBytesUsedOrNull)
-		{
-			*outBytesUsedOrNull = 6;
-		}
-	}
 	return result;
 }// UTF8Decoder_StateMachine::byteSequenceTotalValue
 
@@ -326,52 +311,25 @@ isFirstOfFour	(UInt8		inByte)
 }// UTF8Decoder_StateMachine::isFirstOfFour
 
 
-/*!
-Returns true only for bytes that indicate the start of a
-sequence of exactly 5 bytes.
-
-Not to be confused with Third of Five or Seven of Nine.
-
-(4.0)
-*/
-inline Boolean
-UTF8Decoder_StateMachine::
-isFirstOfFive	(UInt8		inByte)
-{
-	return (0xF8 == (inByte & 0xFC));
-}// UTF8Decoder_StateMachine::isFirstOfFive
-
-
-/*!
-Returns true only for bytes that indicate the start of a
-sequence of exactly 6 bytes.
-
-(4.0)
-*/
-inline Boolean
-UTF8Decoder_StateMachine::
-isFirstOfSix	(UInt8		inByte)
-{
-	return (0xFC == (inByte & 0xFE));
-}// UTF8Decoder_StateMachine::isFirstOfSix
-
-
 /*!
 Returns true only for bytes that cannot ever be considered
-valid UTF-8, no matter what the context.
+valid UTF-8, no matter what the context.  This includes the
+bytes that would begin 5-byte and 6-byte sequences, which
+were removed from UTF-8 by RFC 3629.
 
 Note that this does not reject bytes that could be used to
-begin over-long encodings (such as 0xC0).  Those problems
-are detected later so that they can be represented as a
-single error character.
+begin over-long encodings (such as 0xC0) or values beyond
+the Unicode range (such as 0xF5).  Those problems are
+detected later so that they can be represented as a single
+error character.
 
-(4.0)
+(2023.10)
 */
 inline Boolean
 UTF8Decoder_StateMachine::
 isIllegalByte	(UInt8		inByte)
 {
-	return ((0xFE == inByte) || (0xFF == inByte));
+	return (inByte >= 0xF8);
 }// UTF8Decoder_StateMachine::isIllegalByte
 
 
@@ -406,7 +364,7 @@ isStartingByte	(UInt8		inByte)
 	// this is the paranoid form that should never be necessary given
 	// the actual definition of the bits in the encoding
 	return (isSingleByteGlyph(inByte) || isFirstOfTwo(inByte) || isFirstOfThree(inByte) ||
-			isFirstOfFour(inByte) || isFirstOfFive(inByte) || isFirstOfSix(inByte));
+			isFirstOfFour(inByte) || isIllegalByte(inByte));
 #endif
 }// UTF8Decoder_StateMachine::isStartingByte
 
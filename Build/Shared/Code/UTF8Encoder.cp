@@ -0,0 +1,722 @@
+/*!	\file UTF8Encoder.cp
+	\brief Conversion of UTF-16 text into UTF-8 bytes in bulk.
+*/
+/*###############################################################
+
+	Data Access Library
+	© 1998-2023 by Kevin Grant
+	
+	This library is free software; you can redistribute it or
+	modify it under the terms of the GNU Lesser Public License
+	as published by the Free Software Foundation; either version
+	2.1 of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be
+	useful, but WITHOUT ANY WARRANTY; without even the implied
+	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+	PURPOSE.  See the GNU Lesser Public License for details.
+	
+	You should have received a copy of the GNU Lesser Public
+	License along with this library; if not, write to:
+	
+		Free Software Foundation, Inc.
+		59 Temple Place, Suite 330
+		Boston, MA  02111-1307
+		USA
+
+###############################################################*/
+
+#include "UTF8Encoder.h"
+#include <UniversalDefines.h>
+
+// standard-C++ includes
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// compiler includes
+#if defined(__SSE2__)
+#	include <immintrin.h>
+#elif defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
+// Mac includes
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreServices/CoreServices.h>
+
+// library includes
+#include <CFRetainRelease.h>
+#include <Console.h>
+
+
+
+#pragma mark Constants
+namespace {
+
+size_t const	kMy_VectorBlockSize = 8;	//!< number of UTF-16 values converted at once by UTF8Encoder_EncodeRun()
+
+} // anonymous namespace
+
+#pragma mark Types
+namespace {
+
+typedef std::basic_string< UInt8 >	My_ByteString;
+typedef std::vector< UniChar >		My_UniCharList;
+
+} // anonymous namespace
+
+#pragma mark Internal Method Prototypes
+namespace {
+
+void		appendUTF16					(UnicodeScalarValue, My_UniCharList&);
+void		encodeCharacterByCharacter	(CFStringRef, My_ByteString&);
+void		encodeInChunks				(CFStringRef, CFIndex, My_ByteString&);
+void		encodeRunInChunks			(CFStringRef, CFIndex, My_ByteString&);
+void		fillRandomText				(std::minstd_rand&, size_t, UInt16, My_UniCharList&);
+Boolean		unitTest_EncodeRun_000		();
+Boolean		unitTest_EncodeRun_001		();
+
+} // anonymous namespace
+
+
+
+#pragma mark Public Methods
+
+/*!
+Encodes large, generated samples of ASCII, CJK and
+emoji-heavy text into UTF-8 three ways, and logs the speed
+of each to the console: one character at a time with
+CFStringGetBytes() (the way that strings were traditionally
+sent to sessions), with CFStringGetBytes() on large ranges
+(the way that other encodings are now sent), and with
+UTF8Encoder_EncodeRun().  Speeds are in megabytes of UTF-8
+output per second.
+
+(2023.10)
+*/
+void
+UTF8Encoder_RunBenchmarks ()
+{
+	size_t const		kCorpusLength = (2 * 1024 * 1024);
+	CFIndex const		kChunkLength = 4096;
+	UInt16 const		kIterationCount = 5;
+	std::minstd_rand	generator(2023/* arbitrary, but fixed */);
+	
+	
+	for (UInt16 corpusIndex = 0; corpusIndex < 3; ++corpusIndex)
+	{
+		char const* const	kCorpusNames[] = { "ASCII", "CJK", "emoji" };
+		My_UniCharList		corpus;
+		My_ByteString		perCharacterBytes;
+		My_ByteString		chunkBytes;
+		My_ByteString		runBytes;
+		CFAbsoluteTime		perCharacterTime = 0;
+		CFAbsoluteTime		chunkTime = 0;
+		CFAbsoluteTime		runTime = 0;
+		
+		
+		fillRandomText(generator, kCorpusLength, corpusIndex, corpus);
+		
+		CFRetainRelease		corpusString(CFStringCreateWithCharactersNoCopy(kCFAllocatorDefault, corpus.data(), corpus.size(),
+																			kCFAllocatorNull),
+											CFRetainRelease::kAlreadyRetained);
+		CFStringRef			corpusCFString = corpusString.returnCFStringRef();
+		
+		
+		// encode one character at a time
+		{
+			CFAbsoluteTime const	kStartTime = CFAbsoluteTimeGetCurrent();
+			
+			
+			for (UInt16 i = 0; i < kIterationCount; ++i)
+			{
+				perCharacterBytes.clear();
+				encodeCharacterByCharacter(corpusCFString, perCharacterBytes);
+			}
+			perCharacterTime = (CFAbsoluteTimeGetCurrent() - kStartTime);
+		}
+		
+		// encode large ranges with the system
+		{
+			CFAbsoluteTime const	kStartTime = CFAbsoluteTimeGetCurrent();
+			
+			
+			for (UInt16 i = 0; i < kIterationCount; ++i)
+			{
+				chunkBytes.clear();
+				encodeInChunks(corpusCFString, kChunkLength, chunkBytes);
+			}
+			chunkTime = (CFAbsoluteTimeGetCurrent() - kStartTime);
+		}
+		
+		// encode large runs directly
+		{
+			CFAbsoluteTime const	kStartTime = CFAbsoluteTimeGetCurrent();
+			
+			
+			for (UInt16 i = 0; i < kIterationCount; ++i)
+			{
+				runBytes.clear();
+				encodeRunInChunks(corpusCFString, kChunkLength, runBytes);
+			}
+			runTime = (CFAbsoluteTimeGetCurrent() - kStartTime);
+		}
+		
+		// report results
+		{
+			double const		kMegabytes = ((STATIC_CAST(perCharacterBytes.size(), double) * kIterationCount) / (1024.0 * 1024.0));
+			std::ostringstream	reportSS;
+			std::string			reportStr;
+			
+			
+			reportSS << "UTF-8 encoder benchmark, " << kCorpusNames[corpusIndex] << " (" << corpus.size() << " UTF-16 values):"
+						<< " per-character " << ((perCharacterTime > 0) ? (kMegabytes / perCharacterTime) : 0) << " MB/s,"
+						<< " chunked " << ((chunkTime > 0) ? (kMegabytes / chunkTime) : 0) << " MB/s,"
+						<< " run " << ((runTime > 0) ? (kMegabytes / runTime) : 0) << " MB/s"
+						<< (((perCharacterBytes == chunkBytes) && (perCharacterBytes == runBytes)) ? "" : " (MISMATCHED OUTPUT)");
+			reportStr = reportSS.str();
+			Console_WriteLine(reportStr.c_str());
+		}
+	}
+}// RunBenchmarks
+
+
+/*!
+A unit test for this module.  This should always
+be run before a release, after any substantial
+changes are made, or if you suspect bugs!  It
+should also be EXPANDED as new functionality is
+proposed (ideally, a test is written before the
+functionality is added).
+
+(2023.10)
+*/
+void
+UTF8Encoder_RunTests ()
+{
+	UInt16		totalTests = 0;
+	UInt16		failedTests = 0;
+	
+	
+	++totalTests; if (false == unitTest_EncodeRun_000()) ++failedTests;
+	++totalTests; if (false == unitTest_EncodeRun_001()) ++failedTests;
+	
+	Console_WriteUnitTestReport("UTF-8 Encoder", failedTests, totalTests);
+}// RunTests
+
+
+/*!
+Converts as much of the given UTF-16 text as possible into
+UTF-8, returning the number of bytes written; the number of
+UTF-16 values that were converted is returned separately.
+
+Only whole characters are converted, so the output always
+ends on a character boundary.  Conversion stops early if:
+- the next character does not fit in the remaining space;
+- an unpaired surrogate is found (this cannot be encoded);
+- the text ends with the first half of a surrogate pair
+  (the second half may be at the start of the next run).
+In the first and last cases, convert the rest in another
+call.  If no text is used even though there are at least 2
+values and room for 4 bytes, the text is not valid.
+
+Where available, ASCII is converted 8 values at a time.
+
+(2023.10)
+*/
+size_t
+UTF8Encoder_EncodeRun	(UniChar const*		inText,
+						 size_t				inTextLength,
+						 UInt8*				outBytes,
+						 size_t				inByteCapacity,
+						 size_t&			outTextLengthUsed)
+{
+	UniChar const* const	kPastEndText = (inText + inTextLength);
+	UInt8 const* const		kPastEndBytes = (outBytes + inByteCapacity);
+	UniChar const*			textPtr = inText;
+	UInt8*					bytePtr = outBytes;
+	Boolean					stopped = false;
+	
+	
+	while ((false == stopped) && (textPtr != kPastEndText))
+	{
+		UniChar const	kValue = *textPtr;
+		ptrdiff_t const	kBytesLeft = (kPastEndBytes - bytePtr);
+		
+		
+		if (kValue < 0x80)
+		{
+			size_t		asciiCount = 1;
+			
+			
+			if (kBytesLeft < 1)
+			{
+				stopped = true;
+				asciiCount = 0;
+			}
+			else
+			{
+				*bytePtr = STATIC_CAST(kValue, UInt8);
+			}
+			
+			// a whole block is always narrowed, even if only part of
+			// it is ASCII, as long as there is room for all of it
+			// (any bytes beyond the ASCII values are overwritten)
+#if defined(__SSE2__)
+			if (((kPastEndText - textPtr) >= STATIC_CAST(kMy_VectorBlockSize, ptrdiff_t)) &&
+				(kBytesLeft >= STATIC_CAST(kMy_VectorBlockSize, ptrdiff_t)))
+			{
+				__m128i const	kBlock = _mm_loadu_si128(REINTERPRET_CAST(textPtr, __m128i const*));
+				__m128i const	kHighBits = _mm_and_si128(kBlock, _mm_set1_epi16(STATIC_CAST(0xFF80, short)));
+				UInt32 const	kNonASCIIMask = (~STATIC_CAST(_mm_movemask_epi8(_mm_cmpeq_epi16(kHighBits, _mm_setzero_si128())), UInt32) & 0xFFFF);
+				
+				
+				_mm_storel_epi64(REINTERPRET_CAST(bytePtr, __m128i*), _mm_packus_epi16(kBlock, kBlock));
+				asciiCount = ((0 == kNonASCIIMask) ? kMy_VectorBlockSize : (__builtin_ctz(kNonASCIIMask) / 2));
+			}
+#elif defined(__ARM_NEON)
+			if (((kPastEndText - textPtr) >= STATIC_CAST(kMy_VectorBlockSize, ptrdiff_t)) &&
+				(kBytesLeft >= STATIC_CAST(kMy_VectorBlockSize, ptrdiff_t)))
+			{
+				uint16x8_t const	kBlock = vld1q_u16(textPtr);
+				
+				
+				// NEON has no direct equivalent to “movemask” so a block
+				// that is not entirely ASCII only advances by one value
+				if (vmaxvq_u16(kBlock) < 0x80)
+				{
+					vst1_u8(bytePtr, vmovn_u16(kBlock));
+					asciiCount = kMy_VectorBlockSize;
+				}
+			}
+#endif
+			textPtr += asciiCount;
+			bytePtr += asciiCount;
+		}
+		else if (kValue < 0x800)
+		{
+			if (kBytesLeft < 2)
+			{
+				stopped = true;
+			}
+			else
+			{
+				bytePtr[0] = STATIC_CAST(0xC0 | (kValue >> 6), UInt8);
+				bytePtr[1] = STATIC_CAST(0x80 | (kValue & 0x3F), UInt8);
+				bytePtr += 2;
+				++textPtr;
+			}
+		}
+		else if ((kValue < 0xD800) || (kValue > 0xDFFF))
+		{
+			if (kBytesLeft < 3)
+			{
+				stopped = true;
+			}
+			else
+			{
+				bytePtr[0] = STATIC_CAST(0xE0 | (kValue >> 12), UInt8);
+				bytePtr[1] = STATIC_CAST(0x80 | ((kValue >> 6) & 0x3F), UInt8);
+				bytePtr[2] = STATIC_CAST(0x80 | (kValue & 0x3F), UInt8);
+				bytePtr += 3;
+				++textPtr;
+			}
+		}
+		else if ((kValue > 0xDBFF) || ((textPtr + 1) == kPastEndText) ||
+					(textPtr[1] < 0xDC00) || (textPtr[1] > 0xDFFF))
+		{
+			// a low surrogate without a high surrogate, a high surrogate
+			// at the end of the text (whose pair may follow), or a high
+			// surrogate that is not followed by a low surrogate
+			stopped = true;
+		}
+		else if (kBytesLeft < 4)
+		{
+			stopped = true;
+		}
+		else
+		{
+			UnicodeScalarValue const	kCodePoint = (0x10000 + ((kValue - 0xD800) << 10) + (textPtr[1] - 0xDC00));
+			
+			
+			bytePtr[0] = STATIC_CAST(0xF0 | (kCodePoint >> 18), UInt8);
+			bytePtr[1] = STATIC_CAST(0x80 | ((kCodePoint >> 12) & 0x3F), UInt8);
+			bytePtr[2] = STATIC_CAST(0x80 | ((kCodePoint >> 6) & 0x3F), UInt8);
+			bytePtr[3] = STATIC_CAST(0x80 | (kCodePoint & 0x3F), UInt8);
+			bytePtr += 4;
+			textPtr += 2;
+		}
+	}
+	
+	outTextLengthUsed = STATIC_CAST(textPtr - inText, size_t);
+	return STATIC_CAST(bytePtr - outBytes, size_t);
+}// EncodeRun
+
+
+#pragma mark Internal Methods
+namespace {
+
+/*!
+Appends the given code point in UTF-16 form, which is
+a surrogate pair for code points beyond the Basic
+Multilingual Plane.
+
+(2023.10)
+*/
+void
+appendUTF16		(UnicodeScalarValue		inCodePoint,
+				 My_UniCharList&		inoutText)
+{
+	if (inCodePoint < 0x10000)
+	{
+		inoutText.push_back(STATIC_CAST(inCodePoint, UniChar));
+	}
+	else
+	{
+		inoutText.push_back(STATIC_CAST(0xD800 + ((inCodePoint - 0x10000) >> 10), UniChar));
+		inoutText.push_back(STATIC_CAST(0xDC00 + ((inCodePoint - 0x10000) & 0x03FF), UniChar));
+	}
+}// appendUTF16
+
+
+/*!
+Converts the given string to UTF-8 with one call to
+CFStringGetBytes() per character, retrying with two
+values for surrogate pairs, into a 1024-byte buffer.
+This is how strings were traditionally sent to sessions,
+and it is the reference for the benchmark.
+
+(2023.10)
+*/
+void
+encodeCharacterByCharacter	(CFStringRef		inString,
+							 My_ByteString&		inoutBytes)
+{
+	CFIndex const	kLength = CFStringGetLength(inString);
+	CFRange			targetRange = CFRangeMake(0, 1/* count */);
+	UInt8			byteArray[1024]; // arbitrary size
+	UInt8*			currentPtr = byteArray;
+	size_t			sizeRemaining = sizeof(byteArray);
+	
+	
+	for (targetRange.location = 0; targetRange.location < kLength; )
+	{
+		CFIndex		bytesForChar = 0;
+		CFIndex		numberOfCharactersConverted = 0;
+		
+		
+		targetRange.length = 1;
+		numberOfCharactersConverted = CFStringGetBytes(inString, targetRange, kCFStringEncodingUTF8, 0/* loss byte */,
+														false/* is external representation */,
+														currentPtr, sizeRemaining, &bytesForChar);
+		if (0 == numberOfCharactersConverted)
+		{
+			targetRange.length = 2;
+			numberOfCharactersConverted = CFStringGetBytes(inString, targetRange, kCFStringEncodingUTF8, 0/* loss byte */,
+															false/* is external representation */,
+															currentPtr, sizeRemaining, &bytesForChar);
+		}
+		
+		if (numberOfCharactersConverted > 0)
+		{
+			sizeRemaining -= bytesForChar;
+			currentPtr += bytesForChar;
+			targetRange.location += targetRange.length;
+		}
+		
+		if ((0 == numberOfCharactersConverted) || (sizeRemaining < 4) || (targetRange.location >= kLength))
+		{
+			inoutBytes.append(byteArray, currentPtr - byteArray);
+			currentPtr = byteArray;
+			sizeRemaining = sizeof(byteArray);
+		}
+		
+		if (0 == numberOfCharactersConverted)
+		{
+			break;
+		}
+	}
+}// encodeCharacterByCharacter
+
+
+/*!
+Converts the given string to UTF-8 with one call to
+CFStringGetBytes() per range of the given length, never
+ending a range between the two halves of a surrogate pair.
+
+(2023.10)
+*/
+void
+encodeInChunks	(CFStringRef		inString,
+				 CFIndex			inChunkLength,
+				 My_ByteString&		inoutBytes)
+{
+	CFIndex const			kLength = CFStringGetLength(inString);
+	std::vector< UInt8 >	byteArray(inChunkLength * kUTF8Encoder_MaximumBytesPerUniChar);
+	CFIndex					location = 0;
+	CFIndex					charactersConverted = 1;
+	
+	
+	while ((location < kLength) && (charactersConverted > 0))
+	{
+		CFIndex		chunkLength = std::min(kLength - location, inChunkLength);
+		CFIndex		byteCount = 0;
+		
+		
+		if (((location + chunkLength) < kLength) && (chunkLength > 1) &&
+			CFStringIsSurrogateHighCharacter(CFStringGetCharacterAtIndex(inString, location + chunkLength - 1)))
+		{
+			--chunkLength;
+		}
+		charactersConverted = CFStringGetBytes(inString, CFRangeMake(location, chunkLength), kCFStringEncodingUTF8,
+												0/* loss byte */, false/* is external representation */,
+												byteArray.data(), byteArray.size(), &byteCount);
+		inoutBytes.append(byteArray.data(), byteCount);
+		location += charactersConverted;
+	}
+}// encodeInChunks
+
+
+/*!
+Converts the given string to UTF-8 with one call to
+UTF8Encoder_EncodeRun() per run of the given length.
+
+(2023.10)
+*/
+void
+encodeRunInChunks	(CFStringRef		inString,
+					 CFIndex			inChunkLength,
+					 My_ByteString&		inoutBytes)
+{
+	CFIndex const			kLength = CFStringGetLength(inString);
+	UniChar const*			directText = CFStringGetCharactersPtr(inString);
+	std::vector< UniChar >	textArray(inChunkLength);
+	std::vector< UInt8 >	byteArray(inChunkLength * kUTF8Encoder_MaximumBytesPerUniChar);
+	CFIndex					location = 0;
+	size_t					textLengthUsed = 1;
+	
+	
+	while ((location < kLength) && (textLengthUsed > 0))
+	{
+		CFIndex const	kChunkLength = std::min(kLength - location, inChunkLength);
+		UniChar const*	chunkText = directText;
+		size_t			byteCount = 0;
+		
+		
+		if (nullptr == chunkText)
+		{
+			CFStringGetCharacters(inString, CFRangeMake(location, kChunkLength), textArray.data());
+			chunkText = textArray.data();
+		}
+		else
+		{
+			chunkText += location;
+		}
+		byteCount = UTF8Encoder_EncodeRun(chunkText, kChunkLength, byteArray.data(), byteArray.size(), textLengthUsed);
+		inoutBytes.append(byteArray.data(), byteCount);
+		location += textLengthUsed;
+	}
+}// encodeRunInChunks
+
+
+/*!
+Appends generated text until the list has at least the given
+number of UTF-16 values: mostly ASCII (style 0), mostly CJK
+(style 1) or mostly emoji (style 2).  Words of a few
+characters are separated by spaces and new-lines.
+
+(2023.10)
+*/
+void
+fillRandomText	(std::minstd_rand&		inoutGenerator,
+				 size_t					inLength,
+				 UInt16					inStyle,
+				 My_UniCharList&		inoutText)
+{
+	inoutText.reserve(inoutText.size() + inLength + 1);
+	while (inoutText.size() < inLength)
+	{
+		for (UInt16 i = STATIC_CAST(2 + (inoutGenerator() % 8), UInt16); i > 0; --i)
+		{
+			switch (inStyle)
+			{
+			case 0:
+				inoutText.push_back(STATIC_CAST('a' + (inoutGenerator() % 26), UniChar));
+				break;
+			
+			case 1:
+				// mostly ideographs, with some kana and accented Latin letters
+				if (0 == (inoutGenerator() % 4))
+				{
+					appendUTF16(0x3041 + (inoutGenerator() % 0x56)/* Hiragana */, inoutText);
+				}
+				else if (0 == (inoutGenerator() % 16))
+				{
+					appendUTF16(0x00C0 + (inoutGenerator() % 0x40)/* Latin-1 letters */, inoutText);
+				}
+				else
+				{
+					appendUTF16(0x4E00 + (inoutGenerator() % 0x5200)/* CJK unified ideographs */, inoutText);
+				}
+				break;
+			
+			case 2:
+			default:
+				// emoji, some with a variation selector or joined
+				appendUTF16(0x1F300 + (inoutGenerator() % 0x350), inoutText);
+				if (0 == (inoutGenerator() % 8))
+				{
+					appendUTF16(0xFE0F/* variation selector 16 */, inoutText);
+				}
+				else if (0 == (inoutGenerator() % 8))
+				{
+					appendUTF16(0x200D/* zero-width joiner */, inoutText);
+				}
+				break;
+			}
+		}
+		inoutText.push_back((0 == (inoutGenerator() % 10)) ? '\n' : ' ');
+	}
+}// fillRandomText
+
+
+/*!
+Tests UTF8Encoder_EncodeRun() with specific text whose
+encoding (and stopping point) is known.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_EncodeRun_000 ()
+{
+	struct My_TestCase
+	{
+		char const*		description;
+		UniChar			text[20];
+		size_t			textLength;
+		size_t			byteCapacity;
+		size_t			expectedTextUsed;
+		char const*		expectedBytes;
+	};
+	My_TestCase const	kTestCases[] =
+						{
+							{ "ASCII", { 'A', 'b', '~' }, 3, 16, 3, "Ab~" },
+							{ "2-byte", { 0x00E9 }, 1, 16, 1, "\xC3\xA9" },
+							{ "3-byte", { 0x65E5, 0x672C }, 2, 16, 2, "\xE6\x97\xA5\xE6\x9C\xAC" },
+							{ "4-byte", { 0xD83D, 0xDE00 }, 2, 16, 2, "\xF0\x9F\x98\x80" },
+							{ "highest code point", { 0xDBFF, 0xDFFF }, 2, 16, 2, "\xF4\x8F\xBF\xBF" },
+							{ "lone low surrogate", { 'A', 0xDE00, 'B' }, 3, 16, 1, "A" },
+							{ "unpaired high surrogate", { 'A', 0xD83D, 'B' }, 3, 16, 1, "A" },
+							{ "high surrogate at end", { 'A', 0xD83D }, 2, 16, 1, "A" },
+							{ "no room for 3-byte", { 'A', 0x65E5 }, 2, 3, 1, "A" },
+							{ "no room for 4-byte", { 'A', 'B', 0xD83D, 0xDE00 }, 4, 5, 2, "AB" },
+							{ "no room for ASCII", { 'A', 'B', 'C' }, 3, 2, 2, "AB" },
+							{ "vector block, all ASCII", { 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j' }, 10, 16, 10, "abcdefghij" },
+							{ "vector block, mixed", { 'a', 'b', 'c', 0x00E9, 'e', 'f', 'g', 'h', 'i', 0x65E5, 'k' }, 11, 32, 11,
+								"abc\xC3\xA9" "efghi\xE6\x97\xA5" "k" },
+							{ "vector block, high values", { 'a', 0xFF21, 'c', 'd', 'e', 'f', 'g', 'h' }, 8, 16, 8,
+								"a\xEF\xBC\xA1" "cdefgh" },
+							{ "vector block, tight space", { 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i' }, 9, 7, 7, "abcdefg" },
+						};
+	Boolean				result = true;
+	
+	
+	for (auto const& testCase : kTestCases)
+	{
+		UInt8			byteArray[32];
+		size_t			textUsed = 0;
+		size_t const	kByteCount = UTF8Encoder_EncodeRun(testCase.text, testCase.textLength, byteArray,
+															testCase.byteCapacity, textUsed);
+		My_ByteString	expectedBytes(REINTERPRET_CAST(testCase.expectedBytes, UInt8 const*), std::strlen(testCase.expectedBytes));
+		
+		
+		Console_TestAssertUpdate(result, testCase.expectedTextUsed == textUsed, Console_WriteValue, testCase.description, textUsed);
+		Console_TestAssertUpdate(result, expectedBytes == My_ByteString(byteArray, kByteCount),
+									Console_WriteValue, testCase.description, kByteCount);
+	}
+	
+	return result;
+}// unitTest_EncodeRun_000
+
+
+/*!
+Tests UTF8Encoder_EncodeRun() with randomly-generated text
+in runs and output buffers of many sizes, to ensure that the
+combined output always matches a conversion by the system.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_EncodeRun_001 ()
+{
+	std::minstd_rand	generator(1979/* arbitrary, but fixed */);
+	Boolean				result = true;
+	
+	
+	for (UInt16 trialIndex = 0; trialIndex < 60; ++trialIndex)
+	{
+		My_UniCharList		text;
+		My_ByteString		expectedBytes;
+		My_ByteString		actualBytes;
+		size_t				offset = 0;
+		size_t				textUsed = 1;
+		
+		
+		// mix the styles so that vector blocks are sometimes interrupted
+		for (UInt16 i = 0; i < 8; ++i)
+		{
+			fillRandomText(generator, text.size() + 1 + (generator() % 40), STATIC_CAST(generator() % 3, UInt16), text);
+		}
+		
+		CFRetainRelease		textString(CFStringCreateWithCharacters(kCFAllocatorDefault, text.data(), text.size()),
+										CFRetainRelease::kAlreadyRetained);
+		
+		
+		encodeInChunks(textString.returnCFStringRef(), text.size(), expectedBytes);
+		while ((offset < text.size()) && (textUsed > 0))
+		{
+			size_t const			kRunLength = std::min(text.size() - offset, STATIC_CAST(1 + (generator() % 50), size_t));
+			std::vector< UInt8 >	byteArray(1 + (generator() % 60));
+			size_t const			kByteCount = UTF8Encoder_EncodeRun(text.data() + offset, kRunLength, byteArray.data(),
+																		byteArray.size(), textUsed);
+			
+			
+			actualBytes.append(byteArray.data(), kByteCount);
+			offset += textUsed;
+			
+			// a run can only fail to make progress if it has just one value
+			// (the first half of a surrogate pair) or there is not enough
+			// space for the next character; try again with a larger run
+			if (0 == textUsed)
+			{
+				std::vector< UInt8 >	largeByteArray(8);
+				size_t const			kRetryByteCount = UTF8Encoder_EncodeRun(text.data() + offset, std::min< size_t >(text.size() - offset, 2),
+																				largeByteArray.data(), largeByteArray.size(), textUsed);
+				
+				
+				actualBytes.append(largeByteArray.data(), kRetryByteCount);
+				offset += textUsed;
+			}
+		}
+		Console_TestAssertUpdate(result, text.size() == offset, Console_WriteValue, "random text, values used", offset);
+		Console_TestAssertUpdate(result, expectedBytes == actualBytes, Console_WriteValue, "random text, byte count", actualBytes.size());
+	}
+	
+	return result;
+}// unitTest_EncodeRun_001
+
+} // anonymous namespace
+
+// BELOW IS REQUIRED NEWLINE TO END FILE
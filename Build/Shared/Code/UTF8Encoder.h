@@ -0,0 +1,82 @@
+/*!	\file UTF8Encoder.h
+	\brief Conversion of UTF-16 text into UTF-8 bytes in bulk.
+	
+	This is the opposite of the UTF8Decoder module: it is used
+	for text that is sent (such as a Paste or a macro) rather
+	than text that is received.  Whole runs of text are encoded
+	at once (with vector instructions for ASCII, where they are
+	available) instead of one character at a time, and output
+	always ends on a character boundary.
+*/
+/*###############################################################
+
+	Data Access Library
+	© 1998-2023 by Kevin Grant
+	
+	This library is free software; you can redistribute it or
+	modify it under the terms of the GNU Lesser Public License
+	as published by the Free Software Foundation; either version
+	2.1 of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be
+	useful, but WITHOUT ANY WARRANTY; without even the implied
+	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+	PURPOSE.  See the GNU Lesser Public License for details.
+	
+	You should have received a copy of the GNU Lesser Public
+	License along with this library; if not, write to:
+	
+		Free Software Foundation, Inc.
+		59 Temple Place, Suite 330
+		Boston, MA  02111-1307
+		USA
+
+###############################################################*/
+
+#include <UniversalDefines.h>
+
+#pragma once
+
+// Mac includes
+#include <CoreServices/CoreServices.h>
+
+
+
+#pragma mark Constants
+
+/*!
+The largest number of bytes that one UTF-16 value can
+require in UTF-8 (a surrogate pair requires 4 bytes, but
+that is only 2 bytes per value).  A buffer that is this
+many times larger than the text always has enough room.
+*/
+size_t const	kUTF8Encoder_MaximumBytesPerUniChar = 3;
+
+
+
+#pragma mark Public Methods
+
+//!\name Module Tests
+//@{
+
+void
+	UTF8Encoder_RunBenchmarks	();
+
+void
+	UTF8Encoder_RunTests		();
+
+//@}
+
+//!\name Encoding Text
+//@{
+
+size_t
+	UTF8Encoder_EncodeRun		(UniChar const*		inText,
+								 size_t				inTextLength,
+								 UInt8*				outBytes,
+								 size_t				inByteCapacity,
+								 size_t&			outTextLengthUsed);
+
+//@}
+
+// BELOW IS REQUIRED NEWLINE TO END FILE
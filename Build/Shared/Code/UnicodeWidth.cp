@@ -0,0 +1,544 @@
+/*!	\file UnicodeWidth.cp
+	\brief Cell widths and grapheme cluster boundaries.
+*/
+/*###############################################################
+
+	Data Access Library
+	© 1998-2023 by Kevin Grant
+	
+	This library is free software; you can redistribute it or
+	modify it under the terms of the GNU Lesser Public License
+	as published by the Free Software Foundation; either version
+	2.1 of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be
+	useful, but WITHOUT ANY WARRANTY; without even the implied
+	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+	PURPOSE.  See the GNU Lesser Public License for details.
+	
+	You should have received a copy of the GNU Lesser Public
+	License along with this library; if not, write to:
+	
+		Free Software Foundation, Inc.
+		59 Temple Place, Suite 330
+		Boston, MA  02111-1307
+		USA
+
+###############################################################*/
+
+#include "UnicodeWidth.h"
+#include <UniversalDefines.h>
+
+// standard-C++ includes
+#include <algorithm>
+
+// Mac includes
+#include <CoreServices/CoreServices.h>
+
+// library includes
+#include <Console.h>
+
+
+
+#pragma mark Constants
+namespace {
+
+UnicodeScalarValue const	kMy_ReplacementCharacter = 0xFFFD;		//!< stands in for an unpaired surrogate
+UnicodeScalarValue const	kMy_TextPresentationSelector = 0xFE0E;	//!< VS15; requests a narrow, text-style symbol
+UnicodeScalarValue const	kMy_EmojiPresentationSelector = 0xFE0F;	//!< VS16; requests a wide, emoji-style symbol
+
+/*!
+Tracks the emoji sequence rule of UAX #29 (GB11): a
+pictograph, any number of extending characters and a
+zero-width joiner may be followed by another pictograph
+in the same cluster.
+*/
+enum My_EmojiSequenceState
+{
+	kMy_EmojiSequenceStateNone			= 0,	//!< not in a pictograph sequence
+	kMy_EmojiSequenceStatePictograph	= 1,	//!< after a pictograph and any extending characters
+	kMy_EmojiSequenceStateJoiner		= 2,	//!< after a pictograph sequence and a zero-width joiner
+};
+
+} // anonymous namespace
+
+#pragma mark Internal Method Prototypes
+namespace {
+
+UnicodeScalarValue	decodeScalar							(UniChar const*, CFIndex, CFIndex&);
+Boolean				isBreakBetween							(UnicodeWidth_BreakClass, UnicodeWidth_BreakClass, CFIndex,
+															 My_EmojiSequenceState);
+Boolean				unitTest_ReturnCellCount_000			();
+Boolean				unitTest_ReturnCluster_000				();
+Boolean				unitTest_ReturnCluster_001				();
+
+} // anonymous namespace
+
+
+
+#pragma mark Public Methods
+
+/*!
+A unit test for this module.  This should always
+be run before a release, after any substantial
+changes are made, or if you suspect bugs!  It
+should also be EXPANDED as new functionality is
+proposed (ideally, a test is written before the
+functionality is added).
+
+(2023.10)
+*/
+void
+UnicodeWidth_RunTests ()
+{
+	UInt16		totalTests = 0;
+	UInt16		failedTests = 0;
+	
+	
+	++totalTests; if (false == unitTest_ReturnCellCount_000()) ++failedTests;
+	++totalTests; if (false == unitTest_ReturnCluster_000()) ++failedTests;
+	++totalTests; if (false == unitTest_ReturnCluster_001()) ++failedTests;
+	
+	Console_WriteUnitTestReport("Unicode Width", failedTests, totalTests);
+}// RunTests
+
+
+/*!
+Finds the first grapheme cluster (user-perceived character)
+in the given UTF-16 text using the rules of UAX #29, and
+returns its length, its first code point and the number of
+terminal cells that it should occupy.
+
+The cell count is the width of the first code point that
+takes up space (so that, for instance, a base letter and
+its combining marks use one cell) except that emoji forms
+are resolved for the whole cluster: a flag (pair of
+regional indicators) uses 2 cells, and a pictograph that
+is followed by a variation selector uses 2 cells for the
+emoji form (U+FE0F) or 1 cell for the text form (U+FE0E).
+A cluster can have a cell count of 0 if it only contains
+invisible characters (such as a combining mark with no
+base character); callers typically ignore such clusters.
+
+An unpaired surrogate is a cluster of length 1 whose first
+code point is U+FFFD.  The length is only 0 if the given
+text is empty.
+
+This never allocates memory so it is suitable for loops
+over large buffers.
+
+(2023.10)
+*/
+UnicodeWidth_Cluster
+UnicodeWidth_ReturnCluster	(UniChar const*		inText,
+							 CFIndex			inLength)
+{
+	UnicodeWidth_Cluster	result = { 0, kMy_ReplacementCharacter, 0 };
+	
+	
+	if (inLength > 0)
+	{
+		CFIndex						unitCount = 0;
+		UnicodeScalarValue const	kFirstScalar = decodeScalar(inText, inLength, unitCount);
+		UnicodeWidth_BreakClass		previousClass = UnicodeWidth_ReturnBreakClass(kFirstScalar);
+		UnicodeWidth_BreakClass		firstClass = previousClass;
+		CFIndex						regionalIndicatorCount = 0;
+		My_EmojiSequenceState		emojiState = kMy_EmojiSequenceStateNone;
+		
+		
+		result.length = unitCount;
+		result.firstScalar = kFirstScalar;
+		result.cellCount = std::min< UInt16 >(UnicodeWidth_ReturnCellCount(kFirstScalar), 2);
+		if (kUnicodeWidth_BreakClassRegionalIndicator == previousClass)
+		{
+			regionalIndicatorCount = 1;
+		}
+		else if (kUnicodeWidth_BreakClassExtendedPictographic == previousClass)
+		{
+			emojiState = kMy_EmojiSequenceStatePictograph;
+		}
+		
+		while (result.length < inLength)
+		{
+			UnicodeScalarValue const		kScalar = decodeScalar(inText + result.length, inLength - result.length, unitCount);
+			UnicodeWidth_BreakClass const	kClass = UnicodeWidth_ReturnBreakClass(kScalar);
+			
+			
+			if (isBreakBetween(previousClass, kClass, regionalIndicatorCount, emojiState))
+			{
+				break;
+			}
+			
+			// the code point belongs to this cluster
+			result.length += unitCount;
+			if (kUnicodeWidth_BreakClassPrepend == firstClass)
+			{
+				// a prepended character is drawn with what follows
+				// so the width and symbol come from the base
+				firstClass = kClass;
+				result.firstScalar = kScalar;
+			}
+			if (0 == result.cellCount)
+			{
+				result.cellCount = std::min< UInt16 >(UnicodeWidth_ReturnCellCount(kScalar), 2);
+			}
+			
+			// resolve emoji forms
+			if (kUnicodeWidth_BreakClassRegionalIndicator == kClass)
+			{
+				++regionalIndicatorCount;
+				result.cellCount = 2;
+			}
+			else if (kUnicodeWidth_BreakClassExtendedPictographic == firstClass)
+			{
+				if (kMy_EmojiPresentationSelector == kScalar)
+				{
+					result.cellCount = 2;
+				}
+				else if ((kMy_TextPresentationSelector == kScalar) && (previousClass == firstClass))
+				{
+					result.cellCount = 1;
+				}
+			}
+			
+			// track emoji sequences
+			if (kUnicodeWidth_BreakClassExtendedPictographic == kClass)
+			{
+				emojiState = kMy_EmojiSequenceStatePictograph;
+			}
+			else if ((kUnicodeWidth_BreakClassZWJ == kClass) && (kMy_EmojiSequenceStatePictograph == emojiState))
+			{
+				emojiState = kMy_EmojiSequenceStateJoiner;
+			}
+			else if (kUnicodeWidth_BreakClassExtend != kClass)
+			{
+				emojiState = kMy_EmojiSequenceStateNone;
+			}
+			
+			previousClass = kClass;
+		}
+	}
+	
+	return result;
+}// ReturnCluster
+
+
+#pragma mark Internal Methods
+namespace {
+
+/*!
+Returns the code point that begins the given UTF-16 text
+and the number of units that it uses (1 or 2).  An unpaired
+surrogate is returned as U+FFFD, using 1 unit.
+
+The text must not be empty.
+
+(2023.10)
+*/
+inline UnicodeScalarValue
+decodeScalar	(UniChar const*		inText,
+				 CFIndex			inLength,
+				 CFIndex&			outUnitCount)
+{
+	UniChar const			kFirstUnit = inText[0];
+	UnicodeScalarValue		result = kFirstUnit;
+	
+	
+	outUnitCount = 1;
+	if (CFStringIsSurrogateHighCharacter(kFirstUnit))
+	{
+		if ((inLength > 1) && CFStringIsSurrogateLowCharacter(inText[1]))
+		{
+			result = CFStringGetLongCharacterForSurrogatePair(kFirstUnit, inText[1]);
+			outUnitCount = 2;
+		}
+		else
+		{
+			result = kMy_ReplacementCharacter;
+		}
+	}
+	else if (CFStringIsSurrogateLowCharacter(kFirstUnit))
+	{
+		result = kMy_ReplacementCharacter;
+	}
+	
+	return result;
+}// decodeScalar
+
+
+/*!
+Returns true if the rules of UAX #29 place a grapheme
+cluster boundary between two code points with the given
+break classes.  The number of consecutive regional
+indicators before the boundary and the state of any emoji
+sequence must also be given.
+
+This implements the extended grapheme cluster rules
+except for the Indic conjunct rule (GB9c).
+
+(2023.10)
+*/
+Boolean
+isBreakBetween	(UnicodeWidth_BreakClass	inPrevious,
+				 UnicodeWidth_BreakClass	inNext,
+				 CFIndex					inRegionalIndicatorCount,
+				 My_EmojiSequenceState		inEmojiState)
+{
+	Boolean		result = true;
+	
+	
+	if ((kUnicodeWidth_BreakClassCR == inPrevious) && (kUnicodeWidth_BreakClassLF == inNext))
+	{
+		// GB3
+		result = false;
+	}
+	else if ((kUnicodeWidth_BreakClassControl == inPrevious) || (kUnicodeWidth_BreakClassCR == inPrevious) ||
+				(kUnicodeWidth_BreakClassLF == inPrevious) || (kUnicodeWidth_BreakClassControl == inNext) ||
+				(kUnicodeWidth_BreakClassCR == inNext) || (kUnicodeWidth_BreakClassLF == inNext))
+	{
+		// GB4, GB5
+		result = true;
+	}
+	else if (kUnicodeWidth_BreakClassHangulL == inPrevious)
+	{
+		// GB6
+		result = ((kUnicodeWidth_BreakClassHangulL != inNext) && (kUnicodeWidth_BreakClassHangulV != inNext) &&
+					(kUnicodeWidth_BreakClassHangulLV != inNext) && (kUnicodeWidth_BreakClassHangulLVT != inNext) &&
+					(kUnicodeWidth_BreakClassExtend != inNext) && (kUnicodeWidth_BreakClassZWJ != inNext) &&
+					(kUnicodeWidth_BreakClassSpacingMark != inNext));
+	}
+	else if (((kUnicodeWidth_BreakClassHangulLV == inPrevious) || (kUnicodeWidth_BreakClassHangulV == inPrevious)) &&
+				((kUnicodeWidth_BreakClassHangulV == inNext) || (kUnicodeWidth_BreakClassHangulT == inNext)))
+	{
+		// GB7
+		result = false;
+	}
+	else if (((kUnicodeWidth_BreakClassHangulLVT == inPrevious) || (kUnicodeWidth_BreakClassHangulT == inPrevious)) &&
+				(kUnicodeWidth_BreakClassHangulT == inNext))
+	{
+		// GB8
+		result = false;
+	}
+	else if ((kUnicodeWidth_BreakClassExtend == inNext) || (kUnicodeWidth_BreakClassZWJ == inNext) ||
+				(kUnicodeWidth_BreakClassSpacingMark == inNext) || (kUnicodeWidth_BreakClassPrepend == inPrevious))
+	{
+		// GB9, GB9a, GB9b
+		result = false;
+	}
+	else if ((kUnicodeWidth_BreakClassZWJ == inPrevious) && (kUnicodeWidth_BreakClassExtendedPictographic == inNext) &&
+				(kMy_EmojiSequenceStateJoiner == inEmojiState))
+	{
+		// GB11
+		result = false;
+	}
+	else if ((kUnicodeWidth_BreakClassRegionalIndicator == inPrevious) && (kUnicodeWidth_BreakClassRegionalIndicator == inNext) &&
+				(1 == (inRegionalIndicatorCount % 2)))
+	{
+		// GB12, GB13
+		result = false;
+	}
+	
+	return result;
+}// isBreakBetween
+
+
+/*!
+Tests the table lookups for code points whose properties
+are well known.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_ReturnCellCount_000 ()
+{
+	struct My_TestCase
+	{
+		char const*					description;
+		UnicodeScalarValue			codePoint;
+		UInt16						cellCount;
+		UnicodeWidth_BreakClass		breakClass;
+	};
+	My_TestCase const	kTestCases[] =
+						{
+							{ "ASCII letter", 'A', 1, kUnicodeWidth_BreakClassOther },
+							{ "space", ' ', 1, kUnicodeWidth_BreakClassOther },
+							{ "carriage return", 0x000D, 0, kUnicodeWidth_BreakClassCR },
+							{ "line feed", 0x000A, 0, kUnicodeWidth_BreakClassLF },
+							{ "escape", 0x001B, 0, kUnicodeWidth_BreakClassControl },
+							{ "Latin-1 letter", 0x00E9, 1, kUnicodeWidth_BreakClassOther },
+							{ "combining acute accent", 0x0301, 0, kUnicodeWidth_BreakClassExtend },
+							{ "box drawing", 0x2500, 1, kUnicodeWidth_BreakClassOther },
+							{ "zero-width space", 0x200B, 0, kUnicodeWidth_BreakClassControl },
+							{ "zero-width joiner", 0x200D, 0, kUnicodeWidth_BreakClassZWJ },
+							{ "CJK ideograph", 0x4E2D, 2, kUnicodeWidth_BreakClassOther },
+							{ "CJK extension B", 0x20000, 2, kUnicodeWidth_BreakClassOther },
+							{ "Hiragana", 0x3042, 2, kUnicodeWidth_BreakClassOther },
+							{ "full-width letter", 0xFF21, 2, kUnicodeWidth_BreakClassOther },
+							{ "half-width Katakana", 0xFF71, 1, kUnicodeWidth_BreakClassOther },
+							{ "Hangul syllable LV", 0xAC00, 2, kUnicodeWidth_BreakClassHangulLV },
+							{ "Hangul syllable LVT", 0xAC01, 2, kUnicodeWidth_BreakClassHangulLVT },
+							{ "Hangul leading consonant", 0x1100, 2, kUnicodeWidth_BreakClassHangulL },
+							{ "Hangul vowel", 0x1161, 0, kUnicodeWidth_BreakClassHangulV },
+							{ "Hangul trailing consonant", 0x11A8, 0, kUnicodeWidth_BreakClassHangulT },
+							{ "emoji", 0x1F600, 2, kUnicodeWidth_BreakClassExtendedPictographic },
+							{ "text-style pictograph", 0x2764, 1, kUnicodeWidth_BreakClassExtendedPictographic },
+							{ "emoji modifier", 0x1F3FB, 2, kUnicodeWidth_BreakClassExtend },
+							{ "regional indicator", 0x1F1FA, 1, kUnicodeWidth_BreakClassRegionalIndicator },
+							{ "variation selector", 0xFE0F, 0, kUnicodeWidth_BreakClassExtend },
+							{ "replacement character", 0xFFFD, 1, kUnicodeWidth_BreakClassOther },
+							{ "beyond Unicode", 0x110000, 1, kUnicodeWidth_BreakClassOther },
+						};
+	Boolean				result = true;
+	
+	
+	for (auto const& testCase : kTestCases)
+	{
+		UInt16 const					kCellCount = UnicodeWidth_ReturnCellCount(testCase.codePoint);
+		UnicodeWidth_BreakClass const	kBreakClass = UnicodeWidth_ReturnBreakClass(testCase.codePoint);
+		
+		
+		Console_TestAssertUpdate(result, testCase.cellCount == kCellCount, Console_WriteValue, testCase.description, kCellCount);
+		Console_TestAssertUpdate(result, testCase.breakClass == kBreakClass, Console_WriteValue, testCase.description, kBreakClass);
+	}
+	
+	// the standalone test must reject anything that could join
+	// another code point or change width in context
+	Console_TestAssertUpdate(result, UnicodeWidth_IsStandalone('A'), Console_WriteLine, "standalone ASCII");
+	Console_TestAssertUpdate(result, UnicodeWidth_IsStandalone(0x4E2D), Console_WriteLine, "standalone CJK");
+	Console_TestAssertUpdate(result, false == UnicodeWidth_IsStandalone(0x0301), Console_WriteLine, "standalone combining mark");
+	Console_TestAssertUpdate(result, false == UnicodeWidth_IsStandalone(0x1100), Console_WriteLine, "standalone Hangul consonant");
+	Console_TestAssertUpdate(result, false == UnicodeWidth_IsStandalone(0x2764), Console_WriteLine, "standalone pictograph");
+	Console_TestAssertUpdate(result, false == UnicodeWidth_IsStandalone(0x1F600), Console_WriteLine, "standalone emoji");
+	Console_TestAssertUpdate(result, false == UnicodeWidth_IsStandalone(0x001B), Console_WriteLine, "standalone control");
+	
+	return result;
+}// unitTest_ReturnCellCount_000
+
+
+/*!
+Tests UnicodeWidth_ReturnCluster() with sequences whose
+cluster lengths and cell counts are known.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_ReturnCluster_000 ()
+{
+	struct My_TestCase
+	{
+		char const*				description;
+		UniChar					text[12];
+		CFIndex					length;
+		UnicodeScalarValue		firstScalar;
+		UInt16					cellCount;
+	};
+	My_TestCase const	kTestCases[] =
+						{
+							{ "ASCII", { 'A', 'B' }, 1, 'A', 1 },
+							{ "combining mark", { 'e', 0x0301, 'x' }, 2, 'e', 1 },
+							{ "several combining marks", { 'a', 0x0300, 0x0316, 0x0317 }, 4, 'a', 1 },
+							{ "lone combining mark", { 0x0301, 'x' }, 1, 0x0301, 0 },
+							{ "CJK", { 0x4E2D, 0x6587 }, 1, 0x4E2D, 2 },
+							{ "CJK extension B", { 0xD840, 0xDC00, 'x' }, 2, 0x20000, 2 },
+							{ "CRLF", { 0x000D, 0x000A, 'x' }, 2, 0x000D, 0 },
+							{ "LFCR", { 0x000A, 0x000D }, 1, 0x000A, 0 },
+							{ "control then mark", { 0x001B, 0x0301 }, 1, 0x001B, 0 },
+							{ "Hangul L+V+T", { 0x1100, 0x1161, 0x11A8, 'x' }, 3, 0x1100, 2 },
+							{ "Hangul LV+T", { 0xAC00, 0x11A8, 0x1100 }, 2, 0xAC00, 2 },
+							{ "Hangul LVT+V", { 0xAC01, 0x1161 }, 1, 0xAC01, 2 },
+							{ "spacing mark", { 0x0915, 0x093F, 'x' }, 2, 0x0915, 1 },
+							{ "prepend", { 0x0600, 0x0661, 'x' }, 2, 0x0661, 1 },
+							{ "emoji", { 0xD83D, 0xDE00, 'x' }, 2, 0x1F600, 2 },
+							{ "emoji skin tone", { 0xD83D, 0xDC4B, 0xD83C, 0xDFFD, 'x' }, 4, 0x1F44B, 2 },
+							{ "ZWJ family", { 0xD83D, 0xDC68, 0x200D, 0xD83D, 0xDC69, 0x200D, 0xD83D, 0xDC67, 'x' }, 8, 0x1F468, 2 },
+							{ "ZWJ without pictograph", { 'a', 0x200D, 0xD83D, 0xDC69 }, 2, 'a', 1 },
+							{ "flag", { 0xD83C, 0xDDFA, 0xD83C, 0xDDF8, 'x' }, 4, 0x1F1FA, 2 },
+							{ "two flags", { 0xD83C, 0xDDFA, 0xD83C, 0xDDF8, 0xD83C, 0xDDEB, 0xD83C, 0xDDF7 }, 4, 0x1F1FA, 2 },
+							{ "lone regional indicator", { 0xD83C, 0xDDFA, 'x' }, 2, 0x1F1FA, 1 },
+							{ "emoji presentation", { 0x2764, 0xFE0F, 'x' }, 2, 0x2764, 2 },
+							{ "text presentation", { 0x231A, 0xFE0E, 'x' }, 2, 0x231A, 1 },
+							{ "unpaired high surrogate", { 0xD83D, 'x' }, 1, 0xFFFD, 1 },
+							{ "unpaired low surrogate", { 0xDE00, 0xDE00 }, 1, 0xFFFD, 1 },
+						};
+	Boolean				result = true;
+	
+	
+	for (auto const& testCase : kTestCases)
+	{
+		CFIndex		textLength = 0;
+		
+		
+		while ((textLength < STATIC_CAST(sizeof(testCase.text) / sizeof(UniChar), CFIndex)) && (0 != testCase.text[textLength]))
+		{
+			++textLength;
+		}
+		
+		UnicodeWidth_Cluster const	kCluster = UnicodeWidth_ReturnCluster(testCase.text, textLength);
+		
+		
+		Console_TestAssertUpdate(result, testCase.length == kCluster.length, Console_WriteValue, testCase.description, kCluster.length);
+		Console_TestAssertUpdate(result, testCase.firstScalar == kCluster.firstScalar, Console_WriteValue, testCase.description, kCluster.firstScalar);
+		Console_TestAssertUpdate(result, testCase.cellCount == kCluster.cellCount, Console_WriteValue, testCase.description, kCluster.cellCount);
+	}
+	
+	return result;
+}// unitTest_ReturnCluster_000
+
+
+/*!
+Tests UnicodeWidth_ReturnCluster() across a mixed buffer,
+walking it cluster by cluster as a terminal would.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_ReturnCluster_001 ()
+{
+	// "a", "é" (decomposed), "中", a flag, a family emoji, "!"
+	UniChar const	kText[] = { 'a', 'e', 0x0301, 0x4E2D, 0xD83C, 0xDDEF, 0xD83C, 0xDDF5,
+								0xD83D, 0xDC68, 0x200D, 0xD83D, 0xDC67, '!' };
+	CFIndex const	kTextLength = STATIC_CAST(sizeof(kText) / sizeof(UniChar), CFIndex);
+	CFIndex const	kExpectedLengths[] = { 1, 2, 1, 4, 5, 1 };
+	UInt16 const	kExpectedCells[] = { 1, 1, 2, 2, 2, 1 };
+	size_t			clusterCount = 0;
+	UInt16			totalCells = 0;
+	CFIndex			i = 0;
+	Boolean			result = true;
+	
+	
+	while (i < kTextLength)
+	{
+		UnicodeWidth_Cluster const	kCluster = UnicodeWidth_ReturnCluster(kText + i, kTextLength - i);
+		
+		
+		if (clusterCount < (sizeof(kExpectedLengths) / sizeof(CFIndex)))
+		{
+			Console_TestAssertUpdate(result, kExpectedLengths[clusterCount] == kCluster.length, Console_WriteValue, "mixed text, cluster length", kCluster.length);
+			Console_TestAssertUpdate(result, kExpectedCells[clusterCount] == kCluster.cellCount, Console_WriteValue, "mixed text, cell count", kCluster.cellCount);
+		}
+		i += kCluster.length;
+		totalCells += kCluster.cellCount;
+		++clusterCount;
+	}
+	Console_TestAssertUpdate(result, 6 == clusterCount, Console_WriteValue, "mixed text, cluster count", clusterCount);
+	Console_TestAssertUpdate(result, 9 == totalCells, Console_WriteValue, "mixed text, total cells", totalCells);
+	Console_TestAssertUpdate(result, 0 == UnicodeWidth_ReturnCluster(kText, 0).length, Console_WriteLine, "empty text, cluster length");
+	
+	return result;
+}// unitTest_ReturnCluster_001
+
+} // anonymous namespace
+
+// BELOW IS REQUIRED NEWLINE TO END FILE
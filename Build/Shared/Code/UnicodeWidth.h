@@ -0,0 +1,217 @@
+/*!	\file UnicodeWidth.h
+	\brief The number of terminal cells occupied by Unicode
+	text, and the boundaries of grapheme clusters.
+	
+	Every code point is looked up in a constant table that is
+	generated from the Unicode database (see the script
+	Tools/GenerateUnicodeWidthTable.py) and compiled in, so a
+	lookup is two array accesses and there is no setup cost.
+	The table combines East Asian Width (wide and full-width
+	characters use 2 cells), zero-width characters such as
+	combining marks and joiners, and the grapheme cluster
+	break classes of UAX #29 (including the emoji rules for
+	zero-width joiner sequences and regional indicators).
+*/
+/*###############################################################
+
+	Data Access Library
+	© 1998-2023 by Kevin Grant
+	
+	This library is free software; you can redistribute it or
+	modify it under the terms of the GNU Lesser Public License
+	as published by the Free Software Foundation; either version
+	2.1 of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be
+	useful, but WITHOUT ANY WARRANTY; without even the implied
+	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+	PURPOSE.  See the GNU Lesser Public License for details.
+	
+	You should have received a copy of the GNU Lesser Public
+	License along with this library; if not, write to:
+	
+		Free Software Foundation, Inc.
+		59 Temple Place, Suite 330
+		Boston, MA  02111-1307
+		USA
+
+###############################################################*/
+
+#include <UniversalDefines.h>
+
+#pragma once
+
+// Mac includes
+#include <CoreServices/CoreServices.h>
+
+// library includes
+#include <UnicodeWidthTable.h>
+
+
+
+#pragma mark Constants
+
+/*!
+Grapheme cluster break classes (see UAX #29); these determine
+which adjacent code points are displayed as one symbol.
+
+IMPORTANT:	These values are stored in the generated table and
+			must match the script that creates it.
+*/
+enum UnicodeWidth_BreakClass : UInt8
+{
+	kUnicodeWidth_BreakClassOther					= 0,	//!< no special rules (most characters)
+	kUnicodeWidth_BreakClassCR						= 1,	//!< carriage return
+	kUnicodeWidth_BreakClassLF						= 2,	//!< line feed
+	kUnicodeWidth_BreakClassControl					= 3,	//!< other controls and format characters (always alone)
+	kUnicodeWidth_BreakClassExtend					= 4,	//!< combining marks, variation selectors, emoji modifiers
+	kUnicodeWidth_BreakClassZWJ						= 5,	//!< zero-width joiner
+	kUnicodeWidth_BreakClassRegionalIndicator		= 6,	//!< flag letters (paired)
+	kUnicodeWidth_BreakClassPrepend					= 7,	//!< joins the FOLLOWING character
+	kUnicodeWidth_BreakClassSpacingMark				= 8,	//!< combining marks that take up space
+	kUnicodeWidth_BreakClassHangulL					= 9,	//!< Hangul leading consonant
+	kUnicodeWidth_BreakClassHangulV					= 10,	//!< Hangul vowel
+	kUnicodeWidth_BreakClassHangulT					= 11,	//!< Hangul trailing consonant
+	kUnicodeWidth_BreakClassHangulLV				= 12,	//!< Hangul syllable with no trailing consonant
+	kUnicodeWidth_BreakClassHangulLVT				= 13,	//!< Hangul syllable with a trailing consonant
+	kUnicodeWidth_BreakClassExtendedPictographic	= 14,	//!< emoji and other pictographs
+};
+
+#pragma mark Types
+
+/*!
+Describes the first grapheme cluster in a UTF-16 buffer
+(see UnicodeWidth_ReturnCluster()).
+*/
+struct UnicodeWidth_Cluster
+{
+	CFIndex					length;			//!< number of UTF-16 units in the cluster (at least 1 for nonempty text)
+	UnicodeScalarValue		firstScalar;	//!< first code point of the cluster (U+FFFD for an unpaired surrogate)
+	UInt16					cellCount;		//!< number of terminal cells that the cluster occupies (0, 1 or 2)
+};
+
+
+
+#pragma mark Public Methods
+
+//!\name Module Tests
+//@{
+
+void
+	UnicodeWidth_RunTests				();
+
+//@}
+
+//!\name Code Point Properties
+//@{
+
+inline constexpr UInt8
+	UnicodeWidth_ReturnProperties		(UnicodeScalarValue		inCodePoint);
+
+inline constexpr UnicodeWidth_BreakClass
+	UnicodeWidth_ReturnBreakClass		(UnicodeScalarValue		inCodePoint);
+
+inline constexpr UInt16
+	UnicodeWidth_ReturnCellCount		(UnicodeScalarValue		inCodePoint);
+
+inline constexpr Boolean
+	UnicodeWidth_IsStandalone			(UnicodeScalarValue		inCodePoint);
+
+//@}
+
+//!\name Grapheme Clusters
+//@{
+
+UnicodeWidth_Cluster
+	UnicodeWidth_ReturnCluster			(UniChar const*			inText,
+										 CFIndex				inLength);
+
+//@}
+
+
+
+#pragma mark Inline Methods
+
+/*!
+Returns the table entry for the given code point: the cell
+count is in the low 2 bits and the break class is in the
+next 4 bits.  Values beyond the Unicode range are treated
+as ordinary single-width characters.
+
+(2023.10)
+*/
+inline constexpr UInt8
+UnicodeWidth_ReturnProperties	(UnicodeScalarValue		inCodePoint)
+{
+	return (inCodePoint > 0x10FFFF)
+			? 1
+			: kUnicodeWidth_BlockBytes[(STATIC_CAST(kUnicodeWidth_BlockIndexes[inCodePoint >> kUnicodeWidth_BlockBits], UInt32) << kUnicodeWidth_BlockBits) |
+										(inCodePoint & ((1 << kUnicodeWidth_BlockBits) - 1))];
+}// ReturnProperties
+
+
+/*!
+Returns the grapheme cluster break class of the given code
+point.
+
+(2023.10)
+*/
+inline constexpr UnicodeWidth_BreakClass
+UnicodeWidth_ReturnBreakClass	(UnicodeScalarValue		inCodePoint)
+{
+	return STATIC_CAST((UnicodeWidth_ReturnProperties(inCodePoint) >> 2) & 0x0F, UnicodeWidth_BreakClass);
+}// ReturnBreakClass
+
+
+/*!
+Returns the number of terminal cells that the given code
+point occupies by itself: 0 for combining marks, joiners
+and other invisible characters, 2 for wide and full-width
+characters (East Asian Width “W” or “F”), or 1.
+
+The width of a whole cluster can differ (for instance, a
+text-style emoji becomes wide when followed by U+FE0F);
+see UnicodeWidth_ReturnCluster().
+
+(2023.10)
+*/
+inline constexpr UInt16
+UnicodeWidth_ReturnCellCount	(UnicodeScalarValue		inCodePoint)
+{
+	return (UnicodeWidth_ReturnProperties(inCodePoint) & 0x03);
+}// ReturnCellCount
+
+
+/*!
+Returns true only if the given code point always forms a
+complete cluster by itself when it is surrounded by other
+such code points: it takes up space, it fits in one UTF-16
+unit and it is not a mark, joiner, control, pictograph or
+part of a Hangul sequence.  (Pictographs are excluded since
+variation selectors can change their width.)
+
+A buffer in which every code point is standalone can be
+written one cell at a time without finding clusters.
+
+(2023.10)
+*/
+inline constexpr Boolean
+UnicodeWidth_IsStandalone	(UnicodeScalarValue		inCodePoint)
+{
+	UnicodeWidth_BreakClass const	kBreakClass = UnicodeWidth_ReturnBreakClass(inCodePoint);
+	
+	
+	return ((inCodePoint <= 0xFFFF) && (0 != UnicodeWidth_ReturnCellCount(inCodePoint)) &&
+			((kUnicodeWidth_BreakClassOther == kBreakClass) || (kUnicodeWidth_BreakClassHangulLV == kBreakClass) ||
+				(kUnicodeWidth_BreakClassHangulLVT == kBreakClass)));
+}// IsStandalone
+
+
+// the table is checked when this header is compiled
+static_assert(1 == UnicodeWidth_ReturnCellCount('A'), "ASCII letters must use one cell");
+static_assert(0 == UnicodeWidth_ReturnCellCount(0x0301), "combining marks must not use cells");
+static_assert(2 == UnicodeWidth_ReturnCellCount(0x4E2D), "CJK ideographs must use two cells");
+static_assert(2 == UnicodeWidth_ReturnCellCount(0x1F600), "emoji must use two cells");
+static_assert(kUnicodeWidth_BreakClassZWJ == UnicodeWidth_ReturnBreakClass(0x200D), "zero-width joiner must have its own class");
+
+// BELOW IS REQUIRED NEWLINE TO END FILE
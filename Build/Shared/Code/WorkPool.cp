@@ -0,0 +1,826 @@
+/*!	\file WorkPool.cp
+	\brief A shared pool of worker threads for splitting large
+	scans into chunks that run in parallel.
+*/
+/*###############################################################
+	
+	Data Access Library
+	© 1998-2023 by Kevin Grant
+	
+	This library is free software; you can redistribute it or
+	modify it under the terms of the GNU Lesser Public License
+	as published by the Free Software Foundation; either version
+	2.1 of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be
+	useful, but WITHOUT ANY WARRANTY; without even the implied
+	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+	PURPOSE.  See the GNU Lesser Public License for details.
+	
+	You should have received a copy of the GNU Lesser Public
+	License along with this library; if not, write to:
+		
+		Free Software Foundation, Inc.
+		59 Temple Place, Suite 330
+		Boston, MA  02111-1307
+		USA
+
+###############################################################*/
+
+#include "WorkPool.h"
+#include <UniversalDefines.h>
+
+// standard-C++ includes
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// library includes
+#include <Console.h>
+
+
+
+#pragma mark Types
+
+/*!
+A set of chunks submitted together.  The job is kept
+alive by each of its unfinished chunks as well as by
+the submitter’s reference.
+*/
+struct WorkPool_Job
+{
+	WorkPool_Job	(size_t, WorkPool_ChunkFunction const&);
+	
+	WorkPool_ChunkFunction		chunkFunction;			//!< called for every chunk
+	std::atomic< bool >			isCanceled;				//!< if true, chunks not yet started are skipped
+	std::mutex					completionMutex;		//!< protects "remainingChunkCount"
+	std::condition_variable		completionCondition;	//!< signaled when the last chunk ends
+	size_t						remainingChunkCount;	//!< chunks not yet finished (or skipped)
+};
+
+namespace {
+
+/*!
+One unit of work in a queue.
+*/
+struct My_Task
+{
+	WorkPool_JobRef		job;			//!< the job that owns the chunk
+	size_t				chunkIndex;		//!< which chunk of the job to run
+};
+
+/*!
+Tasks that are assigned to one worker.  The owner
+takes tasks from the front and any other thread
+steals from the back, so that each end is usually
+only touched by one thread.
+*/
+struct My_WorkerQueue
+{
+	std::mutex				mutex;		//!< protects "tasks"
+	std::deque< My_Task >	tasks;		//!< work not yet started
+};
+
+/*!
+The worker threads and their queues.  There is only
+one pool, created by the first job; it is never
+destroyed since its threads run for the life of the
+process.
+*/
+class My_Pool
+{
+public:
+	My_Pool ();
+	
+	void
+	enqueueJob	(WorkPool_JobRef, size_t);
+	
+	UInt16
+	returnWorkerCount () const
+	{
+		return STATIC_CAST(queues.size(), UInt16);
+	}
+	
+	bool
+	runNextTask	(size_t, bool);
+	
+	bool
+	runNextTaskOfJob	(WorkPool_Job const*);
+
+private:
+	void
+	runWorker	(size_t);
+	
+	std::vector< std::unique_ptr< My_WorkerQueue > >	queues;				//!< one per worker thread
+	std::mutex											idleMutex;			//!< protects "queuedTaskCount"
+	std::condition_variable								idleCondition;		//!< signaled when tasks are added
+	size_t												queuedTaskCount;	//!< total tasks in all queues (or about to be)
+};
+
+} // anonymous namespace
+
+#pragma mark Internal Method Prototypes
+namespace {
+
+void		runTask					(My_Task&);
+Boolean		unitTest_CancelJob_000	();
+Boolean		unitTest_RunJob_000		();
+Boolean		unitTest_RunJob_001		();
+Boolean		unitTest_RunJob_002		();
+Boolean		unitTest_WaitForJob_000	();
+
+} // anonymous namespace
+
+#pragma mark Variables
+namespace {
+
+My_Pool&	gPool ()	{ static My_Pool* x = new My_Pool(); return *x; } // never deleted (see My_Pool)
+
+} // anonymous namespace
+
+
+
+#pragma mark Public Methods
+
+/*!
+A unit test for this module.  This should always
+be run before a release, after any substantial
+changes are made, or if you suspect bugs!  It
+should also be EXPANDED as new functionality is
+proposed (ideally, a test is written before the
+functionality is added).
+
+(2023.10)
+*/
+void
+WorkPool_RunTests ()
+{
+	UInt16		totalTests = 0;
+	UInt16		failedTests = 0;
+	
+	
+	++totalTests; if (false == unitTest_RunJob_000()) ++failedTests;
+	++totalTests; if (false == unitTest_RunJob_001()) ++failedTests;
+	++totalTests; if (false == unitTest_RunJob_002()) ++failedTests;
+	++totalTests; if (false == unitTest_CancelJob_000()) ++failedTests;
+	++totalTests; if (false == unitTest_WaitForJob_000()) ++failedTests;
+	
+	Console_WriteUnitTestReport("Work Pool", failedTests, totalTests);
+}// RunTests
+
+
+/*!
+Requests that the given job end as soon as possible.
+Chunks that have not started will not run at all, and
+running chunks see the flag set (they may return early
+if they check it).
+
+It is still necessary to call WorkPool_WaitForJob()
+before releasing anything that running chunks use.
+
+(2023.10)
+*/
+void
+WorkPool_CancelJob	(WorkPool_JobRef	inJob)
+{
+	if (nullptr != inJob)
+	{
+		inJob->isCanceled = true;
+	}
+}// CancelJob
+
+
+/*!
+Returns true only if WorkPool_CancelJob() has been
+called for the given job.
+
+(2023.10)
+*/
+Boolean
+WorkPool_IsJobCanceled	(WorkPool_JobRef	inJob)
+{
+	return ((nullptr != inJob) && inJob->isCanceled);
+}// IsJobCanceled
+
+
+/*!
+Returns the number of threads in the pool (one per
+processor core), which is a good guide for how many
+chunks a job should have at minimum.  Jobs should
+have many more chunks than this anyway, to allow
+work to be balanced when chunks take varying time.
+
+(2023.10)
+*/
+UInt16
+WorkPool_ReturnWorkerCount ()
+{
+	return gPool().returnWorkerCount();
+}// ReturnWorkerCount
+
+
+/*!
+A convenience for starting a job and waiting for all
+of its chunks to finish.
+
+(2023.10)
+*/
+void
+WorkPool_RunJob		(size_t						inChunkCount,
+					 WorkPool_ChunkFunction		inFunction)
+{
+	WorkPool_WaitForJob(WorkPool_StartJob(inChunkCount, inFunction));
+}// RunJob
+
+
+/*!
+Runs one chunk of the given job on the calling thread,
+if any chunk of the job has not been started by a worker,
+and returns true; otherwise, returns false immediately.
+Chunks of other jobs are never run.
+
+This allows a thread that is waiting for a job to help
+finish it; it also ensures that the job can finish even
+if every worker is busy (or blocked) in other jobs.
+
+(2023.10)
+*/
+Boolean
+WorkPool_RunPendingChunk	(WorkPool_JobRef	inJob)
+{
+	return ((nullptr != inJob) && gPool().runNextTaskOfJob(inJob.get()));
+}// RunPendingChunk
+
+
+/*!
+Schedules a function to be called for each chunk index
+from 0 to "inChunkCount - 1" on the pool’s threads, and
+returns immediately.  Chunks are handed out roughly in
+order of their indices, so the first chunks tend to
+finish first.
+
+Anything that chunks use must remain valid until the
+job is finished; see WorkPool_WaitForJob().
+
+(2023.10)
+*/
+WorkPool_JobRef
+WorkPool_StartJob	(size_t						inChunkCount,
+					 WorkPool_ChunkFunction		inFunction)
+{
+	WorkPool_JobRef		result = std::make_shared< WorkPool_Job >(inChunkCount, inFunction);
+	
+	
+	if (inChunkCount > 0)
+	{
+		gPool().enqueueJob(result, inChunkCount);
+	}
+	return result;
+}// StartJob
+
+
+/*!
+Returns only when every chunk of the given job has
+finished (or been skipped, if the job was canceled).
+While waiting, the calling thread also runs chunks of
+the same job that no worker has started yet (but never
+chunks of any other job, which could take much longer
+or depend on the caller; see WorkPool_RunPendingChunk()).
+
+(2023.10)
+*/
+void
+WorkPool_WaitForJob		(WorkPool_JobRef	inJob)
+{
+	if (nullptr != inJob)
+	{
+		WorkPool_Job&	jobRef = *inJob;
+		
+		
+		while (true)
+		{
+			{
+				std::lock_guard< std::mutex >	lock(jobRef.completionMutex);
+				
+				
+				if (0 == jobRef.remainingChunkCount)
+				{
+					break;
+				}
+			}
+			
+			// since all chunks are queued when a job starts, if no
+			// task can be found then the job’s remaining chunks are
+			// all running; just wait for them
+			if (false == WorkPool_RunPendingChunk(inJob))
+			{
+				std::unique_lock< std::mutex >	lock(jobRef.completionMutex);
+				
+				
+				jobRef.completionCondition.wait(lock, [&jobRef]{ return (0 == jobRef.remainingChunkCount); });
+				break;
+			}
+		}
+	}
+}// WaitForJob
+
+
+#pragma mark Internal Methods
+
+/*!
+Constructor.
+
+(2023.10)
+*/
+WorkPool_Job::
+WorkPool_Job	(size_t							inChunkCount,
+				 WorkPool_ChunkFunction const&	inFunction)
+:
+chunkFunction(inFunction),
+isCanceled(false),
+completionMutex(),
+completionCondition(),
+remainingChunkCount(inChunkCount)
+{
+}// WorkPool_Job 2-argument constructor
+
+
+namespace {
+
+/*!
+Constructor.  Starts one worker thread for each
+processor core.
+
+(2023.10)
+*/
+My_Pool::
+My_Pool ()
+:
+queues(),
+idleMutex(),
+idleCondition(),
+queuedTaskCount(0)
+{
+	size_t const	kWorkerCount = std::max(1U, std::thread::hardware_concurrency());
+	
+	
+	// all queues must exist before any thread can look for work
+	for (size_t i = 0; i < kWorkerCount; ++i)
+	{
+		queues.emplace_back(new My_WorkerQueue);
+	}
+	for (size_t i = 0; i < kWorkerCount; ++i)
+	{
+		std::thread(&My_Pool::runWorker, this, i).detach();
+	}
+}// My_Pool default constructor
+
+
+/*!
+Adds every chunk of the given job to the worker queues,
+interleaved so that each worker starts with one of the
+first chunks (worker 0 has chunks 0, N, 2N, etc.).
+
+(2023.10)
+*/
+void
+My_Pool::
+enqueueJob	(WorkPool_JobRef	inJob,
+			 size_t				inChunkCount)
+{
+	size_t const	kQueueCount = queues.size();
+	
+	
+	// the count is raised first so that it is never less than
+	// the number of queued tasks (a worker may take a task as
+	// soon as it is added below)
+	{
+		std::lock_guard< std::mutex >	lock(idleMutex);
+		
+		
+		queuedTaskCount += inChunkCount;
+	}
+	
+	for (size_t i = 0; i < kQueueCount; ++i)
+	{
+		std::lock_guard< std::mutex >	lock(queues[i]->mutex);
+		
+		
+		for (size_t chunkIndex = i; chunkIndex < inChunkCount; chunkIndex += kQueueCount)
+		{
+			queues[i]->tasks.push_back(My_Task{inJob, chunkIndex});
+		}
+	}
+	
+	idleCondition.notify_all();
+}// My_Pool::enqueueJob
+
+
+/*!
+Finds one task and runs it on the calling thread,
+returning true; or, returns false if every queue is
+empty.  The queue with the given index is checked
+first; if "inIsOwner" is true, the oldest task of
+that queue is used.  Otherwise, the newest task of
+the first nonempty queue is stolen.
+
+(2023.10)
+*/
+bool
+My_Pool::
+runNextTask		(size_t		inQueueIndex,
+				 bool		inIsOwner)
+{
+	size_t const	kQueueCount = queues.size();
+	My_Task			task;
+	bool			result = false;
+	
+	
+	for (size_t offset = 0; ((false == result) && (offset < kQueueCount)); ++offset)
+	{
+		My_WorkerQueue&					queueRef = *queues[(inQueueIndex + offset) % kQueueCount];
+		std::lock_guard< std::mutex >	lock(queueRef.mutex);
+		
+		
+		if (false == queueRef.tasks.empty())
+		{
+			if (inIsOwner && (0 == offset))
+			{
+				task = std::move(queueRef.tasks.front());
+				queueRef.tasks.pop_front();
+			}
+			else
+			{
+				task = std::move(queueRef.tasks.back());
+				queueRef.tasks.pop_back();
+			}
+			result = true;
+		}
+	}
+	
+	if (result)
+	{
+		{
+			std::lock_guard< std::mutex >	lock(idleMutex);
+			
+			
+			--queuedTaskCount;
+		}
+		runTask(task);
+	}
+	return result;
+}// My_Pool::runNextTask
+
+
+/*!
+Like runNextTask(), except that only a task of the given
+job is taken (the newest one found in any queue).  Returns
+false if no queue has a task of the job.
+
+(2023.10)
+*/
+bool
+My_Pool::
+runNextTaskOfJob	(WorkPool_Job const*	inJobPtr)
+{
+	My_Task		task;
+	bool		result = false;
+	
+	
+	for (auto toQueue = queues.begin(); ((false == result) && (toQueue != queues.end())); ++toQueue)
+	{
+		My_WorkerQueue&					queueRef = **toQueue;
+		std::lock_guard< std::mutex >	lock(queueRef.mutex);
+		auto							toTask = std::find_if(queueRef.tasks.rbegin(), queueRef.tasks.rend(),
+																[inJobPtr] (My_Task const& inTask) { return (inJobPtr == inTask.job.get()); });
+		
+		
+		if (queueRef.tasks.rend() != toTask)
+		{
+			task = std::move(*toTask);
+			queueRef.tasks.erase(std::next(toTask).base());
+			result = true;
+		}
+	}
+	
+	if (result)
+	{
+		{
+			std::lock_guard< std::mutex >	lock(idleMutex);
+			
+			
+			--queuedTaskCount;
+		}
+		runTask(task);
+	}
+	return result;
+}// My_Pool::runNextTaskOfJob
+
+
+/*!
+The body of each worker thread: runs tasks until
+there are none left anywhere, then sleeps until a
+new job is started.
+
+(2023.10)
+*/
+void
+My_Pool::
+runWorker	(size_t		inQueueIndex)
+{
+	while (true)
+	{
+		if (false == runNextTask(inQueueIndex, true/* is owner */))
+		{
+			std::unique_lock< std::mutex >	lock(idleMutex);
+			
+			
+			idleCondition.wait(lock, [this]{ return (queuedTaskCount > 0); });
+		}
+	}
+}// My_Pool::runWorker
+
+
+/*!
+Calls the job function for the given task (unless
+the job was canceled), and then signals the job if
+it was the last chunk.
+
+(2023.10)
+*/
+void
+runTask		(My_Task&	inoutTask)
+{
+	WorkPool_Job&	jobRef = *inoutTask.job;
+	
+	
+	if (false == jobRef.isCanceled)
+	{
+		try
+		{
+			jobRef.chunkFunction(inoutTask.chunkIndex, jobRef.isCanceled);
+		}
+		catch (std::exception const&	inException)
+		{
+			Console_Warning(Console_WriteLine, inException.what());
+		}
+		catch (...)
+		{
+			// the chunk must still be counted below, or the job never ends
+			Console_Warning(Console_WriteLine, "work pool chunk threw an unknown exception");
+		}
+	}
+	
+	{
+		std::lock_guard< std::mutex >	lock(jobRef.completionMutex);
+		
+		
+		--jobRef.remainingChunkCount;
+		if (0 == jobRef.remainingChunkCount)
+		{
+			jobRef.completionCondition.notify_all();
+		}
+	}
+	
+	// release the job as soon as the chunk is finished
+	inoutTask.job.reset();
+}// runTask
+
+
+/*!
+Tests that every chunk of a job runs exactly once.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_RunJob_000 ()
+{
+	size_t const						kChunkCount = 1000;
+	std::vector< std::atomic< int > >	callCounts(kChunkCount);
+	std::vector< std::atomic< int > >*	callCountsPtr = &callCounts;
+	Boolean								result = true;
+	
+	
+	for (auto& countRef : callCounts)
+	{
+		countRef = 0;
+	}
+	
+	WorkPool_RunJob(kChunkCount, [callCountsPtr] (size_t inChunkIndex, std::atomic< bool > const& UNUSED_ARGUMENT(inIsCanceled))
+									{
+										++((*callCountsPtr)[inChunkIndex]);
+									});
+	
+	for (size_t i = 0; i < kChunkCount; ++i)
+	{
+		int const	kCallCount = callCounts[i];
+		
+		
+		Console_TestAssertUpdate(result, 1 == kCallCount, Console_WriteValue, "chunk call count", kCallCount);
+	}
+	
+	return result;
+}// unitTest_RunJob_000
+
+
+/*!
+Tests that a job with no chunks finishes immediately,
+and that there is at least one worker.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_RunJob_001 ()
+{
+	std::atomic< int >		callCount(0);
+	std::atomic< int >*		callCountPtr = &callCount;
+	Boolean					result = true;
+	
+	
+	WorkPool_RunJob(0, [callCountPtr] (size_t UNUSED_ARGUMENT(inChunkIndex), std::atomic< bool > const& UNUSED_ARGUMENT(inIsCanceled))
+						{
+							++(*callCountPtr);
+						});
+	
+	{
+		int const	kCallCount = callCount;
+		
+		
+		Console_TestAssertUpdate(result, 0 == kCallCount, Console_WriteValue, "call count for empty job", kCallCount);
+	}
+	{
+		UInt16 const	kWorkerCount = WorkPool_ReturnWorkerCount();
+		
+		
+		Console_TestAssertUpdate(result, kWorkerCount > 0, Console_WriteValue, "worker count", kWorkerCount);
+	}
+	
+	return result;
+}// unitTest_RunJob_001
+
+
+/*!
+Tests that a job still finishes if its chunks throw
+exceptions of any type.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_RunJob_002 ()
+{
+	size_t const			kChunkCount = 100;
+	std::atomic< int >		callCount(0);
+	std::atomic< int >*		callCountPtr = &callCount;
+	Boolean					result = true;
+	
+	
+	WorkPool_RunJob(kChunkCount, [callCountPtr] (size_t inChunkIndex, std::atomic< bool > const& UNUSED_ARGUMENT(inIsCanceled))
+									{
+										++(*callCountPtr);
+										if (0 == (inChunkIndex % 2))
+										{
+											throw STATIC_CAST(inChunkIndex, int);
+										}
+										throw std::runtime_error("test exception");
+									});
+	
+	{
+		int const	kCallCount = callCount;
+		
+		
+		Console_TestAssertUpdate(result, STATIC_CAST(kChunkCount, int) == kCallCount, Console_WriteValue, "call count for throwing job", kCallCount);
+	}
+	
+	return result;
+}// unitTest_RunJob_002
+
+
+/*!
+Tests that canceling a job skips chunks that have not
+started, and that waiting for a canceled job works.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_CancelJob_000 ()
+{
+	size_t const			kChunkCount = 100000;
+	std::atomic< int >		callCount(0);
+	std::atomic< int >*		callCountPtr = &callCount;
+	WorkPool_JobRef			job;
+	WorkPool_JobRef*		jobPtr = &job;
+	std::mutex				startMutex; // holds chunks until the job reference is set
+	std::mutex*				startMutexPtr = &startMutex;
+	Boolean					result = true;
+	
+	
+	{
+		std::lock_guard< std::mutex >	lock(startMutex);
+		
+		
+		job = WorkPool_StartJob(kChunkCount, [=] (size_t UNUSED_ARGUMENT(inChunkIndex), std::atomic< bool > const& UNUSED_ARGUMENT(inIsCanceled))
+												{
+													std::lock_guard< std::mutex >	chunkLock(*startMutexPtr);
+													
+													
+													++(*callCountPtr);
+													WorkPool_CancelJob(*jobPtr);
+												});
+	}
+	WorkPool_WaitForJob(job);
+	
+	{
+		int const	kCallCount = callCount;
+		
+		
+		Console_TestAssertUpdate(result, WorkPool_IsJobCanceled(job), Console_WriteLine, "job should be canceled");
+		Console_TestAssertUpdate(result, kCallCount > 0, Console_WriteValue, "call count for canceled job", kCallCount);
+		Console_TestAssertUpdate(result, kCallCount < STATIC_CAST(kChunkCount, int), Console_WriteValue, "call count for canceled job", kCallCount);
+	}
+	
+	return result;
+}// unitTest_CancelJob_000
+
+
+/*!
+Tests that waiting for a job only runs chunks of that
+job on the calling thread, even when every worker is
+busy with another job that has chunks waiting.
+
+Returns "true" if ALL assertions pass; "false" is
+returned if any fail, however messages should be
+printed for ALL assertion failures regardless.
+
+(2023.10)
+*/
+Boolean
+unitTest_WaitForJob_000 ()
+{
+	size_t const			kBusyChunkCount = 4 * STATIC_CAST(WorkPool_ReturnWorkerCount(), size_t);
+	std::thread::id const	kWaitingThread = std::this_thread::get_id();
+	std::atomic< bool >		isReleased(false);
+	std::atomic< bool >*	isReleasedPtr = &isReleased;
+	std::atomic< int >		busyCallerCount(0); // chunks of the busy job run by the waiting thread too early
+	std::atomic< int >*		busyCallerCountPtr = &busyCallerCount;
+	std::atomic< int >		callCount(0);
+	std::atomic< int >*		callCountPtr = &callCount;
+	WorkPool_JobRef			busyJob;
+	Boolean					result = true;
+	
+	
+	// the first job occupies every worker until it is released
+	// (and still has chunks queued, that must not be taken)
+	busyJob = WorkPool_StartJob(kBusyChunkCount, [=] (size_t UNUSED_ARGUMENT(inChunkIndex), std::atomic< bool > const& UNUSED_ARGUMENT(inIsCanceled))
+													{
+														if ((kWaitingThread == std::this_thread::get_id()) && (false == *isReleasedPtr))
+														{
+															++(*busyCallerCountPtr);
+														}
+														while (false == *isReleasedPtr)
+														{
+															std::this_thread::yield();
+														}
+													});
+	WorkPool_RunJob(10, [callCountPtr] (size_t UNUSED_ARGUMENT(inChunkIndex), std::atomic< bool > const& UNUSED_ARGUMENT(inIsCanceled))
+						{
+							++(*callCountPtr);
+						});
+	isReleased = true;
+	WorkPool_WaitForJob(busyJob);
+	
+	{
+		int const	kCallCount = callCount;
+		int const	kBusyCallerCount = busyCallerCount;
+		
+		
+		Console_TestAssertUpdate(result, 10 == kCallCount, Console_WriteValue, "call count for waited job", kCallCount);
+		Console_TestAssertUpdate(result, 0 == kBusyCallerCount, Console_WriteValue, "chunks of other job run while waiting", kBusyCallerCount);
+	}
+	
+	return result;
+}// unitTest_WaitForJob_000
+
+} // anonymous namespace
+
+// BELOW IS REQUIRED NEWLINE TO END FILE
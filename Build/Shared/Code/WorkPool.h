@@ -0,0 +1,114 @@
+/*!	\file WorkPool.h
+	\brief A shared pool of worker threads for splitting large
+	scans into chunks that run in parallel.
+	
+	The pool is started the first time a job is submitted and
+	its threads live for the rest of the process, so that
+	frequent jobs (such as searches repeated on every key
+	typed into a Find field) do not pay to create threads.
+	There is one worker per available processor core.
+	
+	Each worker owns a queue of chunks; a worker always takes
+	its oldest chunk first but an idle worker will “steal”
+	the newest chunk from another worker’s queue, so uneven
+	chunk costs are balanced automatically.
+*/
+/*###############################################################
+	
+	Data Access Library
+	© 1998-2023 by Kevin Grant
+	
+	This library is free software; you can redistribute it or
+	modify it under the terms of the GNU Lesser Public License
+	as published by the Free Software Foundation; either version
+	2.1 of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be
+	useful, but WITHOUT ANY WARRANTY; without even the implied
+	warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+	PURPOSE.  See the GNU Lesser Public License for details.
+	
+	You should have received a copy of the GNU Lesser Public
+	License along with this library; if not, write to:
+		
+		Free Software Foundation, Inc.
+		59 Temple Place, Suite 330
+		Boston, MA  02111-1307
+		USA
+
+###############################################################*/
+
+#include <UniversalDefines.h>
+
+#pragma once
+
+// standard-C++ includes
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Mac includes
+#include <CoreServices/CoreServices.h>
+
+
+
+#pragma mark Types
+
+struct WorkPool_Job;
+typedef std::shared_ptr< WorkPool_Job >		WorkPool_JobRef;
+
+/*!
+Called once for each chunk of a job, on an arbitrary pool
+thread (chunks of the same job may run simultaneously, and
+in any order).
+
+If the job is canceled, chunks that have not started are
+skipped entirely; a chunk that is already running can poll
+"inIsCanceled" to return early.
+
+(2023.10)
+*/
+typedef std::function< void (size_t						/* inChunkIndex */,
+							 std::atomic< bool > const&		/* inIsCanceled */) >	WorkPool_ChunkFunction;
+
+
+
+#pragma mark Public Methods
+
+//!\name Module Tests
+//@{
+
+void
+	WorkPool_RunTests				();
+
+//@}
+
+//!\name Running Jobs
+//@{
+
+void
+	WorkPool_CancelJob				(WorkPool_JobRef			inJob);
+
+Boolean
+	WorkPool_IsJobCanceled			(WorkPool_JobRef			inJob);
+
+UInt16
+	WorkPool_ReturnWorkerCount		();
+
+void
+	WorkPool_RunJob					(size_t						inChunkCount,
+									 WorkPool_ChunkFunction		inFunction);
+
+Boolean
+	WorkPool_RunPendingChunk		(WorkPool_JobRef			inJob);
+
+WorkPool_JobRef
+	WorkPool_StartJob				(size_t						inChunkCount,
+									 WorkPool_ChunkFunction		inFunction);
+
+void
+	WorkPool_WaitForJob				(WorkPool_JobRef			inJob);
+
+//@}
+
+// BELOW IS REQUIRED NEWLINE TO END FILE
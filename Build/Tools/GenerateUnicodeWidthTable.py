@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+# vim: set fileencoding=UTF-8 :
+
+"""Generates the cell-width and grapheme-break table that is used
+by the UnicodeWidth module (Shared/Code/UnicodeWidthTable.h).
+
+Run this whenever the Python version used to build changes its
+Unicode database (unicodedata.unidata_version) and commit the
+result, e.g.:
+
+    python3 Tools/GenerateUnicodeWidthTable.py > Shared/Code/UnicodeWidthTable.h
+
+Every code point is described by one byte: the low 2 bits are the
+number of terminal cells (0, 1 or 2) and the next 4 bits are the
+grapheme cluster break class (see "UnicodeWidth_BreakClass"). The
+bytes are stored as a two-level table: the high bits of a code point
+select a block of 256 bytes, and identical blocks are only stored
+once, so any lookup is exactly two array accesses.
+
+Python does not expose the grapheme break or emoji properties of
+UAX #29 and UTS #51, so those are derived from general categories
+plus the short lists below (taken from GraphemeBreakProperty.txt
+and emoji-data.txt).
+
+"""
+from __future__ import division
+from __future__ import print_function
+
+__version__ = '1.0'
+
+import sys
+import unicodedata
+
+# IMPORTANT: these values must match "UnicodeWidth_BreakClass"
+kOther = 0
+kCR = 1
+kLF = 2
+kControl = 3
+kExtend = 4
+kZWJ = 5
+kRegionalIndicator = 6
+kPrepend = 7
+kSpacingMark = 8
+kHangulL = 9
+kHangulV = 10
+kHangulT = 11
+kHangulLV = 12
+kHangulLVT = 13
+kExtendedPictographic = 14
+
+kBlockBits = 8
+kCodePointLimit = 0x110000
+
+# Other_Grapheme_Extend (and other Extend values that are not marks)
+kOtherExtend = [
+    (0x09BE, 0x09BE), (0x09D7, 0x09D7), (0x0B3E, 0x0B3E), (0x0B57, 0x0B57),
+    (0x0BBE, 0x0BBE), (0x0BD7, 0x0BD7), (0x0CC2, 0x0CC2), (0x0CD5, 0x0CD6),
+    (0x0D3E, 0x0D3E), (0x0D57, 0x0D57), (0x0DCF, 0x0DCF), (0x0DDF, 0x0DDF),
+    (0x1B35, 0x1B35), (0x200C, 0x200C), (0x302E, 0x302F), (0xFF9E, 0xFF9F),
+    (0x1133E, 0x1133E), (0x11357, 0x11357), (0x114B0, 0x114B0), (0x114BD, 0x114BD),
+    (0x115AF, 0x115AF), (0x11930, 0x11930), (0x1D165, 0x1D165), (0x1D16E, 0x1D172),
+    (0x1F3FB, 0x1F3FF), (0xE0020, 0xE007F),
+]
+
+kPrependRanges = [
+    (0x0600, 0x0605), (0x06DD, 0x06DD), (0x070F, 0x070F), (0x0890, 0x0891),
+    (0x08E2, 0x08E2), (0x0D4E, 0x0D4E), (0x110BD, 0x110BD), (0x110CD, 0x110CD),
+    (0x111C2, 0x111C3), (0x1193F, 0x1193F), (0x11941, 0x11941), (0x11A3A, 0x11A3A),
+    (0x11A84, 0x11A89), (0x11D46, 0x11D46),
+]
+
+# spacing marks that do NOT join the previous character
+kNotSpacingMark = [
+    (0x102B, 0x102C), (0x1038, 0x1038), (0x1062, 0x1064), (0x1067, 0x106D),
+    (0x1083, 0x1083), (0x1087, 0x108C), (0x108F, 0x108F), (0x109A, 0x109C),
+    (0x1A61, 0x1A61), (0x1A63, 0x1A64), (0xAA7B, 0xAA7B), (0xAA7D, 0xAA7D),
+    (0x11720, 0x11721),
+]
+
+kExtraSpacingMark = [(0x0E33, 0x0E33), (0x0EB3, 0x0EB3)]
+
+kExtendedPictographicRanges = [
+    (0x00A9, 0x00A9), (0x00AE, 0x00AE), (0x203C, 0x203C), (0x2049, 0x2049),
+    (0x2122, 0x2122), (0x2139, 0x2139), (0x2194, 0x2199), (0x21A9, 0x21AA),
+    (0x231A, 0x231B), (0x2328, 0x2328), (0x2388, 0x2388), (0x23CF, 0x23CF),
+    (0x23E9, 0x23F3), (0x23F8, 0x23FA), (0x24C2, 0x24C2), (0x25AA, 0x25AB),
+    (0x25B6, 0x25B6), (0x25C0, 0x25C0), (0x25FB, 0x25FE), (0x2600, 0x2605),
+    (0x2607, 0x2612), (0x2614, 0x2685), (0x2690, 0x2705), (0x2708, 0x2712),
+    (0x2714, 0x2714), (0x2716, 0x2716), (0x271D, 0x271D), (0x2721, 0x2721),
+    (0x2728, 0x2728), (0x2733, 0x2734), (0x2744, 0x2744), (0x2747, 0x2747),
+    (0x274C, 0x274C), (0x274E, 0x274E), (0x2753, 0x2755), (0x2757, 0x2757),
+    (0x2763, 0x2767), (0x2795, 0x2797), (0x27A1, 0x27A1), (0x27B0, 0x27B0),
+    (0x27BF, 0x27BF), (0x2934, 0x2935), (0x2B05, 0x2B07), (0x2B1B, 0x2B1C),
+    (0x2B50, 0x2B50), (0x2B55, 0x2B55), (0x3030, 0x3030), (0x303D, 0x303D),
+    (0x3297, 0x3297), (0x3299, 0x3299), (0x1F000, 0x1F0FF), (0x1F10D, 0x1F10F),
+    (0x1F12F, 0x1F12F), (0x1F16C, 0x1F171), (0x1F17E, 0x1F17F), (0x1F18E, 0x1F18E),
+    (0x1F191, 0x1F19A), (0x1F1AD, 0x1F1E5), (0x1F201, 0x1F20F), (0x1F21A, 0x1F21A),
+    (0x1F22F, 0x1F22F), (0x1F232, 0x1F23A), (0x1F23C, 0x1F23F), (0x1F249, 0x1F3FA),
+    (0x1F400, 0x1F53D), (0x1F546, 0x1F64F), (0x1F680, 0x1F6FF), (0x1F774, 0x1F77F),
+    (0x1F7D5, 0x1F7FF), (0x1F80C, 0x1F80F), (0x1F848, 0x1F84F), (0x1F85A, 0x1F85F),
+    (0x1F888, 0x1F88F), (0x1F8AE, 0x1F8FF), (0x1F90C, 0x1F93A), (0x1F93C, 0x1F945),
+    (0x1F947, 0x1FAFF), (0x1FC00, 0x1FFFD),
+]
+
+# ranges that are always double-width, even where unassigned
+kWideRanges = [
+    (0x3400, 0x4DBF), (0x4E00, 0x9FFF), (0xF900, 0xFAFF),
+    (0x1F300, 0x1F64F), (0x1F900, 0x1F9FF),
+    (0x20000, 0x2FFFD), (0x30000, 0x3FFFD),
+]
+
+
+def inRanges(codePoint, ranges):
+    for first, last in ranges:
+        if first <= codePoint <= last:
+            return True
+    return False
+
+
+def breakClass(codePoint, category):
+    if codePoint == 0x0D: return kCR
+    if codePoint == 0x0A: return kLF
+    if codePoint == 0x200D: return kZWJ
+    if 0x1F1E6 <= codePoint <= 0x1F1FF: return kRegionalIndicator
+    if inRanges(codePoint, kPrependRanges): return kPrepend
+    if inRanges(codePoint, kOtherExtend) or category in ('Mn', 'Me'): return kExtend
+    if category in ('Cc', 'Cf', 'Zl', 'Zp', 'Cs'): return kControl
+    if (category == 'Mc' and not inRanges(codePoint, kNotSpacingMark)) or \
+            inRanges(codePoint, kExtraSpacingMark):
+        return kSpacingMark
+    if (0x1100 <= codePoint <= 0x115F) or (0xA960 <= codePoint <= 0xA97C): return kHangulL
+    if (0x1160 <= codePoint <= 0x11A7) or (0xD7B0 <= codePoint <= 0xD7C6): return kHangulV
+    if (0x11A8 <= codePoint <= 0x11FF) or (0xD7CB <= codePoint <= 0xD7FB): return kHangulT
+    if 0xAC00 <= codePoint <= 0xD7A3:
+        return kHangulLV if (0 == ((codePoint - 0xAC00) % 28)) else kHangulLVT
+    if inRanges(codePoint, kExtendedPictographicRanges): return kExtendedPictographic
+    return kOther
+
+
+def cellCount(codePoint, category):
+    if codePoint == 0x00AD: return 1 # soft hyphen is visible in terminals
+    if category in ('Mn', 'Me', 'Cc', 'Cf', 'Zl', 'Zp'): return 0
+    if (0x1160 <= codePoint <= 0x11FF) or (0xD7B0 <= codePoint <= 0xD7FF): return 0 # conjoining vowels and finals
+    if unicodedata.east_asian_width(chr(codePoint)) in ('W', 'F'): return 2
+    if inRanges(codePoint, kWideRanges): return 2
+    return 1
+
+
+def propertiesByte(codePoint):
+    category = unicodedata.category(chr(codePoint))
+    return cellCount(codePoint, category) | (breakClass(codePoint, category) << 2)
+
+
+def main():
+    blockSize = (1 << kBlockBits)
+    blocks = []
+    blockIndexByContents = {}
+    indexes = []
+    for blockStart in range(0, kCodePointLimit, blockSize):
+        contents = bytes(propertiesByte(cp) for cp in range(blockStart, blockStart + blockSize))
+        if contents not in blockIndexByContents:
+            blockIndexByContents[contents] = len(blocks)
+            blocks.append(contents)
+        indexes.append(blockIndexByContents[contents])
+    if len(blocks) > 256: raise Exception('too many unique blocks for 8-bit indexes: %d' % len(blocks))
+
+    print('/*!\t\\file UnicodeWidthTable.h')
+    print('\t\\brief Generated data for the UnicodeWidth module.')
+    print('\t')
+    print('\tIMPORTANT:\tDo not edit; this is created by running the')
+    print('\t\t\tscript Tools/GenerateUnicodeWidthTable.py (from')
+    print('\t\t\tUnicode %s, %d unique blocks).' % (unicodedata.unidata_version, len(blocks)))
+    print('*/')
+    print('')
+    print('#pragma once')
+    print('')
+    print('')
+    print('')
+    print('#pragma mark Variables')
+    print('')
+    print('//! bits of a code point that select a block of "kUnicodeWidth_BlockBytes"')
+    print('UInt8 const\t\tkUnicodeWidth_BlockBits = %d;' % kBlockBits)
+    print('')
+    print('//! index into "kUnicodeWidth_BlockBytes" (in units of blocks) for each code point shifted by "kUnicodeWidth_BlockBits"')
+    print('inline constexpr UInt8\t\tkUnicodeWidth_BlockIndexes[%d] =' % len(indexes))
+    print('{')
+    for i in range(0, len(indexes), 16):
+        print('\t' + ', '.join('0x%02X' % x for x in indexes[i:i + 16]) + ',')
+    print('};')
+    print('')
+    print('//! properties of each code point (see UnicodeWidth_ReturnProperties())')
+    print('inline constexpr UInt8\t\tkUnicodeWidth_BlockBytes[%d] =' % (len(blocks) * blockSize))
+    print('{')
+    for blockIndex, contents in enumerate(blocks):
+        print('\t// block %d' % blockIndex)
+        for i in range(0, blockSize, 16):
+            print('\t' + ', '.join('0x%02X' % x for x in contents[i:i + 16]) + ',')
+    print('};')
+    print('')
+    print('// BELOW IS REQUIRED NEWLINE TO END FILE')
+
+
+if __name__ == '__main__':
+    main()